@@ -42,7 +42,9 @@ project (_AMD_SAMPLE_NAME)
    targetdir "../bin"
    objdir "../build/%{_AMD_SAMPLE_DIR_LAYOUT}"
    warnings "Extra"
-   floatingpoint "Fast"
+   -- /fp:precise, as the CPU code's scalar and SIMD paths must give the same bits
+   -- (-cpubenchmark reports any difference), which /fp:fast does not keep
+   floatingpoint "Default"
 
    -- Specify WindowsTargetPlatformVersion here for VS2015
    windowstarget (_AMD_WIN_SDK_VERSION)
@@ -0,0 +1,235 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUBenchmark.cpp
+//
+// Headless benchmark for the CPU code paths: the command line and the report. The parts of
+// the benchmark are in CPUBenchmarkCulling.cpp, CPUBenchmarkLights.cpp, CPUBenchmarkShadows.cpp,
+// CPUBenchmarkVPLs.cpp and CPUBenchmarkReadback.cpp.
+//--------------------------------------------------------------------------------------
+
+#include "CPUBenchmark.h"
+#include "CPUBenchmarkUtil.h"
+#include "CPUTaskScheduler.h"
+
+#include <stdio.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <thread>
+#include <vector>
+
+namespace TiledLighting11
+{
+    // case-insensitive match of "-name" or "/name", with an optional ":value" suffix
+    static bool MatchOption( const std::wstring& Token, const wchar_t* pName, std::wstring* pValue )
+    {
+        if( Token.size() < 2 || ( Token[0] != L'-' && Token[0] != L'/' ) )
+        {
+            return false;
+        }
+
+        size_t i = 1;
+        for( ; *pName != L'\0'; pName++, i++ )
+        {
+            if( i >= Token.size() || towlower( Token[i] ) != towlower( *pName ) )
+            {
+                return false;
+            }
+        }
+
+        if( i == Token.size() )
+        {
+            if( pValue ) pValue->clear();
+            return true;
+        }
+
+        if( Token[i] != L':' || pValue == NULL )
+        {
+            return false;
+        }
+
+        *pValue = Token.substr( i + 1 );
+        return true;
+    }
+
+    static unsigned ParseUnsigned( const std::wstring& Value, unsigned uDefault )
+    {
+        wchar_t* pEnd = NULL;
+        unsigned long uResult = wcstoul( Value.c_str(), &pEnd, 10 );
+        return ( pEnd != Value.c_str() && *pEnd == L'\0' ) ? (unsigned)uResult : uDefault;
+    }
+
+    // paths are expected to be plain ASCII
+    static std::string ToASCIIPath( const std::wstring& Value )
+    {
+        std::string Path;
+        for( size_t j = 0; j < Value.size(); j++ )
+        {
+            Path += ( Value[j] < 128 ) ? (char)Value[j] : '_';
+        }
+        return Path;
+    }
+
+    // split on whitespace
+    static void SplitCommandLine( const wchar_t* pCommandLine, std::vector<std::wstring>& Tokens )
+    {
+        std::wstring Token;
+        for( const wchar_t* p = pCommandLine; ; p++ )
+        {
+            if( *p == L'\0' || iswspace( *p ) )
+            {
+                if( !Token.empty() ) Tokens.push_back( Token );
+                Token.clear();
+                if( *p == L'\0' ) break;
+            }
+            else
+            {
+                Token += *p;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Look for -cpubenchmark and its options
+    //--------------------------------------------------------------------------------------
+    bool ParseCPUBenchmarkCommandLine( const wchar_t* pCommandLine, CPUBenchmarkConfig& Config )
+    {
+        if( pCommandLine == NULL )
+        {
+            return false;
+        }
+
+        std::vector<std::wstring> Tokens;
+        SplitCommandLine( pCommandLine, Tokens );
+
+        bool bBenchmark = false;
+        std::wstring Value;
+        for( size_t i = 0; i < Tokens.size(); i++ )
+        {
+            if( MatchOption( Tokens[i], L"cpubenchmark", NULL ) )       bBenchmark = true;
+            else if( MatchOption( Tokens[i], L"width", &Value ) )       Config.uWidth = ParseUnsigned( Value, Config.uWidth );
+            else if( MatchOption( Tokens[i], L"height", &Value ) )      Config.uHeight = ParseUnsigned( Value, Config.uHeight );
+            else if( MatchOption( Tokens[i], L"msaa", &Value ) )        Config.uNumSamples = ParseUnsigned( Value, Config.uNumSamples );
+            else if( MatchOption( Tokens[i], L"lights", &Value ) )      Config.uNumLights = ParseUnsigned( Value, Config.uNumLights );
+            else if( MatchOption( Tokens[i], L"frames", &Value ) )      Config.uNumFrames = ParseUnsigned( Value, Config.uNumFrames );
+            else if( MatchOption( Tokens[i], L"threads", &Value ) )     Config.uMaxNumThreads = ParseUnsigned( Value, Config.uMaxNumThreads );
+            else if( MatchOption( Tokens[i], L"slices", &Value ) )      Config.uNumSlices = ParseUnsigned( Value, Config.uNumSlices );
+            else if( MatchOption( Tokens[i], L"zbins", &Value ) )       Config.uNumZBins = ParseUnsigned( Value, Config.uNumZBins );
+            else if( MatchOption( Tokens[i], L"out", &Value ) )         Config.OutputPath = ToASCIIPath( Value );
+            else if( MatchOption( Tokens[i], L"telemetry", &Value ) )   Config.TelemetryPath = ToASCIIPath( Value );
+        }
+
+        // keep the configuration sane
+        if( Config.uWidth == 0 ) Config.uWidth = 1;
+        if( Config.uHeight == 0 ) Config.uHeight = 1;
+        if( Config.uNumSamples != 1 && Config.uNumSamples != 2 && Config.uNumSamples != 4 && Config.uNumSamples != 8 ) Config.uNumSamples = 1;
+        if( Config.uNumLights > 65535 ) Config.uNumLights = 65535;
+        if( Config.uNumFrames == 0 ) Config.uNumFrames = 1;
+        if( Config.uNumSlices == 0 || Config.uNumSlices > 256 ) Config.uNumSlices = 16;
+        if( Config.uNumZBins == 0 || Config.uNumZBins > 65536 ) Config.uNumZBins = 256;
+
+        return bBenchmark;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Look for one -name:value option
+    //--------------------------------------------------------------------------------------
+    bool GetCommandLineOption( const wchar_t* pCommandLine, const wchar_t* pName, std::string& Value )
+    {
+        if( pCommandLine == NULL )
+        {
+            return false;
+        }
+
+        std::vector<std::wstring> Tokens;
+        SplitCommandLine( pCommandLine, Tokens );
+
+        std::wstring WideValue;
+        for( size_t i = 0; i < Tokens.size(); i++ )
+        {
+            if( MatchOption( Tokens[i], pName, &WideValue ) && !WideValue.empty() )
+            {
+                Value = ToASCIIPath( WideValue );
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Run the benchmark
+    //--------------------------------------------------------------------------------------
+    int RunCPUBenchmark( const CPUBenchmarkConfig& Config )
+    {
+        FILE* pReport = OpenReport( Config.OutputPath );
+        if( pReport == NULL )
+        {
+            return 1;
+        }
+
+        unsigned uMaxNumThreads = Config.uMaxNumThreads ? Config.uMaxNumThreads : std::thread::hardware_concurrency();
+        if( uMaxNumThreads == 0 ) uMaxNumThreads = 1;
+
+        CPUTaskScheduler Scheduler( uMaxNumThreads );
+
+        int nResult = 0;
+
+        if( !RunLightCullingBenchmarks( pReport, Config, Scheduler ) )
+        {
+            nResult = 1;
+        }
+
+        if( !RunLightBenchmarks( pReport, Config, Scheduler ) )
+        {
+            nResult = 1;
+        }
+
+        if( !RunShadowBenchmarks( pReport, Config, Scheduler ) )
+        {
+            nResult = 1;
+        }
+
+        if( !RunVPLBenchmarks( pReport, Config, Scheduler ) )
+        {
+            nResult = 1;
+        }
+
+        if( !RunReadbackBenchmarks( pReport ) )
+        {
+            nResult = 1;
+        }
+
+        if( pReport != stdout )
+        {
+            fclose( pReport );
+        }
+
+        return nResult;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
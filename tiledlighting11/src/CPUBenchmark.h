@@ -0,0 +1,78 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUBenchmark.h
+//
+// Headless benchmark for the CPU code paths, run with -cpubenchmark on the command line.
+// It never creates a window or a D3D device, so it can run on build machines without a GPU.
+// This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <string>
+
+namespace TiledLighting11
+{
+    struct CPUBenchmarkConfig
+    {
+        CPUBenchmarkConfig()
+            :uWidth(1920)
+            ,uHeight(1080)
+            ,uNumSamples(1)
+            ,uNumLights(2048)
+            ,uNumFrames(20)
+            ,uMaxNumThreads(0)
+            ,uNumSlices(16)
+            ,uNumZBins(256)
+        {
+        }
+
+        unsigned        uWidth;             // -width:N
+        unsigned        uHeight;            // -height:N
+        unsigned        uNumSamples;        // -msaa:N
+        unsigned        uNumLights;         // -lights:N, for both point and spot lights
+        unsigned        uNumFrames;         // -frames:N, timed iterations per configuration
+        unsigned        uMaxNumThreads;     // -threads:N, 0 means one per hardware thread
+        unsigned        uNumSlices;         // -slices:N, depth slices per tile for the clustered mode
+        unsigned        uNumZBins;          // -zbins:N, depth bins for the z-binned mode
+        std::string     OutputPath;         // -out:path, empty means stdout
+        std::string     TelemetryPath;      // -telemetry:path, light list occupancy as CSV, or JSON Lines if it ends in .json
+    };
+
+    // Returns true if the command line contains -cpubenchmark, filling in Config from the other options
+    bool ParseCPUBenchmarkCommandLine( const wchar_t* pCommandLine, CPUBenchmarkConfig& Config );
+
+    // For the sample's own options: true if the command line contains -name:value, with the value as an ASCII path
+    bool GetCommandLineOption( const wchar_t* pCommandLine, const wchar_t* pName, std::string& Value );
+
+    // Runs the benchmark and writes the report. Returns 0 if every configuration
+    // produced the same index buffers as the single-threaded scalar oracle,
+    // and every other check in the report passed.
+    int RunCPUBenchmark( const CPUBenchmarkConfig& Config );
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
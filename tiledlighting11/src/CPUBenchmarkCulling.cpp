@@ -0,0 +1,1261 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUBenchmarkCulling.cpp
+//
+// The light culling part of the headless CPU benchmark: the culler at every SIMD level
+// and thread count against the single-threaded scalar oracle, and the other culling modes.
+//--------------------------------------------------------------------------------------
+
+#include "CPUBenchmarkUtil.h"
+#include "CPUClusteredCulling.h"
+#include "CPUCompactLightCulling.h"
+#include "CPUHierarchicalCulling.h"
+#include "CPUIncrementalCulling.h"
+#include "CPULightBVH.h"
+#include "CPULightListTelemetry.h"
+#include "CPUScene.h"
+#include "CPUSpotLightCulling.h"
+#include "CPUTaskScheduler.h"
+#include "CPUZBinnedCulling.h"
+#include "CommonConstants.h"
+#include "DefaultScene.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace TiledLighting11
+{
+    //--------------------------------------------------------------------------------------
+    // Time uNumFrames calls to CullLights
+    //--------------------------------------------------------------------------------------
+    // CPULightCuller or any culler with the same CullLights
+    template<class LightCuller>
+    static double TimeCullLights( LightCuller& Culler, const CPULightCullingInput& Input, CPULightCullingOutput& Output, CPUTaskScheduler* pScheduler, unsigned uNumFrames )
+    {
+        // warm up (allocates the output and the view-space light arrays)
+        Culler.CullLights( Input, Output, pScheduler );
+
+        return TimeIterations( uNumFrames, [&]()
+        {
+            Culler.CullLights( Input, Output, pScheduler );
+        } );
+    }
+
+    static bool OutputsMatch( const CPULightCullingOutput& A, const CPULightCullingOutput& B )
+    {
+        return A.PointIndexBuffer == B.PointIndexBuffer && A.SpotIndexBuffer == B.SpotIndexBuffer && A.VPLIndexBuffer == B.VPLIndexBuffer;
+    }
+
+    // true if any of the uNumLights indices at pIndices is uLight
+    static bool ListContains( const unsigned short* pIndices, unsigned uNumLights, unsigned uLight )
+    {
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            if( pIndices[i] == uLight ) return true;
+        }
+        return false;
+    }
+
+    // true if the sphere c, in world space, contains the view-space point Pos.
+    // The radius is shrunk a little to stay clear of the boundary, where float rounding decides.
+    static bool LightTouchesPoint( const CPUMatrix& mView, const CPUFloat4& c, const float Pos[3] )
+    {
+        const float (*m)[4] = mView.m;
+        const float d[3] =
+        {
+            c.x*m[0][0] + c.y*m[1][0] + c.z*m[2][0] + m[3][0] - Pos[0],
+            c.x*m[0][1] + c.y*m[1][1] + c.z*m[2][1] + m[3][1] - Pos[1],
+            c.x*m[0][2] + c.y*m[1][2] + c.z*m[2][2] + m[3][2] - Pos[2],
+        };
+
+        const float fRadius = 0.99f*c.w;
+        return d[0]*d[0] + d[1]*d[1] + d[2]*d[2] < fRadius*fRadius;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Clustered culling: timing, per-pixel list lengths compared to the halfZ lists, memory,
+    // and a brute-force check that every light touching a pixel is in that pixel's cluster
+    //--------------------------------------------------------------------------------------
+    static bool RunClusteredBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, const CPUScene& Scene, const CPULightCullingInput& Input,
+        const CPULightCullingOutput& HalfZ, CPUTaskScheduler& Scheduler )
+    {
+        // exponential slices from 1/64th of the far plane distance out to the far plane
+        CPUClusterSlicing Slicing;
+        Slicing.uNumSlices = Config.uNumSlices;
+        Slicing.fFarZ = CPULightCuller::ConvertProjDepthToView( Input.mProjectionInv, 0.0f );
+        Slicing.fNearZ = Slicing.fFarZ / 64.0f;
+
+        CPUClusteredLightCuller Culler;
+        CPUClusteredCullingOutput Output;
+        Culler.CullLights( Input, Slicing, Output, &Scheduler );
+
+        const double fTime = TimeIterations( Config.uNumFrames, [&]()
+        {
+            Culler.CullLights( Input, Slicing, Output, &Scheduler );
+        } );
+
+        // walk the pixels (sample 0), looking up both list layouts
+        unsigned long long uNumHalfZ = 0, uNumClustered = 0, uNumMissing = 0;
+        for( unsigned y = 0; y < Scene.uHeight; y++ )
+        {
+            for( unsigned x = 0; x < Scene.uWidth; x++ )
+            {
+                const float fDepth = Scene.Depth[( (size_t)y*Scene.uWidth + x )*Scene.uNumSamples];
+                if( fDepth == 0.0f )
+                {
+                    continue;
+                }
+
+                const float fViewZ = CPULightCuller::ConvertProjDepthToView( Input.mProjectionInv, fDepth );
+
+                for( int nType = 0; nType < 2; nType++ )
+                {
+                    const std::vector<unsigned short>& HalfZBuffer = ( nType == 0 ) ? HalfZ.PointIndexBuffer : HalfZ.SpotIndexBuffer;
+                    const CPUClusterLists& Lists = ( nType == 0 ) ? Output.PointLists : Output.SpotLists;
+                    const CPUFloat4* pLights = ( nType == 0 ) ? Input.pPointLightCenterAndRadius : Input.pSpotLightCenterAndRadius;
+                    const unsigned uNumLights = ( nType == 0 ) ? Input.uNumPointLights : Input.uNumSpotLights;
+
+                    unsigned uFirst, uCount;
+                    CPULightCuller::GetLightListInfo( &HalfZBuffer[0], HalfZ.uNumTilesX, Input.uMaxNumLightsPerTile, x, y, fViewZ, uFirst, uCount );
+                    uNumHalfZ += uCount;
+
+                    CPUClusteredLightCuller::GetClusterLightListInfo( Output, Lists, x, y, fViewZ, uFirst, uCount );
+                    uNumClustered += uCount;
+
+                    // brute force on a sparse grid of pixels
+                    if( ( x % 8 ) != 4 || ( y % 8 ) != 4 || uNumLights == 0 )
+                    {
+                        continue;
+                    }
+
+                    const float fNdcX = ( x + 0.5f ) / Scene.uWidth * 2.0f - 1.0f;
+                    const float fNdcY = 1.0f - ( y + 0.5f ) / Scene.uHeight * 2.0f;
+                    const float Pos[3] = { fNdcX*Input.mProjectionInv.m[0][0]*fViewZ, fNdcY*Input.mProjectionInv.m[1][1]*fViewZ, fViewZ };
+
+                    for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+                    {
+                        if( LightTouchesPoint( Input.mView, pLights[uLight], Pos ) &&
+                            ( uCount == 0 || !ListContains( &Lists.Indices[uFirst], uCount, uLight ) ) )
+                        {
+                            uNumMissing++;
+                        }
+                    }
+                }
+            }
+        }
+
+        const size_t uHalfZBytes = ( HalfZ.PointIndexBuffer.size() + HalfZ.SpotIndexBuffer.size() )*sizeof(unsigned short);
+        const size_t uClusteredBytes = ( Output.PointLists.OffsetAndCount.size() + Output.SpotLists.OffsetAndCount.size() )*sizeof(unsigned) +
+            ( Output.PointLists.Indices.size() + Output.SpotLists.Indices.size() )*sizeof(unsigned short);
+
+        fprintf( pReport, "\nclustered culling, %u exponential slices per tile from %.1f to %.1f, %u threads\n",
+            Slicing.uNumSlices, Slicing.fNearZ, Slicing.fFarZ, Scheduler.GetNumThreads() );
+        fprintf( pReport, "%-8s %12.3f ms/frame\n", "time", fTime*1000.0 );
+        fprintf( pReport, "%-8s %12.2f halfZ, %.2f clustered (point + spot lights per pixel)\n", "lights", (double)uNumHalfZ / ( (double)Scene.uWidth*Scene.uHeight ), (double)uNumClustered / ( (double)Scene.uWidth*Scene.uHeight ) );
+        fprintf( pReport, "%-8s %12.2f MB halfZ, %.2f MB clustered\n", "memory", uHalfZBytes / ( 1024.0*1024.0 ), uClusteredBytes / ( 1024.0*1024.0 ) );
+        fprintf( pReport, "%-8s %12llu lights missing from their pixel's cluster  %s\n", "check", uNumMissing, GetCheckResult( uNumMissing == 0 ) );
+
+        return uNumMissing == 0;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Z-binned culling: timing, per-pixel light counts and memory compared to the halfZ lists,
+    // a cross-check that every halfZ light touching a pixel is in the pixel's z-binned set,
+    // and the same brute-force check as the clustered mode
+    //--------------------------------------------------------------------------------------
+    static bool RunZBinnedBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, const CPUScene& Scene, const CPULightCullingInput& Input,
+        const CPULightCullingOutput& HalfZ, CPUTaskScheduler& Scheduler )
+    {
+        CPUZBinning Binning;
+        Binning.uNumBins = Config.uNumZBins;
+        Binning.fFarZ = CPULightCuller::ConvertProjDepthToView( Input.mProjectionInv, 0.0f );
+
+        CPUZBinnedLightCuller Culler;
+        CPUZBinnedCullingOutput Output;
+        Culler.CullLights( Input, Binning, Output, &Scheduler );
+
+        const double fTime = TimeIterations( Config.uNumFrames, [&]()
+        {
+            Culler.CullLights( Input, Binning, Output, &Scheduler );
+        } );
+
+        unsigned long long uNumHalfZ = 0, uNumZBinned = 0, uNumHalfZMissing = 0, uNumMissing = 0;
+        std::vector<unsigned> Indices;
+        for( unsigned y = 0; y < Scene.uHeight; y++ )
+        {
+            for( unsigned x = 0; x < Scene.uWidth; x++ )
+            {
+                const float fDepth = Scene.Depth[( (size_t)y*Scene.uWidth + x )*Scene.uNumSamples];
+                if( fDepth == 0.0f )
+                {
+                    continue;
+                }
+
+                const float fViewZ = CPULightCuller::ConvertProjDepthToView( Input.mProjectionInv, fDepth );
+                const float fNdcX = ( x + 0.5f ) / Scene.uWidth * 2.0f - 1.0f;
+                const float fNdcY = 1.0f - ( y + 0.5f ) / Scene.uHeight * 2.0f;
+                const float Pos[3] = { fNdcX*Input.mProjectionInv.m[0][0]*fViewZ, fNdcY*Input.mProjectionInv.m[1][1]*fViewZ, fViewZ };
+
+                for( int nType = 0; nType < 2; nType++ )
+                {
+                    const std::vector<unsigned short>& HalfZBuffer = ( nType == 0 ) ? HalfZ.PointIndexBuffer : HalfZ.SpotIndexBuffer;
+                    const CPUZBinnedLights& Lights = ( nType == 0 ) ? Output.PointLights : Output.SpotLights;
+                    const CPUFloat4* pLights = ( nType == 0 ) ? Input.pPointLightCenterAndRadius : Input.pSpotLightCenterAndRadius;
+                    const unsigned uNumLights = ( nType == 0 ) ? Input.uNumPointLights : Input.uNumSpotLights;
+
+                    Indices.clear();
+                    CPUZBinnedLightCuller::GetZBinnedLights( Output, Lights, x, y, fViewZ, Indices );
+                    uNumZBinned += Indices.size();
+
+                    // every light of the halfZ list that reaches this pixel must be in the z-binned set
+                    unsigned uFirst, uCount;
+                    CPULightCuller::GetLightListInfo( &HalfZBuffer[0], HalfZ.uNumTilesX, Input.uMaxNumLightsPerTile, x, y, fViewZ, uFirst, uCount );
+                    uNumHalfZ += uCount;
+                    uCount = std::min( uCount, Input.uMaxNumLightsPerTile );
+                    for( unsigned i = 0; i < uCount; i++ )
+                    {
+                        const unsigned uLight = HalfZBuffer[uFirst + i];
+                        if( LightTouchesPoint( Input.mView, pLights[uLight], Pos ) &&
+                            std::find( Indices.begin(), Indices.end(), uLight ) == Indices.end() )
+                        {
+                            uNumHalfZMissing++;
+                        }
+                    }
+
+                    // brute force on a sparse grid of pixels
+                    if( ( x % 8 ) != 4 || ( y % 8 ) != 4 )
+                    {
+                        continue;
+                    }
+
+                    for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+                    {
+                        if( LightTouchesPoint( Input.mView, pLights[uLight], Pos ) &&
+                            std::find( Indices.begin(), Indices.end(), uLight ) == Indices.end() )
+                        {
+                            uNumMissing++;
+                        }
+                    }
+                }
+            }
+        }
+
+        const size_t uHalfZBytes = ( HalfZ.PointIndexBuffer.size() + HalfZ.SpotIndexBuffer.size() )*sizeof(unsigned short);
+        const size_t uZBinnedBytes = Output.PointLights.GetMemorySize() + Output.SpotLights.GetMemorySize();
+        const double fNumPixels = (double)Scene.uWidth*Scene.uHeight;
+
+        fprintf( pReport, "\nz-binned culling, %u linear bins from 0 to %.1f, %u mask words per tile, %u threads\n",
+            Binning.uNumBins, Binning.fFarZ, Output.PointLights.uNumMaskWords, Scheduler.GetNumThreads() );
+        fprintf( pReport, "%-8s %12.3f ms/frame\n", "time", fTime*1000.0 );
+        fprintf( pReport, "%-8s %12.2f halfZ, %.2f z-binned (point + spot lights per pixel)\n", "lights", uNumHalfZ / fNumPixels, uNumZBinned / fNumPixels );
+        fprintf( pReport, "%-8s %12.2f MB halfZ, %.2f MB z-binned\n", "memory", uHalfZBytes / ( 1024.0*1024.0 ), uZBinnedBytes / ( 1024.0*1024.0 ) );
+        fprintf( pReport, "%-8s %12llu halfZ lights touching a pixel missing from its z-binned set  %s\n", "check", uNumHalfZMissing, GetCheckResult( uNumHalfZMissing == 0 ) );
+        fprintf( pReport, "%-8s %12llu lights missing from their pixel's z-binned set  %s\n", "check", uNumMissing, GetCheckResult( uNumMissing == 0 ) );
+
+        return uNumHalfZMissing == 0 && uNumMissing == 0;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Light BVH: flat loop vs. hierarchy traversal at 2k, 16k and 128k point lights, with the
+    // radius scaled so the lit fraction of the room stays the same as with 2k lights
+    //--------------------------------------------------------------------------------------
+    static bool RunLightBVHBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, const CPULightCullingInput& OracleInput,
+        const CPULightCullingOutput& Oracle, CPUTaskScheduler& Scheduler )
+    {
+        // the index buffers must not change when CPULightCuller uses the hierarchies
+        CPULightCuller BVHCuller;
+        BVHCuller.SetUseLightBVH( true );
+        CPULightCullingOutput BVHOutput;
+        BVHCuller.CullLights( OracleInput, BVHOutput, &Scheduler );
+        bool bResult = OutputsMatch( BVHOutput, Oracle );
+
+        fprintf( pReport, "\nlight BVH (LBVH, %u lights per leaf), point lights only, %u threads; index buffers with the BVH: %s\n",
+            CPULightBVH::MAX_LEAF_SIZE, Scheduler.GetNumThreads(), GetMatchResult( bResult ) );
+        fprintf( pReport, "%8s %8s %14s %12s %12s %12s %9s  %s\n", "lights", "radius", "lights/tile", "ms flat", "ms build", "ms BVH", "speedup", "vs. flat" );
+
+        static const unsigned kNumLights[] = { 2048, 16384, 131072 };
+        const CPUSIMDLevel Level = GetCPUSIMDLevel();
+
+        for( unsigned uTest = 0; uTest < sizeof(kNumLights)/sizeof(kNumLights[0]); uTest++ )
+        {
+            CPUSceneDesc SceneDesc;
+            SceneDesc.uWidth = Config.uWidth;
+            SceneDesc.uHeight = Config.uHeight;
+            SceneDesc.uNumSamples = Config.uNumSamples;
+            SceneDesc.uNumPointLights = kNumLights[uTest];
+            SceneDesc.uNumSpotLights = 0;
+            SceneDesc.fLightRadiusScale = powf( 2048.0f / kNumLights[uTest], 1.0f/3.0f );
+
+            CPUScene Scene;
+            CreateCPUScene( SceneDesc, Scene );
+
+            CPULightCullingInput Input;
+            FillCPULightCullingInput( Scene, GetMaxNumLightsPerTile( SceneDesc.uHeight ), Input );
+
+            const unsigned uNumTilesX = CPULightCuller::GetNumTiles( Input.uWidth );
+            const unsigned uNumTiles = uNumTilesX * CPULightCuller::GetNumTiles( Input.uHeight );
+            std::vector<CPUTileFrustum> Frusta( uNumTiles );
+            for( unsigned uTile = 0; uTile < uNumTiles; uTile++ )
+            {
+                CPULightCuller::BuildTileFrustum( Input, uTile % uNumTilesX, uTile / uNumTilesX, Frusta[uTile] );
+                CPULightCuller::CalculateTileDepthBounds( Input, uTile % uNumTilesX, uTile / uNumTilesX, Frusta[uTile] );
+            }
+
+            CPUViewSpaceLights Lights;
+            CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pPointLightCenterAndRadius, Input.uNumPointLights, Lights );
+
+            // keep the flat loop to about a billion sphere tests per configuration
+            const unsigned uNumFrames = std::max( 1u, std::min( Config.uNumFrames, (unsigned)( 1.0e9 / ( (double)uNumTiles*Input.uNumPointLights ) ) ) );
+
+            const unsigned uNumThreads = Scheduler.GetNumThreads();
+            std::vector< std::vector<unsigned> > FlatA( uNumTiles ), FlatB( uNumTiles );
+            std::vector< std::vector<unsigned> > ThreadListsA( uNumThreads ), ThreadListsB( uNumThreads );
+            std::vector<unsigned char> ThreadMismatch( uNumThreads, 0 );
+            CPULightBVH BVH;
+            unsigned long long uNumIndices = 0;
+
+            CPUTaskScheduler::RangeFunction CullFlat = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+            {
+                for( unsigned uTile = uBegin; uTile < uEnd; uTile++ )
+                {
+                    CPULightCuller::CullLightsAgainstTile( Lights, Frusta[uTile], Level, FlatA[uTile], FlatB[uTile] );
+                }
+            };
+
+            // compares against the flat lists, which run first
+            CPUTaskScheduler::RangeFunction CullBVH = [&]( unsigned uBegin, unsigned uEnd, unsigned uThreadIndex )
+            {
+                std::vector<unsigned>& ListA = ThreadListsA[uThreadIndex];
+                std::vector<unsigned>& ListB = ThreadListsB[uThreadIndex];
+                for( unsigned uTile = uBegin; uTile < uEnd; uTile++ )
+                {
+                    BVH.CullLightsAgainstTile( Frusta[uTile], ListA, ListB );
+                    if( ListA != FlatA[uTile] || ListB != FlatB[uTile] )
+                    {
+                        ThreadMismatch[uThreadIndex] = 1;
+                    }
+                }
+            };
+
+            const double fFlatTime = TimeIterations( uNumFrames, [&]()
+            {
+                Scheduler.ParallelFor( uNumTiles, 8, CullFlat );
+            } );
+
+            const double fBuildTime = TimeIterations( Config.uNumFrames, [&]()
+            {
+                BVH.Build( Lights, &Scheduler );
+            } );
+
+            const double fTraversalTime = TimeIterations( Config.uNumFrames, [&]()
+            {
+                Scheduler.ParallelFor( uNumTiles, 8, CullBVH );
+            } );
+
+            for( unsigned uTile = 0; uTile < uNumTiles; uTile++ )
+            {
+                uNumIndices += FlatA[uTile].size() + FlatB[uTile].size();
+            }
+            const bool bMatch = std::find( ThreadMismatch.begin(), ThreadMismatch.end(), 1 ) == ThreadMismatch.end();
+            bResult = bResult && bMatch;
+
+            fprintf( pReport, "%8u %8.1f %14.2f %12.3f %12.3f %12.3f %8.2fx  %s\n",
+                Input.uNumPointLights, Scene.PointLightCenterAndRadius[0].w, (double)uNumIndices / uNumTiles,
+                fFlatTime*1000.0, fBuildTime*1000.0, ( fBuildTime + fTraversalTime )*1000.0,
+                fFlatTime / ( fBuildTime + fTraversalTime ), GetMatchResult( bMatch ) );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Spot light culling modes: per-tile spot counts, false positives (tile-light pairs where
+    // the cone lights none of the tile's pixels), and a brute-force check on a sparse grid
+    // of pixels that no lit pixel is missing the light from its list
+    //--------------------------------------------------------------------------------------
+    static bool RunSpotCullingBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, const CPUScene& Scene, const CPULightCullingInput& Input, CPUTaskScheduler& Scheduler )
+    {
+        const unsigned uNumTilesX = CPULightCuller::GetNumTiles( Input.uWidth );
+        const unsigned uNumTiles = uNumTilesX * CPULightCuller::GetNumTiles( Input.uHeight );
+        const unsigned uNumLights = Input.uNumSpotLights;
+        const unsigned uListSize = std::max( uNumLights, 1u );
+
+        // the real screen size, so that every pixel of a tile is inside its frustum
+        std::vector<CPUTileFrustum> Frusta( uNumTiles );
+        for( unsigned uTile = 0; uTile < uNumTiles; uTile++ )
+        {
+            CPULightCuller::BuildTileFrustum( Input, uTile % uNumTilesX, uTile / uNumTilesX, Frusta[uTile], false );
+            CPULightCuller::CalculateTileDepthBounds( Input, uTile % uNumTilesX, uTile / uNumTilesX, Frusta[uTile] );
+        }
+
+        CPUViewSpaceLights Spheres, ConeSpheres;
+        CPUViewSpaceSpotCones Cones;
+        CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pSpotLightCenterAndRadius, uNumLights, Spheres );
+        TransformSpotConesToViewSpace( Input.mView, Input.pSpotLightCenterAndRadius, Input.pSpotParams, uNumLights, Cones );
+        GetSpotConeBoundingSpheres( Cones, ConeSpheres );
+
+        fprintf( pReport, "\nspot light culling, %u spot lights with a %.1f degree cone angle, real-size tile frusta\n",
+            uNumLights, uNumLights ? acosf( Cones.CosAngle[0] )*57.2957795f : 0.0f );
+        fprintf( pReport, "%-12s %10s %12s %14s %16s %10s %8s  %s\n", "mode", "ms/frame", "spots/tile", "pairs", "false positives", "FP saved", "missed", "check" );
+
+        bool bResult = true;
+        unsigned long long uSphereFalsePositives = 0;
+        std::vector<unsigned short> ListsA( (size_t)uNumTiles*uListSize ), ListsB( (size_t)uNumTiles*uListSize );
+        std::vector<unsigned> CountsA( uNumTiles ), CountsB( uNumTiles );
+
+        for( int nMode = 0; nMode < CPU_SPOT_CULLING_NUM_MODES; nMode++ )
+        {
+            // timing, with the whole culler
+            CPULightCuller Culler;
+            Culler.SetSpotCullingMode( (CPUSpotCullingMode)nMode );
+            CPULightCullingOutput Output;
+            const double fTime = TimeCullLights( Culler, Input, Output, &Scheduler, Config.uNumFrames );
+
+            // lists for the checks
+            CPUTaskScheduler::RangeFunction CullTiles = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+            {
+                for( unsigned uTile = uBegin; uTile < uEnd; uTile++ )
+                {
+                    unsigned short* pListA = &ListsA[(size_t)uTile*uListSize];
+                    unsigned short* pListB = &ListsB[(size_t)uTile*uListSize];
+                    if( nMode == CPU_SPOT_CULLING_CONE_TIGHT )
+                    {
+                        CullSpotConesAgainstTile( Cones, Frusta[uTile], pListA, pListB, uListSize, CountsA[uTile], CountsB[uTile] );
+                    }
+                    else
+                    {
+                        const CPUViewSpaceLights& Lights = ( nMode == CPU_SPOT_CULLING_SPHERE ) ? Spheres : ConeSpheres;
+                        CPULightCuller::CullLightsAgainstTile( Lights, Frusta[uTile], CPU_SIMD_AUTO, pListA, pListB, uListSize, CountsA[uTile], CountsB[uTile] );
+                    }
+                }
+            };
+            Scheduler.ParallelFor( uNumTiles, 8, CullTiles );
+
+            // false positives, over the union of lists A and B
+            unsigned long long uNumIndices = 0, uNumPairs = 0, uNumFalsePositives = 0;
+            std::vector<unsigned> Union;
+            for( unsigned uTile = 0; uTile < uNumTiles; uTile++ )
+            {
+                const unsigned short* pListA = &ListsA[(size_t)uTile*uListSize];
+                const unsigned short* pListB = &ListsB[(size_t)uTile*uListSize];
+                uNumIndices += CountsA[uTile] + CountsB[uTile];
+
+                Union.clear();
+                std::set_union( pListA, pListA + CountsA[uTile], pListB, pListB + CountsB[uTile], std::back_inserter( Union ) );
+                uNumPairs += Union.size();
+
+                const unsigned uStartX = ( uTile % uNumTilesX )*CPU_CULLING_TILE_RES;
+                const unsigned uStartY = ( uTile / uNumTilesX )*CPU_CULLING_TILE_RES;
+                const unsigned uEndX = std::min( uStartX + CPU_CULLING_TILE_RES, Scene.uWidth );
+                const unsigned uEndY = std::min( uStartY + CPU_CULLING_TILE_RES, Scene.uHeight );
+
+                for( size_t i = 0; i < Union.size(); i++ )
+                {
+                    bool bLit = false;
+                    for( unsigned y = uStartY; y < uEndY && !bLit; y++ )
+                    {
+                        for( unsigned x = uStartX; x < uEndX && !bLit; x++ )
+                        {
+                            const float fDepth = Scene.Depth[( (size_t)y*Scene.uWidth + x )*Scene.uNumSamples];
+                            if( fDepth == 0.0f )
+                            {
+                                continue;
+                            }
+
+                            const float fViewZ = CPULightCuller::ConvertProjDepthToView( Input.mProjectionInv, fDepth );
+                            const float fNdcX = ( x + 0.5f ) / Scene.uWidth * 2.0f - 1.0f;
+                            const float fNdcY = 1.0f - ( y + 0.5f ) / Scene.uHeight * 2.0f;
+                            const float Pos[3] = { fNdcX*Input.mProjectionInv.m[0][0]*fViewZ, fNdcY*Input.mProjectionInv.m[1][1]*fViewZ, fViewZ };
+                            bLit = IsPointInSpotCone( Cones, Union[i], Pos, 1.0f );
+                        }
+                    }
+
+                    if( !bLit )
+                    {
+                        uNumFalsePositives++;
+                    }
+                }
+            }
+
+            // brute force on a sparse grid of pixels
+            unsigned long long uNumMissing = 0;
+            for( unsigned y = 4; y < Scene.uHeight; y += 8 )
+            {
+                for( unsigned x = 4; x < Scene.uWidth; x += 8 )
+                {
+                    const float fDepth = Scene.Depth[( (size_t)y*Scene.uWidth + x )*Scene.uNumSamples];
+                    if( fDepth == 0.0f )
+                    {
+                        continue;
+                    }
+
+                    const float fViewZ = CPULightCuller::ConvertProjDepthToView( Input.mProjectionInv, fDepth );
+                    const float fNdcX = ( x + 0.5f ) / Scene.uWidth * 2.0f - 1.0f;
+                    const float fNdcY = 1.0f - ( y + 0.5f ) / Scene.uHeight * 2.0f;
+                    const float Pos[3] = { fNdcX*Input.mProjectionInv.m[0][0]*fViewZ, fNdcY*Input.mProjectionInv.m[1][1]*fViewZ, fViewZ };
+
+                    const unsigned uTile = ( x / CPU_CULLING_TILE_RES ) + ( y / CPU_CULLING_TILE_RES )*uNumTilesX;
+                    const bool bListA = fViewZ < Frusta[uTile].fHalfZ;
+                    const unsigned short* pList = bListA ? &ListsA[(size_t)uTile*uListSize] : &ListsB[(size_t)uTile*uListSize];
+                    const unsigned uCount = bListA ? CountsA[uTile] : CountsB[uTile];
+
+                    for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+                    {
+                        if( IsPointInSpotCone( Cones, uLight, Pos, 0.99f ) && !ListContains( pList, uCount, uLight ) )
+                        {
+                            uNumMissing++;
+                        }
+                    }
+                }
+            }
+
+            if( nMode == CPU_SPOT_CULLING_SPHERE )
+            {
+                uSphereFalsePositives = uNumFalsePositives;
+            }
+            bResult = bResult && ( uNumMissing == 0 );
+
+            fprintf( pReport, "%-12s %10.3f %12.2f %14llu %16llu %9.1f%% %8llu  %s\n",
+                GetCPUSpotCullingModeName( (CPUSpotCullingMode)nMode ), fTime*1000.0, (double)uNumIndices / uNumTiles, uNumPairs, uNumFalsePositives,
+                uSphereFalsePositives ? 100.0*( 1.0 - (double)uNumFalsePositives / uSphereFalsePositives ) : 0.0,
+                uNumMissing, GetCheckResult( uNumMissing == 0 ) );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Compacted lists: checks them against the fixed layout lists at every tile, then
+    // compares the memory of both layouts at 1080p, 1440p and 4K, and finally runs with
+    // half the pool it needs to exercise the overflow reporting
+    //--------------------------------------------------------------------------------------
+    static bool CompactListsMatch( const CPUCompactLightLists& Lists, const std::vector<unsigned short>& FixedBuffer, unsigned uNumTiles, unsigned uMaxNumLightsPerTile )
+    {
+        const unsigned uMaxNumElementsPerTile = 2*uMaxNumLightsPerTile + 4;
+        for( unsigned uTile = 0; uTile < uNumTiles; uTile++ )
+        {
+            const unsigned* pInfo = &Lists.TileInfo[4*(size_t)uTile];
+            const unsigned short* pFixed = &FixedBuffer[(size_t)uTile*uMaxNumElementsPerTile];
+
+            // the fixed layout stores the full counts, but only the first uMaxNumLightsPerTile indices
+            if( pInfo[1] != pFixed[2] || pInfo[2] != pFixed[3] ||
+                pInfo[3] != ( ( (unsigned)pFixed[0] << 16 ) | pFixed[1] ) )
+            {
+                return false;
+            }
+
+            const unsigned uNumA = std::min( pInfo[1], uMaxNumLightsPerTile );
+            const unsigned uNumB = std::min( pInfo[2], uMaxNumLightsPerTile );
+            if( ( uNumA && !ElementsMatch( &Lists.Indices[pInfo[0]], pFixed + 4, uNumA ) ) ||
+                ( uNumB && !ElementsMatch( &Lists.Indices[pInfo[0] + pInfo[1]], pFixed + 4 + uMaxNumLightsPerTile, uNumB ) ) )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool RunCompactBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kResolutions[][2] = { { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+
+        fprintf( pReport, "\ncompacted light lists, %u point and %u spot lights, pool sized for measured occupancy + 25%%\n", Config.uNumLights, Config.uNumLights );
+        fprintf( pReport, "%-10s %8s %14s %14s %12s %12s %12s %8s  %s\n", "resolution", "tiles", "fixed MB", "compact MB", "saving", "ms fixed", "ms compact", "overflow", "vs. fixed" );
+
+        bool bResult = true;
+        for( unsigned uRes = 0; uRes < sizeof(kResolutions)/sizeof(kResolutions[0]); uRes++ )
+        {
+            CPUSceneDesc SceneDesc;
+            SceneDesc.uWidth = kResolutions[uRes][0];
+            SceneDesc.uHeight = kResolutions[uRes][1];
+            SceneDesc.uNumSamples = Config.uNumSamples;
+            SceneDesc.uNumPointLights = Config.uNumLights;
+            SceneDesc.uNumSpotLights = Config.uNumLights;
+
+            CPUScene Scene;
+            CreateCPUScene( SceneDesc, Scene );
+
+            CPULightCullingInput Input;
+            FillCPULightCullingInput( Scene, GetMaxNumLightsPerTile( SceneDesc.uHeight ), Input );
+
+            const unsigned uNumTiles = CPULightCuller::GetNumTiles( SceneDesc.uWidth ) * CPULightCuller::GetNumTiles( SceneDesc.uHeight );
+
+            CPULightCuller FixedCuller;
+            CPULightCullingOutput Fixed;
+            const double fFixedTime = TimeCullLights( FixedCuller, Input, Fixed, &Scheduler, Config.uNumFrames );
+            const CPULightCullingStats& FixedStats = FixedCuller.GetStats();
+
+            // measure the occupancy with an exact fit, then size the pools from it like an app would
+            CPUCompactLightCuller Culler;
+            CPUCompactLightCullingOutput Output;
+            Culler.CullLights( Input, Output, &Scheduler );
+            const unsigned uPointCapacity = CPUCompactLightCuller::GetPoolCapacityForOccupancy( Culler.GetStats().Point.uNumIndicesRequired );
+            const unsigned uSpotCapacity = CPUCompactLightCuller::GetPoolCapacityForOccupancy( Culler.GetStats().Spot.uNumIndicesRequired );
+            Culler.SetPoolCapacity( std::max( uPointCapacity, uSpotCapacity ) );
+
+            const double fCompactTime = TimeIterations( Config.uNumFrames, [&]()
+            {
+                Culler.CullLights( Input, Output, &Scheduler );
+            } );
+
+            const bool bMatch = CompactListsMatch( Output.PointLists, Fixed.PointIndexBuffer, uNumTiles, Input.uMaxNumLightsPerTile ) &&
+                CompactListsMatch( Output.SpotLists, Fixed.SpotIndexBuffer, uNumTiles, Input.uMaxNumLightsPerTile ) &&
+                Culler.GetStats().Point.uNumIndicesDropped == 0 && Culler.GetStats().Spot.uNumIndicesDropped == 0;
+            bResult = bResult && bMatch;
+
+            const size_t uFixedBytes = 2*CPUCompactLightCuller::GetFixedLayoutSize( uNumTiles, Input.uMaxNumLightsPerTile );
+            const size_t uCompactBytes = 2*CPUCompactLightCuller::GetCompactLayoutSize( uNumTiles, Output.PointLists.uCapacity );
+
+            fprintf( pReport, "%4ux%-5u %8u %14.2f %14.2f %11.1f%% %12.3f %12.3f %8u  %s\n",
+                SceneDesc.uWidth, SceneDesc.uHeight, uNumTiles, uFixedBytes / ( 1024.0*1024.0 ), uCompactBytes / ( 1024.0*1024.0 ),
+                100.0*( 1.0 - (double)uCompactBytes / uFixedBytes ), fFixedTime*1000.0, fCompactTime*1000.0,
+                FixedStats.uNumOverflowedPointTiles + FixedStats.uNumOverflowedSpotTiles,
+                GetMatchResult( bMatch ) );
+
+            // overflow reporting: the last resolution again, with half the pool it needs
+            if( uRes + 1 == sizeof(kResolutions)/sizeof(kResolutions[0]) )
+            {
+                const CPUCompactLightListStats& Needed = Culler.GetStats().Point;
+                const unsigned uHalfCapacity = (unsigned)( Needed.uNumIndicesRequired / 2 );
+                Culler.SetPoolCapacity( uHalfCapacity );
+                const unsigned long long uNumRequired = Needed.uNumIndicesRequired;
+                Culler.CullLights( Input, Output, &Scheduler );
+
+                const CPUCompactLightListStats& Stats = Culler.GetStats().Point;
+                const bool bReported = Stats.uNumIndicesDropped == uNumRequired - uHalfCapacity && Stats.uNumTruncatedTiles > 0;
+                bResult = bResult && bReported;
+
+                fprintf( pReport, "%-10s %llu of %llu point light indices dropped from %u tiles with a %u entry pool  %s\n", "overflow",
+                    Stats.uNumIndicesDropped, Stats.uNumIndicesRequired, Stats.uNumTruncatedTiles, uHalfCapacity, GetCheckResult( bReported ) );
+            }
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Incremental culling along scripted paths: the fraction of tiles and lists re-culled
+    // per frame after the first, timing against a full cull of every frame, and a check
+    // against the full cull (identical lists with no depth tolerance, otherwise a
+    // brute-force check that no light touching a pixel is missing from its list)
+    //--------------------------------------------------------------------------------------
+    enum CPUIncrementalPath
+    {
+        CPU_PATH_STATIC = 0,        // nothing changes
+        CPU_PATH_MOVING_LIGHTS,     // 1% of the point and spot lights move every frame
+        CPU_PATH_OCCLUDER,          // an object slides across the screen in front of a static camera
+        CPU_PATH_DEPTH_JITTER,      // tiny depth changes everywhere, every other frame
+        CPU_PATH_PAN_AND_HOLD,      // the camera moves for three frames, then stops
+        CPU_PATH_WALK,              // the camera moves every frame
+    };
+
+    static void ApplyIncrementalPathFrame( CPUIncrementalPath Path, unsigned uFrame, const CPUScene& BaseScene, CPUScene& Scene )
+    {
+        if( uFrame == 0 )
+        {
+            return;
+        }
+
+        switch( Path )
+        {
+        case CPU_PATH_MOVING_LIGHTS:
+            {
+                const unsigned uNumPointMoved = std::max( (unsigned)Scene.PointLightCenterAndRadius.size() / 100, 1u );
+                for( unsigned i = 0; i < uNumPointMoved && !Scene.PointLightCenterAndRadius.empty(); i++ )
+                {
+                    Scene.PointLightCenterAndRadius[( uFrame*uNumPointMoved + i ) % Scene.PointLightCenterAndRadius.size()].x += 20.0f;
+                }
+                const unsigned uNumSpotMoved = std::max( (unsigned)Scene.SpotLightCenterAndRadius.size() / 100, 1u );
+                for( unsigned i = 0; i < uNumSpotMoved && !Scene.SpotLightCenterAndRadius.empty(); i++ )
+                {
+                    Scene.SpotLightCenterAndRadius[( uFrame*uNumSpotMoved + i ) % Scene.SpotLightCenterAndRadius.size()].y += 20.0f;
+                }
+            }
+            break;
+
+        case CPU_PATH_OCCLUDER:
+            {
+                // a 96x96 pixel box, 400 units from the camera
+                const float fDepth = Scene.mProjection.m[2][2] + Scene.mProjection.m[3][2] / 400.0f;
+                const unsigned uStartX = std::min( Scene.uWidth / 4 + uFrame*16, Scene.uWidth );
+                const unsigned uStartY = Scene.uHeight / 2 - std::min( 48u, Scene.uHeight / 2 );
+                const unsigned uEndX = std::min( uStartX + 96, Scene.uWidth );
+                const unsigned uEndY = std::min( uStartY + 96, Scene.uHeight );
+
+                Scene.Depth = BaseScene.Depth;
+                for( unsigned y = uStartY; y < uEndY; y++ )
+                {
+                    for( size_t i = ( (size_t)y*Scene.uWidth + uStartX )*Scene.uNumSamples; i < ( (size_t)y*Scene.uWidth + uEndX )*Scene.uNumSamples; i++ )
+                    {
+                        Scene.Depth[i] = std::max( Scene.Depth[i], fDepth );
+                    }
+                }
+            }
+            break;
+
+        case CPU_PATH_DEPTH_JITTER:
+            {
+                const float fScale = ( uFrame & 1 ) ? 1.00001f : 1.0f;
+                for( size_t i = 0; i < Scene.Depth.size(); i++ )
+                {
+                    Scene.Depth[i] = BaseScene.Depth[i]*fScale;
+                }
+            }
+            break;
+
+        case CPU_PATH_PAN_AND_HOLD:
+        case CPU_PATH_WALK:
+            if( Path == CPU_PATH_WALK || uFrame <= 3 )
+            {
+                const float Eye[3] = { BaseScene.EyePt.x + 40.0f*uFrame, BaseScene.EyePt.y, BaseScene.EyePt.z + 10.0f*uFrame };
+                const float At[3] = { BaseScene.LookAtPt.x, BaseScene.LookAtPt.y, BaseScene.LookAtPt.z };
+                SetCPUSceneCamera( Scene, Eye, At );
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // Lights touching a pixel on a sparse grid but missing from its list
+    static unsigned long long CountMissingLights( const CPUScene& Scene, const CPULightCullingInput& Input, const CPULightCullingOutput& Output, unsigned uSpacing )
+    {
+        unsigned long long uNumMissing = 0;
+        for( unsigned y = uSpacing / 2; y < Scene.uHeight; y += uSpacing )
+        {
+            for( unsigned x = uSpacing / 2; x < Scene.uWidth; x += uSpacing )
+            {
+                const float fDepth = Scene.Depth[( (size_t)y*Scene.uWidth + x )*Scene.uNumSamples];
+                if( fDepth == 0.0f )
+                {
+                    continue;
+                }
+
+                const float fViewZ = CPULightCuller::ConvertProjDepthToView( Input.mProjectionInv, fDepth );
+                const float fNdcX = ( x + 0.5f ) / Scene.uWidth * 2.0f - 1.0f;
+                const float fNdcY = 1.0f - ( y + 0.5f ) / Scene.uHeight * 2.0f;
+                const float Pos[3] = { fNdcX*Input.mProjectionInv.m[0][0]*fViewZ, fNdcY*Input.mProjectionInv.m[1][1]*fViewZ, fViewZ };
+
+                const std::vector<CPUFloat4>* pLights[2] = { &Scene.PointLightCenterAndRadius, &Scene.SpotLightCenterAndRadius };
+                const std::vector<unsigned short>* pBuffers[2] = { &Output.PointIndexBuffer, &Output.SpotIndexBuffer };
+                for( int nType = 0; nType < 2; nType++ )
+                {
+                    unsigned uFirst, uNum;
+                    CPULightCuller::GetLightListInfo( &( *pBuffers[nType] )[0], Output.uNumTilesX, Input.uMaxNumLightsPerTile, x, y, fViewZ, uFirst, uNum, Output.uTileRes );
+                    const unsigned short* pList = &( *pBuffers[nType] )[uFirst];
+
+                    for( unsigned uLight = 0; uLight < pLights[nType]->size(); uLight++ )
+                    {
+                        if( LightTouchesPoint( Input.mView, ( *pLights[nType] )[uLight], Pos ) && !ListContains( pList, uNum, uLight ) )
+                        {
+                            uNumMissing++;
+                        }
+                    }
+                }
+            }
+        }
+
+        return uNumMissing;
+    }
+
+    static bool RunIncrementalBenchmark( FILE* pReport, const CPUScene& BaseScene, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned NUM_PATH_FRAMES = 12;
+
+        struct PathDesc
+        {
+            const char*         pName;
+            CPUIncrementalPath  Path;
+            float               fTolerance;
+        };
+        static const PathDesc kPaths[] =
+        {
+            { "static",        CPU_PATH_STATIC,        0.0f },
+            { "moving lights", CPU_PATH_MOVING_LIGHTS, 0.0f },
+            { "occluder",      CPU_PATH_OCCLUDER,      0.0f },
+            { "depth jitter",  CPU_PATH_DEPTH_JITTER,  0.0f },
+            { "depth jitter",  CPU_PATH_DEPTH_JITTER,  1.0f },
+            { "pan and hold",  CPU_PATH_PAN_AND_HOLD,  0.0f },
+            { "walk",          CPU_PATH_WALK,          0.0f },
+        };
+
+        fprintf( pReport, "\nincremental culling, %u frame scripted paths; re-culled fractions are averaged over the frames after the first\n", NUM_PATH_FRAMES );
+        fprintf( pReport, "%-14s %9s %12s %12s %9s %15s %15s  %s\n", "path", "tolerance", "ms/frame", "full ms/frame", "speedup", "re-culled tiles", "re-culled lists", "vs. full cull" );
+
+        bool bResult = true;
+        for( size_t p = 0; p < sizeof(kPaths)/sizeof(kPaths[0]); p++ )
+        {
+            const PathDesc& Desc = kPaths[p];
+
+            CPUScene Scene = BaseScene;
+            CPULightCullingInput Input;
+            CPUIncrementalLightCuller Incremental;
+            Incremental.SetDepthTolerance( Desc.fTolerance );
+            CPULightCuller Full;
+            CPULightCullingOutput IncrementalOutput, FullOutput;
+
+            double fIncrementalTime = 0.0, fFullTime = 0.0;
+            unsigned long long uNumDirtyTiles = 0, uNumDirtyLists = 0, uNumTiles = 0, uNumMissing = 0;
+            bool bMatch = true;
+
+            for( unsigned uFrame = 0; uFrame < NUM_PATH_FRAMES; uFrame++ )
+            {
+                ApplyIncrementalPathFrame( Desc.Path, uFrame, BaseScene, Scene );
+                FillCPULightCullingInput( Scene, GetMaxNumLightsPerTile( Scene.uHeight ), Input );
+
+                CPUBenchmarkTimer Timer;
+                Incremental.CullLights( Input, IncrementalOutput, &Scheduler );
+                const double fFrameIncrementalTime = Timer.GetSeconds();
+                Timer.Restart();
+                Full.CullLights( Input, FullOutput, &Scheduler );
+                const double fFrameFullTime = Timer.GetSeconds();
+
+                if( Desc.fTolerance == 0.0f )
+                {
+                    bMatch = bMatch && OutputsMatch( IncrementalOutput, FullOutput );
+                }
+                else
+                {
+                    uNumMissing += CountMissingLights( Scene, Input, IncrementalOutput, 32 );
+                }
+
+                // the first frame is always a full cull
+                if( uFrame > 0 )
+                {
+                    const CPUIncrementalCullingStats& Stats = Incremental.GetStats();
+                    fIncrementalTime += fFrameIncrementalTime;
+                    fFullTime += fFrameFullTime;
+                    uNumDirtyTiles += Stats.uNumDirtyTiles;
+                    uNumDirtyLists += Stats.uNumDirtyLists;
+                    uNumTiles += Stats.uNumTiles;
+                }
+            }
+
+            bMatch = bMatch && ( uNumMissing == 0 );
+            bResult = bResult && bMatch;
+
+            // two light types without VPLs
+            fprintf( pReport, "%-14s %9.1f %12.3f %12.3f %8.2fx %14.1f%% %14.1f%%  %s",
+                Desc.pName, Desc.fTolerance, fIncrementalTime*1000.0 / ( NUM_PATH_FRAMES - 1 ), fFullTime*1000.0 / ( NUM_PATH_FRAMES - 1 ),
+                fIncrementalTime > 0.0 ? fFullTime / fIncrementalTime : 0.0,
+                100.0*uNumDirtyTiles / uNumTiles, 100.0*uNumDirtyLists / ( 2*uNumTiles ),
+                Desc.fTolerance == 0.0f ? GetMatchResult( bMatch ) : ( bMatch ? "superset" : "FAILED" ) );
+            if( Desc.fTolerance != 0.0f )
+            {
+                fprintf( pReport, " (%llu lights missing on a sparse pixel grid)", uNumMissing );
+            }
+            fprintf( pReport, "\n" );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Hierarchical culling: the light tests of the coarse and fine passes against a flat
+    // cull's, and the time, for a few light counts and super-tile sizes
+    //--------------------------------------------------------------------------------------
+    static bool RunHierarchicalBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kNumLights[] = { 1024, 4096, 16384 };
+        static const unsigned kFactors[] = { 2, 4, 8 };
+
+        fprintf( pReport, "\nhierarchical culling, point and spot lights in equal numbers, %u threads; tests are light vs. tile or super-tile tests per frame\n", Scheduler.GetNumThreads() );
+        fprintf( pReport, "%7s %11s %8s %14s %14s %14s %14s %10s %10s %9s  %s\n",
+            "lights", "super-tile", "empty", "coarse tests", "intermediate", "fine tests", "flat tests", "ms flat", "ms hier.", "speedup", "vs. flat" );
+
+        bool bResult = true;
+        for( unsigned uLights = 0; uLights < sizeof(kNumLights)/sizeof(kNumLights[0]); uLights++ )
+        {
+            CPUSceneDesc SceneDesc;
+            SceneDesc.uWidth = Config.uWidth;
+            SceneDesc.uHeight = Config.uHeight;
+            SceneDesc.uNumSamples = Config.uNumSamples;
+            SceneDesc.uNumPointLights = kNumLights[uLights];
+            SceneDesc.uNumSpotLights = kNumLights[uLights];
+            SceneDesc.fLightRadiusScale = powf( 1024.0f / kNumLights[uLights], 1.0f/3.0f );
+
+            CPUScene Scene;
+            CreateCPUScene( SceneDesc, Scene );
+
+            CPULightCullingInput Input;
+            FillCPULightCullingInput( Scene, GetMaxNumLightsPerTile( SceneDesc.uHeight ), Input );
+
+            CPULightCuller Flat;
+            CPULightCullingOutput FlatOutput;
+            const double fFlatTime = TimeCullLights( Flat, Input, FlatOutput, &Scheduler, Config.uNumFrames );
+            const unsigned long long uNumFlatTests = (unsigned long long)FlatOutput.uNumTilesX*FlatOutput.uNumTilesY*( Input.uNumPointLights + Input.uNumSpotLights );
+
+            for( unsigned uFactor = 0; uFactor < sizeof(kFactors)/sizeof(kFactors[0]); uFactor++ )
+            {
+                CPUHierarchicalLightCuller Hierarchical;
+                Hierarchical.SetSuperTileFactor( kFactors[uFactor] );
+                CPULightCullingOutput Output;
+                const double fTime = TimeCullLights( Hierarchical, Input, Output, &Scheduler, Config.uNumFrames );
+                const CPUHierarchicalCullingStats& Stats = Hierarchical.GetStats();
+
+                const bool bMatch = OutputsMatch( Output, FlatOutput );
+                bResult = bResult && bMatch;
+
+                fprintf( pReport, "%7u %4ux%-3u px %8u %14llu %14llu %14llu %14llu %10.3f %10.3f %8.2fx  %s\n",
+                    kNumLights[uLights], kFactors[uFactor]*Input.uTileRes, kFactors[uFactor]*Input.uTileRes, Stats.uNumEmptySuperTiles,
+                    Stats.Point.uNumCoarseTests + Stats.Spot.uNumCoarseTests, Stats.Point.uNumCoarseIndices + Stats.Spot.uNumCoarseIndices,
+                    Stats.Point.uNumFineTests + Stats.Spot.uNumFineTests, uNumFlatTests,
+                    fFlatTime*1000.0, fTime*1000.0, fTime > 0.0 ? fFlatTime / fTime : 0.0, GetMatchResult( bMatch ) );
+            }
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Tile size sweep: culling time, the average number of point and spot lights a pixel
+    // loops over, overflowed tiles and index buffer memory for each tile size in g_nTileRes,
+    // over a few resolutions and light counts
+    //--------------------------------------------------------------------------------------
+    static double GetAverageLightsPerPixel( const CPUScene& Scene, const CPULightCullingInput& Input, const CPULightCullingOutput& Output )
+    {
+        const std::vector<unsigned short>* pBuffers[2] = { &Output.PointIndexBuffer, &Output.SpotIndexBuffer };
+        unsigned long long uNumPixels = 0, uNumLights = 0;
+
+        for( unsigned y = 0; y < Scene.uHeight; y++ )
+        {
+            for( unsigned x = 0; x < Scene.uWidth; x++ )
+            {
+                const float fDepth = Scene.Depth[( (size_t)y*Scene.uWidth + x )*Scene.uNumSamples];
+                if( fDepth == 0.0f )
+                {
+                    continue;
+                }
+
+                const float fViewZ = CPULightCuller::ConvertProjDepthToView( Input.mProjectionInv, fDepth );
+                for( int nType = 0; nType < 2; nType++ )
+                {
+                    unsigned uFirst, uNum;
+                    CPULightCuller::GetLightListInfo( &( *pBuffers[nType] )[0], Output.uNumTilesX, Input.uMaxNumLightsPerTile, x, y, fViewZ, uFirst, uNum, Output.uTileRes );
+                    uNumLights += std::min( uNum, Input.uMaxNumLightsPerTile );
+                }
+                uNumPixels++;
+            }
+        }
+
+        return uNumPixels ? (double)uNumLights / uNumPixels : 0.0;
+    }
+
+    static bool RunTileSizeSweep( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kResolutions[][2] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 } };
+        static const unsigned kNumLights[] = { 1024, 4096 };
+
+        fprintf( pReport, "\ntile size sweep, point and spot lights in equal numbers, lights per pixel is the point + spot list length a pixel loops over\n" );
+        fprintf( pReport, "%-10s %7s %6s %8s %12s %16s %10s %12s  %s\n", "resolution", "lights", "tile", "tiles", "ms/frame", "lights/pixel", "overflow", "buffers MB", "vs. brute force" );
+
+        bool bResult = true;
+        for( unsigned uRes = 0; uRes < sizeof(kResolutions)/sizeof(kResolutions[0]); uRes++ )
+        {
+            for( unsigned uLights = 0; uLights < sizeof(kNumLights)/sizeof(kNumLights[0]); uLights++ )
+            {
+                CPUSceneDesc SceneDesc;
+                SceneDesc.uWidth = kResolutions[uRes][0];
+                SceneDesc.uHeight = kResolutions[uRes][1];
+                SceneDesc.uNumSamples = Config.uNumSamples;
+                SceneDesc.uNumPointLights = kNumLights[uLights];
+                SceneDesc.uNumSpotLights = kNumLights[uLights];
+
+                CPUScene Scene;
+                CreateCPUScene( SceneDesc, Scene );
+
+                CPULightCullingInput Input;
+                FillCPULightCullingInput( Scene, GetMaxNumLightsPerTile( SceneDesc.uHeight ), Input );
+
+                for( unsigned uTileRes = 0; uTileRes < NUM_TILE_RES_SETTINGS; uTileRes++ )
+                {
+                    Input.uTileRes = (unsigned)g_nTileRes[uTileRes];
+
+                    CPULightCuller Culler;
+                    CPULightCullingOutput Output;
+                    const double fTime = TimeCullLights( Culler, Input, Output, &Scheduler, Config.uNumFrames );
+                    const CPULightCullingStats& Stats = Culler.GetStats();
+
+                    // lights dropped by overflowing tiles are expected to be missing, so only check without overflow
+                    const unsigned uNumOverflowed = Stats.uNumOverflowedPointTiles + Stats.uNumOverflowedSpotTiles;
+                    const unsigned long long uNumMissing = CountMissingLights( Scene, Input, Output, 32 );
+                    const bool bOk = ( uNumOverflowed > 0 ) || ( uNumMissing == 0 );
+                    bResult = bResult && bOk;
+
+                    const size_t uNumBytes = ( Output.PointIndexBuffer.size() + Output.SpotIndexBuffer.size() )*sizeof(unsigned short);
+
+                    fprintf( pReport, "%4ux%-5u %7u %3ux%-2u %8u %12.3f %16.2f %10u %12.2f  ",
+                        SceneDesc.uWidth, SceneDesc.uHeight, kNumLights[uLights], (unsigned)g_nTileRes[uTileRes], (unsigned)g_nTileRes[uTileRes],
+                        Output.uNumTilesX*Output.uNumTilesY, fTime*1000.0, GetAverageLightsPerPixel( Scene, Input, Output ),
+                        uNumOverflowed, uNumBytes / ( 1024.0*1024.0 ) );
+                    if( uNumOverflowed > 0 )
+                    {
+                        fprintf( pReport, "%llu missing (overflow)\n", uNumMissing );
+                    }
+                    else
+                    {
+                        fprintf( pReport, "%s\n", bOk ? "ok" : "MISSING LIGHTS" );
+                    }
+                }
+            }
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Light list occupancy: how long the point and spot lists get, against the list size that
+    // GetMaxNumLightsPerTile picks from the screen height, over a few resolutions and light
+    // counts. The telemetry must agree with the culler's own counts.
+    //--------------------------------------------------------------------------------------
+    static bool RunOccupancyReport( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kResolutions[][2] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 } };
+        static const unsigned kNumLights[] = { 1024, 4096, 16384 };
+
+        FILE* pTelemetry = NULL;
+        bool bJSON = false;
+        if( !Config.TelemetryPath.empty() )
+        {
+            pTelemetry = OpenReport( Config.TelemetryPath );
+            if( pTelemetry == NULL )
+            {
+                fprintf( pReport, "\ncould not open %s for the light list telemetry\n", Config.TelemetryPath.c_str() );
+                return false;
+            }
+
+            const size_t uLength = Config.TelemetryPath.size();
+            bJSON = ( uLength >= 5 && Config.TelemetryPath.compare( uLength - 5, 5, ".json" ) == 0 );
+            if( !bJSON )
+            {
+                WriteLightListTelemetryCSVHeader( pTelemetry );
+            }
+        }
+
+        fprintf( pReport, "\nlight list occupancy, point and spot lights in equal numbers, lengths are per list (two per tile) before clamping to the list size\n" );
+        fprintf( pReport, "%-10s %7s %6s %10s %8s %6s %6s %6s %6s %10s  %s\n", "resolution", "lights", "type", "list size", "mean", "p50", "p95", "p99", "max", "overflow", "vs. culler stats" );
+
+        bool bResult = true;
+        unsigned uFrame = 0;
+        for( unsigned uRes = 0; uRes < sizeof(kResolutions)/sizeof(kResolutions[0]); uRes++ )
+        {
+            for( unsigned uLights = 0; uLights < sizeof(kNumLights)/sizeof(kNumLights[0]); uLights++ )
+            {
+                CPUSceneDesc SceneDesc;
+                SceneDesc.uWidth = kResolutions[uRes][0];
+                SceneDesc.uHeight = kResolutions[uRes][1];
+                SceneDesc.uNumSamples = Config.uNumSamples;
+                SceneDesc.uNumPointLights = kNumLights[uLights];
+                SceneDesc.uNumSpotLights = kNumLights[uLights];
+
+                CPUScene Scene;
+                CreateCPUScene( SceneDesc, Scene );
+
+                CPULightCullingInput Input;
+                FillCPULightCullingInput( Scene, GetMaxNumLightsPerTile( SceneDesc.uHeight ), Input );
+
+                CPULightCuller Culler;
+                CPULightCullingOutput Output;
+                Culler.CullLights( Input, Output, &Scheduler );
+                const CPULightCullingStats& Stats = Culler.GetStats();
+
+                CPULightListTelemetry Telemetry;
+                Telemetry.uFrame = uFrame++;
+                GatherLightListTelemetry( Input, Output, Telemetry );
+
+                const CPULightListOccupancy* pTypes[2] = { &Telemetry.Point, &Telemetry.Spot };
+                const unsigned long long uNumIndices[2] = { Stats.uNumPointIndices, Stats.uNumSpotIndices };
+                const unsigned uNumOverflowedTiles[2] = { Stats.uNumOverflowedPointTiles, Stats.uNumOverflowedSpotTiles };
+                static const char* const kTypeNames[2] = { "point", "spot" };
+
+                for( int nType = 0; nType < 2; nType++ )
+                {
+                    const CPULightListOccupancy& Occupancy = *pTypes[nType];
+                    const bool bMatch = ( Occupancy.uNumEntries == uNumIndices[nType] ) && ( Occupancy.uNumOverflowedTiles == uNumOverflowedTiles[nType] );
+                    bResult = bResult && bMatch;
+
+                    fprintf( pReport, "%4ux%-5u %7u %6s %10u %8.2f %6u %6u %6u %6u %10u  %s\n",
+                        SceneDesc.uWidth, SceneDesc.uHeight, kNumLights[uLights], kTypeNames[nType], Occupancy.uListSize,
+                        (double)Occupancy.uNumEntries / Occupancy.uNumLists, Occupancy.uP50, Occupancy.uP95, Occupancy.uP99, Occupancy.uMaxLength,
+                        Occupancy.uNumOverflowedTiles, bMatch ? "ok" : "MISMATCH" );
+                }
+
+                if( pTelemetry != NULL )
+                {
+                    if( bJSON )
+                    {
+                        WriteLightListTelemetryJSON( pTelemetry, Telemetry );
+                    }
+                    else
+                    {
+                        WriteLightListTelemetryCSV( pTelemetry, Telemetry );
+                    }
+                }
+            }
+        }
+
+        if( pTelemetry != NULL && pTelemetry != stdout )
+        {
+            fclose( pTelemetry );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Light culling: the culler at every SIMD level and thread count against the oracle,
+    // then the other culling modes
+    //--------------------------------------------------------------------------------------
+    bool RunLightCullingBenchmarks( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        bool bResult = true;
+
+        CPUSceneDesc SceneDesc;
+        SceneDesc.uWidth = Config.uWidth;
+        SceneDesc.uHeight = Config.uHeight;
+        SceneDesc.uNumSamples = Config.uNumSamples;
+        SceneDesc.uNumPointLights = Config.uNumLights;
+        SceneDesc.uNumSpotLights = Config.uNumLights;
+
+        CPUScene Scene;
+        CreateCPUScene( SceneDesc, Scene );
+
+        CPULightCullingInput Input;
+        FillCPULightCullingInput( Scene, GetMaxNumLightsPerTile( Config.uHeight ), Input );
+
+        const unsigned uMaxNumThreads = Scheduler.GetNumThreads();
+
+        const unsigned uNumTiles = CPULightCuller::GetNumTiles( Config.uWidth ) * CPULightCuller::GetNumTiles( Config.uHeight );
+        const double fNumLightTileTests = (double)uNumTiles * ( Input.uNumPointLights + Input.uNumSpotLights );
+
+        fprintf( pReport, "TiledLighting11 CPU light culling benchmark\n" );
+        fprintf( pReport, "resolution %ux%u, %ux MSAA, %u tiles, %u point lights, %u spot lights, %u max lights per tile\n",
+            Config.uWidth, Config.uHeight, Config.uNumSamples, uNumTiles, Input.uNumPointLights, Input.uNumSpotLights, Input.uMaxNumLightsPerTile );
+        fprintf( pReport, "detected SIMD level %s, %u frames per configuration\n\n", GetCPUSIMDLevelName( GetCPUSIMDLevel() ), Config.uNumFrames );
+
+        // the oracle: scalar, on the calling thread
+        CPULightCuller Culler;
+        Culler.SetSIMDLevel( CPU_SIMD_SCALAR );
+        CPULightCullingOutput Oracle;
+        const double fOracleTime = TimeCullLights( Culler, Input, Oracle, NULL, Config.uNumFrames );
+        const CPULightCullingStats OracleStats = Culler.GetStats();
+
+        fprintf( pReport, "avg lights per tile: %.2f point, %.2f spot; overflowed tiles: %u point, %u spot\n\n",
+            (double)OracleStats.uNumPointIndices / uNumTiles, (double)OracleStats.uNumSpotIndices / uNumTiles,
+            OracleStats.uNumOverflowedPointTiles, OracleStats.uNumOverflowedSpotTiles );
+
+        // "light-tile tests/s" counts one sphere vs. tile test per light per tile
+        fprintf( pReport, "%-8s %8s %12s %14s %20s %9s  %s\n", "SIMD", "threads", "ms/frame", "tiles/s", "light-tile tests/s", "speedup", "vs. oracle" );
+
+        CPULightCullingOutput Output;
+        for( int nLevel = CPU_SIMD_SCALAR; nLevel <= (int)GetCPUSIMDLevel(); nLevel++ )
+        {
+            Culler.SetSIMDLevel( (CPUSIMDLevel)nLevel );
+
+            for( unsigned uNumThreads = 1; ; uNumThreads = ( uNumThreads*2 > uMaxNumThreads ) ? uMaxNumThreads : uNumThreads*2 )
+            {
+                CPUTaskScheduler SweepScheduler( uNumThreads );
+                const double fTime = TimeCullLights( Culler, Input, Output, &SweepScheduler, Config.uNumFrames );
+
+                const bool bMatch = OutputsMatch( Output, Oracle );
+                if( !bMatch )
+                {
+                    bResult = false;
+                }
+
+                fprintf( pReport, "%-8s %8u %12.3f %14.0f %20.0f %8.2fx  %s",
+                    GetCPUSIMDLevelName( (CPUSIMDLevel)nLevel ), uNumThreads, fTime*1000.0, uNumTiles / fTime, fNumLightTileTests / fTime,
+                    fOracleTime / fTime, GetMatchResult( bMatch ) );
+                if( !bMatch )
+                {
+                    fprintf( pReport, " (point lists differ from tile %u, spot lists from tile %u)",
+                        CPULightCuller::CompareIndexBuffers( &Output.PointIndexBuffer[0], &Oracle.PointIndexBuffer[0], uNumTiles, Input.uMaxNumLightsPerTile ),
+                        CPULightCuller::CompareIndexBuffers( &Output.SpotIndexBuffer[0], &Oracle.SpotIndexBuffer[0], uNumTiles, Input.uMaxNumLightsPerTile ) );
+                }
+                fprintf( pReport, "\n" );
+
+                if( uNumThreads == uMaxNumThreads )
+                {
+                    break;
+                }
+            }
+        }
+
+        if( !RunClusteredBenchmark( pReport, Config, Scene, Input, Oracle, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunZBinnedBenchmark( pReport, Config, Scene, Input, Oracle, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunSpotCullingBenchmark( pReport, Config, Scene, Input, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunCompactBenchmark( pReport, Config, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunLightBVHBenchmark( pReport, Config, Input, Oracle, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunIncrementalBenchmark( pReport, Scene, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunHierarchicalBenchmark( pReport, Config, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunTileSizeSweep( pReport, Config, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunOccupancyReport( pReport, Config, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        return bResult;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,879 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUBenchmarkLights.cpp
+//
+// The lights part of the headless CPU benchmark: light pools, animation, light set files,
+// quantized lights and procedural light generation.
+//--------------------------------------------------------------------------------------
+
+#include "CPUBenchmarkUtil.h"
+#include "CPULightAnimation.h"
+#include "CPULightGeneration.h"
+#include "CPULightPool.h"
+#include "CPULightSet.h"
+#include "CPUQuantizedLights.h"
+#include "CPUSpotLightCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace TiledLighting11
+{
+    //--------------------------------------------------------------------------------------
+    // Light pool: 100k operations per frame on a pool of point lights (center and radius,
+    // color). The dirty ranges of every frame are copied into a mirror of the attribute
+    // arrays, which stands in for the GPU buffers. The pool is checked against a reference
+    // rebuilt from a log of the operations, and the mirror against the pool.
+    //--------------------------------------------------------------------------------------
+    enum CPULightPoolPattern
+    {
+        CPU_POOL_SCATTERED = 0,     // updates to random lights
+        CPU_POOL_WINDOW,            // updates to a window of 2048 lights
+        CPU_POOL_CHURN,             // 5% adds, 5% removes, the rest updates to random lights
+    };
+
+    struct CPULightPoolOp
+    {
+        enum Type { ADD, REMOVE, UPDATE } Op;
+        CPULightHandle  Handle;
+        CPUFloat4       CenterAndRadius;
+        unsigned        uColor;
+    };
+
+    static bool RunLightPoolBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config )
+    {
+        static const unsigned kNumOpsPerFrame = 100000;
+        static const unsigned kNumInitialLights = 32768;
+        static const unsigned kCapacity = 65536;
+        static const unsigned kWindowSize = 2048;
+        static const unsigned kMaxGap = 16;
+        static const char* const kPatternNames[] = { "scattered", "window", "churn" };
+        static const unsigned kAttributeSizes[2] = { sizeof(CPUFloat4), sizeof(unsigned) };
+
+        fprintf( pReport, "\nlight pool, %u operations per frame, %u lights to start with, ranges merged across gaps of up to %u lights\n", kNumOpsPerFrame, kNumInitialLights, kMaxGap );
+        fprintf( pReport, "%-10s %7s %10s %10s %8s %10s %12s %12s  %s\n", "pattern", "lights", "ms ops", "ms ranges", "ranges", "dirty", "upload KB", "full KB", "vs. reference" );
+
+        bool bResult = true;
+        for( int nPattern = CPU_POOL_SCATTERED; nPattern <= CPU_POOL_CHURN; nPattern++ )
+        {
+            unsigned uState = 0x9E3779B9u;
+
+            CPULightPool Pool;
+            Pool.Reset( kCapacity, kAttributeSizes, 2 );
+
+            // the reference, by handle slot, and the mirror of the attribute arrays
+            CPULightPoolOp NoLight;
+            memset( &NoLight, 0, sizeof(NoLight) );
+            NoLight.Handle = CPU_INVALID_LIGHT_HANDLE;
+            std::vector<CPULightPoolOp> Reference( kCapacity, NoLight );
+            std::vector<unsigned char> Mirror[2];
+            for( unsigned i = 0; i < 2; i++ )
+            {
+                Mirror[i].assign( (size_t)kCapacity*kAttributeSizes[i], 0 );
+            }
+
+            std::vector<CPULightPoolOp> Log;
+            Log.reserve( kNumOpsPerFrame + kNumInitialLights );
+            std::vector<CPULightPoolRange> Ranges;
+
+            bool bMatch = true;
+            double fOpsTime = 0.0;
+            double fRangesTime = 0.0;
+            unsigned long long uNumRanges = 0;
+            unsigned long long uNumDirty = 0;
+            unsigned long long uNumUploadBytes = 0;
+            unsigned long long uNumFullBytes = 0;
+
+            // frame 0 fills the pool and is not timed
+            for( unsigned uFrame = 0; uFrame <= Config.uNumFrames; uFrame++ )
+            {
+                Log.clear();
+
+                CPUBenchmarkTimer Timer;
+                const unsigned uNumOps = ( uFrame == 0 ) ? kNumInitialLights : kNumOpsPerFrame;
+                for( unsigned i = 0; i < uNumOps; i++ )
+                {
+                    const unsigned uRandom = GetBenchmarkRandom( uState );
+                    const unsigned uPercent = uRandom % 100;
+
+                    CPULightPoolOp Op;
+                    Op.Op = CPULightPoolOp::UPDATE;
+                    Op.CenterAndRadius.x = (float)( uRandom & 0xFFF );
+                    Op.CenterAndRadius.y = (float)( ( uRandom >> 12 ) & 0xFFF );
+                    Op.CenterAndRadius.z = (float)i;
+                    Op.CenterAndRadius.w = 1.0f + (float)uFrame;
+                    Op.uColor = uRandom;
+
+                    if( uFrame == 0 || ( nPattern == CPU_POOL_CHURN && uPercent < 5 ) )
+                    {
+                        Op.Op = CPULightPoolOp::ADD;
+                        Op.Handle = Pool.Add();
+                        if( Op.Handle == CPU_INVALID_LIGHT_HANDLE )
+                        {
+                            continue;
+                        }
+                        Pool.Set( Op.Handle, 0, &Op.CenterAndRadius );
+                        Pool.Set( Op.Handle, 1, &Op.uColor );
+                    }
+                    else if( Pool.GetCount() == 0 )
+                    {
+                        continue;
+                    }
+                    else if( nPattern == CPU_POOL_CHURN && uPercent < 10 )
+                    {
+                        Op.Op = CPULightPoolOp::REMOVE;
+                        Op.Handle = Pool.GetHandle( GetBenchmarkRandom( uState ) % Pool.GetCount() );
+                        Pool.Remove( Op.Handle );
+                    }
+                    else
+                    {
+                        const unsigned uWindow = ( nPattern == CPU_POOL_WINDOW ) ? std::min( kWindowSize, Pool.GetCount() ) : Pool.GetCount();
+                        const unsigned uWindowStart = ( Pool.GetCount() - uWindow ) / 2;
+                        Op.Handle = Pool.GetHandle( uWindowStart + GetBenchmarkRandom( uState ) % uWindow );
+                        Pool.Set( Op.Handle, 0, &Op.CenterAndRadius );
+                    }
+                    Log.push_back( Op );
+                }
+                const double fFrameOpsTime = Timer.GetSeconds();
+                Timer.Restart();
+
+                // upload: gather every attribute's ranges, and copy them into the mirror
+                unsigned uFrameRanges = 0;
+                unsigned long long uFrameBytes = 0;
+                for( unsigned uAttribute = 0; uAttribute < 2; uAttribute++ )
+                {
+                    uFrameBytes += UploadDirtyRanges( Pool, uAttribute, kAttributeSizes[uAttribute], kMaxGap, Ranges, Mirror[uAttribute] );
+                    uFrameRanges += (unsigned)Ranges.size();
+                    if( uFrame > 0 )
+                    {
+                        uNumDirty += Pool.GetNumDirty( uAttribute );
+                    }
+                }
+                Pool.ClearDirtyRanges();
+                const double fFrameRangesTime = Timer.GetSeconds();
+
+                if( uFrame > 0 )
+                {
+                    fOpsTime += fFrameOpsTime;
+                    fRangesTime += fFrameRangesTime;
+                    uNumRanges += uFrameRanges;
+                    uNumUploadBytes += uFrameBytes;
+                    uNumFullBytes += (unsigned long long)Pool.GetCount()*( kAttributeSizes[0] + kAttributeSizes[1] );
+                }
+
+                // replay the log on the reference
+                std::vector<CPULightHandle> RemovedHandles;
+                for( size_t i = 0; i < Log.size(); i++ )
+                {
+                    const CPULightPoolOp& Op = Log[i];
+                    CPULightPoolOp& Light = Reference[Op.Handle & ( CPULightPool::MAX_CAPACITY - 1 )];
+                    if( Op.Op == CPULightPoolOp::REMOVE )
+                    {
+                        Light.Handle = CPU_INVALID_LIGHT_HANDLE;
+                        RemovedHandles.push_back( Op.Handle );
+                    }
+                    else if( Op.Op == CPULightPoolOp::ADD )
+                    {
+                        Light = Op;
+                    }
+                    else
+                    {
+                        Light.CenterAndRadius = Op.CenterAndRadius;
+                    }
+                }
+
+                // every light of the reference is in the pool with the same attributes
+                unsigned uNumLights = 0;
+                for( unsigned uSlot = 0; uSlot < kCapacity; uSlot++ )
+                {
+                    const CPULightPoolOp& Light = Reference[uSlot];
+                    if( Light.Handle == CPU_INVALID_LIGHT_HANDLE )
+                    {
+                        continue;
+                    }
+                    uNumLights++;
+                    bMatch = bMatch && Pool.IsValid( Light.Handle ) &&
+                        memcmp( Pool.Get( Light.Handle, 0 ), &Light.CenterAndRadius, sizeof(CPUFloat4) ) == 0 &&
+                        memcmp( Pool.Get( Light.Handle, 1 ), &Light.uColor, sizeof(unsigned) ) == 0 &&
+                        Pool.GetHandle( Pool.GetDenseIndex( Light.Handle ) ) == Light.Handle;
+                }
+                bMatch = bMatch && ( uNumLights == Pool.GetCount() );
+
+                // removed handles stay invalid, even when their slot was reused
+                for( size_t i = 0; i < RemovedHandles.size(); i++ )
+                {
+                    bMatch = bMatch && !Pool.IsValid( RemovedHandles[i] );
+                }
+
+                // the uploads brought the mirror up to date
+                for( unsigned uAttribute = 0; uAttribute < 2; uAttribute++ )
+                {
+                    bMatch = bMatch && ElementsMatch( &Mirror[uAttribute][0], (const unsigned char*)Pool.GetData( uAttribute ), (size_t)Pool.GetCount()*kAttributeSizes[uAttribute] );
+                }
+            }
+            bResult = bResult && bMatch;
+
+            const unsigned uNumFrames = std::max( Config.uNumFrames, 1u );
+            fprintf( pReport, "%-10s %7u %10.3f %10.3f %8.0f %10.0f %12.1f %12.1f  %s\n",
+                kPatternNames[nPattern], Pool.GetCount(), fOpsTime*1000.0 / uNumFrames, fRangesTime*1000.0 / uNumFrames,
+                (double)uNumRanges / uNumFrames, (double)uNumDirty / uNumFrames, uNumUploadBytes / ( 1024.0*uNumFrames ), uNumFullBytes / ( 1024.0*uNumFrames ),
+                bMatch ? "ok" : "MISMATCH" );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Light animation: ns per light for every SIMD level at 2k, 32k and 256k lights, with
+    // the spot light parameters and matrices. The SIMD levels must give the same bits as
+    // the scalar path, which is checked against sinf and cosf.
+    //--------------------------------------------------------------------------------------
+    static bool RunLightAnimationBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kNumLights[] = { 2048, 32768, 262144 };
+        static const float kBBoxMin[3] = { -1000.0f, 0.0f, -500.0f };
+        static const float kBBoxMax[3] = { 1000.0f, 600.0f, 500.0f };
+        static const float kRadius = 25.0f;
+        static const float kTime = 12.345f;
+
+        // the positions move by up to 2.5*kRadius from their pivots
+        static const float kPositionTolerance = 1e-3f;
+        static const float kDirectionTolerance = 1e-4f;
+
+        fprintf( pReport, "\nlight animation, point and spot outputs (center and radius, color, spot params, spot matrix), %u threads\n", Scheduler.GetNumThreads() );
+        fprintf( pReport, "%-8s %7s %10s %12s %9s  %s\n", "SIMD", "lights", "ns/light", "Mlights/s", "speedup", "check" );
+
+        bool bResult = true;
+        for( unsigned uSize = 0; uSize < sizeof(kNumLights)/sizeof(kNumLights[0]); uSize++ )
+        {
+            const unsigned uNumLights = kNumLights[uSize];
+
+            std::vector<CPULightAnimationDesc> Descs;
+            CPULightAnimator::CreateRandomLights( uSize + 1, kBBoxMin, kBBoxMax, kRadius, uNumLights, Descs );
+            CPULightAnimator Animator;
+            Animator.SetLights( &Descs[0], uNumLights );
+
+            std::vector<CPUFloat4> CenterAndRadius[2];
+            std::vector<unsigned> Color[2];
+            std::vector<CPUSpotParams> SpotParams[2];
+            std::vector<CPUMatrix> SpotMatrices[2];
+            for( int i = 0; i < 2; i++ )
+            {
+                CenterAndRadius[i].resize( uNumLights );
+                Color[i].resize( uNumLights );
+                SpotParams[i].resize( uNumLights );
+                SpotMatrices[i].resize( uNumLights );
+            }
+
+            // the scalar results, checked against libm
+            Animator.SetSIMDLevel( CPU_SIMD_SCALAR );
+            Animator.Animate( kTime, &CenterAndRadius[0][0], &Color[0][0], &SpotParams[0][0], &SpotMatrices[0][0], &Scheduler );
+
+            bool bReference = true;
+            for( unsigned i = 0; i < uNumLights; i++ )
+            {
+                const CPULightAnimationDesc& Desc = Descs[i];
+                const float fOrbit = 6.28318530718f*( Desc.fOrbitRate*kTime + Desc.fPhase );
+                const float fBob = 6.28318530718f*( Desc.fBobRate*kTime + Desc.fPhase );
+                const float fFlicker = 6.28318530718f*( Desc.fFlickerRate*kTime + Desc.fPhase );
+                const float fDir = 6.28318530718f*( Desc.fDirRate*kTime + Desc.fPhase );
+                const float fDirXZ = sqrtf( 1.0f - Desc.fDirY*Desc.fDirY );
+                const float Dir[3] = { fDirXZ*cosf( fDir ), Desc.fDirY, fDirXZ*sinf( fDir ) };
+                const float Expected[4] =
+                {
+                    Desc.Pivot[0] + Desc.fOrbitRadius*cosf( fOrbit ),
+                    Desc.Pivot[1] + Desc.fBobHeight*sinf( fBob ),
+                    Desc.Pivot[2] + Desc.fOrbitRadius*sinf( fOrbit ),
+                    Desc.fRadius*( 1.0f + Desc.fFlicker*sinf( fFlicker ) ),
+                };
+                const CPUFloat4& c = CenterAndRadius[0][i];
+                bReference = bReference && fabsf( c.x - Expected[0] ) < kPositionTolerance && fabsf( c.y - Expected[1] ) < kPositionTolerance &&
+                    fabsf( c.z - Expected[2] ) < kPositionTolerance && fabsf( c.w - Expected[3] ) < kPositionTolerance;
+
+                // the matrix turns (0,-1,0) into the light direction, and its rows are orthonormal
+                const CPUMatrix& m = SpotMatrices[0][i];
+                for( int j = 0; j < 3; j++ )
+                {
+                    bReference = bReference && fabsf( -m.m[1][j] - Dir[j] ) < kDirectionTolerance;
+                    for( int k = 0; k < 3; k++ )
+                    {
+                        const float fDot = m.m[j][0]*m.m[k][0] + m.m[j][1]*m.m[k][1] + m.m[j][2]*m.m[k][2];
+                        bReference = bReference && fabsf( fDot - ( j == k ? 1.0f : 0.0f ) ) < kDirectionTolerance;
+                    }
+                }
+
+                // same packing as LightUtil's, from the animated direction and radius
+                const float AnimatedDir[3] = { -m.m[1][0], -m.m[1][1], -m.m[1][2] };
+                const CPUSpotParams Params = PackCPUSpotParams( AnimatedDir, 0.816496580927726f, c.w*1.333333333333f );
+                bReference = bReference && memcmp( &Params, &SpotParams[0][i], sizeof(Params) ) == 0;
+            }
+
+            const unsigned uNumIterations = std::max( Config.uNumFrames, 1u )*std::max( 262144 / uNumLights, 1u );
+            double fScalarTime = 0.0;
+            for( int nLevel = CPU_SIMD_SCALAR; nLevel <= (int)GetCPUSIMDLevel(); nLevel++ )
+            {
+                Animator.SetSIMDLevel( (CPUSIMDLevel)nLevel );
+                Animator.Animate( kTime, &CenterAndRadius[1][0], &Color[1][0], &SpotParams[1][0], &SpotMatrices[1][0], &Scheduler );
+
+                const bool bMatch = bReference &&
+                    ElementsMatch( CenterAndRadius[0], CenterAndRadius[1] ) && ElementsMatch( Color[0], Color[1] ) &&
+                    ElementsMatch( SpotParams[0], SpotParams[1] ) && ElementsMatch( SpotMatrices[0], SpotMatrices[1] );
+                bResult = bResult && bMatch;
+
+                unsigned uIteration = 0;
+                const double fTime = TimeIterations( uNumIterations, [&]()
+                {
+                    Animator.Animate( kTime + ( uIteration++ )*0.016f, &CenterAndRadius[1][0], &Color[1][0], &SpotParams[1][0], &SpotMatrices[1][0], &Scheduler );
+                } );
+                if( nLevel == CPU_SIMD_SCALAR )
+                {
+                    fScalarTime = fTime;
+                }
+
+                fprintf( pReport, "%-8s %7u %10.3f %12.1f %8.2fx  %s\n",
+                    GetCPUSIMDLevelName( (CPUSIMDLevel)nLevel ), uNumLights, fTime*1e9 / uNumLights, uNumLights / ( fTime*1e6 ), fScalarTime / fTime,
+                    GetMatchResult( bMatch ) );
+            }
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Light set files: for 2k to 1M lights (half point, half spot lights), the time to
+    // generate the lights procedurally, write them, map the file and check its header,
+    // check every light, and copy the mapped sections out as an upload would. The file
+    // is in the page cache after writing, so the times do not include the disk. Also checks
+    // the round trip, and that damaged files are rejected.
+    //--------------------------------------------------------------------------------------
+    static bool LightSetSectionsMatch( const CPULightSetDesc& A, const CPULightSetDesc& B )
+    {
+        return A.uNumPointLights == B.uNumPointLights && A.uNumSpotLights == B.uNumSpotLights &&
+            ElementsMatch( A.pPointLightCenterAndRadius, B.pPointLightCenterAndRadius, A.uNumPointLights ) &&
+            ElementsMatch( A.pPointLightColor, B.pPointLightColor, A.uNumPointLights ) &&
+            ElementsMatch( A.pSpotLightCenterAndRadius, B.pSpotLightCenterAndRadius, A.uNumSpotLights ) &&
+            ElementsMatch( A.pSpotLightColor, B.pSpotLightColor, A.uNumSpotLights ) &&
+            ElementsMatch( A.pSpotParams, B.pSpotParams, A.uNumSpotLights ) &&
+            ElementsMatch( A.pSpotMatrices, B.pSpotMatrices, A.uNumSpotLights ) &&
+            A.pPointLightShadowViewProj == NULL && B.pPointLightShadowViewProj == NULL;
+    }
+
+    // parse a copy of a light set file, 16-byte aligned as a mapping is, with one kind of damage
+    static CPULightSetResult ParseDamagedLightSet( const unsigned char* pFile, size_t uSize, int nDamage, std::vector<unsigned char>& Buffer )
+    {
+        Buffer.assign( uSize + CPU_LIGHT_SET_ALIGNMENT, 0 );
+        unsigned char* pData = &Buffer[0] + ( CPU_LIGHT_SET_ALIGNMENT - (size_t)&Buffer[0] % CPU_LIGHT_SET_ALIGNMENT ) % CPU_LIGHT_SET_ALIGNMENT;
+        memcpy( pData, pFile, uSize );
+
+        CPULightSetHeader* pHeader = (CPULightSetHeader*)pData;
+        const unsigned uMagic = pHeader->uMagic;
+        const unsigned uNaN = 0x7FC00000;
+        switch( nDamage )
+        {
+        case 1: uSize -= CPU_LIGHT_SET_ALIGNMENT; break;
+        case 2: pHeader->uMagic = ( uMagic >> 24 ) | ( ( uMagic >> 8 ) & 0xFF00 ) | ( ( uMagic << 8 ) & 0xFF0000 ) | ( uMagic << 24 ); break;
+        case 3: pHeader->uVersion++; break;
+        case 4: pHeader->Sections[CPU_LIGHT_SET_POINT_COLOR].uOffset = pHeader->Sections[CPU_LIGHT_SET_POINT_CENTER_AND_RADIUS].uOffset; break;
+        case 5: memcpy( pData + pHeader->Sections[CPU_LIGHT_SET_SPOT_CENTER_AND_RADIUS].uOffset + 3*sizeof(float), &uNaN, sizeof(uNaN) ); break;
+        default: break;
+        }
+
+        CPULightSetDesc Desc;
+        return ParseCPULightSet( pData, uSize, true, Desc );
+    }
+
+    static bool RunLightSetBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config )
+    {
+        static const unsigned kNumLights[] = { 2048, 16384, 131072, 1048576 };
+        static const float kBBoxMin[3] = { -1000.0f, 0.0f, -500.0f };
+        static const float kBBoxMax[3] = { 1000.0f, 600.0f, 500.0f };
+        static const char* const kPath = "cpubenchmark_lightset.tmp";
+
+        const unsigned uNumFrames = std::max( Config.uNumFrames, 1u );
+
+        fprintf( pReport, "\nlight set files, half point and half spot lights, without shadow matrices, written to %s\n", kPath );
+        fprintf( pReport, "%-8s %8s %12s %10s %10s %10s %10s %10s  %s\n", "lights", "MB", "ms generate", "ms write", "ms map", "ms check", "ms copy", "GB/s copy", "round trip" );
+
+        bool bResult = true;
+        std::vector<unsigned char> File;
+        for( unsigned uSize = 0; uSize < sizeof(kNumLights)/sizeof(kNumLights[0]); uSize++ )
+        {
+            const unsigned uNumLights = kNumLights[uSize] / 2;
+
+            // the lights, as the animation system makes them
+            CPUBenchmarkTimer Timer;
+            std::vector<CPUFloat4> PointCenterAndRadius( uNumLights ), SpotCenterAndRadius( uNumLights );
+            std::vector<unsigned> PointColor( uNumLights ), SpotColor( uNumLights );
+            std::vector<CPUSpotParams> SpotParams( uNumLights );
+            std::vector<CPUMatrix> SpotMatrices( uNumLights );
+            {
+                std::vector<CPULightAnimationDesc> Descs;
+                CPULightAnimator Animator;
+                CPULightAnimator::CreateRandomLights( 1, kBBoxMin, kBBoxMax, 25.0f, uNumLights, Descs );
+                Animator.SetLights( &Descs[0], uNumLights );
+                Animator.Animate( 0.0f, &PointCenterAndRadius[0], &PointColor[0], NULL, NULL, NULL );
+
+                CPULightAnimator::CreateRandomLights( 2, kBBoxMin, kBBoxMax, 25.0f, uNumLights, Descs );
+                Animator.SetLights( &Descs[0], uNumLights );
+                Animator.Animate( 0.0f, &SpotCenterAndRadius[0], &SpotColor[0], &SpotParams[0], &SpotMatrices[0], NULL );
+            }
+            const double fGenerateTime = Timer.GetSeconds();
+
+            CPULightSetDesc Desc;
+            ClearCPULightSetDesc( Desc );
+            Desc.uNumPointLights = uNumLights;
+            Desc.pPointLightCenterAndRadius = &PointCenterAndRadius[0];
+            Desc.pPointLightColor = &PointColor[0];
+            Desc.uNumSpotLights = uNumLights;
+            Desc.pSpotLightCenterAndRadius = &SpotCenterAndRadius[0];
+            Desc.pSpotLightColor = &SpotColor[0];
+            Desc.pSpotParams = &SpotParams[0];
+            Desc.pSpotMatrices = &SpotMatrices[0];
+
+            Timer.Restart();
+            const CPULightSetResult WriteResult = WriteCPULightSet( kPath, Desc );
+            const double fWriteTime = Timer.GetSeconds();
+            if( WriteResult != CPU_LIGHT_SET_OK )
+            {
+                fprintf( pReport, "%-8u skipped, the file cannot be written (%s)\n", kNumLights[uSize], GetCPULightSetResultName( WriteResult ) );
+                continue;
+            }
+
+            double fMapTime = 0.0, fCheckTime = 0.0, fCopyTime = 0.0;
+            CPULightSetResult Result = CPU_LIGHT_SET_OK;
+            bool bMatch = true;
+            size_t uFileSize = 0;
+            for( unsigned uFrame = 0; uFrame < uNumFrames && Result == CPU_LIGHT_SET_OK; uFrame++ )
+            {
+                CPULightSetFile LightSet;
+                Timer.Restart();
+                Result = LightSet.Open( kPath, false );
+                fMapTime += Timer.GetSeconds();
+                if( Result != CPU_LIGHT_SET_OK )
+                {
+                    break;
+                }
+
+                CPULightSetDesc Parsed;
+                Timer.Restart();
+                Result = ParseCPULightSet( LightSet.GetData(), LightSet.GetSize(), true, Parsed );
+                fCheckTime += Timer.GetSeconds();
+
+                // into one buffer, as big as the file
+                uFileSize = LightSet.GetSize();
+                File.resize( uFileSize );
+                Timer.Restart();
+                memcpy( &File[0], LightSet.GetData(), uFileSize );
+                fCopyTime += Timer.GetSeconds();
+
+                bMatch = bMatch && ( Result == CPU_LIGHT_SET_OK ) && LightSetSectionsMatch( Desc, Parsed );
+            }
+            bMatch = bMatch && ( Result == CPU_LIGHT_SET_OK );
+            bResult = bResult && bMatch;
+
+            fprintf( pReport, "%-8u %8.2f %12.3f %10.3f %10.3f %10.3f %10.3f %10.2f  %s\n",
+                kNumLights[uSize], uFileSize / ( 1024.0*1024.0 ), fGenerateTime*1000.0, fWriteTime*1000.0,
+                fMapTime*1000.0 / uNumFrames, fCheckTime*1000.0 / uNumFrames, fCopyTime*1000.0 / uNumFrames,
+                fCopyTime > 0.0 ? uFileSize*(double)uNumFrames / ( fCopyTime*1e9 ) : 0.0,
+                bMatch ? "identical" : GetCPULightSetResultName( Result ) );
+
+            // damaged copies of the smallest file
+            if( uSize == 0 && bMatch )
+            {
+                static const char* const kDamageNames[] = { "none", "truncated", "byte-swapped", "version", "overlap", "NaN radius" };
+                static const CPULightSetResult kExpected[] = { CPU_LIGHT_SET_OK, CPU_LIGHT_SET_BAD_HEADER, CPU_LIGHT_SET_BAD_HEADER, CPU_LIGHT_SET_BAD_VERSION, CPU_LIGHT_SET_BAD_SECTION, CPU_LIGHT_SET_BAD_LIGHT };
+
+                std::vector<unsigned char> Damaged;
+                fprintf( pReport, "damaged files:" );
+                bool bRejected = true;
+                for( int nDamage = 0; nDamage < 6; nDamage++ )
+                {
+                    const CPULightSetResult DamagedResult = ParseDamagedLightSet( &File[0], File.size(), nDamage, Damaged );
+                    bRejected = bRejected && ( DamagedResult == kExpected[nDamage] );
+                    fprintf( pReport, " %s %s,", kDamageNames[nDamage], GetCPULightSetResultName( DamagedResult ) );
+                }
+                fprintf( pReport, " %s\n", GetCheckResult( bRejected ) );
+                bResult = bResult && bRejected;
+            }
+        }
+
+        remove( kPath );
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Quantized lights: bandwidth per light, speed, and the errors against their bounds
+    //--------------------------------------------------------------------------------------
+    struct QuantizedLightErrors
+    {
+        float   fPosition;      // in steps of the bounds, per axis
+        float   fRadius;        // relative growth past the original sphere
+        float   fColor;         // relative to the brightest channel
+        float   fDirection;     // radians
+        float   fCone;          // relative
+        float   fFalloff;       // relative
+        unsigned uNumUncovered; // decoded spheres that don't hold the original one
+    };
+
+    static void AddQuantizedCenterErrors( const CPUQuantizedLightBounds& Bounds, const CPUFloat4& Original, const CPUFloat4& Decoded, QuantizedLightErrors& Errors )
+    {
+        const float Delta[3] = { Decoded.x - Original.x, Decoded.y - Original.y, Decoded.z - Original.z };
+        for( int i = 0; i < 3; i++ )
+        {
+            Errors.fPosition = std::max( Errors.fPosition, Bounds.Scale[i] > 0.0f ? fabsf( Delta[i] ) / Bounds.Scale[i] : 0.0f );
+        }
+
+        const float fDistance = sqrtf( Delta[0]*Delta[0] + Delta[1]*Delta[1] + Delta[2]*Delta[2] );
+        if( fDistance + Original.w > Decoded.w )
+        {
+            Errors.uNumUncovered++;
+        }
+        Errors.fRadius = std::max( Errors.fRadius, Decoded.w / ( fDistance + Original.w ) - 1.0f );
+    }
+
+    static void AddQuantizedColorErrors( unsigned uOriginal, const CPUFloat4& Decoded, QuantizedLightErrors& Errors )
+    {
+        const float Original[3] = { ( uOriginal & 0xFF ) / 255.0f, ( ( uOriginal >> 8 ) & 0xFF ) / 255.0f, ( ( uOriginal >> 16 ) & 0xFF ) / 255.0f };
+        const float fMax = std::max( Original[0], std::max( Original[1], Original[2] ) );
+        const float fError = std::max( fabsf( Decoded.x - Original[0] ), std::max( fabsf( Decoded.y - Original[1] ), fabsf( Decoded.z - Original[2] ) ) );
+        Errors.fColor = std::max( Errors.fColor, fMax > 0.0f ? fError / fMax : fError );
+    }
+
+    static bool RunQuantizedLightBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config )
+    {
+        static const unsigned kNumLights[] = { 2048, 65536, 262144 };
+        static const float kBBoxMin[3] = { -1000.0f, 0.0f, -500.0f };
+        static const float kBBoxMax[3] = { 1000.0f, 600.0f, 500.0f };
+
+        // what DoLighting and DoSpotLighting fetch per light: the center and radius, the color, and the spot parameters
+        static const unsigned kFloatPointBytes = sizeof(CPUFloat4) + sizeof(unsigned);
+        static const unsigned kFloatSpotBytes = sizeof(CPUFloat4) + sizeof(unsigned) + sizeof(CPUSpotParams);
+
+        const unsigned uNumFrames = std::max( Config.uNumFrames, 1u );
+
+        fprintf( pReport, "\nquantized lights, bytes per light: point %u (float %u), spot %u (float %u)\n",
+            (unsigned)sizeof(CPUQuantizedPointLight), kFloatPointBytes, (unsigned)sizeof(CPUQuantizedSpotLight), kFloatSpotBytes );
+        fprintf( pReport, "errors: position in steps of the bounds (max 0.5, plus float rounding), radius growth, color (max %.5f), direction in radians (max %.5f), cone (max %.5f), falloff (max %.5f)\n",
+            CPU_QUANTIZED_COLOR_MAX_ERROR, CPU_QUANTIZED_DIRECTION_MAX_ERROR, CPU_QUANTIZED_CONE_MAX_ERROR, CPU_QUANTIZED_FALLOFF_MAX_ERROR );
+        fprintf( pReport, "%-8s %9s %9s %11s %11s %11s %9s %9s %9s %9s %9s %9s  %s\n", "lights", "MB float", "MB quant", "ms quantize", "ms decode", "GB/s decode",
+            "position", "radius", "color", "direction", "cone", "falloff", "vs. bounds" );
+
+        bool bResult = true;
+        for( unsigned uSize = 0; uSize < sizeof(kNumLights)/sizeof(kNumLights[0]); uSize++ )
+        {
+            const unsigned uNumLights = kNumLights[uSize];
+
+            // the lights, as the animation system makes them
+            std::vector<CPUFloat4> PointCenterAndRadius( uNumLights ), SpotCenterAndRadius( uNumLights );
+            std::vector<unsigned> PointColor( uNumLights ), SpotColor( uNumLights );
+            std::vector<CPUSpotParams> SpotParams( uNumLights );
+            {
+                std::vector<CPULightAnimationDesc> Descs;
+                CPULightAnimator Animator;
+                CPULightAnimator::CreateRandomLights( 1, kBBoxMin, kBBoxMax, 25.0f, uNumLights, Descs );
+                Animator.SetLights( &Descs[0], uNumLights );
+                Animator.Animate( 0.0f, &PointCenterAndRadius[0], &PointColor[0], NULL, NULL, NULL );
+
+                CPULightAnimator::CreateRandomLights( 2, kBBoxMin, kBBoxMax, 25.0f, uNumLights, Descs );
+                Animator.SetLights( &Descs[0], uNumLights );
+                Animator.Animate( 0.0f, &SpotCenterAndRadius[0], &SpotColor[0], &SpotParams[0], NULL, NULL );
+            }
+
+            // the bounds of the centers, in the sample those of the scene
+            float BBoxMin[3] = { PointCenterAndRadius[0].x, PointCenterAndRadius[0].y, PointCenterAndRadius[0].z };
+            float BBoxMax[3] = { BBoxMin[0], BBoxMin[1], BBoxMin[2] };
+            for( unsigned i = 0; i < uNumLights; i++ )
+            {
+                const CPUFloat4* pCenters[2] = { &PointCenterAndRadius[i], &SpotCenterAndRadius[i] };
+                for( int j = 0; j < 2; j++ )
+                {
+                    const float Center[3] = { pCenters[j]->x, pCenters[j]->y, pCenters[j]->z };
+                    for( int k = 0; k < 3; k++ )
+                    {
+                        BBoxMin[k] = std::min( BBoxMin[k], Center[k] );
+                        BBoxMax[k] = std::max( BBoxMax[k], Center[k] );
+                    }
+                }
+            }
+
+            CPUQuantizedLightBounds Bounds;
+            InitCPUQuantizedLightBounds( BBoxMin, BBoxMax, Bounds );
+
+            std::vector<CPUQuantizedPointLight> QuantizedPointLights( uNumLights );
+            std::vector<CPUQuantizedSpotLight> QuantizedSpotLights( uNumLights );
+            std::vector<CPUFloat4> DecodedPointCenterAndRadius( uNumLights ), DecodedPointColor( uNumLights );
+            std::vector<CPUFloat4> DecodedSpotCenterAndRadius( uNumLights ), DecodedSpotColor( uNumLights ), DecodedSpotParams( uNumLights );
+
+            double fQuantizeTime = 0.0, fDecodeTime = 0.0;
+            for( unsigned uFrame = 0; uFrame < uNumFrames; uFrame++ )
+            {
+                CPUBenchmarkTimer Timer;
+                QuantizeCPUPointLights( Bounds, &PointCenterAndRadius[0], &PointColor[0], uNumLights, &QuantizedPointLights[0] );
+                QuantizeCPUSpotLights( Bounds, &SpotCenterAndRadius[0], &SpotColor[0], &SpotParams[0], uNumLights, &QuantizedSpotLights[0] );
+                fQuantizeTime += Timer.GetSeconds();
+
+                Timer.Restart();
+                DequantizeCPUPointLights( Bounds, &QuantizedPointLights[0], uNumLights, &DecodedPointCenterAndRadius[0], &DecodedPointColor[0] );
+                DequantizeCPUSpotLights( Bounds, &QuantizedSpotLights[0], uNumLights, &DecodedSpotCenterAndRadius[0], &DecodedSpotColor[0], &DecodedSpotParams[0] );
+                fDecodeTime += Timer.GetSeconds();
+            }
+
+            QuantizedLightErrors Errors;
+            memset( &Errors, 0, sizeof(Errors) );
+            for( unsigned i = 0; i < uNumLights; i++ )
+            {
+                AddQuantizedCenterErrors( Bounds, PointCenterAndRadius[i], DecodedPointCenterAndRadius[i], Errors );
+                AddQuantizedColorErrors( PointColor[i], DecodedPointColor[i], Errors );
+                AddQuantizedCenterErrors( Bounds, SpotCenterAndRadius[i], DecodedSpotCenterAndRadius[i], Errors );
+                AddQuantizedColorErrors( SpotColor[i], DecodedSpotColor[i], Errors );
+
+                // against the direction as DoSpotLighting reconstructs it from CPUSpotParams
+                const CPUSpotParams& Params = SpotParams[i];
+                const float fCosineAndSign = CPUConvertF16ToF32( Params.fCosineOfConeAngleAndLightDirZSign );
+                float Dir[3] = { CPUConvertF16ToF32( Params.fLightDirX ), CPUConvertF16ToF32( Params.fLightDirY ), 0.0f };
+                Dir[2] = sqrtf( std::max( 1.0f - Dir[0]*Dir[0] - Dir[1]*Dir[1], 0.0f ) );
+                Dir[2] = ( fCosineAndSign > 0.0f ) ? Dir[2] : -Dir[2];
+
+                const CPUFloat4& Decoded = DecodedSpotParams[i];
+                float DecodedDir[3] = { Decoded.x, Decoded.y, sqrtf( std::max( 1.0f - Decoded.x*Decoded.x - Decoded.y*Decoded.y, 0.0f ) ) };
+                DecodedDir[2] = ( Decoded.z > 0.0f ) ? DecodedDir[2] : -DecodedDir[2];
+
+                const double fCrossX = (double)Dir[1]*DecodedDir[2] - (double)Dir[2]*DecodedDir[1];
+                const double fCrossY = (double)Dir[2]*DecodedDir[0] - (double)Dir[0]*DecodedDir[2];
+                const double fCrossZ = (double)Dir[0]*DecodedDir[1] - (double)Dir[1]*DecodedDir[0];
+                const double fDot = (double)Dir[0]*DecodedDir[0] + (double)Dir[1]*DecodedDir[1] + (double)Dir[2]*DecodedDir[2];
+                const double fSinAngle = sqrt( fCrossX*fCrossX + fCrossY*fCrossY + fCrossZ*fCrossZ );
+                Errors.fDirection = std::max( Errors.fDirection, (float)atan2( fSinAngle, fDot ) );
+
+                const float fCosine = fabsf( fCosineAndSign );
+                const float fFalloff = CPUConvertF16ToF32( Params.fFalloffRadius );
+                Errors.fCone = std::max( Errors.fCone, fabsf( fabsf( Decoded.z ) - fCosine ) / fCosine );
+                Errors.fFalloff = std::max( Errors.fFalloff, fabsf( Decoded.w - fFalloff ) / fFalloff );
+            }
+
+            // half a step, and the rounding of the decoded coordinate; the radius grows by the
+            // step of the half it is rounded up to
+            const bool bWithinBounds = ( Errors.fPosition <= 0.505f ) && ( Errors.uNumUncovered == 0 ) && ( Errors.fRadius <= 1.0f / 1024.0f ) &&
+                ( Errors.fColor <= CPU_QUANTIZED_COLOR_MAX_ERROR ) && ( Errors.fDirection <= CPU_QUANTIZED_DIRECTION_MAX_ERROR ) &&
+                ( Errors.fCone <= CPU_QUANTIZED_CONE_MAX_ERROR ) && ( Errors.fFalloff <= CPU_QUANTIZED_FALLOFF_MAX_ERROR );
+            bResult = bResult && bWithinBounds;
+
+            const double fFloatBytes = (double)uNumLights*( kFloatPointBytes + kFloatSpotBytes );
+            const double fQuantizedBytes = (double)uNumLights*( sizeof(CPUQuantizedPointLight) + sizeof(CPUQuantizedSpotLight) );
+            fprintf( pReport, "%-8u %9.2f %9.2f %11.3f %11.3f %11.2f %9.5f %9.6f %9.6f %9.6f %9.6f %9.6f  %s",
+                uNumLights, fFloatBytes / ( 1024.0*1024.0 ), fQuantizedBytes / ( 1024.0*1024.0 ),
+                fQuantizeTime*1000.0 / uNumFrames, fDecodeTime*1000.0 / uNumFrames, fDecodeTime > 0.0 ? fQuantizedBytes*uNumFrames / ( fDecodeTime*1e9 ) : 0.0,
+                Errors.fPosition, Errors.fRadius, Errors.fColor, Errors.fDirection, Errors.fCone, Errors.fFalloff, GetCheckResult( bWithinBounds ) );
+            if( Errors.uNumUncovered != 0 )
+            {
+                fprintf( pReport, " (%u decoded spheres don't hold the original)", Errors.uNumUncovered );
+            }
+            fprintf( pReport, "\n" );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Light generation: the counter-based generator against the serial rand() loop InitLights had
+    //--------------------------------------------------------------------------------------
+    static float GetSerialRandFloat( float fRangeMin, float fRangeMax )
+    {
+        return (float)rand() / ( RAND_MAX + 1.0f ) * ( fRangeMax - fRangeMin ) + fRangeMin;
+    }
+
+    static unsigned GetSerialRandColor( unsigned uLight )
+    {
+        float r, g, b;
+        if( uLight % 2 )
+        {
+            r = GetSerialRandFloat( 0.0f, 1.0f );
+            g = GetSerialRandFloat( 0.27f, 1.0f );
+            b = GetSerialRandFloat( 0.0f, 1.0f );
+        }
+        else
+        {
+            r = GetSerialRandFloat( 0.9f, 1.0f );
+            g = GetSerialRandFloat( 0.0f, 1.0f );
+            b = GetSerialRandFloat( 0.0f, 1.0f );
+        }
+        return (unsigned)( r*255.0f + 0.5f ) | ( (unsigned)( g*255.0f + 0.5f ) << 8 ) | ( (unsigned)( b*255.0f + 0.5f ) << 16 ) | 0xFF000000u;
+    }
+
+    static void GenerateSerialLights( const CPULightGenerationDesc& Desc, unsigned uNumLights, CPUFloat4* pPointCenterAndRadius, unsigned* pPointColor,
+        CPUFloat4* pSpotCenterAndRadius, unsigned* pSpotColor, CPUSpotParams* pSpotParams, CPUMatrix* pSpotMatrices )
+    {
+        srand( Desc.uSeed );
+
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            const CPUFloat4 CenterAndRadius = { GetSerialRandFloat( Desc.BBoxMin[0], Desc.BBoxMax[0] ), GetSerialRandFloat( Desc.BBoxMin[1], Desc.BBoxMax[1] ), GetSerialRandFloat( Desc.BBoxMin[2], Desc.BBoxMax[2] ), Desc.fRadius };
+            pPointCenterAndRadius[i] = CenterAndRadius;
+            pPointColor[i] = GetSerialRandColor( i );
+        }
+
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            const CPUFloat4 CenterAndRadius = { GetSerialRandFloat( Desc.BBoxMin[0], Desc.BBoxMax[0] ), GetSerialRandFloat( Desc.BBoxMin[1], Desc.BBoxMax[1] ), GetSerialRandFloat( Desc.BBoxMin[2], Desc.BBoxMax[2] ), Desc.fRadius };
+            pSpotCenterAndRadius[i] = CenterAndRadius;
+            pSpotColor[i] = GetSerialRandColor( i );
+
+            float Dir[3] = { GetSerialRandFloat( -1.0f, 1.0f ), GetSerialRandFloat( 0.1f, 1.0f ), GetSerialRandFloat( -1.0f, 1.0f ) };
+            if( i % 2 )
+            {
+                Dir[1] = -Dir[1];
+            }
+            const float fInvLength = 1.0f / sqrtf( Dir[0]*Dir[0] + Dir[1]*Dir[1] + Dir[2]*Dir[2] );
+            Dir[0] *= fInvLength;
+            Dir[1] *= fInvLength;
+            Dir[2] *= fInvLength;
+
+            pSpotParams[i] = PackCPUSpotParams( Dir, Desc.fSpotCosineOfConeAngle, Desc.fSpotFalloffRadius );
+            CalcCPUSpotLightRotation( Dir, pSpotMatrices[i] );
+        }
+    }
+
+    static bool RunLightGenerationBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kNumLights[] = { 2048, 1048576 };
+        static const float kBBoxMin[3] = { -1000.0f, 0.0f, -500.0f };
+        static const float kBBoxMax[3] = { 1000.0f, 600.0f, 500.0f };
+
+        const unsigned uNumFrames = std::max( Config.uNumFrames, 1u );
+
+        // known answers from the Random123 distribution
+        static const unsigned kCounters[3][4] = { { 0, 0, 0, 0 }, { 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu }, { 0x243F6A88u, 0x85A308D3u, 0x13198A2Eu, 0x03707344u } };
+        static const unsigned kKeys[3][2] = { { 0, 0 }, { 0xFFFFFFFFu, 0xFFFFFFFFu }, { 0xA4093822u, 0x299F31D0u } };
+        static const unsigned kResults[3][4] = { { 0x6627E8D5u, 0xE169C58Du, 0xBC57AC4Cu, 0x9B00DBD8u }, { 0x408F276Du, 0x41C83B0Eu, 0xA20BC7C6u, 0x6D5451FDu }, { 0xD16CFE09u, 0x94FDCCEBu, 0x5001E420u, 0x24126EA1u } };
+
+        bool bKnownAnswers = true;
+        for( int i = 0; i < 3; i++ )
+        {
+            unsigned Result[4];
+            CPUPhilox4x32( kCounters[i], kKeys[i], Result );
+            bKnownAnswers = bKnownAnswers && ( memcmp( Result, kResults[i], sizeof(Result) ) == 0 );
+        }
+
+        fprintf( pReport, "\nlight generation, point and spot lights with debug drawing matrices, %u threads, Philox4x32-10 known answers %s\n",
+            Scheduler.GetNumThreads(), GetCheckResult( bKnownAnswers ) );
+        fprintf( pReport, "%-8s %12s %12s %12s %9s  %s\n", "lights", "ms rand()", "ms 1 thread", "ms threads", "speedup", "vs. 1 thread" );
+
+        CPULightGenerationDesc Desc;
+        InitCPULightGenerationDesc( 1, kBBoxMin, kBBoxMax, Desc );
+
+        bool bResult = bKnownAnswers;
+        for( unsigned uSize = 0; uSize < sizeof(kNumLights)/sizeof(kNumLights[0]); uSize++ )
+        {
+            const unsigned uNumLights = kNumLights[uSize];
+
+            std::vector<CPUFloat4> PointCenterAndRadius[2], SpotCenterAndRadius[2];
+            std::vector<unsigned> PointColor[2], SpotColor[2];
+            std::vector<CPUSpotParams> SpotParams[2];
+            std::vector<CPUMatrix> SpotMatrices[2];
+            for( int i = 0; i < 2; i++ )
+            {
+                PointCenterAndRadius[i].resize( uNumLights );
+                SpotCenterAndRadius[i].resize( uNumLights );
+                PointColor[i].resize( uNumLights );
+                SpotColor[i].resize( uNumLights );
+                SpotParams[i].resize( uNumLights );
+                SpotMatrices[i].resize( uNumLights );
+            }
+
+            double fSerialTime = 0.0, fSingleThreadTime = 0.0, fParallelTime = 0.0;
+            for( unsigned uFrame = 0; uFrame < uNumFrames; uFrame++ )
+            {
+                CPUBenchmarkTimer Timer;
+                GenerateSerialLights( Desc, uNumLights, &PointCenterAndRadius[0][0], &PointColor[0][0], &SpotCenterAndRadius[0][0], &SpotColor[0][0], &SpotParams[0][0], &SpotMatrices[0][0] );
+                fSerialTime += Timer.GetSeconds();
+
+                Timer.Restart();
+                GenerateCPUPointLights( Desc, uNumLights, &PointCenterAndRadius[0][0], &PointColor[0][0], NULL );
+                GenerateCPUSpotLights( Desc, uNumLights, &SpotCenterAndRadius[0][0], &SpotColor[0][0], &SpotParams[0][0], &SpotMatrices[0][0], NULL );
+                fSingleThreadTime += Timer.GetSeconds();
+
+                Timer.Restart();
+                GenerateCPUPointLights( Desc, uNumLights, &PointCenterAndRadius[1][0], &PointColor[1][0], &Scheduler );
+                GenerateCPUSpotLights( Desc, uNumLights, &SpotCenterAndRadius[1][0], &SpotColor[1][0], &SpotParams[1][0], &SpotMatrices[1][0], &Scheduler );
+                fParallelTime += Timer.GetSeconds();
+            }
+
+            const bool bMatch = ElementsMatch( PointCenterAndRadius[0], PointCenterAndRadius[1] ) && ElementsMatch( SpotCenterAndRadius[0], SpotCenterAndRadius[1] ) &&
+                ( PointColor[0] == PointColor[1] ) && ( SpotColor[0] == SpotColor[1] ) &&
+                ElementsMatch( SpotParams[0], SpotParams[1] ) && ElementsMatch( SpotMatrices[0], SpotMatrices[1] );
+            bResult = bResult && bMatch;
+
+            fprintf( pReport, "%-8u %12.3f %12.3f %12.3f %8.2fx  %s\n", uNumLights,
+                fSerialTime*1000.0 / uNumFrames, fSingleThreadTime*1000.0 / uNumFrames, fParallelTime*1000.0 / uNumFrames,
+                fParallelTime > 0.0 ? fSerialTime / fParallelTime : 0.0, GetMatchResult( bMatch ) );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Lights
+    //--------------------------------------------------------------------------------------
+    bool RunLightBenchmarks( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        bool bResult = true;
+
+        if( !RunLightPoolBenchmark( pReport, Config ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunLightAnimationBenchmark( pReport, Config, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunLightSetBenchmark( pReport, Config ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunQuantizedLightBenchmark( pReport, Config ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunLightGenerationBenchmark( pReport, Config, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        return bResult;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
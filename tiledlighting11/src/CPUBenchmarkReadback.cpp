@@ -0,0 +1,271 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUBenchmarkReadback.cpp
+//
+// The readback part of the headless CPU benchmark: the readback queue against a simulated GPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPUBenchmarkUtil.h"
+#include "CPUReadbackQueue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace TiledLighting11
+{
+    //--------------------------------------------------------------------------------------
+    // The readback queue against a simulated GPU that passes each copy's fence a fixed or
+    // random number of frames after the copy was made, in order. Every frame requests the
+    // VPL count of that frame and updates; each result must be the value of the frame it
+    // says it is from, newer than the last one and no older than the last Reset, and the
+    // queue must never copy into a slot whose fence has not passed or read one that is not
+    // ready (either would make the CPU wait for the GPU).
+    //--------------------------------------------------------------------------------------
+    static unsigned GetSimulatedNumVPLs( unsigned uFrame )
+    {
+        unsigned uHash = uFrame*0x9E3779B9u;
+        uHash ^= uHash >> 16;
+        return uHash % kMaxVPLs;
+    }
+
+    class SimulatedGPUReadback : public CPUReadbackBackend
+    {
+    public:
+        SimulatedGPUReadback( unsigned uNumSlots, unsigned uLatency, unsigned uJitter, unsigned uFailEvery )
+            :uFrame(0)
+            ,uNumViolations(0)
+            ,m_uLatency(uLatency)
+            ,m_uJitter(uJitter)
+            ,m_uFailEvery(uFailEvery)
+            ,m_uNumReads(0)
+            ,m_uLastFence(0)
+            ,m_uRandom(0x2545F491u)
+            ,m_Slots(uNumSlots)
+        {
+            memset( &m_Slots[0], 0, uNumSlots*sizeof(Slot) );
+        }
+
+        // the frame the CPU is on, and the copies or reads that would have waited for the GPU
+        unsigned    uFrame;
+        unsigned    uNumViolations;
+
+        virtual void CopyToSlot( unsigned uSlot )
+        {
+            if( m_Slots[uSlot].bCopied && uFrame < m_Slots[uSlot].uFenceFrame )
+            {
+                uNumViolations++;
+            }
+
+            // the fences pass in order
+            unsigned uJitter = 0;
+            if( m_uJitter > 0 )
+            {
+                m_uRandom ^= m_uRandom << 13;
+                m_uRandom ^= m_uRandom >> 17;
+                m_uRandom ^= m_uRandom << 5;
+                uJitter = m_uRandom % ( m_uJitter + 1 );
+            }
+            m_uLastFence = std::max( m_uLastFence, uFrame + m_uLatency + uJitter );
+
+            m_Slots[uSlot].bCopied = true;
+            m_Slots[uSlot].uFenceFrame = m_uLastFence;
+            m_Slots[uSlot].Data[0] = GetSimulatedNumVPLs( uFrame );
+            m_Slots[uSlot].Data[1] = uFrame;
+        }
+
+        virtual bool IsSlotReady( unsigned uSlot )
+        {
+            return m_Slots[uSlot].bCopied && uFrame >= m_Slots[uSlot].uFenceFrame;
+        }
+
+        virtual bool ReadSlot( unsigned uSlot, void* pData, unsigned uDataSize )
+        {
+            if( !IsSlotReady( uSlot ) )
+            {
+                uNumViolations++;
+            }
+
+            m_uNumReads++;
+            if( m_uFailEvery > 0 && m_uNumReads % m_uFailEvery == 0 )
+            {
+                return false;
+            }
+
+            memcpy( pData, m_Slots[uSlot].Data, std::min( uDataSize, (unsigned)sizeof(m_Slots[uSlot].Data) ) );
+            return true;
+        }
+
+    private:
+        struct Slot
+        {
+            bool        bCopied;
+            unsigned    uFenceFrame;
+            unsigned    Data[2];        // the VPL count, and the frame it was copied in
+        };
+
+        unsigned            m_uLatency;
+        unsigned            m_uJitter;
+        unsigned            m_uFailEvery;
+        unsigned            m_uNumReads;
+        unsigned            m_uLastFence;
+        unsigned            m_uRandom;
+        std::vector<Slot>   m_Slots;
+    };
+
+    static bool RunReadbackQueueBenchmark( FILE* pReport )
+    {
+        struct ReadbackTest
+        {
+            unsigned    uNumSlots;
+            unsigned    uLatency;
+            unsigned    uJitter;
+            unsigned    uFailEvery;
+            unsigned    uResetEvery;
+        };
+
+        static const ReadbackTest kTests[] =
+        {
+            { 1, 0, 0, 0, 0 }, { 1, 1, 0, 0, 0 }, { 1, 2, 0, 0, 0 },
+            { 2, 1, 0, 0, 0 }, { 2, 2, 0, 0, 0 }, { 2, 3, 0, 0, 0 },
+            { 3, 1, 0, 0, 0 }, { 3, 2, 0, 0, 0 }, { 3, 3, 0, 0, 0 },
+            { 4, 2, 0, 0, 0 }, { 4, 3, 0, 0, 0 },
+            { 3, 1, 2, 0, 0 }, { 3, 2, 3, 0, 0 }, { 3, 2, 0, 7, 0 }, { 3, 2, 1, 0, 50 },
+        };
+        static const unsigned kNumFrames = 100000;
+
+        fprintf( pReport, "\nreadback queue, the VPL count read back over %u frames from a simulated GPU that passes each copy's fence a number of frames later\n", kNumFrames );
+        fprintf( pReport, "%-5s %-10s %-9s %-7s %9s %8s %9s %7s %11s %11s %9s  %s\n", "slots", "GPU frames", "fail each", "reset", "requests", "dropped", "read", "failed", "avg latency", "max latency", "ns/frame", "check" );
+
+        bool bResult = true;
+        for( unsigned uTest = 0; uTest < sizeof(kTests)/sizeof(kTests[0]); uTest++ )
+        {
+            const ReadbackTest& Test = kTests[uTest];
+
+            SimulatedGPUReadback Backend( Test.uNumSlots, Test.uLatency, Test.uJitter, Test.uFailEvery );
+            CPUReadbackQueue Queue;
+            Queue.Init( &Backend, Test.uNumSlots, 2*sizeof(unsigned) );
+
+            unsigned uNumWrong = 0, uResetFrame = 0, uLastResultFrame = 0;
+            bool bHadResult = false;
+            CPUBenchmarkTimer Timer;
+            for( unsigned uFrame = 1; uFrame <= kNumFrames; uFrame++ )
+            {
+                Backend.uFrame = uFrame;
+                if( Test.uResetEvery > 0 && uFrame % Test.uResetEvery == 0 )
+                {
+                    Queue.Reset();
+                    uResetFrame = uFrame;
+                    bHadResult = false;
+                }
+
+                Queue.Request( uFrame, uFrame & 1 );
+                if( Queue.Update( uFrame ) )
+                {
+                    const unsigned* pResult = (const unsigned*)Queue.GetResult();
+                    const unsigned uResultFrame = Queue.GetResultFrame();
+                    if( pResult[0] != GetSimulatedNumVPLs( uResultFrame ) || pResult[1] != uResultFrame || Queue.GetResultTag() != ( uResultFrame & 1 ) ||
+                        ( bHadResult && uResultFrame <= uLastResultFrame ) || uResultFrame < uResetFrame )
+                    {
+                        uNumWrong++;
+                    }
+                    uLastResultFrame = uResultFrame;
+                    bHadResult = true;
+                }
+            }
+            const double fTime = Timer.GetSeconds();
+
+            // a ring deeper than the GPU is behind never drops a request, and with a fixed
+            // delay every request is read the frame its fence passes
+            const CPUReadbackStats& Stats = Queue.GetStats();
+            const unsigned uMaxLatency = Test.uLatency + Test.uJitter;
+            bool bCorrect = uNumWrong == 0 && Backend.uNumViolations == 0 && Stats.uNumRequests == kNumFrames && Stats.uMaxLatency <= uMaxLatency &&
+                Stats.uNumCompleted + Queue.GetNumInFlight() + Stats.uNumDropped <= kNumFrames && Stats.uNumRead + Stats.uNumFailed <= Stats.uNumCompleted;
+            if( Test.uJitter == 0 && Test.uResetEvery == 0 )
+            {
+                bCorrect = bCorrect && Stats.uMaxLatency == Test.uLatency && Stats.uNumCompleted + Queue.GetNumInFlight() + Stats.uNumDropped == kNumFrames;
+                if( Test.uNumSlots > Test.uLatency )
+                {
+                    bCorrect = bCorrect && Stats.uNumDropped == 0 && Stats.uNumRead + Stats.uNumFailed == kNumFrames - Test.uLatency;
+                }
+            }
+            if( Test.uFailEvery > 0 )
+            {
+                bCorrect = bCorrect && Stats.uNumFailed == ( Stats.uNumRead + Stats.uNumFailed ) / Test.uFailEvery;
+            }
+            bResult = bResult && bCorrect;
+
+            fprintf( pReport, "%-5u ", Test.uNumSlots );
+            if( Test.uJitter > 0 )
+            {
+                fprintf( pReport, "%u-%-8u ", Test.uLatency, Test.uLatency + Test.uJitter );
+            }
+            else
+            {
+                fprintf( pReport, "%-10u ", Test.uLatency );
+            }
+            if( Test.uFailEvery > 0 )
+            {
+                fprintf( pReport, "%-9u ", Test.uFailEvery );
+            }
+            else
+            {
+                fprintf( pReport, "%-9s ", "-" );
+            }
+            if( Test.uResetEvery > 0 )
+            {
+                fprintf( pReport, "%-7u ", Test.uResetEvery );
+            }
+            else
+            {
+                fprintf( pReport, "%-7s ", "-" );
+            }
+            fprintf( pReport, "%9u %8u %9u %7u %11.2f %11u %9.1f  %s\n", Stats.uNumRequests, Stats.uNumDropped, Stats.uNumRead, Stats.uNumFailed,
+                Stats.uNumRead ? (double)Stats.uTotalLatency / Stats.uNumRead : 0.0, Stats.uMaxLatency, fTime / kNumFrames*1e9, GetCheckResult( bCorrect ) );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Readback
+    //--------------------------------------------------------------------------------------
+    bool RunReadbackBenchmarks( FILE* pReport )
+    {
+        bool bResult = true;
+
+        if( !RunReadbackQueueBenchmark( pReport ) )
+        {
+            bResult = false;
+        }
+
+        return bResult;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
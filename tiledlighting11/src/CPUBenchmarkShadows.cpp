@@ -0,0 +1,1035 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUBenchmarkShadows.cpp
+//
+// The shadows part of the headless CPU benchmark: shadow matrices, the shadow scheduler,
+// the shadow atlas, shadow caster culling and the shadow cache.
+//--------------------------------------------------------------------------------------
+
+#include "CPUBenchmarkUtil.h"
+#include "CPULightGeneration.h"
+#include "CPUScene.h"
+#include "CPUShadowAtlas.h"
+#include "CPUShadowCache.h"
+#include "CPUShadowCasterCulling.h"
+#include "CPUShadowMatrices.h"
+#include "CPUShadowScheduler.h"
+#include "CPUTaskScheduler.h"
+#include "DefaultScene.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+namespace TiledLighting11
+{
+    //--------------------------------------------------------------------------------------
+    // Shadow matrices: the closed-form batches of CPUShadowMatrices.h at every SIMD level,
+    // against the path LightUtil had (look-at times perspective, then a general inverse,
+    // one light at a time), with both checked against that path in double precision. The
+    // errors are per matrix row, as a row is dotted with a homogeneous position: world
+    // space positions in the scene for the view-projection matrices, and clip space
+    // positions (x, y and z no larger than w) for the inverses.
+    //--------------------------------------------------------------------------------------
+    // the largest error of a row, relative to the row's largest element, with the first three
+    // columns scaled by how large the x, y and z of the homogeneous points it is used on get
+    static double GetShadowMatrixError( const float m[4][4], const double Reference[4][4], double fPositionScale )
+    {
+        double fError = 0.0;
+        for( int i = 0; i < 4; i++ )
+        {
+            double fScale = 0.0, fRowError = 0.0;
+            for( int j = 0; j < 4; j++ )
+            {
+                const double fColumnScale = ( j < 3 ) ? fPositionScale : 1.0;
+                fScale = std::max( fScale, fColumnScale*fabs( Reference[i][j] ) );
+                fRowError = std::max( fRowError, fColumnScale*fabs( m[i][j] - Reference[i][j] ) );
+            }
+            fError = std::max( fError, fRowError / fScale );
+        }
+        return fError;
+    }
+
+    static bool RunShadowMatrixBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kNumLights[] = { 12, 32768 };
+        static const float kBBoxMin[3] = { -1300.0f, 0.0f, -600.0f };
+        static const float kBBoxMax[3] = { 1300.0f, 700.0f, 600.0f };
+
+        // a few float roundings, relative to the row
+        static const double kMaxError = 2e-6;
+        const double fSceneSize = sqrt( (double)kBBoxMax[0]*kBBoxMax[0] + (double)kBBoxMax[1]*kBBoxMax[1] + (double)kBBoxMax[2]*kBBoxMax[2] );
+
+        fprintf( pReport, "\nshadow matrices, view-projection and inverse per point light face and spot light, errors vs. the general path in double precision, %u threads\n", Scheduler.GetNumThreads() );
+        fprintf( pReport, "%-8s %-8s %8s %12s %10s %12s %12s  %s\n", "lights", "path", "threads", "ms/frame", "ns/matrix", "max VP err", "max inv err", "check" );
+
+        CPULightGenerationDesc Desc;
+        InitCPULightGenerationDesc( 1, kBBoxMin, kBBoxMax, Desc );
+
+        bool bResult = true;
+        for( unsigned uSize = 0; uSize < sizeof(kNumLights)/sizeof(kNumLights[0]); uSize++ )
+        {
+            const unsigned uNumLights = kNumLights[uSize];
+            const unsigned uNumMatrices = 7*uNumLights;
+            const unsigned uNumIterations = std::max( Config.uNumFrames, 1u )*std::max( 32768 / uNumLights, 1u );
+
+            // point and spot lights at the generated positions, with radii from 100 to 1000,
+            // the spot lights looking at the point lights (or next to them, if that is within 6 degrees of straight up or down)
+            std::vector<CPUFloat4> PointLights( uNumLights ), SpotLights( uNumLights ), LookAts( uNumLights );
+            std::vector<unsigned> Colors( uNumLights );
+            std::vector<CPUSpotParams> SpotParams( uNumLights );
+            GenerateCPUPointLights( Desc, uNumLights, &PointLights[0], &Colors[0], NULL );
+            GenerateCPUSpotLights( Desc, uNumLights, &SpotLights[0], &Colors[0], &SpotParams[0], NULL, NULL );
+            for( unsigned i = 0; i < uNumLights; i++ )
+            {
+                PointLights[i].w = 100.0f + (float)( ( i*7919u ) % 901u );
+                SpotLights[i].w = 100.0f + (float)( ( i*104729u ) % 901u );
+                LookAts[i] = PointLights[i];
+                const float fHorizontal = fabsf( LookAts[i].x - SpotLights[i].x ) + fabsf( LookAts[i].z - SpotLights[i].z );
+                if( fHorizontal < 0.1f*fabsf( LookAts[i].y - SpotLights[i].y ) )
+                {
+                    LookAts[i].x += 0.1f*fabsf( LookAts[i].y - SpotLights[i].y );
+                }
+            }
+
+            std::vector<ShadowReferenceMatrix> ReferenceViewProj( uNumMatrices ), ReferenceViewProjInv( uNumMatrices );
+            CalcGeneralShadowMatrices( PointLights, SpotLights, LookAts, &ReferenceViewProj[0].m, &ReferenceViewProjInv[0].m );
+
+            // the general path in float, the closed form of every SIMD level, and the closed form with the threads
+            std::vector<CPUMatrix> ViewProj[2], ViewProjInv[2];
+            for( int i = 0; i < 2; i++ )
+            {
+                ViewProj[i].resize( uNumMatrices );
+                ViewProjInv[i].resize( uNumMatrices );
+            }
+
+            const int nNumPaths = (int)GetCPUSIMDLevel() + 3;
+            for( int nPath = 0; nPath < nNumPaths; nPath++ )
+            {
+                const bool bGeneral = ( nPath == 0 );
+                const bool bThreads = ( nPath == nNumPaths - 1 );
+                const CPUSIMDLevel Level = bThreads ? CPU_SIMD_AUTO : (CPUSIMDLevel)( nPath - 1 );
+                CPUTaskScheduler* pScheduler = bThreads ? &Scheduler : NULL;
+                const int nOutput = ( nPath <= 1 ) ? 0 : 1;
+
+                double fTime = 0.0;
+                for( unsigned uIteration = 0; uIteration <= uNumIterations; uIteration++ )
+                {
+                    CPUBenchmarkTimer Timer;
+                    if( bGeneral )
+                    {
+                        CalcGeneralShadowMatrices( PointLights, SpotLights, LookAts, &ViewProj[0][0].m, &ViewProjInv[0][0].m );
+                    }
+                    else
+                    {
+                        CalcCPUPointLightShadowMatrices( &PointLights[0], uNumLights, &ViewProj[nOutput][0], &ViewProjInv[nOutput][0], Level, pScheduler );
+                        CalcCPUSpotLightShadowMatrices( &SpotLights[0], &LookAts[0], uNumLights, &ViewProj[nOutput][6*uNumLights], &ViewProjInv[nOutput][6*uNumLights], Level, pScheduler );
+                    }
+
+                    // (the first iteration warms up)
+                    if( uIteration > 0 )
+                    {
+                        fTime += Timer.GetSeconds();
+                    }
+                }
+                fTime /= uNumIterations;
+
+                double fViewProjError = 0.0, fViewProjInvError = 0.0;
+                for( unsigned i = 0; i < uNumMatrices; i++ )
+                {
+                    fViewProjError = std::max( fViewProjError, GetShadowMatrixError( ViewProj[nOutput][i].m, ReferenceViewProj[i].m, fSceneSize ) );
+                    fViewProjInvError = std::max( fViewProjInvError, GetShadowMatrixError( ViewProjInv[nOutput][i].m, ReferenceViewProjInv[i].m, 1.0 ) );
+                }
+
+                // the closed form is within kMaxError of the reference, and bit for bit the same at every level
+                const char* pCheck = "reference";
+                if( !bGeneral )
+                {
+                    const bool bAccurate = ( fViewProjError <= kMaxError && fViewProjInvError <= kMaxError );
+                    const bool bMatch = ( nOutput == 0 ) ||
+                        ( ElementsMatch( ViewProj[0], ViewProj[1], uNumMatrices ) && ElementsMatch( ViewProjInv[0], ViewProjInv[1], uNumMatrices ) );
+                    bResult = bResult && bAccurate && bMatch;
+                    pCheck = !bAccurate ? "FAILED" : !bMatch ? "MISMATCH" : ( nOutput == 0 ) ? "ok" : "identical";
+                }
+
+                fprintf( pReport, "%-8u %-8s %8u %12.4f %10.2f %12.2e %12.2e  %s\n", uNumLights,
+                    bGeneral ? "general" : GetCPUSIMDLevelName( ResolveCPUSIMDLevel( Level ) ), pScheduler ? Scheduler.GetNumThreads() : 1,
+                    fTime*1000.0, fTime*1e9 / uNumMatrices, fViewProjError, fViewProjInvError, pCheck );
+            }
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Shadow slot scheduling along scripted camera paths: many shadow-casting candidates,
+    // a quarter of them moving, and the sample's 12+12 atlas slots. Reports the shadow
+    // passes per frame against the passes it takes to render every face of the visible
+    // casters in a slot each frame (as the sample renders its 12+12 lights), and how long
+    // faces are shown out of date. Checks the pass budget and that threading the scoring
+    // does not change the schedule.
+    //--------------------------------------------------------------------------------------
+    enum CPUShadowPath
+    {
+        CPU_SHADOW_PATH_STATIC = 0,     // the camera does not move
+        CPU_SHADOW_PATH_TURN,           // the camera turns around once in the middle of the room
+        CPU_SHADOW_PATH_WALK,           // the camera walks down the length of the room
+        CPU_SHADOW_PATH_CUTS,           // the camera jumps between the corners every 40 frames
+    };
+
+    static void GetShadowPathCamera( CPUShadowPath Path, unsigned uFrame, unsigned uNumFrames, const CPUScene& BaseScene, float Eye[3], float At[3] )
+    {
+        const float fTime = (float)uFrame / (float)uNumFrames;
+
+        switch( Path )
+        {
+        case CPU_SHADOW_PATH_TURN:
+            Eye[0] = 0.0f; Eye[1] = 300.0f; Eye[2] = 0.0f;
+            At[0] = 1000.0f*cosf( 6.2831853f*fTime ); At[1] = 300.0f; At[2] = 1000.0f*sinf( 6.2831853f*fTime );
+            break;
+
+        case CPU_SHADOW_PATH_WALK:
+            Eye[0] = -1350.0f + 2700.0f*fTime; Eye[1] = 250.0f; Eye[2] = 200.0f*sinf( 0.05f*uFrame );
+            At[0] = Eye[0] + 1000.0f; At[1] = 300.0f; At[2] = 0.0f;
+            break;
+
+        case CPU_SHADOW_PATH_CUTS:
+            {
+                const unsigned uCorner = ( uFrame / 40 ) % 4;
+                Eye[0] = ( uCorner & 1 ) ? 1350.0f : -1350.0f; Eye[1] = 600.0f; Eye[2] = ( uCorner & 2 ) ? 600.0f : -600.0f;
+                At[0] = 0.0f; At[1] = 300.0f; At[2] = 0.0f;
+            }
+            break;
+
+        default:
+            Eye[0] = BaseScene.EyePt.x; Eye[1] = BaseScene.EyePt.y; Eye[2] = BaseScene.EyePt.z;
+            At[0] = BaseScene.LookAtPt.x; At[1] = BaseScene.LookAtPt.y; At[2] = BaseScene.LookAtPt.z;
+            break;
+        }
+    }
+
+    static bool RunShadowSchedulerBenchmark( FILE* pReport, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned NUM_PATH_FRAMES = 240;
+        static const unsigned NUM_CASTERS_PER_TYPE = 256;
+
+        struct PathDesc
+        {
+            const char*     pName;
+            CPUShadowPath   Path;
+        };
+        // a sample of the frames, listed under each path
+        struct FrameRow
+        {
+            unsigned                uFrame;
+            unsigned                uAllPasses;
+            CPUShadowSchedulerStats Stats;
+        };
+
+        static const PathDesc kPaths[] =
+        {
+            { "static", CPU_SHADOW_PATH_STATIC },
+            { "turn",   CPU_SHADOW_PATH_TURN },
+            { "walk",   CPU_SHADOW_PATH_WALK },
+            { "cuts",   CPU_SHADOW_PATH_CUTS },
+        };
+
+        // only the camera matters, so a small depth buffer; the casters are twice the size of the scene's lights
+        CPUSceneDesc SceneDesc;
+        SceneDesc.uWidth = 160;
+        SceneDesc.uHeight = 90;
+        SceneDesc.uNumPointLights = NUM_CASTERS_PER_TYPE;
+        SceneDesc.uNumSpotLights = NUM_CASTERS_PER_TYPE;
+        SceneDesc.fLightRadiusScale = 2.0f;
+        CPUScene BaseScene;
+        CreateCPUScene( SceneDesc, BaseScene );
+
+        std::vector<CPUShadowCaster> BaseCasters( 2*NUM_CASTERS_PER_TYPE );
+        for( unsigned i = 0; i < NUM_CASTERS_PER_TYPE; i++ )
+        {
+            BaseCasters[i].CenterAndRadius = BaseScene.PointLightCenterAndRadius[i];
+            BaseCasters[i].uType = CPU_SHADOW_CASTER_POINT;
+            BaseCasters[i].bMoved = false;
+            BaseCasters[NUM_CASTERS_PER_TYPE + i].CenterAndRadius = BaseScene.SpotLightCenterAndRadius[i];
+            BaseCasters[NUM_CASTERS_PER_TYPE + i].uType = CPU_SHADOW_CASTER_SPOT;
+            BaseCasters[NUM_CASTERS_PER_TYPE + i].bMoved = false;
+        }
+
+        const CPUShadowSchedulerDesc Desc;
+        const unsigned uNumSlottedFaces = 6*Desc.uNumPointSlots + Desc.uNumSpotSlots;
+
+        fprintf( pReport, "\nshadow scheduling, %u frame scripted camera paths, %u point and %u spot light candidates (a quarter of them moving), %u+%u slots, up to %u passes per frame, %u threads\n",
+            NUM_PATH_FRAMES, NUM_CASTERS_PER_TYPE, NUM_CASTERS_PER_TYPE, Desc.uNumPointSlots, Desc.uNumSpotSlots, Desc.uMaxFacesPerFrame, Scheduler.GetNumThreads() );
+        fprintf( pReport, "%-8s %9s %9s %10s %9s %13s %11s %11s %11s %9s  %s\n",
+            "path", "ms/frame", "visible", "unshadowed", "new slots", "passes/frame", "max passes", "all passes", "stale faces", "max stale", "check" );
+
+        bool bResult = true;
+        for( size_t p = 0; p < sizeof(kPaths)/sizeof(kPaths[0]); p++ )
+        {
+            const PathDesc& Path = kPaths[p];
+
+            CPUScene Scene = BaseScene;
+            std::vector<CPUShadowCaster> Casters = BaseCasters;
+            CPUShadowScheduler Serial, Threaded;
+
+            double fTime = 0.0;
+            unsigned long long uNumVisible = 0, uNumUnslotted = 0, uNumSlotChanges = 0, uNumPasses = 0, uNumAllPasses = 0, uNumStaleFaces = 0;
+            unsigned uMaxPasses = 0, uMaxStaleFrames = 0;
+            bool bWithinBudget = true, bMatch = true;
+            std::vector<FrameRow> FrameRows;
+
+            for( unsigned uFrame = 0; uFrame < NUM_PATH_FRAMES; uFrame++ )
+            {
+                float Eye[3], At[3];
+                GetShadowPathCamera( Path.Path, uFrame, NUM_PATH_FRAMES, BaseScene, Eye, At );
+                SetCPUSceneCamera( Scene, Eye, At );
+
+                // every fourth caster circles around where it started
+                for( unsigned i = 0; i < (unsigned)Casters.size(); i += 4 )
+                {
+                    const float fAngle = 0.05f*uFrame + (float)i;
+                    Casters[i].CenterAndRadius.x = BaseCasters[i].CenterAndRadius.x + 60.0f*cosf( fAngle );
+                    Casters[i].CenterAndRadius.z = BaseCasters[i].CenterAndRadius.z + 60.0f*sinf( fAngle );
+                    Casters[i].bMoved = ( uFrame > 0 );
+                }
+
+                Serial.Update( Scene.mView, Scene.mProjection, &Casters[0], (unsigned)Casters.size(), NULL );
+
+                CPUBenchmarkTimer Timer;
+                Threaded.Update( Scene.mView, Scene.mProjection, &Casters[0], (unsigned)Casters.size(), &Scheduler );
+                fTime += Timer.GetSeconds();
+
+                bMatch = bMatch && ElementsMatch( Serial.GetFaceUpdates(), Threaded.GetFaceUpdates() );
+
+                // every face of the visible casters in a slot, rendered every frame
+                unsigned uAllPasses = 0;
+                for( unsigned i = 0; i < (unsigned)Casters.size(); i++ )
+                {
+                    if( Threaded.GetSlot( i ) != CPU_SHADOW_NO_SLOT && Threaded.GetImportance( i ) > 0.0f )
+                    {
+                        uAllPasses += ( Casters[i].uType == CPU_SHADOW_CASTER_POINT ) ? 6 : 1;
+                    }
+                }
+
+                const CPUShadowSchedulerStats& Stats = Threaded.GetStats();
+                bWithinBudget = bWithinBudget && ( Stats.uNumFaceUpdates <= Desc.uMaxFacesPerFrame ) && ( uAllPasses <= uNumSlottedFaces );
+                uNumVisible += Stats.uNumVisibleCasters;
+                uNumUnslotted += Stats.uNumUnslottedCasters;
+                uNumSlotChanges += Stats.uNumSlotChanges;
+                uNumPasses += Stats.uNumFaceUpdates;
+                uNumAllPasses += uAllPasses;
+                uNumStaleFaces += Stats.uNumStaleFaces;
+                uMaxPasses = std::max( uMaxPasses, Stats.uNumFaceUpdates );
+                uMaxStaleFrames = std::max( uMaxStaleFrames, Stats.uMaxStaleFrames );
+
+                if( uFrame % 40 == 0 || uFrame == NUM_PATH_FRAMES - 1 )
+                {
+                    FrameRow Row = { uFrame, uAllPasses, Stats };
+                    FrameRows.push_back( Row );
+                }
+            }
+
+            const bool bPathResult = bWithinBudget && bMatch;
+            bResult = bResult && bPathResult;
+
+            const double fFrames = (double)NUM_PATH_FRAMES;
+            fprintf( pReport, "%-8s %9.4f %9.1f %10.1f %9.2f %13.2f %11u %11.2f %11.2f %9u  %s\n",
+                Path.pName, fTime*1000.0 / fFrames, uNumVisible / fFrames, uNumUnslotted / fFrames, uNumSlotChanges / fFrames,
+                uNumPasses / fFrames, uMaxPasses, uNumAllPasses / fFrames, uNumStaleFaces / fFrames, uMaxStaleFrames,
+                GetCheckResult( bWithinBudget, bMatch ) );
+            for( size_t i = 0; i < FrameRows.size(); i++ )
+            {
+                const CPUShadowSchedulerStats& Stats = FrameRows[i].Stats;
+                fprintf( pReport, "  frame %3u: %3u visible, %3u unshadowed, %2u new slots, %2u passes (%2u for all), %3u stale faces, stale for up to %u frames\n",
+                    FrameRows[i].uFrame, Stats.uNumVisibleCasters, Stats.uNumUnslottedCasters, Stats.uNumSlotChanges, Stats.uNumFaceUpdates,
+                    FrameRows[i].uAllPasses, Stats.uNumStaleFaces, Stats.uMaxStaleFrames );
+            }
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Shadow atlas allocation: the atlas filled with tiles sized by each shadow-casting
+    // candidate's screen coverage from a few viewpoints, against the lights a fixed grid
+    // of 256x256 tiles would hold, and a long run of random allocations, frees and tier
+    // changes for packing efficiency and fragmentation, with the quadtrees and the tiles
+    // checked for overlaps along the way
+    //--------------------------------------------------------------------------------------
+
+    // The atlas' own consistency check, and no two tiles overlapping, on a grid of minimum-size cells
+    static bool CheckAtlasTiles( const CPUShadowAtlas& Atlas, const std::vector<unsigned>& Tiles )
+    {
+        const unsigned uCellSize = Atlas.GetDesc().uMinTileSize;
+        const unsigned uNumCellsX = Atlas.GetWidth() / uCellSize;
+        std::vector<unsigned char> Cells( (size_t)uNumCellsX*( Atlas.GetHeight() / uCellSize ), 0 );
+
+        unsigned long long uUsedArea = 0;
+        for( size_t i = 0; i < Tiles.size(); i++ )
+        {
+            const CPUShadowAtlasTile Tile = Atlas.GetTile( Tiles[i] );
+            for( unsigned y = Tile.uY / uCellSize; y < ( Tile.uY + Tile.uSize ) / uCellSize; y++ )
+            {
+                for( unsigned x = Tile.uX / uCellSize; x < ( Tile.uX + Tile.uSize ) / uCellSize; x++ )
+                {
+                    if( Cells[(size_t)y*uNumCellsX + x]++ != 0 )
+                    {
+                        return false;
+                    }
+                }
+            }
+            uUsedArea += (unsigned long long)Tile.uSize*Tile.uSize;
+        }
+
+        return Atlas.CheckConsistency() && uUsedArea == Atlas.GetStats().uUsedArea && Tiles.size() == Atlas.GetStats().uNumTiles;
+    }
+
+    // A random tier, smaller ones more likely: 40% 64, 30% 128, 20% 256, 8% 512, 2% 1024
+    static unsigned GetRandomShadowTileSize( unsigned& uState )
+    {
+        const unsigned uRandom = GetBenchmarkRandom( uState ) % 100;
+        return uRandom < 40 ? 64 : uRandom < 70 ? 128 : uRandom < 90 ? 256 : uRandom < 98 ? 512 : 1024;
+    }
+
+    static bool RunShadowAtlasBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config )
+    {
+        static const unsigned NUM_CASTERS_PER_TYPE = 256;
+        static const unsigned FIXED_TILE_SIZE = 256;
+        static const unsigned NUM_CHURN_OPS = 200000;
+        static const unsigned CHURN_CHECK_INTERVAL = 1000;
+
+        // point light faces from 64 to 512 texels in a 4096x2048 atlas, spot lights from 64 to 1024 in 2048x1024
+        static const unsigned kMaxTileSize[CPU_SHADOW_CASTER_NUM_TYPES] = { 512, 1024 };
+        static const unsigned kNumFaces[CPU_SHADOW_CASTER_NUM_TYPES] = { 6, 1 };
+        CPUShadowAtlasDesc AtlasDescs[CPU_SHADOW_CASTER_NUM_TYPES];
+        AtlasDescs[CPU_SHADOW_CASTER_POINT].uRootSize = 2048;
+        AtlasDescs[CPU_SHADOW_CASTER_POINT].uNumRootsX = 2;
+        AtlasDescs[CPU_SHADOW_CASTER_SPOT].uRootSize = 1024;
+        AtlasDescs[CPU_SHADOW_CASTER_SPOT].uNumRootsX = 2;
+
+        // the shadow scheduler benchmark's candidates, seen from its static camera and the four corners
+        CPUSceneDesc SceneDesc;
+        SceneDesc.uWidth = 160;
+        SceneDesc.uHeight = 90;
+        SceneDesc.uNumPointLights = NUM_CASTERS_PER_TYPE;
+        SceneDesc.uNumSpotLights = NUM_CASTERS_PER_TYPE;
+        SceneDesc.fLightRadiusScale = 2.0f;
+        CPUScene Scene;
+        CreateCPUScene( SceneDesc, Scene );
+        const CPUScene BaseScene = Scene;
+
+        fprintf( pReport, "\nshadow atlas, %u point and %u spot light candidates sized by screen coverage at %u pixels high, largest first; point faces in 4096x2048, spot lights in 2048x1024\n",
+            NUM_CASTERS_PER_TYPE, NUM_CASTERS_PER_TYPE, Config.uHeight );
+        fprintf( pReport, "%-8s %-6s %8s %9s %12s %9s %9s %9s %9s %9s  %s\n",
+            "view", "type", "visible", "shadowed", "MTexels req", "at size", "smaller", "dropped", "used", "fixed 256", "check" );
+
+        bool bResult = true;
+        for( unsigned uView = 0; uView < 5; uView++ )
+        {
+            float Eye[3], At[3];
+            GetShadowPathCamera( uView == 0 ? CPU_SHADOW_PATH_STATIC : CPU_SHADOW_PATH_CUTS, 40*( uView - ( uView > 0 ? 1 : 0 ) ), 240, BaseScene, Eye, At );
+            SetCPUSceneCamera( Scene, Eye, At );
+
+            for( unsigned uType = 0; uType < CPU_SHADOW_CASTER_NUM_TYPES; uType++ )
+            {
+                const std::vector<CPUFloat4>& Lights = ( uType == CPU_SHADOW_CASTER_POINT ) ? Scene.PointLightCenterAndRadius : Scene.SpotLightCenterAndRadius;
+
+                // visible candidates, largest coverage first
+                std::vector< std::pair<float, unsigned> > Visible;
+                for( unsigned i = 0; i < (unsigned)Lights.size(); i++ )
+                {
+                    float fDistance;
+                    const float fCoverage = CPUShadowScheduler::GetScreenCoverage( Scene.mView, Scene.mProjection, Lights[i], fDistance );
+                    if( fCoverage >= CPUShadowSchedulerDesc().fMinCoverage )
+                    {
+                        Visible.push_back( std::make_pair( -fCoverage, i ) );
+                    }
+                }
+                std::sort( Visible.begin(), Visible.end() );
+
+                // a light is shadowed if all of its faces get a tile, at the requested size or smaller
+                CPUShadowAtlas Atlas;
+                Atlas.Reset( AtlasDescs[uType] );
+                std::vector<unsigned> Tiles;
+                unsigned long long uRequestedArea = 0;
+                unsigned uNumShadowed = 0, uNumAtSize = 0, uNumSmaller = 0, uNumDropped = 0;
+                for( size_t i = 0; i < Visible.size(); i++ )
+                {
+                    const unsigned uSize = CPUShadowAtlas::GetTileSizeForCoverage( -Visible[i].first, Config.uHeight, 0, AtlasDescs[uType].uMinTileSize, kMaxTileSize[uType] );
+                    uRequestedArea += (unsigned long long)kNumFaces[uType]*uSize*uSize;
+
+                    unsigned LightTiles[6];
+                    unsigned uNumLightTiles = 0;
+                    while( uNumLightTiles < kNumFaces[uType] )
+                    {
+                        const unsigned uTile = Atlas.Allocate( uSize, true );
+                        if( uTile == CPU_SHADOW_ATLAS_NO_TILE )
+                        {
+                            break;
+                        }
+                        LightTiles[uNumLightTiles++] = uTile;
+                    }
+
+                    if( uNumLightTiles < kNumFaces[uType] )
+                    {
+                        for( unsigned uFace = 0; uFace < uNumLightTiles; uFace++ )
+                        {
+                            Atlas.Free( LightTiles[uFace] );
+                        }
+                        uNumDropped++;
+                        continue;
+                    }
+
+                    uNumShadowed++;
+                    for( unsigned uFace = 0; uFace < uNumLightTiles; uFace++ )
+                    {
+                        Tiles.push_back( LightTiles[uFace] );
+                        if( Atlas.GetTile( LightTiles[uFace] ).uSize == uSize ) uNumAtSize++; else uNumSmaller++;
+                    }
+                }
+
+                const unsigned long long uAtlasArea = (unsigned long long)Atlas.GetWidth()*Atlas.GetHeight();
+                const unsigned uNumFixedLights = (unsigned)( uAtlasArea / ( FIXED_TILE_SIZE*FIXED_TILE_SIZE ) ) / kNumFaces[uType];
+                const bool bMatch = CheckAtlasTiles( Atlas, Tiles );
+                bResult = bResult && bMatch;
+
+                fprintf( pReport, "%-8u %-6s %8u %9u %12.2f %9u %9u %9u %8.1f%% %9u  %s\n",
+                    uView, uType == CPU_SHADOW_CASTER_POINT ? "point" : "spot", (unsigned)Visible.size(), uNumShadowed, uRequestedArea / 1048576.0,
+                    uNumAtSize, uNumSmaller, uNumDropped, 100.0*Atlas.GetStats().uUsedArea / uAtlasArea,
+                    std::min( uNumFixedLights, (unsigned)Visible.size() ), GetCheckResult( bMatch ) );
+            }
+        }
+
+        // random tiers into an empty point atlas until the first one that does not fit
+        {
+            CPUShadowAtlas Atlas;
+            Atlas.Reset( AtlasDescs[CPU_SHADOW_CASTER_POINT] );
+            std::vector<unsigned> Tiles;
+            unsigned uState = 1;
+            unsigned long long uFailedArea = 0;
+            for( ;; )
+            {
+                const unsigned uSize = GetRandomShadowTileSize( uState );
+                const unsigned uTile = Atlas.Allocate( uSize, false );
+                if( uTile == CPU_SHADOW_ATLAS_NO_TILE )
+                {
+                    uFailedArea = (unsigned long long)uSize*uSize;
+                    break;
+                }
+                Tiles.push_back( uTile );
+            }
+
+            const bool bMatch = CheckAtlasTiles( Atlas, Tiles );
+            bResult = bResult && bMatch;
+            fprintf( pReport, "fill with random tiers (40%% 64, 30%% 128, 20%% 256, 8%% 512, 2%% 1024): %u tiles, %.1f%% used when a %ux%u tile did not fit  %s\n",
+                (unsigned)Tiles.size(), 100.0*Atlas.GetStats().uUsedArea / ( (double)Atlas.GetWidth()*Atlas.GetHeight() ),
+                (unsigned)sqrt( (double)uFailedArea ), (unsigned)sqrt( (double)uFailedArea ), GetCheckResult( bMatch ) );
+        }
+
+        // steady state: allocate while less than 75% of the area is used, otherwise free tiles or move them to neighboring tiers
+        {
+            CPUShadowAtlas Atlas;
+            Atlas.Reset( AtlasDescs[CPU_SHADOW_CASTER_POINT] );
+            const double fAtlasArea = (double)Atlas.GetWidth()*Atlas.GetHeight();
+            std::vector<unsigned> Tiles;
+            unsigned uState = 2;
+
+            double fTime = 0.0, fOccupancy = 0.0, fFragmentation = 0.0;
+            unsigned uNumAllocations = 0, uNumFailed = 0, uNumFragmented = 0, uNumReallocations = 0, uNumKept = 0;
+            bool bMatch = true;
+
+            for( unsigned uOp = 0; uOp < NUM_CHURN_OPS; uOp++ )
+            {
+                const unsigned uRandom = GetBenchmarkRandom( uState );
+                const unsigned uIndex = Tiles.empty() ? 0 : GetBenchmarkRandom( uState ) % (unsigned)Tiles.size();
+                const unsigned uSize = GetRandomShadowTileSize( uState );
+
+                CPUBenchmarkTimer Timer;
+                if( Tiles.empty() || Atlas.GetStats().uUsedArea < 0.75*fAtlasArea )
+                {
+                    // a failure with enough free area is due to fragmentation
+                    const unsigned uTile = Atlas.Allocate( uSize, false );
+                    uNumAllocations++;
+                    if( uTile == CPU_SHADOW_ATLAS_NO_TILE )
+                    {
+                        uNumFailed++;
+                        if( Atlas.GetStats().uFreeArea >= (unsigned long long)uSize*uSize )
+                        {
+                            uNumFragmented++;
+                        }
+                    }
+                    else
+                    {
+                        Tiles.push_back( uTile );
+                    }
+                }
+                else if( uRandom & 1 )
+                {
+                    const unsigned uOldSize = Atlas.GetTile( Tiles[uIndex] ).uSize;
+                    const unsigned uNewSize = ( uRandom & 8 ) ? std::min( uOldSize*2, 1024u ) : std::max( uOldSize / 2, 64u );
+                    Tiles[uIndex] = Atlas.Reallocate( Tiles[uIndex], uNewSize, false );
+                    uNumReallocations++;
+                    if( Atlas.GetTile( Tiles[uIndex] ).uSize != uNewSize )
+                    {
+                        uNumKept++;
+                    }
+                }
+                else
+                {
+                    Atlas.Free( Tiles[uIndex] );
+                    Tiles[uIndex] = Tiles.back();
+                    Tiles.pop_back();
+                }
+                fTime += Timer.GetSeconds();
+
+                // the share of the free area outside the largest free tile
+                const CPUShadowAtlasStats& Stats = Atlas.GetStats();
+                fOccupancy += Stats.uUsedArea / fAtlasArea;
+                if( Stats.uFreeArea > 0 )
+                {
+                    fFragmentation += 1.0 - (double)Stats.uLargestFreeSize*Stats.uLargestFreeSize / (double)Stats.uFreeArea;
+                }
+
+                if( uOp % CHURN_CHECK_INTERVAL == CHURN_CHECK_INTERVAL - 1 )
+                {
+                    bMatch = bMatch && CheckAtlasTiles( Atlas, Tiles );
+                }
+            }
+
+            bResult = bResult && bMatch;
+            fprintf( pReport, "churn, %u random allocations below 75%% of the area used, frees and tier changes above: %.1f ns/op, %.1f%% used and %.1f%% of the free area fragmented on average, "
+                "%u of %u allocations failed (%u with enough free area), %u of %u tier changes kept the old tile  %s\n",
+                NUM_CHURN_OPS, fTime*1e9 / NUM_CHURN_OPS, 100.0*fOccupancy / NUM_CHURN_OPS, 100.0*fFragmentation / NUM_CHURN_OPS,
+                uNumFailed, uNumAllocations, uNumFragmented, uNumKept, uNumReallocations, GetCheckResult( bMatch ) );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Shadow caster culling for the sample's default light rig, the shadow-casting lights of
+    // LightUtil::InitLights: the draws the point light faces and spot lights submit when
+    // every pass renders every caster, against the draws left after culling the casters by
+    // the lights' spheres and the faces' frusta. The casters are the CPU scene's room in
+    // sections and its pillars, standing in for the Sponza subsets, and the grid objects.
+    // Checks the draw lists against a test of every box corner in double precision, and
+    // that threading does not change them.
+    //--------------------------------------------------------------------------------------
+    // The box touches the sphere, and no plane has all eight corners outside it
+    static bool IsShadowCasterVisible( const CPUFloat4& Center, const CPUFloat4& Extents, const CPUFloat4& Sphere, const CPUFloat4 Planes[6] )
+    {
+        double fDistanceSq = 0.0;
+        for( int i = 0; i < 3; i++ )
+        {
+            const double fOffset = std::max( fabs( (double)(&Center.x)[i] - (&Sphere.x)[i] ) - (&Extents.x)[i], 0.0 );
+            fDistanceSq += fOffset*fOffset;
+        }
+        if( fDistanceSq > (double)Sphere.w*Sphere.w )
+        {
+            return false;
+        }
+
+        for( int p = 0; p < 6; p++ )
+        {
+            bool bAllOutside = true;
+            for( int nCorner = 0; nCorner < 8 && bAllOutside; nCorner++ )
+            {
+                const double x = (double)Center.x + ( ( nCorner & 1 ) ? Extents.x : -Extents.x );
+                const double y = (double)Center.y + ( ( nCorner & 2 ) ? Extents.y : -Extents.y );
+                const double z = (double)Center.z + ( ( nCorner & 4 ) ? Extents.z : -Extents.z );
+                bAllOutside = ( Planes[p].x*x + Planes[p].y*y + Planes[p].z*z + Planes[p].w < 0.0 );
+            }
+            if( bAllOutside )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static bool RunShadowCasterCullingBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kNumLights = 12;
+        static const unsigned kNumFaces[2] = { 6, 1 };
+
+        std::vector<CPUFloat4> Centers, Extents;
+        const unsigned uNumRoomCasters = GetDefaultShadowCasters( Centers, Extents );
+        const unsigned uNumCasters = (unsigned)Centers.size();
+
+        std::vector<CPUFloat4> PointLights, SpotLights, LookAts, SpotSpheres, Planes;
+        std::vector<CPUMatrix> ViewProj;
+        GetDefaultShadowLights( PointLights, SpotLights, LookAts );
+        CalcShadowCasterFaces( PointLights, SpotLights, LookAts, ViewProj, Planes, SpotSpheres );
+
+        fprintf( pReport, "\nshadow caster culling, the default light rig against %u room walls and pillars and %u grid objects, draws with every caster in every pass and after culling, %u threads\n",
+            uNumRoomCasters, uNumCasters - uNumRoomCasters, Scheduler.GetNumThreads() );
+        fprintf( pReport, "%-8s %7s %7s %8s %10s %10s %10s %8s %9s %8s %8s %10s %12s  %s\n", "type", "lights", "faces", "casters", "before", "in range", "after", "after %",
+            "max/face", "missing", "extra", "us serial", "us threaded", "check" );
+
+        const unsigned uNumIterations = std::max( Config.uNumFrames, 1u )*1000;
+
+        bool bResult = true;
+        unsigned long long uTotalBefore = 0, uTotalAfter = 0;
+        for( int nType = 0; nType < 2; nType++ )
+        {
+            const bool bPoint = ( nType == 0 );
+            const CPUFloat4* pSpheres = bPoint ? &PointLights[0] : &SpotSpheres[0];
+            const CPUFloat4* pPlanes = bPoint ? &Planes[0] : &Planes[6*6*kNumLights];
+            const unsigned uNumFaces = kNumFaces[nType];
+
+            // serial, then threaded
+            CPUShadowCasterCuller Cullers[2];
+            double fTime[2] = { 0.0, 0.0 };
+            for( int nPath = 0; nPath < 2; nPath++ )
+            {
+                CPUTaskScheduler* pScheduler = ( nPath == 1 ) ? &Scheduler : NULL;
+                Cullers[nPath].SetCasters( &Centers[0], &Extents[0], uNumCasters );
+
+                // (the first iteration warms up)
+                Cullers[nPath].CullCasters( pSpheres, pPlanes, kNumLights, uNumFaces, pScheduler );
+                CPUBenchmarkTimer Timer;
+                for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+                {
+                    Cullers[nPath].CullCasters( pSpheres, pPlanes, kNumLights, uNumFaces, pScheduler );
+                }
+                fTime[nPath] = Timer.GetSeconds() / uNumIterations;
+            }
+
+            // every caster the reference keeps is drawn; the extra draws are the reference's rounding
+            unsigned long long uNumMissing = 0, uNumExtra = 0;
+            bool bMatch = true;
+            std::vector<unsigned char> bDrawn( uNumCasters );
+            for( unsigned uLight = 0; uLight < kNumLights; uLight++ )
+            {
+                for( unsigned uFace = 0; uFace < uNumFaces; uFace++ )
+                {
+                    unsigned uNumDraws, uNumThreadedDraws;
+                    const unsigned* pDraws = Cullers[0].GetDrawList( uLight, uFace, uNumDraws );
+                    const unsigned* pThreadedDraws = Cullers[1].GetDrawList( uLight, uFace, uNumThreadedDraws );
+                    bMatch = bMatch && ( uNumDraws == uNumThreadedDraws ) && ElementsMatch( pDraws, pThreadedDraws, uNumDraws );
+
+                    std::fill( bDrawn.begin(), bDrawn.end(), (unsigned char)0 );
+                    for( unsigned i = 0; i < uNumDraws; i++ )
+                    {
+                        bDrawn[pDraws[i]] = 1;
+                    }
+
+                    const CPUFloat4* pFacePlanes = &pPlanes[6*( uLight*uNumFaces + uFace )];
+                    for( unsigned i = 0; i < uNumCasters; i++ )
+                    {
+                        const bool bVisible = IsShadowCasterVisible( Centers[i], Extents[i], pSpheres[uLight], pFacePlanes );
+                        uNumMissing += ( bVisible && !bDrawn[i] ) ? 1 : 0;
+                        uNumExtra += ( !bVisible && bDrawn[i] ) ? 1 : 0;
+                    }
+                }
+            }
+
+            const bool bCorrect = ( uNumMissing == 0 );
+            bResult = bResult && bCorrect && bMatch;
+
+            const CPUShadowCasterCullingStats& Stats = Cullers[0].GetStats();
+            uTotalBefore += Stats.uNumDrawsBefore;
+            uTotalAfter += Stats.uNumDrawsAfter;
+            fprintf( pReport, "%-8s %7u %7u %8u %10llu %10llu %10llu %7.1f%% %9u %8llu %8llu %10.2f %12.2f  %s\n", bPoint ? "point" : "spot", kNumLights, Stats.uNumFaces, uNumCasters,
+                Stats.uNumDrawsBefore, Stats.uNumDrawsInRange, Stats.uNumDrawsAfter, 100.0*Stats.uNumDrawsAfter / std::max( Stats.uNumDrawsBefore, 1ull ), Stats.uMaxDrawsPerFace,
+                uNumMissing, uNumExtra, fTime[0]*1e6, fTime[1]*1e6, GetCheckResult( bCorrect, bMatch ) );
+        }
+
+        fprintf( pReport, "all shadow passes: %llu draws before, %llu after (%.1f%%)\n", uTotalBefore, uTotalAfter, 100.0*uTotalAfter / std::max( uTotalBefore, 1ull ) );
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Static shadow caching for the default light rig over a scripted sequence of frames:
+    // two point lights move every frame and a spot light now and then, a few dynamic casters
+    // walk through the room, some grid objects are hidden and then all of them changed, and
+    // some atlas tiles are resized. Each face's static copy and shadow map are simulated as
+    // the casters (and their versions) drawn into them, and checked every frame against
+    // what rendering everything again would give; a face that renders its static casters
+    // again must have needed to, and one that does not must still be up to date.
+    //--------------------------------------------------------------------------------------
+    struct SimulatedShadowMap
+    {
+        bool                                bValid;
+        CPUMatrix                           ViewProj;
+        CPUShadowAtlasTile                  Tile;
+        std::vector<unsigned long long>     Casters;    // caster index << 32 | version
+    };
+
+    static bool IsSameShadowMap( const SimulatedShadowMap& A, const SimulatedShadowMap& B )
+    {
+        return A.bValid == B.bValid && ElementsMatch( &A.ViewProj, &B.ViewProj, 1 ) &&
+            A.Tile.uX == B.Tile.uX && A.Tile.uY == B.Tile.uY && A.Tile.uSize == B.Tile.uSize && A.Casters == B.Casters;
+    }
+
+    static void AddSimulatedCasters( const unsigned* pCasters, unsigned uNumCasters, const std::vector<unsigned>& Versions, SimulatedShadowMap& Map )
+    {
+        for( unsigned i = 0; i < uNumCasters; i++ )
+        {
+            Map.Casters.push_back( ( (unsigned long long)pCasters[i] << 32 ) | Versions[pCasters[i]] );
+        }
+    }
+
+    static bool RunShadowCacheBenchmark( FILE* pReport )
+    {
+        static const unsigned kNumLights = 12;
+        static const unsigned kNumFaces[2] = { 6, 1 };
+        static const unsigned kNumFrames = 120;
+        static const unsigned kNumDynamicCasters = 4;
+        static const unsigned kNumHiddenGridObjects = 80;
+        static const unsigned kHideFrame = 30;
+        static const unsigned kChangeGridFrame = 60;
+        static const unsigned kResizeFrame = 90;
+
+        std::vector<CPUFloat4> Centers, Extents;
+        const unsigned uNumRoomCasters = GetDefaultShadowCasters( Centers, Extents );
+        const unsigned uFirstDynamicCaster = (unsigned)Centers.size();
+        const unsigned uNumCasters = uFirstDynamicCaster + kNumDynamicCasters;
+        Centers.resize( uNumCasters );
+        Extents.resize( uNumCasters );
+
+        std::vector<CPUFloat4> BasePointLights, BaseSpotLights, LookAts;
+        GetDefaultShadowLights( BasePointLights, BaseSpotLights, LookAts );
+
+        fprintf( pReport, "\nshadow cache, the default light rig over %u frames: point lights 0 and 1 move every frame and spot light 3 every 20, %u dynamic casters, %u of %u grid objects hidden at frame %u, all changed at frame %u, point light 5's and spot light 7's tiles resized at frame %u\n",
+            kNumFrames, kNumDynamicCasters, kNumHiddenGridObjects, (unsigned)MAX_NUM_GRID_OBJECTS, kHideFrame, kChangeGridFrame, kResizeFrame );
+        fprintf( pReport, "%-8s %8s %7s %7s %6s %6s %6s %7s %8s %10s %10s %10s %9s %7s %7s %10s  %s\n", "type", "lookups", "hits", "hit %", "cold", "light", "tile", "caster",
+            "rebuilt", "static", "uncached", "dynamic", "unneeded", "missed", "stale", "us/update", "check" );
+
+        bool bResult = true;
+        for( int nType = 0; nType < 2; nType++ )
+        {
+            const bool bPoint = ( nType == 0 );
+            const unsigned uNumFaces = kNumFaces[nType];
+            const unsigned uNumLightFaces = kNumLights*uNumFaces;
+
+            CPUShadowCasterCuller Culler;
+            CPUShadowCache Cache;
+            Cache.Reset( uNumCasters );
+            for( unsigned i = uFirstDynamicCaster; i < uNumCasters; i++ )
+            {
+                Cache.SetCasterDynamic( i, true );
+            }
+
+            // the versions of the casters as this benchmark changes them, and the simulated maps
+            std::vector<unsigned> Versions( uNumCasters, 0 );
+            std::vector<SimulatedShadowMap> StaticCopies( uNumLightFaces ), ShadowMaps( uNumLightFaces );
+            for( unsigned i = 0; i < uNumLightFaces; i++ )
+            {
+                StaticCopies[i].bValid = false;
+                ShadowMaps[i].bValid = false;
+            }
+
+            std::vector<CPUShadowAtlasTile> Tiles( uNumLightFaces );
+            std::vector<CPUMatrix> FaceViewProj( uNumLightFaces );
+            std::vector<CPUFloat4> PointLights = BasePointLights, SpotLights = BaseSpotLights;
+            std::vector<CPUFloat4> SpotSpheres, Planes;
+            std::vector<CPUMatrix> ViewProj;
+
+            unsigned long long uNumUncachedDraws = 0, uNumUnneeded = 0, uNumMissed = 0, uNumStale = 0;
+            unsigned long long uNumColdMisses = 0, uNumLightMisses = 0, uNumTileMisses = 0, uNumCasterMisses = 0;
+            unsigned long long uNumComposites = 0, uNumStaticDraws = 0, uNumDynamicDraws = 0;
+            double fUpdateTime = 0.0;
+
+            for( unsigned uFrame = 0; uFrame < kNumFrames; uFrame++ )
+            {
+                // the moving lights, and the tiles
+                for( unsigned i = 0; i < 2; i++ )
+                {
+                    const float fAngle = 0.1f*(float)uFrame + 3.0f*(float)i;
+                    PointLights[i].x = BasePointLights[i].x + 40.0f*cosf( fAngle );
+                    PointLights[i].z = BasePointLights[i].z + 40.0f*sinf( fAngle );
+                }
+                SpotLights[3].x = BaseSpotLights[3].x + 10.0f*(float)( ( uFrame + 10 ) / 20 );
+                for( unsigned i = 0; i < uNumLightFaces; i++ )
+                {
+                    const unsigned uLight = i / uNumFaces;
+                    const bool bResized = ( uFrame >= kResizeFrame && uLight == ( bPoint ? 5u : 7u ) );
+                    Tiles[i].uX = ( i % 16 )*256;
+                    Tiles[i].uY = ( i / 16 )*256;
+                    Tiles[i].uSize = bResized ? 128 : 256;
+                }
+
+                // the dynamic casters walk along x, and change every frame
+                for( unsigned k = 0; k < kNumDynamicCasters; k++ )
+                {
+                    const unsigned i = uFirstDynamicCaster + k;
+                    const CPUFloat4 Center = { -1200.0f + (float)( ( uFrame*20 + k*600 ) % 2400 ), 60.0f, -120.0f + 80.0f*(float)k, 1.0f };
+                    const CPUFloat4 Extent = { 15.0f, 60.0f, 15.0f, 0.0f };
+                    Centers[i] = Center;
+                    Extents[i] = Extent;
+                    Versions[i]++;
+                }
+
+                // the static casters that change, as the grid object slider and triangle density would
+                if( uFrame == kHideFrame || uFrame == kChangeGridFrame )
+                {
+                    const unsigned uFirst = uNumRoomCasters + ( uFrame == kHideFrame ? (unsigned)MAX_NUM_GRID_OBJECTS - kNumHiddenGridObjects : 0 );
+                    for( unsigned i = uFirst; i < uNumRoomCasters + (unsigned)MAX_NUM_GRID_OBJECTS; i++ )
+                    {
+                        Cache.InvalidateCaster( i );
+                        Versions[i]++;
+                    }
+                }
+
+                CalcShadowCasterFaces( PointLights, SpotLights, LookAts, ViewProj, Planes, SpotSpheres );
+                const unsigned uFirstFace = bPoint ? 0 : 6*kNumLights;
+                std::copy( ViewProj.begin() + uFirstFace, ViewProj.begin() + uFirstFace + uNumLightFaces, FaceViewProj.begin() );
+
+                Culler.SetCasters( &Centers[0], &Extents[0], uNumCasters );
+                Culler.CullCasters( bPoint ? &PointLights[0] : &SpotSpheres[0], &Planes[6*uFirstFace], kNumLights, uNumFaces, NULL );
+
+                CPUBenchmarkTimer Timer;
+                Cache.Update( Culler, &FaceViewProj[0], &Tiles[0], kNumLights, uNumFaces );
+                fUpdateTime += Timer.GetSeconds();
+
+                const CPUShadowCacheStats& Stats = Cache.GetStats();
+                uNumColdMisses += Stats.uNumColdMisses;
+                uNumLightMisses += Stats.uNumLightMisses;
+                uNumTileMisses += Stats.uNumTileMisses;
+                uNumCasterMisses += Stats.uNumCasterMisses;
+                uNumComposites += Stats.uNumComposites;
+                uNumStaticDraws += Stats.uNumStaticDraws;
+                uNumDynamicDraws += Stats.uNumDynamicDraws;
+
+                // render what the cache asks for, and compare with rendering everything
+                for( unsigned uLight = 0; uLight < kNumLights; uLight++ )
+                {
+                    for( unsigned uFace = 0; uFace < uNumFaces; uFace++ )
+                    {
+                        const unsigned uIndex = uLight*uNumFaces + uFace;
+
+                        unsigned uNumDraws;
+                        const unsigned* pDraws = Culler.GetDrawList( uLight, uFace, uNumDraws );
+                        uNumUncachedDraws += uNumDraws;
+
+                        SimulatedShadowMap ExpectedCopy;
+                        ExpectedCopy.bValid = true;
+                        ExpectedCopy.ViewProj = FaceViewProj[uIndex];
+                        ExpectedCopy.Tile = Tiles[uIndex];
+                        SimulatedShadowMap ExpectedMap = ExpectedCopy;
+                        for( unsigned i = 0; i < uNumDraws; i++ )
+                        {
+                            const unsigned long long uEntry = ( (unsigned long long)pDraws[i] << 32 ) | Versions[pDraws[i]];
+                            if( pDraws[i] < uFirstDynamicCaster )
+                            {
+                                ExpectedCopy.Casters.push_back( uEntry );
+                            }
+                        }
+                        ExpectedMap.Casters = ExpectedCopy.Casters;
+                        for( unsigned i = 0; i < uNumDraws; i++ )
+                        {
+                            if( pDraws[i] >= uFirstDynamicCaster )
+                            {
+                                ExpectedMap.Casters.push_back( ( (unsigned long long)pDraws[i] << 32 ) | Versions[pDraws[i]] );
+                            }
+                        }
+
+                        const bool bNeeded = !IsSameShadowMap( StaticCopies[uIndex], ExpectedCopy );
+                        const bool bRendered = Cache.NeedsStaticRender( uLight, uFace );
+                        uNumUnneeded += ( bRendered && !bNeeded ) ? 1 : 0;
+                        uNumMissed += ( !bRendered && bNeeded ) ? 1 : 0;
+
+                        unsigned uNumCasterDraws;
+                        const unsigned* pCasterDraws;
+                        if( bRendered )
+                        {
+                            SimulatedShadowMap& Copy = StaticCopies[uIndex];
+                            Copy.bValid = true;
+                            Copy.ViewProj = FaceViewProj[uIndex];
+                            Copy.Tile = Tiles[uIndex];
+                            Copy.Casters.clear();
+                            pCasterDraws = Cache.GetStaticDrawList( uLight, uFace, uNumCasterDraws );
+                            AddSimulatedCasters( pCasterDraws, uNumCasterDraws, Versions, Copy );
+                        }
+
+                        if( Cache.NeedsComposite( uLight, uFace ) )
+                        {
+                            ShadowMaps[uIndex] = StaticCopies[uIndex];
+                            pCasterDraws = Cache.GetDynamicDrawList( uLight, uFace, uNumCasterDraws );
+                            AddSimulatedCasters( pCasterDraws, uNumCasterDraws, Versions, ShadowMaps[uIndex] );
+                        }
+
+                        uNumStale += IsSameShadowMap( ShadowMaps[uIndex], ExpectedMap ) ? 0 : 1;
+                    }
+                }
+            }
+
+            const CPUShadowCacheStats& Stats = Cache.GetStats();
+            const bool bCorrect = ( uNumMissed == 0 && uNumStale == 0 );
+            const bool bExact = ( uNumUnneeded == 0 );
+            bResult = bResult && bCorrect && bExact;
+
+            fprintf( pReport, "%-8s %8llu %7llu %6.1f%% %6llu %6llu %6llu %7llu %8llu %10llu %10llu %10llu %9llu %7llu %7llu %10.2f  %s\n", bPoint ? "point" : "spot",
+                Stats.uTotalLookups, Stats.uTotalHits, 100.0*Stats.uTotalHits / std::max( Stats.uTotalLookups, 1ull ), uNumColdMisses, uNumLightMisses, uNumTileMisses, uNumCasterMisses,
+                uNumComposites, uNumStaticDraws, uNumUncachedDraws, uNumDynamicDraws, uNumUnneeded, uNumMissed, uNumStale, fUpdateTime*1e6 / kNumFrames,
+                GetCheckResult( bCorrect, bExact ) );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Shadows
+    //--------------------------------------------------------------------------------------
+    bool RunShadowBenchmarks( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        bool bResult = true;
+
+        if( !RunShadowMatrixBenchmark( pReport, Config, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunShadowSchedulerBenchmark( pReport, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunShadowAtlasBenchmark( pReport, Config ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunShadowCasterCullingBenchmark( pReport, Config, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunShadowCacheBenchmark( pReport ) )
+        {
+            bResult = false;
+        }
+
+        return bResult;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,313 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPUBenchmarkUtil.cpp
+//
+// Helpers shared by the parts of the headless CPU benchmark.
+//--------------------------------------------------------------------------------------
+
+#include "CPUBenchmarkUtil.h"
+#include "CPUScene.h"
+#include "CPUShadowCasterCulling.h"
+#include "CPUShadowMatrices.h"
+#include "CommonConstants.h"
+#include "DefaultScene.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace TiledLighting11
+{
+    //--------------------------------------------------------------------------------------
+    // Open a report, or stdout for an empty path
+    //--------------------------------------------------------------------------------------
+    FILE* OpenReport( const std::string& Path )
+    {
+        if( Path.empty() )
+        {
+            return stdout;
+        }
+
+        FILE* pFile = NULL;
+#if defined(_MSC_VER)
+        if( fopen_s( &pFile, Path.c_str(), "w" ) != 0 )
+        {
+            pFile = NULL;
+        }
+#else
+        pFile = fopen( Path.c_str(), "w" );
+#endif
+        return pFile;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Copy the dirty ranges of a pool attribute to a copy of the buffer, as the upload would
+    //--------------------------------------------------------------------------------------
+    size_t UploadDirtyRanges( const CPULightPool& Pool, unsigned uAttribute, size_t uElementSize, unsigned uMaxGap,
+        std::vector<CPULightPoolRange>& Ranges, std::vector<unsigned char>& Buffer )
+    {
+        Pool.GetDirtyRanges( uAttribute, uMaxGap, Ranges );
+        if( Buffer.size() < Pool.GetCount()*uElementSize )
+        {
+            Buffer.resize( Pool.GetCount()*uElementSize );
+        }
+
+        size_t uBytes = 0;
+        const unsigned char* pData = (const unsigned char*)Pool.GetData( uAttribute );
+        for( size_t i = 0; i < Ranges.size(); i++ )
+        {
+            memcpy( &Buffer[Ranges[i].uFirst*uElementSize], pData + Ranges[i].uFirst*uElementSize, Ranges[i].uCount*uElementSize );
+            uBytes += Ranges[i].uCount*uElementSize;
+        }
+        return uBytes;
+    }
+
+    // The grid objects as CommonUtil lays them out, see DefaultScene.h
+    static void GetGridObjectBounds( unsigned uGrid, CPUFloat4& Center, CPUFloat4& Extents )
+    {
+        GetGridObjectCenter( (int)uGrid, &Center.x );
+        Center.w = 1.0f;
+        Extents.x = 0.0f;
+        Extents.y = 0.5f*GRID_OBJECT_SIZE;
+        Extents.z = 0.5f*GRID_OBJECT_SIZE;
+        Extents.w = 0.0f;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // The casters of the default light rig's benchmarks
+    //--------------------------------------------------------------------------------------
+    unsigned GetDefaultShadowCasters( std::vector<CPUFloat4>& Centers, std::vector<CPUFloat4>& Extents )
+    {
+        static const unsigned kNumRoomSections = 8;
+
+        GetCPUSceneCasterBounds( kNumRoomSections, Centers, Extents );
+        const unsigned uNumRoomCasters = (unsigned)Centers.size();
+        for( unsigned i = 0; i < (unsigned)MAX_NUM_GRID_OBJECTS; i++ )
+        {
+            CPUFloat4 Center, Extent;
+            GetGridObjectBounds( i, Center, Extent );
+            Centers.push_back( Center );
+            Extents.push_back( Extent );
+        }
+
+        return uNumRoomCasters;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The default light rig's shadow-casting lights
+    //--------------------------------------------------------------------------------------
+    void GetDefaultShadowLights( std::vector<CPUFloat4>& PointLights, std::vector<CPUFloat4>& SpotLights, std::vector<CPUFloat4>& LookAts )
+    {
+        PointLights.resize( MAX_NUM_SHADOWCASTING_POINTS );
+        for( int i = 0; i < MAX_NUM_SHADOWCASTING_POINTS; i++ )
+        {
+            const float* pPoint = g_DefaultShadowCastingPointLights[i].CenterAndRadius;
+            const CPUFloat4 Point = { pPoint[0], pPoint[1], pPoint[2], pPoint[3] };
+            PointLights[i] = Point;
+        }
+
+        SpotLights.resize( MAX_NUM_SHADOWCASTING_SPOTS );
+        LookAts.resize( MAX_NUM_SHADOWCASTING_SPOTS );
+        for( int i = 0; i < MAX_NUM_SHADOWCASTING_SPOTS; i++ )
+        {
+            const float* pSpot = g_DefaultShadowCastingSpotLights[i].PositionAndRadius;
+            const float* pLookAt = g_DefaultShadowCastingSpotLights[i].LookAt;
+            const CPUFloat4 Spot = { pSpot[0], pSpot[1], pSpot[2], pSpot[3] };
+            const CPUFloat4 LookAt = { pLookAt[0], pLookAt[1], pLookAt[2], 1.0f };
+            SpotLights[i] = Spot;
+            LookAts[i] = LookAt;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The shadow cameras, frustum planes and spot light spheres of the lights
+    //--------------------------------------------------------------------------------------
+    void CalcShadowCasterFaces( const std::vector<CPUFloat4>& PointLights, const std::vector<CPUFloat4>& SpotLights, const std::vector<CPUFloat4>& LookAts,
+        std::vector<CPUMatrix>& ViewProj, std::vector<CPUFloat4>& Planes, std::vector<CPUFloat4>& SpotSpheres )
+    {
+        const unsigned uNumPointLights = (unsigned)PointLights.size();
+        const unsigned uNumSpotLights = (unsigned)SpotLights.size();
+        const unsigned uNumFaces = 6*uNumPointLights + uNumSpotLights;
+
+        SpotSpheres.resize( uNumSpotLights );
+        for( unsigned i = 0; i < uNumSpotLights; i++ )
+        {
+            const CPUFloat4& Spot = SpotLights[i];
+            const float Dir[3] = { LookAts[i].x - Spot.x, LookAts[i].y - Spot.y, LookAts[i].z - Spot.z };
+            const float fScale = Spot.w / sqrtf( Dir[0]*Dir[0] + Dir[1]*Dir[1] + Dir[2]*Dir[2] );
+            const CPUFloat4 Sphere = { Spot.x + Dir[0]*fScale, Spot.y + Dir[1]*fScale, Spot.z + Dir[2]*fScale, Spot.w };
+            SpotSpheres[i] = Sphere;
+        }
+
+        std::vector<CPUMatrix> ViewProjInv( uNumFaces );
+        ViewProj.resize( uNumFaces );
+        CalcCPUPointLightShadowMatrices( &PointLights[0], uNumPointLights, &ViewProj[0], &ViewProjInv[0], CPU_SIMD_AUTO, NULL );
+        CalcCPUSpotLightShadowMatrices( &SpotLights[0], &LookAts[0], uNumSpotLights, &ViewProj[6*uNumPointLights], &ViewProjInv[6*uNumPointLights], CPU_SIMD_AUTO, NULL );
+
+        // the matrices are transposed for the shaders; the planes come from the untransposed ones
+        Planes.resize( 6*uNumFaces );
+        for( unsigned i = 0; i < uNumFaces; i++ )
+        {
+            CPUMatrix m;
+            for( int r = 0; r < 4; r++ )
+            {
+                for( int c = 0; c < 4; c++ )
+                {
+                    m.m[r][c] = ViewProj[i].m[c][r];
+                }
+            }
+            CPUShadowCasterCuller::ExtractFrustumPlanes( m, &Planes[6*i] );
+        }
+    }
+
+    static const float kShadowFaceDir[6][3] = { { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 0.0f, 1.0f } };
+    static const float kShadowFaceUp[6][3] = { { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+
+    // XMMatrixLookAtLH( Eye, LookAt, Up ) * XMMatrixPerspectiveFovLH( fov, 1, CPU_SHADOW_NEAR_Z, fFarZ )
+    template<typename T>
+    static void CalcLookAtPerspective( const T Eye[3], const T LookAt[3], const float Up[3], double fFovDegrees, T fFarZ, T ViewProj[4][4] )
+    {
+        T z[3] = { LookAt[0] - Eye[0], LookAt[1] - Eye[1], LookAt[2] - Eye[2] };
+        const T fLengthZ = (T)sqrt( z[0]*z[0] + z[1]*z[1] + z[2]*z[2] );
+        for( int i = 0; i < 3; i++ ) z[i] /= fLengthZ;
+
+        T x[3] = { Up[1]*z[2] - Up[2]*z[1], Up[2]*z[0] - Up[0]*z[2], Up[0]*z[1] - Up[1]*z[0] };
+        const T fLengthX = (T)sqrt( x[0]*x[0] + x[1]*x[1] + x[2]*x[2] );
+        for( int i = 0; i < 3; i++ ) x[i] /= fLengthX;
+
+        const T y[3] = { z[1]*x[2] - z[2]*x[1], z[2]*x[0] - z[0]*x[2], z[0]*x[1] - z[1]*x[0] };
+
+        const T View[4][4] =
+        {
+            { x[0], y[0], z[0], 0 },
+            { x[1], y[1], z[1], 0 },
+            { x[2], y[2], z[2], 0 },
+            { -( x[0]*Eye[0] + x[1]*Eye[1] + x[2]*Eye[2] ), -( y[0]*Eye[0] + y[1]*Eye[1] + y[2]*Eye[2] ), -( z[0]*Eye[0] + z[1]*Eye[1] + z[2]*Eye[2] ), 1 },
+        };
+
+        const T h = (T)( 1.0 / tan( fFovDegrees*( 3.14159265358979323846 / 360.0 ) ) );
+        const T q = fFarZ / ( fFarZ - (T)CPU_SHADOW_NEAR_Z );
+        const T Proj[4][4] = { { h, 0, 0, 0 }, { 0, h, 0, 0 }, { 0, 0, q, 1 }, { 0, 0, -q*(T)CPU_SHADOW_NEAR_Z, 0 } };
+
+        for( int i = 0; i < 4; i++ )
+        {
+            for( int j = 0; j < 4; j++ )
+            {
+                ViewProj[i][j] = View[i][0]*Proj[0][j] + View[i][1]*Proj[1][j] + View[i][2]*Proj[2][j] + View[i][3]*Proj[3][j];
+            }
+        }
+    }
+
+    // the adjugate over the determinant, from 2x2 sub-determinants, as XMMatrixInverse does it
+    template<typename T>
+    static void InvertMatrix( const T a[4][4], T Inv[4][4] )
+    {
+        const T s0 = a[0][0]*a[1][1] - a[1][0]*a[0][1];
+        const T s1 = a[0][0]*a[1][2] - a[1][0]*a[0][2];
+        const T s2 = a[0][0]*a[1][3] - a[1][0]*a[0][3];
+        const T s3 = a[0][1]*a[1][2] - a[1][1]*a[0][2];
+        const T s4 = a[0][1]*a[1][3] - a[1][1]*a[0][3];
+        const T s5 = a[0][2]*a[1][3] - a[1][2]*a[0][3];
+        const T c5 = a[2][2]*a[3][3] - a[3][2]*a[2][3];
+        const T c4 = a[2][1]*a[3][3] - a[3][1]*a[2][3];
+        const T c3 = a[2][1]*a[3][2] - a[3][1]*a[2][2];
+        const T c2 = a[2][0]*a[3][3] - a[3][0]*a[2][3];
+        const T c1 = a[2][0]*a[3][2] - a[3][0]*a[2][2];
+        const T c0 = a[2][0]*a[3][1] - a[3][0]*a[2][1];
+        const T fInvDet = 1 / ( s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0 );
+
+        Inv[0][0] = (  a[1][1]*c5 - a[1][2]*c4 + a[1][3]*c3 )*fInvDet;
+        Inv[0][1] = ( -a[0][1]*c5 + a[0][2]*c4 - a[0][3]*c3 )*fInvDet;
+        Inv[0][2] = (  a[3][1]*s5 - a[3][2]*s4 + a[3][3]*s3 )*fInvDet;
+        Inv[0][3] = ( -a[2][1]*s5 + a[2][2]*s4 - a[2][3]*s3 )*fInvDet;
+        Inv[1][0] = ( -a[1][0]*c5 + a[1][2]*c2 - a[1][3]*c1 )*fInvDet;
+        Inv[1][1] = (  a[0][0]*c5 - a[0][2]*c2 + a[0][3]*c1 )*fInvDet;
+        Inv[1][2] = ( -a[3][0]*s5 + a[3][2]*s2 - a[3][3]*s1 )*fInvDet;
+        Inv[1][3] = (  a[2][0]*s5 - a[2][2]*s2 + a[2][3]*s1 )*fInvDet;
+        Inv[2][0] = (  a[1][0]*c4 - a[1][1]*c2 + a[1][3]*c0 )*fInvDet;
+        Inv[2][1] = ( -a[0][0]*c4 + a[0][1]*c2 - a[0][3]*c0 )*fInvDet;
+        Inv[2][2] = (  a[3][0]*s4 - a[3][1]*s2 + a[3][3]*s0 )*fInvDet;
+        Inv[2][3] = ( -a[2][0]*s4 + a[2][1]*s2 - a[2][3]*s0 )*fInvDet;
+        Inv[3][0] = ( -a[1][0]*c3 + a[1][1]*c1 - a[1][2]*c0 )*fInvDet;
+        Inv[3][1] = (  a[0][0]*c3 - a[0][1]*c1 + a[0][2]*c0 )*fInvDet;
+        Inv[3][2] = ( -a[3][0]*s3 + a[3][1]*s1 - a[3][2]*s0 )*fInvDet;
+        Inv[3][3] = (  a[2][0]*s3 - a[2][1]*s1 + a[2][2]*s0 )*fInvDet;
+    }
+
+    // both matrices transposed, as LightUtil stored them
+    template<typename T>
+    static void CalcGeneralShadowMatrix( const T Eye[3], const T LookAt[3], const float Up[3], double fFovDegrees, T fFarZ, T ViewProj[4][4], T ViewProjInv[4][4] )
+    {
+        T VP[4][4], Inv[4][4];
+        CalcLookAtPerspective( Eye, LookAt, Up, fFovDegrees, fFarZ, VP );
+        InvertMatrix( VP, Inv );
+        for( int i = 0; i < 4; i++ )
+        {
+            for( int j = 0; j < 4; j++ )
+            {
+                ViewProj[i][j] = VP[j][i];
+                ViewProjInv[i][j] = Inv[j][i];
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The general path for every point light face and spot light, in T precision
+    //--------------------------------------------------------------------------------------
+    template<typename T>
+    void CalcGeneralShadowMatrices( const std::vector<CPUFloat4>& PointLights, const std::vector<CPUFloat4>& SpotLights, const std::vector<CPUFloat4>& LookAts,
+        T (*pViewProj)[4][4], T (*pViewProjInv)[4][4] )
+    {
+        for( size_t i = 0; i < PointLights.size(); i++ )
+        {
+            const T Eye[3] = { PointLights[i].x, PointLights[i].y, PointLights[i].z };
+            for( int nFace = 0; nFace < 6; nFace++ )
+            {
+                const T LookAt[3] = { Eye[0] + kShadowFaceDir[nFace][0], Eye[1] + kShadowFaceDir[nFace][1], Eye[2] + kShadowFaceDir[nFace][2] };
+                CalcGeneralShadowMatrix( Eye, LookAt, kShadowFaceUp[nFace], CPU_POINT_SHADOW_FOV, (T)PointLights[i].w, pViewProj[6*i + nFace], pViewProjInv[6*i + nFace] );
+            }
+        }
+
+        static const float kUp[3] = { 0.0f, 1.0f, 0.0f };
+        const size_t uFirstSpot = 6*PointLights.size();
+        for( size_t i = 0; i < SpotLights.size(); i++ )
+        {
+            const T Eye[3] = { SpotLights[i].x, SpotLights[i].y, SpotLights[i].z };
+            const T LookAt[3] = { LookAts[i].x, LookAts[i].y, LookAts[i].z };
+            CalcGeneralShadowMatrix( Eye, LookAt, kUp, CPU_SPOT_SHADOW_FOV, (T)SpotLights[i].w, pViewProj[uFirstSpot + i], pViewProjInv[uFirstSpot + i] );
+        }
+    }
+
+
+    template void CalcGeneralShadowMatrices<float>( const std::vector<CPUFloat4>& PointLights, const std::vector<CPUFloat4>& SpotLights, const std::vector<CPUFloat4>& LookAts,
+        float (*pViewProj)[4][4], float (*pViewProjInv)[4][4] );
+    template void CalcGeneralShadowMatrices<double>( const std::vector<CPUFloat4>& PointLights, const std::vector<CPUFloat4>& SpotLights, const std::vector<CPUFloat4>& LookAts,
+        double (*pViewProj)[4][4], double (*pViewProjInv)[4][4] );
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,207 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPUBenchmarkUtil.h
+//
+// Helpers shared by the parts of the headless CPU benchmark (CPUBenchmark*.cpp): timing,
+// comparing outputs, the check column of the report, and the default light rig.
+// This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUBenchmark.h"
+#include "CPULightCulling.h"
+#include "CPULightPool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+
+    // g_uMaxVPLs when VPLs are enabled
+    static const unsigned kMaxVPLs = 65535;
+
+    //--------------------------------------------------------------------------------------
+    // The parts of the benchmark, in the order RunCPUBenchmark runs them. Each writes its
+    // part of the report and returns false if any of its checks failed.
+    //--------------------------------------------------------------------------------------
+    // CPUBenchmarkCulling.cpp: the culler at every SIMD level and thread count, and the other culling modes
+    bool RunLightCullingBenchmarks( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler );
+
+    // CPUBenchmarkLights.cpp: light pools, animation, light set files, quantized lights and light generation
+    bool RunLightBenchmarks( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler );
+
+    // CPUBenchmarkShadows.cpp: shadow matrices, scheduling, atlases, caster culling and caching
+    bool RunShadowBenchmarks( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler );
+
+    // CPUBenchmarkVPLs.cpp: VPL generation, clustering, sampling and caching
+    bool RunVPLBenchmarks( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler );
+
+    // CPUBenchmarkReadback.cpp: the readback queue against a simulated GPU
+    bool RunReadbackBenchmarks( FILE* pReport );
+
+    //--------------------------------------------------------------------------------------
+    // Timing
+    //--------------------------------------------------------------------------------------
+    // Wall-clock seconds since construction or the last Restart
+    class CPUBenchmarkTimer
+    {
+    public:
+        CPUBenchmarkTimer() : m_Start( Clock::now() ) {}
+
+        void Restart() { m_Start = Clock::now(); }
+        double GetSeconds() const { return std::chrono::duration<double>( Clock::now() - m_Start ).count(); }
+
+    private:
+        typedef std::chrono::high_resolution_clock Clock;
+
+        Clock::time_point m_Start;
+    };
+
+    // Seconds per call, averaged over uNumIterations calls to Body
+    template<class Function>
+    inline double TimeIterations( unsigned uNumIterations, Function Body )
+    {
+        CPUBenchmarkTimer Timer;
+        for( unsigned i = 0; i < uNumIterations; i++ )
+        {
+            Body();
+        }
+        return Timer.GetSeconds() / uNumIterations;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Comparing outputs
+    //--------------------------------------------------------------------------------------
+    // true if the first uCount elements of the two arrays have the same bits
+    template<class T>
+    inline bool ElementsMatch( const T* pA, const T* pB, size_t uCount )
+    {
+        return uCount == 0 || memcmp( pA, pB, uCount*sizeof(T) ) == 0;
+    }
+
+    // true if the two vectors have the same size and bits
+    template<class T>
+    inline bool ElementsMatch( const std::vector<T>& A, const std::vector<T>& B )
+    {
+        return A.size() == B.size() && ( A.empty() || ElementsMatch( &A[0], &B[0], A.size() ) );
+    }
+
+    // true if both vectors hold at least uCount elements, and the first uCount have the same bits
+    template<class T>
+    inline bool ElementsMatch( const std::vector<T>& A, const std::vector<T>& B, size_t uCount )
+    {
+        return uCount == 0 || ( A.size() >= uCount && B.size() >= uCount && ElementsMatch( &A[0], &B[0], uCount ) );
+    }
+
+    // the largest absolute difference between the first uCount elements of the two arrays
+    template<class A, class B>
+    inline double GetMaxAbsDifference( const A* pA, const B* pB, unsigned uCount )
+    {
+        double fDifference = 0.0;
+        for( unsigned i = 0; i < uCount; i++ )
+        {
+            fDifference = std::max( fDifference, fabs( (double)pA[i] - (double)pB[i] ) );
+        }
+        return fDifference;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Reports
+    //--------------------------------------------------------------------------------------
+    // Opens Path for writing, or returns stdout if it is empty; NULL if it can't be opened
+    FILE* OpenReport( const std::string& Path );
+
+    // The check column
+    inline const char* GetCheckResult( bool bPassed )
+    {
+        return bPassed ? "ok" : "FAILED";
+    }
+
+    // for a configuration compared against another one, such as the oracle
+    inline const char* GetMatchResult( bool bMatch )
+    {
+        return bMatch ? "identical" : "MISMATCH";
+    }
+
+    // for a configuration checked against a reference, and then against another configuration
+    inline const char* GetCheckResult( bool bCorrect, bool bMatch )
+    {
+        return !bCorrect ? "FAILED" : ( bMatch ? "ok" : "MISMATCH" );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Scenes
+    //--------------------------------------------------------------------------------------
+    // xorshift32, for the scripted random operations
+    inline unsigned GetBenchmarkRandom( unsigned& uState )
+    {
+        uState ^= uState << 13;
+        uState ^= uState >> 17;
+        uState ^= uState << 5;
+        return uState;
+    }
+
+    // Copies the dirty ranges of a pool attribute (merged across gaps of up to uMaxGap
+    // elements, and returned in Ranges) to a copy of its buffer, as the upload would.
+    // Returns the bytes copied.
+    size_t UploadDirtyRanges( const CPULightPool& Pool, unsigned uAttribute, size_t uElementSize, unsigned uMaxGap,
+        std::vector<CPULightPoolRange>& Ranges, std::vector<unsigned char>& Buffer );
+
+    // The casters of the default light rig's benchmarks, the room walls and pillars and then
+    // the grid objects; returns the number of room casters
+    unsigned GetDefaultShadowCasters( std::vector<CPUFloat4>& Centers, std::vector<CPUFloat4>& Extents );
+
+    // The default light rig's shadow-casting lights (DefaultScene.h)
+    void GetDefaultShadowLights( std::vector<CPUFloat4>& PointLights, std::vector<CPUFloat4>& SpotLights, std::vector<CPUFloat4>& LookAts );
+
+    // The lights' shadow cameras, the point light faces first and then the spot lights, the
+    // frustum planes of each, and the spot lights' bounding spheres as LightUtil has them
+    // (of radius r and r ahead of the light, which holds its cone)
+    void CalcShadowCasterFaces( const std::vector<CPUFloat4>& PointLights, const std::vector<CPUFloat4>& SpotLights, const std::vector<CPUFloat4>& LookAts,
+        std::vector<CPUMatrix>& ViewProj, std::vector<CPUFloat4>& Planes, std::vector<CPUFloat4>& SpotSpheres );
+
+    struct ShadowReferenceMatrix
+    {
+        double  m[4][4];
+    };
+
+    // The path LightUtil had (look-at times perspective, then a general inverse) for every
+    // point light face and then every spot light, in float or double precision
+    template<typename T>
+    void CalcGeneralShadowMatrices( const std::vector<CPUFloat4>& PointLights, const std::vector<CPUFloat4>& SpotLights, const std::vector<CPUFloat4>& LookAts,
+        T (*pViewProj)[4][4], T (*pViewProjInv)[4][4] );
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
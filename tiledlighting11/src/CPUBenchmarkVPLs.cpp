@@ -0,0 +1,1452 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUBenchmarkVPLs.cpp
+//
+// The VPL part of the headless CPU benchmark: VPL generation, clustering, sampling and
+// the VPL cache.
+//--------------------------------------------------------------------------------------
+
+#include "CPUBenchmarkUtil.h"
+#include "CPULightListTelemetry.h"
+#include "CPUScene.h"
+#include "CPUShadowMatrices.h"
+#include "CPUSpotLightCulling.h"
+#include "CPUTaskScheduler.h"
+#include "CPUVPLCache.h"
+#include "CPUVPLClustering.h"
+#include "CPUVPLGeneration.h"
+#include "CPUVPLSampling.h"
+#include "DefaultScene.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace TiledLighting11
+{
+    //--------------------------------------------------------------------------------------
+    // VPL generation from the default light rig's RSMs. The RSM atlases are ray cast against
+    // the shadow caster boxes (the room sections and pillars in a few colors, and the grid
+    // objects) and stored in the formats RSMRenderer renders them to. Checks the scalar
+    // path's VPLs against a double-precision transcription of GenerateVPLsCS through the
+    // general inverse shadow matrices, that they land on the ray cast surfaces to within
+    // the depth quantization, and that every SIMD level and thread count gives the same
+    // bits. Then times a batch of the rig's RSMs repeated.
+    //--------------------------------------------------------------------------------------
+    // the diffuse colors of the casters, in turn
+    static const float kRSMCasterColors[6][3] =
+    {
+        { 0.6f, 0.6f, 0.6f }, { 0.7f, 0.15f, 0.1f }, { 0.2f, 0.55f, 0.15f }, { 0.15f, 0.25f, 0.7f }, { 0.7f, 0.6f, 0.2f }, { 0.8f, 0.8f, 0.75f },
+    };
+
+    // an RSM atlas, and the ray cast surface point of every texel that hit something
+    struct SimulatedRSMAtlas
+    {
+        unsigned                    uWidth;
+        unsigned                    uHeight;
+        std::vector<unsigned short> Depth;
+        std::vector<unsigned>       Normal;
+        std::vector<unsigned>       Diffuse;
+        std::vector<double>         HitPoints;
+    };
+
+    // cleared as RSMRenderer clears the atlases
+    static void InitSimulatedRSMAtlas( unsigned uWidth, unsigned uHeight, SimulatedRSMAtlas& Atlas )
+    {
+        Atlas.uWidth = uWidth;
+        Atlas.uHeight = uHeight;
+        Atlas.Depth.assign( (size_t)uWidth*uHeight, 0xFFFF );
+        Atlas.Normal.assign( (size_t)uWidth*uHeight, 0 );
+        Atlas.Diffuse.assign( (size_t)uWidth*uHeight, 0 );
+        Atlas.HitPoints.assign( (size_t)uWidth*uHeight*3, 0.0 );
+    }
+
+    static CPURSMAtlas GetCPURSMAtlas( const SimulatedRSMAtlas& Atlas )
+    {
+        CPURSMAtlas Result;
+        Result.uWidth = Atlas.uWidth;
+        Result.uHeight = Atlas.uHeight;
+        Result.pDepth = &Atlas.Depth[0];
+        Result.pNormal = &Atlas.Normal[0];
+        Result.pDiffuse = &Atlas.Diffuse[0];
+        return Result;
+    }
+
+    // (x, y, z, 1) through a transposed matrix
+    template<typename T>
+    static void TransformTransposedPoint( const T m[4][4], double x, double y, double z, double Result[4] )
+    {
+        for( int i = 0; i < 4; i++ )
+        {
+            Result[i] = (double)m[i][0]*x + (double)m[i][1]*y + (double)m[i][2]*z + (double)m[i][3];
+        }
+    }
+
+    template<typename T>
+    static void UnprojectTransposed( const T Inv[4][4], double x, double y, double fDepth, double Position[3] )
+    {
+        double v[4];
+        TransformTransposedPoint( Inv, x, y, fDepth, v );
+        for( int i = 0; i < 3; i++ )
+        {
+            Position[i] = v[i] / v[3];
+        }
+    }
+
+    // The nearest box along the ray through each texel center, between the near and far planes
+    static void RayCastRSM( const CPUMatrix& ViewProj, const CPUMatrix& ViewProjInv, const std::vector<CPUFloat4>& Centers, const std::vector<CPUFloat4>& Extents,
+        unsigned uX0, unsigned uY0, SimulatedRSMAtlas& Atlas )
+    {
+        for( unsigned uY = 0; uY < CPU_RSM_RESOLUTION; uY++ )
+        {
+            for( unsigned uX = 0; uX < CPU_RSM_RESOLUTION; uX++ )
+            {
+                const double x = 2.0*( ( uX + 0.5 ) / CPU_RSM_RESOLUTION ) - 1.0;
+                const double y = 1.0 - 2.0*( ( uY + 0.5 ) / CPU_RSM_RESOLUTION );
+
+                double Origin[3], End[3], Dir[3];
+                UnprojectTransposed( ViewProjInv.m, x, y, 0.0, Origin );
+                UnprojectTransposed( ViewProjInv.m, x, y, 1.0, End );
+                for( int i = 0; i < 3; i++ )
+                {
+                    Dir[i] = End[i] - Origin[i];
+                }
+
+                double fNearestT = 2.0;
+                int nNearestAxis = -1;
+                double fNearestSign = 0.0;
+                size_t uNearestCaster = 0;
+                for( size_t c = 0; c < Centers.size(); c++ )
+                {
+                    // slabs; a ray starting inside a box doesn't hit it
+                    double fEnter = 0.0, fExit = 1.0, fSign = 0.0;
+                    int nAxis = -1;
+                    bool bHit = true;
+                    for( int i = 0; i < 3 && bHit; i++ )
+                    {
+                        const double fMin = (double)(&Centers[c].x)[i] - (&Extents[c].x)[i];
+                        const double fMax = (double)(&Centers[c].x)[i] + (&Extents[c].x)[i];
+                        if( fabs( Dir[i] ) < 1e-12 )
+                        {
+                            bHit = ( Origin[i] >= fMin && Origin[i] <= fMax );
+                            continue;
+                        }
+
+                        const double t0 = ( fMin - Origin[i] ) / Dir[i];
+                        const double t1 = ( fMax - Origin[i] ) / Dir[i];
+                        if( std::min( t0, t1 ) > fEnter )
+                        {
+                            fEnter = std::min( t0, t1 );
+                            nAxis = i;
+                            fSign = ( Dir[i] > 0.0 ) ? -1.0 : 1.0;
+                        }
+                        fExit = std::min( fExit, std::max( t0, t1 ) );
+                        bHit = ( fEnter <= fExit );
+                    }
+
+                    if( bHit && nAxis >= 0 && fEnter < fNearestT )
+                    {
+                        fNearestT = fEnter;
+                        nNearestAxis = nAxis;
+                        fNearestSign = fSign;
+                        uNearestCaster = c;
+                    }
+                }
+
+                if( nNearestAxis < 0 )
+                {
+                    continue;
+                }
+
+                const size_t uTexel = (size_t)( uY0 + uY )*Atlas.uWidth + uX0 + uX;
+                double Hit[3], Clip[4];
+                for( int i = 0; i < 3; i++ )
+                {
+                    Hit[i] = Origin[i] + fNearestT*Dir[i];
+                    Atlas.HitPoints[3*uTexel + i] = Hit[i];
+                }
+                TransformTransposedPoint( ViewProj.m, Hit[0], Hit[1], Hit[2], Clip );
+                Atlas.Depth[uTexel] = (unsigned short)( std::min( std::max( Clip[2] / Clip[3], 0.0 ), 1.0 )*65535.0 + 0.5 );
+
+                // RSMPS: 0.5*(1 + n), and the diffuse texture
+                float Normal[3] = { 0.5f, 0.5f, 0.5f };
+                Normal[nNearestAxis] = 0.5f*( 1.0f + (float)fNearestSign );
+                Atlas.Normal[uTexel] = CPUEncodeR11G11B10( Normal );
+                Atlas.Diffuse[uTexel] = CPUEncodeR11G11B10( kRSMCasterColors[uNearestCaster % 6] );
+            }
+        }
+    }
+
+    // The default light rig's shadow-casting lights and RSMs, with the VPL constants at the
+    // sample's default slider settings (see OnD3D11FrameRender)
+    struct VPLGenerationScene
+    {
+        std::vector<CPUFloat4>      PointLights;
+        std::vector<CPUFloat4>      SpotSpheres;
+        std::vector<unsigned>       PointColors;
+        std::vector<unsigned>       SpotColors;
+        std::vector<CPUSpotParams>  SpotParams;
+        std::vector<CPUMatrix>      PointViewProjInv;
+        std::vector<CPUMatrix>      SpotViewProjInv;
+        SimulatedRSMAtlas           PointAtlas;
+        SimulatedRSMAtlas           SpotAtlas;
+    };
+
+    static unsigned PackLightColor( const unsigned char Color[3] )
+    {
+        return 0xFF000000u | ( (unsigned)Color[2] << 16 ) | ( (unsigned)Color[1] << 8 ) | Color[0];
+    }
+
+    static void GetVPLGenerationInput( const VPLGenerationScene& Scene, CPUVPLGenerationInput& Input )
+    {
+        Input.SpotAtlas = GetCPURSMAtlas( Scene.SpotAtlas );
+        Input.PointAtlas = GetCPURSMAtlas( Scene.PointAtlas );
+        Input.pSpotViewProjInv = &Scene.SpotViewProjInv[0];
+        Input.pPointViewProjInv = &Scene.PointViewProjInv[0];
+        Input.pSpotLightCenterAndRadius = &Scene.SpotSpheres[0];
+        Input.pSpotLightColor = &Scene.SpotColors[0];
+        Input.pSpotParams = &Scene.SpotParams[0];
+        Input.uNumSpotLights = (unsigned)Scene.SpotSpheres.size();
+        Input.pPointLightCenterAndRadius = &Scene.PointLights[0];
+        Input.pPointLightColor = &Scene.PointColors[0];
+        Input.uNumPointLights = (unsigned)Scene.PointLights.size();
+        Input.fSpotStrength = 0.2f*( 30.0f / 100.0f );
+        Input.fSpotRadius = 200.0f;
+        Input.fPointStrength = 0.2f*( 30.0f / 100.0f );
+        Input.fPointRadius = 100.0f;
+        Input.fColorThreshold = 70.0f / 100.0f;
+        Input.fBrightnessThreshold = 0.01f*( 18.0f / 100.0f );
+    }
+
+    static void CreateVPLGenerationScene( VPLGenerationScene& Scene )
+    {
+        std::vector<CPUFloat4> Centers, Extents;
+        GetDefaultShadowCasters( Centers, Extents );
+
+        std::vector<CPUFloat4> SpotLights, LookAts, Planes;
+        std::vector<CPUMatrix> ViewProj;
+        GetDefaultShadowLights( Scene.PointLights, SpotLights, LookAts );
+        CalcShadowCasterFaces( Scene.PointLights, SpotLights, LookAts, ViewProj, Planes, Scene.SpotSpheres );
+
+        const unsigned uNumPointLights = (unsigned)Scene.PointLights.size();
+        const unsigned uNumSpotLights = (unsigned)SpotLights.size();
+        Scene.PointViewProjInv.resize( 6*uNumPointLights );
+        Scene.SpotViewProjInv.resize( uNumSpotLights );
+        std::vector<CPUMatrix> Unused( 6*uNumPointLights );
+        CalcCPUPointLightShadowMatrices( &Scene.PointLights[0], uNumPointLights, &Unused[0], &Scene.PointViewProjInv[0], CPU_SIMD_AUTO, NULL );
+        CalcCPUSpotLightShadowMatrices( &SpotLights[0], &LookAts[0], uNumSpotLights, &Unused[0], &Scene.SpotViewProjInv[0], CPU_SIMD_AUTO, NULL );
+
+        Scene.PointColors.resize( uNumPointLights );
+        Scene.SpotColors.resize( uNumSpotLights );
+        Scene.SpotParams.resize( uNumSpotLights );
+        for( unsigned i = 0; i < uNumPointLights; i++ )
+        {
+            Scene.PointColors[i] = PackLightColor( g_DefaultShadowCastingPointLights[i].Color );
+        }
+        for( unsigned i = 0; i < uNumSpotLights; i++ )
+        {
+            // as SetShadowCastingSpotLightData packs them
+            const float Dir[3] = { ( Scene.SpotSpheres[i].x - SpotLights[i].x ) / SpotLights[i].w, ( Scene.SpotSpheres[i].y - SpotLights[i].y ) / SpotLights[i].w,
+                ( Scene.SpotSpheres[i].z - SpotLights[i].z ) / SpotLights[i].w };
+            Scene.SpotColors[i] = PackLightColor( g_DefaultShadowCastingSpotLights[i].Color );
+            Scene.SpotParams[i] = PackCPUSpotParams( Dir, 0.816496580927726f, SpotLights[i].w*1.33333333f );
+        }
+
+        InitSimulatedRSMAtlas( 6*CPU_RSM_RESOLUTION, uNumPointLights*CPU_RSM_RESOLUTION, Scene.PointAtlas );
+        InitSimulatedRSMAtlas( uNumSpotLights*CPU_RSM_RESOLUTION, CPU_RSM_RESOLUTION, Scene.SpotAtlas );
+        for( unsigned i = 0; i < uNumPointLights; i++ )
+        {
+            for( unsigned f = 0; f < 6; f++ )
+            {
+                RayCastRSM( ViewProj[6*i + f], Scene.PointViewProjInv[6*i + f], Centers, Extents, f*CPU_RSM_RESOLUTION, i*CPU_RSM_RESOLUTION, Scene.PointAtlas );
+            }
+        }
+        for( unsigned i = 0; i < uNumSpotLights; i++ )
+        {
+            RayCastRSM( ViewProj[6*uNumPointLights + i], Scene.SpotViewProjInv[i], Centers, Extents, i*CPU_RSM_RESOLUTION, 0, Scene.SpotAtlas );
+        }
+    }
+
+    // Point and spot light i of Scene become the rig's lights uRig, RSMs and all
+    static void CopyVPLGenerationLight( const VPLGenerationScene& Rig, unsigned uRig, unsigned i, VPLGenerationScene& Scene )
+    {
+        Scene.PointLights[i] = Rig.PointLights[uRig];
+        Scene.SpotSpheres[i] = Rig.SpotSpheres[uRig];
+        Scene.PointColors[i] = Rig.PointColors[uRig];
+        Scene.SpotColors[i] = Rig.SpotColors[uRig];
+        Scene.SpotParams[i] = Rig.SpotParams[uRig];
+        Scene.SpotViewProjInv[i] = Rig.SpotViewProjInv[uRig];
+        for( unsigned f = 0; f < 6; f++ )
+        {
+            Scene.PointViewProjInv[6*i + f] = Rig.PointViewProjInv[6*uRig + f];
+        }
+
+        // a row of point light RSMs, and a spot light RSM
+        const size_t uPointRow = (size_t)6*CPU_RSM_RESOLUTION*CPU_RSM_RESOLUTION;
+        std::copy( Rig.PointAtlas.Depth.begin() + uRig*uPointRow, Rig.PointAtlas.Depth.begin() + ( uRig + 1 )*uPointRow, Scene.PointAtlas.Depth.begin() + i*uPointRow );
+        std::copy( Rig.PointAtlas.Normal.begin() + uRig*uPointRow, Rig.PointAtlas.Normal.begin() + ( uRig + 1 )*uPointRow, Scene.PointAtlas.Normal.begin() + i*uPointRow );
+        std::copy( Rig.PointAtlas.Diffuse.begin() + uRig*uPointRow, Rig.PointAtlas.Diffuse.begin() + ( uRig + 1 )*uPointRow, Scene.PointAtlas.Diffuse.begin() + i*uPointRow );
+        for( unsigned uY = 0; uY < CPU_RSM_RESOLUTION; uY++ )
+        {
+            const size_t uSource = (size_t)uY*Rig.SpotAtlas.uWidth + uRig*CPU_RSM_RESOLUTION;
+            const size_t uDest = (size_t)uY*Scene.SpotAtlas.uWidth + i*CPU_RSM_RESOLUTION;
+            std::copy( Rig.SpotAtlas.Depth.begin() + uSource, Rig.SpotAtlas.Depth.begin() + uSource + CPU_RSM_RESOLUTION, Scene.SpotAtlas.Depth.begin() + uDest );
+            std::copy( Rig.SpotAtlas.Normal.begin() + uSource, Rig.SpotAtlas.Normal.begin() + uSource + CPU_RSM_RESOLUTION, Scene.SpotAtlas.Normal.begin() + uDest );
+            std::copy( Rig.SpotAtlas.Diffuse.begin() + uSource, Rig.SpotAtlas.Diffuse.begin() + uSource + CPU_RSM_RESOLUTION, Scene.SpotAtlas.Diffuse.begin() + uDest );
+        }
+    }
+
+    // The rig's lights and RSMs repeated up to uNumLights of each type
+    static void RepeatVPLGenerationScene( const VPLGenerationScene& Rig, unsigned uNumLights, VPLGenerationScene& Scene )
+    {
+        const unsigned uNumRigLights = (unsigned)Rig.PointLights.size();
+
+        Scene.PointLights.resize( uNumLights );
+        Scene.SpotSpheres.resize( uNumLights );
+        Scene.PointColors.resize( uNumLights );
+        Scene.SpotColors.resize( uNumLights );
+        Scene.SpotParams.resize( uNumLights );
+        Scene.PointViewProjInv.resize( 6*uNumLights );
+        Scene.SpotViewProjInv.resize( uNumLights );
+        InitSimulatedRSMAtlas( 6*CPU_RSM_RESOLUTION, uNumLights*CPU_RSM_RESOLUTION, Scene.PointAtlas );
+        InitSimulatedRSMAtlas( uNumLights*CPU_RSM_RESOLUTION, CPU_RSM_RESOLUTION, Scene.SpotAtlas );
+
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            CopyVPLGenerationLight( Rig, i % uNumRigLights, i, Scene );
+        }
+    }
+
+    // GenerateVPLsCS for one sample in double precision, through the transposed general inverse.
+    // fMargin is how far the deciding test is from its threshold, relative to the threshold,
+    // and fDepthStep how far the position moves for half a depth quantization step.
+    struct ReferenceVPL
+    {
+        bool    bEmitted;
+        double  fMargin;
+        double  Position[3];
+        double  fDepthStep;
+        double  Normal[3];
+        double  Color[3];
+        double  SourceDir[3];
+        size_t  uTexel;
+    };
+
+    static void GenerateReferenceVPL( const CPUVPLGenerationInput& Input, unsigned uRSM, const double Inv[4][4], unsigned uSampleX, unsigned uSampleY, ReferenceVPL& VPL )
+    {
+        const bool bSpot = ( uRSM < Input.uNumSpotLights );
+        const unsigned uLight = bSpot ? uRSM : ( uRSM - Input.uNumSpotLights ) / 6;
+        const unsigned uX0 = bSpot ? uRSM*CPU_RSM_RESOLUTION : ( ( uRSM - Input.uNumSpotLights ) % 6 )*CPU_RSM_RESOLUTION;
+        const unsigned uY0 = bSpot ? 0 : uLight*CPU_RSM_RESOLUTION;
+        const CPURSMAtlas& Atlas = bSpot ? Input.SpotAtlas : Input.PointAtlas;
+        const CPUFloat4& Light = bSpot ? Input.pSpotLightCenterAndRadius[uLight] : Input.pPointLightCenterAndRadius[uLight];
+        const unsigned uColor = bSpot ? Input.pSpotLightColor[uLight] : Input.pPointLightColor[uLight];
+
+        const unsigned uX = uSampleX*CPU_RSM_SAMPLE_WIDTH;
+        const unsigned uY = uSampleY*CPU_RSM_SAMPLE_WIDTH;
+        VPL.uTexel = (size_t)( uY0 + uY )*Atlas.uWidth + uX0 + uX;
+
+        float Normal[3], Diffuse[3];
+        CPUDecodeR11G11B10( Atlas.pNormal[VPL.uTexel], Normal );
+        CPUDecodeR11G11B10( Atlas.pDiffuse[VPL.uTexel], Diffuse );
+
+        const double x = 2.0*( ( uX + 0.5 ) / CPU_RSM_RESOLUTION ) - 1.0;
+        const double y = 1.0 - 2.0*( ( uY + 0.5 ) / CPU_RSM_RESOLUTION );
+        const double fDepth = Atlas.pDepth[VPL.uTexel] / 65535.0;
+        UnprojectTransposed( Inv, x, y, fDepth, VPL.Position );
+
+        VPL.fDepthStep = 0.0;
+        for( int nSide = -1; nSide <= 1; nSide += 2 )
+        {
+            double Position[3];
+            UnprojectTransposed( Inv, x, y, fDepth + nSide*0.5 / 65535.0, Position );
+            const double d[3] = { Position[0] - VPL.Position[0], Position[1] - VPL.Position[1], Position[2] - VPL.Position[2] };
+            VPL.fDepthStep = std::max( VPL.fDepthStep, sqrt( d[0]*d[0] + d[1]*d[1] + d[2]*d[2] ) );
+        }
+
+        double LightPos[3] = { Light.x, Light.y, Light.z };
+        double SpotDir[3] = { 0.0, 0.0, 0.0 };
+        if( bSpot )
+        {
+            const CPUSpotParams& Params = Input.pSpotParams[uLight];
+            SpotDir[0] = CPUConvertF16ToF32( Params.fLightDirX );
+            SpotDir[1] = CPUConvertF16ToF32( Params.fLightDirY );
+            SpotDir[2] = sqrt( std::max( 1.0 - SpotDir[0]*SpotDir[0] - SpotDir[1]*SpotDir[1], 0.0 ) );
+            SpotDir[2] = ( CPUConvertF16ToF32( Params.fCosineOfConeAngleAndLightDirZSign ) > 0.0f ) ? SpotDir[2] : -SpotDir[2];
+            for( int i = 0; i < 3; i++ )
+            {
+                LightPos[i] -= Light.w*SpotDir[i];
+            }
+        }
+
+        double ToSample[3];
+        for( int i = 0; i < 3; i++ )
+        {
+            ToSample[i] = VPL.Position[i] - LightPos[i];
+        }
+        const double fDistance = sqrt( ToSample[0]*ToSample[0] + ToSample[1]*ToSample[1] + ToSample[2]*ToSample[2] );
+        const double fFalloff = 1.0 - fDistance / Light.w;
+
+        double fMaxComponent = -HUGE_VAL, fColorLength = 0.0, fStrength = 0.0;
+        for( int i = 0; i < 3; i++ )
+        {
+            VPL.Normal[i] = 2.0*Normal[i] - 1.0;
+            VPL.Color[i] = Diffuse[i]*fFalloff;
+            fMaxComponent = std::max( fMaxComponent, VPL.Color[i] );
+            fColorLength += VPL.Color[i]*VPL.Color[i];
+        }
+        fColorLength = sqrt( fColorLength );
+
+        // black is never interesting
+        if( fColorLength == 0.0 )
+        {
+            VPL.bEmitted = false;
+            VPL.fMargin = HUGE_VAL;
+            return;
+        }
+
+        for( int i = 0; i < 3; i++ )
+        {
+            VPL.Color[i] *= ( ( uColor >> ( 8*i ) ) & 0xFF ) / 255.0*( bSpot ? Input.fSpotStrength : Input.fPointStrength );
+            fStrength += VPL.Color[i]*VPL.Color[i];
+            VPL.SourceDir[i] = bSpot ? -SpotDir[i] : -ToSample[i] / fDistance;
+        }
+        fStrength = sqrt( fStrength );
+
+        const double fColorMargin = ( fMaxComponent / fColorLength - Input.fColorThreshold ) / Input.fColorThreshold;
+        const double fBrightnessMargin = ( fStrength - Input.fBrightnessThreshold ) / Input.fBrightnessThreshold;
+        VPL.bEmitted = ( fColorMargin > 0.0 && fBrightnessMargin > 0.0 );
+        VPL.fMargin = VPL.bEmitted ? std::min( fColorMargin, fBrightnessMargin ) : fabs( ( fColorMargin > 0.0 ) ? fBrightnessMargin : fColorMargin );
+    }
+
+    struct VPLReferenceErrors
+    {
+        unsigned    uNumMismatched;
+        unsigned    uNumBorderline;
+        unsigned    uNumOffSurface;
+        double      fMaxPositionError;
+        double      fMaxColorError;
+        double      fMaxDirectionError;
+        double      fMaxSurfaceError;
+    };
+
+    // relative to the light radius, the color and unit vectors
+    static void GetVPLErrors( const CPUFloat4& Position, const CPUVPLData& Data, const ReferenceVPL& Reference, double fLightRadius, double Errors[3] )
+    {
+        double fColorLength = 0.0;
+        for( int i = 0; i < 3; i++ )
+        {
+            fColorLength = std::max( fColorLength, fabs( Reference.Color[i] ) );
+        }
+        Errors[0] = GetMaxAbsDifference( &Position.x, Reference.Position, 3 ) / fLightRadius;
+        Errors[1] = GetMaxAbsDifference( &Data.Color.x, Reference.Color, 3 ) / fColorLength;
+        Errors[2] = std::max( GetMaxAbsDifference( &Data.Direction.x, Reference.Normal, 3 ), GetMaxAbsDifference( &Data.SourceLightDirection.x, Reference.SourceDir, 3 ) );
+    }
+
+    static void CheckVPLsAgainstReference( const VPLGenerationScene& Scene, const CPUVPLGenerationInput& Input, const CPUVPLGenerationOutput& Output,
+        const std::vector<ShadowReferenceMatrix>& ReferenceInv, VPLReferenceErrors& Result )
+    {
+        // samples this close to a threshold may go either way in float
+        static const double kBorderlineMargin = 1e-3;
+        static const double kMaxErrors[3] = { 1e-4, 1e-3, 1e-4 };
+
+        memset( &Result, 0, sizeof(Result) );
+
+        const unsigned uNumRSMs = Input.uNumSpotLights + 6*Input.uNumPointLights;
+        for( unsigned uRSM = 0; uRSM < uNumRSMs; uRSM++ )
+        {
+            // the reference matrices have the point light faces first
+            const bool bSpot = ( uRSM < Input.uNumSpotLights );
+            const double (*Inv)[4] = ReferenceInv[bSpot ? 6*Input.uNumPointLights + uRSM : uRSM - Input.uNumSpotLights].m;
+            const double fLightRadius = bSpot ? Input.pSpotLightCenterAndRadius[uRSM].w : Input.pPointLightCenterAndRadius[( uRSM - Input.uNumSpotLights ) / 6].w;
+            const SimulatedRSMAtlas& Atlas = bSpot ? Scene.SpotAtlas : Scene.PointAtlas;
+
+            unsigned uVPL = Output.RSMOffsets[uRSM];
+            const unsigned uEnd = Output.RSMOffsets[uRSM + 1];
+            for( unsigned uSample = 0; uSample < CPU_RSM_SAMPLES_PER_RSM; uSample++ )
+            {
+                ReferenceVPL Reference;
+                GenerateReferenceVPL( Input, uRSM, Inv, uSample % CPU_RSM_SAMPLES_PER_ROW, uSample / CPU_RSM_SAMPLES_PER_ROW, Reference );
+                const bool bBorderline = ( Reference.fMargin < kBorderlineMargin );
+                Result.uNumBorderline += bBorderline ? 1 : 0;
+
+                // the next VPL is this sample's if the reference has one, or, near a threshold, if it matches
+                double Errors[3] = { 0.0, 0.0, 0.0 };
+                bool bMatch = false;
+                if( uVPL < uEnd && ( Reference.bEmitted || bBorderline ) )
+                {
+                    GetVPLErrors( Output.PositionAndRadius[uVPL], Output.Data[uVPL], Reference, fLightRadius, Errors );
+                    bMatch = ( Errors[0] <= kMaxErrors[0] && Errors[1] <= kMaxErrors[1] && Errors[2] <= kMaxErrors[2] );
+                }
+
+                if( Reference.bEmitted && !bBorderline && !bMatch )
+                {
+                    Result.uNumMismatched++;
+                }
+
+                if( bMatch || ( Reference.bEmitted && !bBorderline && uVPL < uEnd ) )
+                {
+                    Result.fMaxPositionError = std::max( Result.fMaxPositionError, Errors[0] );
+                    Result.fMaxColorError = std::max( Result.fMaxColorError, Errors[1] );
+                    Result.fMaxDirectionError = std::max( Result.fMaxDirectionError, Errors[2] );
+                    uVPL++;
+
+                    // on the ray cast surface, to within the depth quantization
+                    const double* pHit = &Atlas.HitPoints[3*Reference.uTexel];
+                    const double d[3] = { Reference.Position[0] - pHit[0], Reference.Position[1] - pHit[1], Reference.Position[2] - pHit[2] };
+                    const double fSurfaceError = sqrt( d[0]*d[0] + d[1]*d[1] + d[2]*d[2] ) / ( Reference.fDepthStep + 1e-6*fLightRadius );
+                    Result.fMaxSurfaceError = std::max( Result.fMaxSurfaceError, fSurfaceError );
+                    Result.uNumOffSurface += ( fSurfaceError > 1.0 ) ? 1 : 0;
+                }
+            }
+
+            // VPLs without a sample
+            Result.uNumMismatched += uEnd - uVPL;
+        }
+    }
+
+    static bool VPLOutputsMatch( const CPUVPLGenerationOutput& a, const CPUVPLGenerationOutput& b )
+    {
+        return a.uNumVPLs == b.uNumVPLs && a.RSMOffsets == b.RSMOffsets &&
+            ElementsMatch( a.PositionAndRadius, b.PositionAndRadius, a.uNumVPLs ) && ElementsMatch( a.Data, b.Data, a.uNumVPLs );
+    }
+
+    // the VPLs of each repeated RSM are those of the rig's RSM it repeats
+    static bool RepeatedVPLsMatch( const CPUVPLGenerationOutput& Rig, unsigned uNumRigLights, const CPUVPLGenerationOutput& Output, unsigned uNumLights )
+    {
+        for( unsigned uRSM = 0; uRSM < 7*uNumLights; uRSM++ )
+        {
+            const unsigned uRigRSM = ( uRSM < uNumLights ) ? uRSM % uNumRigLights : uNumRigLights + ( ( uRSM - uNumLights ) % ( 6*uNumRigLights ) );
+            const unsigned uCount = Output.RSMOffsets[uRSM + 1] - Output.RSMOffsets[uRSM];
+            if( uCount != Rig.RSMOffsets[uRigRSM + 1] - Rig.RSMOffsets[uRigRSM] )
+            {
+                return false;
+            }
+            if( uCount > 0 &&
+                ( !ElementsMatch( &Output.PositionAndRadius[Output.RSMOffsets[uRSM]], &Rig.PositionAndRadius[Rig.RSMOffsets[uRigRSM]], uCount ) ||
+                  !ElementsMatch( &Output.Data[Output.RSMOffsets[uRSM]], &Rig.Data[Rig.RSMOffsets[uRigRSM]], uCount ) ) )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // every 11 and 10-bit value against the format's definition
+    static bool CheckR11G11B10Decode()
+    {
+        for( unsigned uBits = 0; uBits < 2048; uBits++ )
+        {
+            for( int nChannel = 0; nChannel < 3; nChannel++ )
+            {
+                const unsigned uMantissaBits = ( nChannel == 2 ) ? 5 : 6;
+                if( uBits >= ( 1u << ( 5 + uMantissaBits ) ) )
+                {
+                    continue;
+                }
+
+                const unsigned uExponent = uBits >> uMantissaBits;
+                const unsigned uMantissa = uBits & ( ( 1u << uMantissaBits ) - 1 );
+                const unsigned uPacked = uBits << ( nChannel == 0 ? 0 : nChannel == 1 ? 11 : 22 );
+
+                float RGB[3];
+                CPUDecodeR11G11B10( uPacked, RGB );
+                const float fValue = RGB[nChannel];
+
+                bool bCorrect;
+                if( uExponent == 31 )
+                {
+                    bCorrect = ( uMantissa == 0 ) ? ( fValue > FLT_MAX ) : ( fValue != fValue );
+                }
+                else
+                {
+                    const double fExpected = ( uExponent == 0 ) ? ldexp( (double)uMantissa, -14 - (int)uMantissaBits )
+                        : ldexp( 1.0 + ldexp( (double)uMantissa, -(int)uMantissaBits ), (int)uExponent - 15 );
+                    bCorrect = ( (double)fValue == fExpected ) && ( uExponent == 0 || CPUEncodeR11G11B10( RGB ) == uPacked );
+                }
+
+                if( !bCorrect )
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static bool RunVPLGenerationBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kNumBatchLights = 256;
+
+        VPLGenerationScene Rig, Batch;
+        CreateVPLGenerationScene( Rig );
+        RepeatVPLGenerationScene( Rig, kNumBatchLights, Batch );
+        const unsigned uNumRigLights = (unsigned)Rig.PointLights.size();
+
+        fprintf( pReport, "\nVPL generation, GenerateVPLsCS on the CPU: the default light rig's %u spot and %u point lights, RSMs ray cast against the shadow casters, and the rig repeated to %u of each; %u threads\n",
+            uNumRigLights, uNumRigLights, kNumBatchLights, Scheduler.GetNumThreads() );
+
+        const bool bDecodeCorrect = CheckR11G11B10Decode();
+        fprintf( pReport, "R11G11B10 decode of every 11 and 10-bit value vs. the format definition: %s\n", GetCheckResult( bDecodeCorrect ) );
+        bool bResult = bDecodeCorrect;
+
+        std::vector<ShadowReferenceMatrix> ReferenceViewProj( 7*uNumRigLights ), ReferenceViewProjInv( 7*uNumRigLights );
+        {
+            std::vector<CPUFloat4> PointLights, SpotLights, LookAts;
+            GetDefaultShadowLights( PointLights, SpotLights, LookAts );
+            CalcGeneralShadowMatrices( PointLights, SpotLights, LookAts, &ReferenceViewProj[0].m, &ReferenceViewProjInv[0].m );
+        }
+
+        fprintf( pReport, "%-8s %-8s %8s %12s %12s %8s %10s %10s  %s\n", "lights", "path", "threads", "ms/frame", "Msamples/s", "VPLs", "color rej", "dim rej", "check" );
+
+        CPUVPLGenerator Generator;
+        CPUVPLGenerationOutput RigReference, BatchReference, Output;
+        for( int nScene = 0; nScene < 2; nScene++ )
+        {
+            const bool bRig = ( nScene == 0 );
+            const VPLGenerationScene& Scene = bRig ? Rig : Batch;
+            CPUVPLGenerationOutput& Reference = bRig ? RigReference : BatchReference;
+
+            CPUVPLGenerationInput Input;
+            GetVPLGenerationInput( Scene, Input );
+            const unsigned uNumSamples = 7*Input.uNumPointLights*CPU_RSM_SAMPLES_PER_RSM;
+            const unsigned uNumIterations = std::max( Config.uNumFrames, 1u )*( bRig ? kNumBatchLights / uNumRigLights : 1 );
+
+            // scalar, then every SIMD level, on the calling thread, then the best level with the threads
+            const int nNumPaths = (int)GetCPUSIMDLevel() + 2;
+            for( int nPath = 0; nPath < nNumPaths; nPath++ )
+            {
+                const bool bThreads = ( nPath == nNumPaths - 1 );
+                const CPUSIMDLevel Level = bThreads ? CPU_SIMD_AUTO : (CPUSIMDLevel)nPath;
+                CPUTaskScheduler* pScheduler = bThreads ? &Scheduler : NULL;
+                CPUVPLGenerationOutput& Result = ( nPath == 0 ) ? Reference : Output;
+                Generator.SetSIMDLevel( Level );
+
+                double fTime = 0.0;
+                for( unsigned uIteration = 0; uIteration <= uNumIterations; uIteration++ )
+                {
+                    CPUBenchmarkTimer Timer;
+                    Generator.GenerateVPLs( Input, Result, pScheduler );
+
+                    // (the first iteration warms up)
+                    if( uIteration > 0 )
+                    {
+                        fTime += Timer.GetSeconds();
+                    }
+                }
+                fTime /= uNumIterations;
+
+                const CPUVPLGenerationStats& Stats = Generator.GetStats();
+                const char* pCheck = "identical";
+                if( nPath == 0 && bRig )
+                {
+                    VPLReferenceErrors Errors;
+                    CheckVPLsAgainstReference( Scene, Input, Result, ReferenceViewProjInv, Errors );
+                    const bool bCorrect = ( Errors.uNumMismatched == 0 && Errors.uNumOffSurface == 0 && Stats.uNumVPLs > 0 );
+                    bResult = bResult && bCorrect;
+                    pCheck = GetCheckResult( bCorrect );
+
+                    fprintf( pReport, "vs. the double-precision reference: %u VPLs mismatched, %u samples within %.0e of a threshold, max errors %.2e position (of the light radius), %.2e color, %.2e direction; "
+                        "%u VPLs off the ray cast surface, max distance %.2f of the depth quantization\n",
+                        Errors.uNumMismatched, Errors.uNumBorderline, 1e-3, Errors.fMaxPositionError, Errors.fMaxColorError, Errors.fMaxDirectionError,
+                        Errors.uNumOffSurface, Errors.fMaxSurfaceError );
+                }
+                else if( nPath == 0 )
+                {
+                    const bool bCorrect = RepeatedVPLsMatch( RigReference, uNumRigLights, Result, kNumBatchLights );
+                    bResult = bResult && bCorrect;
+                    pCheck = bCorrect ? "ok" : "MISMATCH";
+                }
+                else
+                {
+                    const bool bMatch = VPLOutputsMatch( Result, Reference );
+                    bResult = bResult && bMatch;
+                    pCheck = GetMatchResult( bMatch );
+                }
+
+                fprintf( pReport, "%-8u %-8s %8u %12.4f %12.2f %8u %10u %10u  %s\n", 2*Input.uNumPointLights, GetCPUSIMDLevelName( ResolveCPUSIMDLevel( Level ) ),
+                    pScheduler ? Scheduler.GetNumThreads() : 1, fTime*1000.0, uNumSamples / fTime*1e-6, Stats.uNumVPLs, Stats.uNumColorRejected, Stats.uNumBrightnessRejected, pCheck );
+            }
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // VPL clustering of the default light rig's VPLs, and of the repeated rig's, which are
+    // more than the shaders use. Checks that every merged VPL is one bin of the input, that
+    // its sphere holds its members', that single VPLs pass through unchanged, that the VPL
+    // energy is kept and that the thread count doesn't change the output. Reports the VPL
+    // counts, the per-tile VPL list lengths from the CPU culler with the procedural scene's
+    // camera, and how far the light DoVPLLighting gathers at points on the casters moves.
+    //--------------------------------------------------------------------------------------
+
+    // g_fVPLRemoveBackFaceContrib at the default slider setting
+    static const double kVPLRemoveBackFaceContrib = 0.5;
+
+    // A point on a caster, with its normal
+    struct VPLReceiver
+    {
+        double  Position[3];
+        double  Normal[3];
+    };
+
+    // every fourth texel of the rig's RSMs that hit something, in both directions, at the odd
+    // texels, which the VPLs don't come from
+    static void GetVPLReceivers( const SimulatedRSMAtlas& Atlas, std::vector<VPLReceiver>& Receivers )
+    {
+        for( unsigned uY = 1; uY < Atlas.uHeight; uY += 4 )
+        {
+            for( unsigned uX = 1; uX < Atlas.uWidth; uX += 4 )
+            {
+                const size_t uTexel = (size_t)uY*Atlas.uWidth + uX;
+                if( Atlas.Depth[uTexel] == 0xFFFF )
+                {
+                    continue;
+                }
+
+                float Normal[3];
+                CPUDecodeR11G11B10( Atlas.Normal[uTexel], Normal );
+
+                VPLReceiver Receiver;
+                for( int i = 0; i < 3; i++ )
+                {
+                    Receiver.Position[i] = Atlas.HitPoints[3*uTexel + i];
+                    Receiver.Normal[i] = 2.0*Normal[i] - 1.0;
+                }
+                Receivers.push_back( Receiver );
+            }
+        }
+    }
+
+    // DoVPLLighting in double precision, summed over the VPLs, for every receiver
+    static void GatherVPLLighting( const std::vector<VPLReceiver>& Receivers, const CPUFloat4* pPositionAndRadius, const CPUVPLData* pData, unsigned uNumVPLs,
+        std::vector<double>& Lighting )
+    {
+        Lighting.assign( 3*Receivers.size(), 0.0 );
+        for( size_t r = 0; r < Receivers.size(); r++ )
+        {
+            const VPLReceiver& Receiver = Receivers[r];
+            for( unsigned i = 0; i < uNumVPLs; i++ )
+            {
+                const CPUFloat4& VPL = pPositionAndRadius[i];
+                const double ToLight[3] = { VPL.x - Receiver.Position[0], VPL.y - Receiver.Position[1], VPL.z - Receiver.Position[2] };
+                const double fDistanceSq = ToLight[0]*ToLight[0] + ToLight[1]*ToLight[1] + ToLight[2]*ToLight[2];
+                if( fDistanceSq >= (double)VPL.w*VPL.w || fDistanceSq == 0.0 )
+                {
+                    continue;
+                }
+
+                const double fDistance = sqrt( fDistanceSq );
+                const double LightDir[3] = { ToLight[0] / fDistance, ToLight[1] / fDistance, ToLight[2] / fDistance };
+                const CPUVPLData& Data = pData[i];
+                const double fVPLNormalDotDir = -( Data.Direction.x*LightDir[0] + Data.Direction.y*LightDir[1] + Data.Direction.z*LightDir[2] );
+                const double fNdotL = LightDir[0]*Receiver.Normal[0] + LightDir[1]*Receiver.Normal[1] + LightDir[2]*Receiver.Normal[2];
+                if( fVPLNormalDotDir <= 0.0 || fNdotL <= 0.0 )
+                {
+                    continue;
+                }
+
+                // smoothstep( 1, 0, x )
+                const double t = 1.0 - fDistance / VPL.w;
+                const double fFalloff = t*t*( 3.0 - 2.0*t );
+
+                double fSourceLightNdotL = Data.SourceLightDirection.x*Receiver.Normal[0] + Data.SourceLightDirection.y*Receiver.Normal[1] + Data.SourceLightDirection.z*Receiver.Normal[2];
+                fSourceLightNdotL = ( fSourceLightNdotL < 0.0 ) ? 1.0 + fSourceLightNdotL / kVPLRemoveBackFaceContrib : 1.0;
+
+                const double fScale = std::min( fNdotL, 1.0 )*fFalloff*fVPLNormalDotDir*fSourceLightNdotL;
+                for( int c = 0; c < 3; c++ )
+                {
+                    Lighting[3*r + c] += (&Data.Color.x)[c]*fScale;
+                }
+            }
+        }
+    }
+
+    // the relative change in the total gathered light, and the RMS change relative to the RMS light
+    static void GetVPLLightingErrors( const std::vector<double>& Reference, const std::vector<double>& Lighting, double& fTotalError, double& fRMSError )
+    {
+        double fReferenceTotal = 0.0, fTotal = 0.0, fReferenceSq = 0.0, fErrorSq = 0.0;
+        for( size_t i = 0; i < Reference.size(); i++ )
+        {
+            fReferenceTotal += Reference[i];
+            fTotal += Lighting[i];
+            fReferenceSq += Reference[i]*Reference[i];
+            fErrorSq += ( Lighting[i] - Reference[i] )*( Lighting[i] - Reference[i] );
+        }
+        fTotalError = ( fTotal - fReferenceTotal ) / fReferenceTotal;
+        fRMSError = sqrt( fErrorSq / fReferenceSq );
+    }
+
+    // The longest per-tile VPL list, its 99th percentile and the tiles that overflowed, for at
+    // most g_uMaxVPLs VPLs, as the culling shaders see them
+    static void GetVPLListOccupancy( const CPUScene& Scene, const CPUFloat4* pPositionAndRadius, unsigned uNumVPLs, CPUTaskScheduler& Scheduler, CPULightListOccupancy& Occupancy )
+    {
+        CPULightCullingInput Input;
+        FillCPULightCullingInput( Scene, GetMaxNumLightsPerTile( Scene.uHeight ), Input );
+        Input.pVPLCenterAndRadius = pPositionAndRadius;
+        Input.uNumVPLs = std::min( uNumVPLs, kMaxVPLs );
+        Input.uMaxNumVPLsPerTile = GetMaxNumVPLsPerTile( Scene.uHeight );
+
+        CPULightCuller Culler;
+        CPULightCullingOutput Output;
+        Culler.CullLights( Input, Output, &Scheduler );
+
+        CPULightListTelemetry Telemetry;
+        GatherLightListTelemetry( Input, Output, Telemetry );
+        Occupancy = Telemetry.VPL;
+    }
+
+    static bool CheckVPLClusters( const CPUVPLClusteringDesc& Desc, const CPUVPLGenerationOutput& Input, const CPUVPLClusteringOutput& Output, const CPUVPLClusteringStats& Stats )
+    {
+        // float rounding of the merged colors and radii
+        static const double kMaxEnergyError = 1e-5;
+
+        const unsigned uNumClusters = Output.uNumVPLs;
+        std::vector<unsigned> NumMembers( uNumClusters, 0 );
+        std::vector<unsigned long long> Keys( uNumClusters, 0 );
+        for( unsigned i = 0; i < Input.uNumVPLs; i++ )
+        {
+            const unsigned c = Output.ClusterIndices[i];
+            if( c >= uNumClusters )
+            {
+                return false;
+            }
+
+            // one bin per merged VPL
+            const unsigned long long uKey = CPUVPLClusterer::GetClusterKey( Desc, Stats.fCellSize, Input.PositionAndRadius[i], Input.Data[i] );
+            if( NumMembers[c]++ == 0 )
+            {
+                Keys[c] = uKey;
+            }
+            else if( Keys[c] != uKey )
+            {
+                return false;
+            }
+
+            // inside the merged sphere
+            const CPUFloat4& Member = Input.PositionAndRadius[i];
+            const CPUFloat4& Merged = Output.PositionAndRadius[c];
+            const double d[3] = { (double)Member.x - Merged.x, (double)Member.y - Merged.y, (double)Member.z - Merged.z };
+            if( sqrt( d[0]*d[0] + d[1]*d[1] + d[2]*d[2] ) + Member.w > Merged.w )
+            {
+                return false;
+            }
+        }
+
+        // every merged VPL has members, and a bin of its own
+        for( unsigned c = 0; c < uNumClusters; c++ )
+        {
+            if( NumMembers[c] == 0 )
+            {
+                return false;
+            }
+        }
+        std::sort( Keys.begin(), Keys.end() );
+        if( std::adjacent_find( Keys.begin(), Keys.end() ) != Keys.end() )
+        {
+            return false;
+        }
+
+        // single VPLs are copied
+        for( unsigned i = 0; i < Input.uNumVPLs; i++ )
+        {
+            const unsigned c = Output.ClusterIndices[i];
+            if( NumMembers[c] == 1 && ( !ElementsMatch( &Output.PositionAndRadius[c], &Input.PositionAndRadius[i], 1 ) ||
+                                        !ElementsMatch( &Output.Data[c], &Input.Data[i], 1 ) ) )
+            {
+                return false;
+            }
+        }
+
+        for( int c = 0; c < 3; c++ )
+        {
+            if( fabs( Stats.OutputEnergy[c] - Stats.InputEnergy[c] ) > kMaxEnergyError*Stats.InputEnergy[c] )
+            {
+                return false;
+            }
+        }
+
+        return Desc.uMaxVPLs == 0 || uNumClusters <= Desc.uMaxVPLs;
+    }
+
+    static bool VPLClusteringOutputsMatch( const CPUVPLClusteringOutput& a, const CPUVPLClusteringOutput& b )
+    {
+        return a.uNumVPLs == b.uNumVPLs && a.ClusterIndices == b.ClusterIndices &&
+            ElementsMatch( a.PositionAndRadius, b.PositionAndRadius, a.uNumVPLs ) && ElementsMatch( a.Data, b.Data, a.uNumVPLs );
+    }
+
+    static bool RunVPLClusteringBenchmark( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kNumBatchLights = 256;
+
+        struct ClusteringConfig
+        {
+            bool        bBatch;
+            float       fCellSize;
+            unsigned    uMaxVPLs;
+        };
+        static const ClusteringConfig kConfigs[] =
+        {
+            { false, 12.5f, 0 }, { false, 25.0f, 0 }, { false, 50.0f, 0 }, { false, 100.0f, 0 }, { false, 25.0f, 1024 },
+            { true, 25.0f, kMaxVPLs }, { true, 25.0f, 4096 },
+        };
+
+        // the VPLs, from the AUTO path (see RunVPLGenerationBenchmark)
+        VPLGenerationScene Rig, Batch;
+        CreateVPLGenerationScene( Rig );
+        RepeatVPLGenerationScene( Rig, kNumBatchLights, Batch );
+        const unsigned uNumRigLights = (unsigned)( Rig.PointLights.size() + Rig.SpotSpheres.size() );
+
+        CPUVPLGenerator Generator;
+        CPUVPLGenerationOutput VPLs[2];
+        for( int nScene = 0; nScene < 2; nScene++ )
+        {
+            CPUVPLGenerationInput Input;
+            GetVPLGenerationInput( nScene ? Batch : Rig, Input );
+            Generator.GenerateVPLs( Input, VPLs[nScene], &Scheduler );
+        }
+
+        std::vector<VPLReceiver> Receivers;
+        GetVPLReceivers( Rig.SpotAtlas, Receivers );
+        GetVPLReceivers( Rig.PointAtlas, Receivers );
+        std::vector<double> ReferenceLighting, Lighting;
+        GatherVPLLighting( Receivers, &VPLs[0].PositionAndRadius[0], &VPLs[0].Data[0], VPLs[0].uNumVPLs, ReferenceLighting );
+
+        // the procedural scene's camera, at the benchmark resolution
+        CPUSceneDesc SceneDesc;
+        SceneDesc.uWidth = Config.uWidth;
+        SceneDesc.uHeight = Config.uHeight;
+        SceneDesc.uNumSamples = Config.uNumSamples;
+        SceneDesc.uNumPointLights = 0;
+        SceneDesc.uNumSpotLights = 0;
+        CPUScene Scene;
+        CreateCPUScene( SceneDesc, Scene );
+
+        fprintf( pReport, "\nVPL clustering, by position cell, normal (2x2 per cube face) and chromaticity (4 steps), of the VPLs of the default light rig and of the rig repeated to %u spot and %u point lights; "
+            "tile lists at %ux%u with %u VPLs per list and at most %u VPLs; light gathered at %u points on the casters; %u threads\n",
+            kNumBatchLights, kNumBatchLights, Config.uWidth, Config.uHeight, GetMaxNumVPLsPerTile( Config.uHeight ), kMaxVPLs, (unsigned)Receivers.size(), Scheduler.GetNumThreads() );
+        fprintf( pReport, "%-6s %6s %6s %8s %8s %9s %7s %8s %6s %8s %9s %10s %9s %9s %10s %10s  %s\n",
+            "lights", "cell", "budget", "VPLs in", "VPLs out", "reduction", "largest", "tile max", "p99", "overflow", "max grow", "energy err", "light err", "rms err", "ms 1 thr", "ms N thr", "check" );
+
+        bool bResult = true;
+        CPULightListOccupancy Occupancy[2];
+        for( int nScene = 0; nScene < 2; nScene++ )
+        {
+            GetVPLListOccupancy( Scene, &VPLs[nScene].PositionAndRadius[0], VPLs[nScene].uNumVPLs, Scheduler, Occupancy[nScene] );
+            fprintf( pReport, "%-6u %6s %6s %8u %8s %9s %7s %8u %6u %8u %9s %10s %9s %9s %10s %10s  %s\n", nScene ? 2*kNumBatchLights : uNumRigLights,
+                "-", "-", VPLs[nScene].uNumVPLs, "-", "-", "-", Occupancy[nScene].uMaxLength, Occupancy[nScene].uP99, Occupancy[nScene].uNumOverflowedLists, "-", "-", "-", "-", "-", "-",
+                ( VPLs[nScene].uNumVPLs > kMaxVPLs ) ? "(the first 65535 culled)" : "" );
+        }
+
+        CPUVPLClusterer Clusterer;
+        CPUVPLClusteringOutput Output, ThreadedOutput;
+        for( unsigned uConfig = 0; uConfig < sizeof(kConfigs)/sizeof(kConfigs[0]); uConfig++ )
+        {
+            const ClusteringConfig& Test = kConfigs[uConfig];
+            const CPUVPLGenerationOutput& Input = VPLs[Test.bBatch ? 1 : 0];
+
+            CPUVPLClusteringDesc Desc;
+            Desc.fCellSize = Test.fCellSize;
+            Desc.uMaxVPLs = Test.uMaxVPLs;
+
+            // on the calling thread, then with the threads
+            double fTimes[2] = { 0.0, 0.0 };
+            for( int nThreaded = 0; nThreaded < 2; nThreaded++ )
+            {
+                const unsigned uNumIterations = std::max( Config.uNumFrames, 1u );
+                for( unsigned uIteration = 0; uIteration <= uNumIterations; uIteration++ )
+                {
+                    CPUBenchmarkTimer Timer;
+                    Clusterer.ClusterVPLs( Desc, &Input.PositionAndRadius[0], &Input.Data[0], Input.uNumVPLs, nThreaded ? ThreadedOutput : Output, nThreaded ? &Scheduler : NULL );
+
+                    // (the first iteration warms up)
+                    if( uIteration > 0 )
+                    {
+                        fTimes[nThreaded] += Timer.GetSeconds();
+                    }
+                }
+                fTimes[nThreaded] /= uNumIterations;
+            }
+
+            const CPUVPLClusteringStats& Stats = Clusterer.GetStats();
+            const bool bCorrect = CheckVPLClusters( Desc, Input, Output, Stats );
+            const bool bMatch = VPLClusteringOutputsMatch( Output, ThreadedOutput );
+            bResult = bResult && bCorrect && bMatch;
+
+            double fEnergyError = 0.0;
+            for( int c = 0; c < 3; c++ )
+            {
+                fEnergyError = std::max( fEnergyError, fabs( Stats.OutputEnergy[c] - Stats.InputEnergy[c] ) / Stats.InputEnergy[c] );
+            }
+
+            CPULightListOccupancy ClusteredOccupancy;
+            GetVPLListOccupancy( Scene, &Output.PositionAndRadius[0], Output.uNumVPLs, Scheduler, ClusteredOccupancy );
+
+            // the cell size after any coarsening
+            fprintf( pReport, "%-6u %6g ", Test.bBatch ? 2*kNumBatchLights : uNumRigLights, Stats.fCellSize );
+            if( Test.uMaxVPLs )
+            {
+                fprintf( pReport, "%6u ", Test.uMaxVPLs );
+            }
+            else
+            {
+                fprintf( pReport, "%6s ", "-" );
+            }
+            fprintf( pReport, "%8u %8u %8.1fx %7u %8u %6u %8u %9.2f %10.1e ", Stats.uNumInputVPLs, Stats.uNumOutputVPLs, (double)Stats.uNumInputVPLs / Stats.uNumOutputVPLs,
+                Stats.uLargestCluster, ClusteredOccupancy.uMaxLength, ClusteredOccupancy.uP99, ClusteredOccupancy.uNumOverflowedLists, Stats.fMaxRadiusGrowth, fEnergyError );
+            if( !Test.bBatch )
+            {
+                double fTotalError, fRMSError;
+                GatherVPLLighting( Receivers, &Output.PositionAndRadius[0], &Output.Data[0], Output.uNumVPLs, Lighting );
+                GetVPLLightingErrors( ReferenceLighting, Lighting, fTotalError, fRMSError );
+                fprintf( pReport, "%+8.2f%% %8.2f%% ", fTotalError*100.0, fRMSError*100.0 );
+            }
+            else
+            {
+                fprintf( pReport, "%9s %9s ", "-", "-" );
+            }
+            fprintf( pReport, "%10.3f %10.3f  %s\n", fTimes[0]*1000.0, fTimes[1]*1000.0, GetCheckResult( bCorrect, bMatch ) );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Adaptive VPL sampling of the default light rig's RSMs against the fixed grids. The
+    // reference is a VPL at every texel, each at a quarter of the 2x2 grid's strength. The
+    // grids take the top-left texel of each k x k block at k^2/4 times the strength (k = 2
+    // is GenerateVPLsCS, and is checked against the generator), and the sampler draws its
+    // budget by texel luminance. Each is compared by the light DoVPLLighting gathers at
+    // points on the casters, averaged over a few rotations of the sampler's point set.
+    //--------------------------------------------------------------------------------------
+    static void GenerateGridVPLs( const CPUVPLGenerationInput& Input, unsigned uGridWidth, CPUVPLGenerationOutput& Output )
+    {
+        const unsigned uNumRSMs = Input.uNumSpotLights + 6*Input.uNumPointLights;
+        const float fColorScale = (float)( uGridWidth*uGridWidth ) / ( CPU_RSM_SAMPLE_WIDTH*CPU_RSM_SAMPLE_WIDTH );
+
+        Output.PositionAndRadius.clear();
+        Output.Data.clear();
+        Output.RSMOffsets.assign( 1, 0 );
+        for( unsigned uRSM = 0; uRSM < uNumRSMs; uRSM++ )
+        {
+            CPURSMParams Params;
+            CPUGetRSMParams( Input, uRSM, Params );
+            for( unsigned uY = 0; uY < CPU_RSM_RESOLUTION; uY += uGridWidth )
+            {
+                for( unsigned uX = 0; uX < CPU_RSM_RESOLUTION; uX += uGridWidth )
+                {
+                    CPUFloat4 PositionAndRadius;
+                    CPUVPLData Data;
+                    if( CPUGenerateTexelVPL( Params, uX, uY, PositionAndRadius, Data ) )
+                    {
+                        if( uGridWidth != CPU_RSM_SAMPLE_WIDTH )
+                        {
+                            Data.Color.x *= fColorScale;
+                            Data.Color.y *= fColorScale;
+                            Data.Color.z *= fColorScale;
+                        }
+                        Output.PositionAndRadius.push_back( PositionAndRadius );
+                        Output.Data.push_back( Data );
+                    }
+                }
+            }
+            Output.RSMOffsets.push_back( (unsigned)Output.Data.size() );
+        }
+        Output.uNumVPLs = (unsigned)Output.Data.size();
+    }
+
+    static bool RunVPLSamplingBenchmark( FILE* pReport, CPUTaskScheduler& Scheduler )
+    {
+        static const unsigned kGridWidths[] = { 2, 4, 8 };
+        static const unsigned kBudgets[] = { 256, 512, 1024, 2048, 4096, 8192 };
+        static const unsigned kNumRotations = 4;
+        static const unsigned kNumBatchLights = 256;
+
+        // the sum of the VPL weights is the sum of the texel weights at the grid's strength
+        static const double kMaxWeightError = 1e-5;
+
+        VPLGenerationScene Rig, Batch;
+        CreateVPLGenerationScene( Rig );
+        RepeatVPLGenerationScene( Rig, kNumBatchLights, Batch );
+        CPUVPLGenerationInput Input, BatchInput;
+        GetVPLGenerationInput( Rig, Input );
+        GetVPLGenerationInput( Batch, BatchInput );
+        const unsigned uNumRigLights = Input.uNumSpotLights + Input.uNumPointLights;
+
+        std::vector<VPLReceiver> Receivers;
+        GetVPLReceivers( Rig.SpotAtlas, Receivers );
+        GetVPLReceivers( Rig.PointAtlas, Receivers );
+
+        CPUVPLGenerationOutput Reference, VPLs, ThreadedVPLs;
+        GenerateGridVPLs( Input, 1, Reference );
+        std::vector<double> ReferenceLighting, Lighting;
+        GatherVPLLighting( Receivers, &Reference.PositionAndRadius[0], &Reference.Data[0], Reference.uNumVPLs, ReferenceLighting );
+
+        // the per-light summary
+        CPUVPLSampler Sampler;
+        CPUVPLSamplingDesc Desc;
+        Sampler.SampleVPLs( Desc, Input, VPLs, NULL );
+        const CPUVPLSamplingStats Summary = Sampler.GetStats();
+        std::vector<double> RSMWeights = Sampler.GetRSMWeights();
+        std::sort( RSMWeights.begin(), RSMWeights.end(), std::greater<double>() );
+        double fTopWeight = 0.0;
+        for( unsigned i = 0; i < ( Summary.uNumRSMs + 9 ) / 10; i++ )
+        {
+            fTopWeight += RSMWeights[i];
+        }
+
+        fprintf( pReport, "\nVPL sampling, VPL count vs. the light gathered at %u points on the casters, against a VPL at every texel of the default light rig's %u RSMs (%u VPLs); "
+            "%u of the RSMs have no VPLs, and the top 10%% of the RSMs have %.1f%% of the texel luminance; %u threads\n",
+            (unsigned)Receivers.size(), Summary.uNumRSMs, Reference.uNumVPLs, Summary.uNumEmptyRSMs, fTopWeight / Summary.fTotalWeight*100.0, Scheduler.GetNumThreads() );
+        fprintf( pReport, "%-6s %-10s %8s %8s %10s %10s %12s %10s %10s  %s\n", "lights", "sampling", "samples", "VPLs", "light err", "rms err", "rms err min", "ms 1 thr", "ms N thr", "check" );
+
+        bool bResult = true;
+        for( unsigned uGrid = 0; uGrid < sizeof(kGridWidths)/sizeof(kGridWidths[0]); uGrid++ )
+        {
+            GenerateGridVPLs( Input, kGridWidths[uGrid], VPLs );
+
+            const char* pCheck = "";
+            if( kGridWidths[uGrid] == CPU_RSM_SAMPLE_WIDTH )
+            {
+                CPUVPLGenerator Generator;
+                Generator.GenerateVPLs( Input, ThreadedVPLs, NULL );
+                const bool bMatch = VPLOutputsMatch( VPLs, ThreadedVPLs );
+                bResult = bResult && bMatch;
+                pCheck = bMatch ? "same as the generator" : "MISMATCH";
+            }
+
+            double fTotalError, fRMSError;
+            GatherVPLLighting( Receivers, &VPLs.PositionAndRadius[0], &VPLs.Data[0], VPLs.uNumVPLs, Lighting );
+            GetVPLLightingErrors( ReferenceLighting, Lighting, fTotalError, fRMSError );
+            fprintf( pReport, "%-6u grid %ux%-3u %8s %8u %+9.2f%% %9.2f%% %12s %10s %10s  %s\n", uNumRigLights, kGridWidths[uGrid], kGridWidths[uGrid], "-", VPLs.uNumVPLs,
+                fTotalError*100.0, fRMSError*100.0, "-", "-", "-", pCheck );
+        }
+
+        for( unsigned uBudget = 0; uBudget <= sizeof(kBudgets)/sizeof(kBudgets[0]); uBudget++ )
+        {
+            // the last one is the repeated rig, over the VPL limit with the grid
+            const bool bBatch = ( uBudget == sizeof(kBudgets)/sizeof(kBudgets[0]) );
+            const CPUVPLGenerationInput& TestInput = bBatch ? BatchInput : Input;
+            Desc.uNumSamples = bBatch ? 65535 : kBudgets[uBudget];
+
+            double fTotalError = 0.0, fRMSError = 0.0, fMinRMSError = HUGE_VAL;
+            unsigned uNumVPLs = 0;
+            bool bCorrect = true, bMatch = true;
+            double fTimes[2] = { 0.0, 0.0 };
+            for( unsigned uRotation = 0; uRotation < ( bBatch ? 1 : kNumRotations ); uRotation++ )
+            {
+                Desc.uSeed = uRotation;
+
+                // on the calling thread, then with the threads
+                for( int nThreaded = 0; nThreaded < 2; nThreaded++ )
+                {
+                    CPUBenchmarkTimer Timer;
+                    Sampler.SampleVPLs( Desc, TestInput, nThreaded ? ThreadedVPLs : VPLs, nThreaded ? &Scheduler : NULL );
+                    fTimes[nThreaded] += Timer.GetSeconds();
+                }
+                bMatch = bMatch && VPLOutputsMatch( VPLs, ThreadedVPLs );
+
+                const CPUVPLSamplingStats& Stats = Sampler.GetStats();
+                double fWeight = 0.0;
+                for( unsigned i = 0; i < VPLs.uNumVPLs; i++ )
+                {
+                    fWeight += CPUVPLSampler::GetTexelWeight( VPLs.Data[i] );
+                }
+                const double fExpectedWeight = Stats.fTotalWeight / ( CPU_RSM_SAMPLE_WIDTH*CPU_RSM_SAMPLE_WIDTH );
+                bCorrect = bCorrect && VPLs.uNumVPLs > 0 && VPLs.uNumVPLs <= Desc.uNumSamples && VPLs.RSMOffsets.back() == VPLs.uNumVPLs &&
+                    fabs( fWeight - fExpectedWeight ) <= kMaxWeightError*fExpectedWeight;
+                uNumVPLs += VPLs.uNumVPLs;
+
+                if( !bBatch )
+                {
+                    double fRotationTotalError, fRotationRMSError;
+                    GatherVPLLighting( Receivers, &VPLs.PositionAndRadius[0], &VPLs.Data[0], VPLs.uNumVPLs, Lighting );
+                    GetVPLLightingErrors( ReferenceLighting, Lighting, fRotationTotalError, fRotationRMSError );
+                    fTotalError += fRotationTotalError / kNumRotations;
+                    fRMSError += fRotationRMSError / kNumRotations;
+                    fMinRMSError = std::min( fMinRMSError, fRotationRMSError );
+                }
+            }
+
+            const unsigned uNumRuns = bBatch ? 1 : kNumRotations;
+            bResult = bResult && bCorrect && bMatch;
+            fprintf( pReport, "%-6u %-10s %8u %8u ", bBatch ? 2*kNumBatchLights : uNumRigLights, "adaptive", Desc.uNumSamples, ( uNumVPLs + uNumRuns/2 ) / uNumRuns );
+            if( bBatch )
+            {
+                fprintf( pReport, "%10s %10s %12s ", "-", "-", "-" );
+            }
+            else
+            {
+                fprintf( pReport, "%+9.2f%% %9.2f%% %11.2f%% ", fTotalError*100.0, fRMSError*100.0, fMinRMSError*100.0 );
+            }
+            fprintf( pReport, "%10.3f %10.3f  %s\n", fTimes[0] / uNumRuns*1000.0, fTimes[1] / uNumRuns*1000.0, GetCheckResult( bCorrect, bMatch ) );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // VPL cache: the default light rig repeated, over a scripted sequence of frames (lights
+    // moving, changing color, redrawn RSMs, a new threshold, lights removed and added back).
+    // Checks every frame that the cache has exactly the generator's VPLs, that it generated
+    // only the RSMs that changed again, and that the uploaded copy matches the cache.
+    //--------------------------------------------------------------------------------------
+    // The cache's VPLs in key order, which is the generator's order
+    static void GetSortedCacheVPLs( const CPUVPLCache& Cache, unsigned uNumRSMs, CPUVPLGenerationOutput& Output )
+    {
+        const unsigned uNumVPLs = Cache.GetNumVPLs();
+        std::vector<std::pair<unsigned, unsigned>> Keys( uNumVPLs );
+        for( unsigned i = 0; i < uNumVPLs; i++ )
+        {
+            Keys[i] = std::make_pair( Cache.GetKey( i ), i );
+        }
+        std::sort( Keys.begin(), Keys.end() );
+
+        Output.PositionAndRadius.resize( uNumVPLs );
+        Output.Data.resize( uNumVPLs );
+        Output.uNumVPLs = uNumVPLs;
+        Output.RSMOffsets.assign( uNumRSMs + 1, 0 );
+        for( unsigned i = 0; i < uNumVPLs; i++ )
+        {
+            Output.PositionAndRadius[i] = Cache.GetPositionAndRadius()[Keys[i].second];
+            Output.Data[i] = Cache.GetData()[Keys[i].second];
+            Output.RSMOffsets[std::min( Keys[i].first / CPU_RSM_SAMPLES_PER_RSM, uNumRSMs ) + 1]++;
+        }
+        for( unsigned uRSM = 0; uRSM < uNumRSMs; uRSM++ )
+        {
+            Output.RSMOffsets[uRSM + 1] += Output.RSMOffsets[uRSM];
+        }
+    }
+
+    static bool RunVPLCacheBenchmark( FILE* pReport, CPUTaskScheduler& Scheduler )
+    {
+        enum VPLCachePhase
+        {
+            PHASE_FIRST,
+            PHASE_STATIC,
+            PHASE_MOVING,
+            PHASE_COLORS,
+            PHASE_INVALIDATED,
+            PHASE_THRESHOLD,
+            PHASE_FEWER_LIGHTS,
+            PHASE_MORE_LIGHTS,
+            NUM_PHASES
+        };
+
+        static const char* kPhaseNames[NUM_PHASES] = { "first", "static", "moving", "colors", "redrawn", "threshold", "-8 point", "+8 point" };
+        static const unsigned kPhaseFrames[NUM_PHASES] = { 1, 20, 20, 20, 20, 1, 1, 1 };
+        static const unsigned kNumBatchLights = 64;
+        static const unsigned kNumRemovedLights = 8;
+        static const unsigned kMaxGap = 16;
+
+        VPLGenerationScene Rig, Batch;
+        CreateVPLGenerationScene( Rig );
+        RepeatVPLGenerationScene( Rig, kNumBatchLights, Batch );
+        const unsigned uNumRigLights = (unsigned)Rig.PointLights.size();
+        const unsigned uNumRSMs = 7*kNumBatchLights;
+
+        // the rig light each light of the batch is a copy of
+        std::vector<unsigned> RigLights( kNumBatchLights );
+        for( unsigned i = 0; i < kNumBatchLights; i++ )
+        {
+            RigLights[i] = i % uNumRigLights;
+        }
+
+        CPUVPLCache Cache;
+        Cache.Reset( uNumRSMs*CPU_RSM_SAMPLES_PER_RSM );
+        CPUVPLGenerator Generator;
+        CPUVPLGenerationOutput Reference, CacheVPLs;
+        std::vector<CPULightPoolRange> Ranges;
+        std::vector<unsigned char> UploadedPositions, UploadedData;
+        float fColorThreshold = 0.0f;
+
+        fprintf( pReport, "\nVPL cache, VPLs kept from frame to frame for the default light rig repeated to %u lights of each type (%u RSMs), per frame, against generating every RSM; %u threads\n",
+            kNumBatchLights, uNumRSMs, Scheduler.GetNumThreads() );
+        fprintf( pReport, "%-9s %6s %8s %8s %8s %7s %7s %7s %7s %9s %8s %8s  %s\n", "phase", "frames", "RSMs gen", "reused", "regen", "added", "removed", "changed", "moved", "upload KB", "ms cache", "ms full", "check" );
+
+        bool bResult = true;
+        for( unsigned uPhase = 0; uPhase < NUM_PHASES; uPhase++ )
+        {
+            unsigned long long uRSMs = 0, uReused = 0, uRegenerated = 0, uAdded = 0, uRemoved = 0, uChanged = 0, uMoved = 0;
+            size_t uUploadBytes = 0;
+            double fCacheTime = 0.0, fFullTime = 0.0;
+            bool bCorrect = true;
+
+            for( unsigned uFrame = 0; uFrame < kPhaseFrames[uPhase]; uFrame++ )
+            {
+                // what changed this frame, and the RSMs the cache should generate again
+                unsigned uExpectedNew = 0, uExpectedChanged = 0, uExpectedInvalidated = 0;
+                const unsigned uLight = ( 5*uFrame + 3 ) % kNumBatchLights;
+                unsigned uNumPointLights = kNumBatchLights;
+                switch( uPhase )
+                {
+                case PHASE_FIRST:
+                    uExpectedNew = uNumRSMs;
+                    break;
+
+                case PHASE_MOVING:
+                    // the spot light and point light become copies of another rig light
+                    RigLights[uLight] = ( RigLights[uLight] + 1 + uFrame % ( uNumRigLights - 1 ) ) % uNumRigLights;
+                    CopyVPLGenerationLight( Rig, RigLights[uLight], uLight, Batch );
+                    uExpectedChanged = 7;
+                    break;
+
+                case PHASE_COLORS:
+                    Batch.SpotColors[uLight] ^= 0x00204080u;
+                    uExpectedChanged = 1;
+                    break;
+
+                case PHASE_INVALIDATED:
+                    {
+                        // an 8x8 block of a point light face drawn again in another color
+                        const unsigned uFace = uFrame % 6;
+                        const float Color[3] = { 0.9f, 0.1f + 0.04f*uFrame, 0.2f };
+                        const unsigned uDiffuse = CPUEncodeR11G11B10( Color );
+                        for( unsigned uY = 8; uY < 16; uY++ )
+                        {
+                            for( unsigned uX = 8; uX < 16; uX++ )
+                            {
+                                Batch.PointAtlas.Diffuse[(size_t)( uLight*CPU_RSM_RESOLUTION + uY )*Batch.PointAtlas.uWidth + uFace*CPU_RSM_RESOLUTION + uX] = uDiffuse;
+                            }
+                        }
+                        Cache.InvalidateRSM( kNumBatchLights + 6*uLight + uFace );
+                        uExpectedInvalidated = 1;
+                    }
+                    break;
+
+                case PHASE_THRESHOLD:
+                    fColorThreshold = 0.3f;
+                    uExpectedChanged = uNumRSMs;
+                    break;
+
+                case PHASE_FEWER_LIGHTS:
+                    uNumPointLights -= kNumRemovedLights;
+                    break;
+
+                case PHASE_MORE_LIGHTS:
+                    uExpectedNew = 6*kNumRemovedLights;
+                    break;
+
+                default:
+                    break;
+                }
+
+                CPUVPLGenerationInput Input;
+                GetVPLGenerationInput( Batch, Input );
+                Input.fColorThreshold -= fColorThreshold;
+                Input.uNumPointLights = uNumPointLights;
+                const unsigned uNumFrameRSMs = kNumBatchLights + 6*uNumPointLights;
+
+                CPUBenchmarkTimer Timer;
+                Cache.Update( Input, &Scheduler );
+                fCacheTime += Timer.GetSeconds();
+
+                Timer.Restart();
+                Generator.GenerateVPLs( Input, Reference, &Scheduler );
+                fFullTime += Timer.GetSeconds();
+
+                // the upload, then the cache's VPLs against the generator's and the uploaded copy
+                const CPULightPool& Pool = Cache.GetPool();
+                uUploadBytes += UploadDirtyRanges( Pool, CPU_VPL_CACHE_POSITION_AND_RADIUS, sizeof(CPUFloat4), kMaxGap, Ranges, UploadedPositions );
+                uUploadBytes += UploadDirtyRanges( Pool, CPU_VPL_CACHE_DATA, sizeof(CPUVPLData), kMaxGap, Ranges, UploadedData );
+                Cache.ClearDirtyRanges();
+
+                GetSortedCacheVPLs( Cache, uNumFrameRSMs, CacheVPLs );
+                const CPUVPLCacheStats& Stats = Cache.GetStats();
+                const unsigned uNumVPLs = Cache.GetNumVPLs();
+                bCorrect = bCorrect && VPLOutputsMatch( CacheVPLs, Reference ) && Stats.uNumDroppedVPLs == 0 && Stats.uNumVPLs == uNumVPLs &&
+                    ( uNumVPLs == 0 || ( ElementsMatch( (const CPUFloat4*)&UploadedPositions[0], Cache.GetPositionAndRadius(), uNumVPLs ) &&
+                                         ElementsMatch( (const CPUVPLData*)&UploadedData[0], Cache.GetData(), uNumVPLs ) ) ) &&
+                    Stats.uNumRSMs == uNumFrameRSMs && Stats.uNumNewRSMs == uExpectedNew && Stats.uNumChangedRSMs == uExpectedChanged &&
+                    Stats.uNumInvalidatedRSMs == uExpectedInvalidated && Stats.uNumReusedRSMs + uExpectedNew + uExpectedChanged + uExpectedInvalidated == uNumFrameRSMs &&
+                    Stats.uNumReusedVPLs + Stats.uNumRegeneratedVPLs == uNumVPLs;
+
+                // nothing changed, nothing to upload
+                if( uPhase == PHASE_STATIC )
+                {
+                    bCorrect = bCorrect && Stats.uNumRegeneratedVPLs == 0 && Stats.uNumAddedVPLs == 0 && Stats.uNumRemovedVPLs == 0 && Stats.uNumMovedVPLs == 0;
+                }
+
+                uRSMs += Stats.uNumNewRSMs + Stats.uNumChangedRSMs + Stats.uNumInvalidatedRSMs;
+                uReused += Stats.uNumReusedVPLs;
+                uRegenerated += Stats.uNumRegeneratedVPLs;
+                uAdded += Stats.uNumAddedVPLs;
+                uRemoved += Stats.uNumRemovedVPLs;
+                uChanged += Stats.uNumChangedVPLs;
+                uMoved += Stats.uNumMovedVPLs;
+            }
+            if( uPhase == PHASE_STATIC )
+            {
+                bCorrect = bCorrect && uUploadBytes == 0;
+            }
+            bResult = bResult && bCorrect;
+
+            const double fFrames = (double)kPhaseFrames[uPhase];
+            fprintf( pReport, "%-9s %6u %8.1f %8.1f %8.1f %7.1f %7.1f %7.1f %7.1f %9.1f %8.3f %8.3f  %s\n", kPhaseNames[uPhase], kPhaseFrames[uPhase],
+                uRSMs / fFrames, uReused / fFrames, uRegenerated / fFrames, uAdded / fFrames, uRemoved / fFrames, uChanged / fFrames, uMoved / fFrames,
+                uUploadBytes / fFrames / 1024.0, fCacheTime / fFrames*1000.0, fFullTime / fFrames*1000.0, GetCheckResult( bCorrect ) );
+        }
+
+        return bResult;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // VPLs
+    //--------------------------------------------------------------------------------------
+    bool RunVPLBenchmarks( FILE* pReport, const CPUBenchmarkConfig& Config, CPUTaskScheduler& Scheduler )
+    {
+        bool bResult = true;
+
+        if( !RunVPLGenerationBenchmark( pReport, Config, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunVPLClusteringBenchmark( pReport, Config, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunVPLSamplingBenchmark( pReport, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        if( !RunVPLCacheBenchmark( pReport, Scheduler ) )
+        {
+            bResult = false;
+        }
+
+        return bResult;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
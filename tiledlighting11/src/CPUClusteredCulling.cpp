@@ -0,0 +1,331 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUClusteredCulling.cpp
+//
+// Clustered (3D froxel) light culling on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPUClusteredCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // 1/ln(2), since VS2012 has no log2f
+    static const float INV_LN2 = 1.44269504089f;
+
+    static float Log2( float f )
+    {
+        return logf( f ) * INV_LN2;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Slicing helpers
+    //--------------------------------------------------------------------------------------
+    float CPUClusterSlicing::GetSliceScale() const
+    {
+        return (float)uNumSlices / Log2( fFarZ / fNearZ );
+    }
+
+    float CPUClusterSlicing::GetSliceBias() const
+    {
+        return -(float)uNumSlices * Log2( fNearZ ) / Log2( fFarZ / fNearZ );
+    }
+
+    unsigned CPUClusterSlicing::GetSlice( float fViewZ ) const
+    {
+        if( !( fViewZ > 0.0f ) )
+        {
+            return 0;
+        }
+
+        float fSlice = Log2( fViewZ ) * GetSliceScale() + GetSliceBias();
+        if( fSlice < 0.0f )
+        {
+            return 0;
+        }
+
+        return std::min( (unsigned)fSlice, uNumSlices - 1 );
+    }
+
+    float CPUClusterSlicing::GetSliceStartZ( unsigned uSlice ) const
+    {
+        return ( uSlice == 0 ) ? 0.0f : fNearZ * powf( fFarZ / fNearZ, (float)uSlice / (float)uNumSlices );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUClusteredLightCuller::CPUClusteredLightCuller()
+        :m_SIMDLevel(CPU_SIMD_AUTO)
+    {
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUClusteredLightCuller::~CPUClusteredLightCuller()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Bin the lights of one tile into its depth slices. The side planes are shared by every
+    // cluster in the tile, so the 4-plane test runs once per tile. Each slice the light's depth
+    // range covers is then checked with a sphere vs. cluster bounding box test, which also
+    // removes the false positives the plane test lets through near the frustum corners.
+    //--------------------------------------------------------------------------------------
+    void CPUClusteredLightCuller::CullTileClusters( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, const TileSlopes& Slopes, const CPUClusterSlicing& Slicing, ThreadScratch& Temp, TileScratch& Scratch )
+    {
+        std::vector<unsigned>& Candidates = Temp.Candidates;
+        std::vector<unsigned>& LightsAndSlices = Temp.LightsAndSlices;
+        std::vector<unsigned>& Offsets = Temp.Offsets;
+
+        const unsigned uNumSlices = Slicing.uNumSlices;
+        Scratch.Counts.assign( uNumSlices, 0 );
+        Scratch.Indices.clear();
+
+        Candidates.clear();
+        CPULightCuller::CullLightsAgainstFrustum( Lights, Frustum, m_SIMDLevel, Candidates );
+        if( Candidates.empty() )
+        {
+            return;
+        }
+
+        // first pass: find the clusters of each candidate and count them per slice
+        LightsAndSlices.clear();
+        for( size_t i = 0; i < Candidates.size(); i++ )
+        {
+            const unsigned uLight = Candidates[i];
+            const float fX = Lights.X[uLight];
+            const float fY = Lights.Y[uLight];
+            const float fZ = Lights.Z[uLight];
+            const float fR = Lights.Radius[uLight];
+            const unsigned uFirstSlice = Slicing.GetSlice( std::max( fZ - fR, Frustum.fMinZ ) );
+            const unsigned uLastSlice = Slicing.GetSlice( std::min( fZ + fR, Frustum.fMaxZ ) );
+
+            for( unsigned uSlice = uFirstSlice; uSlice <= uLastSlice; uSlice++ )
+            {
+                // cluster depth range, padded a little so that the log2 in the lookup
+                // and the pow in GetSliceStartZ can't disagree about a boundary pixel
+                const float fZ0 = std::max( m_SliceBounds[uSlice]*0.9999f, Frustum.fMinZ );
+                const float fZ1 = std::min( m_SliceBounds[uSlice+1]*1.0001f, Frustum.fMaxZ );
+
+                const float fMinX = std::min( Slopes.fMinX*fZ0, Slopes.fMinX*fZ1 );
+                const float fMaxX = std::max( Slopes.fMaxX*fZ0, Slopes.fMaxX*fZ1 );
+                const float fMinY = std::min( Slopes.fMinY*fZ0, Slopes.fMinY*fZ1 );
+                const float fMaxY = std::max( Slopes.fMaxY*fZ0, Slopes.fMaxY*fZ1 );
+
+                const float fDX = ( fX < fMinX ) ? ( fMinX - fX ) : ( ( fX > fMaxX ) ? ( fX - fMaxX ) : 0.0f );
+                const float fDY = ( fY < fMinY ) ? ( fMinY - fY ) : ( ( fY > fMaxY ) ? ( fY - fMaxY ) : 0.0f );
+                const float fDZ = ( fZ < fZ0 ) ? ( fZ0 - fZ ) : ( ( fZ > fZ1 ) ? ( fZ - fZ1 ) : 0.0f );
+                if( fDX*fDX + fDY*fDY + fDZ*fDZ < fR*fR )
+                {
+                    LightsAndSlices.push_back( uLight | ( uSlice << 16 ) );
+                    Scratch.Counts[uSlice]++;
+                }
+            }
+        }
+
+        // exclusive scan of the counts, then scatter (keeping ascending light order within each slice)
+        Offsets.resize( uNumSlices );
+        unsigned uTotal = 0;
+        for( unsigned uSlice = 0; uSlice < uNumSlices; uSlice++ )
+        {
+            Offsets[uSlice] = uTotal;
+            uTotal += Scratch.Counts[uSlice];
+        }
+
+        Scratch.Indices.resize( uTotal );
+        for( size_t i = 0; i < LightsAndSlices.size(); i++ )
+        {
+            Scratch.Indices[Offsets[LightsAndSlices[i] >> 16]++] = (unsigned short)( LightsAndSlices[i] & 0xFFFF );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Concatenate the per-tile lists into the shared index pool
+    //--------------------------------------------------------------------------------------
+    void CPUClusteredLightCuller::GatherClusterLists( const std::vector<TileScratch>& Tiles, unsigned uNumSlices, CPUClusterLists& Lists, CPUTaskScheduler* pScheduler )
+    {
+        const unsigned uNumTiles = (unsigned)Tiles.size();
+
+        // exclusive scan over the tiles
+        std::vector<unsigned> TileOffsets( uNumTiles );
+        unsigned uTotal = 0;
+        for( unsigned uTile = 0; uTile < uNumTiles; uTile++ )
+        {
+            TileOffsets[uTile] = uTotal;
+            uTotal += (unsigned)Tiles[uTile].Indices.size();
+        }
+
+        Lists.OffsetAndCount.resize( 2*(size_t)uNumTiles*uNumSlices );
+        Lists.Indices.resize( uTotal );
+
+        CPUTaskScheduler::RangeFunction Scatter = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned uTile = uBegin; uTile < uEnd; uTile++ )
+            {
+                const TileScratch& Tile = Tiles[uTile];
+                if( !Tile.Indices.empty() )
+                {
+                    std::copy( Tile.Indices.begin(), Tile.Indices.end(), Lists.Indices.begin() + TileOffsets[uTile] );
+                }
+
+                unsigned uOffset = TileOffsets[uTile];
+                unsigned* pCluster = &Lists.OffsetAndCount[2*(size_t)uTile*uNumSlices];
+                for( unsigned uSlice = 0; uSlice < uNumSlices; uSlice++ )
+                {
+                    pCluster[2*uSlice] = uOffset;
+                    pCluster[2*uSlice+1] = Tile.Counts[uSlice];
+                    uOffset += Tile.Counts[uSlice];
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumTiles, 64, Scatter );
+        }
+        else
+        {
+            Scatter( 0, uNumTiles, 0 );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cull all clusters
+    //--------------------------------------------------------------------------------------
+    void CPUClusteredLightCuller::CullLights( const CPULightCullingInput& Input, const CPUClusterSlicing& Slicing, CPUClusteredCullingOutput& Output, CPUTaskScheduler* pScheduler )
+    {
+        assert( Input.pDepth != NULL );
+        assert( Slicing.uNumSlices > 0 && Slicing.uNumSlices <= 256 );
+        assert( Slicing.fNearZ > 0.0f && Slicing.fFarZ > Slicing.fNearZ );
+
+        const unsigned uNumTilesX = CPULightCuller::GetNumTiles( Input.uWidth, Input.uTileRes );
+        const unsigned uNumTilesY = CPULightCuller::GetNumTiles( Input.uHeight, Input.uTileRes );
+        const unsigned uNumTiles = uNumTilesX*uNumTilesY;
+        const bool bVPLsEnabled = ( Input.pVPLCenterAndRadius != NULL );
+
+        Output.uTileRes = Input.uTileRes;
+        Output.uNumTilesX = uNumTilesX;
+        Output.uNumTilesY = uNumTilesY;
+        Output.Slicing = Slicing;
+
+        CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pPointLightCenterAndRadius, Input.uNumPointLights, m_PointLights );
+        CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pSpotLightCenterAndRadius, Input.uNumSpotLights, m_SpotLights );
+        CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pVPLCenterAndRadius, bVPLsEnabled ? Input.uNumVPLs : 0, m_VPLs );
+
+        m_SliceBounds.resize( Slicing.uNumSlices + 1 );
+        for( unsigned uSlice = 0; uSlice < Slicing.uNumSlices; uSlice++ )
+        {
+            m_SliceBounds[uSlice] = Slicing.GetSliceStartZ( uSlice );
+        }
+        m_SliceBounds[Slicing.uNumSlices] = FLT_MAX;
+
+        // tile extents in NDC use the real screen size (see CPULightCuller::BuildTileFrustum)
+        const float fWidth = (float)Input.uWidth;
+        const float fHeight = (float)Input.uHeight;
+
+        m_PointTiles.resize( uNumTiles );
+        m_SpotTiles.resize( uNumTiles );
+        m_VPLTiles.resize( bVPLsEnabled ? uNumTiles : 0 );
+
+        // per-thread temporaries
+        const unsigned uNumThreads = pScheduler ? pScheduler->GetNumThreads() : 1;
+        std::vector<ThreadScratch> Temps( uNumThreads );
+
+        CPUTaskScheduler::RangeFunction CullTiles = [&]( unsigned uBegin, unsigned uEnd, unsigned uThreadIndex )
+        {
+            ThreadScratch& Temp = Temps[uThreadIndex];
+
+            for( unsigned uTile = uBegin; uTile < uEnd; uTile++ )
+            {
+                const unsigned uTileX = uTile % uNumTilesX;
+                const unsigned uTileY = uTile / uNumTilesX;
+
+                CPUTileFrustum Frustum;
+                CPULightCuller::BuildTileFrustum( Input, uTileX, uTileY, Frustum, false );
+                CPULightCuller::CalculateTileDepthBounds( Input, uTileX, uTileY, Frustum );
+
+                // the inverse projection only scales x and y, so the slopes come straight from NDC
+                TileSlopes Slopes;
+                Slopes.fMinX = ( Input.uTileRes*uTileX/fWidth*2.0f-1.0f ) * Input.mProjectionInv.m[0][0];
+                Slopes.fMaxX = ( Input.uTileRes*(uTileX+1)/fWidth*2.0f-1.0f ) * Input.mProjectionInv.m[0][0];
+                Slopes.fMinY = ( (fHeight-Input.uTileRes*(uTileY+1))/fHeight*2.0f-1.0f ) * Input.mProjectionInv.m[1][1];
+                Slopes.fMaxY = ( (fHeight-Input.uTileRes*uTileY)/fHeight*2.0f-1.0f ) * Input.mProjectionInv.m[1][1];
+
+                CullTileClusters( m_PointLights, Frustum, Slopes, Slicing, Temp, m_PointTiles[uTile] );
+                CullTileClusters( m_SpotLights, Frustum, Slopes, Slicing, Temp, m_SpotTiles[uTile] );
+                if( bVPLsEnabled )
+                {
+                    CullTileClusters( m_VPLs, Frustum, Slopes, Slicing, Temp, m_VPLTiles[uTile] );
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumTiles, 8, CullTiles );
+        }
+        else
+        {
+            CullTiles( 0, uNumTiles, 0 );
+        }
+
+        GatherClusterLists( m_PointTiles, Slicing.uNumSlices, Output.PointLists, pScheduler );
+        GatherClusterLists( m_SpotTiles, Slicing.uNumSlices, Output.SpotLists, pScheduler );
+        if( bVPLsEnabled )
+        {
+            GatherClusterLists( m_VPLTiles, Slicing.uNumSlices, Output.VPLLists, pScheduler );
+        }
+        else
+        {
+            Output.VPLLists.OffsetAndCount.clear();
+            Output.VPLLists.Indices.clear();
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Find the cluster list for a pixel
+    //--------------------------------------------------------------------------------------
+    void CPUClusteredLightCuller::GetClusterLightListInfo( const CPUClusteredCullingOutput& Output, const CPUClusterLists& Lists, unsigned uX, unsigned uY, float fViewZ, unsigned& uFirstLightIndex, unsigned& uNumLights )
+    {
+        const unsigned uTileIndex = ( uX / Output.uTileRes ) + ( uY / Output.uTileRes )*Output.uNumTilesX;
+        const unsigned uClusterIndex = uTileIndex*Output.Slicing.uNumSlices + Output.Slicing.GetSlice( fViewZ );
+
+        uFirstLightIndex = Lists.OffsetAndCount[2*uClusterIndex];
+        uNumLights = Lists.OffsetAndCount[2*uClusterIndex+1];
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
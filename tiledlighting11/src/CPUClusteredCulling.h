@@ -0,0 +1,145 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUClusteredCulling.h
+//
+// Clustered (3D froxel) light culling on the CPU. Each 16x16 tile is cut into
+// uNumSlices exponentially spaced depth slices, instead of the two halfZ lists.
+// The result is decoded by GetClusterLightListInfo in Shaders/CommonHeader.h.
+// This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    static const unsigned CPU_CLUSTER_DEFAULT_NUM_SLICES = 16;
+
+    // Exponential depth slicing. Slice k starts at fNearZ*(fFarZ/fNearZ)^(k/uNumSlices),
+    // except that slice 0 also covers [0,fNearZ) and the last slice runs to infinity.
+    struct CPUClusterSlicing
+    {
+        CPUClusterSlicing() : uNumSlices(CPU_CLUSTER_DEFAULT_NUM_SLICES), fNearZ(1.0f), fFarZ(1000.0f) {}
+
+        unsigned            uNumSlices;
+        float               fNearZ;
+        float               fFarZ;
+
+        // slice = floor( log2(viewZ)*fScale + fBias ), the form the shader lookup uses
+        float GetSliceScale() const;
+        float GetSliceBias() const;
+        unsigned GetSlice( float fViewZ ) const;
+        float GetSliceStartZ( unsigned uSlice ) const;
+    };
+
+    // Cluster grid layout:
+    // OffsetAndCount holds two uints (first index into Indices, number of lights) per cluster,
+    // with cluster index = tileIndex*uNumSlices + slice, so the clusters of a tile are contiguous.
+    // Indices is the shared R16_UINT index pool.
+    struct CPUClusterLists
+    {
+        std::vector<unsigned>       OffsetAndCount;
+        std::vector<unsigned short> Indices;
+    };
+
+    struct CPUClusteredCullingOutput
+    {
+        CPUClusteredCullingOutput() : uTileRes(CPU_CULLING_TILE_RES), uNumTilesX(0), uNumTilesY(0) {}
+
+        unsigned            uTileRes;
+        unsigned            uNumTilesX;
+        unsigned            uNumTilesY;
+        CPUClusterSlicing   Slicing;
+
+        CPUClusterLists     PointLists;
+        CPUClusterLists     SpotLists;
+        CPUClusterLists     VPLLists;
+    };
+
+    class CPUClusteredLightCuller
+    {
+    public:
+        // Constructor / destructor
+        CPUClusteredLightCuller();
+        ~CPUClusteredLightCuller();
+
+        void SetSIMDLevel( CPUSIMDLevel Level ) { m_SIMDLevel = Level; }
+
+        // Cull every cluster. uMaxNumLightsPerTile and uMaxNumVPLsPerTile in Input are ignored,
+        // since the index pools are sized to fit.
+        void CullLights( const CPULightCullingInput& Input, const CPUClusterSlicing& Slicing, CPUClusteredCullingOutput& Output, CPUTaskScheduler* pScheduler );
+
+        // Same lookup as GetClusterLightListInfo in CommonHeader.h, for a pixel at (uX,uY) with view-space depth fViewZ
+        static void GetClusterLightListInfo( const CPUClusteredCullingOutput& Output, const CPUClusterLists& Lists, unsigned uX, unsigned uY, float fViewZ, unsigned& uFirstLightIndex, unsigned& uNumLights );
+
+    private:
+        // the lists of one tile, ordered by slice
+        struct TileScratch
+        {
+            std::vector<unsigned short> Indices;
+            std::vector<unsigned>       Counts;
+        };
+
+        // per-thread temporaries
+        struct ThreadScratch
+        {
+            std::vector<unsigned>       Candidates;
+            std::vector<unsigned>       LightsAndSlices;
+            std::vector<unsigned>       Offsets;
+        };
+
+        // x/y extents of a tile as view-space slopes (x/z and y/z)
+        struct TileSlopes
+        {
+            float fMinX, fMaxX;
+            float fMinY, fMaxY;
+        };
+
+        void CullTileClusters( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, const TileSlopes& Slopes, const CPUClusterSlicing& Slicing, ThreadScratch& Temp, TileScratch& Scratch );
+        static void GatherClusterLists( const std::vector<TileScratch>& Tiles, unsigned uNumSlices, CPUClusterLists& Lists, CPUTaskScheduler* pScheduler );
+
+        CPUSIMDLevel                m_SIMDLevel;
+
+        // start of each slice plus the end of the last one, see CPUClusterSlicing::GetSliceStartZ
+        std::vector<float>          m_SliceBounds;
+
+        // per-frame view-space copies of the light arrays
+        CPUViewSpaceLights          m_PointLights;
+        CPUViewSpaceLights          m_SpotLights;
+        CPUViewSpaceLights          m_VPLs;
+
+        // per-tile lists, reused from frame to frame
+        std::vector<TileScratch>    m_PointTiles;
+        std::vector<TileScratch>    m_SpotTiles;
+        std::vector<TileScratch>    m_VPLTiles;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,264 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUCompactLightCulling.cpp
+//
+// Variable-length, prefix-sum compacted per-tile light lists.
+//--------------------------------------------------------------------------------------
+
+#include "CPUCompactLightCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUCompactLightCuller::CPUCompactLightCuller()
+        :m_SIMDLevel(CPU_SIMD_AUTO)
+        ,m_uPoolCapacity(0)
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUCompactLightCuller::~CPUCompactLightCuller()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Pool sizing policy
+    //--------------------------------------------------------------------------------------
+    unsigned CPUCompactLightCuller::GetPoolCapacityForOccupancy( unsigned long long uNumIndices )
+    {
+        const unsigned long long uGranularity = 4096;
+        unsigned long long uCapacity = uNumIndices + uNumIndices/4;
+        uCapacity = ( ( uCapacity + uGranularity - 1 ) / uGranularity ) * uGranularity;
+        return (unsigned)std::min( std::max( uCapacity, uGranularity ), 0xFFFFFFFFull );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Memory footprint of the two layouts
+    //--------------------------------------------------------------------------------------
+    size_t CPUCompactLightCuller::GetFixedLayoutSize( unsigned uNumTiles, unsigned uMaxNumLightsPerTile )
+    {
+        return (size_t)uNumTiles * ( 2*uMaxNumLightsPerTile + 4 ) * sizeof(unsigned short);
+    }
+
+    size_t CPUCompactLightCuller::GetCompactLayoutSize( unsigned uNumTiles, unsigned uPoolCapacity )
+    {
+        return (size_t)uNumTiles * 4 * sizeof(unsigned) + (size_t)uPoolCapacity * sizeof(unsigned short);
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Count pass: cull one tile into unbounded lists A and B
+    //--------------------------------------------------------------------------------------
+    void CPUCompactLightCuller::CountTile( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, CPUSIMDLevel Level, ThreadScratch& Temp, TileScratch& Tile )
+    {
+        memcpy( &Tile.uHalfZBits, &Frustum.fHalfZ, sizeof(Tile.uHalfZBits) );
+
+        // every light can land in both lists, so size the buffers for that
+        const size_t uListSize = std::max( Lights.uCount, 1u );
+        if( Temp.ListA.size() < uListSize )
+        {
+            Temp.ListA.resize( uListSize );
+            Temp.ListB.resize( uListSize );
+        }
+
+        CPULightCuller::CullLightsAgainstTile( Lights, Frustum, Level, &Temp.ListA[0], &Temp.ListB[0], (unsigned)uListSize, Tile.uCountA, Tile.uCountB );
+
+        Tile.Indices.resize( Tile.uCountA + Tile.uCountB );
+        if( Tile.uCountA ) memcpy( &Tile.Indices[0], &Temp.ListA[0], Tile.uCountA*sizeof(unsigned short) );
+        if( Tile.uCountB ) memcpy( &Tile.Indices[Tile.uCountA], &Temp.ListB[0], Tile.uCountB*sizeof(unsigned short) );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Scan and scatter passes: assign every tile its range of the pool and copy the lists in
+    //--------------------------------------------------------------------------------------
+    void CPUCompactLightCuller::ScanAndScatter( const std::vector<TileScratch>& Tiles, CPUCompactLightLists& Lists, CPUCompactLightListStats& Stats, CPUTaskScheduler* pScheduler )
+    {
+        const unsigned uNumTiles = (unsigned)Tiles.size();
+        memset( &Stats, 0, sizeof(Stats) );
+
+        // exclusive scan
+        m_TileOffsets.resize( uNumTiles );
+        unsigned long long uTotal = 0;
+        for( unsigned uTile = 0; uTile < uNumTiles; uTile++ )
+        {
+            m_TileOffsets[uTile] = uTotal;
+            const unsigned uCount = Tiles[uTile].uCountA + Tiles[uTile].uCountB;
+            uTotal += uCount;
+            Stats.uMaxNumIndicesPerTile = std::max( Stats.uMaxNumIndicesPerTile, uCount );
+        }
+        Stats.uNumIndicesRequired = uTotal;
+
+        const unsigned uCapacity = ( m_uPoolCapacity != 0 ) ? m_uPoolCapacity : (unsigned)std::min( uTotal, 0xFFFFFFFFull );
+        Lists.uCapacity = uCapacity;
+        Lists.TileInfo.resize( 4*(size_t)uNumTiles );
+        Lists.Indices.resize( uCapacity );
+
+        // tiles are truncated in scan order, so everything before the first tile
+        // that doesn't fit is intact, like a GPU pool allocated with a bump pointer
+        if( uTotal > uCapacity )
+        {
+            Stats.uNumIndicesDropped = uTotal - uCapacity;
+            for( unsigned uTile = 0; uTile < uNumTiles; uTile++ )
+            {
+                const TileScratch& Tile = Tiles[uTile];
+                if( m_TileOffsets[uTile] + Tile.uCountA + Tile.uCountB > uCapacity )
+                {
+                    Stats.uNumTruncatedTiles++;
+                }
+            }
+        }
+
+        CPUTaskScheduler::RangeFunction Scatter = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned uTile = uBegin; uTile < uEnd; uTile++ )
+            {
+                const TileScratch& Tile = Tiles[uTile];
+                const unsigned long long uOffset = std::min( m_TileOffsets[uTile], (unsigned long long)uCapacity );
+                const unsigned uSpace = (unsigned)( uCapacity - uOffset );
+                const unsigned uCountA = std::min( Tile.uCountA, uSpace );
+                const unsigned uCountB = std::min( Tile.uCountB, uSpace - uCountA );
+
+                if( uCountA ) memcpy( &Lists.Indices[(size_t)uOffset], &Tile.Indices[0], uCountA*sizeof(unsigned short) );
+                if( uCountB ) memcpy( &Lists.Indices[(size_t)uOffset + uCountA], &Tile.Indices[Tile.uCountA], uCountB*sizeof(unsigned short) );
+
+                unsigned* pInfo = &Lists.TileInfo[4*(size_t)uTile];
+                pInfo[0] = (unsigned)uOffset;
+                pInfo[1] = uCountA;
+                pInfo[2] = uCountB;
+                pInfo[3] = Tile.uHalfZBits;
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumTiles, 64, Scatter );
+        }
+        else
+        {
+            Scatter( 0, uNumTiles, 0 );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cull all tiles
+    //--------------------------------------------------------------------------------------
+    void CPUCompactLightCuller::CullLights( const CPULightCullingInput& Input, CPUCompactLightCullingOutput& Output, CPUTaskScheduler* pScheduler )
+    {
+        assert( Input.pDepth != NULL );
+
+        const unsigned uNumTilesX = CPULightCuller::GetNumTiles( Input.uWidth, Input.uTileRes );
+        const unsigned uNumTilesY = CPULightCuller::GetNumTiles( Input.uHeight, Input.uTileRes );
+        const unsigned uNumTiles = uNumTilesX*uNumTilesY;
+        const bool bVPLsEnabled = ( Input.pVPLCenterAndRadius != NULL );
+
+        Output.uTileRes = Input.uTileRes;
+        Output.uNumTilesX = uNumTilesX;
+        Output.uNumTilesY = uNumTilesY;
+
+        CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pPointLightCenterAndRadius, Input.uNumPointLights, m_PointLights );
+        CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pSpotLightCenterAndRadius, Input.uNumSpotLights, m_SpotLights );
+        CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pVPLCenterAndRadius, bVPLsEnabled ? Input.uNumVPLs : 0, m_VPLs );
+
+        m_PointTiles.resize( uNumTiles );
+        m_SpotTiles.resize( uNumTiles );
+        m_VPLTiles.resize( bVPLsEnabled ? uNumTiles : 0 );
+
+        const unsigned uNumThreads = pScheduler ? pScheduler->GetNumThreads() : 1;
+        std::vector<ThreadScratch> Temps( uNumThreads );
+        const CPUSIMDLevel Level = ResolveCPUSIMDLevel( m_SIMDLevel );
+
+        // count pass
+        CPUTaskScheduler::RangeFunction CountTiles = [&]( unsigned uBegin, unsigned uEnd, unsigned uThreadIndex )
+        {
+            ThreadScratch& Temp = Temps[uThreadIndex];
+
+            for( unsigned uTile = uBegin; uTile < uEnd; uTile++ )
+            {
+                CPUTileFrustum Frustum;
+                CPULightCuller::BuildTileFrustum( Input, uTile % uNumTilesX, uTile / uNumTilesX, Frustum );
+                CPULightCuller::CalculateTileDepthBounds( Input, uTile % uNumTilesX, uTile / uNumTilesX, Frustum );
+
+                CountTile( m_PointLights, Frustum, Level, Temp, m_PointTiles[uTile] );
+                CountTile( m_SpotLights, Frustum, Level, Temp, m_SpotTiles[uTile] );
+                if( bVPLsEnabled )
+                {
+                    CountTile( m_VPLs, Frustum, Level, Temp, m_VPLTiles[uTile] );
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumTiles, 8, CountTiles );
+        }
+        else
+        {
+            CountTiles( 0, uNumTiles, 0 );
+        }
+
+        // scan and scatter passes
+        ScanAndScatter( m_PointTiles, Output.PointLists, m_Stats.Point, pScheduler );
+        ScanAndScatter( m_SpotTiles, Output.SpotLists, m_Stats.Spot, pScheduler );
+        if( bVPLsEnabled )
+        {
+            ScanAndScatter( m_VPLTiles, Output.VPLLists, m_Stats.VPL, pScheduler );
+        }
+        else
+        {
+            Output.VPLLists = CPUCompactLightLists();
+            memset( &m_Stats.VPL, 0, sizeof(m_Stats.VPL) );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Find the list A or list B range for a pixel
+    //--------------------------------------------------------------------------------------
+    void CPUCompactLightCuller::GetCompactLightListInfo( const CPUCompactLightCullingOutput& Output, const CPUCompactLightLists& Lists, unsigned uX, unsigned uY, float fViewZ, unsigned& uFirstLightIndex, unsigned& uNumLights )
+    {
+        const unsigned uTileIndex = ( uX / Output.uTileRes ) + ( uY / Output.uTileRes )*Output.uNumTilesX;
+        const unsigned* pInfo = &Lists.TileInfo[4*(size_t)uTileIndex];
+
+        float fHalfZ;
+        memcpy( &fHalfZ, &pInfo[3], sizeof(fHalfZ) );
+
+        uFirstLightIndex = ( fViewZ < fHalfZ ) ? pInfo[0] : ( pInfo[0] + pInfo[1] );
+        uNumLights = ( fViewZ < fHalfZ ) ? pInfo[1] : pInfo[2];
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
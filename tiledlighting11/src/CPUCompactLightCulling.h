@@ -0,0 +1,160 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUCompactLightCulling.h
+//
+// Variable-length, prefix-sum compacted per-tile light lists. The halfZ culling is
+// the same as DoLightCulling, but instead of reserving GetMaxNumElementsPerTile slots
+// for every tile, the lists are built in three passes (count, exclusive scan, scatter)
+// into one dense index pool. The result is decoded by GetCompactLightListInfo in
+// Shaders/CommonHeader.h. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    // Compacted list layout:
+    // TileInfo holds four uints per tile:
+    // | First Index (List A, List B follows it) | Light Count List A | Light Count List B | HalfZ Bits |
+    // Indices is the shared R16_UINT index pool, with uCapacity entries.
+    struct CPUCompactLightLists
+    {
+        CPUCompactLightLists() : uCapacity(0) {}
+
+        std::vector<unsigned>       TileInfo;
+        std::vector<unsigned short> Indices;
+        unsigned                    uCapacity;
+    };
+
+    struct CPUCompactLightCullingOutput
+    {
+        CPUCompactLightCullingOutput() : uTileRes(CPU_CULLING_TILE_RES), uNumTilesX(0), uNumTilesY(0) {}
+
+        unsigned                uTileRes;
+        unsigned                uNumTilesX;
+        unsigned                uNumTilesY;
+
+        CPUCompactLightLists    PointLists;
+        CPUCompactLightLists    SpotLists;
+        CPUCompactLightLists    VPLLists;
+    };
+
+    // Per light type
+    struct CPUCompactLightListStats
+    {
+        // indices the frame needed, before clamping to the pool capacity
+        unsigned long long  uNumIndicesRequired;
+
+        // indices that didn't fit, and the tiles that lost some (or all) of their lights
+        unsigned long long  uNumIndicesDropped;
+        unsigned            uNumTruncatedTiles;
+
+        // longest list A + list B of any tile
+        unsigned            uMaxNumIndicesPerTile;
+    };
+
+    struct CPUCompactLightCullingStats
+    {
+        CPUCompactLightListStats    Point;
+        CPUCompactLightListStats    Spot;
+        CPUCompactLightListStats    VPL;
+    };
+
+    class CPUCompactLightCuller
+    {
+    public:
+        // Constructor / destructor
+        CPUCompactLightCuller();
+        ~CPUCompactLightCuller();
+
+        void SetSIMDLevel( CPUSIMDLevel Level ) { m_SIMDLevel = Level; }
+
+        // Capacity of each index pool. 0 sizes every pool to fit the current frame exactly;
+        // otherwise tiles past the end of the pool are truncated and reported in the stats,
+        // which is what the GPU would see with a pool allocated up front.
+        void SetPoolCapacity( unsigned uNumIndices ) { m_uPoolCapacity = uNumIndices; }
+
+        // Pool size for a measured occupancy: 25% headroom, rounded up to a multiple of 4096
+        static unsigned GetPoolCapacityForOccupancy( unsigned long long uNumIndices );
+
+        // Cull every tile. uMaxNumLightsPerTile and uMaxNumVPLsPerTile in Input are ignored,
+        // since a tile's list length is only limited by the pool.
+        void CullLights( const CPULightCullingInput& Input, CPUCompactLightCullingOutput& Output, CPUTaskScheduler* pScheduler );
+
+        const CPUCompactLightCullingStats& GetStats() const { return m_Stats; }
+
+        // Same lookup as GetCompactLightListInfo in CommonHeader.h, for a pixel at (uX,uY) with view-space depth fViewZ
+        static void GetCompactLightListInfo( const CPUCompactLightCullingOutput& Output, const CPUCompactLightLists& Lists, unsigned uX, unsigned uY, float fViewZ, unsigned& uFirstLightIndex, unsigned& uNumLights );
+
+        // Bytes used by the fixed-size PerTileLightIndexBuffer layout and by the compacted layout
+        static size_t GetFixedLayoutSize( unsigned uNumTiles, unsigned uMaxNumLightsPerTile );
+        static size_t GetCompactLayoutSize( unsigned uNumTiles, unsigned uPoolCapacity );
+
+    private:
+        // the halfZ split and lists of one tile, list A followed by list B
+        struct TileScratch
+        {
+            unsigned                    uHalfZBits;
+            unsigned                    uCountA;
+            unsigned                    uCountB;
+            std::vector<unsigned short> Indices;
+        };
+
+        // per-thread list A and B buffers, big enough for every light
+        struct ThreadScratch
+        {
+            std::vector<unsigned short> ListA;
+            std::vector<unsigned short> ListB;
+        };
+
+        static void CountTile( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, CPUSIMDLevel Level, ThreadScratch& Temp, TileScratch& Tile );
+        void ScanAndScatter( const std::vector<TileScratch>& Tiles, CPUCompactLightLists& Lists, CPUCompactLightListStats& Stats, CPUTaskScheduler* pScheduler );
+
+        CPUSIMDLevel                    m_SIMDLevel;
+        unsigned                        m_uPoolCapacity;
+        CPUCompactLightCullingStats     m_Stats;
+
+        // per-frame view-space copies of the light arrays
+        CPUViewSpaceLights              m_PointLights;
+        CPUViewSpaceLights              m_SpotLights;
+        CPUViewSpaceLights              m_VPLs;
+
+        // per-tile lists, reused from frame to frame
+        std::vector<TileScratch>        m_PointTiles;
+        std::vector<TileScratch>        m_SpotTiles;
+        std::vector<TileScratch>        m_VPLTiles;
+
+        // exclusive scan of the per-tile counts
+        std::vector<unsigned long long> m_TileOffsets;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,337 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUHierarchicalCulling.cpp
+//
+// Two-level tile culling on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPUHierarchicalCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // light types, in the order of the index buffers
+    enum
+    {
+        LIGHT_TYPE_POINT = 0,
+        LIGHT_TYPE_SPOT,
+        LIGHT_TYPE_VPL,
+        NUM_LIGHT_TYPES
+    };
+
+    // The super-tile planes are taken from its corner tiles. A tile's side plane is the
+    // same plane as its neighbours' along that side, but computed from other corners, so
+    // it can differ in the last bits. The coarse pass pads each radius by this fraction
+    // of the light's distance to cover that, so it never rejects a light a tile keeps.
+    static const float COARSE_RADIUS_PADDING = 1.0e-4f;
+
+    //--------------------------------------------------------------------------------------
+    // Copy of the lights with the radius padded for the coarse test
+    //--------------------------------------------------------------------------------------
+    static void PadLightRadii( const CPUViewSpaceLights& Lights, CPUViewSpaceLights& PaddedLights )
+    {
+        PaddedLights = Lights;
+        for( unsigned i = 0; i < Lights.uCount; i++ )
+        {
+            const float fDistance = fabsf( Lights.X[i] ) + fabsf( Lights.Y[i] ) + fabsf( Lights.Z[i] );
+            PaddedLights.Radius[i] = Lights.Radius[i] + COARSE_RADIUS_PADDING*fDistance;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUHierarchicalLightCuller::CPUHierarchicalLightCuller()
+        :m_SIMDLevel(CPU_SIMD_AUTO)
+        ,m_uSuperTileFactor(4)
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUHierarchicalLightCuller::~CPUHierarchicalLightCuller()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Coarse pass over the super-tiles, then fine pass over their tiles
+    //--------------------------------------------------------------------------------------
+    void CPUHierarchicalLightCuller::CullLights( const CPULightCullingInput& Input, CPULightCullingOutput& Output, CPUTaskScheduler* pScheduler )
+    {
+        assert( Input.pDepth != NULL );
+        assert( Input.uNumSamples > 0 );
+        assert( m_uSuperTileFactor > 0 );
+
+        const unsigned uFactor = m_uSuperTileFactor;
+        const unsigned uNumTilesX = CPULightCuller::GetNumTiles( Input.uWidth, Input.uTileRes );
+        const unsigned uNumTilesY = CPULightCuller::GetNumTiles( Input.uHeight, Input.uTileRes );
+        const unsigned uNumTiles = uNumTilesX*uNumTilesY;
+        const unsigned uNumSuperTilesX = ( uNumTilesX + uFactor - 1 ) / uFactor;
+        const unsigned uNumSuperTilesY = ( uNumTilesY + uFactor - 1 ) / uFactor;
+        const unsigned uNumSuperTiles = uNumSuperTilesX*uNumSuperTilesY;
+        const bool bVPLsEnabled = ( Input.pVPLCenterAndRadius != NULL );
+
+        // same layout as CPULightCuller::CullLights
+        Output.uTileRes = Input.uTileRes;
+        Output.uNumTilesX = uNumTilesX;
+        Output.uNumTilesY = uNumTilesY;
+        Output.uMaxNumElementsPerTile = 2*Input.uMaxNumLightsPerTile + 4;
+        Output.uMaxNumVPLElementsPerTile = 2*Input.uMaxNumVPLsPerTile + 4;
+        Output.PointIndexBuffer.assign( (size_t)uNumTiles*Output.uMaxNumElementsPerTile, 0 );
+        Output.SpotIndexBuffer.assign( (size_t)uNumTiles*Output.uMaxNumElementsPerTile, 0 );
+        if( bVPLsEnabled )
+        {
+            Output.VPLIndexBuffer.assign( (size_t)uNumTiles*Output.uMaxNumVPLElementsPerTile, 0 );
+        }
+        else
+        {
+            Output.VPLIndexBuffer.clear();
+        }
+        Output.TileFrusta.resize( uNumTiles );
+
+        const CPUFloat4* pLights[NUM_LIGHT_TYPES] = { Input.pPointLightCenterAndRadius, Input.pSpotLightCenterAndRadius, Input.pVPLCenterAndRadius };
+        const unsigned uNumLights[NUM_LIGHT_TYPES] = { Input.uNumPointLights, Input.uNumSpotLights, bVPLsEnabled ? Input.uNumVPLs : 0 };
+        for( int nType = 0; nType < NUM_LIGHT_TYPES; nType++ )
+        {
+            CPULightCuller::TransformLightsToViewSpace( Input.mView, pLights[nType], uNumLights[nType], m_Lights[nType] );
+            PadLightRadii( m_Lights[nType], m_PaddedLights[nType] );
+            m_SuperTileLists[nType].resize( uNumSuperTiles );
+        }
+
+        const unsigned uNumThreads = pScheduler ? pScheduler->GetNumThreads() : 1;
+        m_ThreadScratch.resize( uNumThreads );
+        for( unsigned i = 0; i < uNumThreads; i++ )
+        {
+            for( int nType = 0; nType < NUM_LIGHT_TYPES; nType++ )
+            {
+                m_ThreadScratch[i].Pool[nType].clear();
+            }
+        }
+
+        std::vector<CPUHierarchicalCullingStats> ThreadStats( uNumThreads );
+        memset( &ThreadStats[0], 0, sizeof(CPUHierarchicalCullingStats)*uNumThreads );
+
+        const CPUSIMDLevel Level = ResolveCPUSIMDLevel( m_SIMDLevel );
+
+        // Coarse pass: the tile frusta and depth bounds, then every light against the super-tile
+        CPUTaskScheduler::RangeFunction CullSuperTiles = [&]( unsigned uBegin, unsigned uEnd, unsigned uThreadIndex )
+        {
+            ThreadScratch& Temp = m_ThreadScratch[uThreadIndex];
+            CPUHierarchicalCullingStats& Stats = ThreadStats[uThreadIndex];
+            CPUHierarchicalListStats* pListStats[NUM_LIGHT_TYPES] = { &Stats.Point, &Stats.Spot, &Stats.VPL };
+
+            for( unsigned uSuperTile = uBegin; uSuperTile < uEnd; uSuperTile++ )
+            {
+                const unsigned uFirstTileX = ( uSuperTile % uNumSuperTilesX )*uFactor;
+                const unsigned uFirstTileY = ( uSuperTile / uNumSuperTilesX )*uFactor;
+                const unsigned uLastTileX = std::min( uFirstTileX + uFactor, uNumTilesX ) - 1;
+                const unsigned uLastTileY = std::min( uFirstTileY + uFactor, uNumTilesY ) - 1;
+
+                // the union of the tiles' depth bounds (fMinZ > fMaxZ for tiles without samples)
+                float fMinZ = FLT_MAX;
+                float fMaxZ = 0.0f;
+                for( unsigned uTileY = uFirstTileY; uTileY <= uLastTileY; uTileY++ )
+                {
+                    for( unsigned uTileX = uFirstTileX; uTileX <= uLastTileX; uTileX++ )
+                    {
+                        CPUTileFrustum& Frustum = Output.TileFrusta[uTileY*uNumTilesX + uTileX];
+                        CPULightCuller::BuildTileFrustum( Input, uTileX, uTileY, Frustum );
+                        CPULightCuller::CalculateTileDepthBounds( Input, uTileX, uTileY, Frustum );
+                        fMinZ = std::min( fMinZ, Frustum.fMinZ );
+                        fMaxZ = std::max( fMaxZ, Frustum.fMaxZ );
+                    }
+                }
+
+                // planes are ordered top, right, bottom, left (see BuildTileFrustum)
+                CPUTileFrustum SuperFrustum;
+                memcpy( SuperFrustum.Planes[0], Output.TileFrusta[uFirstTileY*uNumTilesX + uFirstTileX].Planes[0], sizeof(SuperFrustum.Planes[0]) );
+                memcpy( SuperFrustum.Planes[1], Output.TileFrusta[uFirstTileY*uNumTilesX + uLastTileX].Planes[1], sizeof(SuperFrustum.Planes[1]) );
+                memcpy( SuperFrustum.Planes[2], Output.TileFrusta[uLastTileY*uNumTilesX + uFirstTileX].Planes[2], sizeof(SuperFrustum.Planes[2]) );
+                memcpy( SuperFrustum.Planes[3], Output.TileFrusta[uFirstTileY*uNumTilesX + uFirstTileX].Planes[3], sizeof(SuperFrustum.Planes[3]) );
+                SuperFrustum.fMinZ = fMinZ;
+                SuperFrustum.fMaxZ = fMaxZ;
+                SuperFrustum.fHalfZ = fMaxZ;
+
+                const bool bEmpty = ( fMinZ > fMaxZ );
+                if( bEmpty )
+                {
+                    Stats.uNumEmptySuperTiles++;
+                }
+
+                for( int nType = 0; nType < NUM_LIGHT_TYPES; nType++ )
+                {
+                    std::vector<unsigned>& Pool = Temp.Pool[nType];
+                    SuperTileList& List = m_SuperTileLists[nType][uSuperTile];
+                    List.uThread = uThreadIndex;
+                    List.uOffset = (unsigned)Pool.size();
+
+                    if( !bEmpty )
+                    {
+                        CPULightCuller::CullLightsAgainstFrustum( m_PaddedLights[nType], SuperFrustum, Level, Pool );
+                        pListStats[nType]->uNumCoarseTests += m_PaddedLights[nType].uCount;
+                    }
+
+                    List.uCount = (unsigned)Pool.size() - List.uOffset;
+                    pListStats[nType]->uNumCoarseIndices += List.uCount;
+                }
+            }
+        };
+
+        // Fine pass: gather a super-tile's survivors once, then cull each of its tiles against them
+        CPUTaskScheduler::RangeFunction CullTiles = [&]( unsigned uBegin, unsigned uEnd, unsigned uThreadIndex )
+        {
+            ThreadScratch& Temp = m_ThreadScratch[uThreadIndex];
+            CPUHierarchicalCullingStats& Stats = ThreadStats[uThreadIndex];
+            CPUHierarchicalListStats* pListStats[NUM_LIGHT_TYPES] = { &Stats.Point, &Stats.Spot, &Stats.VPL };
+
+            for( unsigned uSuperTile = uBegin; uSuperTile < uEnd; uSuperTile++ )
+            {
+                const unsigned uFirstTileX = ( uSuperTile % uNumSuperTilesX )*uFactor;
+                const unsigned uFirstTileY = ( uSuperTile / uNumSuperTilesX )*uFactor;
+                const unsigned uLastTileX = std::min( uFirstTileX + uFactor, uNumTilesX ) - 1;
+                const unsigned uLastTileY = std::min( uFirstTileY + uFactor, uNumTilesY ) - 1;
+
+                for( int nType = 0; nType < NUM_LIGHT_TYPES; nType++ )
+                {
+                    std::vector<unsigned short>& IndexBuffer = ( nType == LIGHT_TYPE_POINT ) ? Output.PointIndexBuffer : ( nType == LIGHT_TYPE_SPOT ) ? Output.SpotIndexBuffer : Output.VPLIndexBuffer;
+                    if( IndexBuffer.empty() )
+                    {
+                        continue;
+                    }
+
+                    const unsigned uMaxNumElementsPerTile = ( nType == LIGHT_TYPE_VPL ) ? Output.uMaxNumVPLElementsPerTile : Output.uMaxNumElementsPerTile;
+                    const unsigned uListSize = ( nType == LIGHT_TYPE_VPL ) ? Input.uMaxNumVPLsPerTile : Input.uMaxNumLightsPerTile;
+
+                    // gather the survivors into a padded SoA array, in ascending light index order
+                    const SuperTileList& List = m_SuperTileLists[nType][uSuperTile];
+                    const unsigned* pSurvivors = List.uCount ? &m_ThreadScratch[List.uThread].Pool[nType][List.uOffset] : NULL;
+                    const CPUViewSpaceLights& Lights = m_Lights[nType];
+                    CPUViewSpaceLights& Survivors = Temp.Survivors;
+                    const unsigned uPaddedCount = ( List.uCount + 7 ) & ~7u;
+                    Survivors.X.assign( uPaddedCount, 0.0f );
+                    Survivors.Y.assign( uPaddedCount, 0.0f );
+                    Survivors.Z.assign( uPaddedCount, 0.0f );
+                    Survivors.Radius.assign( uPaddedCount, 0.0f );
+                    Survivors.uCount = List.uCount;
+                    for( unsigned i = 0; i < List.uCount; i++ )
+                    {
+                        const unsigned uLight = pSurvivors[i];
+                        Survivors.X[i] = Lights.X[uLight];
+                        Survivors.Y[i] = Lights.Y[uLight];
+                        Survivors.Z[i] = Lights.Z[uLight];
+                        Survivors.Radius[i] = Lights.Radius[uLight];
+                    }
+
+                    for( unsigned uTileY = uFirstTileY; uTileY <= uLastTileY; uTileY++ )
+                    {
+                        for( unsigned uTileX = uFirstTileX; uTileX <= uLastTileX; uTileX++ )
+                        {
+                            const unsigned uTile = uTileY*uNumTilesX + uTileX;
+                            const CPUTileFrustum& Frustum = Output.TileFrusta[uTile];
+                            unsigned short* pTile = &IndexBuffer[(size_t)uTile*uMaxNumElementsPerTile];
+
+                            unsigned uHalfZBits;
+                            memcpy( &uHalfZBits, &Frustum.fHalfZ, sizeof(uHalfZBits) );
+                            pTile[0] = (unsigned short)( uHalfZBits >> 16 );
+                            pTile[1] = (unsigned short)( uHalfZBits & 0x0000FFFF );
+
+                            unsigned uCountA = 0, uCountB = 0;
+                            if( List.uCount > 0 )
+                            {
+                                CPULightCuller::CullLightsAgainstTile( Survivors, Frustum, Level, Temp.ListA, Temp.ListB );
+                                uCountA = (unsigned)Temp.ListA.size();
+                                uCountB = (unsigned)Temp.ListB.size();
+
+                                // back to light indices; the survivors are in ascending order, so the lists are too
+                                for( unsigned i = 0; i < std::min( uCountA, uListSize ); i++ )
+                                {
+                                    pTile[4 + i] = (unsigned short)pSurvivors[Temp.ListA[i]];
+                                }
+                                for( unsigned i = 0; i < std::min( uCountB, uListSize ); i++ )
+                                {
+                                    pTile[4 + uListSize + i] = (unsigned short)pSurvivors[Temp.ListB[i]];
+                                }
+                            }
+
+                            pTile[2] = (unsigned short)std::min( uCountA, 0xFFFFu );
+                            pTile[3] = (unsigned short)std::min( uCountB, 0xFFFFu );
+
+                            pListStats[nType]->uNumFineTests += List.uCount;
+                            pListStats[nType]->uNumFineIndices += uCountA + uCountB;
+                            if( uCountA > uListSize || uCountB > uListSize )
+                            {
+                                pListStats[nType]->uNumOverflowedTiles++;
+                            }
+                        }
+                    }
+                }
+            }
+        };
+
+        // a super-tile is up to 16 tiles of work, so one per chunk balances well enough
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumSuperTiles, 1, CullSuperTiles );
+            pScheduler->ParallelFor( uNumSuperTiles, 1, CullTiles );
+        }
+        else
+        {
+            CullSuperTiles( 0, uNumSuperTiles, 0 );
+            CullTiles( 0, uNumSuperTiles, 0 );
+        }
+
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        m_Stats.uNumSuperTiles = uNumSuperTiles;
+        m_Stats.uNumTiles = uNumTiles;
+        for( unsigned i = 0; i < uNumThreads; i++ )
+        {
+            m_Stats.uNumEmptySuperTiles += ThreadStats[i].uNumEmptySuperTiles;
+
+            const CPUHierarchicalListStats* pSrc[NUM_LIGHT_TYPES] = { &ThreadStats[i].Point, &ThreadStats[i].Spot, &ThreadStats[i].VPL };
+            CPUHierarchicalListStats* pDst[NUM_LIGHT_TYPES] = { &m_Stats.Point, &m_Stats.Spot, &m_Stats.VPL };
+            for( int nType = 0; nType < NUM_LIGHT_TYPES; nType++ )
+            {
+                pDst[nType]->uNumCoarseTests += pSrc[nType]->uNumCoarseTests;
+                pDst[nType]->uNumCoarseIndices += pSrc[nType]->uNumCoarseIndices;
+                pDst[nType]->uNumFineTests += pSrc[nType]->uNumFineTests;
+                pDst[nType]->uNumFineIndices += pSrc[nType]->uNumFineIndices;
+                pDst[nType]->uNumOverflowedTiles += pSrc[nType]->uNumOverflowedTiles;
+            }
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,126 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUHierarchicalCulling.h
+//
+// Two-level tile culling on the CPU. A coarse pass culls every light against the
+// frusta of super-tiles (4x4 tiles, so 64x64 pixels with 16x16 tiles) into a dense
+// list per super-tile, and a fine pass culls each tile against only its super-tile's
+// survivors. The index buffers are the same as CPULightCuller's, in the
+// PerTileLightIndexBuffer layout. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    // Per light type
+    struct CPUHierarchicalListStats
+    {
+        // light vs. super-tile tests, and the lights that survived them (the intermediate list entries)
+        unsigned long long  uNumCoarseTests;
+        unsigned long long  uNumCoarseIndices;
+
+        // light vs. tile tests, and the entries over lists A and B, before clamping to the list size
+        unsigned long long  uNumFineTests;
+        unsigned long long  uNumFineIndices;
+
+        // tiles where list A or B had more entries than fit
+        unsigned            uNumOverflowedTiles;
+    };
+
+    struct CPUHierarchicalCullingStats
+    {
+        unsigned                    uNumSuperTiles;
+        unsigned                    uNumTiles;
+
+        // super-tiles without any depth samples, whose tiles skip the fine pass
+        unsigned                    uNumEmptySuperTiles;
+
+        CPUHierarchicalListStats    Point;
+        CPUHierarchicalListStats    Spot;
+        CPUHierarchicalListStats    VPL;
+    };
+
+    class CPUHierarchicalLightCuller
+    {
+    public:
+        // Constructor / destructor
+        CPUHierarchicalLightCuller();
+        ~CPUHierarchicalLightCuller();
+
+        void SetSIMDLevel( CPUSIMDLevel Level ) { m_SIMDLevel = Level; }
+
+        // Tiles per super-tile side (4 by default)
+        void SetSuperTileFactor( unsigned uFactor ) { m_uSuperTileFactor = uFactor; }
+        unsigned GetSuperTileFactor() const { return m_uSuperTileFactor; }
+
+        // Spot lights are culled with their bounding spheres, as CPU_SPOT_CULLING_SPHERE does
+        void CullLights( const CPULightCullingInput& Input, CPULightCullingOutput& Output, CPUTaskScheduler* pScheduler );
+
+        const CPUHierarchicalCullingStats& GetStats() const { return m_Stats; }
+
+    private:
+        // not copyable
+        CPUHierarchicalLightCuller( const CPUHierarchicalLightCuller& );
+        CPUHierarchicalLightCuller& operator=( const CPUHierarchicalLightCuller& );
+
+        // where a super-tile's intermediate list lives in the per-thread pools
+        struct SuperTileList
+        {
+            unsigned    uThread;
+            unsigned    uOffset;
+            unsigned    uCount;
+        };
+
+        // per-thread state: the intermediate lists, and the gathered survivors of one super-tile
+        struct ThreadScratch
+        {
+            std::vector<unsigned>   Pool[3];
+            CPUViewSpaceLights      Survivors;
+            std::vector<unsigned>   ListA;
+            std::vector<unsigned>   ListB;
+        };
+
+        CPUSIMDLevel                    m_SIMDLevel;
+        unsigned                        m_uSuperTileFactor;
+        CPUHierarchicalCullingStats     m_Stats;
+
+        // per-frame view-space copies of the light arrays, exact for the fine pass
+        // and with the radius padded for the coarse pass
+        CPUViewSpaceLights              m_Lights[3];
+        CPUViewSpaceLights              m_PaddedLights[3];
+
+        std::vector<SuperTileList>      m_SuperTileLists[3];
+        std::vector<ThreadScratch>      m_ThreadScratch;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
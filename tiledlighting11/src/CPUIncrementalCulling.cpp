@@ -0,0 +1,345 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUIncrementalCulling.cpp
+//
+// Incremental light culling on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPUIncrementalCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // light types, in the order of the index buffers
+    enum
+    {
+        LIGHT_TYPE_POINT = 0,
+        LIGHT_TYPE_SPOT,
+        LIGHT_TYPE_VPL,
+        NUM_LIGHT_TYPES
+    };
+
+    static const unsigned ALL_LISTS_DIRTY = ( 1u << NUM_LIGHT_TYPES ) - 1;
+
+    //--------------------------------------------------------------------------------------
+    // Append the old and new versions of every light that differs from last frame
+    //--------------------------------------------------------------------------------------
+    static unsigned GatherChangedLights( const std::vector<CPUFloat4>& PrevLights, const CPUFloat4* pLights, unsigned uCount, std::vector<CPUFloat4>& Changed )
+    {
+        assert( PrevLights.size() == uCount );
+
+        unsigned uNumChanged = 0;
+        for( unsigned i = 0; i < uCount; i++ )
+        {
+            if( memcmp( &PrevLights[i], &pLights[i], sizeof(CPUFloat4) ) != 0 )
+            {
+                Changed.push_back( PrevLights[i] );
+                Changed.push_back( pLights[i] );
+                uNumChanged++;
+            }
+        }
+
+        return uNumChanged;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUIncrementalLightCuller::CPUIncrementalLightCuller()
+        :m_SIMDLevel(CPU_SIMD_AUTO)
+        ,m_fDepthTolerance(0.0f)
+        ,m_bValid(false)
+        ,m_uWidth(0)
+        ,m_uHeight(0)
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        memset( &m_mView, 0, sizeof(m_mView) );
+        memset( &m_mProjectionInv, 0, sizeof(m_mProjectionInv) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUIncrementalLightCuller::~CPUIncrementalLightCuller()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Can last frame's lists be kept, or does every tile need culling
+    //--------------------------------------------------------------------------------------
+    bool CPUIncrementalLightCuller::IsLastFrameValid( const CPULightCullingInput& Input, const CPULightCullingOutput& Output ) const
+    {
+        const bool bVPLsEnabled = ( Input.pVPLCenterAndRadius != NULL );
+        const unsigned uNumTilesX = CPULightCuller::GetNumTiles( Input.uWidth, Input.uTileRes );
+        const unsigned uNumTilesY = CPULightCuller::GetNumTiles( Input.uHeight, Input.uTileRes );
+        const size_t uNumTiles = (size_t)uNumTilesX*uNumTilesY;
+
+        if( !m_bValid || Input.uWidth != m_uWidth || Input.uHeight != m_uHeight )
+        {
+            return false;
+        }
+
+        // the camera moved
+        if( memcmp( &Input.mView, &m_mView, sizeof(CPUMatrix) ) != 0 || memcmp( &Input.mProjectionInv, &m_mProjectionInv, sizeof(CPUMatrix) ) != 0 )
+        {
+            return false;
+        }
+
+        if( Input.uNumPointLights != m_PrevLights[LIGHT_TYPE_POINT].size() ||
+            Input.uNumSpotLights != m_PrevLights[LIGHT_TYPE_SPOT].size() ||
+            ( bVPLsEnabled ? Input.uNumVPLs : 0 ) != m_PrevLights[LIGHT_TYPE_VPL].size() )
+        {
+            return false;
+        }
+
+        // Output isn't last frame's, or the list sizes changed
+        return Output.uTileRes == Input.uTileRes && Output.uNumTilesX == uNumTilesX && Output.uNumTilesY == uNumTilesY &&
+            Output.uMaxNumElementsPerTile == 2*Input.uMaxNumLightsPerTile + 4 &&
+            Output.uMaxNumVPLElementsPerTile == 2*Input.uMaxNumVPLsPerTile + 4 &&
+            Output.PointIndexBuffer.size() == uNumTiles*Output.uMaxNumElementsPerTile &&
+            Output.SpotIndexBuffer.size() == uNumTiles*Output.uMaxNumElementsPerTile &&
+            Output.VPLIndexBuffer.size() == ( bVPLsEnabled ? uNumTiles*Output.uMaxNumVPLElementsPerTile : 0 ) &&
+            Output.TileFrusta.size() == uNumTiles &&
+            m_TileDepthBounds.size() == 2*uNumTiles;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Re-cull the dirty lists
+    //--------------------------------------------------------------------------------------
+    void CPUIncrementalLightCuller::CullLights( const CPULightCullingInput& Input, CPULightCullingOutput& Output, CPUTaskScheduler* pScheduler )
+    {
+        assert( Input.pDepth != NULL );
+        assert( Input.uNumSamples > 0 );
+
+        const unsigned uNumTilesX = CPULightCuller::GetNumTiles( Input.uWidth, Input.uTileRes );
+        const unsigned uNumTilesY = CPULightCuller::GetNumTiles( Input.uHeight, Input.uTileRes );
+        const unsigned uNumTiles = uNumTilesX*uNumTilesY;
+        const bool bVPLsEnabled = ( Input.pVPLCenterAndRadius != NULL );
+
+        const CPUFloat4* pLights[NUM_LIGHT_TYPES] = { Input.pPointLightCenterAndRadius, Input.pSpotLightCenterAndRadius, Input.pVPLCenterAndRadius };
+        const unsigned uNumLights[NUM_LIGHT_TYPES] = { Input.uNumPointLights, Input.uNumSpotLights, bVPLsEnabled ? Input.uNumVPLs : 0 };
+
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        m_Stats.uNumTiles = uNumTiles;
+        m_Stats.bFullCull = !IsLastFrameValid( Input, Output );
+
+        if( m_Stats.bFullCull )
+        {
+            // same layout as CPULightCuller::CullLights
+            Output.uTileRes = Input.uTileRes;
+            Output.uNumTilesX = uNumTilesX;
+            Output.uNumTilesY = uNumTilesY;
+            Output.uMaxNumElementsPerTile = 2*Input.uMaxNumLightsPerTile + 4;
+            Output.uMaxNumVPLElementsPerTile = 2*Input.uMaxNumVPLsPerTile + 4;
+            Output.PointIndexBuffer.assign( (size_t)uNumTiles*Output.uMaxNumElementsPerTile, 0 );
+            Output.SpotIndexBuffer.assign( (size_t)uNumTiles*Output.uMaxNumElementsPerTile, 0 );
+            if( bVPLsEnabled )
+            {
+                Output.VPLIndexBuffer.assign( (size_t)uNumTiles*Output.uMaxNumVPLElementsPerTile, 0 );
+            }
+            else
+            {
+                Output.VPLIndexBuffer.clear();
+            }
+            Output.TileFrusta.resize( uNumTiles );
+            m_TileDepthBounds.resize( 2*(size_t)uNumTiles );
+        }
+
+        // the lights that moved or changed size since last frame; when most of a type changed,
+        // finding their tiles costs more than culling every tile
+        bool bAllListsDirty[NUM_LIGHT_TYPES] = { m_Stats.bFullCull, m_Stats.bFullCull, m_Stats.bFullCull };
+        unsigned uNumChanged[NUM_LIGHT_TYPES] = { 0, 0, 0 };
+        for( int nType = 0; nType < NUM_LIGHT_TYPES; nType++ )
+        {
+            CPULightCuller::TransformLightsToViewSpace( Input.mView, pLights[nType], uNumLights[nType], m_Lights[nType] );
+
+            m_ChangedCenterAndRadius.clear();
+            if( !m_Stats.bFullCull )
+            {
+                uNumChanged[nType] = GatherChangedLights( m_PrevLights[nType], pLights[nType], uNumLights[nType], m_ChangedCenterAndRadius );
+                bAllListsDirty[nType] = ( 2*uNumChanged[nType] >= uNumLights[nType] ) && ( uNumChanged[nType] > 0 );
+            }
+
+            CPULightCuller::TransformLightsToViewSpace( Input.mView, m_ChangedCenterAndRadius.empty() ? NULL : &m_ChangedCenterAndRadius[0],
+                bAllListsDirty[nType] ? 0 : (unsigned)m_ChangedCenterAndRadius.size(), m_ChangedLights[nType] );
+        }
+        m_Stats.uNumChangedPointLights = uNumChanged[LIGHT_TYPE_POINT];
+        m_Stats.uNumChangedSpotLights = uNumChanged[LIGHT_TYPE_SPOT];
+        m_Stats.uNumChangedVPLs = uNumChanged[LIGHT_TYPE_VPL];
+
+        const unsigned uNumThreads = pScheduler ? pScheduler->GetNumThreads() : 1;
+        std::vector<CPUIncrementalCullingStats> ThreadStats( uNumThreads );
+        memset( &ThreadStats[0], 0, sizeof(CPUIncrementalCullingStats)*uNumThreads );
+        std::vector< std::vector<unsigned> > ThreadIndices( uNumThreads );
+
+        const CPUSIMDLevel Level = ResolveCPUSIMDLevel( m_SIMDLevel );
+        const float fTolerance = m_fDepthTolerance;
+        const bool bFullCull = m_Stats.bFullCull;
+
+        CPUTaskScheduler::RangeFunction CullTiles = [&]( unsigned uBegin, unsigned uEnd, unsigned uThreadIndex )
+        {
+            CPUIncrementalCullingStats& Stats = ThreadStats[uThreadIndex];
+            std::vector<unsigned>& Indices = ThreadIndices[uThreadIndex];
+
+            for( unsigned uTile = uBegin; uTile < uEnd; uTile++ )
+            {
+                const unsigned uTileX = uTile % uNumTilesX;
+                const unsigned uTileY = uTile / uNumTilesX;
+
+                CPUTileFrustum NewFrustum;
+                CPULightCuller::BuildTileFrustum( Input, uTileX, uTileY, NewFrustum );
+                CPULightCuller::CalculateTileDepthBounds( Input, uTileX, uTileY, NewFrustum );
+
+                float* pDepthBounds = &m_TileDepthBounds[2*(size_t)uTile];
+                const bool bDepthDirty = bFullCull ||
+                    !( fabsf( NewFrustum.fMinZ - pDepthBounds[0] ) <= fTolerance && fabsf( NewFrustum.fMaxZ - pDepthBounds[1] ) <= fTolerance );
+
+                unsigned uDirtyLists = 0;
+                if( bDepthDirty )
+                {
+                    uDirtyLists = ALL_LISTS_DIRTY;
+                    if( !bFullCull )
+                    {
+                        Stats.uNumDepthDirtyTiles++;
+                    }
+
+                    pDepthBounds[0] = NewFrustum.fMinZ;
+                    pDepthBounds[1] = NewFrustum.fMaxZ;
+
+                    // grow the bounds of tiles with depth samples, leaving fHalfZ where it is
+                    if( NewFrustum.fMinZ <= NewFrustum.fMaxZ )
+                    {
+                        NewFrustum.fMinZ -= fTolerance;
+                        NewFrustum.fMaxZ += fTolerance;
+                    }
+                    Output.TileFrusta[uTile] = NewFrustum;
+                }
+                else
+                {
+                    // a list changes only if a changed light overlaps the tile before or after the change
+                    for( int nType = 0; nType < NUM_LIGHT_TYPES; nType++ )
+                    {
+                        bool bDirty = bAllListsDirty[nType];
+                        if( !bDirty && m_ChangedLights[nType].uCount > 0 )
+                        {
+                            Indices.clear();
+                            CPULightCuller::CullLightsAgainstFrustum( m_ChangedLights[nType], Output.TileFrusta[uTile], Level, Indices );
+                            bDirty = !Indices.empty();
+                        }
+
+                        if( bDirty )
+                        {
+                            uDirtyLists |= 1u << nType;
+                            Stats.uNumLightDirtyLists++;
+                        }
+                    }
+                }
+
+                if( uDirtyLists == 0 )
+                {
+                    continue;
+                }
+
+                const CPUTileFrustum& Frustum = Output.TileFrusta[uTile];
+
+                // store fHalfZ for this tile as two 16-bit unsigned values
+                unsigned uHalfZBits;
+                memcpy( &uHalfZBits, &Frustum.fHalfZ, sizeof(uHalfZBits) );
+                const unsigned short uHalfZBitsHigh = (unsigned short)( uHalfZBits >> 16 );
+                const unsigned short uHalfZBitsLow = (unsigned short)( uHalfZBits & 0x0000FFFF );
+
+                unsigned short* pTiles[NUM_LIGHT_TYPES] =
+                {
+                    &Output.PointIndexBuffer[(size_t)uTile*Output.uMaxNumElementsPerTile],
+                    &Output.SpotIndexBuffer[(size_t)uTile*Output.uMaxNumElementsPerTile],
+                    bVPLsEnabled ? &Output.VPLIndexBuffer[(size_t)uTile*Output.uMaxNumVPLElementsPerTile] : NULL,
+                };
+                const unsigned uListSizes[NUM_LIGHT_TYPES] = { Input.uMaxNumLightsPerTile, Input.uMaxNumLightsPerTile, Input.uMaxNumVPLsPerTile };
+
+                Stats.uNumDirtyTiles++;
+                for( int nType = 0; nType < NUM_LIGHT_TYPES; nType++ )
+                {
+                    unsigned short* pTile = pTiles[nType];
+                    if( pTile == NULL || ( uDirtyLists & ( 1u << nType ) ) == 0 )
+                    {
+                        continue;
+                    }
+
+                    const unsigned uListSize = uListSizes[nType];
+                    unsigned uCountA = 0, uCountB = 0;
+                    CPULightCuller::CullLightsAgainstTile( m_Lights[nType], Frustum, Level, pTile + 4, pTile + 4 + uListSize, uListSize, uCountA, uCountB );
+
+                    // clear what is left of last frame's lists, as CPULightCuller starts from a cleared buffer
+                    std::fill( pTile + 4 + std::min( uCountA, uListSize ), pTile + 4 + uListSize, (unsigned short)0 );
+                    std::fill( pTile + 4 + uListSize + std::min( uCountB, uListSize ), pTile + 4 + 2*uListSize, (unsigned short)0 );
+
+                    pTile[0] = uHalfZBitsHigh;
+                    pTile[1] = uHalfZBitsLow;
+                    pTile[2] = (unsigned short)std::min( uCountA, 0xFFFFu );
+                    pTile[3] = (unsigned short)std::min( uCountB, 0xFFFFu );
+                    Stats.uNumDirtyLists++;
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumTiles, 8, CullTiles );
+        }
+        else
+        {
+            CullTiles( 0, uNumTiles, 0 );
+        }
+
+        for( unsigned i = 0; i < uNumThreads; i++ )
+        {
+            m_Stats.uNumDirtyTiles += ThreadStats[i].uNumDirtyTiles;
+            m_Stats.uNumDirtyLists += ThreadStats[i].uNumDirtyLists;
+            m_Stats.uNumDepthDirtyTiles += ThreadStats[i].uNumDepthDirtyTiles;
+            m_Stats.uNumLightDirtyLists += ThreadStats[i].uNumLightDirtyLists;
+        }
+
+        // remember this frame
+        m_bValid = true;
+        m_mView = Input.mView;
+        m_mProjectionInv = Input.mProjectionInv;
+        m_uWidth = Input.uWidth;
+        m_uHeight = Input.uHeight;
+        for( int nType = 0; nType < NUM_LIGHT_TYPES; nType++ )
+        {
+            m_PrevLights[nType].assign( pLights[nType], pLights[nType] + uNumLights[nType] );
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,119 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUIncrementalCulling.h
+//
+// Incremental light culling on the CPU. The culler keeps last frame's per-tile lists,
+// tile depth bounds, camera and light arrays, and only re-culls the lists that can have
+// changed: every list when the camera moves, every list of a tile whose depth bounds
+// moved by more than a tolerance, and the list of a light type in the tiles that a
+// changed light overlapped before or overlaps now. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    struct CPUIncrementalCullingStats
+    {
+        unsigned            uNumTiles;
+
+        // every list was culled, because this is the first frame, or the camera, screen size,
+        // light counts or list sizes changed
+        bool                bFullCull;
+
+        // tiles with at least one re-culled list, and re-culled lists (up to three per tile)
+        unsigned            uNumDirtyTiles;
+        unsigned            uNumDirtyLists;
+
+        // tiles re-culled because their depth bounds moved, and lists re-culled only because of lights
+        unsigned            uNumDepthDirtyTiles;
+        unsigned            uNumLightDirtyLists;
+
+        // lights whose center or radius differs from last frame
+        unsigned            uNumChangedPointLights;
+        unsigned            uNumChangedSpotLights;
+        unsigned            uNumChangedVPLs;
+    };
+
+    class CPUIncrementalLightCuller
+    {
+    public:
+        // Constructor / destructor
+        CPUIncrementalLightCuller();
+        ~CPUIncrementalLightCuller();
+
+        void SetSIMDLevel( CPUSIMDLevel Level ) { m_SIMDLevel = Level; }
+
+        // A tile is re-culled when its view-space min or max depth moves by more than fTolerance.
+        // Re-culled tiles are culled against bounds grown by fTolerance, so the lists stay a
+        // superset of what a full cull would give. With 0 (the default) the index buffers are
+        // the same as CPULightCuller's.
+        void SetDepthTolerance( float fTolerance ) { m_fDepthTolerance = fTolerance; }
+
+        // Forget last frame, so that the next CullLights culls every tile
+        void Invalidate() { m_bValid = false; }
+
+        // Output must be what the previous call wrote (it is culled from scratch otherwise).
+        // Spot lights are culled with their bounding spheres, as CPU_SPOT_CULLING_SPHERE does.
+        void CullLights( const CPULightCullingInput& Input, CPULightCullingOutput& Output, CPUTaskScheduler* pScheduler );
+
+        const CPUIncrementalCullingStats& GetStats() const { return m_Stats; }
+
+    private:
+        // not copyable
+        CPUIncrementalLightCuller( const CPUIncrementalLightCuller& );
+        CPUIncrementalLightCuller& operator=( const CPUIncrementalLightCuller& );
+
+        bool IsLastFrameValid( const CPULightCullingInput& Input, const CPULightCullingOutput& Output ) const;
+
+        CPUSIMDLevel                m_SIMDLevel;
+        float                       m_fDepthTolerance;
+        bool                        m_bValid;
+        CPUIncrementalCullingStats  m_Stats;
+
+        // last frame's camera and light arrays
+        CPUMatrix                   m_mView;
+        CPUMatrix                   m_mProjectionInv;
+        unsigned                    m_uWidth;
+        unsigned                    m_uHeight;
+        std::vector<CPUFloat4>      m_PrevLights[3];
+
+        // last frame's tile depth bounds, before the tolerance was added (min, max per tile)
+        std::vector<float>          m_TileDepthBounds;
+
+        // per-frame view-space copies of the light arrays, and of the changed lights (old and new)
+        CPUViewSpaceLights          m_Lights[3];
+        CPUViewSpaceLights          m_ChangedLights[3];
+        std::vector<CPUFloat4>      m_ChangedCenterAndRadius;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,583 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPULightAnimation.cpp
+//
+// Parametric light animation on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPULightAnimation.h"
+#include "CPUSIMD.h"
+#include "CPUSpotLightCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    static const unsigned BLOCK_SIZE = 8;
+
+    // Same as the spot lights of LightUtil::InitLights: the cone of maximum volume inside
+    // the bounding sphere, with height (the falloff radius) 4/3 of the sphere radius
+    static const float SPOT_COSINE_OF_CONE_ANGLE = 0.816496580927726f;
+    static const float SPOT_FALLOFF_SCALE = 1.333333333333f;
+
+    static const float TWO_PI = 6.28318530718f;
+
+    // Taylor series of sin(x) on [-pi/2,pi/2], good to about 1e-7
+    static const float SIN_C3 = -1.0f/6.0f;
+    static const float SIN_C5 = 1.0f/120.0f;
+    static const float SIN_C7 = -1.0f/5040.0f;
+    static const float SIN_C9 = 1.0f/362880.0f;
+    static const float SIN_C11 = -1.0f/39916800.0f;
+
+    //--------------------------------------------------------------------------------------
+    // Scalar path. The SIMD paths below do the same operations in the same order, so all
+    // three give the same bits.
+    //--------------------------------------------------------------------------------------
+    static float Fract( float p )
+    {
+        float t = (float)(int)p;
+        if( p < t )
+        {
+            t -= 1.0f;
+        }
+        return p - t;
+    }
+
+    // sin(2*pi*p)
+    static float Sin2Pi( float p )
+    {
+        // q in [-0.5,0.5), then folded into [-0.25,0.25] with sin(pi - x) = sin(x),
+        // and sin(2*pi*p) = -sin(2*pi*q) = sin(-2*pi*q)
+        float q = Fract( p ) - 0.5f;
+        q = std::min( q, 0.5f - q );
+        q = std::max( q, -0.5f - q );
+        const float x = q*-TWO_PI;
+        const float x2 = x*x;
+
+        float s = SIN_C11;
+        s = s*x2 + SIN_C9;
+        s = s*x2 + SIN_C7;
+        s = s*x2 + SIN_C5;
+        s = s*x2 + SIN_C3;
+        s = s*x2 + 1.0f;
+        return s*x;
+    }
+
+    static unsigned PackColor( float r, float g, float b )
+    {
+        const unsigned uR = (unsigned)(int)( r*255.0f + 0.5f );
+        const unsigned uG = (unsigned)(int)( g*255.0f + 0.5f );
+        const unsigned uB = (unsigned)(int)( b*255.0f + 0.5f );
+        return uR | ( uG << 8 ) | ( uB << 16 ) | 0xFF000000u;
+    }
+
+    static void AnimateLightScalar( const CPULightAnimationBlock& Block, unsigned uLane, float fTime, unsigned uLight,
+        CPUFloat4* pCenterAndRadius, unsigned* pColor, CPUSpotParams* pSpotParams, CPUMatrix* pSpotMatrices )
+    {
+        const float fPhase = Block.Phase[uLane];
+
+        const float fOrbit = Block.OrbitRate[uLane]*fTime + fPhase;
+        const float fBob = Block.BobRate[uLane]*fTime + fPhase;
+        const float fFlicker = Block.FlickerRate[uLane]*fTime + fPhase;
+        const float fRadius = Block.Radius[uLane]*( 1.0f + Block.Flicker[uLane]*Sin2Pi( fFlicker ) );
+
+        CPUFloat4& CenterAndRadius = pCenterAndRadius[uLight];
+        CenterAndRadius.x = Block.PivotX[uLane] + Block.OrbitRadius[uLane]*Sin2Pi( fOrbit + 0.25f );
+        CenterAndRadius.y = Block.PivotY[uLane] + Block.BobHeight[uLane]*Sin2Pi( fBob );
+        CenterAndRadius.z = Block.PivotZ[uLane] + Block.OrbitRadius[uLane]*Sin2Pi( fOrbit );
+        CenterAndRadius.w = fRadius;
+
+        const float fColor = 0.5f + 0.5f*Sin2Pi( Block.ColorRate[uLane]*fTime + fPhase );
+        pColor[uLight] = PackColor(
+            Block.ColorAR[uLane] + ( Block.ColorBR[uLane] - Block.ColorAR[uLane] )*fColor,
+            Block.ColorAG[uLane] + ( Block.ColorBG[uLane] - Block.ColorAG[uLane] )*fColor,
+            Block.ColorAB[uLane] + ( Block.ColorBB[uLane] - Block.ColorAB[uLane] )*fColor );
+
+        if( pSpotParams == NULL && pSpotMatrices == NULL )
+        {
+            return;
+        }
+
+        const float fDir = Block.DirRate[uLane]*fTime + fPhase;
+        const float Dir[3] = { Block.DirXZ[uLane]*Sin2Pi( fDir + 0.25f ), Block.DirY[uLane], Block.DirXZ[uLane]*Sin2Pi( fDir ) };
+
+        if( pSpotParams != NULL )
+        {
+            pSpotParams[uLight] = PackCPUSpotParams( Dir, SPOT_COSINE_OF_CONE_ANGLE, fRadius*SPOT_FALLOFF_SCALE );
+        }
+
+        if( pSpotMatrices != NULL )
+        {
+            CalcCPUSpotLightRotation( Dir, pSpotMatrices[uLight] );
+        }
+    }
+
+#if CPU_SIMD_X86
+    //--------------------------------------------------------------------------------------
+    // SSE path, four lights at a time
+    //--------------------------------------------------------------------------------------
+    static inline __m128 FractSSE( __m128 p )
+    {
+        __m128 t = _mm_cvtepi32_ps( _mm_cvttps_epi32( p ) );
+        t = _mm_sub_ps( t, _mm_and_ps( _mm_cmplt_ps( p, t ), _mm_set1_ps( 1.0f ) ) );
+        return _mm_sub_ps( p, t );
+    }
+
+    static inline __m128 Sin2PiSSE( __m128 p )
+    {
+        __m128 q = _mm_sub_ps( FractSSE( p ), _mm_set1_ps( 0.5f ) );
+        q = _mm_min_ps( q, _mm_sub_ps( _mm_set1_ps( 0.5f ), q ) );
+        q = _mm_max_ps( q, _mm_sub_ps( _mm_set1_ps( -0.5f ), q ) );
+        const __m128 x = _mm_mul_ps( q, _mm_set1_ps( -TWO_PI ) );
+        const __m128 x2 = _mm_mul_ps( x, x );
+
+        __m128 s = _mm_set1_ps( SIN_C11 );
+        s = _mm_add_ps( _mm_mul_ps( s, x2 ), _mm_set1_ps( SIN_C9 ) );
+        s = _mm_add_ps( _mm_mul_ps( s, x2 ), _mm_set1_ps( SIN_C7 ) );
+        s = _mm_add_ps( _mm_mul_ps( s, x2 ), _mm_set1_ps( SIN_C5 ) );
+        s = _mm_add_ps( _mm_mul_ps( s, x2 ), _mm_set1_ps( SIN_C3 ) );
+        s = _mm_add_ps( _mm_mul_ps( s, x2 ), _mm_set1_ps( 1.0f ) );
+        return _mm_mul_ps( s, x );
+    }
+
+    // CPUConvertF32ToF16 in each 32-bit lane
+    static inline __m128i ConvertF32ToF16SSE( __m128 f )
+    {
+        const __m128i uBits = _mm_castps_si128( f );
+        const __m128i uSign = _mm_and_si128( _mm_srli_epi32( uBits, 16 ), _mm_set1_epi32( 0x8000 ) );
+        const __m128i nExponent = _mm_sub_epi32( _mm_and_si128( _mm_srli_epi32( uBits, 23 ), _mm_set1_epi32( 0xFF ) ), _mm_set1_epi32( 127 - 15 ) );
+        const __m128i uMantissa = _mm_and_si128( _mm_srli_epi32( uBits, 13 ), _mm_set1_epi32( 0x3FF ) );
+        const __m128i uHalf = _mm_and_si128( _mm_or_si128( _mm_or_si128( uSign, _mm_slli_epi32( nExponent, 10 ) ), uMantissa ), _mm_set1_epi32( 0xFFFF ) );
+
+        // denorms flush to (signed) zero
+        const __m128i Normal = _mm_cmpgt_epi32( nExponent, _mm_setzero_si128() );
+        return _mm_or_si128( _mm_and_si128( Normal, uHalf ), _mm_andnot_si128( Normal, uSign ) );
+    }
+
+    static inline __m128i PackColorSSE( __m128 r, __m128 g, __m128 b )
+    {
+        const __m128 Scale = _mm_set1_ps( 255.0f );
+        const __m128 Half = _mm_set1_ps( 0.5f );
+        const __m128i uR = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( r, Scale ), Half ) );
+        const __m128i uG = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( g, Scale ), Half ) );
+        const __m128i uB = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( b, Scale ), Half ) );
+        return _mm_or_si128( _mm_or_si128( uR, _mm_slli_epi32( uG, 8 ) ), _mm_or_si128( _mm_slli_epi32( uB, 16 ), _mm_set1_epi32( (int)0xFF000000u ) ) );
+    }
+
+    // the four lights' (x,y,z,w) at p, p + uStride, p + 2*uStride and p + 3*uStride
+    static inline void StoreFloat4SSE( float* p, unsigned uStride, __m128 x, __m128 y, __m128 z, __m128 w )
+    {
+        _MM_TRANSPOSE4_PS( x, y, z, w );
+        _mm_storeu_ps( p, x );
+        _mm_storeu_ps( p + uStride, y );
+        _mm_storeu_ps( p + 2*uStride, z );
+        _mm_storeu_ps( p + 3*uStride, w );
+    }
+
+    static void AnimateLightsSSE( const CPULightAnimationBlock& Block, unsigned uLane, float fTime, unsigned uLight,
+        CPUFloat4* pCenterAndRadius, unsigned* pColor, CPUSpotParams* pSpotParams, CPUMatrix* pSpotMatrices )
+    {
+        const __m128 Time = _mm_set1_ps( fTime );
+        const __m128 One = _mm_set1_ps( 1.0f );
+        const __m128 Quarter = _mm_set1_ps( 0.25f );
+        const __m128 Phase = _mm_loadu_ps( &Block.Phase[uLane] );
+
+        const __m128 Orbit = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( &Block.OrbitRate[uLane] ), Time ), Phase );
+        const __m128 Bob = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( &Block.BobRate[uLane] ), Time ), Phase );
+        const __m128 Flicker = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( &Block.FlickerRate[uLane] ), Time ), Phase );
+        const __m128 Radius = _mm_mul_ps( _mm_loadu_ps( &Block.Radius[uLane] ), _mm_add_ps( One, _mm_mul_ps( _mm_loadu_ps( &Block.Flicker[uLane] ), Sin2PiSSE( Flicker ) ) ) );
+
+        const __m128 OrbitRadius = _mm_loadu_ps( &Block.OrbitRadius[uLane] );
+        const __m128 x = _mm_add_ps( _mm_loadu_ps( &Block.PivotX[uLane] ), _mm_mul_ps( OrbitRadius, Sin2PiSSE( _mm_add_ps( Orbit, Quarter ) ) ) );
+        const __m128 y = _mm_add_ps( _mm_loadu_ps( &Block.PivotY[uLane] ), _mm_mul_ps( _mm_loadu_ps( &Block.BobHeight[uLane] ), Sin2PiSSE( Bob ) ) );
+        const __m128 z = _mm_add_ps( _mm_loadu_ps( &Block.PivotZ[uLane] ), _mm_mul_ps( OrbitRadius, Sin2PiSSE( Orbit ) ) );
+        StoreFloat4SSE( &pCenterAndRadius[uLight].x, 4, x, y, z, Radius );
+
+        const __m128 HalfOne = _mm_set1_ps( 0.5f );
+        const __m128 Color = _mm_add_ps( HalfOne, _mm_mul_ps( HalfOne, Sin2PiSSE( _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( &Block.ColorRate[uLane] ), Time ), Phase ) ) ) );
+        const __m128 AR = _mm_loadu_ps( &Block.ColorAR[uLane] );
+        const __m128 AG = _mm_loadu_ps( &Block.ColorAG[uLane] );
+        const __m128 AB = _mm_loadu_ps( &Block.ColorAB[uLane] );
+        const __m128i uColor = PackColorSSE(
+            _mm_add_ps( AR, _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( &Block.ColorBR[uLane] ), AR ), Color ) ),
+            _mm_add_ps( AG, _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( &Block.ColorBG[uLane] ), AG ), Color ) ),
+            _mm_add_ps( AB, _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( &Block.ColorBB[uLane] ), AB ), Color ) ) );
+        _mm_storeu_si128( (__m128i*)&pColor[uLight], uColor );
+
+        if( pSpotParams == NULL && pSpotMatrices == NULL )
+        {
+            return;
+        }
+
+        const __m128 Dir = _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( &Block.DirRate[uLane] ), Time ), Phase );
+        const __m128 DirXZ = _mm_loadu_ps( &Block.DirXZ[uLane] );
+        const __m128 dx = _mm_mul_ps( DirXZ, Sin2PiSSE( _mm_add_ps( Dir, Quarter ) ) );
+        const __m128 dy = _mm_loadu_ps( &Block.DirY[uLane] );
+        const __m128 dz = _mm_mul_ps( DirXZ, Sin2PiSSE( Dir ) );
+
+        if( pSpotParams != NULL )
+        {
+            // (dir x, dir y) and (cone cosine with the sign of dir z, falloff radius) per light
+            const __m128i uZSign = _mm_and_si128( _mm_castps_si128( _mm_cmplt_ps( dz, _mm_setzero_ps() ) ), _mm_set1_epi32( 0x8000 ) );
+            const __m128i uCosine = _mm_or_si128( ConvertF32ToF16SSE( _mm_set1_ps( SPOT_COSINE_OF_CONE_ANGLE ) ), uZSign );
+            const __m128i uXY = _mm_or_si128( ConvertF32ToF16SSE( dx ), _mm_slli_epi32( ConvertF32ToF16SSE( dy ), 16 ) );
+            const __m128i uCF = _mm_or_si128( uCosine, _mm_slli_epi32( ConvertF32ToF16SSE( _mm_mul_ps( Radius, _mm_set1_ps( SPOT_FALLOFF_SCALE ) ) ), 16 ) );
+            __m128i* pParams = (__m128i*)&pSpotParams[uLight];
+            _mm_storeu_si128( pParams, _mm_unpacklo_epi32( uXY, uCF ) );
+            _mm_storeu_si128( pParams + 1, _mm_unpackhi_epi32( uXY, uCF ) );
+        }
+
+        if( pSpotMatrices != NULL )
+        {
+            const __m128 Zero = _mm_setzero_ps();
+            const __m128 vx = _mm_sub_ps( Zero, dz );
+            const __m128 vz = dx;
+            const __m128 e = _mm_sub_ps( Zero, dy );
+            const __m128 h = _mm_div_ps( One, _mm_add_ps( One, e ) );
+            const __m128 hxz = _mm_mul_ps( _mm_mul_ps( h, vx ), vz );
+
+            float* pMatrix = &pSpotMatrices[uLight].m[0][0];
+            StoreFloat4SSE( pMatrix, 16, _mm_add_ps( e, _mm_mul_ps( _mm_mul_ps( h, vx ), vx ) ), vz, hxz, Zero );
+            StoreFloat4SSE( pMatrix + 4, 16, _mm_sub_ps( Zero, vz ), e, vx, Zero );
+            StoreFloat4SSE( pMatrix + 8, 16, hxz, _mm_sub_ps( Zero, vx ), _mm_add_ps( e, _mm_mul_ps( _mm_mul_ps( h, vz ), vz ) ), Zero );
+            StoreFloat4SSE( pMatrix + 12, 16, Zero, Zero, Zero, One );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // AVX2 path, eight lights at a time
+    //--------------------------------------------------------------------------------------
+    CPU_SIMD_TARGET_AVX2 static inline __m256 FractAVX2( __m256 p )
+    {
+        __m256 t = _mm256_cvtepi32_ps( _mm256_cvttps_epi32( p ) );
+        t = _mm256_sub_ps( t, _mm256_and_ps( _mm256_cmp_ps( p, t, _CMP_LT_OQ ), _mm256_set1_ps( 1.0f ) ) );
+        return _mm256_sub_ps( p, t );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static inline __m256 Sin2PiAVX2( __m256 p )
+    {
+        __m256 q = _mm256_sub_ps( FractAVX2( p ), _mm256_set1_ps( 0.5f ) );
+        q = _mm256_min_ps( q, _mm256_sub_ps( _mm256_set1_ps( 0.5f ), q ) );
+        q = _mm256_max_ps( q, _mm256_sub_ps( _mm256_set1_ps( -0.5f ), q ) );
+        const __m256 x = _mm256_mul_ps( q, _mm256_set1_ps( -TWO_PI ) );
+        const __m256 x2 = _mm256_mul_ps( x, x );
+
+        __m256 s = _mm256_set1_ps( SIN_C11 );
+        s = _mm256_add_ps( _mm256_mul_ps( s, x2 ), _mm256_set1_ps( SIN_C9 ) );
+        s = _mm256_add_ps( _mm256_mul_ps( s, x2 ), _mm256_set1_ps( SIN_C7 ) );
+        s = _mm256_add_ps( _mm256_mul_ps( s, x2 ), _mm256_set1_ps( SIN_C5 ) );
+        s = _mm256_add_ps( _mm256_mul_ps( s, x2 ), _mm256_set1_ps( SIN_C3 ) );
+        s = _mm256_add_ps( _mm256_mul_ps( s, x2 ), _mm256_set1_ps( 1.0f ) );
+        return _mm256_mul_ps( s, x );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static inline __m256i ConvertF32ToF16AVX2( __m256 f )
+    {
+        const __m256i uBits = _mm256_castps_si256( f );
+        const __m256i uSign = _mm256_and_si256( _mm256_srli_epi32( uBits, 16 ), _mm256_set1_epi32( 0x8000 ) );
+        const __m256i nExponent = _mm256_sub_epi32( _mm256_and_si256( _mm256_srli_epi32( uBits, 23 ), _mm256_set1_epi32( 0xFF ) ), _mm256_set1_epi32( 127 - 15 ) );
+        const __m256i uMantissa = _mm256_and_si256( _mm256_srli_epi32( uBits, 13 ), _mm256_set1_epi32( 0x3FF ) );
+        const __m256i uHalf = _mm256_and_si256( _mm256_or_si256( _mm256_or_si256( uSign, _mm256_slli_epi32( nExponent, 10 ) ), uMantissa ), _mm256_set1_epi32( 0xFFFF ) );
+
+        const __m256i Normal = _mm256_cmpgt_epi32( nExponent, _mm256_setzero_si256() );
+        return _mm256_blendv_epi8( uSign, uHalf, Normal );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static inline __m256i PackColorAVX2( __m256 r, __m256 g, __m256 b )
+    {
+        const __m256 Scale = _mm256_set1_ps( 255.0f );
+        const __m256 Half = _mm256_set1_ps( 0.5f );
+        const __m256i uR = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( r, Scale ), Half ) );
+        const __m256i uG = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( g, Scale ), Half ) );
+        const __m256i uB = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( b, Scale ), Half ) );
+        return _mm256_or_si256( _mm256_or_si256( uR, _mm256_slli_epi32( uG, 8 ) ), _mm256_or_si256( _mm256_slli_epi32( uB, 16 ), _mm256_set1_epi32( (int)0xFF000000u ) ) );
+    }
+
+    // the eight lights' (x,y,z,w) at p, p + uStride, ... p + 7*uStride
+    CPU_SIMD_TARGET_AVX2 static inline void StoreFloat4AVX2( float* p, unsigned uStride, __m256 x, __m256 y, __m256 z, __m256 w )
+    {
+        // (light n in the low half, light n + 4 in the high half)
+        const __m256 xy0 = _mm256_unpacklo_ps( x, y );
+        const __m256 xy1 = _mm256_unpackhi_ps( x, y );
+        const __m256 zw0 = _mm256_unpacklo_ps( z, w );
+        const __m256 zw1 = _mm256_unpackhi_ps( z, w );
+        const __m256 Light0 = _mm256_shuffle_ps( xy0, zw0, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+        const __m256 Light1 = _mm256_shuffle_ps( xy0, zw0, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+        const __m256 Light2 = _mm256_shuffle_ps( xy1, zw1, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+        const __m256 Light3 = _mm256_shuffle_ps( xy1, zw1, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+
+        _mm_storeu_ps( p, _mm256_castps256_ps128( Light0 ) );
+        _mm_storeu_ps( p + uStride, _mm256_castps256_ps128( Light1 ) );
+        _mm_storeu_ps( p + 2*uStride, _mm256_castps256_ps128( Light2 ) );
+        _mm_storeu_ps( p + 3*uStride, _mm256_castps256_ps128( Light3 ) );
+        _mm_storeu_ps( p + 4*uStride, _mm256_extractf128_ps( Light0, 1 ) );
+        _mm_storeu_ps( p + 5*uStride, _mm256_extractf128_ps( Light1, 1 ) );
+        _mm_storeu_ps( p + 6*uStride, _mm256_extractf128_ps( Light2, 1 ) );
+        _mm_storeu_ps( p + 7*uStride, _mm256_extractf128_ps( Light3, 1 ) );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static void AnimateLightsAVX2( const CPULightAnimationBlock& Block, float fTime, unsigned uLight,
+        CPUFloat4* pCenterAndRadius, unsigned* pColor, CPUSpotParams* pSpotParams, CPUMatrix* pSpotMatrices )
+    {
+        const __m256 Time = _mm256_set1_ps( fTime );
+        const __m256 One = _mm256_set1_ps( 1.0f );
+        const __m256 Quarter = _mm256_set1_ps( 0.25f );
+        const __m256 Phase = _mm256_loadu_ps( Block.Phase );
+
+        const __m256 Orbit = _mm256_add_ps( _mm256_mul_ps( _mm256_loadu_ps( Block.OrbitRate ), Time ), Phase );
+        const __m256 Bob = _mm256_add_ps( _mm256_mul_ps( _mm256_loadu_ps( Block.BobRate ), Time ), Phase );
+        const __m256 Flicker = _mm256_add_ps( _mm256_mul_ps( _mm256_loadu_ps( Block.FlickerRate ), Time ), Phase );
+        const __m256 Radius = _mm256_mul_ps( _mm256_loadu_ps( Block.Radius ), _mm256_add_ps( One, _mm256_mul_ps( _mm256_loadu_ps( Block.Flicker ), Sin2PiAVX2( Flicker ) ) ) );
+
+        const __m256 OrbitRadius = _mm256_loadu_ps( Block.OrbitRadius );
+        const __m256 x = _mm256_add_ps( _mm256_loadu_ps( Block.PivotX ), _mm256_mul_ps( OrbitRadius, Sin2PiAVX2( _mm256_add_ps( Orbit, Quarter ) ) ) );
+        const __m256 y = _mm256_add_ps( _mm256_loadu_ps( Block.PivotY ), _mm256_mul_ps( _mm256_loadu_ps( Block.BobHeight ), Sin2PiAVX2( Bob ) ) );
+        const __m256 z = _mm256_add_ps( _mm256_loadu_ps( Block.PivotZ ), _mm256_mul_ps( OrbitRadius, Sin2PiAVX2( Orbit ) ) );
+        StoreFloat4AVX2( &pCenterAndRadius[uLight].x, 4, x, y, z, Radius );
+
+        const __m256 HalfOne = _mm256_set1_ps( 0.5f );
+        const __m256 Color = _mm256_add_ps( HalfOne, _mm256_mul_ps( HalfOne, Sin2PiAVX2( _mm256_add_ps( _mm256_mul_ps( _mm256_loadu_ps( Block.ColorRate ), Time ), Phase ) ) ) );
+        const __m256 AR = _mm256_loadu_ps( Block.ColorAR );
+        const __m256 AG = _mm256_loadu_ps( Block.ColorAG );
+        const __m256 AB = _mm256_loadu_ps( Block.ColorAB );
+        const __m256i uColor = PackColorAVX2(
+            _mm256_add_ps( AR, _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( Block.ColorBR ), AR ), Color ) ),
+            _mm256_add_ps( AG, _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( Block.ColorBG ), AG ), Color ) ),
+            _mm256_add_ps( AB, _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( Block.ColorBB ), AB ), Color ) ) );
+        _mm256_storeu_si256( (__m256i*)&pColor[uLight], uColor );
+
+        if( pSpotParams == NULL && pSpotMatrices == NULL )
+        {
+            return;
+        }
+
+        const __m256 Dir = _mm256_add_ps( _mm256_mul_ps( _mm256_loadu_ps( Block.DirRate ), Time ), Phase );
+        const __m256 DirXZ = _mm256_loadu_ps( Block.DirXZ );
+        const __m256 dx = _mm256_mul_ps( DirXZ, Sin2PiAVX2( _mm256_add_ps( Dir, Quarter ) ) );
+        const __m256 dy = _mm256_loadu_ps( Block.DirY );
+        const __m256 dz = _mm256_mul_ps( DirXZ, Sin2PiAVX2( Dir ) );
+
+        if( pSpotParams != NULL )
+        {
+            const __m256i uZSign = _mm256_and_si256( _mm256_castps_si256( _mm256_cmp_ps( dz, _mm256_setzero_ps(), _CMP_LT_OQ ) ), _mm256_set1_epi32( 0x8000 ) );
+            const __m256i uCosine = _mm256_or_si256( ConvertF32ToF16AVX2( _mm256_set1_ps( SPOT_COSINE_OF_CONE_ANGLE ) ), uZSign );
+            const __m256i uXY = _mm256_or_si256( ConvertF32ToF16AVX2( dx ), _mm256_slli_epi32( ConvertF32ToF16AVX2( dy ), 16 ) );
+            const __m256i uCF = _mm256_or_si256( uCosine, _mm256_slli_epi32( ConvertF32ToF16AVX2( _mm256_mul_ps( Radius, _mm256_set1_ps( SPOT_FALLOFF_SCALE ) ) ), 16 ) );
+
+            // lights 0,1 | 4,5 and 2,3 | 6,7, put back in order
+            const __m256i Lo = _mm256_unpacklo_epi32( uXY, uCF );
+            const __m256i Hi = _mm256_unpackhi_epi32( uXY, uCF );
+            __m256i* pParams = (__m256i*)&pSpotParams[uLight];
+            _mm256_storeu_si256( pParams, _mm256_permute2x128_si256( Lo, Hi, 0x20 ) );
+            _mm256_storeu_si256( pParams + 1, _mm256_permute2x128_si256( Lo, Hi, 0x31 ) );
+        }
+
+        if( pSpotMatrices != NULL )
+        {
+            const __m256 Zero = _mm256_setzero_ps();
+            const __m256 vx = _mm256_sub_ps( Zero, dz );
+            const __m256 vz = dx;
+            const __m256 e = _mm256_sub_ps( Zero, dy );
+            const __m256 h = _mm256_div_ps( One, _mm256_add_ps( One, e ) );
+            const __m256 hxz = _mm256_mul_ps( _mm256_mul_ps( h, vx ), vz );
+
+            float* pMatrix = &pSpotMatrices[uLight].m[0][0];
+            StoreFloat4AVX2( pMatrix, 16, _mm256_add_ps( e, _mm256_mul_ps( _mm256_mul_ps( h, vx ), vx ) ), vz, hxz, Zero );
+            StoreFloat4AVX2( pMatrix + 4, 16, _mm256_sub_ps( Zero, vz ), e, vx, Zero );
+            StoreFloat4AVX2( pMatrix + 8, 16, hxz, _mm256_sub_ps( Zero, vx ), _mm256_add_ps( e, _mm256_mul_ps( _mm256_mul_ps( h, vz ), vz ) ), Zero );
+            StoreFloat4AVX2( pMatrix + 12, 16, Zero, Zero, Zero, One );
+        }
+    }
+#endif
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPULightAnimator::CPULightAnimator()
+        :m_SIMDLevel(CPU_SIMD_AUTO)
+        ,m_uNumLights(0)
+    {
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPULightAnimator::~CPULightAnimator()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Scatter the descriptions into blocks of eight
+    //--------------------------------------------------------------------------------------
+    void CPULightAnimator::SetLights( const CPULightAnimationDesc* pDescs, unsigned uNumLights )
+    {
+        m_uNumLights = uNumLights;
+
+        CPULightAnimationBlock EmptyBlock;
+        memset( &EmptyBlock, 0, sizeof(EmptyBlock) );
+        m_Blocks.assign( ( uNumLights + BLOCK_SIZE - 1 ) / BLOCK_SIZE, EmptyBlock );
+
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            const CPULightAnimationDesc& Desc = pDescs[i];
+            CPULightAnimationBlock& Block = m_Blocks[i / BLOCK_SIZE];
+            const unsigned uLane = i % BLOCK_SIZE;
+
+            Block.PivotX[uLane] = Desc.Pivot[0];
+            Block.PivotY[uLane] = Desc.Pivot[1];
+            Block.PivotZ[uLane] = Desc.Pivot[2];
+            Block.OrbitRadius[uLane] = Desc.fOrbitRadius;
+            Block.OrbitRate[uLane] = Desc.fOrbitRate;
+            Block.BobHeight[uLane] = Desc.fBobHeight;
+            Block.BobRate[uLane] = Desc.fBobRate;
+            Block.Radius[uLane] = Desc.fRadius;
+            Block.Flicker[uLane] = Desc.fFlicker;
+            Block.FlickerRate[uLane] = Desc.fFlickerRate;
+            Block.ColorAR[uLane] = Desc.ColorA[0];
+            Block.ColorAG[uLane] = Desc.ColorA[1];
+            Block.ColorAB[uLane] = Desc.ColorA[2];
+            Block.ColorBR[uLane] = Desc.ColorB[0];
+            Block.ColorBG[uLane] = Desc.ColorB[1];
+            Block.ColorBB[uLane] = Desc.ColorB[2];
+            Block.ColorRate[uLane] = Desc.fColorRate;
+            Block.DirY[uLane] = Desc.fDirY;
+            Block.DirXZ[uLane] = sqrtf( std::max( 1.0f - Desc.fDirY*Desc.fDirY, 0.0f ) );
+            Block.DirRate[uLane] = Desc.fDirRate;
+            Block.Phase[uLane] = Desc.fPhase;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Evaluate the blocks in parallel. A partial last block goes through the scalar path,
+    // since the SIMD paths write every lane.
+    //--------------------------------------------------------------------------------------
+    void CPULightAnimator::Animate( float fTime, CPUFloat4* pCenterAndRadius, unsigned* pColor, CPUSpotParams* pSpotParams, CPUMatrix* pSpotMatrices, CPUTaskScheduler* pScheduler ) const
+    {
+        const unsigned uNumBlocks = (unsigned)m_Blocks.size();
+        const CPUSIMDLevel Level = ResolveCPUSIMDLevel( m_SIMDLevel );
+
+        CPUTaskScheduler::RangeFunction AnimateBlocks = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned uBlock = uBegin; uBlock < uEnd; uBlock++ )
+            {
+                const CPULightAnimationBlock& Block = m_Blocks[uBlock];
+                const unsigned uFirstLight = uBlock*BLOCK_SIZE;
+                const unsigned uNumLanes = std::min( m_uNumLights - uFirstLight, BLOCK_SIZE );
+
+#if CPU_SIMD_X86
+                if( uNumLanes == BLOCK_SIZE && Level == CPU_SIMD_AVX2 )
+                {
+                    AnimateLightsAVX2( Block, fTime, uFirstLight, pCenterAndRadius, pColor, pSpotParams, pSpotMatrices );
+                    continue;
+                }
+                if( uNumLanes == BLOCK_SIZE && Level == CPU_SIMD_SSE )
+                {
+                    AnimateLightsSSE( Block, 0, fTime, uFirstLight, pCenterAndRadius, pColor, pSpotParams, pSpotMatrices );
+                    AnimateLightsSSE( Block, 4, fTime, uFirstLight + 4, pCenterAndRadius, pColor, pSpotParams, pSpotMatrices );
+                    continue;
+                }
+#endif
+                for( unsigned uLane = 0; uLane < uNumLanes; uLane++ )
+                {
+                    AnimateLightScalar( Block, uLane, fTime, uFirstLight + uLane, pCenterAndRadius, pColor, pSpotParams, pSpotMatrices );
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumBlocks, 64, AnimateBlocks );
+        }
+        else
+        {
+            AnimateBlocks( 0, uNumBlocks, 0 );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Random motion, from a small deterministic generator
+    //--------------------------------------------------------------------------------------
+    void CPULightAnimator::CreateRandomLights( unsigned uSeed, const float BBoxMin[3], const float BBoxMax[3], float fRadius, unsigned uNumLights, std::vector<CPULightAnimationDesc>& Descs )
+    {
+        unsigned uState = uSeed*747796405u + 2891336453u;
+        struct Random
+        {
+            // in the half-closed interval [fRangeMin, fRangeMax)
+            static float GetFloat( unsigned& uState, float fRangeMin, float fRangeMax )
+            {
+                uState ^= uState << 13;
+                uState ^= uState >> 17;
+                uState ^= uState << 5;
+                return (float)( uState >> 8 ) / 16777216.0f * ( fRangeMax - fRangeMin ) + fRangeMin;
+            }
+        };
+
+        Descs.resize( uNumLights );
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            CPULightAnimationDesc& Desc = Descs[i];
+            for( int j = 0; j < 3; j++ )
+            {
+                Desc.Pivot[j] = Random::GetFloat( uState, BBoxMin[j], BBoxMax[j] );
+            }
+            Desc.fOrbitRadius = Random::GetFloat( uState, 0.0f, 2.0f*fRadius );
+            Desc.fOrbitRate = Random::GetFloat( uState, -0.5f, 0.5f );
+            Desc.fBobHeight = Random::GetFloat( uState, 0.0f, 0.5f*fRadius );
+            Desc.fBobRate = Random::GetFloat( uState, 0.1f, 1.0f );
+
+            Desc.fRadius = fRadius;
+            Desc.fFlicker = Random::GetFloat( uState, 0.0f, 0.2f );
+            Desc.fFlickerRate = Random::GetFloat( uState, 1.0f, 8.0f );
+
+            // a bright color (as LightUtil's GetRandColor makes) and a dimmer one
+            for( int j = 0; j < 3; j++ )
+            {
+                Desc.ColorA[j] = Random::GetFloat( uState, 0.0f, 1.0f );
+            }
+            Desc.ColorA[i % 2] = Random::GetFloat( uState, 0.9f, 1.0f );
+            for( int j = 0; j < 3; j++ )
+            {
+                Desc.ColorB[j] = Desc.ColorA[j]*Random::GetFloat( uState, 0.2f, 0.8f );
+            }
+            Desc.fColorRate = Random::GetFloat( uState, 0.05f, 0.5f );
+
+            // half the spot lights point up, half down, like GetRandLightDirection's
+            Desc.fDirY = Random::GetFloat( uState, 0.1f, 0.9f )*( ( i % 2 ) ? 1.0f : -1.0f );
+            Desc.fDirRate = Random::GetFloat( uState, -0.25f, 0.25f );
+
+            Desc.fPhase = Random::GetFloat( uState, 0.0f, 1.0f );
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
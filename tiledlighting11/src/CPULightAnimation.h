@@ -0,0 +1,130 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPULightAnimation.h
+//
+// Parametric light animation on the CPU. Every light orbits a pivot, bobs up and down,
+// flickers (its radius pulses) and cycles between two colors; spot lights also turn
+// about the vertical axis. The motion parameters are stored in blocks of eight lights,
+// one array of eight per parameter (AoSoA), so that a block is evaluated with one AVX2
+// register or two SSE registers per parameter. The results are written in the layouts
+// of the light buffers: CPUFloat4 center and radius, R8G8B8A8_UNORM color, and the
+// half-precision CPUSpotParams and debug drawing matrix of a spot light.
+// This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    // Motion of one light. Rates are in cycles per second, and fPhase (in cycles) offsets
+    // every cycle of the light, so that lights with the same rates do not move in lockstep.
+    struct CPULightAnimationDesc
+    {
+        // orbit around the pivot, in the horizontal plane, and bob up and down
+        float   Pivot[3];
+        float   fOrbitRadius;
+        float   fOrbitRate;
+        float   fBobHeight;
+        float   fBobRate;
+
+        // the radius pulses between fRadius*(1 - fFlicker) and fRadius*(1 + fFlicker)
+        float   fRadius;
+        float   fFlicker;
+        float   fFlickerRate;
+
+        // the color moves back and forth between ColorA and ColorB (RGB, in [0,1])
+        float   ColorA[3];
+        float   ColorB[3];
+        float   fColorRate;
+
+        // spot lights: the light direction has a fixed y in (-1,1) and turns about the y axis
+        float   fDirY;
+        float   fDirRate;
+
+        float   fPhase;
+    };
+
+    // The parameters of eight lights, one array per CPULightAnimationDesc member, with
+    // the horizontal length of the spot light direction precomputed. Unused lanes are zero.
+    struct CPULightAnimationBlock
+    {
+        float   PivotX[8];
+        float   PivotY[8];
+        float   PivotZ[8];
+        float   OrbitRadius[8];
+        float   OrbitRate[8];
+        float   BobHeight[8];
+        float   BobRate[8];
+        float   Radius[8];
+        float   Flicker[8];
+        float   FlickerRate[8];
+        float   ColorAR[8];
+        float   ColorAG[8];
+        float   ColorAB[8];
+        float   ColorBR[8];
+        float   ColorBG[8];
+        float   ColorBB[8];
+        float   ColorRate[8];
+        float   DirY[8];
+        float   DirXZ[8];
+        float   DirRate[8];
+        float   Phase[8];
+    };
+
+    class CPULightAnimator
+    {
+    public:
+        // Constructor / destructor
+        CPULightAnimator();
+        ~CPULightAnimator();
+
+        void SetSIMDLevel( CPUSIMDLevel Level ) { m_SIMDLevel = Level; }
+
+        void SetLights( const CPULightAnimationDesc* pDescs, unsigned uNumLights );
+        unsigned GetNumLights() const { return m_uNumLights; }
+
+        // Evaluate every light at fTime seconds. The outputs hold GetNumLights() elements.
+        // pSpotParams and pSpotMatrices (the transposed cone rotation that LightUtil draws
+        // spot lights with) are only written if not NULL. Every SIMD level gives the same bits.
+        void Animate( float fTime, CPUFloat4* pCenterAndRadius, unsigned* pColor, CPUSpotParams* pSpotParams, CPUMatrix* pSpotMatrices, CPUTaskScheduler* pScheduler ) const;
+
+        // Random motion for uNumLights lights inside a box, like the static lights of LightUtil::InitLights
+        static void CreateRandomLights( unsigned uSeed, const float BBoxMin[3], const float BBoxMax[3], float fRadius, unsigned uNumLights, std::vector<CPULightAnimationDesc>& Descs );
+
+    private:
+        CPUSIMDLevel                        m_SIMDLevel;
+        unsigned                            m_uNumLights;
+        std::vector<CPULightAnimationBlock> m_Blocks;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
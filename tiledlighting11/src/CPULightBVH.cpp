@@ -0,0 +1,429 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPULightBVH.cpp
+//
+// Per-frame light hierarchy for tile culling.
+//--------------------------------------------------------------------------------------
+
+#include "CPULightBVH.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // deep enough for 30 Morton bit splits plus median splits of 2^32 lights
+    static const int MAX_TRAVERSAL_DEPTH = 64;
+
+    // spread the low 10 bits of u out to every third bit
+    static unsigned ExpandBits( unsigned u )
+    {
+        u = ( u * 0x00010001u ) & 0xFF0000FFu;
+        u = ( u * 0x00000101u ) & 0x0F00F00Fu;
+        u = ( u * 0x00000011u ) & 0xC30C30C3u;
+        u = ( u * 0x00000005u ) & 0x49249249u;
+        return u;
+    }
+
+    // f in [0,1] to a 10-bit grid coordinate
+    static unsigned Quantize( float f )
+    {
+        return (unsigned)std::min( std::max( f*1024.0f, 0.0f ), 1023.0f );
+    }
+
+    static unsigned GetHighestBit( unsigned u )
+    {
+        unsigned uBit = 0;
+        while( u >>= 1 )
+        {
+            uBit++;
+        }
+        return uBit;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPULightBVH::CPULightBVH()
+    {
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPULightBVH::~CPULightBVH()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Build the hierarchy: Morton codes and the sorted copy of the lights are computed in
+    // parallel, the radix sort and the topology are serial (both are cheap next to the
+    // culling), and the leaf bounds are computed in parallel before the interior refit
+    //--------------------------------------------------------------------------------------
+    void CPULightBVH::Build( const CPUViewSpaceLights& Lights, CPUTaskScheduler* pScheduler )
+    {
+        const unsigned uNumLights = Lights.uCount;
+
+        m_Nodes.clear();
+        m_SortedLights.uCount = uNumLights;
+        if( uNumLights == 0 )
+        {
+            return;
+        }
+
+        // bounds of the light centers, for the Morton grid
+        float CenterMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float CenterMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            CenterMin[0] = std::min( CenterMin[0], Lights.X[i] );
+            CenterMin[1] = std::min( CenterMin[1], Lights.Y[i] );
+            CenterMin[2] = std::min( CenterMin[2], Lights.Z[i] );
+            CenterMax[0] = std::max( CenterMax[0], Lights.X[i] );
+            CenterMax[1] = std::max( CenterMax[1], Lights.Y[i] );
+            CenterMax[2] = std::max( CenterMax[2], Lights.Z[i] );
+        }
+
+        float Scale[3];
+        for( int i = 0; i < 3; i++ )
+        {
+            const float fExtent = CenterMax[i] - CenterMin[i];
+            Scale[i] = ( fExtent > 0.0f ) ? 1.0f / fExtent : 0.0f;
+        }
+
+        m_Keys.resize( uNumLights );
+        m_SortScratch.resize( uNumLights );
+
+        CPUTaskScheduler::RangeFunction ComputeKeys = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned i = uBegin; i < uEnd; i++ )
+            {
+                const unsigned uX = ExpandBits( Quantize( ( Lights.X[i] - CenterMin[0] )*Scale[0] ) );
+                const unsigned uY = ExpandBits( Quantize( ( Lights.Y[i] - CenterMin[1] )*Scale[1] ) );
+                const unsigned uZ = ExpandBits( Quantize( ( Lights.Z[i] - CenterMin[2] )*Scale[2] ) );
+                const unsigned uCode = ( uX << 2 ) | ( uY << 1 ) | uZ;
+                m_Keys[i] = ( (unsigned long long)uCode << 32 ) | i;
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumLights, 1024, ComputeKeys );
+        }
+        else
+        {
+            ComputeKeys( 0, uNumLights, 0 );
+        }
+
+        // LSD radix sort on the 30-bit code, 8 bits per pass. It is stable, so lights
+        // with the same code stay in index order and the build is deterministic.
+        for( unsigned uShift = 32; uShift < 64; uShift += 8 )
+        {
+            unsigned Offsets[256];
+            memset( Offsets, 0, sizeof(Offsets) );
+            for( unsigned i = 0; i < uNumLights; i++ )
+            {
+                Offsets[( m_Keys[i] >> uShift ) & 0xFF]++;
+            }
+
+            unsigned uSum = 0;
+            for( unsigned uDigit = 0; uDigit < 256; uDigit++ )
+            {
+                const unsigned uCount = Offsets[uDigit];
+                Offsets[uDigit] = uSum;
+                uSum += uCount;
+            }
+
+            for( unsigned i = 0; i < uNumLights; i++ )
+            {
+                m_SortScratch[Offsets[( m_Keys[i] >> uShift ) & 0xFF]++] = m_Keys[i];
+            }
+            m_Keys.swap( m_SortScratch );
+        }
+
+        // gather the lights in Morton order
+        const unsigned uPaddedCount = ( uNumLights + 7 ) & ~7u;
+        m_SortedLights.X.resize( uPaddedCount );
+        m_SortedLights.Y.resize( uPaddedCount );
+        m_SortedLights.Z.resize( uPaddedCount );
+        m_SortedLights.Radius.resize( uPaddedCount );
+        m_LightIndices.resize( uNumLights );
+
+        CPUTaskScheduler::RangeFunction Gather = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned i = uBegin; i < uEnd; i++ )
+            {
+                const unsigned uIndex = (unsigned)( m_Keys[i] & 0xFFFFFFFFu );
+                m_SortedLights.X[i] = Lights.X[uIndex];
+                m_SortedLights.Y[i] = Lights.Y[uIndex];
+                m_SortedLights.Z[i] = Lights.Z[uIndex];
+                m_SortedLights.Radius[i] = Lights.Radius[uIndex];
+                m_LightIndices[i] = uIndex;
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumLights, 1024, Gather );
+        }
+        else
+        {
+            Gather( 0, uNumLights, 0 );
+        }
+
+        BuildTopology();
+
+        // leaf bounds
+        const unsigned uNumNodes = (unsigned)m_Nodes.size();
+        CPUTaskScheduler::RangeFunction ComputeLeafBounds = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned uNode = uBegin; uNode < uEnd; uNode++ )
+            {
+                CPULightBVHNode& Node = m_Nodes[uNode];
+                if( Node.uCount == 0 )
+                {
+                    continue;
+                }
+
+                for( int i = 0; i < 3; i++ )
+                {
+                    Node.BoundsMin[i] = FLT_MAX;
+                    Node.BoundsMax[i] = -FLT_MAX;
+                }
+
+                for( unsigned i = Node.uFirst; i < Node.uFirst + Node.uCount; i++ )
+                {
+                    const float Center[3] = { m_SortedLights.X[i], m_SortedLights.Y[i], m_SortedLights.Z[i] };
+                    const float r = m_SortedLights.Radius[i];
+
+                    // pad the box a little, so that rounding in the exact sphere test at the
+                    // leaves can never accept a light that the box test rejected
+                    const float fMargin = ( fabsf( Center[0] ) + fabsf( Center[1] ) + fabsf( Center[2] ) + r )*1e-5f;
+                    for( int j = 0; j < 3; j++ )
+                    {
+                        Node.BoundsMin[j] = std::min( Node.BoundsMin[j], Center[j] - r - fMargin );
+                        Node.BoundsMax[j] = std::max( Node.BoundsMax[j], Center[j] + r + fMargin );
+                    }
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumNodes, 256, ComputeLeafBounds );
+        }
+        else
+        {
+            ComputeLeafBounds( 0, uNumNodes, 0 );
+        }
+
+        ComputeBounds();
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Split the sorted range top-down where the highest differing Morton bit changes
+    //--------------------------------------------------------------------------------------
+    void CPULightBVH::BuildTopology()
+    {
+        struct Range
+        {
+            unsigned uNode;
+            unsigned uBegin;
+            unsigned uEnd;
+        };
+
+        const unsigned uNumLights = m_SortedLights.uCount;
+        m_Nodes.reserve( 2*( ( uNumLights + MAX_LEAF_SIZE - 1 ) / MAX_LEAF_SIZE ) );
+        m_Nodes.resize( 1 );
+
+        std::vector<Range> Stack;
+        const Range Root = { 0, 0, uNumLights };
+        Stack.push_back( Root );
+
+        while( !Stack.empty() )
+        {
+            const Range Current = Stack.back();
+            Stack.pop_back();
+
+            const unsigned uCount = Current.uEnd - Current.uBegin;
+            if( uCount <= MAX_LEAF_SIZE )
+            {
+                m_Nodes[Current.uNode].uFirst = Current.uBegin;
+                m_Nodes[Current.uNode].uCount = uCount;
+                continue;
+            }
+
+            const unsigned uFirstCode = (unsigned)( m_Keys[Current.uBegin] >> 32 );
+            const unsigned uLastCode = (unsigned)( m_Keys[Current.uEnd - 1] >> 32 );
+
+            unsigned uSplit = Current.uBegin + uCount/2;
+            if( uFirstCode != uLastCode )
+            {
+                // the codes share every bit above the highest differing one, so the
+                // first code with that bit set starts the right child
+                const unsigned uBit = 1u << GetHighestBit( uFirstCode ^ uLastCode );
+                unsigned uLow = Current.uBegin, uHigh = Current.uEnd - 1;
+                while( uLow < uHigh )
+                {
+                    const unsigned uMid = ( uLow + uHigh ) / 2;
+                    if( (unsigned)( m_Keys[uMid] >> 32 ) & uBit )
+                    {
+                        uHigh = uMid;
+                    }
+                    else
+                    {
+                        uLow = uMid + 1;
+                    }
+                }
+                uSplit = uLow;
+            }
+
+            const unsigned uLeft = (unsigned)m_Nodes.size();
+            m_Nodes.resize( uLeft + 2 );
+            m_Nodes[Current.uNode].uFirst = uLeft;
+            m_Nodes[Current.uNode].uCount = 0;
+
+            const Range Left = { uLeft, Current.uBegin, uSplit };
+            const Range Right = { uLeft + 1, uSplit, Current.uEnd };
+            Stack.push_back( Right );
+            Stack.push_back( Left );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Refit the interior nodes. Children always come after their parent in m_Nodes.
+    //--------------------------------------------------------------------------------------
+    void CPULightBVH::ComputeBounds()
+    {
+        for( size_t uNode = m_Nodes.size(); uNode-- > 0; )
+        {
+            CPULightBVHNode& Node = m_Nodes[uNode];
+            if( Node.uCount != 0 )
+            {
+                continue;
+            }
+
+            const CPULightBVHNode& Left = m_Nodes[Node.uFirst];
+            const CPULightBVHNode& Right = m_Nodes[Node.uFirst + 1];
+            for( int i = 0; i < 3; i++ )
+            {
+                Node.BoundsMin[i] = std::min( Left.BoundsMin[i], Right.BoundsMin[i] );
+                Node.BoundsMax[i] = std::max( Left.BoundsMax[i], Right.BoundsMax[i] );
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Traverse the hierarchy for one tile
+    //--------------------------------------------------------------------------------------
+    void CPULightBVH::CullLightsAgainstTile( const CPUTileFrustum& Frustum, std::vector<unsigned>& ListA, std::vector<unsigned>& ListB ) const
+    {
+        ListA.clear();
+        ListB.clear();
+        if( m_Nodes.empty() )
+        {
+            return;
+        }
+
+        const float (*n)[3] = Frustum.Planes;
+
+        unsigned Stack[MAX_TRAVERSAL_DEPTH];
+        int nStackSize = 0;
+        Stack[nStackSize++] = 0;
+
+        while( nStackSize > 0 )
+        {
+            const CPULightBVHNode& Node = m_Nodes[Stack[--nStackSize]];
+
+            // can anything in the box reach list A or list B?
+            const bool bMayBeInA = Node.BoundsMax[2] > Frustum.fMinZ && Node.BoundsMin[2] < Frustum.fHalfZ;
+            const bool bMayBeInB = Node.BoundsMax[2] > Frustum.fHalfZ && Node.BoundsMin[2] < Frustum.fMaxZ;
+            if( !bMayBeInA && !bMayBeInB )
+            {
+                continue;
+            }
+
+            // the box is outside a side plane if even its closest corner is
+            bool bOutside = false;
+            for( int p = 0; p < 4 && !bOutside; p++ )
+            {
+                const float fDist =
+                    n[p][0]*( n[p][0] > 0.0f ? Node.BoundsMin[0] : Node.BoundsMax[0] ) +
+                    n[p][1]*( n[p][1] > 0.0f ? Node.BoundsMin[1] : Node.BoundsMax[1] ) +
+                    n[p][2]*( n[p][2] > 0.0f ? Node.BoundsMin[2] : Node.BoundsMax[2] );
+                bOutside = ( fDist >= 0.0f );
+            }
+            if( bOutside )
+            {
+                continue;
+            }
+
+            if( Node.uCount == 0 )
+            {
+                assert( nStackSize + 2 <= MAX_TRAVERSAL_DEPTH );
+                Stack[nStackSize++] = Node.uFirst + 1;
+                Stack[nStackSize++] = Node.uFirst;
+                continue;
+            }
+
+            // the exact test, the same operations as CullSpheresScalar
+            for( unsigned i = Node.uFirst; i < Node.uFirst + Node.uCount; i++ )
+            {
+                const float x = m_SortedLights.X[i];
+                const float y = m_SortedLights.Y[i];
+                const float z = m_SortedLights.Z[i];
+                const float r = m_SortedLights.Radius[i];
+
+                if( ( n[0][0]*x + n[0][1]*y + n[0][2]*z < r ) &&
+                    ( n[1][0]*x + n[1][1]*y + n[1][2]*z < r ) &&
+                    ( n[2][0]*x + n[2][1]*y + n[2][2]*z < r ) &&
+                    ( n[3][0]*x + n[3][1]*y + n[3][2]*z < r ) )
+                {
+                    if( Frustum.fMinZ - z < r && z - Frustum.fHalfZ < r )
+                    {
+                        ListA.push_back( m_LightIndices[i] );
+                    }
+                    if( Frustum.fHalfZ - z < r && z - Frustum.fMaxZ < r )
+                    {
+                        ListB.push_back( m_LightIndices[i] );
+                    }
+                }
+            }
+        }
+
+        // the flat loop emits ascending indices, and the index buffers keep the first uListSize
+        std::sort( ListA.begin(), ListA.end() );
+        std::sort( ListB.begin(), ListB.end() );
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,90 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPULightBVH.h
+//
+// Bounding volume hierarchy over a light array, rebuilt every frame, so that tile
+// culling visits only the lights near the tile instead of all of them. The build is
+// an LBVH: lights are sorted along a 30-bit Morton curve and the sorted range is split
+// where the highest Morton bit changes. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+
+    // Axis-aligned box around the spheres below the node. Children of an interior node
+    // are stored next to each other, so one index is enough for both.
+    struct CPULightBVHNode
+    {
+        float       BoundsMin[3];
+        unsigned    uFirst;     // interior node: index of the left child, leaf: first sorted light
+        float       BoundsMax[3];
+        unsigned    uCount;     // interior node: 0, leaf: number of lights
+    };
+
+    class CPULightBVH
+    {
+    public:
+        static const unsigned MAX_LEAF_SIZE = 8;
+
+        // Constructor / destructor
+        CPULightBVH();
+        ~CPULightBVH();
+
+        // Rebuild the hierarchy for this frame's view-space lights
+        void Build( const CPUViewSpaceLights& Lights, CPUTaskScheduler* pScheduler );
+
+        // Same results as CPULightCuller::CullLightsAgainstTile on the lights passed to Build,
+        // with the indices of both lists in ascending order, but without the list size limit
+        void CullLightsAgainstTile( const CPUTileFrustum& Frustum, std::vector<unsigned>& ListA, std::vector<unsigned>& ListB ) const;
+
+        unsigned GetNumNodes() const { return (unsigned)m_Nodes.size(); }
+        unsigned GetNumLights() const { return m_SortedLights.uCount; }
+
+    private:
+        void BuildTopology();
+        void ComputeBounds();
+
+        std::vector<CPULightBVHNode>    m_Nodes;
+
+        // the lights in Morton order, and the index each one had in the input array
+        CPUViewSpaceLights              m_SortedLights;
+        std::vector<unsigned>           m_LightIndices;
+
+        // Morton code in the high 32 bits, light index in the low 32 bits
+        std::vector<unsigned long long> m_Keys;
+        std::vector<unsigned long long> m_SortScratch;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
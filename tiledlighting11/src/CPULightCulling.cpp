@@ -0,0 +1,716 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPULightCulling.cpp
+//
+// CPU implementation of the tiled light culling done by DoLightCulling in
+// Shaders/TilingCommonHeader.h.
+//--------------------------------------------------------------------------------------
+
+#include "CPULightCulling.h"
+#include "CPULightBVH.h"
+#include "CPUSpotLightCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // FLT_MAX as a uint, what DoLightCulling initializes ldsZMin to
+    static const unsigned FLT_MAX_AS_UINT = 0x7f7fffff;
+
+    static unsigned AsUint( float f )
+    {
+        unsigned u;
+        memcpy( &u, &f, sizeof(u) );
+        return u;
+    }
+
+    static float AsFloat( unsigned u )
+    {
+        float f;
+        memcpy( &f, &u, sizeof(f) );
+        return f;
+    }
+
+    // mul( p, m ) followed by the divide by w, as in ConvertProjToView
+    static void ConvertProjToView( const CPUMatrix& mProjectionInv, float x, float y, float Result[3] )
+    {
+        const float (*m)[4] = mProjectionInv.m;
+        float v[4];
+        for( int j = 0; j < 4; j++ )
+        {
+            v[j] = x*m[0][j] + y*m[1][j] + 1.0f*m[2][j] + 1.0f*m[3][j];
+        }
+        Result[0] = v[0] / v[3];
+        Result[1] = v[1] / v[3];
+        Result[2] = v[2] / v[3];
+    }
+
+    // normalize( cross( b, c ) ), as in CreatePlaneEquation
+    static void CreatePlaneEquation( const float b[3], const float c[3], float n[3] )
+    {
+        n[0] = b[1]*c[2] - b[2]*c[1];
+        n[1] = b[2]*c[0] - b[0]*c[2];
+        n[2] = b[0]*c[1] - b[1]*c[0];
+        float fInvLength = 1.0f / sqrtf( n[0]*n[0] + n[1]*n[1] + n[2]*n[2] );
+        n[0] *= fInvLength;
+        n[1] *= fInvLength;
+        n[2] *= fInvLength;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Index sinks for the sphere test kernels
+    //--------------------------------------------------------------------------------------
+
+    // a fixed-size list in the index buffer; keeps counting past the end, like the LDS counters
+    struct CPUIndexListSink
+    {
+        unsigned short* pList;
+        unsigned        uListSize;
+        unsigned        uCount;
+
+        void Push( unsigned uIndex )
+        {
+            if( uCount < uListSize )
+            {
+                pList[uCount] = (unsigned short)uIndex;
+            }
+            uCount++;
+        }
+    };
+
+    struct CPUIndexVectorSink
+    {
+        std::vector<unsigned>* pIndices;
+
+        void Push( unsigned uIndex ) { pIndices->push_back( uIndex ); }
+    };
+
+    struct CPUNullSink
+    {
+        void Push( unsigned ) {}
+    };
+
+    //--------------------------------------------------------------------------------------
+    // Sphere vs. tile kernels. All three produce identical results: the per-lane math is
+    // the same sequence of IEEE single-precision operations, and the lanes are emitted in
+    // ascending light index order.
+    //--------------------------------------------------------------------------------------
+    template<class SinkA, class SinkB>
+    static void CullSpheresScalar( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, SinkA& ListA, SinkB& ListB )
+    {
+        const float (*n)[3] = Frustum.Planes;
+
+        for( unsigned i = 0; i < Lights.uCount; i++ )
+        {
+            const float x = Lights.X[i];
+            const float y = Lights.Y[i];
+            const float z = Lights.Z[i];
+            const float r = Lights.Radius[i];
+
+            // test if sphere is intersecting or inside frustum
+            if( ( n[0][0]*x + n[0][1]*y + n[0][2]*z < r ) &&
+                ( n[1][0]*x + n[1][1]*y + n[1][2]*z < r ) &&
+                ( n[2][0]*x + n[2][1]*y + n[2][2]*z < r ) &&
+                ( n[3][0]*x + n[3][1]*y + n[3][2]*z < r ) )
+            {
+                if( Frustum.fMinZ - z < r && z - Frustum.fHalfZ < r )
+                {
+                    ListA.Push( i );
+                }
+                if( Frustum.fHalfZ - z < r && z - Frustum.fMaxZ < r )
+                {
+                    ListB.Push( i );
+                }
+            }
+        }
+    }
+
+    template<class Sink>
+    static void EmitLanes( unsigned uMask, unsigned uBase, Sink& List )
+    {
+        while( uMask != 0 )
+        {
+            List.Push( uBase + CountTrailingZeros( uMask ) );
+            uMask &= uMask - 1;
+        }
+    }
+
+    static unsigned GetValidLaneMask( unsigned uBase, unsigned uCount, unsigned uWidth )
+    {
+        unsigned uRemaining = uCount - uBase;
+        return ( uRemaining >= uWidth ) ? ( ( 1u << uWidth ) - 1 ) : ( ( 1u << uRemaining ) - 1 );
+    }
+
+#if CPU_SIMD_X86
+    template<class SinkA, class SinkB>
+    static void CullSpheresSSE( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, SinkA& ListA, SinkB& ListB )
+    {
+        __m128 nx[4], ny[4], nz[4];
+        for( int p = 0; p < 4; p++ )
+        {
+            nx[p] = _mm_set1_ps( Frustum.Planes[p][0] );
+            ny[p] = _mm_set1_ps( Frustum.Planes[p][1] );
+            nz[p] = _mm_set1_ps( Frustum.Planes[p][2] );
+        }
+        const __m128 MinZ = _mm_set1_ps( Frustum.fMinZ );
+        const __m128 MaxZ = _mm_set1_ps( Frustum.fMaxZ );
+        const __m128 HalfZ = _mm_set1_ps( Frustum.fHalfZ );
+
+        for( unsigned i = 0; i < Lights.uCount; i += 4 )
+        {
+            const __m128 x = _mm_loadu_ps( &Lights.X[i] );
+            const __m128 y = _mm_loadu_ps( &Lights.Y[i] );
+            const __m128 z = _mm_loadu_ps( &Lights.Z[i] );
+            const __m128 r = _mm_loadu_ps( &Lights.Radius[i] );
+
+            __m128 Inside = _mm_cmplt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx[0], x ), _mm_mul_ps( ny[0], y ) ), _mm_mul_ps( nz[0], z ) ), r );
+            for( int p = 1; p < 4; p++ )
+            {
+                __m128 Dist = _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx[p], x ), _mm_mul_ps( ny[p], y ) ), _mm_mul_ps( nz[p], z ) );
+                Inside = _mm_and_ps( Inside, _mm_cmplt_ps( Dist, r ) );
+            }
+
+            const unsigned uInside = (unsigned)_mm_movemask_ps( Inside ) & GetValidLaneMask( i, Lights.uCount, 4 );
+            if( uInside == 0 )
+            {
+                continue;
+            }
+
+            __m128 A = _mm_and_ps( _mm_cmplt_ps( _mm_sub_ps( MinZ, z ), r ), _mm_cmplt_ps( _mm_sub_ps( z, HalfZ ), r ) );
+            __m128 B = _mm_and_ps( _mm_cmplt_ps( _mm_sub_ps( HalfZ, z ), r ), _mm_cmplt_ps( _mm_sub_ps( z, MaxZ ), r ) );
+            EmitLanes( uInside & (unsigned)_mm_movemask_ps( A ), i, ListA );
+            EmitLanes( uInside & (unsigned)_mm_movemask_ps( B ), i, ListB );
+        }
+    }
+
+    template<class SinkA, class SinkB>
+    CPU_SIMD_TARGET_AVX2 static void CullSpheresAVX2( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, SinkA& ListA, SinkB& ListB )
+    {
+        __m256 nx[4], ny[4], nz[4];
+        for( int p = 0; p < 4; p++ )
+        {
+            nx[p] = _mm256_set1_ps( Frustum.Planes[p][0] );
+            ny[p] = _mm256_set1_ps( Frustum.Planes[p][1] );
+            nz[p] = _mm256_set1_ps( Frustum.Planes[p][2] );
+        }
+        const __m256 MinZ = _mm256_set1_ps( Frustum.fMinZ );
+        const __m256 MaxZ = _mm256_set1_ps( Frustum.fMaxZ );
+        const __m256 HalfZ = _mm256_set1_ps( Frustum.fHalfZ );
+
+        for( unsigned i = 0; i < Lights.uCount; i += 8 )
+        {
+            const __m256 x = _mm256_loadu_ps( &Lights.X[i] );
+            const __m256 y = _mm256_loadu_ps( &Lights.Y[i] );
+            const __m256 z = _mm256_loadu_ps( &Lights.Z[i] );
+            const __m256 r = _mm256_loadu_ps( &Lights.Radius[i] );
+
+            // separate multiplies and adds (no FMA), to match the scalar path bit for bit
+            __m256 Inside = _mm256_cmp_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( nx[0], x ), _mm256_mul_ps( ny[0], y ) ), _mm256_mul_ps( nz[0], z ) ), r, _CMP_LT_OQ );
+            for( int p = 1; p < 4; p++ )
+            {
+                __m256 Dist = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( nx[p], x ), _mm256_mul_ps( ny[p], y ) ), _mm256_mul_ps( nz[p], z ) );
+                Inside = _mm256_and_ps( Inside, _mm256_cmp_ps( Dist, r, _CMP_LT_OQ ) );
+            }
+
+            const unsigned uInside = (unsigned)_mm256_movemask_ps( Inside ) & GetValidLaneMask( i, Lights.uCount, 8 );
+            if( uInside == 0 )
+            {
+                continue;
+            }
+
+            __m256 A = _mm256_and_ps( _mm256_cmp_ps( _mm256_sub_ps( MinZ, z ), r, _CMP_LT_OQ ), _mm256_cmp_ps( _mm256_sub_ps( z, HalfZ ), r, _CMP_LT_OQ ) );
+            __m256 B = _mm256_and_ps( _mm256_cmp_ps( _mm256_sub_ps( HalfZ, z ), r, _CMP_LT_OQ ), _mm256_cmp_ps( _mm256_sub_ps( z, MaxZ ), r, _CMP_LT_OQ ) );
+            EmitLanes( uInside & (unsigned)_mm256_movemask_ps( A ), i, ListA );
+            EmitLanes( uInside & (unsigned)_mm256_movemask_ps( B ), i, ListB );
+        }
+    }
+#endif
+
+    template<class SinkA, class SinkB>
+    static void CullSpheres( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, CPUSIMDLevel Level, SinkA& ListA, SinkB& ListB )
+    {
+#if CPU_SIMD_X86
+        switch( ResolveCPUSIMDLevel( Level ) )
+        {
+        case CPU_SIMD_AVX2:
+            CullSpheresAVX2( Lights, Frustum, ListA, ListB );
+            return;
+        case CPU_SIMD_SSE:
+            CullSpheresSSE( Lights, Frustum, ListA, ListB );
+            return;
+        default:
+            break;
+        }
+#else
+        (void)Level;
+#endif
+        CullSpheresScalar( Lights, Frustum, ListA, ListB );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor for the input description
+    //--------------------------------------------------------------------------------------
+    CPULightCullingInput::CPULightCullingInput()
+        :uWidth(0)
+        ,uHeight(0)
+        ,uTileRes(CPU_CULLING_TILE_RES)
+        ,pDepth(NULL)
+        ,uNumSamples(1)
+        ,pBlendedDepth(NULL)
+        ,pPointLightCenterAndRadius(NULL)
+        ,uNumPointLights(0)
+        ,pSpotLightCenterAndRadius(NULL)
+        ,uNumSpotLights(0)
+        ,pSpotParams(NULL)
+        ,pVPLCenterAndRadius(NULL)
+        ,uNumVPLs(0)
+        ,uMaxNumLightsPerTile(0)
+        ,uMaxNumVPLsPerTile(0)
+    {
+        memset( &mView, 0, sizeof(mView) );
+        memset( &mProjectionInv, 0, sizeof(mProjectionInv) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPULightCuller::CPULightCuller()
+        :m_SIMDLevel(CPU_SIMD_AUTO)
+        ,m_bUseLightBVH(false)
+        ,m_SpotCullingMode(CPU_SPOT_CULLING_SPHERE)
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPULightCuller::~CPULightCuller()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Convert a depth value from post-projection space into view space
+    //--------------------------------------------------------------------------------------
+    float CPULightCuller::ConvertProjDepthToView( const CPUMatrix& mProjectionInv, float fDepth )
+    {
+        return 1.0f / ( fDepth*mProjectionInv.m[2][3] + mProjectionInv.m[3][3] );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Build the four side planes of a tile, exactly as DoLightCulling does
+    //--------------------------------------------------------------------------------------
+    void CPULightCuller::BuildTileFrustum( const CPULightCullingInput& Input, unsigned uTileX, unsigned uTileY, CPUTileFrustum& Frustum, bool bMatchShader )
+    {
+        const unsigned uTileRes = Input.uTileRes;
+        const unsigned pxm = uTileRes*uTileX;
+        const unsigned pym = uTileRes*uTileY;
+        const unsigned pxp = uTileRes*(uTileX+1);
+        const unsigned pyp = uTileRes*(uTileY+1);
+
+        const unsigned uWindowWidthEvenlyDivisibleByTileRes = bMatchShader ? uTileRes*GetNumTiles( Input.uWidth, uTileRes ) : Input.uWidth;
+        const unsigned uWindowHeightEvenlyDivisibleByTileRes = bMatchShader ? uTileRes*GetNumTiles( Input.uHeight, uTileRes ) : Input.uHeight;
+        const float fWidth = (float)uWindowWidthEvenlyDivisibleByTileRes;
+        const float fHeight = (float)uWindowHeightEvenlyDivisibleByTileRes;
+
+        // (fHeight-pym) is exact in float, and unlike the uint subtraction in the shader
+        // it can't wrap when the last row of tiles reaches past the real screen height
+
+        // four corners of the tile, clockwise from top-left
+        float Corners[4][3];
+        ConvertProjToView( Input.mProjectionInv, pxm/fWidth*2.0f-1.0f, (fHeight-pym)/fHeight*2.0f-1.0f, Corners[0] );
+        ConvertProjToView( Input.mProjectionInv, pxp/fWidth*2.0f-1.0f, (fHeight-pym)/fHeight*2.0f-1.0f, Corners[1] );
+        ConvertProjToView( Input.mProjectionInv, pxp/fWidth*2.0f-1.0f, (fHeight-pyp)/fHeight*2.0f-1.0f, Corners[2] );
+        ConvertProjToView( Input.mProjectionInv, pxm/fWidth*2.0f-1.0f, (fHeight-pyp)/fHeight*2.0f-1.0f, Corners[3] );
+
+        // create plane equations for the four sides of the frustum,
+        // with the positive half-space outside the frustum
+        for( unsigned i = 0; i < 4; i++ )
+        {
+            CreatePlaneEquation( Corners[i], Corners[(i+1)&3], Frustum.Planes[i] );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Calculate the min and max view-space depth for a tile, with the same uint
+    // comparisons as the InterlockedMin/InterlockedMax in CalculateMinMaxDepthInLds(MSAA)
+    //--------------------------------------------------------------------------------------
+    void CPULightCuller::CalculateTileDepthBounds( const CPULightCullingInput& Input, unsigned uTileX, unsigned uTileY, CPUTileFrustum& Frustum )
+    {
+        unsigned uZMin = FLT_MAX_AS_UINT;
+        unsigned uZMax = 0;
+
+        const unsigned uStartX = uTileX*Input.uTileRes;
+        const unsigned uStartY = uTileY*Input.uTileRes;
+        const unsigned uEndX = std::min( uStartX + Input.uTileRes, Input.uWidth );
+        const unsigned uEndY = std::min( uStartY + Input.uTileRes, Input.uHeight );
+        const unsigned uNumSamples = Input.uNumSamples;
+
+        for( unsigned y = uStartY; y < uEndY; y++ )
+        {
+            const size_t uRowOffset = (size_t)y*Input.uWidth*uNumSamples;
+            for( unsigned x = uStartX; x < uEndX; x++ )
+            {
+                const size_t uPixelOffset = uRowOffset + (size_t)x*uNumSamples;
+                for( unsigned s = 0; s < uNumSamples; s++ )
+                {
+                    const float fOpaqueDepth = Input.pDepth[uPixelOffset + s];
+
+                    if( Input.pBlendedDepth != NULL )
+                    {
+                        // Blended path
+                        const float fBlendedDepth = Input.pBlendedDepth[uPixelOffset + s];
+                        if( fBlendedDepth != 0.0f )
+                        {
+                            uZMax = std::max( uZMax, AsUint( ConvertProjDepthToView( Input.mProjectionInv, fOpaqueDepth ) ) );
+                            uZMin = std::min( uZMin, AsUint( ConvertProjDepthToView( Input.mProjectionInv, fBlendedDepth ) ) );
+                        }
+                    }
+                    else if( fOpaqueDepth != 0.0f )
+                    {
+                        // Opaque only path
+                        const unsigned uZ = AsUint( ConvertProjDepthToView( Input.mProjectionInv, fOpaqueDepth ) );
+                        uZMax = std::max( uZMax, uZ );
+                        uZMin = std::min( uZMin, uZ );
+                    }
+                }
+            }
+        }
+
+        Frustum.fMaxZ = AsFloat( uZMax );
+        Frustum.fMinZ = AsFloat( uZMin );
+        Frustum.fHalfZ = ( Frustum.fMinZ + Frustum.fMaxZ ) / 2.0f;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // mul( float4(center.xyz, 1), g_mView ) for every light, into padded SoA arrays
+    //--------------------------------------------------------------------------------------
+    void CPULightCuller::TransformLightsToViewSpace( const CPUMatrix& mView, const CPUFloat4* pCenterAndRadius, unsigned uCount, CPUViewSpaceLights& Lights )
+    {
+        const unsigned uPaddedCount = ( uCount + 7 ) & ~7u;
+        Lights.X.assign( uPaddedCount, 0.0f );
+        Lights.Y.assign( uPaddedCount, 0.0f );
+        Lights.Z.assign( uPaddedCount, 0.0f );
+        Lights.Radius.assign( uPaddedCount, 0.0f );
+        Lights.uCount = uCount;
+
+        const float (*m)[4] = mView.m;
+        for( unsigned i = 0; i < uCount; i++ )
+        {
+            const CPUFloat4& c = pCenterAndRadius[i];
+            Lights.X[i] = c.x*m[0][0] + c.y*m[1][0] + c.z*m[2][0] + m[3][0];
+            Lights.Y[i] = c.x*m[0][1] + c.y*m[1][1] + c.z*m[2][1] + m[3][1];
+            Lights.Z[i] = c.x*m[0][2] + c.y*m[1][2] + c.z*m[2][2] + m[3][2];
+            Lights.Radius[i] = c.w;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Sphere vs. tile test with the halfZ split
+    //--------------------------------------------------------------------------------------
+    void CPULightCuller::CullLightsAgainstTile( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, CPUSIMDLevel Level,
+        unsigned short* pListA, unsigned short* pListB, unsigned uListSize, unsigned& uCountA, unsigned& uCountB )
+    {
+        CPUIndexListSink ListA = { pListA, uListSize, 0 };
+        CPUIndexListSink ListB = { pListB, uListSize, 0 };
+        CullSpheres( Lights, Frustum, Level, ListA, ListB );
+        uCountA = ListA.uCount;
+        uCountB = ListB.uCount;
+    }
+
+    void CPULightCuller::CullLightsAgainstTile( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, CPUSIMDLevel Level,
+        std::vector<unsigned>& ListA, std::vector<unsigned>& ListB )
+    {
+        ListA.clear();
+        ListB.clear();
+        CPUIndexVectorSink SinkA = { &ListA };
+        CPUIndexVectorSink SinkB = { &ListB };
+        CullSpheres( Lights, Frustum, Level, SinkA, SinkB );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Sphere vs. tile test over the whole depth range of the tile
+    //--------------------------------------------------------------------------------------
+    void CPULightCuller::CullLightsAgainstFrustum( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, CPUSIMDLevel Level, std::vector<unsigned>& Indices )
+    {
+        // with fHalfZ at the back of the tile, list A covers the whole depth range
+        CPUTileFrustum FullRange = Frustum;
+        FullRange.fHalfZ = Frustum.fMaxZ;
+
+        CPUIndexVectorSink ListA = { &Indices };
+        CPUNullSink ListB;
+        CullSpheres( Lights, FullRange, Level, ListA, ListB );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cull all tiles
+    //--------------------------------------------------------------------------------------
+    void CPULightCuller::CullLights( const CPULightCullingInput& Input, CPULightCullingOutput& Output, CPUTaskScheduler* pScheduler )
+    {
+        assert( Input.pDepth != NULL );
+        assert( Input.uNumSamples > 0 );
+
+        assert( Input.uTileRes > 0 );
+
+        const unsigned uNumTilesX = GetNumTiles( Input.uWidth, Input.uTileRes );
+        const unsigned uNumTilesY = GetNumTiles( Input.uHeight, Input.uTileRes );
+        const unsigned uNumTiles = uNumTilesX*uNumTilesY;
+        const bool bVPLsEnabled = ( Input.pVPLCenterAndRadius != NULL );
+
+        // max num lights times 2 (because the halfZ method has two lists per tile, list A and B),
+        // plus two more to store the 32-bit halfZ, plus one more for the light count of list A,
+        // plus one more for the light count of list B
+        Output.uTileRes = Input.uTileRes;
+        Output.uNumTilesX = uNumTilesX;
+        Output.uNumTilesY = uNumTilesY;
+        Output.uMaxNumElementsPerTile = 2*Input.uMaxNumLightsPerTile + 4;
+        Output.uMaxNumVPLElementsPerTile = 2*Input.uMaxNumVPLsPerTile + 4;
+        Output.PointIndexBuffer.assign( (size_t)uNumTiles*Output.uMaxNumElementsPerTile, 0 );
+        Output.SpotIndexBuffer.assign( (size_t)uNumTiles*Output.uMaxNumElementsPerTile, 0 );
+        if( bVPLsEnabled )
+        {
+            Output.VPLIndexBuffer.assign( (size_t)uNumTiles*Output.uMaxNumVPLElementsPerTile, 0 );
+        }
+        else
+        {
+            Output.VPLIndexBuffer.clear();
+        }
+        Output.TileFrusta.resize( uNumTiles );
+
+        // the shader transforms every light once per tile; do it once per frame instead
+        TransformLightsToViewSpace( Input.mView, Input.pPointLightCenterAndRadius, Input.uNumPointLights, m_PointLights );
+        TransformLightsToViewSpace( Input.mView, Input.pSpotLightCenterAndRadius, Input.uNumSpotLights, m_SpotLights );
+        TransformLightsToViewSpace( Input.mView, Input.pVPLCenterAndRadius, bVPLsEnabled ? Input.uNumVPLs : 0, m_VPLs );
+
+        // the conservative cone mode swaps in tighter spheres, the tight mode tests the cones themselves
+        const bool bSpotCones = ( m_SpotCullingMode != CPU_SPOT_CULLING_SPHERE ) && ( Input.pSpotParams != NULL );
+        if( bSpotCones )
+        {
+            TransformSpotConesToViewSpace( Input.mView, Input.pSpotLightCenterAndRadius, Input.pSpotParams, Input.uNumSpotLights, m_SpotCones );
+            if( m_SpotCullingMode == CPU_SPOT_CULLING_CONE_CONSERVATIVE )
+            {
+                GetSpotConeBoundingSpheres( m_SpotCones, m_SpotLights );
+            }
+        }
+        const CPUViewSpaceSpotCones* pSpotCones = ( bSpotCones && m_SpotCullingMode == CPU_SPOT_CULLING_CONE_TIGHT ) ? &m_SpotCones : NULL;
+
+        if( m_bUseLightBVH )
+        {
+            if( !m_pPointBVH )
+            {
+                m_pPointBVH.reset( new CPULightBVH );
+                m_pSpotBVH.reset( new CPULightBVH );
+                m_pVPLBVH.reset( new CPULightBVH );
+            }
+            m_pPointBVH->Build( m_PointLights, pScheduler );
+            m_pSpotBVH->Build( m_SpotLights, pScheduler );
+            m_pVPLBVH->Build( m_VPLs, pScheduler );
+        }
+
+        const unsigned uNumThreads = pScheduler ? pScheduler->GetNumThreads() : 1;
+        std::vector<CPULightCullingStats> ThreadStats( uNumThreads );
+        memset( &ThreadStats[0], 0, sizeof(CPULightCullingStats)*uNumThreads );
+
+        // per-thread unbounded lists for the BVH traversal
+        std::vector< std::vector<unsigned> > ThreadListsA( m_bUseLightBVH ? uNumThreads : 0 );
+        std::vector< std::vector<unsigned> > ThreadListsB( m_bUseLightBVH ? uNumThreads : 0 );
+
+        const CPUSIMDLevel Level = GetSIMDLevel();
+
+        CPUTaskScheduler::RangeFunction CullTiles = [&]( unsigned uBegin, unsigned uEnd, unsigned uThreadIndex )
+        {
+            CPULightCullingStats& Stats = ThreadStats[uThreadIndex];
+
+            for( unsigned uTile = uBegin; uTile < uEnd; uTile++ )
+            {
+                const unsigned uTileX = uTile % uNumTilesX;
+                const unsigned uTileY = uTile / uNumTilesX;
+
+                CPUTileFrustum& Frustum = Output.TileFrusta[uTile];
+                BuildTileFrustum( Input, uTileX, uTileY, Frustum );
+                CalculateTileDepthBounds( Input, uTileX, uTileY, Frustum );
+
+                // store fHalfZ for this tile as two 16-bit unsigned values
+                const unsigned uHalfZBits = AsUint( Frustum.fHalfZ );
+                const unsigned short uHalfZBitsHigh = (unsigned short)( uHalfZBits >> 16 );
+                const unsigned short uHalfZBitsLow = (unsigned short)( uHalfZBits & 0x0000FFFF );
+
+                struct ListDesc
+                {
+                    const CPUViewSpaceLights*   pLights;
+                    const CPULightBVH*          pBVH;
+                    const CPUViewSpaceSpotCones* pCones;
+                    unsigned short*             pTile;
+                    unsigned                    uListSize;
+                    unsigned long long*         pNumIndices;
+                    unsigned*                   pNumOverflowedTiles;
+                };
+
+                ListDesc Lists[3] =
+                {
+                    { &m_PointLights, m_pPointBVH.get(), NULL,       &Output.PointIndexBuffer[(size_t)uTile*Output.uMaxNumElementsPerTile], Input.uMaxNumLightsPerTile, &Stats.uNumPointIndices, &Stats.uNumOverflowedPointTiles },
+                    { &m_SpotLights,  m_pSpotBVH.get(),  pSpotCones, &Output.SpotIndexBuffer[(size_t)uTile*Output.uMaxNumElementsPerTile],  Input.uMaxNumLightsPerTile, &Stats.uNumSpotIndices,  &Stats.uNumOverflowedSpotTiles },
+                    { &m_VPLs,        m_pVPLBVH.get(),   NULL,       bVPLsEnabled ? &Output.VPLIndexBuffer[(size_t)uTile*Output.uMaxNumVPLElementsPerTile] : NULL, Input.uMaxNumVPLsPerTile, &Stats.uNumVPLIndices, &Stats.uNumOverflowedVPLTiles },
+                };
+
+                for( int nList = 0; nList < 3; nList++ )
+                {
+                    const ListDesc& Desc = Lists[nList];
+                    if( Desc.pTile == NULL )
+                    {
+                        continue;
+                    }
+
+                    unsigned uCountA = 0, uCountB = 0;
+                    if( Desc.pCones )
+                    {
+                        CullSpotConesAgainstTile( *Desc.pCones, Frustum, Desc.pTile + 4, Desc.pTile + 4 + Desc.uListSize, Desc.uListSize, uCountA, uCountB );
+                    }
+                    else if( m_bUseLightBVH )
+                    {
+                        std::vector<unsigned>& ListA = ThreadListsA[uThreadIndex];
+                        std::vector<unsigned>& ListB = ThreadListsB[uThreadIndex];
+                        Desc.pBVH->CullLightsAgainstTile( Frustum, ListA, ListB );
+
+                        uCountA = (unsigned)ListA.size();
+                        uCountB = (unsigned)ListB.size();
+                        for( unsigned i = 0; i < std::min( uCountA, Desc.uListSize ); i++ )
+                        {
+                            Desc.pTile[4 + i] = (unsigned short)ListA[i];
+                        }
+                        for( unsigned i = 0; i < std::min( uCountB, Desc.uListSize ); i++ )
+                        {
+                            Desc.pTile[4 + Desc.uListSize + i] = (unsigned short)ListB[i];
+                        }
+                    }
+                    else
+                    {
+                        CullLightsAgainstTile( *Desc.pLights, Frustum, Level, Desc.pTile + 4, Desc.pTile + 4 + Desc.uListSize, Desc.uListSize, uCountA, uCountB );
+                    }
+
+                    Desc.pTile[0] = uHalfZBitsHigh;
+                    Desc.pTile[1] = uHalfZBitsLow;
+                    Desc.pTile[2] = (unsigned short)std::min( uCountA, 0xFFFFu );
+                    Desc.pTile[3] = (unsigned short)std::min( uCountB, 0xFFFFu );
+
+                    *Desc.pNumIndices += uCountA + uCountB;
+                    if( uCountA > Desc.uListSize || uCountB > Desc.uListSize )
+                    {
+                        (*Desc.pNumOverflowedTiles)++;
+                    }
+                }
+            }
+        };
+
+        // 8 tiles per chunk keeps the chunks small enough to balance well
+        // at 720p and up, without making the queues the bottleneck
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumTiles, 8, CullTiles );
+        }
+        else
+        {
+            CullTiles( 0, uNumTiles, 0 );
+        }
+
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        m_Stats.uNumTiles = uNumTiles;
+        m_Stats.uNumPointLightsInput = Input.uNumPointLights;
+        m_Stats.uNumSpotLightsInput = Input.uNumSpotLights;
+        m_Stats.uNumVPLsInput = bVPLsEnabled ? Input.uNumVPLs : 0;
+        for( unsigned i = 0; i < uNumThreads; i++ )
+        {
+            m_Stats.uNumPointIndices += ThreadStats[i].uNumPointIndices;
+            m_Stats.uNumSpotIndices += ThreadStats[i].uNumSpotIndices;
+            m_Stats.uNumVPLIndices += ThreadStats[i].uNumVPLIndices;
+            m_Stats.uNumOverflowedPointTiles += ThreadStats[i].uNumOverflowedPointTiles;
+            m_Stats.uNumOverflowedSpotTiles += ThreadStats[i].uNumOverflowedSpotTiles;
+            m_Stats.uNumOverflowedVPLTiles += ThreadStats[i].uNumOverflowedVPLTiles;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Find the list A or list B range for a pixel
+    //--------------------------------------------------------------------------------------
+    void CPULightCuller::GetLightListInfo( const unsigned short* pBuffer, unsigned uNumTilesX, unsigned uMaxNumLightsPerTile, unsigned uX, unsigned uY, float fViewZ, unsigned& uFirstLightIndex, unsigned& uNumLights,
+        unsigned uTileRes )
+    {
+        const unsigned uTileIndex = ( uX / uTileRes ) + ( uY / uTileRes )*uNumTilesX;
+        const unsigned uStartIndex = ( 2*uMaxNumLightsPerTile + 4 )*uTileIndex;
+
+        // reconstruct fHalfZ
+        const float fHalfZ = AsFloat( ( (unsigned)pBuffer[uStartIndex] << 16 ) | pBuffer[uStartIndex+1] );
+
+        uFirstLightIndex = ( fViewZ < fHalfZ ) ? ( uStartIndex + 4 ) : ( uStartIndex + 4 + uMaxNumLightsPerTile );
+        uNumLights = ( fViewZ < fHalfZ ) ? pBuffer[uStartIndex+2] : pBuffer[uStartIndex+3];
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Compare two index buffers, treating each per-tile list as a set
+    //--------------------------------------------------------------------------------------
+    unsigned CPULightCuller::CompareIndexBuffers( const unsigned short* pBufferA, const unsigned short* pBufferB, unsigned uNumTiles, unsigned uMaxNumLightsPerTile )
+    {
+        const unsigned uMaxNumElementsPerTile = 2*uMaxNumLightsPerTile + 4;
+        std::vector<unsigned short> SortedA, SortedB;
+
+        for( unsigned uTile = 0; uTile < uNumTiles; uTile++ )
+        {
+            const unsigned short* pTileA = pBufferA + (size_t)uTile*uMaxNumElementsPerTile;
+            const unsigned short* pTileB = pBufferB + (size_t)uTile*uMaxNumElementsPerTile;
+
+            // halfZ and both counts must match exactly
+            if( memcmp( pTileA, pTileB, 4*sizeof(unsigned short) ) != 0 )
+            {
+                return uTile;
+            }
+
+            for( unsigned uList = 0; uList < 2; uList++ )
+            {
+                const unsigned uCount = std::min( (unsigned)pTileA[2+uList], uMaxNumLightsPerTile );
+                const unsigned uOffset = 4 + uList*uMaxNumLightsPerTile;
+                SortedA.assign( pTileA + uOffset, pTileA + uOffset + uCount );
+                SortedB.assign( pTileB + uOffset, pTileB + uOffset + uCount );
+                std::sort( SortedA.begin(), SortedA.end() );
+                std::sort( SortedB.begin(), SortedB.end() );
+                if( SortedA != SortedB )
+                {
+                    return uTile;
+                }
+            }
+        }
+
+        return uNumTiles;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
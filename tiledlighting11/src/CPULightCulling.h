@@ -0,0 +1,282 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPULightCulling.h
+//
+// CPU implementation of the tiled light culling done by DoLightCulling in
+// Shaders/TilingCommonHeader.h. It writes the same PerTileLightIndexBuffer layout that
+// GetLightListInfo in Shaders/CommonHeader.h decodes, so it can be used as a headless
+// reference for the compute shaders. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "CPUSIMD.h"
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+    class CPULightBVH;
+
+    // Same memory layout as DirectX::XMFLOAT4
+    struct CPUFloat4
+    {
+        float x, y, z, w;
+    };
+
+    // Row-major, row-vector convention, same memory layout as DirectX::XMFLOAT4X4
+    struct CPUMatrix
+    {
+        float m[4][4];
+    };
+
+    // Same layout as LightUtilSpotParams: half-precision floats stored as unsigned shorts,
+    // with the sign of the light direction's z in the sign bit of the cone angle cosine
+    struct CPUSpotParams
+    {
+        unsigned short fLightDirX;
+        unsigned short fLightDirY;
+        unsigned short fCosineOfConeAngleAndLightDirZSign;
+        unsigned short fFalloffRadius;
+    };
+
+    // What the spot light lists are culled with, see CPUSpotLightCulling.h
+    enum CPUSpotCullingMode
+    {
+        CPU_SPOT_CULLING_SPHERE = 0,            // the bounding sphere in g_SpotLightBufferCenterAndRadius, like DoLightCulling
+        CPU_SPOT_CULLING_CONE_CONSERVATIVE,     // the smallest sphere around the cone
+        CPU_SPOT_CULLING_CONE_TIGHT,            // the cone itself (a spherical sector) against each tile plane
+        CPU_SPOT_CULLING_NUM_MODES
+    };
+
+    // Light culling constants.
+    // These must match their counterparts in CommonHeader.h.
+    // CPU_CULLING_TILE_RES is the default tile size; CPULightCullingInput::uTileRes selects another
+    // (the compute shaders are built for the sizes in g_nTileRes, see CommonConstants.h).
+    static const unsigned CPU_CULLING_TILE_RES = 16;
+
+    // Everything DoLightCulling reads from its constant buffers and SRVs
+    struct CPULightCullingInput
+    {
+        CPULightCullingInput();
+
+        // matrices as built in OnD3D11FrameRender, before they are transposed for upload
+        CPUMatrix           mView;
+        CPUMatrix           mProjectionInv;
+
+        unsigned            uWidth;
+        unsigned            uHeight;
+
+        // tile width and height in pixels, see CommonUtil::GetTileRes
+        unsigned            uTileRes;
+
+        // post-projection depth (inverted, so 0 is the far plane), uWidth*uHeight*uNumSamples floats,
+        // with the samples of a pixel stored next to each other
+        const float*        pDepth;
+        unsigned            uNumSamples;
+
+        // optional, non-NULL selects the blended-geometry culling path
+        const float*        pBlendedDepth;
+
+        // the contents of g_PointLightBufferCenterAndRadius, g_SpotLightBufferCenterAndRadius
+        // and g_VPLBufferCenterAndRadius (uNumVPLs should already be min(g_uMaxVPLs, g_uNumVPLs))
+        const CPUFloat4*    pPointLightCenterAndRadius;
+        unsigned            uNumPointLights;
+        const CPUFloat4*    pSpotLightCenterAndRadius;
+        unsigned            uNumSpotLights;
+        // optional, the contents of g_SpotLightBufferSpotParams, needed by the cone culling modes
+        const CPUSpotParams* pSpotParams;
+        const CPUFloat4*    pVPLCenterAndRadius;
+        unsigned            uNumVPLs;
+
+        // see GetMaxNumLightsPerTile and GetMaxNumVPLsPerTile in CommonConstants.h
+        unsigned            uMaxNumLightsPerTile;
+        unsigned            uMaxNumVPLsPerTile;
+    };
+
+    // Light centers in view space, structure-of-arrays, padded to a multiple of 8
+    struct CPUViewSpaceLights
+    {
+        CPUViewSpaceLights() : uCount(0) {}
+
+        std::vector<float>  X;
+        std::vector<float>  Y;
+        std::vector<float>  Z;
+        std::vector<float>  Radius;
+        unsigned            uCount;
+    };
+
+    // Decoded spot light cones in view space, structure-of-arrays
+    struct CPUViewSpaceSpotCones
+    {
+        CPUViewSpaceSpotCones() : uCount(0) {}
+
+        std::vector<float>  ApexX;
+        std::vector<float>  ApexY;
+        std::vector<float>  ApexZ;
+        std::vector<float>  DirX;
+        std::vector<float>  DirY;
+        std::vector<float>  DirZ;
+        std::vector<float>  CosAngle;
+        std::vector<float>  SinAngle;
+        std::vector<float>  Range;
+        // view-space depth extent of each sector
+        std::vector<float>  MinZ;
+        std::vector<float>  MaxZ;
+        unsigned            uCount;
+    };
+
+    // Side planes (through the origin, positive half-space outside) and depth range for one tile
+    struct CPUTileFrustum
+    {
+        float               Planes[4][3];
+        float               fMinZ;
+        float               fMaxZ;
+        float               fHalfZ;
+    };
+
+    // PerTileLightIndexBuffer layout:
+    // | HalfZ High Bits | HalfZ Low Bits | Light Count List A | Light Count List B | list A indices | list B indices |
+    struct CPULightCullingOutput
+    {
+        CPULightCullingOutput() : uTileRes(CPU_CULLING_TILE_RES), uNumTilesX(0), uNumTilesY(0), uMaxNumElementsPerTile(0), uMaxNumVPLElementsPerTile(0) {}
+
+        unsigned                    uTileRes;
+        unsigned                    uNumTilesX;
+        unsigned                    uNumTilesY;
+        unsigned                    uMaxNumElementsPerTile;
+        unsigned                    uMaxNumVPLElementsPerTile;
+
+        // R16_UINT, byte-for-byte what the culling compute shaders write to the index buffers in CommonUtil
+        std::vector<unsigned short> PointIndexBuffer;
+        std::vector<unsigned short> SpotIndexBuffer;
+        std::vector<unsigned short> VPLIndexBuffer;
+
+        // per-tile frustum and view-space depth bounds (fMinZ > fMaxZ for tiles without any depth samples)
+        std::vector<CPUTileFrustum> TileFrusta;
+    };
+
+    struct CPULightCullingStats
+    {
+        unsigned            uNumTiles;
+        unsigned            uNumPointLightsInput;
+        unsigned            uNumSpotLightsInput;
+        unsigned            uNumVPLsInput;
+
+        // total entries over lists A and B of all tiles, before clamping to the list size
+        unsigned long long  uNumPointIndices;
+        unsigned long long  uNumSpotIndices;
+        unsigned long long  uNumVPLIndices;
+
+        // tiles where list A or B had more entries than fit (the GPU behaviour is undefined there)
+        unsigned            uNumOverflowedPointTiles;
+        unsigned            uNumOverflowedSpotTiles;
+        unsigned            uNumOverflowedVPLTiles;
+    };
+
+    class CPULightCuller
+    {
+    public:
+        // Constructor / destructor
+        CPULightCuller();
+        ~CPULightCuller();
+
+        void SetSIMDLevel( CPUSIMDLevel Level ) { m_SIMDLevel = Level; }
+        CPUSIMDLevel GetSIMDLevel() const { return ResolveCPUSIMDLevel( m_SIMDLevel ); }
+
+        // Build a CPULightBVH over each light array every frame and traverse it per tile,
+        // instead of testing every light against every tile. The index buffers are the same.
+        void SetUseLightBVH( bool bUseLightBVH ) { m_bUseLightBVH = bUseLightBVH; }
+
+        // How the spot light lists are culled. The cone modes fall back to the bounding
+        // spheres when Input.pSpotParams is NULL. The tight mode doesn't use the spot BVH.
+        void SetSpotCullingMode( CPUSpotCullingMode Mode ) { m_SpotCullingMode = Mode; }
+
+        // Cull every tile, spreading the tiles across pScheduler (NULL runs on the calling thread).
+        // Per-list index order is ascending, whereas the GPU order depends on thread timing,
+        // so compare against GPU readbacks with CompareIndexBuffers.
+        void CullLights( const CPULightCullingInput& Input, CPULightCullingOutput& Output, CPUTaskScheduler* pScheduler );
+
+        const CPULightCullingStats& GetStats() const { return m_Stats; }
+
+        // Building blocks, shared with the other CPU culling modes
+        static unsigned GetNumTiles( unsigned uNumPixels, unsigned uTileRes = CPU_CULLING_TILE_RES ) { return ( uNumPixels + uTileRes - 1 ) / uTileRes; }
+        // Like DoLightCulling, the shader-matching version maps pixels to NDC as if the screen were padded out
+        // to a multiple of the tile size, which skews the planes when it isn't. bMatchShader=false uses the
+        // real screen size, so that every pixel of a tile is inside the tile's frustum.
+        static void BuildTileFrustum( const CPULightCullingInput& Input, unsigned uTileX, unsigned uTileY, CPUTileFrustum& Frustum, bool bMatchShader = true );
+        static void CalculateTileDepthBounds( const CPULightCullingInput& Input, unsigned uTileX, unsigned uTileY, CPUTileFrustum& Frustum );
+        static float ConvertProjDepthToView( const CPUMatrix& mProjectionInv, float fDepth );
+        static void TransformLightsToViewSpace( const CPUMatrix& mView, const CPUFloat4* pCenterAndRadius, unsigned uCount, CPUViewSpaceLights& Lights );
+
+        // Sphere vs. tile test with the halfZ split. Writes at most uListSize indices per list,
+        // but returns the full counts.
+        static void CullLightsAgainstTile( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, CPUSIMDLevel Level,
+            unsigned short* pListA, unsigned short* pListB, unsigned uListSize, unsigned& uCountA, unsigned& uCountB );
+
+        // Same test without the list size limit (or the 16-bit indices), into ListA and ListB
+        static void CullLightsAgainstTile( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, CPUSIMDLevel Level,
+            std::vector<unsigned>& ListA, std::vector<unsigned>& ListB );
+
+        // Sphere vs. tile test over [fMinZ,fMaxZ] with no halfZ split, appending to Indices
+        static void CullLightsAgainstFrustum( const CPUViewSpaceLights& Lights, const CPUTileFrustum& Frustum, CPUSIMDLevel Level, std::vector<unsigned>& Indices );
+
+        // Same lookup as GetLightListInfo in CommonHeader.h, for a pixel at (uX,uY) with view-space depth fViewZ.
+        // uFirstLightIndex is relative to pBuffer.
+        static void GetLightListInfo( const unsigned short* pBuffer, unsigned uNumTilesX, unsigned uMaxNumLightsPerTile, unsigned uX, unsigned uY, float fViewZ, unsigned& uFirstLightIndex, unsigned& uNumLights,
+            unsigned uTileRes = CPU_CULLING_TILE_RES );
+
+        // Compare two index buffers in PerTileLightIndexBuffer layout, treating each list as a set.
+        // Returns the index of the first mismatching tile, or uNumTiles if they match.
+        static unsigned CompareIndexBuffers( const unsigned short* pBufferA, const unsigned short* pBufferB, unsigned uNumTiles, unsigned uMaxNumLightsPerTile );
+
+    private:
+        // not copyable
+        CPULightCuller( const CPULightCuller& );
+        CPULightCuller& operator=( const CPULightCuller& );
+
+        CPUSIMDLevel            m_SIMDLevel;
+        bool                    m_bUseLightBVH;
+        CPUSpotCullingMode      m_SpotCullingMode;
+        CPULightCullingStats    m_Stats;
+
+        // per-frame view-space copies of the light arrays
+        CPUViewSpaceLights      m_PointLights;
+        CPUViewSpaceLights      m_SpotLights;
+        CPUViewSpaceLights      m_VPLs;
+        CPUViewSpaceSpotCones   m_SpotCones;
+
+        // per-frame hierarchies over the view-space lights, when m_bUseLightBVH is set
+        std::unique_ptr<CPULightBVH>    m_pPointBVH;
+        std::unique_ptr<CPULightBVH>    m_pSpotBVH;
+        std::unique_ptr<CPULightBVH>    m_pVPLBVH;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
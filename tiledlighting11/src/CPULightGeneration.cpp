@@ -0,0 +1,237 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPULightGeneration.cpp
+//
+// Procedural random lights.
+//--------------------------------------------------------------------------------------
+
+#include "CPULightGeneration.h"
+#include "CPUSpotLightCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <math.h>
+
+namespace TiledLighting11
+{
+    // one key per light type, so that point and spot light i are independent
+    static const unsigned POINT_LIGHT_STREAM = 0;
+    static const unsigned SPOT_LIGHT_STREAM = 1;
+
+    // lights per chunk when generating in parallel
+    static const unsigned LIGHT_GENERATION_GRAIN_SIZE = 1024;
+
+    //--------------------------------------------------------------------------------------
+    // Philox4x32-10
+    //--------------------------------------------------------------------------------------
+    void CPUPhilox4x32( const unsigned Counter[4], const unsigned Key[2], unsigned Result[4] )
+    {
+        static const unsigned M0 = 0xD2511F53u;
+        static const unsigned M1 = 0xCD9E8D57u;
+        static const unsigned W0 = 0x9E3779B9u;
+        static const unsigned W1 = 0xBB67AE85u;
+
+        unsigned c0 = Counter[0], c1 = Counter[1], c2 = Counter[2], c3 = Counter[3];
+        unsigned k0 = Key[0], k1 = Key[1];
+        for( int nRound = 0; nRound < 10; nRound++ )
+        {
+            const unsigned long long uProduct0 = (unsigned long long)M0*c0;
+            const unsigned long long uProduct1 = (unsigned long long)M1*c2;
+
+            c0 = (unsigned)( uProduct1 >> 32 ) ^ c1 ^ k0;
+            c2 = (unsigned)( uProduct0 >> 32 ) ^ c3 ^ k1;
+            c1 = (unsigned)uProduct1;
+            c3 = (unsigned)uProduct0;
+
+            k0 += W0;
+            k1 += W1;
+        }
+
+        Result[0] = c0;
+        Result[1] = c1;
+        Result[2] = c2;
+        Result[3] = c3;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The random numbers of one light, as floats in [0,1)
+    //--------------------------------------------------------------------------------------
+    class LightRandom
+    {
+    public:
+        LightRandom( unsigned uSeed, unsigned uStream, unsigned uLight )
+            :m_uLight(uLight)
+            ,m_uBlock(0)
+            ,m_uNext(4)
+        {
+            m_Key[0] = uSeed;
+            m_Key[1] = uStream;
+        }
+
+        // in the half-closed interval [fRangeMin, fRangeMax), like LightUtil's GetRandFloat
+        float GetFloat( float fRangeMin, float fRangeMax )
+        {
+            if( m_uNext == 4 )
+            {
+                const unsigned Counter[4] = { m_uLight, m_uBlock++, 0, 0 };
+                CPUPhilox4x32( Counter, m_Key, m_Numbers );
+                m_uNext = 0;
+            }
+
+            return (float)( m_Numbers[m_uNext++] >> 8 ) / 16777216.0f * ( fRangeMax - fRangeMin ) + fRangeMin;
+        }
+
+    private:
+        unsigned    m_Key[2];
+        unsigned    m_uLight;
+        unsigned    m_uBlock;
+        unsigned    m_Numbers[4];
+        unsigned    m_uNext;
+    };
+
+    static void GenerateCenterAndColor( const CPULightGenerationDesc& Desc, unsigned uLight, LightRandom& Random, CPUFloat4& CenterAndRadius, unsigned& uColor )
+    {
+        CenterAndRadius.x = Random.GetFloat( Desc.BBoxMin[0], Desc.BBoxMax[0] );
+        CenterAndRadius.y = Random.GetFloat( Desc.BBoxMin[1], Desc.BBoxMax[1] );
+        CenterAndRadius.z = Random.GetFloat( Desc.BBoxMin[2], Desc.BBoxMax[2] );
+        CenterAndRadius.w = Desc.fRadius;
+
+        // green contributes the most to perceived brightness, so cap its min value, or else
+        // make the red component large, to avoid overly dim lights
+        float r, g, b;
+        if( uLight % 2 )
+        {
+            r = Random.GetFloat( 0.0f, 1.0f );
+            g = Random.GetFloat( 0.27f, 1.0f );
+            b = Random.GetFloat( 0.0f, 1.0f );
+        }
+        else
+        {
+            r = Random.GetFloat( 0.9f, 1.0f );
+            g = Random.GetFloat( 0.0f, 1.0f );
+            b = Random.GetFloat( 0.0f, 1.0f );
+        }
+
+        const unsigned uR = (unsigned)( r*255.0f + 0.5f );
+        const unsigned uG = (unsigned)( g*255.0f + 0.5f );
+        const unsigned uB = (unsigned)( b*255.0f + 0.5f );
+        uColor = uR | ( uG << 8 ) | ( uB << 16 ) | 0xFF000000u;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Desc
+    //--------------------------------------------------------------------------------------
+    void InitCPULightGenerationDesc( unsigned uSeed, const float BBoxMin[3], const float BBoxMax[3], CPULightGenerationDesc& Desc )
+    {
+        Desc.uSeed = uSeed;
+
+        float fExtentsSquared = 0.0f;
+        for( int i = 0; i < 3; i++ )
+        {
+            Desc.BBoxMin[i] = BBoxMin[i];
+            Desc.BBoxMax[i] = BBoxMax[i];
+
+            const float fExtent = 0.5f*( BBoxMax[i] - BBoxMin[i] );
+            fExtentsSquared += fExtent*fExtent;
+        }
+        Desc.fRadius = 0.075f*sqrtf( fExtentsSquared );
+
+        // the max-volume cone inside the bounding sphere: h_cone = (4/3)*r_sphere, and
+        // r_cone = sqrt(8/9)*r_sphere, so the cone angle is 35.26438968 degrees
+        Desc.fSpotCosineOfConeAngle = 0.816496580927726f;
+        Desc.fSpotFalloffRadius = 1.333333333333f*Desc.fRadius;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Generate
+    //--------------------------------------------------------------------------------------
+    void GenerateCPUPointLights( const CPULightGenerationDesc& Desc, unsigned uNumLights, CPUFloat4* pCenterAndRadius, unsigned* pColor, CPUTaskScheduler* pScheduler )
+    {
+        CPUTaskScheduler::RangeFunction GenerateLights = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned i = uBegin; i < uEnd; i++ )
+            {
+                LightRandom Random( Desc.uSeed, POINT_LIGHT_STREAM, i );
+                GenerateCenterAndColor( Desc, i, Random, pCenterAndRadius[i], pColor[i] );
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumLights, LIGHT_GENERATION_GRAIN_SIZE, GenerateLights );
+        }
+        else
+        {
+            GenerateLights( 0, uNumLights, 0 );
+        }
+    }
+
+    void GenerateCPUSpotLights( const CPULightGenerationDesc& Desc, unsigned uNumLights, CPUFloat4* pCenterAndRadius, unsigned* pColor,
+        CPUSpotParams* pSpotParams, CPUMatrix* pSpotMatrices, CPUTaskScheduler* pScheduler )
+    {
+        CPUTaskScheduler::RangeFunction GenerateLights = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned i = uBegin; i < uEnd; i++ )
+            {
+                LightRandom Random( Desc.uSeed, SPOT_LIGHT_STREAM, i );
+                GenerateCenterAndColor( Desc, i, Random, pCenterAndRadius[i], pColor[i] );
+
+                // half the lights point up, half down
+                float Dir[3];
+                Dir[0] = Random.GetFloat( -1.0f, 1.0f );
+                Dir[1] = Random.GetFloat( 0.1f, 1.0f );
+                Dir[2] = Random.GetFloat( -1.0f, 1.0f );
+                if( i % 2 )
+                {
+                    Dir[1] = -Dir[1];
+                }
+
+                const float fInvLength = 1.0f / sqrtf( Dir[0]*Dir[0] + Dir[1]*Dir[1] + Dir[2]*Dir[2] );
+                Dir[0] *= fInvLength;
+                Dir[1] *= fInvLength;
+                Dir[2] *= fInvLength;
+
+                pSpotParams[i] = PackCPUSpotParams( Dir, Desc.fSpotCosineOfConeAngle, Desc.fSpotFalloffRadius );
+                if( pSpotMatrices )
+                {
+                    CalcCPUSpotLightRotation( Dir, pSpotMatrices[i] );
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumLights, LIGHT_GENERATION_GRAIN_SIZE, GenerateLights );
+        }
+        else
+        {
+            GenerateLights( 0, uNumLights, 0 );
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,75 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPULightGeneration.h
+//
+// Procedural random lights, as LightUtil::InitLights makes them, from a counter-based
+// random number generator (Philox4x32-10) instead of the sequential rand(). Every random
+// number of light i is a function of the seed, the light type and i alone, so the lights
+// can be generated in parallel chunks, in any order, and the result does not depend on
+// the number of threads. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+
+    // Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3"):
+    // four random 32-bit numbers per 128-bit counter and 64-bit key
+    void CPUPhilox4x32( const unsigned Counter[4], const unsigned Key[2], unsigned Result[4] );
+
+    struct CPULightGenerationDesc
+    {
+        unsigned    uSeed;
+
+        // the lights' centers are uniform in the box
+        float       BBoxMin[3];
+        float       BBoxMax[3];
+
+        // the bounding sphere radius of every light, and the cones of the spot lights
+        float       fRadius;
+        float       fSpotCosineOfConeAngle;
+        float       fSpotFalloffRadius;
+    };
+
+    // InitLights' sizes: the radius is 7.5% of the half diagonal of the box, and the spot
+    // light cones are the largest that fit in the bounding spheres
+    void InitCPULightGenerationDesc( unsigned uSeed, const float BBoxMin[3], const float BBoxMax[3], CPULightGenerationDesc& Desc );
+
+    // Lights [0,uNumLights), in the light buffer layouts. Even lights get a red color
+    // channel in [0.9,1), odd ones a green channel in [0.27,1), and odd spot lights point
+    // down, as in InitLights. pSpotMatrices (the debug drawing rotations) can be NULL.
+    void GenerateCPUPointLights( const CPULightGenerationDesc& Desc, unsigned uNumLights, CPUFloat4* pCenterAndRadius, unsigned* pColor, CPUTaskScheduler* pScheduler );
+    void GenerateCPUSpotLights( const CPULightGenerationDesc& Desc, unsigned uNumLights, CPUFloat4* pCenterAndRadius, unsigned* pColor,
+        CPUSpotParams* pSpotParams, CPUMatrix* pSpotMatrices, CPUTaskScheduler* pScheduler );
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
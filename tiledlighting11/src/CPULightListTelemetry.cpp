@@ -0,0 +1,203 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPULightListTelemetry.cpp
+//
+// Occupancy telemetry for the per-tile light lists.
+//--------------------------------------------------------------------------------------
+
+#include "CPULightListTelemetry.h"
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    static const char* const g_LightTypeNames[] = { "point", "spot", "vpl" };
+
+    //--------------------------------------------------------------------------------------
+    // Histogram and summary of one light type's lists
+    //--------------------------------------------------------------------------------------
+    void GatherLightListOccupancy( const unsigned short* pBuffer, unsigned uNumTiles, unsigned uListSize, CPULightListOccupancy& Occupancy )
+    {
+        const unsigned uMaxNumElementsPerTile = 2*uListSize + 4;
+
+        Occupancy = CPULightListOccupancy();
+        Occupancy.uNumLists = 2*uNumTiles;
+        Occupancy.uListSize = uListSize;
+
+        for( unsigned uTile = 0; uTile < uNumTiles; uTile++ )
+        {
+            const unsigned short* pTile = &pBuffer[(size_t)uTile*uMaxNumElementsPerTile];
+            bool bOverflowed = false;
+
+            for( unsigned uList = 0; uList < 2; uList++ )
+            {
+                const unsigned uLength = pTile[2 + uList];
+                if( uLength >= Occupancy.Histogram.size() )
+                {
+                    Occupancy.Histogram.resize( uLength + 1, 0 );
+                }
+                Occupancy.Histogram[uLength]++;
+                Occupancy.uNumEntries += uLength;
+
+                if( uLength > uListSize )
+                {
+                    Occupancy.uNumOverflowedLists++;
+                    bOverflowed = true;
+                }
+            }
+
+            if( bOverflowed )
+            {
+                Occupancy.uNumOverflowedTiles++;
+            }
+        }
+
+        Occupancy.uMaxLength = Occupancy.Histogram.empty() ? 0 : (unsigned)Occupancy.Histogram.size() - 1;
+        Occupancy.uP50 = GetLightListPercentile( Occupancy, 50.0 );
+        Occupancy.uP95 = GetLightListPercentile( Occupancy, 95.0 );
+        Occupancy.uP99 = GetLightListPercentile( Occupancy, 99.0 );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Telemetry for the index buffers of a CPU culling output
+    //--------------------------------------------------------------------------------------
+    void GatherLightListTelemetry( const CPULightCullingInput& Input, const CPULightCullingOutput& Output, CPULightListTelemetry& Telemetry )
+    {
+        const unsigned uNumTiles = Output.uNumTilesX*Output.uNumTilesY;
+        assert( Output.PointIndexBuffer.size() == (size_t)uNumTiles*Output.uMaxNumElementsPerTile );
+
+        Telemetry.uWidth = Input.uWidth;
+        Telemetry.uHeight = Input.uHeight;
+        Telemetry.uTileRes = Output.uTileRes;
+        Telemetry.uNumTilesX = Output.uNumTilesX;
+        Telemetry.uNumTilesY = Output.uNumTilesY;
+
+        GatherLightListOccupancy( Output.PointIndexBuffer.empty() ? NULL : &Output.PointIndexBuffer[0], uNumTiles, Input.uMaxNumLightsPerTile, Telemetry.Point );
+        GatherLightListOccupancy( Output.SpotIndexBuffer.empty() ? NULL : &Output.SpotIndexBuffer[0], uNumTiles, Input.uMaxNumLightsPerTile, Telemetry.Spot );
+
+        Telemetry.bHasVPLs = !Output.VPLIndexBuffer.empty();
+        if( Telemetry.bHasVPLs )
+        {
+            GatherLightListOccupancy( &Output.VPLIndexBuffer[0], uNumTiles, Input.uMaxNumVPLsPerTile, Telemetry.VPL );
+        }
+        else
+        {
+            Telemetry.VPL = CPULightListOccupancy();
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Nearest-rank percentile of the list lengths
+    //--------------------------------------------------------------------------------------
+    unsigned GetLightListPercentile( const CPULightListOccupancy& Occupancy, double fPercent )
+    {
+        if( Occupancy.uNumLists == 0 )
+        {
+            return 0;
+        }
+
+        const double fRank = ceil( std::min( std::max( fPercent, 0.0 ), 100.0 )*Occupancy.uNumLists / 100.0 );
+        const unsigned long long uRank = std::max( (unsigned long long)fRank, 1ull );
+
+        unsigned long long uNumLists = 0;
+        for( size_t uLength = 0; uLength < Occupancy.Histogram.size(); uLength++ )
+        {
+            uNumLists += Occupancy.Histogram[uLength];
+            if( uNumLists >= uRank )
+            {
+                return (unsigned)uLength;
+            }
+        }
+
+        return Occupancy.uMaxLength;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // CSV
+    //--------------------------------------------------------------------------------------
+    void WriteLightListTelemetryCSVHeader( FILE* pFile )
+    {
+        fprintf( pFile, "frame,type,width,height,tile_res,tiles_x,tiles_y,list_size,lists,entries,mean,max,p50,p95,p99,overflowed_lists,overflowed_tiles,histogram\n" );
+    }
+
+    void WriteLightListTelemetryCSV( FILE* pFile, const CPULightListTelemetry& Telemetry )
+    {
+        const CPULightListOccupancy* pTypes[] = { &Telemetry.Point, &Telemetry.Spot, &Telemetry.VPL };
+        const int nNumTypes = Telemetry.bHasVPLs ? 3 : 2;
+
+        for( int nType = 0; nType < nNumTypes; nType++ )
+        {
+            const CPULightListOccupancy& Occupancy = *pTypes[nType];
+
+            fprintf( pFile, "%u,%s,%u,%u,%u,%u,%u,%u,%u,%llu,%.3f,%u,%u,%u,%u,%u,%u,",
+                Telemetry.uFrame, g_LightTypeNames[nType], Telemetry.uWidth, Telemetry.uHeight, Telemetry.uTileRes, Telemetry.uNumTilesX, Telemetry.uNumTilesY,
+                Occupancy.uListSize, Occupancy.uNumLists, Occupancy.uNumEntries, Occupancy.uNumLists ? (double)Occupancy.uNumEntries / Occupancy.uNumLists : 0.0,
+                Occupancy.uMaxLength, Occupancy.uP50, Occupancy.uP95, Occupancy.uP99, Occupancy.uNumOverflowedLists, Occupancy.uNumOverflowedTiles );
+
+            for( size_t i = 0; i < Occupancy.Histogram.size(); i++ )
+            {
+                fprintf( pFile, i ? ";%u" : "%u", Occupancy.Histogram[i] );
+            }
+            fprintf( pFile, "\n" );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // JSON
+    //--------------------------------------------------------------------------------------
+    void WriteLightListTelemetryJSON( FILE* pFile, const CPULightListTelemetry& Telemetry )
+    {
+        const CPULightListOccupancy* pTypes[] = { &Telemetry.Point, &Telemetry.Spot, &Telemetry.VPL };
+        const int nNumTypes = Telemetry.bHasVPLs ? 3 : 2;
+
+        fprintf( pFile, "{\"frame\":%u,\"width\":%u,\"height\":%u,\"tile_res\":%u,\"tiles_x\":%u,\"tiles_y\":%u",
+            Telemetry.uFrame, Telemetry.uWidth, Telemetry.uHeight, Telemetry.uTileRes, Telemetry.uNumTilesX, Telemetry.uNumTilesY );
+
+        for( int nType = 0; nType < nNumTypes; nType++ )
+        {
+            const CPULightListOccupancy& Occupancy = *pTypes[nType];
+
+            fprintf( pFile, ",\"%s\":{\"list_size\":%u,\"lists\":%u,\"entries\":%llu,\"mean\":%.3f,\"max\":%u,\"p50\":%u,\"p95\":%u,\"p99\":%u,\"overflowed_lists\":%u,\"overflowed_tiles\":%u,\"histogram\":[",
+                g_LightTypeNames[nType], Occupancy.uListSize, Occupancy.uNumLists, Occupancy.uNumEntries,
+                Occupancy.uNumLists ? (double)Occupancy.uNumEntries / Occupancy.uNumLists : 0.0,
+                Occupancy.uMaxLength, Occupancy.uP50, Occupancy.uP95, Occupancy.uP99, Occupancy.uNumOverflowedLists, Occupancy.uNumOverflowedTiles );
+
+            for( size_t i = 0; i < Occupancy.Histogram.size(); i++ )
+            {
+                fprintf( pFile, i ? ",%u" : "%u", Occupancy.Histogram[i] );
+            }
+            fprintf( pFile, "]}" );
+        }
+
+        fprintf( pFile, "}\n" );
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,104 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPULightListTelemetry.h
+//
+// Occupancy telemetry for the per-tile light lists: the histogram of list lengths, the
+// longest list, percentiles and the tiles that overflowed, for point, spot and VPL lists.
+// It reads the PerTileLightIndexBuffer layout, so it works on the CPU culler's output as
+// well as on index buffers read back from the GPU (see CommonUtil::GatherLightListTelemetry).
+// The counts in the buffer are what the culling found, not what fit, so the lengths are
+// the lengths the lists would need. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    // One light type. Every tile has two lists (A and B, split at halfZ), and both are counted.
+    struct CPULightListOccupancy
+    {
+        CPULightListOccupancy() : uNumLists(0), uListSize(0), uNumEntries(0), uMaxLength(0), uP50(0), uP95(0), uP99(0), uNumOverflowedLists(0), uNumOverflowedTiles(0) {}
+
+        unsigned                uNumLists;
+        unsigned                uListSize;          // the lists' capacity, uMaxNumLightsPerTile or uMaxNumVPLsPerTile
+        unsigned long long      uNumEntries;
+
+        unsigned                uMaxLength;
+        unsigned                uP50;
+        unsigned                uP95;
+        unsigned                uP99;
+
+        // lists longer than uListSize, and tiles with at least one of them
+        unsigned                uNumOverflowedLists;
+        unsigned                uNumOverflowedTiles;
+
+        // Histogram[n] is the number of lists with n entries, up to uMaxLength
+        std::vector<unsigned>   Histogram;
+    };
+
+    struct CPULightListTelemetry
+    {
+        CPULightListTelemetry() : uFrame(0), uWidth(0), uHeight(0), uTileRes(0), uNumTilesX(0), uNumTilesY(0), bHasVPLs(false) {}
+
+        unsigned                uFrame;
+        unsigned                uWidth;
+        unsigned                uHeight;
+        unsigned                uTileRes;
+        unsigned                uNumTilesX;
+        unsigned                uNumTilesY;
+
+        CPULightListOccupancy   Point;
+        CPULightListOccupancy   Spot;
+        bool                    bHasVPLs;
+        CPULightListOccupancy   VPL;
+    };
+
+    // Reads the two counts of uNumTiles tiles from a buffer in the PerTileLightIndexBuffer layout
+    void GatherLightListOccupancy( const unsigned short* pBuffer, unsigned uNumTiles, unsigned uListSize, CPULightListOccupancy& Occupancy );
+
+    // All three light types of a CPU culling output (VPLs only if Output has them)
+    void GatherLightListTelemetry( const CPULightCullingInput& Input, const CPULightCullingOutput& Output, CPULightListTelemetry& Telemetry );
+
+    // The smallest length that fPercent percent of the lists fit in
+    unsigned GetLightListPercentile( const CPULightListOccupancy& Occupancy, double fPercent );
+
+    // CSV, one row per light type. The histogram is the last column, as counts
+    // for lengths 0, 1, 2, ... separated by semicolons.
+    void WriteLightListTelemetryCSVHeader( FILE* pFile );
+    void WriteLightListTelemetryCSV( FILE* pFile, const CPULightListTelemetry& Telemetry );
+
+    // JSON, one object per frame on a single line, so that a file of frames is JSON Lines
+    void WriteLightListTelemetryJSON( FILE* pFile, const CPULightListTelemetry& Telemetry );
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
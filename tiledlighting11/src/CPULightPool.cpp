@@ -0,0 +1,338 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPULightPool.cpp
+//
+// Light pool with stable handles and dirty-range tracking.
+//--------------------------------------------------------------------------------------
+
+#include "CPULightPool.h"
+#include "CPUSIMD.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    static const unsigned SLOT_MASK = CPULightPool::MAX_CAPACITY - 1;
+
+    static unsigned GetSlot( CPULightHandle Handle ) { return Handle & SLOT_MASK; }
+    static unsigned GetGeneration( CPULightHandle Handle ) { return Handle >> CPU_LIGHT_HANDLE_SLOT_BITS; }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPULightPool::CPULightPool()
+        :m_uCapacity(0)
+        ,m_uCount(0)
+        ,m_uNumAttributes(0)
+        ,m_uFirstDirtyWord(1)
+        ,m_uLastDirtyWord(0)
+    {
+        memset( m_AttributeSizes, 0, sizeof(m_AttributeSizes) );
+        memset( m_uNumDirty, 0, sizeof(m_uNumDirty) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPULightPool::~CPULightPool()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Remove every light and resize the attribute arrays
+    //--------------------------------------------------------------------------------------
+    void CPULightPool::Reset( unsigned uCapacity, const unsigned* pAttributeSizes, unsigned uNumAttributes )
+    {
+        assert( uCapacity <= MAX_CAPACITY );
+        assert( uNumAttributes <= MAX_ATTRIBUTES );
+
+        m_uCapacity = uCapacity;
+        m_uCount = 0;
+        m_uNumAttributes = uNumAttributes;
+
+        const unsigned uNumWords = ( uCapacity + 31 ) / 32;
+        for( unsigned i = 0; i < MAX_ATTRIBUTES; i++ )
+        {
+            m_AttributeSizes[i] = ( i < uNumAttributes ) ? pAttributeSizes[i] : 0;
+            m_Data[i].assign( (size_t)uCapacity*m_AttributeSizes[i], 0 );
+            m_DirtyBits[i].assign( ( i < uNumAttributes ) ? uNumWords : 0, 0 );
+            m_uNumDirty[i] = 0;
+        }
+        m_uFirstDirtyWord = 1;
+        m_uLastDirtyWord = 0;
+
+        m_SlotToDense.assign( uCapacity, CPU_INVALID_LIGHT_HANDLE );
+        m_SlotGeneration.assign( uCapacity, 0 );
+        m_DenseToSlot.assign( uCapacity, 0 );
+
+        // handed out from the back, so the first lights get slots 0, 1, 2...
+        m_FreeSlots.resize( uCapacity );
+        for( unsigned i = 0; i < uCapacity; i++ )
+        {
+            m_FreeSlots[i] = uCapacity - 1 - i;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Set an element's dirty bit
+    //--------------------------------------------------------------------------------------
+    void CPULightPool::MarkDirty( unsigned uAttribute, unsigned uDenseIndex )
+    {
+        const unsigned uWord = uDenseIndex / 32;
+        const unsigned uBit = 1u << ( uDenseIndex % 32 );
+
+        unsigned& uBits = m_DirtyBits[uAttribute][uWord];
+        if( ( uBits & uBit ) == 0 )
+        {
+            uBits |= uBit;
+            m_uNumDirty[uAttribute]++;
+        }
+
+        if( m_uFirstDirtyWord > m_uLastDirtyWord )
+        {
+            m_uFirstDirtyWord = uWord;
+            m_uLastDirtyWord = uWord;
+        }
+        else
+        {
+            m_uFirstDirtyWord = std::min( m_uFirstDirtyWord, uWord );
+            m_uLastDirtyWord = std::max( m_uLastDirtyWord, uWord );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Take a free slot, and put the light at the end of the attribute arrays
+    //--------------------------------------------------------------------------------------
+    CPULightHandle CPULightPool::Add()
+    {
+        if( m_uCount == m_uCapacity )
+        {
+            return CPU_INVALID_LIGHT_HANDLE;
+        }
+
+        const unsigned uSlot = m_FreeSlots.back();
+        m_FreeSlots.pop_back();
+
+        const unsigned uDenseIndex = m_uCount++;
+        m_SlotToDense[uSlot] = uDenseIndex;
+        m_DenseToSlot[uDenseIndex] = uSlot;
+
+        for( unsigned i = 0; i < m_uNumAttributes; i++ )
+        {
+            MarkDirty( i, uDenseIndex );
+        }
+
+        return uSlot | ( m_SlotGeneration[uSlot] << CPU_LIGHT_HANDLE_SLOT_BITS );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Move the last light into the hole, and free the slot
+    //--------------------------------------------------------------------------------------
+    bool CPULightPool::Remove( CPULightHandle Handle )
+    {
+        if( !IsValid( Handle ) )
+        {
+            return false;
+        }
+
+        const unsigned uSlot = GetSlot( Handle );
+        const unsigned uDenseIndex = m_SlotToDense[uSlot];
+        const unsigned uLast = m_uCount - 1;
+
+        if( uDenseIndex != uLast )
+        {
+            for( unsigned i = 0; i < m_uNumAttributes; i++ )
+            {
+                const size_t uSize = m_AttributeSizes[i];
+                memcpy( &m_Data[i][uDenseIndex*uSize], &m_Data[i][uLast*uSize], uSize );
+                MarkDirty( i, uDenseIndex );
+            }
+
+            const unsigned uMovedSlot = m_DenseToSlot[uLast];
+            m_DenseToSlot[uDenseIndex] = uMovedSlot;
+            m_SlotToDense[uMovedSlot] = uDenseIndex;
+        }
+        m_uCount--;
+
+        m_SlotToDense[uSlot] = CPU_INVALID_LIGHT_HANDLE;
+        m_SlotGeneration[uSlot] = ( m_SlotGeneration[uSlot] + 1 ) & ( CPU_INVALID_LIGHT_HANDLE >> CPU_LIGHT_HANDLE_SLOT_BITS );
+        m_FreeSlots.push_back( uSlot );
+
+        return true;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The slot is in use, by the light of this generation
+    //--------------------------------------------------------------------------------------
+    bool CPULightPool::IsValid( CPULightHandle Handle ) const
+    {
+        const unsigned uSlot = GetSlot( Handle );
+        return uSlot < m_uCapacity && m_SlotToDense[uSlot] != CPU_INVALID_LIGHT_HANDLE && m_SlotGeneration[uSlot] == GetGeneration( Handle );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Write one attribute of a light
+    //--------------------------------------------------------------------------------------
+    void CPULightPool::Set( CPULightHandle Handle, unsigned uAttribute, const void* pData )
+    {
+        assert( IsValid( Handle ) );
+        assert( uAttribute < m_uNumAttributes );
+
+        const unsigned uDenseIndex = m_SlotToDense[GetSlot( Handle )];
+        const size_t uSize = m_AttributeSizes[uAttribute];
+        memcpy( &m_Data[uAttribute][uDenseIndex*uSize], pData, uSize );
+        MarkDirty( uAttribute, uDenseIndex );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Read one attribute of a light
+    //--------------------------------------------------------------------------------------
+    const void* CPULightPool::Get( CPULightHandle Handle, unsigned uAttribute ) const
+    {
+        assert( IsValid( Handle ) );
+        assert( uAttribute < m_uNumAttributes );
+
+        const unsigned uDenseIndex = m_SlotToDense[GetSlot( Handle )];
+        return &m_Data[uAttribute][uDenseIndex*m_AttributeSizes[uAttribute]];
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Dense index of a valid handle
+    //--------------------------------------------------------------------------------------
+    unsigned CPULightPool::GetDenseIndex( CPULightHandle Handle ) const
+    {
+        assert( IsValid( Handle ) );
+        return m_SlotToDense[GetSlot( Handle )];
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Handle of the light at a dense index
+    //--------------------------------------------------------------------------------------
+    CPULightHandle CPULightPool::GetHandle( unsigned uDenseIndex ) const
+    {
+        assert( uDenseIndex < m_uCount );
+        const unsigned uSlot = m_DenseToSlot[uDenseIndex];
+        return uSlot | ( m_SlotGeneration[uSlot] << CPU_LIGHT_HANDLE_SLOT_BITS );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Walk the runs of set bits in the dirty words, merging runs closer than uMaxGap
+    //--------------------------------------------------------------------------------------
+    void CPULightPool::GetDirtyRanges( unsigned uAttribute, unsigned uMaxGap, std::vector<CPULightPoolRange>& Ranges ) const
+    {
+        Ranges.clear();
+        if( uAttribute >= m_uNumAttributes || m_uNumDirty[uAttribute] == 0 )
+        {
+            return;
+        }
+
+        const std::vector<unsigned>& DirtyBits = m_DirtyBits[uAttribute];
+        const unsigned uLastWord = std::min( m_uLastDirtyWord, (unsigned)DirtyBits.size() - 1 );
+
+        bool bOpen = false;
+        CPULightPoolRange Range = { 0, 0 };
+        for( unsigned uWord = m_uFirstDirtyWord; uWord <= uLastWord; uWord++ )
+        {
+            unsigned uBits = DirtyBits[uWord];
+            while( uBits != 0 )
+            {
+                // the run of set bits starting at the lowest one
+                const unsigned uStart = CountTrailingZeros( uBits );
+                const unsigned uShifted = ~( uBits >> uStart );
+                const unsigned uLength = ( uShifted == 0 ) ? 32 - uStart : std::min( CountTrailingZeros( uShifted ), 32 - uStart );
+                uBits = ( uStart + uLength >= 32 ) ? 0 : ( uBits & ( ~0u << ( uStart + uLength ) ) );
+
+                const unsigned uFirst = uWord*32 + uStart;
+                if( bOpen && uFirst <= Range.uFirst + Range.uCount + uMaxGap )
+                {
+                    Range.uCount = uFirst + uLength - Range.uFirst;
+                }
+                else
+                {
+                    if( bOpen )
+                    {
+                        Ranges.push_back( Range );
+                    }
+                    Range.uFirst = uFirst;
+                    Range.uCount = uLength;
+                    bOpen = true;
+                }
+            }
+        }
+        if( bOpen )
+        {
+            Ranges.push_back( Range );
+        }
+
+        // elements past the end were dirtied before lights were removed, and are not read
+        while( !Ranges.empty() && Ranges.back().uFirst >= m_uCount )
+        {
+            Ranges.pop_back();
+        }
+        if( !Ranges.empty() )
+        {
+            Ranges.back().uCount = std::min( Ranges.back().uCount, m_uCount - Ranges.back().uFirst );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Zero the dirty words that can be nonzero
+    //--------------------------------------------------------------------------------------
+    void CPULightPool::ClearDirtyRanges()
+    {
+        if( m_uFirstDirtyWord <= m_uLastDirtyWord )
+        {
+            for( unsigned i = 0; i < m_uNumAttributes; i++ )
+            {
+                std::fill( m_DirtyBits[i].begin() + m_uFirstDirtyWord, m_DirtyBits[i].begin() + m_uLastDirtyWord + 1, 0u );
+                m_uNumDirty[i] = 0;
+            }
+        }
+        m_uFirstDirtyWord = 1;
+        m_uLastDirtyWord = 0;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Mark the first GetCount() elements of every attribute dirty
+    //--------------------------------------------------------------------------------------
+    void CPULightPool::MarkAllDirty()
+    {
+        for( unsigned i = 0; i < m_uCount; i++ )
+        {
+            for( unsigned j = 0; j < m_uNumAttributes; j++ )
+            {
+                MarkDirty( j, i );
+            }
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
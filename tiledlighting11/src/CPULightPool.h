@@ -0,0 +1,141 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPULightPool.h
+//
+// A pool of lights with stable handles. Each attribute of the lights (center and radius,
+// color, ...) is kept in its own densely packed array, in the layout of the structured
+// buffers the shaders read, so that the first GetCount() elements can be uploaded as is.
+// Adding and removing a light is O(1): a removed light's hole is filled by moving the
+// last light into it. Every write marks the element dirty, and GetDirtyRanges turns the
+// dirty elements of an attribute into a short list of ranges to upload.
+// This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+namespace TiledLighting11
+{
+    // The slot of the light in the low CPU_LIGHT_HANDLE_SLOT_BITS bits, and in the others
+    // a generation count that changes every time the slot is freed, so that the handle
+    // of a removed light stays invalid even after its slot is reused
+    typedef unsigned CPULightHandle;
+
+    static const unsigned CPU_LIGHT_HANDLE_SLOT_BITS = 20;
+    static const CPULightHandle CPU_INVALID_LIGHT_HANDLE = 0xFFFFFFFF;
+
+    // Elements [uFirst, uFirst + uCount) of an attribute array
+    struct CPULightPoolRange
+    {
+        unsigned    uFirst;
+        unsigned    uCount;
+    };
+
+    class CPULightPool
+    {
+    public:
+        static const unsigned MAX_CAPACITY = 1 << CPU_LIGHT_HANDLE_SLOT_BITS;
+        static const unsigned MAX_ATTRIBUTES = 8;
+
+        // Constructor / destructor
+        CPULightPool();
+        ~CPULightPool();
+
+        // Remove every light, and size the pool for uCapacity lights with uNumAttributes
+        // attributes, pAttributeSizes[i] bytes per light for attribute i
+        void Reset( unsigned uCapacity, const unsigned* pAttributeSizes, unsigned uNumAttributes );
+
+        // Returns CPU_INVALID_LIGHT_HANDLE when the pool is full. The attributes of the
+        // new light are undefined until they are set.
+        CPULightHandle Add();
+
+        // The last light moves into the removed light's place, so its dense index changes
+        bool Remove( CPULightHandle Handle );
+
+        bool IsValid( CPULightHandle Handle ) const;
+
+        // pData points to GetAttributeSize(uAttribute) bytes
+        void Set( CPULightHandle Handle, unsigned uAttribute, const void* pData );
+        const void* Get( CPULightHandle Handle, unsigned uAttribute ) const;
+
+        unsigned GetCount() const { return m_uCount; }
+        unsigned GetCapacity() const { return m_uCapacity; }
+        unsigned GetNumAttributes() const { return m_uNumAttributes; }
+        unsigned GetAttributeSize( unsigned uAttribute ) const { return m_AttributeSizes[uAttribute]; }
+
+        // Where a light is in the attribute arrays, and which light is there
+        unsigned GetDenseIndex( CPULightHandle Handle ) const;
+        CPULightHandle GetHandle( unsigned uDenseIndex ) const;
+
+        // The attribute array, GetCount() elements
+        const void* GetData( unsigned uAttribute ) const { return m_Data[uAttribute].empty() ? NULL : &m_Data[uAttribute][0]; }
+
+        // The elements of an attribute written since the last ClearDirtyRanges, as sorted
+        // ranges inside [0, GetCount()). Dirty runs less than uMaxGap clean elements apart
+        // are merged into one range, since uploading a few clean elements costs less than
+        // another upload call.
+        void GetDirtyRanges( unsigned uAttribute, unsigned uMaxGap, std::vector<CPULightPoolRange>& Ranges ) const;
+
+        // Number of dirty elements of an attribute (including any past GetCount())
+        unsigned GetNumDirty( unsigned uAttribute ) const { return m_uNumDirty[uAttribute]; }
+
+        // Call after the dirty ranges of every attribute have been uploaded
+        void ClearDirtyRanges();
+
+        // Mark every element dirty, e.g. after the buffers were recreated
+        void MarkAllDirty();
+
+    private:
+        void MarkDirty( unsigned uAttribute, unsigned uDenseIndex );
+
+        unsigned                    m_uCapacity;
+        unsigned                    m_uCount;
+        unsigned                    m_uNumAttributes;
+        unsigned                    m_AttributeSizes[MAX_ATTRIBUTES];
+
+        // the attribute arrays, and a bit per element of each, set if the element is dirty
+        std::vector<unsigned char>  m_Data[MAX_ATTRIBUTES];
+        std::vector<unsigned>       m_DirtyBits[MAX_ATTRIBUTES];
+        unsigned                    m_uNumDirty[MAX_ATTRIBUTES];
+
+        // the range of dirty bit words that can be nonzero (empty if the first is past the last)
+        unsigned                    m_uFirstDirtyWord;
+        unsigned                    m_uLastDirtyWord;
+
+        // handle slot to dense index (CPU_INVALID_LIGHT_HANDLE if free) and generation,
+        // dense index to slot, and the free slots
+        std::vector<unsigned>       m_SlotToDense;
+        std::vector<unsigned>       m_SlotGeneration;
+        std::vector<unsigned>       m_DenseToSlot;
+        std::vector<unsigned>       m_FreeSlots;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
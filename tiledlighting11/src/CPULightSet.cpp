@@ -0,0 +1,424 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPULightSet.cpp
+//
+// Light set files: writing, parsing and memory mapping.
+//--------------------------------------------------------------------------------------
+
+#include "CPULightSet.h"
+#include "CPUSpotLightCulling.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace TiledLighting11
+{
+    // bytes per light in each section
+    static const unsigned g_SectionElementSizes[CPU_LIGHT_SET_NUM_SECTIONS] =
+    {
+        sizeof(CPUFloat4), sizeof(unsigned), 6*sizeof(CPUMatrix), 6*sizeof(CPUMatrix),
+        sizeof(CPUFloat4), sizeof(unsigned), sizeof(CPUSpotParams), sizeof(CPUMatrix), sizeof(CPUMatrix), sizeof(CPUMatrix),
+    };
+
+    static bool IsSpotLightSection( unsigned uSection ) { return uSection >= CPU_LIGHT_SET_SPOT_CENTER_AND_RADIUS; }
+
+    static bool IsShadowSection( unsigned uSection )
+    {
+        return uSection == CPU_LIGHT_SET_POINT_SHADOW_VIEW_PROJ || uSection == CPU_LIGHT_SET_POINT_SHADOW_VIEW_PROJ_INV ||
+            uSection == CPU_LIGHT_SET_SPOT_SHADOW_VIEW_PROJ || uSection == CPU_LIGHT_SET_SPOT_SHADOW_VIEW_PROJ_INV;
+    }
+
+    // the member of the desc that points to a section
+    static const void** GetSectionPointer( CPULightSetDesc& Desc, unsigned uSection )
+    {
+        switch( uSection )
+        {
+        case CPU_LIGHT_SET_POINT_CENTER_AND_RADIUS:     return (const void**)&Desc.pPointLightCenterAndRadius;
+        case CPU_LIGHT_SET_POINT_COLOR:                 return (const void**)&Desc.pPointLightColor;
+        case CPU_LIGHT_SET_POINT_SHADOW_VIEW_PROJ:      return (const void**)&Desc.pPointLightShadowViewProj;
+        case CPU_LIGHT_SET_POINT_SHADOW_VIEW_PROJ_INV:  return (const void**)&Desc.pPointLightShadowViewProjInv;
+        case CPU_LIGHT_SET_SPOT_CENTER_AND_RADIUS:      return (const void**)&Desc.pSpotLightCenterAndRadius;
+        case CPU_LIGHT_SET_SPOT_COLOR:                  return (const void**)&Desc.pSpotLightColor;
+        case CPU_LIGHT_SET_SPOT_PARAMS:                 return (const void**)&Desc.pSpotParams;
+        case CPU_LIGHT_SET_SPOT_MATRICES:               return (const void**)&Desc.pSpotMatrices;
+        case CPU_LIGHT_SET_SPOT_SHADOW_VIEW_PROJ:       return (const void**)&Desc.pSpotLightShadowViewProj;
+        default:                                        return (const void**)&Desc.pSpotLightShadowViewProjInv;
+        }
+    }
+
+    static unsigned long long AlignSize( unsigned long long uSize )
+    {
+        return ( uSize + CPU_LIGHT_SET_ALIGNMENT - 1 ) & ~(unsigned long long)( CPU_LIGHT_SET_ALIGNMENT - 1 );
+    }
+
+    // finite, and not NaN
+    static bool IsFinite( float f )
+    {
+        return fabsf( f ) <= FLT_MAX;
+    }
+
+    static bool IsValidSphere( const CPUFloat4& c )
+    {
+        return IsFinite( c.x ) && IsFinite( c.y ) && IsFinite( c.z ) && IsFinite( c.w ) && c.w > 0.0f;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // For reports
+    //--------------------------------------------------------------------------------------
+    const char* GetCPULightSetResultName( CPULightSetResult Result )
+    {
+        switch( Result )
+        {
+        case CPU_LIGHT_SET_OK:          return "ok";
+        case CPU_LIGHT_SET_CANNOT_OPEN: return "cannot open";
+        case CPU_LIGHT_SET_BAD_HEADER:  return "bad header";
+        case CPU_LIGHT_SET_BAD_VERSION: return "bad version";
+        case CPU_LIGHT_SET_BAD_SECTION: return "bad section";
+        case CPU_LIGHT_SET_BAD_LIGHT:   return "bad light";
+        default:                        return "unknown";
+        }
+    }
+
+    void ClearCPULightSetDesc( CPULightSetDesc& Desc )
+    {
+        memset( &Desc, 0, sizeof(Desc) );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The header, then the sections in order, each padded to the alignment
+    //--------------------------------------------------------------------------------------
+    CPULightSetResult WriteCPULightSet( const char* pPath, const CPULightSetDesc& Desc )
+    {
+        CPULightSetDesc Sections = Desc;
+        const bool bShadowMatrices = ( Desc.pPointLightShadowViewProj != NULL || Desc.pSpotLightShadowViewProj != NULL );
+
+        CPULightSetHeader Header;
+        memset( &Header, 0, sizeof(Header) );
+        Header.uMagic = CPU_LIGHT_SET_MAGIC;
+        Header.uVersion = CPU_LIGHT_SET_VERSION;
+        Header.uHeaderSize = sizeof(CPULightSetHeader);
+        Header.uFlags = bShadowMatrices ? CPU_LIGHT_SET_SHADOW_MATRICES : 0;
+        Header.uNumPointLights = Desc.uNumPointLights;
+        Header.uNumSpotLights = Desc.uNumSpotLights;
+
+        unsigned long long uOffset = AlignSize( sizeof(CPULightSetHeader) );
+        for( unsigned i = 0; i < CPU_LIGHT_SET_NUM_SECTIONS; i++ )
+        {
+            if( IsShadowSection( i ) && !bShadowMatrices )
+            {
+                continue;
+            }
+
+            const unsigned uNumLights = IsSpotLightSection( i ) ? Desc.uNumSpotLights : Desc.uNumPointLights;
+            const unsigned long long uSize = (unsigned long long)uNumLights*g_SectionElementSizes[i];
+            if( uSize == 0 )
+            {
+                continue;
+            }
+            if( *GetSectionPointer( Sections, i ) == NULL )
+            {
+                return CPU_LIGHT_SET_BAD_SECTION;
+            }
+
+            Header.Sections[i].uOffset = (unsigned)uOffset;
+            Header.Sections[i].uSize = (unsigned)uSize;
+            uOffset = AlignSize( uOffset + uSize );
+        }
+
+        // the offsets and sizes are 32-bit
+        if( uOffset > 0xFFFFFFFFull )
+        {
+            return CPU_LIGHT_SET_BAD_SECTION;
+        }
+        Header.uFileSize = (unsigned)uOffset;
+
+        FILE* pFile = NULL;
+#if defined(_MSC_VER)
+        if( fopen_s( &pFile, pPath, "wb" ) != 0 )
+        {
+            pFile = NULL;
+        }
+#else
+        pFile = fopen( pPath, "wb" );
+#endif
+        if( pFile == NULL )
+        {
+            return CPU_LIGHT_SET_CANNOT_OPEN;
+        }
+
+        static const unsigned char Padding[CPU_LIGHT_SET_ALIGNMENT] = { 0 };
+        bool bWritten = fwrite( &Header, sizeof(Header), 1, pFile ) == 1;
+        unsigned long long uWritten = sizeof(Header);
+        for( unsigned i = 0; i < CPU_LIGHT_SET_NUM_SECTIONS && bWritten; i++ )
+        {
+            if( Header.Sections[i].uSize == 0 )
+            {
+                continue;
+            }
+
+            const size_t uPadding = (size_t)( Header.Sections[i].uOffset - uWritten );
+            bWritten = ( uPadding == 0 || fwrite( Padding, uPadding, 1, pFile ) == 1 ) &&
+                fwrite( *GetSectionPointer( Sections, i ), Header.Sections[i].uSize, 1, pFile ) == 1;
+            uWritten = Header.Sections[i].uOffset + Header.Sections[i].uSize;
+        }
+
+        const size_t uPadding = (size_t)( Header.uFileSize - uWritten );
+        bWritten = bWritten && ( uPadding == 0 || fwrite( Padding, uPadding, 1, pFile ) == 1 );
+        bWritten = ( fclose( pFile ) == 0 ) && bWritten;
+
+        return bWritten ? CPU_LIGHT_SET_OK : CPU_LIGHT_SET_CANNOT_OPEN;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Validate in place, without copying anything
+    //--------------------------------------------------------------------------------------
+    CPULightSetResult ParseCPULightSet( const void* pData, size_t uSize, bool bCheckLights, CPULightSetDesc& Desc )
+    {
+        ClearCPULightSetDesc( Desc );
+
+        const CPULightSetHeader* pHeader = (const CPULightSetHeader*)pData;
+        if( pData == NULL || ( (size_t)pData & ( CPU_LIGHT_SET_ALIGNMENT - 1 ) ) != 0 || uSize < sizeof(CPULightSetHeader) ||
+            pHeader->uMagic != CPU_LIGHT_SET_MAGIC )
+        {
+            return CPU_LIGHT_SET_BAD_HEADER;
+        }
+        if( pHeader->uVersion != CPU_LIGHT_SET_VERSION )
+        {
+            return CPU_LIGHT_SET_BAD_VERSION;
+        }
+        if( pHeader->uHeaderSize != sizeof(CPULightSetHeader) || ( pHeader->uFlags & ~CPU_LIGHT_SET_SHADOW_MATRICES ) != 0 ||
+            pHeader->uFileSize != uSize )
+        {
+            return CPU_LIGHT_SET_BAD_HEADER;
+        }
+
+        const bool bShadowMatrices = ( pHeader->uFlags & CPU_LIGHT_SET_SHADOW_MATRICES ) != 0;
+        for( unsigned i = 0; i < CPU_LIGHT_SET_NUM_SECTIONS; i++ )
+        {
+            const CPULightSetSectionEntry& Section = pHeader->Sections[i];
+            const unsigned uNumLights = IsSpotLightSection( i ) ? pHeader->uNumSpotLights : pHeader->uNumPointLights;
+            const bool bPresent = !IsShadowSection( i ) || bShadowMatrices;
+            const unsigned long long uExpectedSize = bPresent ? (unsigned long long)uNumLights*g_SectionElementSizes[i] : 0;
+
+            if( Section.uSize != uExpectedSize )
+            {
+                return CPU_LIGHT_SET_BAD_SECTION;
+            }
+            if( Section.uSize == 0 )
+            {
+                if( Section.uOffset != 0 )
+                {
+                    return CPU_LIGHT_SET_BAD_SECTION;
+                }
+                continue;
+            }
+
+            if( ( Section.uOffset & ( CPU_LIGHT_SET_ALIGNMENT - 1 ) ) != 0 || Section.uOffset < sizeof(CPULightSetHeader) ||
+                (unsigned long long)Section.uOffset + Section.uSize > uSize )
+            {
+                return CPU_LIGHT_SET_BAD_SECTION;
+            }
+
+            for( unsigned j = 0; j < i; j++ )
+            {
+                const CPULightSetSectionEntry& Other = pHeader->Sections[j];
+                if( Other.uSize != 0 && (unsigned long long)Section.uOffset < (unsigned long long)Other.uOffset + Other.uSize &&
+                    (unsigned long long)Other.uOffset < (unsigned long long)Section.uOffset + Section.uSize )
+                {
+                    return CPU_LIGHT_SET_BAD_SECTION;
+                }
+            }
+
+            *GetSectionPointer( Desc, i ) = (const unsigned char*)pData + Section.uOffset;
+        }
+
+        Desc.uNumPointLights = pHeader->uNumPointLights;
+        Desc.uNumSpotLights = pHeader->uNumSpotLights;
+
+        if( bCheckLights )
+        {
+            for( unsigned i = 0; i < Desc.uNumPointLights; i++ )
+            {
+                if( !IsValidSphere( Desc.pPointLightCenterAndRadius[i] ) )
+                {
+                    ClearCPULightSetDesc( Desc );
+                    return CPU_LIGHT_SET_BAD_LIGHT;
+                }
+            }
+
+            for( unsigned i = 0; i < Desc.uNumSpotLights; i++ )
+            {
+                // the cone angle is below 90 degrees, and the direction is not NaN
+                const CPUSpotParams& Params = Desc.pSpotParams[i];
+                const float fCosine = CPUConvertF16ToF32( Params.fCosineOfConeAngleAndLightDirZSign & 0x7FFF );
+                const float fFalloffRadius = CPUConvertF16ToF32( Params.fFalloffRadius );
+                if( !IsValidSphere( Desc.pSpotLightCenterAndRadius[i] ) || !( fCosine > 0.0f && fCosine <= 1.0f ) || !( fFalloffRadius > 0.0f ) ||
+                    !IsFinite( CPUConvertF16ToF32( Params.fLightDirX ) ) || !IsFinite( CPUConvertF16ToF32( Params.fLightDirY ) ) )
+                {
+                    ClearCPULightSetDesc( Desc );
+                    return CPU_LIGHT_SET_BAD_LIGHT;
+                }
+            }
+        }
+
+        return CPU_LIGHT_SET_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPULightSetFile::CPULightSetFile()
+        :m_pData(NULL)
+        ,m_uSize(0)
+#if defined(_WIN32)
+        ,m_hFile(INVALID_HANDLE_VALUE)
+        ,m_hMapping(NULL)
+#endif
+    {
+        ClearCPULightSetDesc( m_Desc );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPULightSetFile::~CPULightSetFile()
+    {
+        Close();
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Map the whole file read-only, and parse it in place
+    //--------------------------------------------------------------------------------------
+    CPULightSetResult CPULightSetFile::Open( const char* pPath, bool bCheckLights )
+    {
+        Close();
+
+#if defined(_WIN32)
+        m_hFile = CreateFileA( pPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+        LARGE_INTEGER FileSize;
+        if( m_hFile == INVALID_HANDLE_VALUE || !GetFileSizeEx( m_hFile, &FileSize ) )
+        {
+            Close();
+            return CPU_LIGHT_SET_CANNOT_OPEN;
+        }
+        if( FileSize.QuadPart < (LONGLONG)sizeof(CPULightSetHeader) || FileSize.QuadPart > 0xFFFFFFFFll )
+        {
+            Close();
+            return CPU_LIGHT_SET_BAD_HEADER;
+        }
+
+        m_hMapping = CreateFileMappingA( m_hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+        m_pData = m_hMapping ? MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+        m_uSize = (size_t)FileSize.QuadPart;
+#else
+        const int nFile = open( pPath, O_RDONLY );
+        struct stat FileStat;
+        if( nFile < 0 || fstat( nFile, &FileStat ) != 0 )
+        {
+            if( nFile >= 0 ) close( nFile );
+            return CPU_LIGHT_SET_CANNOT_OPEN;
+        }
+        if( FileStat.st_size < (off_t)sizeof(CPULightSetHeader) || (unsigned long long)FileStat.st_size > 0xFFFFFFFFull )
+        {
+            close( nFile );
+            return CPU_LIGHT_SET_BAD_HEADER;
+        }
+
+        // the mapping stays valid after the descriptor is closed
+        void* pMapping = mmap( NULL, (size_t)FileStat.st_size, PROT_READ, MAP_PRIVATE, nFile, 0 );
+        close( nFile );
+        m_pData = ( pMapping != MAP_FAILED ) ? pMapping : NULL;
+        m_uSize = (size_t)FileStat.st_size;
+#endif
+
+        if( m_pData == NULL )
+        {
+            Close();
+            return CPU_LIGHT_SET_CANNOT_OPEN;
+        }
+
+        const CPULightSetResult Result = ParseCPULightSet( m_pData, m_uSize, bCheckLights, m_Desc );
+        if( Result != CPU_LIGHT_SET_OK )
+        {
+            Close();
+        }
+        return Result;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Unmap, after which the desc no longer points anywhere
+    //--------------------------------------------------------------------------------------
+    void CPULightSetFile::Close()
+    {
+#if defined(_WIN32)
+        if( m_pData != NULL )
+        {
+            UnmapViewOfFile( m_pData );
+        }
+        if( m_hMapping != NULL )
+        {
+            CloseHandle( m_hMapping );
+        }
+        if( m_hFile != INVALID_HANDLE_VALUE )
+        {
+            CloseHandle( m_hFile );
+        }
+        m_hMapping = NULL;
+        m_hFile = INVALID_HANDLE_VALUE;
+#else
+        if( m_pData != NULL )
+        {
+            munmap( (void*)m_pData, m_uSize );
+        }
+#endif
+
+        m_pData = NULL;
+        m_uSize = 0;
+        ClearCPULightSetDesc( m_Desc );
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPULightSet.h
+//
+// A binary file format for a set of point and spot lights, laid out so that it can be
+// memory-mapped and used in place: a header, then one 16-byte aligned section per light
+// attribute, each in the layout of the light buffer it fills (CPUFloat4 center and radius,
+// R8G8B8A8_UNORM color, CPUSpotParams, CPUMatrix). The shadow matrices of shadow-casting
+// lights are optional. All values are little-endian; a big-endian host sees a bad magic
+// number and rejects the file. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stddef.h>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    static const unsigned CPU_LIGHT_SET_MAGIC = 0x534C4C54;     // "TLLS"
+    static const unsigned CPU_LIGHT_SET_VERSION = 1;
+    static const unsigned CPU_LIGHT_SET_ALIGNMENT = 16;
+
+    // the header flags
+    static const unsigned CPU_LIGHT_SET_SHADOW_MATRICES = 0x1;  // the four shadow sections are present
+
+    enum CPULightSetSection
+    {
+        CPU_LIGHT_SET_POINT_CENTER_AND_RADIUS = 0,  // CPUFloat4 per point light
+        CPU_LIGHT_SET_POINT_COLOR,                  // R8G8B8A8_UNORM per point light
+        CPU_LIGHT_SET_POINT_SHADOW_VIEW_PROJ,       // six transposed view-projection matrices (one per cube face) per point light
+        CPU_LIGHT_SET_POINT_SHADOW_VIEW_PROJ_INV,   // and their transposed inverses
+        CPU_LIGHT_SET_SPOT_CENTER_AND_RADIUS,       // CPUFloat4 per spot light, the bounding sphere of the cone
+        CPU_LIGHT_SET_SPOT_COLOR,                   // R8G8B8A8_UNORM per spot light
+        CPU_LIGHT_SET_SPOT_PARAMS,                  // CPUSpotParams per spot light
+        CPU_LIGHT_SET_SPOT_MATRICES,                // the transposed cone rotation for debug drawing, per spot light
+        CPU_LIGHT_SET_SPOT_SHADOW_VIEW_PROJ,        // transposed view-projection matrix per spot light
+        CPU_LIGHT_SET_SPOT_SHADOW_VIEW_PROJ_INV,    // and its transposed inverse
+        CPU_LIGHT_SET_NUM_SECTIONS
+    };
+
+    enum CPULightSetResult
+    {
+        CPU_LIGHT_SET_OK = 0,
+        CPU_LIGHT_SET_CANNOT_OPEN,      // the file cannot be opened, mapped or written
+        CPU_LIGHT_SET_BAD_HEADER,       // too small, wrong magic number or header size, unknown flags
+        CPU_LIGHT_SET_BAD_VERSION,
+        CPU_LIGHT_SET_BAD_SECTION,      // a section is misaligned, the wrong size, overlaps another or runs past the end
+        CPU_LIGHT_SET_BAD_LIGHT,        // a light is not finite, has no radius, or a bad cone angle
+        CPU_LIGHT_SET_NUM_RESULTS
+    };
+
+    const char* GetCPULightSetResultName( CPULightSetResult Result );
+
+    // Byte offset from the start of the file, and size
+    struct CPULightSetSectionEntry
+    {
+        unsigned    uOffset;
+        unsigned    uSize;
+    };
+
+    struct CPULightSetHeader
+    {
+        unsigned                    uMagic;
+        unsigned                    uVersion;
+        unsigned                    uHeaderSize;        // sizeof(CPULightSetHeader)
+        unsigned                    uFlags;
+        unsigned                    uNumPointLights;
+        unsigned                    uNumSpotLights;
+        unsigned                    uFileSize;
+        unsigned                    uReserved;
+        CPULightSetSectionEntry     Sections[CPU_LIGHT_SET_NUM_SECTIONS];   // absent sections are all zero
+    };
+
+    // The lights to write, or the lights of a parsed file (pointing into its memory).
+    // The shadow matrices are either all NULL, or all set.
+    struct CPULightSetDesc
+    {
+        unsigned                uNumPointLights;
+        const CPUFloat4*        pPointLightCenterAndRadius;
+        const unsigned*         pPointLightColor;
+        const CPUMatrix*        pPointLightShadowViewProj;      // 6 per light
+        const CPUMatrix*        pPointLightShadowViewProjInv;   // 6 per light
+
+        unsigned                uNumSpotLights;
+        const CPUFloat4*        pSpotLightCenterAndRadius;
+        const unsigned*         pSpotLightColor;
+        const CPUSpotParams*    pSpotParams;
+        const CPUMatrix*        pSpotMatrices;
+        const CPUMatrix*        pSpotLightShadowViewProj;
+        const CPUMatrix*        pSpotLightShadowViewProjInv;
+    };
+
+    // Everything zero, and no lights
+    void ClearCPULightSetDesc( CPULightSetDesc& Desc );
+
+    CPULightSetResult WriteCPULightSet( const char* pPath, const CPULightSetDesc& Desc );
+
+    // Check the header and the sections of a file in memory (pData must be 16-byte aligned),
+    // and point Desc into it. The header checks are O(1); bCheckLights also reads every
+    // light, which touches every page of a mapped file.
+    CPULightSetResult ParseCPULightSet( const void* pData, size_t uSize, bool bCheckLights, CPULightSetDesc& Desc );
+
+    // A read-only memory mapping of a light set file
+    class CPULightSetFile
+    {
+    public:
+        // Constructor / destructor
+        CPULightSetFile();
+        ~CPULightSetFile();
+
+        CPULightSetResult Open( const char* pPath, bool bCheckLights );
+        void Close();
+
+        bool IsOpen() const { return m_pData != NULL; }
+        const void* GetData() const { return m_pData; }
+        size_t GetSize() const { return m_uSize; }
+
+        // Valid while the file is open
+        const CPULightSetDesc& GetDesc() const { return m_Desc; }
+
+    private:
+        // not copyable
+        CPULightSetFile( const CPULightSetFile& );
+        CPULightSetFile& operator=( const CPULightSetFile& );
+
+        const void*         m_pData;
+        size_t              m_uSize;
+        CPULightSetDesc     m_Desc;
+
+#if defined(_WIN32)
+        void*               m_hFile;
+        void*               m_hMapping;
+#endif
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,303 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPUQuantizedLights.cpp
+//
+// Quantized light records.
+//--------------------------------------------------------------------------------------
+
+#include "CPUQuantizedLights.h"
+#include "CPUSpotLightCulling.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // the largest RGB9E5 value, 511/512 * 2^16
+    static const float RGB9E5_MAX_VALUE = 65408.0f;
+
+    // the largest half
+    static const float HALF_MAX_VALUE = 65504.0f;
+
+    // to the nearest half, or to the next one up, for positive values
+    static unsigned short ConvertF32ToF16( float fValue, bool bRoundUp )
+    {
+        fValue = std::min( std::max( fValue, 0.0f ), HALF_MAX_VALUE );
+
+        // CPUConvertF32ToF16 truncates
+        unsigned short uHalf = CPUConvertF32ToF16( fValue );
+        const float fLow = CPUConvertF16ToF32( uHalf );
+        if( fLow < fValue )
+        {
+            const float fHigh = CPUConvertF16ToF32( (unsigned short)( uHalf + 1 ) );
+            if( bRoundUp || fHigh - fValue < fValue - fLow )
+            {
+                uHalf++;
+            }
+        }
+
+        return uHalf;
+    }
+
+    // in double, so that the step is the nearest one
+    static unsigned QuantizeCoordinate( float fValue, float fMin, float fScale )
+    {
+        const double fQuantized = ( fScale > 0.0f ) ? ( (double)fValue - fMin ) / fScale + 0.5 : 0.0;
+        return (unsigned)std::min( std::max( fQuantized, 0.0 ), 65535.0 );
+    }
+
+    // 2^nExponent, for nExponent in [-126,127]
+    static float GetPowerOfTwo( int nExponent )
+    {
+        const unsigned uBits = (unsigned)( nExponent + 127 ) << 23;
+        float fValue;
+        memcpy( &fValue, &uBits, sizeof(fValue) );
+        return fValue;
+    }
+
+    static float UnpackSnorm16( unsigned uValue )
+    {
+        return std::max( (float)(short)(unsigned short)uValue / 32767.0f, -1.0f );
+    }
+
+    static unsigned PackSnorm16( float fValue )
+    {
+        const float fClamped = std::min( std::max( fValue, -1.0f ), 1.0f );
+        return (unsigned short)(short)floorf( fClamped*32767.0f + 0.5f );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Center, and the radius rounded up to hold the original sphere
+    //--------------------------------------------------------------------------------------
+    static void QuantizeCenterAndRadius( const CPUQuantizedLightBounds& Bounds, const CPUFloat4& CenterAndRadius, unsigned& uCenterXY, unsigned& uCenterZAndRadius )
+    {
+        const float Center[3] = { CenterAndRadius.x, CenterAndRadius.y, CenterAndRadius.z };
+
+        unsigned Quantized[3];
+        float fDistanceSquared = 0.0f;
+        for( int i = 0; i < 3; i++ )
+        {
+            Quantized[i] = QuantizeCoordinate( Center[i], Bounds.Min[i], Bounds.Scale[i] );
+            const float fError = Bounds.Min[i] + Quantized[i]*Bounds.Scale[i] - Center[i];
+            fDistanceSquared += fError*fError;
+        }
+
+        // a little extra for the rounding of the distance and the sum
+        const float fRadius = ( CenterAndRadius.w + sqrtf( fDistanceSquared ) )*( 1.0f + 1.0f / 1048576.0f );
+
+        uCenterXY = Quantized[0] | ( Quantized[1] << 16 );
+        uCenterZAndRadius = Quantized[2] | ( (unsigned)ConvertF32ToF16( fRadius, true ) << 16 );
+    }
+
+    static CPUFloat4 DequantizeCenterAndRadius( const CPUQuantizedLightBounds& Bounds, unsigned uCenterXY, unsigned uCenterZAndRadius )
+    {
+        CPUFloat4 CenterAndRadius;
+        CenterAndRadius.x = Bounds.Min[0] + ( uCenterXY & 0xFFFF )*Bounds.Scale[0];
+        CenterAndRadius.y = Bounds.Min[1] + ( uCenterXY >> 16 )*Bounds.Scale[1];
+        CenterAndRadius.z = Bounds.Min[2] + ( uCenterZAndRadius & 0xFFFF )*Bounds.Scale[2];
+        CenterAndRadius.w = CPUConvertF16ToF32( (unsigned short)( uCenterZAndRadius >> 16 ) );
+        return CenterAndRadius;
+    }
+
+    // R8G8B8A8_UNORM to RGB9E5
+    static unsigned QuantizeColor( unsigned uColor )
+    {
+        const float RGB[3] = { ( uColor & 0xFF ) / 255.0f, ( ( uColor >> 8 ) & 0xFF ) / 255.0f, ( ( uColor >> 16 ) & 0xFF ) / 255.0f };
+        return CPUPackRGB9E5( RGB );
+    }
+
+    static CPUFloat4 DequantizeColor( unsigned uColor )
+    {
+        float RGB[3];
+        CPUUnpackRGB9E5( uColor, RGB );
+
+        CPUFloat4 Color = { RGB[0], RGB[1], RGB[2], 0.0f };
+        return Color;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Bounds
+    //--------------------------------------------------------------------------------------
+    void InitCPUQuantizedLightBounds( const float BBoxMin[3], const float BBoxMax[3], CPUQuantizedLightBounds& Bounds )
+    {
+        for( int i = 0; i < 3; i++ )
+        {
+            Bounds.Min[i] = BBoxMin[i];
+            Bounds.Scale[i] = std::max( BBoxMax[i] - BBoxMin[i], 0.0f ) / 65535.0f;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // RGB9E5, as DXGI_FORMAT_R9G9B9E5_SHAREDEXP: value = mantissa*2^(exponent - 15 - 9)
+    //--------------------------------------------------------------------------------------
+    unsigned CPUPackRGB9E5( const float RGB[3] )
+    {
+        float Clamped[3];
+        for( int i = 0; i < 3; i++ )
+        {
+            // negative values and NaNs go to 0
+            Clamped[i] = ( RGB[i] > 0.0f ) ? std::min( RGB[i], RGB9E5_MAX_VALUE ) : 0.0f;
+        }
+
+        // the shared exponent puts the largest channel's mantissa in [256,511], when it can
+        const float fMax = std::max( Clamped[0], std::max( Clamped[1], Clamped[2] ) );
+        int nExponent;
+        frexpf( fMax, &nExponent );
+        int nSharedExponent = std::max( nExponent + 15, 0 );
+
+        float fScale = GetPowerOfTwo( 24 - nSharedExponent );
+        if( (unsigned)( fMax*fScale + 0.5f ) == 512 )
+        {
+            nSharedExponent++;
+            fScale *= 0.5f;
+        }
+
+        unsigned uPacked = (unsigned)nSharedExponent << 27;
+        for( int i = 0; i < 3; i++ )
+        {
+            uPacked |= std::min( (unsigned)( Clamped[i]*fScale + 0.5f ), 511u ) << ( 9*i );
+        }
+
+        return uPacked;
+    }
+
+    void CPUUnpackRGB9E5( unsigned uPacked, float RGB[3] )
+    {
+        const float fScale = GetPowerOfTwo( (int)( uPacked >> 27 ) - 24 );
+        for( int i = 0; i < 3; i++ )
+        {
+            RGB[i] = ( ( uPacked >> ( 9*i ) ) & 0x1FF )*fScale;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Octahedral unit vectors: the direction is projected onto the octahedron |x|+|y|+|z| = 1,
+    // and the lower half is folded over the upper, into the [-1,1] square
+    //--------------------------------------------------------------------------------------
+    unsigned CPUPackOctahedral( const float Dir[3] )
+    {
+        const float fL1Norm = fabsf( Dir[0] ) + fabsf( Dir[1] ) + fabsf( Dir[2] );
+        float u = ( fL1Norm > 0.0f ) ? Dir[0] / fL1Norm : 0.0f;
+        float v = ( fL1Norm > 0.0f ) ? Dir[1] / fL1Norm : 0.0f;
+
+        if( Dir[2] < 0.0f )
+        {
+            const float fFoldedU = ( 1.0f - fabsf( v ) )*( u >= 0.0f ? 1.0f : -1.0f );
+            const float fFoldedV = ( 1.0f - fabsf( u ) )*( v >= 0.0f ? 1.0f : -1.0f );
+            u = fFoldedU;
+            v = fFoldedV;
+        }
+
+        return PackSnorm16( u ) | ( PackSnorm16( v ) << 16 );
+    }
+
+    void CPUUnpackOctahedral( unsigned uPacked, float Dir[3] )
+    {
+        float x = UnpackSnorm16( uPacked & 0xFFFF );
+        float y = UnpackSnorm16( uPacked >> 16 );
+        const float z = 1.0f - fabsf( x ) - fabsf( y );
+
+        // unfold the lower half
+        const float t = std::max( -z, 0.0f );
+        x += ( x >= 0.0f ) ? -t : t;
+        y += ( y >= 0.0f ) ? -t : t;
+
+        const float fInvLength = 1.0f / sqrtf( x*x + y*y + z*z );
+        Dir[0] = x*fInvLength;
+        Dir[1] = y*fInvLength;
+        Dir[2] = z*fInvLength;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Quantize
+    //--------------------------------------------------------------------------------------
+    void QuantizeCPUPointLights( const CPUQuantizedLightBounds& Bounds, const CPUFloat4* pCenterAndRadius, const unsigned* pColor, unsigned uCount, CPUQuantizedPointLight* pLights )
+    {
+        for( unsigned i = 0; i < uCount; i++ )
+        {
+            QuantizeCenterAndRadius( Bounds, pCenterAndRadius[i], pLights[i].uCenterXY, pLights[i].uCenterZAndRadius );
+            pLights[i].uColor = QuantizeColor( pColor[i] );
+        }
+    }
+
+    void QuantizeCPUSpotLights( const CPUQuantizedLightBounds& Bounds, const CPUFloat4* pCenterAndRadius, const unsigned* pColor, const CPUSpotParams* pSpotParams, unsigned uCount, CPUQuantizedSpotLight* pLights )
+    {
+        for( unsigned i = 0; i < uCount; i++ )
+        {
+            QuantizeCenterAndRadius( Bounds, pCenterAndRadius[i], pLights[i].uCenterXY, pLights[i].uCenterZAndRadius );
+            pLights[i].uColor = QuantizeColor( pColor[i] );
+
+            // the direction as DoSpotLighting reconstructs it
+            const CPUSpotParams& Params = pSpotParams[i];
+            const float fCosineAndSign = CPUConvertF16ToF32( Params.fCosineOfConeAngleAndLightDirZSign );
+            float Dir[3];
+            Dir[0] = CPUConvertF16ToF32( Params.fLightDirX );
+            Dir[1] = CPUConvertF16ToF32( Params.fLightDirY );
+            Dir[2] = sqrtf( std::max( 1.0f - Dir[0]*Dir[0] - Dir[1]*Dir[1], 0.0f ) );
+            Dir[2] = ( fCosineAndSign > 0.0f ) ? Dir[2] : -Dir[2];
+
+            pLights[i].uDirection = CPUPackOctahedral( Dir );
+            pLights[i].uConeAndFalloff = ConvertF32ToF16( fabsf( fCosineAndSign ), false ) |
+                ( (unsigned)ConvertF32ToF16( CPUConvertF16ToF32( Params.fFalloffRadius ), true ) << 16 );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Dequantize
+    //--------------------------------------------------------------------------------------
+    void DequantizeCPUPointLights( const CPUQuantizedLightBounds& Bounds, const CPUQuantizedPointLight* pLights, unsigned uCount, CPUFloat4* pCenterAndRadius, CPUFloat4* pColor )
+    {
+        for( unsigned i = 0; i < uCount; i++ )
+        {
+            pCenterAndRadius[i] = DequantizeCenterAndRadius( Bounds, pLights[i].uCenterXY, pLights[i].uCenterZAndRadius );
+            pColor[i] = DequantizeColor( pLights[i].uColor );
+        }
+    }
+
+    void DequantizeCPUSpotLights( const CPUQuantizedLightBounds& Bounds, const CPUQuantizedSpotLight* pLights, unsigned uCount, CPUFloat4* pCenterAndRadius, CPUFloat4* pColor, CPUFloat4* pSpotParams )
+    {
+        for( unsigned i = 0; i < uCount; i++ )
+        {
+            pCenterAndRadius[i] = DequantizeCenterAndRadius( Bounds, pLights[i].uCenterXY, pLights[i].uCenterZAndRadius );
+            pColor[i] = DequantizeColor( pLights[i].uColor );
+
+            float Dir[3];
+            CPUUnpackOctahedral( pLights[i].uDirection, Dir );
+            const float fCosine = CPUConvertF16ToF32( (unsigned short)( pLights[i].uConeAndFalloff & 0xFFFF ) );
+
+            // the sign of z goes in the cone angle cosine, as in CPUSpotParams
+            pSpotParams[i].x = Dir[0];
+            pSpotParams[i].y = Dir[1];
+            pSpotParams[i].z = ( Dir[2] < 0.0f ) ? -fCosine : fCosine;
+            pSpotParams[i].w = CPUConvertF16ToF32( (unsigned short)( pLights[i].uConeAndFalloff >> 16 ) );
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,101 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPUQuantizedLights.h
+//
+// A compact, quantized record per light, to lift the light count past MAX_NUM_LIGHTS
+// without the memory and bandwidth of the float light buffers:
+//   - the center is three 16-bit unorms over the scene bounds (CalculateSceneMinMax)
+//   - the radius (and a spot light's falloff radius) is a half
+//   - the color is RGB9E5, a 9-bit mantissa per channel with a shared 5-bit exponent,
+//     so it is not limited to [0,1] like R8G8B8A8_UNORM
+//   - a spot light's direction is octahedral, two 16-bit snorms
+// A point light is 12 bytes (against 20 for CPUFloat4 plus R8G8B8A8_UNORM), and a spot
+// light is 20 bytes (against 28 with CPUSpotParams). The decoders return what the float
+// buffers hold, so DoLighting and DoSpotLighting are unchanged; the HLSL decoders are in
+// Shaders/LightingCommonHeader.h. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    // Decoded center = Min + quantized center*Scale
+    struct CPUQuantizedLightBounds
+    {
+        float   Min[3];
+        float   Scale[3];
+    };
+
+    // StructuredBuffer<uint3> in HLSL
+    struct CPUQuantizedPointLight
+    {
+        unsigned    uCenterXY;          // x in the low 16 bits, y in the high
+        unsigned    uCenterZAndRadius;  // z in the low 16 bits, the half radius in the high
+        unsigned    uColor;             // RGB9E5
+    };
+
+    // StructuredBuffer<QuantizedSpotLight> in HLSL
+    struct CPUQuantizedSpotLight
+    {
+        unsigned    uCenterXY;          // the bounding sphere, as for a point light
+        unsigned    uCenterZAndRadius;
+        unsigned    uColor;
+        unsigned    uDirection;         // octahedral x in the low 16 bits, y in the high, as snorms
+        unsigned    uConeAndFalloff;    // the half cosine of the cone angle in the low 16 bits, the half falloff radius in the high
+    };
+
+    // Worst-case errors, besides those of the positions (half a Scale step per axis).
+    // The radius is rounded up past the position error, so that the decoded sphere holds
+    // the original one and culling stays conservative.
+    static const float CPU_QUANTIZED_COLOR_MAX_ERROR = 1.0f / 511.0f;          // of the brightest channel
+    static const float CPU_QUANTIZED_DIRECTION_MAX_ERROR = 0.0001f;            // radians
+    static const float CPU_QUANTIZED_CONE_MAX_ERROR = 1.0f / 2048.0f;          // relative
+    static const float CPU_QUANTIZED_FALLOFF_MAX_ERROR = 1.0f / 1024.0f;       // relative, rounded up
+
+    // The bounds must hold every light's center
+    void InitCPUQuantizedLightBounds( const float BBoxMin[3], const float BBoxMax[3], CPUQuantizedLightBounds& Bounds );
+
+    unsigned CPUPackRGB9E5( const float RGB[3] );
+    void CPUUnpackRGB9E5( unsigned uPacked, float RGB[3] );
+
+    unsigned CPUPackOctahedral( const float Dir[3] );
+    void CPUUnpackOctahedral( unsigned uPacked, float Dir[3] );
+
+    // From the light buffer layouts (R8G8B8A8_UNORM color)
+    void QuantizeCPUPointLights( const CPUQuantizedLightBounds& Bounds, const CPUFloat4* pCenterAndRadius, const unsigned* pColor, unsigned uCount, CPUQuantizedPointLight* pLights );
+    void QuantizeCPUSpotLights( const CPUQuantizedLightBounds& Bounds, const CPUFloat4* pCenterAndRadius, const unsigned* pColor, const CPUSpotParams* pSpotParams, unsigned uCount, CPUQuantizedSpotLight* pLights );
+
+    // To what DoLighting and DoSpotLighting read: the center and radius, the color in xyz
+    // (w is 0), and for spot lights the float4 of g_SpotLightBufferSpotParams
+    void DequantizeCPUPointLights( const CPUQuantizedLightBounds& Bounds, const CPUQuantizedPointLight* pLights, unsigned uCount, CPUFloat4* pCenterAndRadius, CPUFloat4* pColor );
+    void DequantizeCPUSpotLights( const CPUQuantizedLightBounds& Bounds, const CPUQuantizedSpotLight* pLights, unsigned uCount, CPUFloat4* pCenterAndRadius, CPUFloat4* pColor, CPUFloat4* pSpotParams );
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPUReadbackQueue.cpp
+//
+// Asynchronous GPU readbacks.
+//--------------------------------------------------------------------------------------
+
+#include "CPUReadbackQueue.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace TiledLighting11
+{
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUReadbackQueue::CPUReadbackQueue()
+        :m_pBackend(NULL)
+        ,m_uDataSize(0)
+        ,m_uFirst(0)
+        ,m_uNumInFlight(0)
+        ,m_uNumStale(0)
+        ,m_bHasResult(false)
+        ,m_uResultFrame(0)
+        ,m_uResultTag(0)
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUReadbackQueue::~CPUReadbackQueue()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Set up the ring. A new backend has nothing in flight.
+    //--------------------------------------------------------------------------------------
+    void CPUReadbackQueue::Init( CPUReadbackBackend* pBackend, unsigned uNumSlots, unsigned uDataSize )
+    {
+        assert( pBackend != NULL && uNumSlots > 0 );
+
+        m_pBackend = pBackend;
+        m_uDataSize = uDataSize;
+        m_Slots.assign( uNumSlots, Slot() );
+        m_Result.assign( ( uDataSize + 3 ) / 4, 0 );
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        m_uFirst = 0;
+        m_uNumInFlight = 0;
+        m_uNumStale = 0;
+        Reset();
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Forget the result. The requests in flight stay in the ring, so that no slot is copied
+    // to before its fence passes, but are thrown away when they complete.
+    //--------------------------------------------------------------------------------------
+    void CPUReadbackQueue::Reset()
+    {
+        m_uNumStale = m_uNumInFlight;
+        m_bHasResult = false;
+        m_uResultFrame = 0;
+        m_uResultTag = 0;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Start copying the data of a frame
+    //--------------------------------------------------------------------------------------
+    bool CPUReadbackQueue::Request( unsigned uFrame, unsigned uTag )
+    {
+        assert( m_pBackend != NULL );
+
+        m_Stats.uNumRequests++;
+
+        const unsigned uNumSlots = (unsigned)m_Slots.size();
+        if( m_uNumInFlight == uNumSlots )
+        {
+            m_Stats.uNumDropped++;
+            return false;
+        }
+
+        const unsigned uSlot = ( m_uFirst + m_uNumInFlight ) % uNumSlots;
+        m_pBackend->CopyToSlot( uSlot );
+        m_Slots[uSlot].uFrame = uFrame;
+        m_Slots[uSlot].uTag = uTag;
+        m_uNumInFlight++;
+
+        return true;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Collect the slots whose fences have passed. The GPU passes the fences in the order
+    // they were put down, so the first one that has not passed ends the search, and of the
+    // ones before it only the newest is read, unless it is stale.
+    //--------------------------------------------------------------------------------------
+    bool CPUReadbackQueue::Update( unsigned uFrame )
+    {
+        const unsigned uNumSlots = (unsigned)m_Slots.size();
+
+        unsigned uNumReady = 0;
+        while( uNumReady < m_uNumInFlight && m_pBackend->IsSlotReady( ( m_uFirst + uNumReady ) % uNumSlots ) )
+        {
+            uNumReady++;
+        }
+
+        if( uNumReady == 0 )
+        {
+            return false;
+        }
+
+        const unsigned uNumStale = uNumReady < m_uNumStale ? uNumReady : m_uNumStale;
+        const unsigned uSlot = ( m_uFirst + uNumReady - 1 ) % uNumSlots;
+        const bool bRead = ( uNumReady > uNumStale ) && m_pBackend->ReadSlot( uSlot, m_Result.empty() ? NULL : &m_Result[0], m_uDataSize );
+
+        m_Stats.uNumCompleted += uNumReady;
+        m_uFirst = ( m_uFirst + uNumReady ) % uNumSlots;
+        m_uNumInFlight -= uNumReady;
+        m_uNumStale -= uNumStale;
+
+        if( uNumReady == uNumStale )
+        {
+            return false;
+        }
+        else if( !bRead )
+        {
+            m_Stats.uNumFailed++;
+            return false;
+        }
+
+        const unsigned uLatency = uFrame - m_Slots[uSlot].uFrame;
+        m_Stats.uNumRead++;
+        m_Stats.uLastLatency = uLatency;
+        m_Stats.uMaxLatency = uLatency > m_Stats.uMaxLatency ? uLatency : m_Stats.uMaxLatency;
+        m_Stats.uTotalLatency += uLatency;
+
+        m_bHasResult = true;
+        m_uResultFrame = m_Slots[uSlot].uFrame;
+        m_uResultTag = m_Slots[uSlot].uTag;
+
+        return true;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
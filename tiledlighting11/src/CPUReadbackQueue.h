@@ -0,0 +1,152 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPUReadbackQueue.h
+//
+// Reading GPU results back without waiting for them. Each request copies the data into
+// the next of a ring of slots (staging buffers, say) and marks the copy with a fence;
+// later updates check the fences of the slots in flight, oldest first, and read the
+// newest one that has passed, so the results come back a frame or more late but the CPU
+// never stalls. If every slot is still in flight the request is dropped rather than
+// waited on. The copies, fences and reads are a backend's, so the queue logic can run
+// against a mock backend on the CPU (see CPUBenchmarkReadback.cpp). This file has no D3D or
+// DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+namespace TiledLighting11
+{
+    // enough for the GPU to run two or three frames behind without dropping requests
+    static const unsigned CPU_READBACK_DEFAULT_NUM_SLOTS = 3;
+
+    // The GPU side of a readback queue. The slots are used in ring order, and a slot is
+    // only copied to again after its fence has passed.
+    class CPUReadbackBackend
+    {
+    public:
+        virtual ~CPUReadbackBackend() {}
+
+        // Copy the data into slot uSlot and put a fence after the copy
+        virtual void CopyToSlot( unsigned uSlot ) = 0;
+
+        // Whether the fence of slot uSlot has passed, without waiting for it
+        virtual bool IsSlotReady( unsigned uSlot ) = 0;
+
+        // Read uDataSize bytes of slot uSlot, once it is ready
+        virtual bool ReadSlot( unsigned uSlot, void* pData, unsigned uDataSize ) = 0;
+    };
+
+    struct CPUReadbackStats
+    {
+        // requests made, and those dropped because every slot was in flight
+        unsigned            uNumRequests;
+        unsigned            uNumDropped;
+
+        // fences that passed, the slots read (only the newest of the ones that passed by
+        // the same update is read) and the reads that failed
+        unsigned            uNumCompleted;
+        unsigned            uNumRead;
+        unsigned            uNumFailed;
+
+        // frames from a request to the update that read it, for the last read, the most
+        // of any read and the sum over all of them
+        unsigned            uLastLatency;
+        unsigned            uMaxLatency;
+        unsigned long long  uTotalLatency;
+    };
+
+    class CPUReadbackQueue
+    {
+    public:
+        // Constructor / destructor
+        CPUReadbackQueue();
+        ~CPUReadbackQueue();
+
+        // uNumSlots slots of uDataSize bytes. Forgets the requests in flight and the result.
+        void Init( CPUReadbackBackend* pBackend, unsigned uNumSlots, unsigned uDataSize );
+
+        // Forget the result, and the results of the requests in flight, e.g. when the frame
+        // numbers start over. Their slots are still used until their fences pass.
+        void Reset();
+
+        // Copy the data of frame uFrame into the next slot. uTag is the caller's, kept with
+        // the request (what the frame had enabled, say). Returns false, without waiting, if
+        // every slot is still in flight.
+        bool Request( unsigned uFrame, unsigned uTag = 0 );
+
+        // Check the slots in flight at frame uFrame, and read the newest one that is ready.
+        // Returns true if there is a new result.
+        bool Update( unsigned uFrame );
+
+        bool HasResult() const { return m_bHasResult; }
+        unsigned GetNumInFlight() const { return m_uNumInFlight; }
+        unsigned GetNumSlots() const { return (unsigned)m_Slots.size(); }
+        unsigned GetDataSize() const { return m_uDataSize; }
+
+        // The last result read, and the frame and tag it was requested with
+        const void* GetResult() const { return m_Result.empty() ? NULL : &m_Result[0]; }
+        unsigned GetResultFrame() const { return m_uResultFrame; }
+        unsigned GetResultTag() const { return m_uResultTag; }
+
+        const CPUReadbackStats& GetStats() const { return m_Stats; }
+
+    private:
+        // not copyable
+        CPUReadbackQueue( const CPUReadbackQueue& );
+        CPUReadbackQueue& operator=( const CPUReadbackQueue& );
+
+        struct Slot
+        {
+            unsigned    uFrame;
+            unsigned    uTag;
+        };
+
+        CPUReadbackBackend*     m_pBackend;
+        unsigned                m_uDataSize;
+
+        // the ring: m_uNumInFlight slots from m_uFirst are waiting for their fences, and the
+        // first m_uNumStale of them were requested before the last Reset
+        std::vector<Slot>       m_Slots;
+        unsigned                m_uFirst;
+        unsigned                m_uNumInFlight;
+        unsigned                m_uNumStale;
+
+        // in 4-byte units, so that the result can be read as ints
+        std::vector<unsigned>   m_Result;
+        bool                    m_bHasResult;
+        unsigned                m_uResultFrame;
+        unsigned                m_uResultTag;
+
+        CPUReadbackStats        m_Stats;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
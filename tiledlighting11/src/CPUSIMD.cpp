@@ -0,0 +1,129 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUSIMD.cpp
+//
+// CPU feature detection for the CPU-side (headless) code paths of the TiledLighting11 sample.
+//--------------------------------------------------------------------------------------
+
+#include "CPUSIMD.h"
+
+#if CPU_SIMD_X86 && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+namespace TiledLighting11
+{
+
+#if CPU_SIMD_X86
+    static void CPUID( int Info[4], int nFunction, int nSubFunction )
+    {
+#if defined(_MSC_VER)
+        __cpuidex( Info, nFunction, nSubFunction );
+#else
+        unsigned a = 0, b = 0, c = 0, d = 0;
+        __cpuid_count( nFunction, nSubFunction, a, b, c, d );
+        Info[0] = (int)a; Info[1] = (int)b; Info[2] = (int)c; Info[3] = (int)d;
+#endif
+    }
+
+    static unsigned long long ReadXCR0()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv( 0 );
+#else
+        unsigned uLow = 0, uHigh = 0;
+        __asm__ __volatile__( "xgetbv" : "=a"(uLow), "=d"(uHigh) : "c"(0) );
+        return ( (unsigned long long)uHigh << 32 ) | uLow;
+#endif
+    }
+
+    static CPUSIMDLevel DetectCPUSIMDLevel()
+    {
+        int Info[4];
+        CPUID( Info, 0, 0 );
+        const int nMaxFunction = Info[0];
+
+        CPUID( Info, 1, 0 );
+        const bool bSSE2 = ( Info[3] & (1 << 26) ) != 0;
+        const bool bOSXSAVE = ( Info[2] & (1 << 27) ) != 0;
+        const bool bAVX = ( Info[2] & (1 << 28) ) != 0;
+        if( !bSSE2 )
+        {
+            return CPU_SIMD_SCALAR;
+        }
+
+        // the OS must save the YMM registers on context switches (XCR0 bits 1 and 2)
+        if( !bOSXSAVE || !bAVX || ( ReadXCR0() & 0x6 ) != 0x6 || nMaxFunction < 7 )
+        {
+            return CPU_SIMD_SSE;
+        }
+
+        CPUID( Info, 7, 0 );
+        const bool bAVX2 = ( Info[1] & (1 << 5) ) != 0;
+        return bAVX2 ? CPU_SIMD_AVX2 : CPU_SIMD_SSE;
+    }
+#endif
+
+    //--------------------------------------------------------------------------------------
+    // Returns the widest SIMD level supported by both the CPU and the OS
+    //--------------------------------------------------------------------------------------
+    CPUSIMDLevel GetCPUSIMDLevel()
+    {
+#if CPU_SIMD_X86
+        static const CPUSIMDLevel DetectedLevel = DetectCPUSIMDLevel();
+        return DetectedLevel;
+#else
+        return CPU_SIMD_SCALAR;
+#endif
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Clamps the requested level to what the machine supports
+    //--------------------------------------------------------------------------------------
+    CPUSIMDLevel ResolveCPUSIMDLevel( CPUSIMDLevel RequestedLevel )
+    {
+        CPUSIMDLevel SupportedLevel = GetCPUSIMDLevel();
+        if( RequestedLevel == CPU_SIMD_AUTO || RequestedLevel > SupportedLevel )
+        {
+            return SupportedLevel;
+        }
+        return RequestedLevel;
+    }
+
+    const char* GetCPUSIMDLevelName( CPUSIMDLevel Level )
+    {
+        switch( Level )
+        {
+        case CPU_SIMD_SCALAR: return "Scalar";
+        case CPU_SIMD_SSE:    return "SSE";
+        case CPU_SIMD_AVX2:   return "AVX2";
+        default:              return "Auto";
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
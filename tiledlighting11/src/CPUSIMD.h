@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUSIMD.h
+//
+// CPU feature detection and SIMD helpers for the CPU-side (headless) code paths
+// of the TiledLighting11 sample. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_SIMD_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#else
+#define CPU_SIMD_X86 0
+#endif
+
+// MSVC lets us use any intrinsic in any function, so the AVX2 code paths only need
+// runtime dispatch. GCC and Clang need the target ISA enabled per function.
+#if CPU_SIMD_X86 && ( defined(__GNUC__) || defined(__clang__) )
+#define CPU_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_SIMD_TARGET_AVX2
+#endif
+
+namespace TiledLighting11
+{
+    enum CPUSIMDLevel
+    {
+        CPU_SIMD_SCALAR = 0,
+        CPU_SIMD_SSE,       // 4-wide, SSE2 (always available on x64)
+        CPU_SIMD_AVX2,      // 8-wide
+        CPU_SIMD_NUM_LEVELS,
+        CPU_SIMD_AUTO = CPU_SIMD_NUM_LEVELS
+    };
+
+    // Returns the widest SIMD level supported by both the CPU and the OS
+    CPUSIMDLevel GetCPUSIMDLevel();
+
+    // Clamps the requested level to what the machine supports (CPU_SIMD_AUTO picks the best)
+    CPUSIMDLevel ResolveCPUSIMDLevel( CPUSIMDLevel RequestedLevel );
+
+    const char* GetCPUSIMDLevelName( CPUSIMDLevel Level );
+
+    // Index of the lowest set bit; uMask must be non-zero
+    inline unsigned CountTrailingZeros( unsigned uMask )
+    {
+#if defined(_MSC_VER)
+        unsigned long uIndex;
+        _BitScanForward( &uIndex, uMask );
+        return (unsigned)uIndex;
+#elif defined(__GNUC__) || defined(__clang__)
+        return (unsigned)__builtin_ctz( uMask );
+#else
+        unsigned uIndex = 0;
+        while( ( uMask & 1 ) == 0 )
+        {
+            uMask >>= 1;
+            uIndex++;
+        }
+        return uIndex;
+#endif
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,416 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUScene.cpp
+//
+// Synthetic scene (camera, depth buffer and lights) for the headless CPU code paths.
+//--------------------------------------------------------------------------------------
+
+#include "CPUScene.h"
+#include "CPUSpotLightCulling.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // miscellaneous constants
+    static const float PI = 3.14159265359f;
+
+    // roughly the dimensions of the Sponza atrium
+    static const float ROOM_MIN[3] = { -1500.0f,    0.0f, -700.0f };
+    static const float ROOM_MAX[3] = {  1500.0f, 1300.0f,  700.0f };
+
+    // two rows of pillars down the length of the room
+    static const unsigned NUM_PILLARS_PER_ROW = 7;
+    static const float PILLAR_HALF_WIDTH = 60.0f;
+    static const float PILLAR_HEIGHT = 900.0f;
+    static const float PILLAR_ROW_Z = 380.0f;
+
+    struct CPUBox
+    {
+        float Min[3];
+        float Max[3];
+    };
+
+    // small deterministic generator, so the scene is the same on every platform
+    // (rand() differs between C runtimes)
+    class CPUSceneRandom
+    {
+    public:
+        explicit CPUSceneRandom( unsigned uSeed ) : m_uState( uSeed*747796405u + 2891336453u ) {}
+
+        // in the half-closed interval [fRangeMin, fRangeMax)
+        float GetFloat( float fRangeMin, float fRangeMax )
+        {
+            m_uState ^= m_uState << 13;
+            m_uState ^= m_uState >> 17;
+            m_uState ^= m_uState << 5;
+            return (float)( m_uState >> 8 ) / 16777216.0f * ( fRangeMax - fRangeMin ) + fRangeMin;
+        }
+
+    private:
+        unsigned m_uState;
+    };
+
+    // D3D11 standard sample positions, in 1/16th of a pixel
+    static const int SAMPLE_POSITIONS_2X[2][2] = { { 4, 4 }, { -4, -4 } };
+    static const int SAMPLE_POSITIONS_4X[4][2] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+    static const int SAMPLE_POSITIONS_8X[8][2] = { { 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 } };
+
+    static void GetSamplePosition( unsigned uNumSamples, unsigned uSample, float& fOffsetX, float& fOffsetY )
+    {
+        const int* pPosition = NULL;
+        switch( uNumSamples )
+        {
+        case 2: pPosition = SAMPLE_POSITIONS_2X[uSample]; break;
+        case 4: pPosition = SAMPLE_POSITIONS_4X[uSample]; break;
+        case 8: pPosition = SAMPLE_POSITIONS_8X[uSample]; break;
+        default: break;
+        }
+
+        fOffsetX = pPosition ? pPosition[0] / 16.0f : 0.0f;
+        fOffsetY = pPosition ? pPosition[1] / 16.0f : 0.0f;
+    }
+
+    static float Dot3( const float a[3], const float b[3] )
+    {
+        return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+    }
+
+    static void Normalize3( float v[3] )
+    {
+        float fInvLength = 1.0f / sqrtf( Dot3( v, v ) );
+        v[0] *= fInvLength;
+        v[1] *= fInvLength;
+        v[2] *= fInvLength;
+    }
+
+    static void Cross3( const float a[3], const float b[3], float Result[3] )
+    {
+        Result[0] = a[1]*b[2] - a[2]*b[1];
+        Result[1] = a[2]*b[0] - a[0]*b[2];
+        Result[2] = a[0]*b[1] - a[1]*b[0];
+    }
+
+    // ray vs. box slab test, returning the entry and exit distances
+    static void IntersectBox( const CPUBox& Box, const float Origin[3], const float InvDir[3], float& fEnter, float& fExit )
+    {
+        fEnter = -FLT_MAX;
+        fExit = FLT_MAX;
+        for( int i = 0; i < 3; i++ )
+        {
+            float t1 = ( Box.Min[i] - Origin[i] ) * InvDir[i];
+            float t2 = ( Box.Max[i] - Origin[i] ) * InvDir[i];
+            fEnter = std::max( fEnter, std::min( t1, t2 ) );
+            fExit = std::min( fExit, std::max( t1, t2 ) );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // XMMatrixLookAtLH
+    //--------------------------------------------------------------------------------------
+    static void BuildViewMatrix( const float Eye[3], const float At[3], CPUMatrix& mView )
+    {
+        const float Up[3] = { 0.0f, 1.0f, 0.0f };
+        float ZAxis[3] = { At[0]-Eye[0], At[1]-Eye[1], At[2]-Eye[2] };
+        Normalize3( ZAxis );
+        float XAxis[3];
+        Cross3( Up, ZAxis, XAxis );
+        Normalize3( XAxis );
+        float YAxis[3];
+        Cross3( ZAxis, XAxis, YAxis );
+
+        memset( &mView, 0, sizeof(mView) );
+        for( int i = 0; i < 3; i++ )
+        {
+            mView.m[i][0] = XAxis[i];
+            mView.m[i][1] = YAxis[i];
+            mView.m[i][2] = ZAxis[i];
+        }
+        mView.m[3][0] = -Dot3( XAxis, Eye );
+        mView.m[3][1] = -Dot3( YAxis, Eye );
+        mView.m[3][2] = -Dot3( ZAxis, Eye );
+        mView.m[3][3] = 1.0f;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // XMMatrixPerspectiveFovLH, plus the inverse that OnD3D11FrameRender builds by hand.
+    // Near and far are swapped, as in the SetProjParams call in OnD3D11ResizedSwapChain.
+    //--------------------------------------------------------------------------------------
+    static void BuildProjectionMatrices( float fFovAngleY, float fAspectRatio, float fNearZ, float fFarZ, CPUMatrix& mProj, CPUMatrix& mProjInv )
+    {
+        const float fHeight = 1.0f / tanf( 0.5f*fFovAngleY );
+        const float fWidth = fHeight / fAspectRatio;
+        const float fRange = fFarZ / ( fFarZ - fNearZ );
+
+        memset( &mProj, 0, sizeof(mProj) );
+        mProj.m[0][0] = fWidth;
+        mProj.m[1][1] = fHeight;
+        mProj.m[2][2] = fRange;
+        mProj.m[2][3] = 1.0f;
+        mProj.m[3][2] = -fRange*fNearZ;
+
+        memset( &mProjInv, 0, sizeof(mProjInv) );
+        mProjInv.m[0][0] = 1.0f / mProj.m[0][0];
+        mProjInv.m[1][1] = 1.0f / mProj.m[1][1];
+        mProjInv.m[2][2] = 0.0f;
+        mProjInv.m[2][3] = 1.0f / mProj.m[3][2];
+        mProjInv.m[3][2] = 1.0f;
+        mProjInv.m[3][3] = -mProj.m[2][2] / mProj.m[3][2];
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The room itself (seen from the inside), then the pillars
+    //--------------------------------------------------------------------------------------
+    static void GetSceneGeometry( CPUBox& Room, std::vector<CPUBox>& Pillars )
+    {
+        for( int i = 0; i < 3; i++ )
+        {
+            Room.Min[i] = ROOM_MIN[i];
+            Room.Max[i] = ROOM_MAX[i];
+        }
+
+        Pillars.clear();
+        for( unsigned uRow = 0; uRow < 2; uRow++ )
+        {
+            const float fZ = ( uRow == 0 ) ? -PILLAR_ROW_Z : PILLAR_ROW_Z;
+            for( unsigned i = 0; i < NUM_PILLARS_PER_ROW; i++ )
+            {
+                const float fX = ROOM_MIN[0] + ( ROOM_MAX[0] - ROOM_MIN[0] ) * ( i + 1 ) / ( NUM_PILLARS_PER_ROW + 1 );
+                CPUBox Pillar = { { fX - PILLAR_HALF_WIDTH, ROOM_MIN[1], fZ - PILLAR_HALF_WIDTH }, { fX + PILLAR_HALF_WIDTH, ROOM_MIN[1] + PILLAR_HEIGHT, fZ + PILLAR_HALF_WIDTH } };
+                Pillars.push_back( Pillar );
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Move the camera and ray-cast the depth buffer again
+    //--------------------------------------------------------------------------------------
+    void SetCPUSceneCamera( CPUScene& Scene, const float Eye[3], const float At[3] )
+    {
+        CPUBox Room;
+        std::vector<CPUBox> Pillars;
+        GetSceneGeometry( Room, Pillars );
+
+        Scene.EyePt.x = Eye[0]; Scene.EyePt.y = Eye[1]; Scene.EyePt.z = Eye[2]; Scene.EyePt.w = 1.0f;
+        Scene.LookAtPt.x = At[0]; Scene.LookAtPt.y = At[1]; Scene.LookAtPt.z = At[2]; Scene.LookAtPt.w = 1.0f;
+        BuildViewMatrix( Eye, At, Scene.mView );
+
+        Scene.Depth.resize( (size_t)Scene.uWidth*Scene.uHeight*Scene.uNumSamples );
+        for( unsigned y = 0; y < Scene.uHeight; y++ )
+        {
+            for( unsigned x = 0; x < Scene.uWidth; x++ )
+            {
+                for( unsigned s = 0; s < Scene.uNumSamples; s++ )
+                {
+                    float fOffsetX, fOffsetY;
+                    GetSamplePosition( Scene.uNumSamples, s, fOffsetX, fOffsetY );
+
+                    // view-space direction with z = 1, so the hit distance is the view-space depth
+                    const float fNdcX = ( x + 0.5f + fOffsetX ) / Scene.uWidth * 2.0f - 1.0f;
+                    const float fNdcY = 1.0f - ( y + 0.5f + fOffsetY ) / Scene.uHeight * 2.0f;
+                    const float fViewX = fNdcX * Scene.mProjectionInv.m[0][0];
+                    const float fViewY = fNdcY * Scene.mProjectionInv.m[1][1];
+
+                    // the rows of the upper 3x3 of the view matrix transform view-space directions to world space
+                    float InvDir[3];
+                    for( int i = 0; i < 3; i++ )
+                    {
+                        const float fDir = fViewX*Scene.mView.m[i][0] + fViewY*Scene.mView.m[i][1] + Scene.mView.m[i][2];
+                        InvDir[i] = 1.0f / fDir;
+                    }
+
+                    float fEnter, fExit;
+                    IntersectBox( Room, Eye, InvDir, fEnter, fExit );
+                    float fViewZ = fExit;
+
+                    for( size_t i = 0; i < Pillars.size(); i++ )
+                    {
+                        IntersectBox( Pillars[i], Eye, InvDir, fEnter, fExit );
+                        if( fEnter <= fExit && fEnter > 0.0f && fEnter < fViewZ )
+                        {
+                            fViewZ = fEnter;
+                        }
+                    }
+
+                    // inverted depth, 0 at (and past) the far plane
+                    float fDepth = Scene.mProjection.m[2][2] + Scene.mProjection.m[3][2] / fViewZ;
+                    Scene.Depth[( (size_t)y*Scene.uWidth + x )*Scene.uNumSamples + s] = std::max( fDepth, 0.0f );
+                }
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Build the synthetic scene
+    //--------------------------------------------------------------------------------------
+    void CreateCPUScene( const CPUSceneDesc& Desc, CPUScene& Scene )
+    {
+        Scene.uWidth = Desc.uWidth;
+        Scene.uHeight = Desc.uHeight;
+        Scene.uNumSamples = Desc.uNumSamples;
+
+        Scene.BBoxMin.x = ROOM_MIN[0]; Scene.BBoxMin.y = ROOM_MIN[1]; Scene.BBoxMin.z = ROOM_MIN[2]; Scene.BBoxMin.w = 1.0f;
+        Scene.BBoxMax.x = ROOM_MAX[0]; Scene.BBoxMax.y = ROOM_MAX[1]; Scene.BBoxMax.z = ROOM_MAX[2]; Scene.BBoxMax.w = 1.0f;
+
+        const float BoundaryDiff[3] = { ROOM_MAX[0]-ROOM_MIN[0], ROOM_MAX[1]-ROOM_MIN[1], ROOM_MAX[2]-ROOM_MIN[2] };
+        const float fMaxDistance = sqrtf( Dot3( BoundaryDiff, BoundaryDiff ) );
+        const float fAspectRatio = (float)Desc.uWidth / (float)Desc.uHeight;
+        BuildProjectionMatrices( PI / 4, fAspectRatio, fMaxDistance, 0.1f, Scene.mProjection, Scene.mProjectionInv );
+
+        // camera at one end of the room, looking down its length
+        const float Eye[3] = { ROOM_MIN[0] + 150.0f, 250.0f, 0.0f };
+        const float At[3] = { ROOM_MAX[0], 300.0f, 0.0f };
+        SetCPUSceneCamera( Scene, Eye, At );
+
+        // lights, sized the same way as in LightUtil::InitLights
+        CPUSceneRandom Random( Desc.uSeed );
+        const float fRadius = 0.075f * 0.5f * fMaxDistance * Desc.fLightRadiusScale;
+
+        Scene.PointLightCenterAndRadius.resize( Desc.uNumPointLights );
+        for( unsigned i = 0; i < Desc.uNumPointLights; i++ )
+        {
+            CPUFloat4& Light = Scene.PointLightCenterAndRadius[i];
+            Light.x = Random.GetFloat( ROOM_MIN[0], ROOM_MAX[0] );
+            Light.y = Random.GetFloat( ROOM_MIN[1], ROOM_MAX[1] );
+            Light.z = Random.GetFloat( ROOM_MIN[2], ROOM_MAX[2] );
+            Light.w = fRadius;
+        }
+
+        Scene.SpotLightCenterAndRadius.resize( Desc.uNumSpotLights );
+        for( unsigned i = 0; i < Desc.uNumSpotLights; i++ )
+        {
+            CPUFloat4& Light = Scene.SpotLightCenterAndRadius[i];
+            Light.x = Random.GetFloat( ROOM_MIN[0], ROOM_MAX[0] );
+            Light.y = Random.GetFloat( ROOM_MIN[1], ROOM_MAX[1] );
+            Light.z = Random.GetFloat( ROOM_MIN[2], ROOM_MAX[2] );
+            Light.w = fRadius;
+        }
+
+        // spot light directions and cones, as in LightUtil::InitLights (drawn after the
+        // positions, so the light positions don't depend on whether these exist)
+        const float fSpotLightFalloffRadius = 1.333333333333f * fRadius;
+        Scene.SpotLightSpotParams.resize( Desc.uNumSpotLights );
+        for( unsigned i = 0; i < Desc.uNumSpotLights; i++ )
+        {
+            float LightDir[3];
+            LightDir[0] = Random.GetFloat( -1.0f, 1.0f );
+            LightDir[1] = Random.GetFloat( 0.1f, 1.0f );
+            LightDir[2] = Random.GetFloat( -1.0f, 1.0f );
+            if( i%2 == 1 )
+            {
+                LightDir[1] = -LightDir[1];
+            }
+
+            const float fInvLength = 1.0f / sqrtf( LightDir[0]*LightDir[0] + LightDir[1]*LightDir[1] + LightDir[2]*LightDir[2] );
+            LightDir[0] *= fInvLength;
+            LightDir[1] *= fInvLength;
+            LightDir[2] *= fInvLength;
+
+            // cosine(35.26438968 degrees), the max-volume cone inside the bounding sphere
+            Scene.SpotLightSpotParams[i] = PackCPUSpotParams( LightDir, 0.816496580927726f, fSpotLightFalloffRadius );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Point the culling input at the scene data
+    //--------------------------------------------------------------------------------------
+    void FillCPULightCullingInput( const CPUScene& Scene, unsigned uMaxNumLightsPerTile, CPULightCullingInput& Input )
+    {
+        Input.mView = Scene.mView;
+        Input.mProjectionInv = Scene.mProjectionInv;
+        Input.uWidth = Scene.uWidth;
+        Input.uHeight = Scene.uHeight;
+        Input.pDepth = Scene.Depth.empty() ? NULL : &Scene.Depth[0];
+        Input.uNumSamples = Scene.uNumSamples;
+        Input.pBlendedDepth = NULL;
+        Input.pPointLightCenterAndRadius = Scene.PointLightCenterAndRadius.empty() ? NULL : &Scene.PointLightCenterAndRadius[0];
+        Input.uNumPointLights = (unsigned)Scene.PointLightCenterAndRadius.size();
+        Input.pSpotLightCenterAndRadius = Scene.SpotLightCenterAndRadius.empty() ? NULL : &Scene.SpotLightCenterAndRadius[0];
+        Input.uNumSpotLights = (unsigned)Scene.SpotLightCenterAndRadius.size();
+        Input.pSpotParams = Scene.SpotLightSpotParams.empty() ? NULL : &Scene.SpotLightSpotParams[0];
+        Input.pVPLCenterAndRadius = NULL;
+        Input.uNumVPLs = 0;
+        Input.uMaxNumLightsPerTile = uMaxNumLightsPerTile;
+        Input.uMaxNumVPLsPerTile = uMaxNumLightsPerTile;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Add the bounding box of [Min,Max] as a center and half extents
+    //--------------------------------------------------------------------------------------
+    static void AddBoxBounds( const float Min[3], const float Max[3], std::vector<CPUFloat4>& Centers, std::vector<CPUFloat4>& Extents )
+    {
+        const CPUFloat4 Center = { 0.5f*( Min[0] + Max[0] ), 0.5f*( Min[1] + Max[1] ), 0.5f*( Min[2] + Max[2] ), 1.0f };
+        const CPUFloat4 Extent = { 0.5f*( Max[0] - Min[0] ), 0.5f*( Max[1] - Min[1] ), 0.5f*( Max[2] - Min[2] ), 0.0f };
+        Centers.push_back( Center );
+        Extents.push_back( Extent );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Bounding boxes of the room in sections, then of the pillars
+    //--------------------------------------------------------------------------------------
+    void GetCPUSceneCasterBounds( unsigned uNumSections, std::vector<CPUFloat4>& Centers, std::vector<CPUFloat4>& Extents )
+    {
+        CPUBox Room;
+        std::vector<CPUBox> Pillars;
+        GetSceneGeometry( Room, Pillars );
+
+        Centers.clear();
+        Extents.clear();
+
+        // the floor, the ceiling and the two long walls, cut across the length of the room
+        for( unsigned i = 0; i < uNumSections; i++ )
+        {
+            const float fX0 = Room.Min[0] + ( Room.Max[0] - Room.Min[0] )*i/uNumSections;
+            const float fX1 = Room.Min[0] + ( Room.Max[0] - Room.Min[0] )*( i + 1 )/uNumSections;
+
+            const float Floor[2][3] = { { fX0, Room.Min[1], Room.Min[2] }, { fX1, Room.Min[1], Room.Max[2] } };
+            const float Ceiling[2][3] = { { fX0, Room.Max[1], Room.Min[2] }, { fX1, Room.Max[1], Room.Max[2] } };
+            const float NearWall[2][3] = { { fX0, Room.Min[1], Room.Min[2] }, { fX1, Room.Max[1], Room.Min[2] } };
+            const float FarWall[2][3] = { { fX0, Room.Min[1], Room.Max[2] }, { fX1, Room.Max[1], Room.Max[2] } };
+            AddBoxBounds( Floor[0], Floor[1], Centers, Extents );
+            AddBoxBounds( Ceiling[0], Ceiling[1], Centers, Extents );
+            AddBoxBounds( NearWall[0], NearWall[1], Centers, Extents );
+            AddBoxBounds( FarWall[0], FarWall[1], Centers, Extents );
+        }
+
+        // the end walls
+        const float LeftWall[2][3] = { { Room.Min[0], Room.Min[1], Room.Min[2] }, { Room.Min[0], Room.Max[1], Room.Max[2] } };
+        const float RightWall[2][3] = { { Room.Max[0], Room.Min[1], Room.Min[2] }, { Room.Max[0], Room.Max[1], Room.Max[2] } };
+        AddBoxBounds( LeftWall[0], LeftWall[1], Centers, Extents );
+        AddBoxBounds( RightWall[0], RightWall[1], Centers, Extents );
+
+        for( size_t i = 0; i < Pillars.size(); i++ )
+        {
+            AddBoxBounds( Pillars[i].Min, Pillars[i].Max, Centers, Extents );
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUScene.h
+//
+// Synthetic scene (camera, depth buffer and lights) for the headless CPU code paths.
+// It stands in for the Sponza scene and the GPU depth pre-pass, so the CPU culling can
+// be exercised without a D3D device. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    struct CPUSceneDesc
+    {
+        CPUSceneDesc() : uWidth(1920), uHeight(1080), uNumSamples(1), uNumPointLights(2048), uNumSpotLights(2048), uSeed(1), fLightRadiusScale(1.0f) {}
+
+        unsigned            uWidth;
+        unsigned            uHeight;
+        unsigned            uNumSamples;
+        unsigned            uNumPointLights;
+        unsigned            uNumSpotLights;
+        unsigned            uSeed;
+
+        // scales the LightUtil::InitLights radius, e.g. to keep the lit volume constant as the light count grows
+        float               fLightRadiusScale;
+    };
+
+    struct CPUScene
+    {
+        unsigned                uWidth;
+        unsigned                uHeight;
+        unsigned                uNumSamples;
+
+        // the scene bounding box, same role as the Sponza bounding box in InitApp
+        CPUFloat4               BBoxMin;
+        CPUFloat4               BBoxMax;
+
+        // camera, built the same way as in OnD3D11FrameRender (reverse Z, with the
+        // hand-built inverse projection that the culling shaders expect)
+        CPUFloat4               EyePt;
+        CPUFloat4               LookAtPt;
+        CPUMatrix               mView;
+        CPUMatrix               mProjection;
+        CPUMatrix               mProjectionInv;
+
+        // depth pre-pass result, uWidth*uHeight*uNumSamples floats
+        std::vector<float>      Depth;
+
+        std::vector<CPUFloat4>  PointLightCenterAndRadius;
+        std::vector<CPUFloat4>  SpotLightCenterAndRadius;
+        std::vector<CPUSpotParams> SpotLightSpotParams;
+    };
+
+    // Builds a room with pillars, a camera looking down its length, a ray-cast depth buffer,
+    // and randomly placed lights sized like LightUtil::InitLights sizes them
+    void CreateCPUScene( const CPUSceneDesc& Desc, CPUScene& Scene );
+
+    // Moves the camera and ray-casts the depth buffer again
+    void SetCPUSceneCamera( CPUScene& Scene, const float Eye[3], const float At[3] );
+
+    // Fills in the matrices, depth buffer, light arrays and per-tile limits of Input from Scene
+    void FillCPULightCullingInput( const CPUScene& Scene, unsigned uMaxNumLightsPerTile, CPULightCullingInput& Input );
+
+    // Bounding boxes (centers and half extents) of the scene's geometry, standing in for the
+    // Sponza mesh subsets: the floor, ceiling and long walls of the room in uNumSections
+    // pieces each along its length, the two end walls, then the pillars
+    void GetCPUSceneCasterBounds( unsigned uNumSections, std::vector<CPUFloat4>& Centers, std::vector<CPUFloat4>& Extents );
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
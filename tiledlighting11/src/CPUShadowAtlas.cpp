@@ -0,0 +1,414 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUShadowAtlas.cpp
+//
+// Quadtree shadow atlas allocation.
+//--------------------------------------------------------------------------------------
+
+#include "CPUShadowAtlas.h"
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // node states; the nodes inside a free or used tile, and below unsplit ones, are NODE_NONE
+    enum
+    {
+        NODE_NONE = 0,
+        NODE_FREE,
+        NODE_SPLIT,
+        NODE_USED,
+    };
+
+    // a tile handle is its level in the top 8 bits and its key in the low 24
+    static unsigned MakeTileHandle( unsigned uLevel, unsigned uKey )
+    {
+        assert( uKey < ( 1u << 24 ) );
+        return ( uLevel << 24 ) | uKey;
+    }
+
+    // every other bit of a Morton code, starting with bit 0
+    static unsigned CompactBits( unsigned u )
+    {
+        u &= 0x55555555u;
+        u = ( u | ( u >> 1 ) ) & 0x33333333u;
+        u = ( u | ( u >> 2 ) ) & 0x0F0F0F0Fu;
+        u = ( u | ( u >> 4 ) ) & 0x00FF00FFu;
+        u = ( u | ( u >> 8 ) ) & 0x0000FFFFu;
+        return u;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUShadowAtlas::CPUShadowAtlas()
+    {
+        Reset( CPUShadowAtlasDesc() );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUShadowAtlas::~CPUShadowAtlas()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Free every tile
+    //--------------------------------------------------------------------------------------
+    void CPUShadowAtlas::Reset( const CPUShadowAtlasDesc& Desc )
+    {
+        assert( Desc.uMinTileSize > 0 && ( Desc.uMinTileSize & ( Desc.uMinTileSize - 1 ) ) == 0 );
+        assert( Desc.uRootSize >= Desc.uMinTileSize && ( Desc.uRootSize & ( Desc.uRootSize - 1 ) ) == 0 );
+        assert( Desc.uNumRootsX > 0 && Desc.uNumRootsY > 0 );
+
+        m_Desc = Desc;
+
+        unsigned uNumLevels = 1;
+        while( GetLevelSize( uNumLevels - 1 ) > Desc.uMinTileSize )
+        {
+            uNumLevels++;
+        }
+
+        const unsigned uNumRoots = Desc.uNumRootsX*Desc.uNumRootsY;
+        m_Levels.resize( uNumLevels );
+        for( unsigned uLevel = 0; uLevel < uNumLevels; uLevel++ )
+        {
+            m_Levels[uLevel].States.assign( (size_t)uNumRoots << ( 2*uLevel ), NODE_NONE );
+            m_Levels[uLevel].FreeNodes.clear();
+        }
+
+        for( unsigned uRoot = 0; uRoot < uNumRoots; uRoot++ )
+        {
+            m_Levels[0].States[uRoot] = NODE_FREE;
+            m_Levels[0].FreeNodes.insert( uRoot );
+        }
+
+        m_Stats.uNumTiles = 0;
+        m_Stats.uUsedArea = 0;
+        m_Stats.uFreeArea = (unsigned long long)GetWidth()*GetHeight();
+        m_Stats.uLargestFreeSize = Desc.uRootSize;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The smallest tier at least uSize texels across
+    //--------------------------------------------------------------------------------------
+    unsigned CPUShadowAtlas::GetLevel( unsigned uSize ) const
+    {
+        unsigned uLevel = 0;
+        while( uLevel + 1 < (unsigned)m_Levels.size() && GetLevelSize( uLevel + 1 ) >= uSize )
+        {
+            uLevel++;
+        }
+        return uLevel;
+    }
+
+    void CPUShadowAtlas::UpdateLargestFreeSize()
+    {
+        m_Stats.uLargestFreeSize = 0;
+        for( unsigned uLevel = 0; uLevel < (unsigned)m_Levels.size(); uLevel++ )
+        {
+            if( !m_Levels[uLevel].FreeNodes.empty() )
+            {
+                m_Stats.uLargestFreeSize = GetLevelSize( uLevel );
+                break;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Split the smallest free tile that is big enough down to uLevel
+    //--------------------------------------------------------------------------------------
+    unsigned CPUShadowAtlas::AllocateAtLevel( unsigned uLevel, bool bAllowSmaller )
+    {
+        unsigned uSource = CPU_SHADOW_ATLAS_NO_TILE;
+        for( unsigned uLarger = uLevel + 1; uLarger-- > 0; )
+        {
+            if( !m_Levels[uLarger].FreeNodes.empty() )
+            {
+                uSource = uLarger;
+                break;
+            }
+        }
+
+        if( uSource == CPU_SHADOW_ATLAS_NO_TILE )
+        {
+            if( !bAllowSmaller )
+            {
+                return CPU_SHADOW_ATLAS_NO_TILE;
+            }
+
+            for( unsigned uSmaller = uLevel + 1; uSmaller < (unsigned)m_Levels.size(); uSmaller++ )
+            {
+                if( !m_Levels[uSmaller].FreeNodes.empty() )
+                {
+                    uSource = uSmaller;
+                    uLevel = uSmaller;
+                    break;
+                }
+            }
+
+            if( uSource == CPU_SHADOW_ATLAS_NO_TILE )
+            {
+                return CPU_SHADOW_ATLAS_NO_TILE;
+            }
+        }
+
+        std::set<unsigned>& FreeNodes = m_Levels[uSource].FreeNodes;
+        unsigned uKey = *FreeNodes.begin();
+        FreeNodes.erase( FreeNodes.begin() );
+
+        // keep the first child and free the other three at each level on the way down
+        for( unsigned uSplit = uSource; uSplit < uLevel; uSplit++ )
+        {
+            m_Levels[uSplit].States[uKey] = NODE_SPLIT;
+            uKey *= 4;
+            for( unsigned uChild = 1; uChild < 4; uChild++ )
+            {
+                m_Levels[uSplit + 1].States[uKey + uChild] = NODE_FREE;
+                m_Levels[uSplit + 1].FreeNodes.insert( uKey + uChild );
+            }
+        }
+        m_Levels[uLevel].States[uKey] = NODE_USED;
+
+        const unsigned long long uArea = (unsigned long long)GetLevelSize( uLevel )*GetLevelSize( uLevel );
+        m_Stats.uNumTiles++;
+        m_Stats.uUsedArea += uArea;
+        m_Stats.uFreeArea -= uArea;
+        UpdateLargestFreeSize();
+
+        return MakeTileHandle( uLevel, uKey );
+    }
+
+    unsigned CPUShadowAtlas::Allocate( unsigned uSize, bool bAllowSmaller )
+    {
+        return AllocateAtLevel( GetLevel( uSize ), bAllowSmaller );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Free a tile, merging it with its siblings as far up as they are all free
+    //--------------------------------------------------------------------------------------
+    void CPUShadowAtlas::Free( unsigned uTile )
+    {
+        unsigned uLevel = uTile >> 24;
+        unsigned uKey = uTile & 0x00FFFFFFu;
+        assert( uLevel < m_Levels.size() && m_Levels[uLevel].States[uKey] == NODE_USED );
+
+        const unsigned long long uArea = (unsigned long long)GetLevelSize( uLevel )*GetLevelSize( uLevel );
+        m_Stats.uNumTiles--;
+        m_Stats.uUsedArea -= uArea;
+        m_Stats.uFreeArea += uArea;
+
+        m_Levels[uLevel].States[uKey] = NODE_FREE;
+        while( uLevel > 0 )
+        {
+            Level& Siblings = m_Levels[uLevel];
+            const unsigned uFirst = uKey & ~3u;
+            if( Siblings.States[uFirst] != NODE_FREE || Siblings.States[uFirst + 1] != NODE_FREE ||
+                Siblings.States[uFirst + 2] != NODE_FREE || Siblings.States[uFirst + 3] != NODE_FREE )
+            {
+                break;
+            }
+
+            // uKey itself is not in the free list yet
+            for( unsigned uChild = 0; uChild < 4; uChild++ )
+            {
+                if( uFirst + uChild != uKey )
+                {
+                    Siblings.FreeNodes.erase( uFirst + uChild );
+                }
+                Siblings.States[uFirst + uChild] = NODE_NONE;
+            }
+
+            uLevel--;
+            uKey = uFirst / 4;
+            m_Levels[uLevel].States[uKey] = NODE_FREE;
+        }
+        m_Levels[uLevel].FreeNodes.insert( uKey );
+
+        UpdateLargestFreeSize();
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Move a tile to another tier
+    //--------------------------------------------------------------------------------------
+    unsigned CPUShadowAtlas::Reallocate( unsigned uTile, unsigned uSize, bool bAllowSmaller )
+    {
+        const unsigned uLevel = uTile >> 24;
+        const unsigned uNewLevel = GetLevel( uSize );
+        if( uNewLevel == uLevel )
+        {
+            return uTile;
+        }
+
+        // shrinking: the old tile has room for the new one
+        if( uNewLevel > uLevel )
+        {
+            Free( uTile );
+            const unsigned uNewTile = AllocateAtLevel( uNewLevel, false );
+            assert( uNewTile != CPU_SHADOW_ATLAS_NO_TILE );
+            return uNewTile;
+        }
+
+        // growing: keep the old tile unless a larger one was found
+        const unsigned uNewTile = AllocateAtLevel( uNewLevel, bAllowSmaller );
+        if( uNewTile == CPU_SHADOW_ATLAS_NO_TILE )
+        {
+            return uTile;
+        }
+        if( ( uNewTile >> 24 ) >= uLevel )
+        {
+            Free( uNewTile );
+            return uTile;
+        }
+
+        Free( uTile );
+        return uNewTile;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Position and size of a tile
+    //--------------------------------------------------------------------------------------
+    CPUShadowAtlasTile CPUShadowAtlas::GetTile( unsigned uTile ) const
+    {
+        const unsigned uLevel = uTile >> 24;
+        const unsigned uKey = uTile & 0x00FFFFFFu;
+        const unsigned uRoot = uKey >> ( 2*uLevel );
+        const unsigned uCode = uKey & ( ( 1u << ( 2*uLevel ) ) - 1 );
+
+        CPUShadowAtlasTile Tile;
+        Tile.uSize = GetLevelSize( uLevel );
+        Tile.uX = ( uRoot % m_Desc.uNumRootsX )*m_Desc.uRootSize + CompactBits( uCode )*Tile.uSize;
+        Tile.uY = ( uRoot / m_Desc.uNumRootsX )*m_Desc.uRootSize + CompactBits( uCode >> 1 )*Tile.uSize;
+        return Tile;
+    }
+
+    CPUFloat4 CPUShadowAtlas::GetScaleOffset( unsigned uTile, float fBorder ) const
+    {
+        const CPUShadowAtlasTile Tile = GetTile( uTile );
+        const float fInvWidth = 1.0f / (float)GetWidth();
+        const float fInvHeight = 1.0f / (float)GetHeight();
+
+        CPUFloat4 ScaleOffset;
+        ScaleOffset.x = ( (float)Tile.uSize - 2.0f*fBorder )*fInvWidth;
+        ScaleOffset.y = ( (float)Tile.uSize - 2.0f*fBorder )*fInvHeight;
+        ScaleOffset.z = ( (float)Tile.uX + fBorder )*fInvWidth;
+        ScaleOffset.w = ( (float)Tile.uY + fBorder )*fInvHeight;
+        return ScaleOffset;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Consistency of the quadtrees, the free lists and the stats
+    //--------------------------------------------------------------------------------------
+    bool CPUShadowAtlas::CheckNode( unsigned uLevel, unsigned uKey, unsigned long long& uUsedArea, unsigned long long& uFreeArea, unsigned& uNumTiles, unsigned& uNumFreeNodes ) const
+    {
+        const unsigned long long uArea = (unsigned long long)GetLevelSize( uLevel )*GetLevelSize( uLevel );
+        switch( m_Levels[uLevel].States[uKey] )
+        {
+        case NODE_FREE:
+            uFreeArea += uArea;
+            uNumFreeNodes++;
+            return m_Levels[uLevel].FreeNodes.count( uKey ) == 1;
+
+        case NODE_USED:
+            uUsedArea += uArea;
+            uNumTiles++;
+            return true;
+
+        case NODE_SPLIT:
+            if( uLevel + 1 >= m_Levels.size() )
+            {
+                return false;
+            }
+            for( unsigned uChild = 0; uChild < 4; uChild++ )
+            {
+                if( !CheckNode( uLevel + 1, 4*uKey + uChild, uUsedArea, uFreeArea, uNumTiles, uNumFreeNodes ) )
+                {
+                    return false;
+                }
+            }
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    bool CPUShadowAtlas::CheckConsistency() const
+    {
+        unsigned long long uUsedArea = 0, uFreeArea = 0;
+        unsigned uNumTiles = 0, uNumFreeNodes = 0;
+        for( unsigned uRoot = 0; uRoot < m_Desc.uNumRootsX*m_Desc.uNumRootsY; uRoot++ )
+        {
+            if( !CheckNode( 0, uRoot, uUsedArea, uFreeArea, uNumTiles, uNumFreeNodes ) )
+            {
+                return false;
+            }
+        }
+
+        // no stale free list entries
+        size_t uNumFreeListEntries = 0;
+        unsigned uLargestFreeSize = 0;
+        for( unsigned uLevel = 0; uLevel < (unsigned)m_Levels.size(); uLevel++ )
+        {
+            uNumFreeListEntries += m_Levels[uLevel].FreeNodes.size();
+            if( uLargestFreeSize == 0 && !m_Levels[uLevel].FreeNodes.empty() )
+            {
+                uLargestFreeSize = GetLevelSize( uLevel );
+            }
+        }
+
+        return uNumFreeListEntries == uNumFreeNodes && uNumTiles == m_Stats.uNumTiles &&
+            uUsedArea == m_Stats.uUsedArea && uFreeArea == m_Stats.uFreeArea && uLargestFreeSize == m_Stats.uLargestFreeSize;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Tier for a light's screen coverage
+    //--------------------------------------------------------------------------------------
+    unsigned CPUShadowAtlas::GetTileSizeForCoverage( float fCoverage, unsigned uScreenHeight, unsigned uCurrentSize, unsigned uMinSize, unsigned uMaxSize )
+    {
+        const float fPixels = sqrtf( std::max( fCoverage, 0.0f ) )*(float)uScreenHeight;
+
+        unsigned uSize = uMinSize;
+        while( uSize < uMaxSize && (float)uSize < fPixels )
+        {
+            uSize *= 2;
+        }
+
+        // shrink a tier only below 80% of the smaller tier's size
+        if( uCurrentSize > uSize && uCurrentSize <= uMaxSize && fPixels > 0.4f*(float)uCurrentSize )
+        {
+            uSize = uCurrentSize;
+        }
+        return uSize;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUShadowAtlas.h
+//
+// Variable-resolution shadow atlas allocation. The atlas is a grid of square roots, each
+// the root of a quadtree whose levels are the power-of-two tile sizes (the tiers), down
+// to a minimum size. A tile is allocated by splitting the smallest free tile that is big
+// enough, and a freed tile merges with its three siblings when they are free too, so
+// tiles are allocated, freed and resized one at a time and nothing else moves. Among the
+// free tiles of a tier the one nearest the start of the atlas is taken, which keeps the
+// free space in large pieces. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <set>
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    static const unsigned CPU_SHADOW_ATLAS_NO_TILE = 0xFFFFFFFFu;
+
+    struct CPUShadowAtlasDesc
+    {
+        CPUShadowAtlasDesc() : uRootSize(2048), uNumRootsX(1), uNumRootsY(1), uMinTileSize(64) {}
+
+        // the atlas is uNumRootsX*uRootSize by uNumRootsY*uRootSize texels; both sizes are powers of two
+        unsigned    uRootSize;
+        unsigned    uNumRootsX;
+        unsigned    uNumRootsY;
+        unsigned    uMinTileSize;
+    };
+
+    // In texels
+    struct CPUShadowAtlasTile
+    {
+        unsigned    uX;
+        unsigned    uY;
+        unsigned    uSize;
+    };
+
+    struct CPUShadowAtlasStats
+    {
+        unsigned            uNumTiles;
+        unsigned long long  uUsedArea;
+        unsigned long long  uFreeArea;
+
+        // the largest tile that can be allocated now, 0 if the atlas is full
+        unsigned            uLargestFreeSize;
+    };
+
+    class CPUShadowAtlas
+    {
+    public:
+        // Constructor / destructor
+        CPUShadowAtlas();
+        ~CPUShadowAtlas();
+
+        // Frees every tile
+        void Reset( const CPUShadowAtlasDesc& Desc );
+        const CPUShadowAtlasDesc& GetDesc() const { return m_Desc; }
+        unsigned GetWidth() const { return m_Desc.uNumRootsX*m_Desc.uRootSize; }
+        unsigned GetHeight() const { return m_Desc.uNumRootsY*m_Desc.uRootSize; }
+
+        // Allocates a tile of uSize texels, rounded up to a tier. If no tile that size is
+        // free and bAllowSmaller is set, the largest smaller tile that is free. Returns
+        // the tile's handle, or CPU_SHADOW_ATLAS_NO_TILE if nothing fits.
+        unsigned Allocate( unsigned uSize, bool bAllowSmaller );
+        void Free( unsigned uTile );
+
+        // Moves a tile to another tier and returns its new handle. A tile that shrinks
+        // always fits; a tile that grows keeps its old place if no larger tile is free
+        // (with bAllowSmaller, it grows as far as it can).
+        unsigned Reallocate( unsigned uTile, unsigned uSize, bool bAllowSmaller );
+
+        CPUShadowAtlasTile GetTile( unsigned uTile ) const;
+
+        // Texture coordinate scale (x, y) and offset (z, w) that map [0,1] across the tile,
+        // inset by fBorder texels on every side for the shadow filter's footprint
+        CPUFloat4 GetScaleOffset( unsigned uTile, float fBorder ) const;
+
+        const CPUShadowAtlasStats& GetStats() const { return m_Stats; }
+
+        // Walks the quadtrees and returns false if the node states, the free lists or
+        // the stats disagree
+        bool CheckConsistency() const;
+
+        // The tile size for a light whose bounding sphere covers fCoverage of the screen
+        // (see CPUShadowScheduler::GetScreenCoverage): about as many texels across as the
+        // sphere is pixels across, clamped to [uMinSize, uMaxSize]. A tile of uCurrentSize
+        // (0 for none) only shrinks once the sphere is well below the smaller tier's size,
+        // so that lights near a tier boundary do not switch tiers every frame.
+        static unsigned GetTileSizeForCoverage( float fCoverage, unsigned uScreenHeight, unsigned uCurrentSize, unsigned uMinSize, unsigned uMaxSize );
+
+    private:
+        // not copyable
+        CPUShadowAtlas( const CPUShadowAtlas& );
+        CPUShadowAtlas& operator=( const CPUShadowAtlas& );
+
+        // One tier. A node's key is its root's index times 4^level plus its Morton code
+        // within the root, so a node's children are 4*key to 4*key + 3.
+        struct Level
+        {
+            std::vector<unsigned char>  States;
+            std::set<unsigned>          FreeNodes;
+        };
+
+        unsigned GetLevel( unsigned uSize ) const;
+        unsigned GetLevelSize( unsigned uLevel ) const { return m_Desc.uRootSize >> uLevel; }
+        unsigned AllocateAtLevel( unsigned uLevel, bool bAllowSmaller );
+        bool CheckNode( unsigned uLevel, unsigned uKey, unsigned long long& uUsedArea, unsigned long long& uFreeArea, unsigned& uNumTiles, unsigned& uNumFreeNodes ) const;
+        void UpdateLargestFreeSize();
+
+        CPUShadowAtlasDesc      m_Desc;
+        CPUShadowAtlasStats     m_Stats;
+        std::vector<Level>      m_Levels;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
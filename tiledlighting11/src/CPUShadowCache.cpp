@@ -0,0 +1,270 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPUShadowCache.cpp
+//
+// Static shadow map caching on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPUShadowCache.h"
+#include "CPUShadowCasterCulling.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace TiledLighting11
+{
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUShadowCache::CPUShadowCache()
+        :m_uVersion(0)
+        ,m_uNumDynamicCasters(0)
+        ,m_uNumFacesPerLight(0)
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUShadowCache::~CPUShadowCache()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Forget everything
+    //--------------------------------------------------------------------------------------
+    void CPUShadowCache::Reset( unsigned uNumCasters )
+    {
+        CasterState Caster;
+        Caster.bDynamic = false;
+        Caster.uVersion = 0;
+        m_Casters.assign( uNumCasters, Caster );
+
+        m_Faces.clear();
+        m_Draws.clear();
+        m_uVersion = 0;
+        m_uNumDynamicCasters = 0;
+        m_uNumFacesPerLight = 0;
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Move a caster between the static and dynamic sets
+    //--------------------------------------------------------------------------------------
+    void CPUShadowCache::SetCasterDynamic( unsigned uCaster, bool bDynamic )
+    {
+        assert( uCaster < m_Casters.size() );
+
+        CasterState& Caster = m_Casters[uCaster];
+        if( Caster.bDynamic != bDynamic )
+        {
+            Caster.bDynamic = bDynamic;
+            m_uNumDynamicCasters = bDynamic ? m_uNumDynamicCasters + 1 : m_uNumDynamicCasters - 1;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Mark a caster as changed after every copy rendered so far
+    //--------------------------------------------------------------------------------------
+    void CPUShadowCache::InvalidateCaster( unsigned uCaster )
+    {
+        assert( uCaster < m_Casters.size() );
+        m_Casters[uCaster].uVersion = ++m_uVersion;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Drop every copy
+    //--------------------------------------------------------------------------------------
+    void CPUShadowCache::InvalidateAll()
+    {
+        for( size_t i = 0; i < m_Faces.size(); i++ )
+        {
+            m_Faces[i].bValid = false;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Whether any of the casters changed after a copy rendered at uVersion
+    //--------------------------------------------------------------------------------------
+    bool CPUShadowCache::HasChangedCaster( const unsigned* pCasters, unsigned uNumCasters, unsigned uVersion ) const
+    {
+        for( unsigned i = 0; i < uNumCasters; i++ )
+        {
+            if( m_Casters[pCasters[i]].uVersion > uVersion )
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Split each face's draw list, and decide which faces render their static casters again
+    //--------------------------------------------------------------------------------------
+    void CPUShadowCache::Update( const CPUShadowCasterCuller& Culler, const CPUMatrix* pViewProj, const CPUShadowAtlasTile* pTiles, unsigned uNumLights, unsigned uNumFacesPerLight )
+    {
+        assert( Culler.GetNumCasters() == m_Casters.size() );
+
+        const unsigned uNumFaces = uNumLights*uNumFacesPerLight;
+        if( uNumFacesPerLight != m_uNumFacesPerLight )
+        {
+            m_Faces.clear();
+            m_uNumFacesPerLight = uNumFacesPerLight;
+        }
+        if( m_Faces.size() < uNumFaces )
+        {
+            m_Faces.resize( uNumFaces );
+        }
+
+        const unsigned long long uTotalLookups = m_Stats.uTotalLookups;
+        const unsigned long long uTotalHits = m_Stats.uTotalHits;
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        m_Stats.uNumFaces = uNumFaces;
+
+        m_Draws.clear();
+
+        for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+        {
+            for( unsigned uFace = 0; uFace < uNumFacesPerLight; uFace++ )
+            {
+                const unsigned uIndex = uLight*uNumFacesPerLight + uFace;
+                FaceState& Face = m_Faces[uIndex];
+
+                unsigned uNumCasters = 0;
+                const unsigned* pCasters = Culler.GetDrawList( uLight, uFace, uNumCasters );
+
+                // the static casters, then the dynamic ones
+                Face.uStaticOffset = (unsigned)m_Draws.size();
+                for( unsigned i = 0; i < uNumCasters; i++ )
+                {
+                    if( !m_Casters[pCasters[i]].bDynamic )
+                    {
+                        m_Draws.push_back( pCasters[i] );
+                    }
+                }
+                Face.uNumStatic = (unsigned)m_Draws.size() - Face.uStaticOffset;
+
+                Face.uDynamicOffset = (unsigned)m_Draws.size();
+                for( unsigned i = 0; i < uNumCasters; i++ )
+                {
+                    if( m_Casters[pCasters[i]].bDynamic )
+                    {
+                        m_Draws.push_back( pCasters[i] );
+                    }
+                }
+                Face.uNumDynamic = (unsigned)m_Draws.size() - Face.uDynamicOffset;
+
+                const unsigned* pStatic = Face.uNumStatic ? &m_Draws[Face.uStaticOffset] : NULL;
+                const CPUShadowAtlasTile& Tile = pTiles[uIndex];
+
+                // the copy is stale if it holds a caster that changed or left, or if a
+                // caster that changed or arrived is in the frustum now
+                Face.bRenderStatic = true;
+                if( !Face.bValid )
+                {
+                    m_Stats.uNumColdMisses++;
+                }
+                else if( memcmp( &Face.ViewProj, &pViewProj[uIndex], sizeof(CPUMatrix) ) != 0 )
+                {
+                    m_Stats.uNumLightMisses++;
+                }
+                else if( Face.Tile.uX != Tile.uX || Face.Tile.uY != Tile.uY || Face.Tile.uSize != Tile.uSize )
+                {
+                    m_Stats.uNumTileMisses++;
+                }
+                else if( Face.StaticCasters.size() != Face.uNumStatic ||
+                    ( Face.uNumStatic > 0 && memcmp( &Face.StaticCasters[0], pStatic, Face.uNumStatic*sizeof(unsigned) ) != 0 ) ||
+                    HasChangedCaster( pStatic, Face.uNumStatic, Face.uVersion ) )
+                {
+                    m_Stats.uNumCasterMisses++;
+                }
+                else
+                {
+                    Face.bRenderStatic = false;
+                    m_Stats.uNumHits++;
+                }
+
+                if( Face.bRenderStatic )
+                {
+                    Face.bValid = true;
+                    Face.ViewProj = pViewProj[uIndex];
+                    Face.Tile = Tile;
+                    Face.uVersion = m_uVersion;
+                    Face.StaticCasters.assign( pStatic, pStatic + Face.uNumStatic );
+                    m_Stats.uNumStaticDraws += Face.uNumStatic;
+                }
+
+                // dynamic casters drawn over the copy last time have to be erased as well
+                Face.bComposite = Face.bRenderStatic || Face.uNumDynamic > 0 || Face.bHadDynamic;
+                if( Face.bComposite )
+                {
+                    Face.bHadDynamic = ( Face.uNumDynamic > 0 );
+                    m_Stats.uNumComposites++;
+                    m_Stats.uNumDynamicDraws += Face.uNumDynamic;
+                }
+            }
+        }
+
+        m_Stats.uTotalLookups = uTotalLookups + uNumFaces;
+        m_Stats.uTotalHits = uTotalHits + m_Stats.uNumHits;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // One face's state from the last update
+    //--------------------------------------------------------------------------------------
+    const CPUShadowCache::FaceState& CPUShadowCache::GetFace( unsigned uLight, unsigned uFace ) const
+    {
+        assert( uFace < m_uNumFacesPerLight && uLight*m_uNumFacesPerLight + uFace < m_Faces.size() );
+        return m_Faces[uLight*m_uNumFacesPerLight + uFace];
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The static casters of a face
+    //--------------------------------------------------------------------------------------
+    const unsigned* CPUShadowCache::GetStaticDrawList( unsigned uLight, unsigned uFace, unsigned& uNumDraws ) const
+    {
+        const FaceState& Face = GetFace( uLight, uFace );
+        uNumDraws = Face.uNumStatic;
+        return Face.uNumStatic ? &m_Draws[Face.uStaticOffset] : NULL;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The dynamic casters of a face
+    //--------------------------------------------------------------------------------------
+    const unsigned* CPUShadowCache::GetDynamicDrawList( unsigned uLight, unsigned uFace, unsigned& uNumDraws ) const
+    {
+        const FaceState& Face = GetFace( uLight, uFace );
+        uNumDraws = Face.uNumDynamic;
+        return Face.uNumDynamic ? &m_Draws[Face.uDynamicOffset] : NULL;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
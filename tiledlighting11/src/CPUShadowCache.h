@@ -0,0 +1,180 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPUShadowCache.h
+//
+// Decides which shadow map faces can reuse a cached copy of their static casters. Each
+// face keeps a depth copy of the static casters alone; a face renders its static casters
+// again only when its light moved (its view-projection matrix changed), its atlas tile
+// moved or resized, or a static caster inside its frustum changed or came or went, and
+// the dynamic casters are drawn over the copy on every update. The draw lists come from
+// a CPUShadowCasterCuller. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+#include "CPUShadowAtlas.h"
+
+namespace TiledLighting11
+{
+    class CPUShadowCasterCuller;
+
+    struct CPUShadowCacheStats
+    {
+        // faces looked up in the last update, and those whose static copy was reused
+        unsigned            uNumFaces;
+        unsigned            uNumHits;
+
+        // the faces that rendered their static casters again, by the first reason found:
+        // never rendered (or invalidated wholesale), the light moved, the atlas tile moved
+        // or resized, or a static caster in the frustum changed or came or went
+        unsigned            uNumColdMisses;
+        unsigned            uNumLightMisses;
+        unsigned            uNumTileMisses;
+        unsigned            uNumCasterMisses;
+
+        // faces whose shadow map was rebuilt from the static copy, which are the misses
+        // plus the faces with dynamic casters now or at their last rebuild
+        unsigned            uNumComposites;
+
+        // casters drawn in the last update, static ones into the copies and dynamic ones
+        // over them
+        unsigned long long  uNumStaticDraws;
+        unsigned long long  uNumDynamicDraws;
+
+        // lookups and hits since the last Reset
+        unsigned long long  uTotalLookups;
+        unsigned long long  uTotalHits;
+    };
+
+    class CPUShadowCache
+    {
+    public:
+        // Constructor / destructor
+        CPUShadowCache();
+        ~CPUShadowCache();
+
+        // Forgets every copy and clears the statistics. uNumCasters is the count given to the
+        // culler, and casters start out static.
+        void Reset( unsigned uNumCasters );
+
+        // Dynamic casters are never cached; they are drawn over the static copy on every update
+        void SetCasterDynamic( unsigned uCaster, bool bDynamic );
+        bool IsCasterDynamic( unsigned uCaster ) const { return m_Casters[uCaster].bDynamic; }
+        unsigned GetNumDynamicCasters() const { return m_uNumDynamicCasters; }
+
+        // A static caster changed shape, moved, or was shown or hidden. The faces whose copy
+        // holds it, and the faces it is inside now, render their static casters again; when it
+        // moved, pass its new bounds to the culler before the next update.
+        void InvalidateCaster( unsigned uCaster );
+
+        // Every copy is lost, for example with the device
+        void InvalidateAll();
+
+        // Looks up every face of the culler's last CullCasters call. pViewProj and pTiles hold
+        // the view-projection matrix and atlas tile of face f of light i at i*uNumFacesPerLight + f.
+        // The faces that need it are assumed to be rendered after this call.
+        void Update( const CPUShadowCasterCuller& Culler, const CPUMatrix* pViewProj, const CPUShadowAtlasTile* pTiles, unsigned uNumLights, unsigned uNumFacesPerLight );
+
+        // The static copy is out of date: clear the face's tile in it and draw its static casters
+        bool NeedsStaticRender( unsigned uLight, unsigned uFace ) const { return GetFace( uLight, uFace ).bRenderStatic; }
+
+        // The face's shadow map is out of date: copy the static tile over it and draw its
+        // dynamic casters
+        bool NeedsComposite( unsigned uLight, unsigned uFace ) const { return GetFace( uLight, uFace ).bComposite; }
+
+        // The face's casters from the culler, split into static and dynamic ones, NULL if none
+        const unsigned* GetStaticDrawList( unsigned uLight, unsigned uFace, unsigned& uNumDraws ) const;
+        const unsigned* GetDynamicDrawList( unsigned uLight, unsigned uFace, unsigned& uNumDraws ) const;
+
+        const CPUShadowCacheStats& GetStats() const { return m_Stats; }
+
+    private:
+        // not copyable
+        CPUShadowCache( const CPUShadowCache& );
+        CPUShadowCache& operator=( const CPUShadowCache& );
+
+        struct CasterState
+        {
+            bool        bDynamic;
+
+            // the value of m_uVersion when the caster last changed, 0 for never
+            unsigned    uVersion;
+        };
+
+        struct FaceState
+        {
+            // what the static copy was rendered with
+            bool                    bValid;
+            CPUMatrix               ViewProj;
+            CPUShadowAtlasTile      Tile;
+            unsigned                uVersion;
+            std::vector<unsigned>   StaticCasters;
+
+            // the shadow map had dynamic casters drawn over the copy at its last rebuild
+            bool                    bHadDynamic;
+
+            // this update's decisions, and where its lists start in m_Draws
+            bool                    bRenderStatic;
+            bool                    bComposite;
+            unsigned                uStaticOffset;
+            unsigned                uNumStatic;
+            unsigned                uDynamicOffset;
+            unsigned                uNumDynamic;
+
+            FaceState()
+                :bValid(false)
+                ,uVersion(0)
+                ,bHadDynamic(false)
+                ,bRenderStatic(false)
+                ,bComposite(false)
+                ,uStaticOffset(0)
+                ,uNumStatic(0)
+                ,uDynamicOffset(0)
+                ,uNumDynamic(0)
+            {
+            }
+        };
+
+        const FaceState& GetFace( unsigned uLight, unsigned uFace ) const;
+        bool HasChangedCaster( const unsigned* pCasters, unsigned uNumCasters, unsigned uVersion ) const;
+
+        CPUShadowCacheStats         m_Stats;
+        unsigned                    m_uVersion;
+        unsigned                    m_uNumDynamicCasters;
+        unsigned                    m_uNumFacesPerLight;
+
+        std::vector<CasterState>    m_Casters;
+        std::vector<FaceState>      m_Faces;
+        std::vector<unsigned>       m_Draws;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
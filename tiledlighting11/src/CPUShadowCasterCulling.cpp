@@ -0,0 +1,245 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUShadowCasterCulling.cpp
+//
+// Per-light and per-face shadow caster culling on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPUShadowCasterCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUShadowCasterCuller::CPUShadowCasterCuller()
+        :m_uNumCasters(0)
+        ,m_uNumFacesPerLight(0)
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUShadowCasterCuller::~CPUShadowCasterCuller()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Copy the bounding boxes into SoA arrays
+    //--------------------------------------------------------------------------------------
+    void CPUShadowCasterCuller::SetCasters( const CPUFloat4* pCenters, const CPUFloat4* pExtents, unsigned uNumCasters )
+    {
+        m_uNumCasters = uNumCasters;
+        m_CenterX.resize( uNumCasters );
+        m_CenterY.resize( uNumCasters );
+        m_CenterZ.resize( uNumCasters );
+        m_ExtentX.resize( uNumCasters );
+        m_ExtentY.resize( uNumCasters );
+        m_ExtentZ.resize( uNumCasters );
+
+        for( unsigned i = 0; i < uNumCasters; i++ )
+        {
+            m_CenterX[i] = pCenters[i].x;
+            m_CenterY[i] = pCenters[i].y;
+            m_CenterZ[i] = pCenters[i].z;
+            m_ExtentX[i] = pExtents[i].x;
+            m_ExtentY[i] = pExtents[i].y;
+            m_ExtentZ[i] = pExtents[i].z;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The casters touching one light's sphere, then the ones of those inside each face
+    //--------------------------------------------------------------------------------------
+    void CPUShadowCasterCuller::CullLight( unsigned uLight, const CPUFloat4& Sphere, const CPUFloat4* pPlanes )
+    {
+        LightDrawLists& Lists = m_Lights[uLight];
+        Lists.InRange.clear();
+        Lists.Draws.clear();
+
+        // squared distance from the sphere's center to the box
+        const float fRadiusSq = Sphere.w*Sphere.w;
+        for( unsigned i = 0; i < m_uNumCasters; i++ )
+        {
+            const float dx = std::max( fabsf( m_CenterX[i] - Sphere.x ) - m_ExtentX[i], 0.0f );
+            const float dy = std::max( fabsf( m_CenterY[i] - Sphere.y ) - m_ExtentY[i], 0.0f );
+            const float dz = std::max( fabsf( m_CenterZ[i] - Sphere.z ) - m_ExtentZ[i], 0.0f );
+            if( dx*dx + dy*dy + dz*dz <= fRadiusSq )
+            {
+                Lists.InRange.push_back( i );
+            }
+        }
+
+        const unsigned uNumInRange = (unsigned)Lists.InRange.size();
+        for( unsigned uFace = 0; uFace < m_uNumFacesPerLight; uFace++ )
+        {
+            const CPUFloat4* p = &pPlanes[6*uFace];
+
+            // the box is outside a plane if its corner furthest along the normal is
+            float AbsX[6], AbsY[6], AbsZ[6];
+            for( int k = 0; k < 6; k++ )
+            {
+                AbsX[k] = fabsf( p[k].x );
+                AbsY[k] = fabsf( p[k].y );
+                AbsZ[k] = fabsf( p[k].z );
+            }
+
+            FaceRange& Range = m_FaceRanges[uLight*m_uNumFacesPerLight + uFace];
+            Range.uOffset = (unsigned)Lists.Draws.size();
+
+            for( unsigned j = 0; j < uNumInRange; j++ )
+            {
+                const unsigned i = Lists.InRange[j];
+                const float cx = m_CenterX[i], cy = m_CenterY[i], cz = m_CenterZ[i];
+                const float ex = m_ExtentX[i], ey = m_ExtentY[i], ez = m_ExtentZ[i];
+
+                bool bInside = true;
+                for( int k = 0; k < 6 && bInside; k++ )
+                {
+                    const float fDistance = p[k].x*cx + p[k].y*cy + p[k].z*cz + p[k].w;
+                    const float fReach = AbsX[k]*ex + AbsY[k]*ey + AbsZ[k]*ez;
+                    bInside = ( fDistance + fReach >= 0.0f );
+                }
+
+                if( bInside )
+                {
+                    Lists.Draws.push_back( i );
+                }
+            }
+
+            Range.uCount = (unsigned)Lists.Draws.size() - Range.uOffset;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Build the draw list of every face of every light
+    //--------------------------------------------------------------------------------------
+    void CPUShadowCasterCuller::CullCasters( const CPUFloat4* pLightSpheres, const CPUFloat4* pFacePlanes, unsigned uNumLights, unsigned uNumFacesPerLight, CPUTaskScheduler* pScheduler )
+    {
+        m_uNumFacesPerLight = uNumFacesPerLight;
+        m_Lights.resize( uNumLights );
+        m_FaceRanges.resize( (size_t)uNumLights*uNumFacesPerLight );
+
+        // one light per job: there are few lights, and each one's lists are its own
+        CPUTaskScheduler::RangeFunction CullLights = [&]( unsigned uBegin, unsigned uEnd, unsigned /*uThreadIndex*/ )
+        {
+            for( unsigned uLight = uBegin; uLight < uEnd; uLight++ )
+            {
+                CullLight( uLight, pLightSpheres[uLight], &pFacePlanes[(size_t)6*uLight*uNumFacesPerLight] );
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumLights, 1, CullLights );
+        }
+        else
+        {
+            CullLights( 0, uNumLights, 0 );
+        }
+
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        m_Stats.uNumFaces = uNumLights*uNumFacesPerLight;
+        m_Stats.uNumDrawsBefore = (unsigned long long)m_Stats.uNumFaces*m_uNumCasters;
+        for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+        {
+            m_Stats.uNumDrawsInRange += (unsigned long long)m_Lights[uLight].InRange.size()*uNumFacesPerLight;
+            m_Stats.uNumDrawsAfter += m_Lights[uLight].Draws.size();
+        }
+        for( size_t i = 0; i < m_FaceRanges.size(); i++ )
+        {
+            m_Stats.uMaxDrawsPerFace = std::max( m_Stats.uMaxDrawsPerFace, m_FaceRanges[i].uCount );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The draw list of one face
+    //--------------------------------------------------------------------------------------
+    const unsigned* CPUShadowCasterCuller::GetDrawList( unsigned uLight, unsigned uFace, unsigned& uNumDraws ) const
+    {
+        assert( uLight < m_Lights.size() && uFace < m_uNumFacesPerLight );
+
+        const FaceRange& Range = m_FaceRanges[uLight*m_uNumFacesPerLight + uFace];
+        uNumDraws = Range.uCount;
+        return Range.uCount ? &m_Lights[uLight].Draws[Range.uOffset] : NULL;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Frustum planes from the columns of a row-vector view-projection matrix
+    //--------------------------------------------------------------------------------------
+    void CPUShadowCasterCuller::ExtractFrustumPlanes( const CPUMatrix& mViewProj, CPUFloat4 Planes[6] )
+    {
+        const float (*m)[4] = mViewProj.m;
+
+        // Left clipping plane
+        Planes[0].x = m[0][3] + m[0][0];
+        Planes[0].y = m[1][3] + m[1][0];
+        Planes[0].z = m[2][3] + m[2][0];
+        Planes[0].w = m[3][3] + m[3][0];
+
+        // Right clipping plane
+        Planes[1].x = m[0][3] - m[0][0];
+        Planes[1].y = m[1][3] - m[1][0];
+        Planes[1].z = m[2][3] - m[2][0];
+        Planes[1].w = m[3][3] - m[3][0];
+
+        // Top clipping plane
+        Planes[2].x = m[0][3] - m[0][1];
+        Planes[2].y = m[1][3] - m[1][1];
+        Planes[2].z = m[2][3] - m[2][1];
+        Planes[2].w = m[3][3] - m[3][1];
+
+        // Bottom clipping plane
+        Planes[3].x = m[0][3] + m[0][1];
+        Planes[3].y = m[1][3] + m[1][1];
+        Planes[3].z = m[2][3] + m[2][1];
+        Planes[3].w = m[3][3] + m[3][1];
+
+        // Near clipping plane
+        Planes[4].x = m[0][2];
+        Planes[4].y = m[1][2];
+        Planes[4].z = m[2][2];
+        Planes[4].w = m[3][2];
+
+        // Far clipping plane
+        Planes[5].x = m[0][3] - m[0][2];
+        Planes[5].y = m[1][3] - m[1][2];
+        Planes[5].z = m[2][3] - m[2][2];
+        Planes[5].w = m[3][3] - m[3][2];
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,129 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUShadowCasterCulling.h
+//
+// Shadow caster culling on the CPU. Every shadow map face renders the whole scene unless
+// told otherwise; this finds, per light and per face, the casters whose axis-aligned
+// bounding boxes can reach the face's shadow map. A caster must first touch the light's
+// bounding sphere (anything outside it can only occlude receivers the light does not
+// reach), then the six planes of the face's frustum, as AMD::ExtractPlanesFromFrustum
+// gives them. The result is one draw list per face, in ascending caster order.
+// This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+
+    struct CPUShadowCasterCullingStats
+    {
+        unsigned            uNumFaces;
+
+        // every caster in every face, as without culling
+        unsigned long long  uNumDrawsBefore;
+
+        // casters that touch their light's bounding sphere, counted once per face
+        unsigned long long  uNumDrawsInRange;
+
+        // casters inside the face frusta as well, the draws that are left
+        unsigned long long  uNumDrawsAfter;
+
+        // the longest draw list of any face
+        unsigned            uMaxDrawsPerFace;
+    };
+
+    class CPUShadowCasterCuller
+    {
+    public:
+        // Constructor / destructor
+        CPUShadowCasterCuller();
+        ~CPUShadowCasterCuller();
+
+        // The casters' bounding boxes, as centers and half extents (w is unused). They
+        // stay until the next call; the draw lists index into them.
+        void SetCasters( const CPUFloat4* pCenters, const CPUFloat4* pExtents, unsigned uNumCasters );
+        unsigned GetNumCasters() const { return m_uNumCasters; }
+
+        // pLightSpheres[i] bounds the volume light i reaches, and the six planes of its
+        // face f are pFacePlanes[6*(i*uNumFacesPerLight + f)] onwards, with the inside of
+        // the frustum on their positive side (normalized or not)
+        void CullCasters( const CPUFloat4* pLightSpheres, const CPUFloat4* pFacePlanes, unsigned uNumLights, unsigned uNumFacesPerLight, CPUTaskScheduler* pScheduler );
+
+        // The casters to draw into a face, NULL if none
+        const unsigned* GetDrawList( unsigned uLight, unsigned uFace, unsigned& uNumDraws ) const;
+
+        const CPUShadowCasterCullingStats& GetStats() const { return m_Stats; }
+
+        // The left, right, top, bottom, near and far planes of a view-projection matrix (not
+        // transposed), unnormalized, the same as AMD::ExtractPlanesFromFrustum gives them
+        static void ExtractFrustumPlanes( const CPUMatrix& mViewProj, CPUFloat4 Planes[6] );
+
+    private:
+        // not copyable
+        CPUShadowCasterCuller( const CPUShadowCasterCuller& );
+        CPUShadowCasterCuller& operator=( const CPUShadowCasterCuller& );
+
+        // per light: the casters in range, and the draw lists of its faces one after another
+        struct LightDrawLists
+        {
+            std::vector<unsigned>   InRange;
+            std::vector<unsigned>   Draws;
+        };
+
+        // where a face's draw list starts in its light's Draws, and its length
+        struct FaceRange
+        {
+            unsigned    uOffset;
+            unsigned    uCount;
+        };
+
+        void CullLight( unsigned uLight, const CPUFloat4& Sphere, const CPUFloat4* pPlanes );
+
+        unsigned                        m_uNumCasters;
+        unsigned                        m_uNumFacesPerLight;
+        CPUShadowCasterCullingStats     m_Stats;
+
+        // the bounding boxes, SoA
+        std::vector<float>              m_CenterX;
+        std::vector<float>              m_CenterY;
+        std::vector<float>              m_CenterZ;
+        std::vector<float>              m_ExtentX;
+        std::vector<float>              m_ExtentY;
+        std::vector<float>              m_ExtentZ;
+
+        std::vector<LightDrawLists>     m_Lights;
+        std::vector<FaceRange>          m_FaceRanges;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
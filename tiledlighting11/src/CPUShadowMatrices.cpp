@@ -0,0 +1,540 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUShadowMatrices.cpp
+//
+// Batched shadow view-projection matrices on the CPU.
+//
+// With the view basis X, Y, Z (the rows of the look-at rotation), the eye position E,
+// the focal length f = cot(fov/2), the near plane n, q = far/(far - n) and
+// k = (far - n)/(far*n), the transposed view-projection matrix has the rows
+//     ( f*X, -f*(X.E) ),  ( f*Y, -f*(Y.E) ),  ( q*Z, -q*(Z.E + n) ),  ( Z, -(Z.E) )
+// and the transposed inverse has the rows
+//     ( X[i]/f, Y[i]/f, -k*E[i], Z[i] + E[i]/n )  for i = 0, 1, 2,  and  ( 0, 0, -k, 1/n )
+//--------------------------------------------------------------------------------------
+
+#include "CPUShadowMatrices.h"
+#include "CPUTaskScheduler.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    static const unsigned BLOCK_SIZE = 8;
+
+    static const float INV_NEAR_Z = 1.0f / CPU_SHADOW_NEAR_Z;
+
+    // the look direction and up vector of each cube map face, as LightUtil had them
+    static const float FACE_DIR[6][3] =
+    {
+        {  1.0f,  0.0f,  0.0f },
+        { -1.0f,  0.0f,  0.0f },
+        {  0.0f,  1.0f,  0.0f },
+        {  0.0f, -1.0f,  0.0f },
+        {  0.0f,  0.0f, -1.0f },
+        {  0.0f,  0.0f,  1.0f },
+    };
+
+    static const float FACE_UP[6][3] =
+    {
+        { 0.0f, 1.0f,  0.0f },
+        { 0.0f, 1.0f,  0.0f },
+        { 0.0f, 0.0f,  1.0f },
+        { 0.0f, 0.0f, -1.0f },
+        { 0.0f, 1.0f,  0.0f },
+        { 0.0f, 1.0f,  0.0f },
+    };
+
+    // the x, y and z axes of a light's view space, in world space
+    struct ShadowBasis
+    {
+        float   X[3];
+        float   Y[3];
+        float   Z[3];
+    };
+
+    //--------------------------------------------------------------------------------------
+    // Helpers
+    //--------------------------------------------------------------------------------------
+    static float GetFocalLength( float fFovDegrees )
+    {
+        return (float)( 1.0 / tan( fFovDegrees*( 3.14159265358979323846 / 360.0 ) ) );
+    }
+
+    // the basis of XMMatrixLookAtLH, exact, since every vector is a signed axis
+    static void GetFaceBasis( int nFace, ShadowBasis& Basis )
+    {
+        const float* z = FACE_DIR[nFace];
+        const float* up = FACE_UP[nFace];
+
+        Basis.X[0] = up[1]*z[2] - up[2]*z[1];
+        Basis.X[1] = up[2]*z[0] - up[0]*z[2];
+        Basis.X[2] = up[0]*z[1] - up[1]*z[0];
+        Basis.Y[0] = z[1]*Basis.X[2] - z[2]*Basis.X[1];
+        Basis.Y[1] = z[2]*Basis.X[0] - z[0]*Basis.X[2];
+        Basis.Y[2] = z[0]*Basis.X[1] - z[1]*Basis.X[0];
+        Basis.Z[0] = z[0];
+        Basis.Z[1] = z[1];
+        Basis.Z[2] = z[2];
+    }
+
+    // the basis of XMMatrixLookAtLH with +y up: X = normalize( (0,1,0) x Z ) = (Z.z, 0, -Z.x)/|Z.xz|
+    static void GetSpotBasis( const CPUFloat4& Eye, const CPUFloat4& LookAt, ShadowBasis& Basis )
+    {
+        const float dx = LookAt.x - Eye.x;
+        const float dy = LookAt.y - Eye.y;
+        const float dz = LookAt.z - Eye.z;
+        const float fLength = sqrtf( dx*dx + dy*dy + dz*dz );
+        Basis.Z[0] = dx / fLength;
+        Basis.Z[1] = dy / fLength;
+        Basis.Z[2] = dz / fLength;
+
+        const float fLengthXZ = sqrtf( Basis.Z[2]*Basis.Z[2] + Basis.Z[0]*Basis.Z[0] );
+        Basis.X[0] = Basis.Z[2] / fLengthXZ;
+        Basis.X[1] = 0.0f;
+        Basis.X[2] = -( Basis.Z[0] / fLengthXZ );
+
+        Basis.Y[0] = Basis.Z[1]*Basis.X[2];
+        Basis.Y[1] = Basis.Z[2]*Basis.X[0] - Basis.Z[0]*Basis.X[2];
+        Basis.Y[2] = -( Basis.Z[1]*Basis.X[0] );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Scalar path, one light (or cube map face) at a time
+    //--------------------------------------------------------------------------------------
+    static void CalcShadowMatricesScalar( const CPUFloat4& EyeAndFarZ, const ShadowBasis& Basis, float fFocalLength, float fInvFocalLength,
+        CPUMatrix& ViewProj, CPUMatrix& ViewProjInv )
+    {
+        const float Eye[3] = { EyeAndFarZ.x, EyeAndFarZ.y, EyeAndFarZ.z };
+        const float fFarZ = EyeAndFarZ.w;
+        const float fQ = fFarZ / ( fFarZ - CPU_SHADOW_NEAR_Z );
+        const float fK = ( fFarZ - CPU_SHADOW_NEAR_Z ) / ( fFarZ*CPU_SHADOW_NEAR_Z );
+
+        const float fDotX = Basis.X[0]*Eye[0] + Basis.X[1]*Eye[1] + Basis.X[2]*Eye[2];
+        const float fDotY = Basis.Y[0]*Eye[0] + Basis.Y[1]*Eye[1] + Basis.Y[2]*Eye[2];
+        const float fDotZ = Basis.Z[0]*Eye[0] + Basis.Z[1]*Eye[1] + Basis.Z[2]*Eye[2];
+
+        for( int i = 0; i < 3; i++ )
+        {
+            ViewProj.m[0][i] = fFocalLength*Basis.X[i];
+            ViewProj.m[1][i] = fFocalLength*Basis.Y[i];
+            ViewProj.m[2][i] = fQ*Basis.Z[i];
+            ViewProj.m[3][i] = Basis.Z[i];
+
+            ViewProjInv.m[i][0] = Basis.X[i]*fInvFocalLength;
+            ViewProjInv.m[i][1] = Basis.Y[i]*fInvFocalLength;
+            ViewProjInv.m[i][2] = -( Eye[i]*fK );
+            ViewProjInv.m[i][3] = Basis.Z[i] + Eye[i]*INV_NEAR_Z;
+        }
+
+        ViewProj.m[0][3] = -( fFocalLength*fDotX );
+        ViewProj.m[1][3] = -( fFocalLength*fDotY );
+        ViewProj.m[2][3] = -( fQ*( fDotZ + CPU_SHADOW_NEAR_Z ) );
+        ViewProj.m[3][3] = -fDotZ;
+
+        ViewProjInv.m[3][0] = 0.0f;
+        ViewProjInv.m[3][1] = 0.0f;
+        ViewProjInv.m[3][2] = -fK;
+        ViewProjInv.m[3][3] = INV_NEAR_Z;
+    }
+
+#if CPU_SIMD_X86
+    //--------------------------------------------------------------------------------------
+    // SSE path, four lights at a time
+    //--------------------------------------------------------------------------------------
+    struct ShadowBasisSSE
+    {
+        __m128  X[3];
+        __m128  Y[3];
+        __m128  Z[3];
+    };
+
+    static inline __m128 NegateSSE( __m128 v )
+    {
+        return _mm_xor_ps( v, _mm_set1_ps( -0.0f ) );
+    }
+
+    static inline __m128 Dot3SSE( const __m128 a[3], const __m128 b[3] )
+    {
+        return _mm_add_ps( _mm_add_ps( _mm_mul_ps( a[0], b[0] ), _mm_mul_ps( a[1], b[1] ) ), _mm_mul_ps( a[2], b[2] ) );
+    }
+
+    // the four lights' (x,y,z,w) from p, p + uStride, p + 2*uStride and p + 3*uStride
+    static inline void LoadFloat4SSE( const float* p, unsigned uStride, __m128& x, __m128& y, __m128& z, __m128& w )
+    {
+        x = _mm_loadu_ps( p );
+        y = _mm_loadu_ps( p + uStride );
+        z = _mm_loadu_ps( p + 2*uStride );
+        w = _mm_loadu_ps( p + 3*uStride );
+        _MM_TRANSPOSE4_PS( x, y, z, w );
+    }
+
+    // the four lights' (x,y,z,w) at p, p + uStride, p + 2*uStride and p + 3*uStride
+    static inline void StoreFloat4SSE( float* p, unsigned uStride, __m128 x, __m128 y, __m128 z, __m128 w )
+    {
+        _MM_TRANSPOSE4_PS( x, y, z, w );
+        _mm_storeu_ps( p, x );
+        _mm_storeu_ps( p + uStride, y );
+        _mm_storeu_ps( p + 2*uStride, z );
+        _mm_storeu_ps( p + 3*uStride, w );
+    }
+
+    static void CalcShadowMatricesSSE( const __m128 Eye[3], __m128 FarZ, const ShadowBasisSSE& Basis, __m128 FocalLength, __m128 InvFocalLength,
+        float* pViewProj, float* pViewProjInv, unsigned uStride )
+    {
+        const __m128 NearZ = _mm_set1_ps( CPU_SHADOW_NEAR_Z );
+        const __m128 InvNearZ = _mm_set1_ps( INV_NEAR_Z );
+        const __m128 Zero = _mm_setzero_ps();
+        const __m128 Q = _mm_div_ps( FarZ, _mm_sub_ps( FarZ, NearZ ) );
+        const __m128 K = _mm_div_ps( _mm_sub_ps( FarZ, NearZ ), _mm_mul_ps( FarZ, NearZ ) );
+
+        const __m128 DotX = Dot3SSE( Basis.X, Eye );
+        const __m128 DotY = Dot3SSE( Basis.Y, Eye );
+        const __m128 DotZ = Dot3SSE( Basis.Z, Eye );
+
+        StoreFloat4SSE( pViewProj, uStride, _mm_mul_ps( FocalLength, Basis.X[0] ), _mm_mul_ps( FocalLength, Basis.X[1] ), _mm_mul_ps( FocalLength, Basis.X[2] ),
+            NegateSSE( _mm_mul_ps( FocalLength, DotX ) ) );
+        StoreFloat4SSE( pViewProj + 4, uStride, _mm_mul_ps( FocalLength, Basis.Y[0] ), _mm_mul_ps( FocalLength, Basis.Y[1] ), _mm_mul_ps( FocalLength, Basis.Y[2] ),
+            NegateSSE( _mm_mul_ps( FocalLength, DotY ) ) );
+        StoreFloat4SSE( pViewProj + 8, uStride, _mm_mul_ps( Q, Basis.Z[0] ), _mm_mul_ps( Q, Basis.Z[1] ), _mm_mul_ps( Q, Basis.Z[2] ),
+            NegateSSE( _mm_mul_ps( Q, _mm_add_ps( DotZ, NearZ ) ) ) );
+        StoreFloat4SSE( pViewProj + 12, uStride, Basis.Z[0], Basis.Z[1], Basis.Z[2], NegateSSE( DotZ ) );
+
+        for( int i = 0; i < 3; i++ )
+        {
+            StoreFloat4SSE( pViewProjInv + 4*i, uStride, _mm_mul_ps( Basis.X[i], InvFocalLength ), _mm_mul_ps( Basis.Y[i], InvFocalLength ),
+                NegateSSE( _mm_mul_ps( Eye[i], K ) ), _mm_add_ps( Basis.Z[i], _mm_mul_ps( Eye[i], InvNearZ ) ) );
+        }
+        StoreFloat4SSE( pViewProjInv + 12, uStride, Zero, Zero, NegateSSE( K ), InvNearZ );
+    }
+
+    static void CalcPointLightMatricesSSE( const CPUFloat4* pPositionAndRadius, unsigned uLight, const ShadowBasis Faces[6], float fFocalLength, float fInvFocalLength,
+        CPUMatrix* pViewProj, CPUMatrix* pViewProjInv )
+    {
+        __m128 Eye[3], FarZ;
+        LoadFloat4SSE( &pPositionAndRadius[uLight].x, 4, Eye[0], Eye[1], Eye[2], FarZ );
+
+        for( int nFace = 0; nFace < 6; nFace++ )
+        {
+            ShadowBasisSSE Basis;
+            for( int i = 0; i < 3; i++ )
+            {
+                Basis.X[i] = _mm_set1_ps( Faces[nFace].X[i] );
+                Basis.Y[i] = _mm_set1_ps( Faces[nFace].Y[i] );
+                Basis.Z[i] = _mm_set1_ps( Faces[nFace].Z[i] );
+            }
+
+            CalcShadowMatricesSSE( Eye, FarZ, Basis, _mm_set1_ps( fFocalLength ), _mm_set1_ps( fInvFocalLength ),
+                &pViewProj[6*uLight + nFace].m[0][0], &pViewProjInv[6*uLight + nFace].m[0][0], 6*16 );
+        }
+    }
+
+    static void CalcSpotLightMatricesSSE( const CPUFloat4* pPositionAndRadius, const CPUFloat4* pLookAt, unsigned uLight, float fFocalLength, float fInvFocalLength,
+        CPUMatrix* pViewProj, CPUMatrix* pViewProjInv )
+    {
+        __m128 Eye[3], FarZ, LookAt[3], Unused;
+        LoadFloat4SSE( &pPositionAndRadius[uLight].x, 4, Eye[0], Eye[1], Eye[2], FarZ );
+        LoadFloat4SSE( &pLookAt[uLight].x, 4, LookAt[0], LookAt[1], LookAt[2], Unused );
+
+        // see GetSpotBasis
+        const __m128 dx = _mm_sub_ps( LookAt[0], Eye[0] );
+        const __m128 dy = _mm_sub_ps( LookAt[1], Eye[1] );
+        const __m128 dz = _mm_sub_ps( LookAt[2], Eye[2] );
+        const __m128 Length = _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) ) );
+
+        ShadowBasisSSE Basis;
+        Basis.Z[0] = _mm_div_ps( dx, Length );
+        Basis.Z[1] = _mm_div_ps( dy, Length );
+        Basis.Z[2] = _mm_div_ps( dz, Length );
+
+        const __m128 LengthXZ = _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( Basis.Z[2], Basis.Z[2] ), _mm_mul_ps( Basis.Z[0], Basis.Z[0] ) ) );
+        Basis.X[0] = _mm_div_ps( Basis.Z[2], LengthXZ );
+        Basis.X[1] = _mm_setzero_ps();
+        Basis.X[2] = NegateSSE( _mm_div_ps( Basis.Z[0], LengthXZ ) );
+
+        Basis.Y[0] = _mm_mul_ps( Basis.Z[1], Basis.X[2] );
+        Basis.Y[1] = _mm_sub_ps( _mm_mul_ps( Basis.Z[2], Basis.X[0] ), _mm_mul_ps( Basis.Z[0], Basis.X[2] ) );
+        Basis.Y[2] = NegateSSE( _mm_mul_ps( Basis.Z[1], Basis.X[0] ) );
+
+        CalcShadowMatricesSSE( Eye, FarZ, Basis, _mm_set1_ps( fFocalLength ), _mm_set1_ps( fInvFocalLength ),
+            &pViewProj[uLight].m[0][0], &pViewProjInv[uLight].m[0][0], 16 );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // AVX2 path, eight lights at a time
+    //--------------------------------------------------------------------------------------
+    struct ShadowBasisAVX2
+    {
+        __m256  X[3];
+        __m256  Y[3];
+        __m256  Z[3];
+    };
+
+    CPU_SIMD_TARGET_AVX2 static inline __m256 NegateAVX2( __m256 v )
+    {
+        return _mm256_xor_ps( v, _mm256_set1_ps( -0.0f ) );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static inline __m256 Dot3AVX2( const __m256 a[3], const __m256 b[3] )
+    {
+        return _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( a[0], b[0] ), _mm256_mul_ps( a[1], b[1] ) ), _mm256_mul_ps( a[2], b[2] ) );
+    }
+
+    // the eight lights' (x,y,z,w) from p, p + uStride, ... p + 7*uStride
+    CPU_SIMD_TARGET_AVX2 static inline void LoadFloat4AVX2( const float* p, unsigned uStride, __m256& x, __m256& y, __m256& z, __m256& w )
+    {
+        // (light n in the low half, light n + 4 in the high half)
+        const __m256 Light0 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p ) ), _mm_loadu_ps( p + 4*uStride ), 1 );
+        const __m256 Light1 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + uStride ) ), _mm_loadu_ps( p + 5*uStride ), 1 );
+        const __m256 Light2 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + 2*uStride ) ), _mm_loadu_ps( p + 6*uStride ), 1 );
+        const __m256 Light3 = _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p + 3*uStride ) ), _mm_loadu_ps( p + 7*uStride ), 1 );
+
+        const __m256 xy0 = _mm256_unpacklo_ps( Light0, Light1 );
+        const __m256 zw0 = _mm256_unpackhi_ps( Light0, Light1 );
+        const __m256 xy1 = _mm256_unpacklo_ps( Light2, Light3 );
+        const __m256 zw1 = _mm256_unpackhi_ps( Light2, Light3 );
+        x = _mm256_shuffle_ps( xy0, xy1, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+        y = _mm256_shuffle_ps( xy0, xy1, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+        z = _mm256_shuffle_ps( zw0, zw1, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+        w = _mm256_shuffle_ps( zw0, zw1, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+    }
+
+    // the eight lights' (x,y,z,w) at p, p + uStride, ... p + 7*uStride
+    CPU_SIMD_TARGET_AVX2 static inline void StoreFloat4AVX2( float* p, unsigned uStride, __m256 x, __m256 y, __m256 z, __m256 w )
+    {
+        // (light n in the low half, light n + 4 in the high half)
+        const __m256 xy0 = _mm256_unpacklo_ps( x, y );
+        const __m256 xy1 = _mm256_unpackhi_ps( x, y );
+        const __m256 zw0 = _mm256_unpacklo_ps( z, w );
+        const __m256 zw1 = _mm256_unpackhi_ps( z, w );
+        const __m256 Light0 = _mm256_shuffle_ps( xy0, zw0, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+        const __m256 Light1 = _mm256_shuffle_ps( xy0, zw0, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+        const __m256 Light2 = _mm256_shuffle_ps( xy1, zw1, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+        const __m256 Light3 = _mm256_shuffle_ps( xy1, zw1, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+
+        _mm_storeu_ps( p, _mm256_castps256_ps128( Light0 ) );
+        _mm_storeu_ps( p + uStride, _mm256_castps256_ps128( Light1 ) );
+        _mm_storeu_ps( p + 2*uStride, _mm256_castps256_ps128( Light2 ) );
+        _mm_storeu_ps( p + 3*uStride, _mm256_castps256_ps128( Light3 ) );
+        _mm_storeu_ps( p + 4*uStride, _mm256_extractf128_ps( Light0, 1 ) );
+        _mm_storeu_ps( p + 5*uStride, _mm256_extractf128_ps( Light1, 1 ) );
+        _mm_storeu_ps( p + 6*uStride, _mm256_extractf128_ps( Light2, 1 ) );
+        _mm_storeu_ps( p + 7*uStride, _mm256_extractf128_ps( Light3, 1 ) );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static void CalcShadowMatricesAVX2( const __m256 Eye[3], __m256 FarZ, const ShadowBasisAVX2& Basis, __m256 FocalLength, __m256 InvFocalLength,
+        float* pViewProj, float* pViewProjInv, unsigned uStride )
+    {
+        const __m256 NearZ = _mm256_set1_ps( CPU_SHADOW_NEAR_Z );
+        const __m256 InvNearZ = _mm256_set1_ps( INV_NEAR_Z );
+        const __m256 Zero = _mm256_setzero_ps();
+        const __m256 Q = _mm256_div_ps( FarZ, _mm256_sub_ps( FarZ, NearZ ) );
+        const __m256 K = _mm256_div_ps( _mm256_sub_ps( FarZ, NearZ ), _mm256_mul_ps( FarZ, NearZ ) );
+
+        const __m256 DotX = Dot3AVX2( Basis.X, Eye );
+        const __m256 DotY = Dot3AVX2( Basis.Y, Eye );
+        const __m256 DotZ = Dot3AVX2( Basis.Z, Eye );
+
+        StoreFloat4AVX2( pViewProj, uStride, _mm256_mul_ps( FocalLength, Basis.X[0] ), _mm256_mul_ps( FocalLength, Basis.X[1] ), _mm256_mul_ps( FocalLength, Basis.X[2] ),
+            NegateAVX2( _mm256_mul_ps( FocalLength, DotX ) ) );
+        StoreFloat4AVX2( pViewProj + 4, uStride, _mm256_mul_ps( FocalLength, Basis.Y[0] ), _mm256_mul_ps( FocalLength, Basis.Y[1] ), _mm256_mul_ps( FocalLength, Basis.Y[2] ),
+            NegateAVX2( _mm256_mul_ps( FocalLength, DotY ) ) );
+        StoreFloat4AVX2( pViewProj + 8, uStride, _mm256_mul_ps( Q, Basis.Z[0] ), _mm256_mul_ps( Q, Basis.Z[1] ), _mm256_mul_ps( Q, Basis.Z[2] ),
+            NegateAVX2( _mm256_mul_ps( Q, _mm256_add_ps( DotZ, NearZ ) ) ) );
+        StoreFloat4AVX2( pViewProj + 12, uStride, Basis.Z[0], Basis.Z[1], Basis.Z[2], NegateAVX2( DotZ ) );
+
+        for( int i = 0; i < 3; i++ )
+        {
+            StoreFloat4AVX2( pViewProjInv + 4*i, uStride, _mm256_mul_ps( Basis.X[i], InvFocalLength ), _mm256_mul_ps( Basis.Y[i], InvFocalLength ),
+                NegateAVX2( _mm256_mul_ps( Eye[i], K ) ), _mm256_add_ps( Basis.Z[i], _mm256_mul_ps( Eye[i], InvNearZ ) ) );
+        }
+        StoreFloat4AVX2( pViewProjInv + 12, uStride, Zero, Zero, NegateAVX2( K ), InvNearZ );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static void CalcPointLightMatricesAVX2( const CPUFloat4* pPositionAndRadius, unsigned uLight, const ShadowBasis Faces[6], float fFocalLength, float fInvFocalLength,
+        CPUMatrix* pViewProj, CPUMatrix* pViewProjInv )
+    {
+        __m256 Eye[3], FarZ;
+        LoadFloat4AVX2( &pPositionAndRadius[uLight].x, 4, Eye[0], Eye[1], Eye[2], FarZ );
+
+        for( int nFace = 0; nFace < 6; nFace++ )
+        {
+            ShadowBasisAVX2 Basis;
+            for( int i = 0; i < 3; i++ )
+            {
+                Basis.X[i] = _mm256_set1_ps( Faces[nFace].X[i] );
+                Basis.Y[i] = _mm256_set1_ps( Faces[nFace].Y[i] );
+                Basis.Z[i] = _mm256_set1_ps( Faces[nFace].Z[i] );
+            }
+
+            CalcShadowMatricesAVX2( Eye, FarZ, Basis, _mm256_set1_ps( fFocalLength ), _mm256_set1_ps( fInvFocalLength ),
+                &pViewProj[6*uLight + nFace].m[0][0], &pViewProjInv[6*uLight + nFace].m[0][0], 6*16 );
+        }
+    }
+
+    CPU_SIMD_TARGET_AVX2 static void CalcSpotLightMatricesAVX2( const CPUFloat4* pPositionAndRadius, const CPUFloat4* pLookAt, unsigned uLight, float fFocalLength, float fInvFocalLength,
+        CPUMatrix* pViewProj, CPUMatrix* pViewProjInv )
+    {
+        __m256 Eye[3], FarZ, LookAt[3], Unused;
+        LoadFloat4AVX2( &pPositionAndRadius[uLight].x, 4, Eye[0], Eye[1], Eye[2], FarZ );
+        LoadFloat4AVX2( &pLookAt[uLight].x, 4, LookAt[0], LookAt[1], LookAt[2], Unused );
+
+        // see GetSpotBasis
+        const __m256 dx = _mm256_sub_ps( LookAt[0], Eye[0] );
+        const __m256 dy = _mm256_sub_ps( LookAt[1], Eye[1] );
+        const __m256 dz = _mm256_sub_ps( LookAt[2], Eye[2] );
+        const __m256 Length = _mm256_sqrt_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ), _mm256_mul_ps( dz, dz ) ) );
+
+        ShadowBasisAVX2 Basis;
+        Basis.Z[0] = _mm256_div_ps( dx, Length );
+        Basis.Z[1] = _mm256_div_ps( dy, Length );
+        Basis.Z[2] = _mm256_div_ps( dz, Length );
+
+        const __m256 LengthXZ = _mm256_sqrt_ps( _mm256_add_ps( _mm256_mul_ps( Basis.Z[2], Basis.Z[2] ), _mm256_mul_ps( Basis.Z[0], Basis.Z[0] ) ) );
+        Basis.X[0] = _mm256_div_ps( Basis.Z[2], LengthXZ );
+        Basis.X[1] = _mm256_setzero_ps();
+        Basis.X[2] = NegateAVX2( _mm256_div_ps( Basis.Z[0], LengthXZ ) );
+
+        Basis.Y[0] = _mm256_mul_ps( Basis.Z[1], Basis.X[2] );
+        Basis.Y[1] = _mm256_sub_ps( _mm256_mul_ps( Basis.Z[2], Basis.X[0] ), _mm256_mul_ps( Basis.Z[0], Basis.X[2] ) );
+        Basis.Y[2] = NegateAVX2( _mm256_mul_ps( Basis.Z[1], Basis.X[0] ) );
+
+        CalcShadowMatricesAVX2( Eye, FarZ, Basis, _mm256_set1_ps( fFocalLength ), _mm256_set1_ps( fInvFocalLength ),
+            &pViewProj[uLight].m[0][0], &pViewProjInv[uLight].m[0][0], 16 );
+    }
+#endif
+
+    //--------------------------------------------------------------------------------------
+    // Point lights, in blocks of eight in parallel. A partial last block goes through the
+    // scalar path, since the SIMD paths write every lane.
+    //--------------------------------------------------------------------------------------
+    void CalcCPUPointLightShadowMatrices( const CPUFloat4* pPositionAndRadius, unsigned uNumLights,
+        CPUMatrix* pViewProj, CPUMatrix* pViewProjInv, CPUSIMDLevel Level, CPUTaskScheduler* pScheduler )
+    {
+        const CPUSIMDLevel ResolvedLevel = ResolveCPUSIMDLevel( Level );
+        const unsigned uNumBlocks = ( uNumLights + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+        const float fFocalLength = GetFocalLength( CPU_POINT_SHADOW_FOV );
+        const float fInvFocalLength = 1.0f / fFocalLength;
+
+        ShadowBasis Faces[6];
+        for( int nFace = 0; nFace < 6; nFace++ )
+        {
+            GetFaceBasis( nFace, Faces[nFace] );
+        }
+
+        CPUTaskScheduler::RangeFunction CalcBlocks = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned uBlock = uBegin; uBlock < uEnd; uBlock++ )
+            {
+                const unsigned uFirstLight = uBlock*BLOCK_SIZE;
+                const unsigned uNumLanes = std::min( uNumLights - uFirstLight, BLOCK_SIZE );
+
+#if CPU_SIMD_X86
+                if( uNumLanes == BLOCK_SIZE && ResolvedLevel == CPU_SIMD_AVX2 )
+                {
+                    CalcPointLightMatricesAVX2( pPositionAndRadius, uFirstLight, Faces, fFocalLength, fInvFocalLength, pViewProj, pViewProjInv );
+                    continue;
+                }
+                if( uNumLanes == BLOCK_SIZE && ResolvedLevel == CPU_SIMD_SSE )
+                {
+                    CalcPointLightMatricesSSE( pPositionAndRadius, uFirstLight, Faces, fFocalLength, fInvFocalLength, pViewProj, pViewProjInv );
+                    CalcPointLightMatricesSSE( pPositionAndRadius, uFirstLight + 4, Faces, fFocalLength, fInvFocalLength, pViewProj, pViewProjInv );
+                    continue;
+                }
+#endif
+                for( unsigned uLight = uFirstLight; uLight < uFirstLight + uNumLanes; uLight++ )
+                {
+                    for( int nFace = 0; nFace < 6; nFace++ )
+                    {
+                        CalcShadowMatricesScalar( pPositionAndRadius[uLight], Faces[nFace], fFocalLength, fInvFocalLength, pViewProj[6*uLight + nFace], pViewProjInv[6*uLight + nFace] );
+                    }
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumBlocks, 16, CalcBlocks );
+        }
+        else
+        {
+            CalcBlocks( 0, uNumBlocks, 0 );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Spot lights, the same way
+    //--------------------------------------------------------------------------------------
+    void CalcCPUSpotLightShadowMatrices( const CPUFloat4* pPositionAndRadius, const CPUFloat4* pLookAt, unsigned uNumLights,
+        CPUMatrix* pViewProj, CPUMatrix* pViewProjInv, CPUSIMDLevel Level, CPUTaskScheduler* pScheduler )
+    {
+        const CPUSIMDLevel ResolvedLevel = ResolveCPUSIMDLevel( Level );
+        const unsigned uNumBlocks = ( uNumLights + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+        const float fFocalLength = GetFocalLength( CPU_SPOT_SHADOW_FOV );
+        const float fInvFocalLength = 1.0f / fFocalLength;
+
+        CPUTaskScheduler::RangeFunction CalcBlocks = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned uBlock = uBegin; uBlock < uEnd; uBlock++ )
+            {
+                const unsigned uFirstLight = uBlock*BLOCK_SIZE;
+                const unsigned uNumLanes = std::min( uNumLights - uFirstLight, BLOCK_SIZE );
+
+#if CPU_SIMD_X86
+                if( uNumLanes == BLOCK_SIZE && ResolvedLevel == CPU_SIMD_AVX2 )
+                {
+                    CalcSpotLightMatricesAVX2( pPositionAndRadius, pLookAt, uFirstLight, fFocalLength, fInvFocalLength, pViewProj, pViewProjInv );
+                    continue;
+                }
+                if( uNumLanes == BLOCK_SIZE && ResolvedLevel == CPU_SIMD_SSE )
+                {
+                    CalcSpotLightMatricesSSE( pPositionAndRadius, pLookAt, uFirstLight, fFocalLength, fInvFocalLength, pViewProj, pViewProjInv );
+                    CalcSpotLightMatricesSSE( pPositionAndRadius, pLookAt, uFirstLight + 4, fFocalLength, fInvFocalLength, pViewProj, pViewProjInv );
+                    continue;
+                }
+#endif
+                for( unsigned uLight = uFirstLight; uLight < uFirstLight + uNumLanes; uLight++ )
+                {
+                    ShadowBasis Basis;
+                    GetSpotBasis( pPositionAndRadius[uLight], pLookAt[uLight], Basis );
+                    CalcShadowMatricesScalar( pPositionAndRadius[uLight], Basis, fFocalLength, fInvFocalLength, pViewProj[uLight], pViewProjInv[uLight] );
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumBlocks, 16, CalcBlocks );
+        }
+        else
+        {
+            CalcBlocks( 0, uNumBlocks, 0 );
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUShadowMatrices.h
+//
+// The shadow map view-projection matrices of the shadow-casting lights, and their
+// inverses, for a whole batch of lights at once. The lights are the same cameras as in
+// LightUtil: XMMatrixLookAtLH times XMMatrixPerspectiveFovLH, with a square viewport, a
+// near plane at CPU_SHADOW_NEAR_Z and the light's radius as the far plane. The inverse
+// of such a matrix has a closed form (the transposed view basis, the eye position and
+// the inverted projection terms), so no general 4x4 inverse is needed, and four (SSE)
+// or eight (AVX2) lights are computed at a time. Every SIMD level gives the same bits.
+// Both matrices are written transposed, as the shaders read them.
+// This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPULightCulling.h"
+#include "CPUSIMD.h"
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+
+    static const float CPU_SHADOW_NEAR_Z = 2.0f;
+
+    // vertical fields of view, in degrees: a cube map face, and a cone of half angle
+    // 35.26438968 degrees (see the spot light cone in LightUtil::InitLights)
+    static const float CPU_POINT_SHADOW_FOV = 90.0f;
+    static const float CPU_SPOT_SHADOW_FOV = 70.52877936f;
+
+    // Six matrices per light, pViewProj[6*i + nFace], in the cube map face order of the
+    // shadow renderer: +x, -x, +y, -y, -z, +z. The far plane is the light's radius (w).
+    void CalcCPUPointLightShadowMatrices( const CPUFloat4* pPositionAndRadius, unsigned uNumLights,
+        CPUMatrix* pViewProj, CPUMatrix* pViewProjInv, CPUSIMDLevel Level, CPUTaskScheduler* pScheduler );
+
+    // One matrix per light, looking from the light's position at pLookAt[i] (w is unused),
+    // with +y as the up vector, so a spot light must not point straight up or down
+    void CalcCPUSpotLightShadowMatrices( const CPUFloat4* pPositionAndRadius, const CPUFloat4* pLookAt, unsigned uNumLights,
+        CPUMatrix* pViewProj, CPUMatrix* pViewProjInv, CPUSIMDLevel Level, CPUTaskScheduler* pScheduler );
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
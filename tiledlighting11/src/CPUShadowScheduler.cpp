@@ -0,0 +1,378 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUShadowScheduler.cpp
+//
+// Importance-based shadow slot and face scheduling on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPUShadowScheduler.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    static const unsigned kNumFaces[CPU_SHADOW_CASTER_NUM_TYPES] = { 6, 1 };
+
+    // the per-face frame numbers of a caster that was never rendered, or is up to date
+    static const unsigned NEVER_RENDERED = 0xFFFFFFFFu;
+    static const unsigned UP_TO_DATE = 0xFFFFFFFFu;
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUShadowScheduler::CPUShadowScheduler()
+    {
+        Reset( CPUShadowSchedulerDesc() );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUShadowScheduler::~CPUShadowScheduler()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Free every slot and forget every shadow map
+    //--------------------------------------------------------------------------------------
+    void CPUShadowScheduler::Reset( const CPUShadowSchedulerDesc& Desc )
+    {
+        m_Desc = Desc;
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        m_uFrame = 0;
+
+        m_Casters.clear();
+        m_SlotOwners[CPU_SHADOW_CASTER_POINT].assign( Desc.uNumPointSlots, CPU_SHADOW_NO_SLOT );
+        m_SlotOwners[CPU_SHADOW_CASTER_SPOT].assign( Desc.uNumSpotSlots, CPU_SHADOW_NO_SLOT );
+        m_FaceUpdates.clear();
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Projected area of a bounding sphere as a fraction of the screen
+    //--------------------------------------------------------------------------------------
+    float CPUShadowScheduler::GetScreenCoverage( const CPUMatrix& mView, const CPUMatrix& mProjection, const CPUFloat4& CenterAndRadius, float& fDistance )
+    {
+        const float (*m)[4] = mView.m;
+        const CPUFloat4& c = CenterAndRadius;
+        const float x = c.x*m[0][0] + c.y*m[1][0] + c.z*m[2][0] + m[3][0];
+        const float y = c.x*m[0][1] + c.y*m[1][1] + c.z*m[2][1] + m[3][1];
+        const float z = c.x*m[0][2] + c.y*m[1][2] + c.z*m[2][2] + m[3][2];
+        const float r = c.w;
+
+        const float fDistanceSq = x*x + y*y + z*z;
+        fDistance = sqrtf( fDistanceSq );
+        if( fDistanceSq <= r*r )
+        {
+            return 1.0f;
+        }
+
+        // behind the camera, or outside one of the side planes through the eye,
+        // whose normals are (+-sx, 0, -1) and (0, +-sy, -1) before normalizing
+        const float sx = mProjection.m[0][0];
+        const float sy = mProjection.m[1][1];
+        if( z + r <= 0.0f ||
+            fabsf( x )*sx - z > r*sqrtf( sx*sx + 1.0f ) ||
+            fabsf( y )*sy - z > r*sqrtf( sy*sy + 1.0f ) )
+        {
+            return 0.0f;
+        }
+
+        // a disc with the sphere's angular radius, in normalized device coordinates (4 units of area)
+        const float fTanSq = r*r / ( fDistanceSq - r*r );
+        const float fArea = 3.14159265f*sx*sy*fTanSq;
+        return std::min( 0.25f*fArea, 1.0f );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Highest score first, ties by index, so that the ranking does not depend on the sort
+    //--------------------------------------------------------------------------------------
+    bool CPUShadowScheduler::CompareCasters( const RankedCaster& A, const RankedCaster& B )
+    {
+        if( A.fScore != B.fScore )
+        {
+            return A.fScore > B.fScore;
+        }
+        return A.uCaster < B.uCaster;
+    }
+
+    bool CPUShadowScheduler::CompareFaces( const RankedFace& A, const RankedFace& B )
+    {
+        if( A.uClass != B.uClass )
+        {
+            return A.uClass < B.uClass;
+        }
+        if( A.fPriority != B.fPriority )
+        {
+            return A.fPriority > B.fPriority;
+        }
+        if( A.uCaster != B.uCaster )
+        {
+            return A.uCaster < B.uCaster;
+        }
+        return A.uFace < B.uFace;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Give a caster's slot back
+    //--------------------------------------------------------------------------------------
+    void CPUShadowScheduler::ReleaseSlot( unsigned uCaster )
+    {
+        CasterState& State = m_Casters[uCaster];
+        if( State.uSlot != CPU_SHADOW_NO_SLOT )
+        {
+            m_SlotOwners[State.uType][State.uSlot] = CPU_SHADOW_NO_SLOT;
+            State.uSlot = CPU_SHADOW_NO_SLOT;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The best visible casters of a type hold its slots. Casters that hold a slot compete
+    // with their importance scaled by the hysteresis factor, and keep it while they are
+    // not visible until a visible caster needs it.
+    //--------------------------------------------------------------------------------------
+    void CPUShadowScheduler::AssignSlots( unsigned uType )
+    {
+        std::vector<unsigned>& SlotOwners = m_SlotOwners[uType];
+        const unsigned uNumSlots = (unsigned)SlotOwners.size();
+
+        m_RankedCasters.clear();
+        for( unsigned i = 0; i < (unsigned)m_Casters.size(); i++ )
+        {
+            const CasterState& State = m_Casters[i];
+            const bool bHasSlot = ( State.uSlot != CPU_SHADOW_NO_SLOT );
+            if( State.uType == uType && ( State.fImportance > 0.0f || bHasSlot ) )
+            {
+                RankedCaster Caster = { bHasSlot ? State.fImportance*m_Desc.fSlotHysteresis : State.fImportance, i };
+                m_RankedCasters.push_back( Caster );
+            }
+        }
+
+        const unsigned uNumWinners = std::min( uNumSlots, (unsigned)m_RankedCasters.size() );
+        std::partial_sort( m_RankedCasters.begin(), m_RankedCasters.begin() + uNumWinners, m_RankedCasters.end(), CompareCasters );
+
+        for( unsigned i = uNumWinners; i < (unsigned)m_RankedCasters.size(); i++ )
+        {
+            ReleaseSlot( m_RankedCasters[i].uCaster );
+        }
+
+        // newcomers take the free slots in order
+        unsigned uFreeSlot = 0;
+        for( unsigned i = 0; i < uNumWinners; i++ )
+        {
+            CasterState& State = m_Casters[m_RankedCasters[i].uCaster];
+            if( State.uSlot != CPU_SHADOW_NO_SLOT )
+            {
+                continue;
+            }
+
+            while( SlotOwners[uFreeSlot] != CPU_SHADOW_NO_SLOT )
+            {
+                uFreeSlot++;
+            }
+            assert( uFreeSlot < uNumSlots );
+
+            SlotOwners[uFreeSlot] = m_RankedCasters[i].uCaster;
+            State.uSlot = uFreeSlot;
+            std::fill( State.RenderedFrame, State.RenderedFrame + 6, NEVER_RENDERED );
+            std::fill( State.StaleFrame, State.StaleFrame + 6, m_uFrame );
+            m_Stats.uNumSlotChanges++;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Pick the faces to render: out of date faces first, then refreshes, each in order
+    // of importance times the frames they have waited
+    //--------------------------------------------------------------------------------------
+    void CPUShadowScheduler::ScheduleFaces()
+    {
+        m_RankedFaces.clear();
+        for( unsigned uType = 0; uType < CPU_SHADOW_CASTER_NUM_TYPES; uType++ )
+        {
+            const std::vector<unsigned>& SlotOwners = m_SlotOwners[uType];
+            for( size_t uSlot = 0; uSlot < SlotOwners.size(); uSlot++ )
+            {
+                const unsigned uCaster = SlotOwners[uSlot];
+                if( uCaster == CPU_SHADOW_NO_SLOT || m_Casters[uCaster].fImportance == 0.0f )
+                {
+                    continue;
+                }
+
+                const CasterState& State = m_Casters[uCaster];
+                for( unsigned uFace = 0; uFace < kNumFaces[uType]; uFace++ )
+                {
+                    const unsigned uRendered = State.RenderedFrame[uFace];
+                    RankedFace Face = { 0, 0.0f, uCaster, uFace };
+                    unsigned uWait;
+                    if( State.StaleFrame[uFace] != UP_TO_DATE )
+                    {
+                        uWait = m_uFrame - State.StaleFrame[uFace];
+                    }
+                    else if( m_Desc.uRefreshInterval > 0 && m_uFrame - uRendered >= m_Desc.uRefreshInterval )
+                    {
+                        Face.uClass = 1;
+                        uWait = m_uFrame - uRendered - m_Desc.uRefreshInterval;
+                    }
+                    else
+                    {
+                        continue;
+                    }
+
+                    Face.fPriority = State.fImportance*( 1.0f + m_Desc.fWaitWeight*uWait );
+                    m_RankedFaces.push_back( Face );
+                }
+            }
+        }
+
+        const unsigned uNumUpdates = std::min( m_Desc.uMaxFacesPerFrame, (unsigned)m_RankedFaces.size() );
+        std::partial_sort( m_RankedFaces.begin(), m_RankedFaces.begin() + uNumUpdates, m_RankedFaces.end(), CompareFaces );
+
+        m_FaceUpdates.resize( uNumUpdates );
+        for( unsigned i = 0; i < uNumUpdates; i++ )
+        {
+            const RankedFace& Face = m_RankedFaces[i];
+            CasterState& State = m_Casters[Face.uCaster];
+            State.RenderedFrame[Face.uFace] = m_uFrame;
+            State.StaleFrame[Face.uFace] = UP_TO_DATE;
+
+            m_FaceUpdates[i].uCaster = Face.uCaster;
+            m_FaceUpdates[i].uSlot = State.uSlot;
+            m_FaceUpdates[i].uFace = Face.uFace;
+        }
+        m_Stats.uNumFaceUpdates = uNumUpdates;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Visible casters, and the faces shown out of date
+    //--------------------------------------------------------------------------------------
+    void CPUShadowScheduler::UpdateStats()
+    {
+        for( size_t i = 0; i < m_Casters.size(); i++ )
+        {
+            const CasterState& State = m_Casters[i];
+            if( State.fImportance == 0.0f )
+            {
+                continue;
+            }
+
+            m_Stats.uNumVisibleCasters++;
+            if( State.uSlot == CPU_SHADOW_NO_SLOT )
+            {
+                m_Stats.uNumUnslottedCasters++;
+                continue;
+            }
+
+            for( unsigned uFace = 0; uFace < kNumFaces[State.uType]; uFace++ )
+            {
+                if( State.StaleFrame[uFace] != UP_TO_DATE )
+                {
+                    m_Stats.uNumStaleFaces++;
+                    m_Stats.uMaxStaleFrames = std::max( m_Stats.uMaxStaleFrames, m_uFrame - State.StaleFrame[uFace] + 1 );
+                }
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Schedule one frame
+    //--------------------------------------------------------------------------------------
+    void CPUShadowScheduler::Update( const CPUMatrix& mView, const CPUMatrix& mProjection, const CPUShadowCaster* pCasters, unsigned uNumCasters, CPUTaskScheduler* pScheduler )
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+
+        // casters past the end of the array are gone
+        for( unsigned i = uNumCasters; i < (unsigned)m_Casters.size(); i++ )
+        {
+            ReleaseSlot( i );
+        }
+
+        CasterState NewState;
+        NewState.fImportance = 0.0f;
+        NewState.uType = CPU_SHADOW_CASTER_POINT;
+        NewState.uSlot = CPU_SHADOW_NO_SLOT;
+        std::fill( NewState.RenderedFrame, NewState.RenderedFrame + 6, NEVER_RENDERED );
+        std::fill( NewState.StaleFrame, NewState.StaleFrame + 6, UP_TO_DATE );
+        m_Casters.resize( uNumCasters, NewState );
+
+        for( unsigned i = 0; i < uNumCasters; i++ )
+        {
+            assert( pCasters[i].uType < CPU_SHADOW_CASTER_NUM_TYPES );
+            if( m_Casters[i].uType != pCasters[i].uType )
+            {
+                ReleaseSlot( i );
+                m_Casters[i].uType = pCasters[i].uType;
+            }
+        }
+
+        CPUTaskScheduler::RangeFunction ScoreCasters = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned i = uBegin; i < uEnd; i++ )
+            {
+                const CPUShadowCaster& Caster = pCasters[i];
+                CasterState& State = m_Casters[i];
+
+                float fDistance;
+                const float fCoverage = GetScreenCoverage( mView, mProjection, Caster.CenterAndRadius, fDistance );
+                const float r = Caster.CenterAndRadius.w;
+                State.fImportance = ( fCoverage >= m_Desc.fMinCoverage && fCoverage > 0.0f ) ? fCoverage*r / ( r + m_Desc.fDistanceWeight*fDistance ) : 0.0f;
+
+                // a face that is already out of date stays out of date since the earlier frame
+                if( Caster.bMoved && State.uSlot != CPU_SHADOW_NO_SLOT )
+                {
+                    for( unsigned uFace = 0; uFace < 6; uFace++ )
+                    {
+                        State.StaleFrame[uFace] = std::min( State.StaleFrame[uFace], m_uFrame );
+                    }
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumCasters, 256, ScoreCasters );
+        }
+        else
+        {
+            ScoreCasters( 0, uNumCasters, 0 );
+        }
+
+        for( unsigned uType = 0; uType < CPU_SHADOW_CASTER_NUM_TYPES; uType++ )
+        {
+            AssignSlots( uType );
+        }
+        ScheduleFaces();
+        UpdateStats();
+
+        m_uFrame++;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,209 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUShadowScheduler.h
+//
+// Decides which shadow-casting lights get a shadow map, and which shadow map faces are
+// rendered this frame, when there are more candidate casters than atlas slots or more
+// out-of-date faces than the per-frame budget of shadow passes. Casters are ranked by
+// the screen coverage of their bounding spheres, weighted towards the ones near the
+// camera; the best ones hold the slots, and the faces whose shadow maps are out of date
+// (the light moved, or just got its slot) are rendered in order of importance times
+// how long they have been waiting, so the work is spread over several frames.
+// This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+
+    enum CPUShadowCasterType
+    {
+        CPU_SHADOW_CASTER_POINT = 0,    // six cube map faces, in the CPUShadowMatrices face order
+        CPU_SHADOW_CASTER_SPOT,         // one face
+        CPU_SHADOW_CASTER_NUM_TYPES
+    };
+
+    static const unsigned CPU_SHADOW_NO_SLOT = 0xFFFFFFFFu;
+
+    struct CPUShadowCaster
+    {
+        CPUFloat4   CenterAndRadius;    // bounding sphere of the lit volume
+        unsigned    uType;              // CPUShadowCasterType
+        bool        bMoved;             // the light moved since the last frame, so its shadow maps are out of date
+    };
+
+    struct CPUShadowSchedulerDesc
+    {
+        CPUShadowSchedulerDesc()
+            :uNumPointSlots(12)
+            ,uNumSpotSlots(12)
+            ,uMaxFacesPerFrame(24)
+            ,uRefreshInterval(0)
+            ,fMinCoverage(0.0005f)
+            ,fDistanceWeight(0.5f)
+            ,fSlotHysteresis(1.25f)
+            ,fWaitWeight(0.5f)
+        {
+        }
+
+        // atlas slots, the same as MAX_NUM_SHADOWCASTING_POINTS and MAX_NUM_SHADOWCASTING_SPOTS by default
+        unsigned    uNumPointSlots;
+        unsigned    uNumSpotSlots;
+
+        // shadow passes per frame, a point light face or a spot light each
+        unsigned    uMaxFacesPerFrame;
+
+        // faces that are up to date but this many frames old are rendered again when the
+        // budget has room, for shadows of moving geometry; 0 never renders them again
+        unsigned    uRefreshInterval;
+
+        // casters covering less of the screen than this fraction are not shadowed
+        float       fMinCoverage;
+
+        // importance is the coverage times r/(r + fDistanceWeight*d), for a caster of
+        // radius r at distance d from the camera, so that of two casters covering the same
+        // area the one nearer the camera wins
+        float       fDistanceWeight;
+
+        // a caster holding a slot keeps it against casters up to this factor more important,
+        // so that slots do not change hands every frame between casters of similar importance
+        float       fSlotHysteresis;
+
+        // a face's priority is the importance times 1 + fWaitWeight*(frames it has waited)
+        float       fWaitWeight;
+    };
+
+    // One shadow pass: render uFace of the caster's shadow map into its slot of the atlas
+    struct CPUShadowFaceUpdate
+    {
+        unsigned    uCaster;
+        unsigned    uSlot;
+        unsigned    uFace;
+    };
+
+    struct CPUShadowSchedulerStats
+    {
+        // casters with at least fMinCoverage, and those of them left without a slot (unshadowed)
+        unsigned    uNumVisibleCasters;
+        unsigned    uNumUnslottedCasters;
+
+        // casters that got a slot this frame
+        unsigned    uNumSlotChanges;
+
+        // shadow passes this frame
+        unsigned    uNumFaceUpdates;
+
+        // faces of visible casters with a slot that are still out of date after this
+        // frame's passes, and the most frames any of them has been shown out of date
+        unsigned    uNumStaleFaces;
+        unsigned    uMaxStaleFrames;
+    };
+
+    class CPUShadowScheduler
+    {
+    public:
+        // Constructor / destructor
+        CPUShadowScheduler();
+        ~CPUShadowScheduler();
+
+        // Frees every slot and forgets every shadow map
+        void Reset( const CPUShadowSchedulerDesc& Desc );
+        const CPUShadowSchedulerDesc& GetDesc() const { return m_Desc; }
+
+        // Schedules one frame. pCasters[i] is the same light from frame to frame; casters
+        // past the end of a shorter array lose their slots. The returned face updates are
+        // assumed to be rendered this frame.
+        void Update( const CPUMatrix& mView, const CPUMatrix& mProjection, const CPUShadowCaster* pCasters, unsigned uNumCasters, CPUTaskScheduler* pScheduler );
+
+        const std::vector<CPUShadowFaceUpdate>& GetFaceUpdates() const { return m_FaceUpdates; }
+        const CPUShadowSchedulerStats& GetStats() const { return m_Stats; }
+
+        // The atlas slot of a caster (per caster type), or CPU_SHADOW_NO_SLOT
+        unsigned GetSlot( unsigned uCaster ) const { return uCaster < m_Casters.size() ? m_Casters[uCaster].uSlot : CPU_SHADOW_NO_SLOT; }
+
+        // The importance of a caster in the last frame, 0 if it was not visible
+        float GetImportance( unsigned uCaster ) const { return uCaster < m_Casters.size() ? m_Casters[uCaster].fImportance : 0.0f; }
+
+        // Projected area of a bounding sphere as a fraction of the screen, 0 outside the view
+        // frustum and 1 with the camera inside the sphere
+        static float GetScreenCoverage( const CPUMatrix& mView, const CPUMatrix& mProjection, const CPUFloat4& CenterAndRadius, float& fDistance );
+
+    private:
+        struct CasterState
+        {
+            float       fImportance;
+            unsigned    uType;
+            unsigned    uSlot;
+
+            // per face, the frame it was last rendered, and the first frame it was out of
+            // date after that (the light moved or got its slot), ~0u for none of either
+            unsigned    RenderedFrame[6];
+            unsigned    StaleFrame[6];
+        };
+
+        struct RankedCaster
+        {
+            float       fScore;
+            unsigned    uCaster;
+        };
+
+        struct RankedFace
+        {
+            unsigned    uClass;     // 0 for out of date faces, 1 for refreshes
+            float       fPriority;
+            unsigned    uCaster;
+            unsigned    uFace;
+        };
+
+        static bool CompareCasters( const RankedCaster& A, const RankedCaster& B );
+        static bool CompareFaces( const RankedFace& A, const RankedFace& B );
+
+        void ReleaseSlot( unsigned uCaster );
+        void AssignSlots( unsigned uType );
+        void ScheduleFaces();
+        void UpdateStats();
+
+        CPUShadowSchedulerDesc              m_Desc;
+        CPUShadowSchedulerStats             m_Stats;
+        unsigned                            m_uFrame;
+
+        std::vector<CasterState>            m_Casters;
+        std::vector<unsigned>               m_SlotOwners[CPU_SHADOW_CASTER_NUM_TYPES];
+
+        std::vector<RankedCaster>           m_RankedCasters;
+        std::vector<RankedFace>             m_RankedFaces;
+        std::vector<CPUShadowFaceUpdate>    m_FaceUpdates;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,325 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUSpotLightCulling.cpp
+//
+// Cone-accurate spot light culling on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPUSpotLightCulling.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // cos(45 degrees), above which the smallest sphere around a sector touches the apex
+    static const float COS_45_DEGREES = 0.70710678f;
+
+    // Largest value of dot(e, u) over the unit vectors u of a cone with half-angle theta,
+    // where fCosPhi = dot(e, axis), clamped at 0 for the apex. The extent of a sector of
+    // range R along e is R times this.
+    static float GetConeExtent( float fCosPhi, float fCosTheta, float fSinTheta )
+    {
+        if( fCosPhi >= fCosTheta )
+        {
+            return 1.0f;
+        }
+
+        // cos(phi - theta)
+        const float fSinPhi = sqrtf( std::max( 1.0f - fCosPhi*fCosPhi, 0.0f ) );
+        return std::max( fCosPhi*fCosTheta + fSinPhi*fSinTheta, 0.0f );
+    }
+
+    const char* GetCPUSpotCullingModeName( CPUSpotCullingMode Mode )
+    {
+        switch( Mode )
+        {
+        case CPU_SPOT_CULLING_SPHERE:               return "sphere";
+        case CPU_SPOT_CULLING_CONE_CONSERVATIVE:    return "cone-sphere";
+        case CPU_SPOT_CULLING_CONE_TIGHT:           return "cone";
+        default:                                    return "unknown";
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Half-precision conversions
+    //--------------------------------------------------------------------------------------
+    unsigned short CPUConvertF32ToF16( float fValue )
+    {
+        unsigned uFloatBits;
+        memcpy( &uFloatBits, &fValue, sizeof(uFloatBits) );
+
+        // no overflow, NaN or infinity handling, and denorms flush to (signed) zero
+        const int nExponent = (int)( ( uFloatBits & 0x7F800000u ) >> 23 ) - 127 + 15;
+        if( nExponent <= 0 )
+        {
+            return (unsigned short)( ( uFloatBits & 0x80000000u ) >> 16 );
+        }
+
+        const unsigned uSignBit = ( uFloatBits & 0x80000000u ) >> 16;
+        const unsigned uExponentBits = (unsigned)nExponent << 10;
+        const unsigned uMantissaBits = ( uFloatBits & 0x007FFFFFu ) >> 13;
+        return (unsigned short)( uSignBit | uExponentBits | uMantissaBits );
+    }
+
+    float CPUConvertF16ToF32( unsigned short uValue )
+    {
+        const unsigned uSignBit = ( (unsigned)uValue & 0x8000u ) << 16;
+        const unsigned uExponent = ( (unsigned)uValue >> 10 ) & 0x1F;
+        const unsigned uMantissa = (unsigned)uValue & 0x3FF;
+
+        unsigned uFloatBits = uSignBit;
+        if( uExponent != 0 )
+        {
+            uFloatBits |= ( ( uExponent - 15 + 127 ) << 23 ) | ( uMantissa << 13 );
+        }
+        else if( uMantissa != 0 )
+        {
+            // denorm, the GPU's R16G16B16A16_FLOAT load handles these too
+            float fValue = uMantissa / 16777216.0f;
+            return uSignBit ? -fValue : fValue;
+        }
+
+        float fValue;
+        memcpy( &fValue, &uFloatBits, sizeof(fValue) );
+        return fValue;
+    }
+
+    CPUSpotParams PackCPUSpotParams( const float LightDir[3], float fCosineOfConeAngle, float fFalloffRadius )
+    {
+        CPUSpotParams PackedParams;
+        PackedParams.fLightDirX = CPUConvertF32ToF16( LightDir[0] );
+        PackedParams.fLightDirY = CPUConvertF32ToF16( LightDir[1] );
+        PackedParams.fCosineOfConeAngleAndLightDirZSign = CPUConvertF32ToF16( fCosineOfConeAngle );
+        PackedParams.fFalloffRadius = CPUConvertF32ToF16( fFalloffRadius );
+
+        // put the sign bit for light dir z in the sign bit for the cone angle
+        if( LightDir[2] < 0.0f )
+        {
+            PackedParams.fCosineOfConeAngleAndLightDirZSign |= 0x8000;
+        }
+        else
+        {
+            PackedParams.fCosineOfConeAngleAndLightDirZSign &= 0x7FFF;
+        }
+
+        return PackedParams;
+    }
+
+    void CalcCPUSpotLightRotation( const float LightDir[3], CPUMatrix& Rotation )
+    {
+        // v = (0,-1,0) x dir = (-dir.z, 0, dir.x), e = -dir.y, h = 1/(1 + e)
+        const float vx = -LightDir[2];
+        const float vz = LightDir[0];
+        const float e = -LightDir[1];
+        const float h = 1.0f / ( 1.0f + e );
+        const float hxz = h*vx*vz;
+
+        const float Rows[4][4] =
+        {
+            { e + h*vx*vx,  vz,     hxz,            0.0f },
+            { -vz,          e,      vx,             0.0f },
+            { hxz,          -vx,    e + h*vz*vz,    0.0f },
+            { 0.0f,         0.0f,   0.0f,           1.0f },
+        };
+        memcpy( Rotation.m, Rows, sizeof(Rows) );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Decode and transform the cones
+    //--------------------------------------------------------------------------------------
+    void TransformSpotConesToViewSpace( const CPUMatrix& mView, const CPUFloat4* pCenterAndRadius, const CPUSpotParams* pSpotParams, unsigned uCount, CPUViewSpaceSpotCones& Cones )
+    {
+        Cones.ApexX.resize( uCount );
+        Cones.ApexY.resize( uCount );
+        Cones.ApexZ.resize( uCount );
+        Cones.DirX.resize( uCount );
+        Cones.DirY.resize( uCount );
+        Cones.DirZ.resize( uCount );
+        Cones.CosAngle.resize( uCount );
+        Cones.SinAngle.resize( uCount );
+        Cones.Range.resize( uCount );
+        Cones.MinZ.resize( uCount );
+        Cones.MaxZ.resize( uCount );
+        Cones.uCount = uCount;
+
+        const float (*m)[4] = mView.m;
+        for( unsigned i = 0; i < uCount; i++ )
+        {
+            const CPUFloat4& Sphere = pCenterAndRadius[i];
+            const CPUSpotParams& Params = pSpotParams[i];
+
+            // reconstruct z component of the light dir from x and y
+            float Dir[3];
+            Dir[0] = CPUConvertF16ToF32( Params.fLightDirX );
+            Dir[1] = CPUConvertF16ToF32( Params.fLightDirY );
+            Dir[2] = sqrtf( std::max( 1.0f - Dir[0]*Dir[0] - Dir[1]*Dir[1], 0.0f ) );
+
+            // the sign bit for cone angle is used to store the sign for the z component of the light dir
+            const float fCosineOfConeAngle = CPUConvertF16ToF32( Params.fCosineOfConeAngleAndLightDirZSign );
+            Dir[2] = ( fCosineOfConeAngle > 0.0f ) ? Dir[2] : -Dir[2];
+
+            // the top of the cone is r_bounding_sphere units away from the bounding sphere
+            // center along the negated light direction
+            const float Apex[3] = { Sphere.x - Sphere.w*Dir[0], Sphere.y - Sphere.w*Dir[1], Sphere.z - Sphere.w*Dir[2] };
+
+            Cones.ApexX[i] = Apex[0]*m[0][0] + Apex[1]*m[1][0] + Apex[2]*m[2][0] + m[3][0];
+            Cones.ApexY[i] = Apex[0]*m[0][1] + Apex[1]*m[1][1] + Apex[2]*m[2][1] + m[3][1];
+            Cones.ApexZ[i] = Apex[0]*m[0][2] + Apex[1]*m[1][2] + Apex[2]*m[2][2] + m[3][2];
+            Cones.DirX[i] = Dir[0]*m[0][0] + Dir[1]*m[1][0] + Dir[2]*m[2][0];
+            Cones.DirY[i] = Dir[0]*m[0][1] + Dir[1]*m[1][1] + Dir[2]*m[2][1];
+            Cones.DirZ[i] = Dir[0]*m[0][2] + Dir[1]*m[1][2] + Dir[2]*m[2][2];
+
+            const float fCos = fabsf( fCosineOfConeAngle );
+            Cones.CosAngle[i] = fCos;
+            Cones.SinAngle[i] = sqrtf( std::max( 1.0f - fCos*fCos, 0.0f ) );
+            Cones.Range[i] = CPUConvertF16ToF32( Params.fFalloffRadius );
+
+            Cones.MaxZ[i] = Cones.ApexZ[i] + Cones.Range[i]*GetConeExtent( Cones.DirZ[i], fCos, Cones.SinAngle[i] );
+            Cones.MinZ[i] = Cones.ApexZ[i] - Cones.Range[i]*GetConeExtent( -Cones.DirZ[i], fCos, Cones.SinAngle[i] );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Smallest sphere around each sector. Up to 45 degrees it passes through the apex and
+    // the rim of the cap, beyond that it is centered on the rim's circle.
+    //--------------------------------------------------------------------------------------
+    void GetSpotConeBoundingSpheres( const CPUViewSpaceSpotCones& Cones, CPUViewSpaceLights& Spheres )
+    {
+        const unsigned uPaddedCount = ( Cones.uCount + 7 ) & ~7u;
+        Spheres.X.assign( uPaddedCount, 0.0f );
+        Spheres.Y.assign( uPaddedCount, 0.0f );
+        Spheres.Z.assign( uPaddedCount, 0.0f );
+        Spheres.Radius.assign( uPaddedCount, 0.0f );
+        Spheres.uCount = Cones.uCount;
+
+        for( unsigned i = 0; i < Cones.uCount; i++ )
+        {
+            const float fRange = Cones.Range[i];
+            const float fCos = Cones.CosAngle[i];
+
+            float fOffset, fRadius;
+            if( fCos >= COS_45_DEGREES )
+            {
+                fOffset = fRange / ( 2.0f*fCos );
+                fRadius = fOffset;
+            }
+            else
+            {
+                fOffset = fRange*fCos;
+                fRadius = fRange*Cones.SinAngle[i];
+            }
+
+            // a little padding, since the sphere touches the sector
+            fRadius *= 1.0001f;
+
+            Spheres.X[i] = Cones.ApexX[i] + fOffset*Cones.DirX[i];
+            Spheres.Y[i] = Cones.ApexY[i] + fOffset*Cones.DirY[i];
+            Spheres.Z[i] = Cones.ApexZ[i] + fOffset*Cones.DirZ[i];
+            Spheres.Radius[i] = fRadius;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Sector vs. tile test with the halfZ split. For a plane through the origin with unit
+    // normal n, the sector reaches n.Apex - R*GetConeExtent(-n.Dir) on the inside, which is
+    // exact for each plane on its own, as the sphere test is.
+    //--------------------------------------------------------------------------------------
+    void CullSpotConesAgainstTile( const CPUViewSpaceSpotCones& Cones, const CPUTileFrustum& Frustum,
+        unsigned short* pListA, unsigned short* pListB, unsigned uListSize, unsigned& uCountA, unsigned& uCountB )
+    {
+        const float (*n)[3] = Frustum.Planes;
+        uCountA = 0;
+        uCountB = 0;
+
+        for( unsigned i = 0; i < Cones.uCount; i++ )
+        {
+            // depth first, it rejects most lights
+            const float fMinZ = Cones.MinZ[i];
+            const float fMaxZ = Cones.MaxZ[i];
+            if( fMaxZ <= Frustum.fMinZ || fMinZ >= Frustum.fMaxZ )
+            {
+                continue;
+            }
+
+            const float Apex[3] = { Cones.ApexX[i], Cones.ApexY[i], Cones.ApexZ[i] };
+            const float Dir[3] = { Cones.DirX[i], Cones.DirY[i], Cones.DirZ[i] };
+            const float fCos = Cones.CosAngle[i];
+            const float fSin = Cones.SinAngle[i];
+            const float fRange = Cones.Range[i];
+
+            bool bInside = true;
+            for( int p = 0; p < 4 && bInside; p++ )
+            {
+                // the sphere around the apex is a cheaper test for lights far outside the plane
+                const float fApexDist = n[p][0]*Apex[0] + n[p][1]*Apex[1] + n[p][2]*Apex[2];
+                if( fApexDist >= fRange )
+                {
+                    bInside = false;
+                    break;
+                }
+
+                const float fCosPhi = -( n[p][0]*Dir[0] + n[p][1]*Dir[1] + n[p][2]*Dir[2] );
+                bInside = ( fApexDist < fRange*GetConeExtent( fCosPhi, fCos, fSin ) );
+            }
+            if( !bInside )
+            {
+                continue;
+            }
+
+            if( fMaxZ > Frustum.fMinZ && fMinZ < Frustum.fHalfZ )
+            {
+                if( uCountA < uListSize ) pListA[uCountA] = (unsigned short)i;
+                uCountA++;
+            }
+            if( fMaxZ > Frustum.fHalfZ && fMinZ < Frustum.fMaxZ )
+            {
+                if( uCountB < uListSize ) pListB[uCountB] = (unsigned short)i;
+                uCountB++;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The lighting condition in DoSpotLighting
+    //--------------------------------------------------------------------------------------
+    bool IsPointInSpotCone( const CPUViewSpaceSpotCones& Cones, unsigned uCone, const float Pos[3], float fScale )
+    {
+        const float v[3] = { Pos[0] - Cones.ApexX[uCone], Pos[1] - Cones.ApexY[uCone], Pos[2] - Cones.ApexZ[uCone] };
+        const float fDistance = sqrtf( v[0]*v[0] + v[1]*v[1] + v[2]*v[2] );
+        if( fDistance <= 0.0f || fDistance >= fScale*Cones.Range[uCone] )
+        {
+            return false;
+        }
+
+        const float fCosine = ( v[0]*Cones.DirX[uCone] + v[1]*Cones.DirY[uCone] + v[2]*Cones.DirZ[uCone] ) / fDistance;
+        return fCosine > 1.0f - fScale*( 1.0f - Cones.CosAngle[uCone] );
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUSpotLightCulling.h
+//
+// Cone-accurate spot light culling on the CPU. A spot light lights the points within
+// its falloff radius of the cone apex and inside the cone angle (see DoSpotLighting),
+// which is a spherical sector. DoLightCulling only tests the bounding sphere stored in
+// g_SpotLightBufferCenterAndRadius; the functions here test the sector itself, or the
+// smallest sphere around it. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    const char* GetCPUSpotCullingModeName( CPUSpotCullingMode Mode );
+
+    // The same truncating conversion as AMD::ConvertF32ToF16, and its inverse
+    unsigned short CPUConvertF32ToF16( float fValue );
+    float CPUConvertF16ToF32( unsigned short uValue );
+
+    // Same as PackSpotParams in LightUtil.cpp
+    CPUSpotParams PackCPUSpotParams( const float LightDir[3], float fCosineOfConeAngle, float fFalloffRadius );
+
+    // Same as CalcSpotLightRotation in LightUtil.cpp: the transposed rotation from (0,-1,0)
+    // to the light direction, for debug drawing the cone
+    void CalcCPUSpotLightRotation( const float LightDir[3], CPUMatrix& Rotation );
+
+    // Decode the spot parameters as DoSpotLighting does, and move the cones to view space
+    void TransformSpotConesToViewSpace( const CPUMatrix& mView, const CPUFloat4* pCenterAndRadius, const CPUSpotParams* pSpotParams, unsigned uCount, CPUViewSpaceSpotCones& Cones );
+
+    // The smallest sphere around each cone, for the conservative mode
+    void GetSpotConeBoundingSpheres( const CPUViewSpaceSpotCones& Cones, CPUViewSpaceLights& Spheres );
+
+    // Cone vs. tile test with the halfZ split, with the same list semantics as CPULightCuller::CullLightsAgainstTile
+    void CullSpotConesAgainstTile( const CPUViewSpaceSpotCones& Cones, const CPUTileFrustum& Frustum,
+        unsigned short* pListA, unsigned short* pListB, unsigned uListSize, unsigned& uCountA, unsigned& uCountB );
+
+    // True if DoSpotLighting lights the view-space point Pos with cone uCone.
+    // fScale < 1 shrinks the cone, to stay clear of the boundary where float rounding decides.
+    bool IsPointInSpotCone( const CPUViewSpaceSpotCones& Cones, unsigned uCone, const float Pos[3], float fScale );
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
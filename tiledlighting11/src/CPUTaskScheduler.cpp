@@ -0,0 +1,236 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUTaskScheduler.cpp
+//
+// Work-stealing thread pool for the CPU-side (headless) code paths of the
+// TiledLighting11 sample.
+//--------------------------------------------------------------------------------------
+
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+
+namespace TiledLighting11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUTaskScheduler::CPUTaskScheduler( unsigned uNumThreads )
+        :m_uJobGeneration(0)
+        ,m_uNumActiveWorkers(0)
+        ,m_bShutdown(false)
+        ,m_pJobFunction(NULL)
+    {
+        if( uNumThreads == 0 )
+        {
+            uNumThreads = std::thread::hardware_concurrency();
+        }
+        if( uNumThreads == 0 )
+        {
+            uNumThreads = 1;
+        }
+
+        // queue 0 belongs to the calling thread
+        for( unsigned i = 0; i < uNumThreads; i++ )
+        {
+            m_Queues.push_back( new WorkQueue );
+        }
+
+        for( unsigned i = 1; i < uNumThreads; i++ )
+        {
+            m_Threads.push_back( std::thread( &CPUTaskScheduler::WorkerThreadMain, this, i ) );
+        }
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUTaskScheduler::~CPUTaskScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> Guard( m_JobLock );
+            m_bShutdown = true;
+        }
+        m_JobStarted.notify_all();
+
+        for( size_t i = 0; i < m_Threads.size(); i++ )
+        {
+            m_Threads[i].join();
+        }
+
+        for( size_t i = 0; i < m_Queues.size(); i++ )
+        {
+            delete m_Queues[i];
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Run Func over [0,uCount) on all threads
+    //--------------------------------------------------------------------------------------
+    void CPUTaskScheduler::ParallelFor( unsigned uCount, unsigned uGrainSize, const RangeFunction& Func )
+    {
+        if( uCount == 0 )
+        {
+            return;
+        }
+
+        if( uGrainSize == 0 )
+        {
+            uGrainSize = 1;
+        }
+
+        const unsigned uNumThreads = GetNumThreads();
+        const unsigned uNumChunks = ( uCount + uGrainSize - 1 ) / uGrainSize;
+
+        // nothing to share, so skip the wake-up cost
+        if( uNumThreads == 1 || uNumChunks == 1 )
+        {
+            Func( 0, uCount, 0 );
+            return;
+        }
+
+        // deal the chunks out in contiguous blocks, so that each thread starts
+        // with neighbouring (and therefore cache-friendly) work, and stealing
+        // only kicks in when the load is uneven
+        for( unsigned uThread = 0; uThread < uNumThreads; uThread++ )
+        {
+            unsigned uFirstChunk = ( uNumChunks * uThread ) / uNumThreads;
+            unsigned uLastChunk = ( uNumChunks * ( uThread + 1 ) ) / uNumThreads;
+
+            std::lock_guard<std::mutex> Guard( m_Queues[uThread]->Lock );
+            for( unsigned uChunk = uFirstChunk; uChunk < uLastChunk; uChunk++ )
+            {
+                Range Chunk;
+                Chunk.uBegin = uChunk * uGrainSize;
+                Chunk.uEnd = ( Chunk.uBegin + uGrainSize < uCount ) ? Chunk.uBegin + uGrainSize : uCount;
+                m_Queues[uThread]->Ranges.push_back( Chunk );
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> Guard( m_JobLock );
+            assert( m_pJobFunction == NULL );
+            m_pJobFunction = &Func;
+            m_uNumActiveWorkers = (unsigned)m_Threads.size();
+            m_uJobGeneration++;
+        }
+        m_JobStarted.notify_all();
+
+        RunChunks( 0 );
+
+        // every queue is empty now, but workers may still be finishing their last chunk
+        std::unique_lock<std::mutex> Lock( m_JobLock );
+        while( m_uNumActiveWorkers > 0 )
+        {
+            m_JobFinished.wait( Lock );
+        }
+        m_pJobFunction = NULL;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Worker threads sleep until a job is posted, then help drain the queues
+    //--------------------------------------------------------------------------------------
+    void CPUTaskScheduler::WorkerThreadMain( unsigned uThreadIndex )
+    {
+        unsigned uSeenGeneration = 0;
+
+        for( ;; )
+        {
+            {
+                std::unique_lock<std::mutex> Lock( m_JobLock );
+                while( !m_bShutdown && m_uJobGeneration == uSeenGeneration )
+                {
+                    m_JobStarted.wait( Lock );
+                }
+                if( m_bShutdown )
+                {
+                    return;
+                }
+                uSeenGeneration = m_uJobGeneration;
+            }
+
+            RunChunks( uThreadIndex );
+
+            {
+                std::lock_guard<std::mutex> Guard( m_JobLock );
+                assert( m_uNumActiveWorkers > 0 );
+                m_uNumActiveWorkers--;
+            }
+            m_JobFinished.notify_one();
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Execute chunks until there is nothing left to pop or steal
+    //--------------------------------------------------------------------------------------
+    void CPUTaskScheduler::RunChunks( unsigned uThreadIndex )
+    {
+        const RangeFunction& Func = *m_pJobFunction;
+
+        Range Chunk;
+        while( PopOrSteal( uThreadIndex, Chunk ) )
+        {
+            Func( Chunk.uBegin, Chunk.uEnd, uThreadIndex );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Take the most recent chunk from our own queue, or the oldest chunk from another thread's queue
+    //--------------------------------------------------------------------------------------
+    bool CPUTaskScheduler::PopOrSteal( unsigned uThreadIndex, Range& Chunk )
+    {
+        {
+            WorkQueue& Own = *m_Queues[uThreadIndex];
+            std::lock_guard<std::mutex> Guard( Own.Lock );
+            if( !Own.Ranges.empty() )
+            {
+                Chunk = Own.Ranges.back();
+                Own.Ranges.pop_back();
+                return true;
+            }
+        }
+
+        const unsigned uNumThreads = GetNumThreads();
+        for( unsigned i = 1; i < uNumThreads; i++ )
+        {
+            WorkQueue& Victim = *m_Queues[( uThreadIndex + i ) % uNumThreads];
+            std::lock_guard<std::mutex> Guard( Victim.Lock );
+            if( !Victim.Ranges.empty() )
+            {
+                Chunk = Victim.Ranges.front();
+                Victim.Ranges.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUTaskScheduler.h
+//
+// Work-stealing thread pool for the CPU-side (headless) code paths of the
+// TiledLighting11 sample. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler
+    {
+    public:
+        // Called with a half-open range [uBegin,uEnd) and the index of the thread running it.
+        // The thread index is in [0,GetNumThreads()) and can be used to address per-thread scratch memory.
+        typedef std::function<void( unsigned uBegin, unsigned uEnd, unsigned uThreadIndex )> RangeFunction;
+
+        // Constructor / destructor
+        // uNumThreads includes the calling thread, 0 means one per hardware thread
+        explicit CPUTaskScheduler( unsigned uNumThreads = 0 );
+        ~CPUTaskScheduler();
+
+        unsigned GetNumThreads() const { return (unsigned)m_Queues.size(); }
+
+        // Splits [0,uCount) into chunks of uGrainSize and runs them on all threads,
+        // including the calling thread. Idle threads steal chunks from busy ones.
+        // Returns when every chunk has finished. Not re-entrant.
+        void ParallelFor( unsigned uCount, unsigned uGrainSize, const RangeFunction& Func );
+
+    private:
+        struct Range
+        {
+            unsigned uBegin;
+            unsigned uEnd;
+        };
+
+        // one double-ended queue per thread: the owner pops from the back, thieves steal from the front
+        struct WorkQueue
+        {
+            std::mutex Lock;
+            std::deque<Range> Ranges;
+        };
+
+        // not copyable
+        CPUTaskScheduler( const CPUTaskScheduler& );
+        CPUTaskScheduler& operator=( const CPUTaskScheduler& );
+
+        void WorkerThreadMain( unsigned uThreadIndex );
+        void RunChunks( unsigned uThreadIndex );
+        bool PopOrSteal( unsigned uThreadIndex, Range& Chunk );
+
+        std::vector<WorkQueue*>     m_Queues;
+        std::vector<std::thread>    m_Threads;
+
+        std::mutex                  m_JobLock;
+        std::condition_variable     m_JobStarted;
+        std::condition_variable     m_JobFinished;
+        unsigned                    m_uJobGeneration;
+        unsigned                    m_uNumActiveWorkers;
+        bool                        m_bShutdown;
+        const RangeFunction*        m_pJobFunction;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
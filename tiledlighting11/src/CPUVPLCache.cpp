@@ -0,0 +1,294 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPUVPLCache.cpp
+//
+// Persistent VPLs on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPUVPLCache.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace TiledLighting11
+{
+    // RSMs per task
+    static const unsigned RSM_GRAIN_SIZE = 4;
+
+    static const unsigned SLOT_MASK = CPULightPool::MAX_CAPACITY - 1;
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUVPLCache::CPUVPLCache()
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUVPLCache::~CPUVPLCache()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Forget everything
+    //--------------------------------------------------------------------------------------
+    void CPUVPLCache::Reset( unsigned uCapacity )
+    {
+        const unsigned AttributeSizes[2] = { sizeof(CPUFloat4), sizeof(CPUVPLData) };
+        m_Pool.Reset( uCapacity, AttributeSizes, 2 );
+
+        m_RSMStates.clear();
+        m_RSMParams.clear();
+        m_RSMNumVPLs.clear();
+        m_Handles.clear();
+        m_SlotKeys.assign( uCapacity, 0 );
+
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Invalidation
+    //--------------------------------------------------------------------------------------
+    void CPUVPLCache::InvalidateRSM( unsigned uRSM )
+    {
+        if( uRSM < m_RSMStates.size() && m_RSMStates[uRSM] == RSM_CACHED )
+        {
+            m_RSMStates[uRSM] = RSM_INVALIDATED;
+        }
+    }
+
+    void CPUVPLCache::InvalidateAll()
+    {
+        m_RSMStates.assign( m_RSMStates.size(), RSM_NEW );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Where a VPL is
+    //--------------------------------------------------------------------------------------
+    unsigned CPUVPLCache::GetKey( unsigned uIndex ) const
+    {
+        return m_SlotKeys[m_Pool.GetHandle( uIndex ) & SLOT_MASK];
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Take the VPLs of an RSM out of the set
+    //--------------------------------------------------------------------------------------
+    void CPUVPLCache::RemoveRSM( unsigned uRSM )
+    {
+        CPULightHandle* pHandles = &m_Handles[(size_t)uRSM*CPU_RSM_SAMPLES_PER_RSM];
+        for( unsigned uSample = 0; uSample < CPU_RSM_SAMPLES_PER_RSM; uSample++ )
+        {
+            if( pHandles[uSample] != CPU_INVALID_LIGHT_HANDLE )
+            {
+                m_Stats.uNumMovedVPLs += ( m_Pool.GetDenseIndex( pHandles[uSample] ) + 1 != m_Pool.GetCount() ) ? 1 : 0;
+                m_Pool.Remove( pHandles[uSample] );
+                pHandles[uSample] = CPU_INVALID_LIGHT_HANDLE;
+                m_Stats.uNumRemovedVPLs++;
+            }
+        }
+        m_RSMNumVPLs[uRSM] = 0;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Find the RSMs whose VPLs are out of date, generate them again, and bring the set in
+    // line with what they made, sample by sample
+    //--------------------------------------------------------------------------------------
+    void CPUVPLCache::Update( const CPUVPLGenerationInput& Input, CPUTaskScheduler* pScheduler )
+    {
+        const unsigned uNumRSMs = Input.uNumSpotLights + 6*Input.uNumPointLights;
+        const unsigned long long uTotalReusedVPLs = m_Stats.uTotalReusedVPLs;
+        const unsigned long long uTotalRegeneratedVPLs = m_Stats.uTotalRegeneratedVPLs;
+
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        m_Stats.uNumRSMs = uNumRSMs;
+
+        // the RSMs past the end are gone
+        for( unsigned uRSM = uNumRSMs; uRSM < m_RSMStates.size(); uRSM++ )
+        {
+            RemoveRSM( uRSM );
+        }
+        m_RSMStates.resize( uNumRSMs, RSM_NEW );
+        m_RSMParams.resize( uNumRSMs );
+        m_RSMNumVPLs.resize( uNumRSMs, 0 );
+        m_Handles.resize( (size_t)uNumRSMs*CPU_RSM_SAMPLES_PER_RSM, CPU_INVALID_LIGHT_HANDLE );
+
+        m_DirtyRSMs.clear();
+        for( unsigned uRSM = 0; uRSM < uNumRSMs; uRSM++ )
+        {
+            CPURSMParams Params;
+            memset( &Params, 0, sizeof(Params) );
+            CPUGetRSMParams( Input, uRSM, Params );
+
+            if( m_RSMStates[uRSM] == RSM_NEW )
+            {
+                m_Stats.uNumNewRSMs++;
+            }
+            else if( m_RSMStates[uRSM] == RSM_INVALIDATED )
+            {
+                m_Stats.uNumInvalidatedRSMs++;
+            }
+            else if( memcmp( &Params, &m_RSMParams[uRSM], sizeof(Params) ) != 0 )
+            {
+                m_Stats.uNumChangedRSMs++;
+            }
+            else
+            {
+                m_Stats.uNumReusedRSMs++;
+                m_Stats.uNumReusedVPLs += m_RSMNumVPLs[uRSM];
+                continue;
+            }
+
+            m_RSMParams[uRSM] = Params;
+            m_RSMStates[uRSM] = RSM_CACHED;
+            m_DirtyRSMs.push_back( uRSM );
+        }
+
+        // every sample of the dirty RSMs
+        const unsigned uNumDirtyRSMs = (unsigned)m_DirtyRSMs.size();
+        const size_t uNumSamples = (size_t)uNumDirtyRSMs*CPU_RSM_SAMPLES_PER_RSM;
+        if( m_NewVPLFlags.size() < uNumSamples )
+        {
+            m_NewVPLFlags.resize( uNumSamples );
+            m_NewPositionAndRadius.resize( uNumSamples );
+            m_NewData.resize( uNumSamples );
+        }
+
+        CPUTaskScheduler::RangeFunction GenerateRSMs = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned i = uBegin; i < uEnd; i++ )
+            {
+                const CPURSMParams& Params = m_RSMParams[m_DirtyRSMs[i]];
+                for( unsigned uSample = 0; uSample < CPU_RSM_SAMPLES_PER_RSM; uSample++ )
+                {
+                    const size_t uIndex = (size_t)i*CPU_RSM_SAMPLES_PER_RSM + uSample;
+                    const unsigned uX = ( uSample % CPU_RSM_SAMPLES_PER_ROW )*CPU_RSM_SAMPLE_WIDTH;
+                    const unsigned uY = ( uSample / CPU_RSM_SAMPLES_PER_ROW )*CPU_RSM_SAMPLE_WIDTH;
+                    m_NewVPLFlags[uIndex] = CPUGenerateTexelVPL( Params, uX, uY, m_NewPositionAndRadius[uIndex], m_NewData[uIndex] ) ? 1 : 0;
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumDirtyRSMs, RSM_GRAIN_SIZE, GenerateRSMs );
+        }
+        else
+        {
+            GenerateRSMs( 0, uNumDirtyRSMs, 0 );
+        }
+
+        // Within an RSM, a sample that lost its VPL hands its handle to one that gained a VPL,
+        // so the set only shrinks (and moves VPLs into the holes) by what the RSM lost overall
+        std::vector<CPULightHandle> SpareHandles;
+        for( unsigned i = 0; i < uNumDirtyRSMs; i++ )
+        {
+            const unsigned uRSM = m_DirtyRSMs[i];
+            CPULightHandle* pHandles = &m_Handles[(size_t)uRSM*CPU_RSM_SAMPLES_PER_RSM];
+            const unsigned char* pFlags = &m_NewVPLFlags[(size_t)i*CPU_RSM_SAMPLES_PER_RSM];
+            const CPUFloat4* pPositions = &m_NewPositionAndRadius[(size_t)i*CPU_RSM_SAMPLES_PER_RSM];
+            const CPUVPLData* pData = &m_NewData[(size_t)i*CPU_RSM_SAMPLES_PER_RSM];
+
+            SpareHandles.clear();
+            unsigned uNumVPLs = 0;
+            for( unsigned uSample = 0; uSample < CPU_RSM_SAMPLES_PER_RSM; uSample++ )
+            {
+                if( pHandles[uSample] != CPU_INVALID_LIGHT_HANDLE && !pFlags[uSample] )
+                {
+                    SpareHandles.push_back( pHandles[uSample] );
+                    pHandles[uSample] = CPU_INVALID_LIGHT_HANDLE;
+                    m_Stats.uNumRemovedVPLs++;
+                }
+                uNumVPLs += pFlags[uSample];
+            }
+
+            for( unsigned uSample = 0; uSample < CPU_RSM_SAMPLES_PER_RSM; uSample++ )
+            {
+                if( !pFlags[uSample] )
+                {
+                    continue;
+                }
+
+                CPULightHandle Handle = pHandles[uSample];
+                if( Handle != CPU_INVALID_LIGHT_HANDLE )
+                {
+                    // only write what changed, so that the rest is not uploaded again
+                    if( memcmp( m_Pool.Get( Handle, CPU_VPL_CACHE_POSITION_AND_RADIUS ), &pPositions[uSample], sizeof(CPUFloat4) ) == 0 &&
+                        memcmp( m_Pool.Get( Handle, CPU_VPL_CACHE_DATA ), &pData[uSample], sizeof(CPUVPLData) ) == 0 )
+                    {
+                        continue;
+                    }
+                    m_Stats.uNumChangedVPLs++;
+                }
+                else
+                {
+                    if( !SpareHandles.empty() )
+                    {
+                        Handle = SpareHandles.back();
+                        SpareHandles.pop_back();
+                    }
+                    else
+                    {
+                        Handle = m_Pool.Add();
+                        if( Handle == CPU_INVALID_LIGHT_HANDLE )
+                        {
+                            m_Stats.uNumDroppedVPLs++;
+                            uNumVPLs--;
+                            continue;
+                        }
+                    }
+                    pHandles[uSample] = Handle;
+                    m_SlotKeys[Handle & SLOT_MASK] = uRSM*CPU_RSM_SAMPLES_PER_RSM + uSample;
+                    m_Stats.uNumAddedVPLs++;
+                }
+
+                m_Pool.Set( Handle, CPU_VPL_CACHE_POSITION_AND_RADIUS, &pPositions[uSample] );
+                m_Pool.Set( Handle, CPU_VPL_CACHE_DATA, &pData[uSample] );
+            }
+
+            for( unsigned j = 0; j < SpareHandles.size(); j++ )
+            {
+                m_Stats.uNumMovedVPLs += ( m_Pool.GetDenseIndex( SpareHandles[j] ) + 1 != m_Pool.GetCount() ) ? 1 : 0;
+                m_Pool.Remove( SpareHandles[j] );
+            }
+
+            m_RSMNumVPLs[uRSM] = uNumVPLs;
+            m_Stats.uNumRegeneratedVPLs += uNumVPLs;
+        }
+
+        m_Stats.uNumVPLs = m_Pool.GetCount();
+        m_Stats.uTotalReusedVPLs = uTotalReusedVPLs + m_Stats.uNumReusedVPLs;
+        m_Stats.uTotalRegeneratedVPLs = uTotalRegeneratedVPLs + m_Stats.uNumRegeneratedVPLs;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,159 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: CPUVPLCache.h
+//
+// A persistent VPL set, kept from frame to frame instead of generated again every frame.
+// Each VPL is keyed by its RSM (the light and, for point lights, the face) and its 2x2
+// texel block, and an RSM's VPLs are only generated again when what GenerateVPLsCS reads
+// for it changes (the light's transform, position, color or spot parameters, or the VPL
+// constants) or when it is invalidated, e.g. because the RSM was rendered again over
+// moved geometry. The VPLs live in a CPULightPool, so they stay densely packed as they
+// come and go, and only the ones that changed are marked dirty for the upload. The set
+// has the same VPLs, bit for bit, as CPUVPLGenerator, in a different order. This file
+// has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightPool.h"
+#include "CPUVPLGeneration.h"
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+
+    // The attributes of the pool, as g_VPLPositionBuffer and g_VPLDataBuffer
+    static const unsigned CPU_VPL_CACHE_POSITION_AND_RADIUS = 0;
+    static const unsigned CPU_VPL_CACHE_DATA = 1;
+
+    struct CPUVPLCacheStats
+    {
+        // RSMs in the last update, those whose VPLs were kept and those generated again,
+        // by the first reason found: new (or after InvalidateAll), their inputs changed,
+        // or invalidated with InvalidateRSM
+        unsigned            uNumRSMs;
+        unsigned            uNumReusedRSMs;
+        unsigned            uNumNewRSMs;
+        unsigned            uNumChangedRSMs;
+        unsigned            uNumInvalidatedRSMs;
+
+        // VPLs of the reused RSMs, and VPLs the regenerated RSMs made
+        unsigned            uNumReusedVPLs;
+        unsigned            uNumRegeneratedVPLs;
+
+        // what the regeneration did to the set: VPLs added, removed, and kept in their
+        // place but with new values (the rest of the regenerated VPLs came out the same),
+        // and VPLs moved to fill the holes of the removed ones
+        unsigned            uNumAddedVPLs;
+        unsigned            uNumRemovedVPLs;
+        unsigned            uNumChangedVPLs;
+        unsigned            uNumMovedVPLs;
+
+        // VPLs that did not fit in the pool
+        unsigned            uNumDroppedVPLs;
+
+        unsigned            uNumVPLs;
+
+        // reused and regenerated VPLs since the last Reset
+        unsigned long long  uTotalReusedVPLs;
+        unsigned long long  uTotalRegeneratedVPLs;
+    };
+
+    class CPUVPLCache
+    {
+    public:
+        // Constructor / destructor
+        CPUVPLCache();
+        ~CPUVPLCache();
+
+        // Forget every VPL, and hold up to uCapacity of them
+        void Reset( unsigned uCapacity );
+
+        // Generate the VPLs of the RSM again at the next update (uRSM counts as in
+        // CPUVPLGenerationOutput::RSMOffsets), or of every RSM
+        void InvalidateRSM( unsigned uRSM );
+        void InvalidateAll();
+
+        // Bring the set up to date with Input, generating the RSMs that need it across
+        // pScheduler (NULL runs on the calling thread)
+        void Update( const CPUVPLGenerationInput& Input, CPUTaskScheduler* pScheduler );
+
+        // The dense VPL buffers, GetNumVPLs() of each, and their dirty ranges
+        unsigned GetNumVPLs() const { return m_Pool.GetCount(); }
+        const CPUFloat4* GetPositionAndRadius() const { return (const CPUFloat4*)m_Pool.GetData( CPU_VPL_CACHE_POSITION_AND_RADIUS ); }
+        const CPUVPLData* GetData() const { return (const CPUVPLData*)m_Pool.GetData( CPU_VPL_CACHE_DATA ); }
+        const CPULightPool& GetPool() const { return m_Pool; }
+
+        // Call after the dirty ranges have been uploaded
+        void ClearDirtyRanges() { m_Pool.ClearDirtyRanges(); }
+
+        // The key of the VPL at a dense index: uRSM*CPU_RSM_SAMPLES_PER_RSM plus the sample's
+        // index in the RSM (row-major), so sorting by key gives the generator's order
+        unsigned GetKey( unsigned uIndex ) const;
+
+        const CPUVPLCacheStats& GetStats() const { return m_Stats; }
+
+    private:
+        // not copyable
+        CPUVPLCache( const CPUVPLCache& );
+        CPUVPLCache& operator=( const CPUVPLCache& );
+
+        enum RSMState
+        {
+            RSM_NEW,
+            RSM_CACHED,
+            RSM_INVALIDATED,
+        };
+
+        void RemoveRSM( unsigned uRSM );
+
+        CPULightPool                    m_Pool;
+        CPUVPLCacheStats                m_Stats;
+
+        // per RSM: its state and the inputs its VPLs were generated from (zero filled,
+        // so that they can be compared with memcmp)
+        std::vector<RSMState>           m_RSMStates;
+        std::vector<CPURSMParams>       m_RSMParams;
+        std::vector<unsigned>           m_RSMNumVPLs;
+
+        // per key, the VPL's handle (CPU_INVALID_LIGHT_HANDLE if the sample made none),
+        // and per pool slot, the key
+        std::vector<CPULightHandle>     m_Handles;
+        std::vector<unsigned>           m_SlotKeys;
+
+        // the RSMs to generate, and what they made: a flag and the VPL of every sample
+        std::vector<unsigned>           m_DirtyRSMs;
+        std::vector<unsigned char>      m_NewVPLFlags;
+        std::vector<CPUFloat4>          m_NewPositionAndRadius;
+        std::vector<CPUVPLData>         m_NewData;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,415 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUVPLClustering.cpp
+//
+// VPL clustering on the CPU.
+//
+// Each pass computes every VPL's key in parallel, then inserts the keys into an open
+// addressing hash table in input order on the calling thread, which numbers the clusters
+// in order of first appearance. The VPLs are then grouped by cluster, keeping input
+// order, and the clusters are merged in parallel, each in double precision over its
+// members in that order.
+//--------------------------------------------------------------------------------------
+
+#include "CPUVPLClustering.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // VPLs per task when computing keys, and clusters per task when merging
+    static const unsigned KEY_GRAIN_SIZE = 1024;
+    static const unsigned MERGE_GRAIN_SIZE = 256;
+
+    // the hash table's empty slots
+    static const unsigned EMPTY_SLOT = 0xFFFFFFFFu;
+
+    // 16 bits per cell coordinate, biased so that the cell containing the origin is 32768
+    // (NaNs go to the lowest cell)
+    static unsigned long long GetCellCoordinate( float fPosition, float fInvCellSize )
+    {
+        float fCell = fPosition*fInvCellSize;
+        fCell = ( fCell >= -32768.0f ) ? std::min( fCell, 32767.0f ) : -32768.0f;
+
+        // floor, without the library call
+        int nCell = (int)fCell;
+        nCell -= ( fCell < (float)nCell ) ? 1 : 0;
+        return (unsigned long long)( nCell + 32768 );
+    }
+
+    // which of uNumBins equal steps of [0,1] fValue is in, clamped
+    static unsigned GetBin( float fValue, unsigned uNumBins )
+    {
+        const float fBin = fValue*uNumBins;
+        return ( fBin >= 0.0f ) ? std::min( (unsigned)fBin, uNumBins - 1 ) : 0;
+    }
+
+    // a finalizer from SplitMix64, to spread the packed cells across the table
+    static unsigned long long HashKey( unsigned long long uKey )
+    {
+        uKey = ( uKey ^ ( uKey >> 30 ) )*0xBF58476D1CE4E5B9ull;
+        uKey = ( uKey ^ ( uKey >> 27 ) )*0x94D049BB133111EBull;
+        return uKey ^ ( uKey >> 31 );
+    }
+
+    static void Normalize( const double v[3], const CPUFloat4& Fallback, CPUFloat4& Result )
+    {
+        const double fLength = sqrt( v[0]*v[0] + v[1]*v[1] + v[2]*v[2] );
+        if( fLength > 0.0 )
+        {
+            Result.x = (float)( v[0] / fLength );
+            Result.y = (float)( v[1] / fLength );
+            Result.z = (float)( v[2] / fLength );
+        }
+        else
+        {
+            Result.x = Fallback.x;
+            Result.y = Fallback.y;
+            Result.z = Fallback.z;
+        }
+        Result.w = Fallback.w;
+    }
+
+    // the extremes of the merged clusters, per thread
+    struct MergeStats
+    {
+        float   fMaxRadiusGrowth;
+        float   fMinNormalCosine;
+    };
+
+    // The energy-weighted centroid, normal and source direction of the members, a radius
+    // that bounds their spheres and the color that keeps their energy
+    static void MergeCluster( const CPUFloat4* pPositionAndRadius, const CPUVPLData* pData, const unsigned* pMembers, unsigned uNumMembers,
+        CPUFloat4& PositionAndRadius, CPUVPLData& Data, MergeStats& Stats )
+    {
+        const unsigned uFirst = pMembers[0];
+        if( uNumMembers == 1 )
+        {
+            PositionAndRadius = pPositionAndRadius[uFirst];
+            Data = pData[uFirst];
+            return;
+        }
+
+        double fWeightSum = 0.0;
+        double Energy[3] = { 0.0, 0.0, 0.0 };
+        double WeightedPosition[3] = { 0.0, 0.0, 0.0 };
+        double MeanPosition[3] = { 0.0, 0.0, 0.0 };
+        double Normal[3] = { 0.0, 0.0, 0.0 };
+        double SourceDir[3] = { 0.0, 0.0, 0.0 };
+        float fMaxMemberRadius = 0.0f;
+        for( unsigned i = 0; i < uNumMembers; i++ )
+        {
+            const CPUFloat4& Member = pPositionAndRadius[pMembers[i]];
+            const CPUVPLData& MemberData = pData[pMembers[i]];
+            const double fRadiusCubed = (double)Member.w*Member.w*Member.w;
+
+            double fWeight = 0.0;
+            for( int c = 0; c < 3; c++ )
+            {
+                const double fEnergy = (&MemberData.Color.x)[c]*fRadiusCubed;
+                Energy[c] += fEnergy;
+                fWeight += fEnergy;
+            }
+            fWeight = std::max( fWeight, 0.0 );
+            fWeightSum += fWeight;
+
+            for( int c = 0; c < 3; c++ )
+            {
+                WeightedPosition[c] += fWeight*(&Member.x)[c];
+                MeanPosition[c] += (&Member.x)[c];
+                Normal[c] += fWeight*(&MemberData.Direction.x)[c];
+                SourceDir[c] += fWeight*(&MemberData.SourceLightDirection.x)[c];
+            }
+            fMaxMemberRadius = std::max( fMaxMemberRadius, Member.w );
+        }
+
+        // (black VPLs have no energy to weight by)
+        for( int c = 0; c < 3; c++ )
+        {
+            (&PositionAndRadius.x)[c] = (float)( ( fWeightSum > 0.0 ) ? WeightedPosition[c] / fWeightSum : MeanPosition[c] / uNumMembers );
+        }
+
+        // bound the members' spheres from the rounded center, and round the radius up
+        double fRadius = 0.0;
+        for( unsigned i = 0; i < uNumMembers; i++ )
+        {
+            const CPUFloat4& Member = pPositionAndRadius[pMembers[i]];
+            const double d[3] = { (double)Member.x - PositionAndRadius.x, (double)Member.y - PositionAndRadius.y, (double)Member.z - PositionAndRadius.z };
+            fRadius = std::max( fRadius, sqrt( d[0]*d[0] + d[1]*d[1] + d[2]*d[2] ) + Member.w );
+        }
+        PositionAndRadius.w = (float)fRadius;
+        if( (double)PositionAndRadius.w < fRadius )
+        {
+            // the next float up, for a positive finite float
+            unsigned uBits;
+            memcpy( &uBits, &PositionAndRadius.w, sizeof(uBits) );
+            uBits++;
+            memcpy( &PositionAndRadius.w, &uBits, sizeof(uBits) );
+        }
+
+        const double fRadiusCubed = (double)PositionAndRadius.w*PositionAndRadius.w*PositionAndRadius.w;
+        for( int c = 0; c < 3; c++ )
+        {
+            (&Data.Color.x)[c] = (float)( Energy[c] / fRadiusCubed );
+        }
+        Data.Color.w = pData[uFirst].Color.w;
+        Normalize( Normal, pData[uFirst].Direction, Data.Direction );
+        Normalize( SourceDir, pData[uFirst].SourceLightDirection, Data.SourceLightDirection );
+
+        Stats.fMaxRadiusGrowth = std::max( Stats.fMaxRadiusGrowth, PositionAndRadius.w / fMaxMemberRadius );
+        for( unsigned i = 0; i < uNumMembers; i++ )
+        {
+            const CPUFloat4& MemberNormal = pData[pMembers[i]].Direction;
+            Stats.fMinNormalCosine = std::min( Stats.fMinNormalCosine, Data.Direction.x*MemberNormal.x + Data.Direction.y*MemberNormal.y + Data.Direction.z*MemberNormal.z );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUVPLClusterer::CPUVPLClusterer()
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUVPLClusterer::~CPUVPLClusterer()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cell x, y and z in the low 48 bits, and the normal and color bin above them
+    //--------------------------------------------------------------------------------------
+    unsigned long long CPUVPLClusterer::GetClusterKey( const CPUVPLClusteringDesc& Desc, float fCellSize, const CPUFloat4& PositionAndRadius, const CPUVPLData& Data )
+    {
+        const float fInvCellSize = 1.0f / fCellSize;
+        const unsigned long long uCell = GetCellCoordinate( PositionAndRadius.x, fInvCellSize ) |
+            ( GetCellCoordinate( PositionAndRadius.y, fInvCellSize ) << 16 ) | ( GetCellCoordinate( PositionAndRadius.z, fInvCellSize ) << 32 );
+
+        // the cube face the normal points at, then the texel within it
+        const float* n = &Data.Direction.x;
+        int nAxis = 0;
+        for( int i = 1; i < 3; i++ )
+        {
+            nAxis = ( fabsf( n[i] ) > fabsf( n[nAxis] ) ) ? i : nAxis;
+        }
+        unsigned uNormalBin = 0;
+        const float fMajor = fabsf( n[nAxis] );
+        if( fMajor > 0.0f )
+        {
+            const float fScale = 0.5f / fMajor;
+            const unsigned uFace = 2*nAxis + ( n[nAxis] < 0.0f ? 1 : 0 );
+            const unsigned u = GetBin( n[( nAxis + 1 ) % 3]*fScale + 0.5f, Desc.uNormalBins );
+            const unsigned v = GetBin( n[( nAxis + 2 ) % 3]*fScale + 0.5f, Desc.uNormalBins );
+            uNormalBin = ( uFace*Desc.uNormalBins + v )*Desc.uNormalBins + u;
+        }
+
+        unsigned uColorBin = 0;
+        const float r = std::max( Data.Color.x, 0.0f ), g = std::max( Data.Color.y, 0.0f ), b = std::max( Data.Color.z, 0.0f );
+        if( r + g + b > 0.0f )
+        {
+            const float fInvSum = 1.0f / ( r + g + b );
+            uColorBin = GetBin( r*fInvSum, Desc.uColorBins )*Desc.uColorBins + GetBin( g*fInvSum, Desc.uColorBins );
+        }
+
+        return uCell | ( (unsigned long long)( uNormalBin*Desc.uColorBins*Desc.uColorBins + uColorBin ) << 48 );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Number the distinct keys in order of first appearance
+    //--------------------------------------------------------------------------------------
+    unsigned CPUVPLClusterer::AssignClusters( unsigned uNumVPLs, std::vector<unsigned>& ClusterIndices )
+    {
+        size_t uTableSize = 16;
+        while( uTableSize < 2*(size_t)uNumVPLs )
+        {
+            uTableSize *= 2;
+        }
+        m_TableKeys.resize( uTableSize );
+        m_TableClusters.assign( uTableSize, EMPTY_SLOT );
+
+        unsigned uNumClusters = 0;
+        for( unsigned i = 0; i < uNumVPLs; i++ )
+        {
+            const unsigned long long uKey = m_Keys[i];
+            size_t uSlot = (size_t)HashKey( uKey ) & ( uTableSize - 1 );
+            while( m_TableClusters[uSlot] != EMPTY_SLOT && m_TableKeys[uSlot] != uKey )
+            {
+                uSlot = ( uSlot + 1 ) & ( uTableSize - 1 );
+            }
+
+            if( m_TableClusters[uSlot] == EMPTY_SLOT )
+            {
+                m_TableKeys[uSlot] = uKey;
+                m_TableClusters[uSlot] = uNumClusters++;
+            }
+            ClusterIndices[i] = m_TableClusters[uSlot];
+        }
+
+        return uNumClusters;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cluster, coarsening until the output fits, then merge each cluster
+    //--------------------------------------------------------------------------------------
+    void CPUVPLClusterer::ClusterVPLs( const CPUVPLClusteringDesc& Desc, const CPUFloat4* pPositionAndRadius, const CPUVPLData* pData, unsigned uNumVPLs,
+        CPUVPLClusteringOutput& Output, CPUTaskScheduler* pScheduler )
+    {
+        assert( Desc.fCellSize > 0.0f );
+        assert( Desc.uNormalBins >= 1 && Desc.uNormalBins <= CPU_VPL_MAX_NORMAL_BINS );
+        assert( Desc.uColorBins >= 1 && Desc.uColorBins <= CPU_VPL_MAX_COLOR_BINS );
+
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        m_Stats.uNumInputVPLs = uNumVPLs;
+        m_Stats.fMaxRadiusGrowth = 1.0f;
+        m_Stats.fMinNormalCosine = 1.0f;
+        m_Stats.fCellSize = Desc.fCellSize;
+
+        Output.ClusterIndices.resize( uNumVPLs );
+        m_Keys.resize( uNumVPLs );
+
+        unsigned uNumClusters = 0;
+        for( ;; )
+        {
+            const float fCellSize = m_Stats.fCellSize;
+            CPUTaskScheduler::RangeFunction ComputeKeys = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+            {
+                for( unsigned i = uBegin; i < uEnd; i++ )
+                {
+                    m_Keys[i] = GetClusterKey( Desc, fCellSize, pPositionAndRadius[i], pData[i] );
+                }
+            };
+
+            if( pScheduler )
+            {
+                pScheduler->ParallelFor( uNumVPLs, KEY_GRAIN_SIZE, ComputeKeys );
+            }
+            else
+            {
+                ComputeKeys( 0, uNumVPLs, 0 );
+            }
+
+            uNumClusters = AssignClusters( uNumVPLs, Output.ClusterIndices );
+            if( Desc.uMaxVPLs == 0 || uNumClusters <= Desc.uMaxVPLs || m_Stats.uNumCoarsenings >= Desc.uMaxCoarsenings )
+            {
+                break;
+            }
+
+            m_Stats.fCellSize *= 2.0f;
+            m_Stats.uNumCoarsenings++;
+        }
+
+        // group the VPLs by cluster, in input order
+        m_ClusterStarts.assign( uNumClusters + 1, 0 );
+        for( unsigned i = 0; i < uNumVPLs; i++ )
+        {
+            m_ClusterStarts[Output.ClusterIndices[i] + 1]++;
+        }
+        for( unsigned c = 0; c < uNumClusters; c++ )
+        {
+            m_Stats.uLargestCluster = std::max( m_Stats.uLargestCluster, m_ClusterStarts[c + 1] );
+            m_Stats.uNumSingletons += ( m_ClusterStarts[c + 1] == 1 ) ? 1 : 0;
+            m_ClusterStarts[c + 1] += m_ClusterStarts[c];
+        }
+        m_Members.resize( uNumVPLs );
+        for( unsigned i = 0; i < uNumVPLs; i++ )
+        {
+            m_Members[m_ClusterStarts[Output.ClusterIndices[i]]++] = i;
+        }
+        // (each start has moved up to the next cluster's)
+        for( unsigned c = uNumClusters; c > 0; c-- )
+        {
+            m_ClusterStarts[c] = m_ClusterStarts[c - 1];
+        }
+        m_ClusterStarts[0] = 0;
+
+        if( Output.PositionAndRadius.size() < uNumClusters )
+        {
+            Output.PositionAndRadius.resize( uNumClusters );
+            Output.Data.resize( uNumClusters );
+        }
+        Output.uNumVPLs = uNumClusters;
+
+        std::vector<MergeStats> ThreadStats( pScheduler ? pScheduler->GetNumThreads() : 1 );
+        for( size_t i = 0; i < ThreadStats.size(); i++ )
+        {
+            ThreadStats[i].fMaxRadiusGrowth = 1.0f;
+            ThreadStats[i].fMinNormalCosine = 1.0f;
+        }
+
+        CPUTaskScheduler::RangeFunction MergeClusters = [&]( unsigned uBegin, unsigned uEnd, unsigned uThreadIndex )
+        {
+            for( unsigned c = uBegin; c < uEnd; c++ )
+            {
+                MergeCluster( pPositionAndRadius, pData, &m_Members[m_ClusterStarts[c]], m_ClusterStarts[c + 1] - m_ClusterStarts[c],
+                    Output.PositionAndRadius[c], Output.Data[c], ThreadStats[uThreadIndex] );
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumClusters, MERGE_GRAIN_SIZE, MergeClusters );
+        }
+        else
+        {
+            MergeClusters( 0, uNumClusters, 0 );
+        }
+
+        m_Stats.uNumOutputVPLs = uNumClusters;
+        for( size_t i = 0; i < ThreadStats.size(); i++ )
+        {
+            m_Stats.fMaxRadiusGrowth = std::max( m_Stats.fMaxRadiusGrowth, ThreadStats[i].fMaxRadiusGrowth );
+            m_Stats.fMinNormalCosine = std::min( m_Stats.fMinNormalCosine, ThreadStats[i].fMinNormalCosine );
+        }
+
+        for( unsigned i = 0; i < uNumVPLs; i++ )
+        {
+            const double fRadiusCubed = (double)pPositionAndRadius[i].w*pPositionAndRadius[i].w*pPositionAndRadius[i].w;
+            for( int c = 0; c < 3; c++ )
+            {
+                m_Stats.InputEnergy[c] += (&pData[i].Color.x)[c]*fRadiusCubed;
+            }
+        }
+        for( unsigned i = 0; i < uNumClusters; i++ )
+        {
+            const double fRadiusCubed = (double)Output.PositionAndRadius[i].w*Output.PositionAndRadius[i].w*Output.PositionAndRadius[i].w;
+            for( int c = 0; c < 3; c++ )
+            {
+                m_Stats.OutputEnergy[c] += (&Output.Data[i].Color.x)[c]*fRadiusCubed;
+            }
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,141 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUVPLClustering.h
+//
+// Merges nearly identical VPLs, to run between VPL generation and tile culling. The VPLs
+// are binned by a spatial hash of their positions, a cube map cell of their normals and
+// their chromaticity, and each bin becomes one VPL. Its sphere bounds the members'
+// spheres, so every pixel a member lit is still in the tile lists of the merged VPL.
+// Its color is scaled so that the VPL energy, the color times the cube of the radius
+// (what DoVPLLighting's falloff integrates to), is the members' total. The output is in
+// the order each bin's first VPL appears in the input, and is the same for any thread
+// count. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+#include "CPUVPLGeneration.h"
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+
+    // Largest number of normal bins per cube face edge and of chromaticity bins per axis
+    static const unsigned CPU_VPL_MAX_NORMAL_BINS = 8;
+    static const unsigned CPU_VPL_MAX_COLOR_BINS = 8;
+
+    struct CPUVPLClusteringDesc
+    {
+        CPUVPLClusteringDesc() : fCellSize(25.0f), uNormalBins(2), uColorBins(4), uMaxVPLs(0), uMaxCoarsenings(8) {}
+
+        // edge of the position cells, in world units
+        float               fCellSize;
+
+        // the normals are binned by the texel of a uNormalBins x uNormalBins cube map they
+        // point at, and the colors by r/(r+g+b) and g/(r+g+b) in uColorBins steps each
+        unsigned            uNormalBins;
+        unsigned            uColorBins;
+
+        // 0, or the largest number of VPLs to output: while there are more, the cell size
+        // doubles, up to uMaxCoarsenings times (the shaders use at most g_uMaxVPLs, USHRT_MAX)
+        unsigned            uMaxVPLs;
+        unsigned            uMaxCoarsenings;
+    };
+
+    // The merged VPLs, in the layout of the VPL buffers
+    struct CPUVPLClusteringOutput
+    {
+        CPUVPLClusteringOutput() : uNumVPLs(0) {}
+
+        std::vector<CPUFloat4>  PositionAndRadius;
+        std::vector<CPUVPLData> Data;
+        unsigned                uNumVPLs;
+
+        // the merged VPL each input VPL went into
+        std::vector<unsigned>   ClusterIndices;
+    };
+
+    struct CPUVPLClusteringStats
+    {
+        unsigned            uNumInputVPLs;
+        unsigned            uNumOutputVPLs;
+        unsigned            uNumSingletons;         // merged VPLs with one member, copied unchanged
+        unsigned            uLargestCluster;
+
+        // the cell size of the last pass, and how many times it was doubled to meet uMaxVPLs
+        float               fCellSize;
+        unsigned            uNumCoarsenings;
+
+        // the total VPL energy per channel (the sum of color times radius cubed), in and out
+        double              InputEnergy[3];
+        double              OutputEnergy[3];
+
+        // the largest merged radius relative to its largest member's, and the smallest
+        // cosine between a merged VPL's normal and one of its members'
+        float               fMaxRadiusGrowth;
+        float               fMinNormalCosine;
+    };
+
+    class CPUVPLClusterer
+    {
+    public:
+        // Constructor / destructor
+        CPUVPLClusterer();
+        ~CPUVPLClusterer();
+
+        // Merge uNumVPLs VPLs, spreading the key computation and the merging across pScheduler
+        // (NULL runs on the calling thread)
+        void ClusterVPLs( const CPUVPLClusteringDesc& Desc, const CPUFloat4* pPositionAndRadius, const CPUVPLData* pData, unsigned uNumVPLs,
+            CPUVPLClusteringOutput& Output, CPUTaskScheduler* pScheduler );
+
+        const CPUVPLClusteringStats& GetStats() const { return m_Stats; }
+
+        // The bin of a VPL at a cell size: VPLs with equal keys are merged
+        static unsigned long long GetClusterKey( const CPUVPLClusteringDesc& Desc, float fCellSize, const CPUFloat4& PositionAndRadius, const CPUVPLData& Data );
+
+    private:
+        // not copyable
+        CPUVPLClusterer( const CPUVPLClusterer& );
+        CPUVPLClusterer& operator=( const CPUVPLClusterer& );
+
+        unsigned AssignClusters( unsigned uNumVPLs, std::vector<unsigned>& ClusterIndices );
+
+        CPUVPLClusteringStats           m_Stats;
+
+        // per-pass scratch: the input's keys, the hash table, and the VPLs grouped by cluster
+        std::vector<unsigned long long> m_Keys;
+        std::vector<unsigned long long> m_TableKeys;
+        std::vector<unsigned>           m_TableClusters;
+        std::vector<unsigned>           m_ClusterStarts;
+        std::vector<unsigned>           m_Members;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,785 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUVPLGeneration.cpp
+//
+// VPL generation from RSM atlases on the CPU.
+//
+// Each RSM is a 16x16 grid of samples, the top-left texel of each 2x2 block. Every path
+// does the same float operations in the same order as the scalar one, without fused
+// multiply-adds, so the paths agree bit for bit. The RSMs write their VPLs to their own
+// 256 entry ranges of the output, which are then packed together in RSM order.
+//--------------------------------------------------------------------------------------
+
+#include "CPUVPLGeneration.h"
+#include "CPUSpotLightCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // 2^(127 - 15): moves an 11 or 10-bit float's exponent bias to float32's, denorms included
+    static const float SMALL_FLOAT_SCALE = 5.192296858534828e33f;
+
+    // the exponent field of an 11 or 10-bit float once shifted into place, all ones for Inf and NaN
+    static const unsigned SMALL_FLOAT_EXPONENT_MASK = 0x0F800000u;
+
+    // RSMs per task
+    static const unsigned RSM_GRAIN_SIZE = 4;
+
+    //--------------------------------------------------------------------------------------
+    // Helpers
+    //--------------------------------------------------------------------------------------
+    static float DecodeSmallFloat( unsigned uBits )
+    {
+        float fValue;
+        if( ( uBits & SMALL_FLOAT_EXPONENT_MASK ) == SMALL_FLOAT_EXPONENT_MASK )
+        {
+            uBits |= 0x7F800000u;
+            memcpy( &fValue, &uBits, sizeof(fValue) );
+            return fValue;
+        }
+
+        memcpy( &fValue, &uBits, sizeof(fValue) );
+        return fValue*SMALL_FLOAT_SCALE;
+    }
+
+    static unsigned EncodeSmallFloat( float fValue, unsigned uMantissaBits )
+    {
+        if( !( fValue > 0.0f ) )
+        {
+            return 0;
+        }
+
+        const unsigned uMaxFinite = ( 30u << uMantissaBits ) | ( ( 1u << uMantissaBits ) - 1 );
+        const unsigned uShift = 23 - uMantissaBits;
+
+        unsigned uBits;
+        memcpy( &uBits, &fValue, sizeof(uBits) );
+
+        unsigned uResult;
+        if( uBits < ( 113u << 23 ) )
+        {
+            // below 2^-14, a denorm in steps of 2^-(14 + uMantissaBits)
+            uResult = (unsigned)( fValue*(float)( 1u << ( 14 + uMantissaBits ) ) + 0.5f );
+        }
+        else
+        {
+            // rebias the exponent, and round the mantissa to nearest, ties to even
+            const unsigned uRebiased = uBits - ( 112u << 23 );
+            uResult = ( uRebiased + ( ( 1u << ( uShift - 1 ) ) - 1 ) + ( ( uRebiased >> uShift ) & 1 ) ) >> uShift;
+        }
+
+        return std::min( uResult, uMaxFinite );
+    }
+
+    // the texel center in post-projection space, as GenerateVPLsCS has it
+    static float GetTexelX( unsigned uX )
+    {
+        return ( 2.0f*( ( (float)uX + 0.5f ) / CPU_RSM_RESOLUTION ) ) - 1.0f;
+    }
+
+    static float GetTexelY( unsigned uY )
+    {
+        return ( 2.0f*-( ( (float)uY + 0.5f ) / CPU_RSM_RESOLUTION ) ) + 1.0f;
+    }
+
+    static void GetLightColor( unsigned uColor, float Color[3] )
+    {
+        for( int i = 0; i < 3; i++ )
+        {
+            Color[i] = (float)( ( uColor >> ( 8*i ) ) & 0xFF ) / 255.0f;
+        }
+    }
+
+    void CPUGetRSMParams( const CPUVPLGenerationInput& Input, unsigned uRSM, CPURSMParams& P )
+    {
+        const CPUMatrix* pInv;
+        const CPUFloat4* pLight;
+        unsigned uColor;
+
+        P.bSpot = ( uRSM < Input.uNumSpotLights );
+        if( P.bSpot )
+        {
+            // one row of RSMs
+            const CPURSMAtlas& Atlas = Input.SpotAtlas;
+            const size_t uOffset = (size_t)uRSM*CPU_RSM_RESOLUTION;
+            P.pDepth = Atlas.pDepth + uOffset;
+            P.pNormal = Atlas.pNormal + uOffset;
+            P.pDiffuse = Atlas.pDiffuse + uOffset;
+            P.uPitch = Atlas.uWidth;
+
+            pInv = &Input.pSpotViewProjInv[uRSM];
+            pLight = &Input.pSpotLightCenterAndRadius[uRSM];
+            uColor = Input.pSpotLightColor[uRSM];
+            P.fStrength = Input.fSpotStrength;
+            P.fVPLRadius = Input.fSpotRadius;
+
+            // reconstruct the light direction as GenerateVPLsCS does, and the light position
+            // from it, r_bounding_sphere units back from the bounding sphere center
+            const CPUSpotParams& Params = Input.pSpotParams[uRSM];
+            float Dir[3];
+            Dir[0] = CPUConvertF16ToF32( Params.fLightDirX );
+            Dir[1] = CPUConvertF16ToF32( Params.fLightDirY );
+            Dir[2] = sqrtf( std::max( 1.0f - Dir[0]*Dir[0] - Dir[1]*Dir[1], 0.0f ) );
+            Dir[2] = ( CPUConvertF16ToF32( Params.fCosineOfConeAngleAndLightDirZSign ) > 0.0f ) ? Dir[2] : -Dir[2];
+
+            for( int i = 0; i < 3; i++ )
+            {
+                P.LightPos[i] = (&pLight->x)[i] - pLight->w*Dir[i];
+                P.SpotSourceDir[i] = -Dir[i];
+            }
+        }
+        else
+        {
+            // a row of six faces per light
+            const unsigned uLight = ( uRSM - Input.uNumSpotLights ) / 6;
+            const unsigned uFace = ( uRSM - Input.uNumSpotLights ) % 6;
+            const CPURSMAtlas& Atlas = Input.PointAtlas;
+            const size_t uOffset = (size_t)uLight*CPU_RSM_RESOLUTION*Atlas.uWidth + uFace*CPU_RSM_RESOLUTION;
+            P.pDepth = Atlas.pDepth + uOffset;
+            P.pNormal = Atlas.pNormal + uOffset;
+            P.pDiffuse = Atlas.pDiffuse + uOffset;
+            P.uPitch = Atlas.uWidth;
+
+            pInv = &Input.pPointViewProjInv[6*uLight + uFace];
+            pLight = &Input.pPointLightCenterAndRadius[uLight];
+            uColor = Input.pPointLightColor[uLight];
+            P.fStrength = Input.fPointStrength;
+            P.fVPLRadius = Input.fPointRadius;
+
+            for( int i = 0; i < 3; i++ )
+            {
+                P.LightPos[i] = (&pLight->x)[i];
+                P.SpotSourceDir[i] = 0.0f;
+            }
+        }
+
+        memcpy( P.Inv, pInv->m, sizeof(P.Inv) );
+        P.fLightRadius = pLight->w;
+        GetLightColor( uColor, P.LightColor );
+        P.fColorThreshold = Input.fColorThreshold;
+        P.fBrightnessThreshold = Input.fBrightnessThreshold;
+
+        for( unsigned i = 0; i < CPU_RSM_SAMPLES_PER_ROW; i++ )
+        {
+            P.SampleX[i] = GetTexelX( i*CPU_RSM_SAMPLE_WIDTH );
+            P.SampleY[i] = GetTexelY( i*CPU_RSM_SAMPLE_WIDTH );
+        }
+    }
+
+    static inline void WriteVPL( const CPURSMParams& P, const float Position[3], const float Normal[3], const float Color[3], const float SourceDir[3],
+        CPUFloat4& PositionAndRadius, CPUVPLData& Data )
+    {
+        PositionAndRadius.x = Position[0];
+        PositionAndRadius.y = Position[1];
+        PositionAndRadius.z = Position[2];
+        PositionAndRadius.w = P.fVPLRadius;
+
+        Data.Direction.x = Normal[0];
+        Data.Direction.y = Normal[1];
+        Data.Direction.z = Normal[2];
+        Data.Direction.w = 0.0f;
+
+        Data.Color.x = Color[0];
+        Data.Color.y = Color[1];
+        Data.Color.z = Color[2];
+        Data.Color.w = 1.0f;
+
+        Data.SourceLightDirection.x = SourceDir[0];
+        Data.SourceLightDirection.y = SourceDir[1];
+        Data.SourceLightDirection.z = SourceDir[2];
+        Data.SourceLightDirection.w = 0.0f;
+    }
+
+    static inline unsigned CountBits( unsigned uMask )
+    {
+        unsigned uCount = 0;
+        for( ; uMask != 0; uMask &= uMask - 1 )
+        {
+            uCount++;
+        }
+        return uCount;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Scalar path, one sample at a time
+    //--------------------------------------------------------------------------------------
+    static inline bool GenerateTexelVPL( const CPURSMParams& P, float x, float y, size_t uTexel, CPUFloat4& PositionAndRadius, CPUVPLData& Data, bool& bColorRejected )
+    {
+        const float fDepth = (float)P.pDepth[uTexel] / 65535.0f;
+
+        float Normal[3], Color[3];
+        CPUDecodeR11G11B10( P.pNormal[uTexel], Normal );
+        CPUDecodeR11G11B10( P.pDiffuse[uTexel], Color );
+        for( int i = 0; i < 3; i++ )
+        {
+            Normal[i] = 2.0f*Normal[i] - 1.0f;
+        }
+
+        float Position[4];
+        for( int i = 0; i < 4; i++ )
+        {
+            Position[i] = ( ( x*P.Inv[i][0] + y*P.Inv[i][1] ) + fDepth*P.Inv[i][2] ) + P.Inv[i][3];
+        }
+        Position[0] /= Position[3];
+        Position[1] /= Position[3];
+        Position[2] /= Position[3];
+
+        const float SourceLightDir[3] = { Position[0] - P.LightPos[0], Position[1] - P.LightPos[1], Position[2] - P.LightPos[2] };
+        const float fLightDistance = sqrtf( ( SourceLightDir[0]*SourceLightDir[0] + SourceLightDir[1]*SourceLightDir[1] ) + SourceLightDir[2]*SourceLightDir[2] );
+        const float fFalloff = 1.0f - fLightDistance / P.fLightRadius;
+        for( int i = 0; i < 3; i++ )
+        {
+            Color[i] *= fFalloff;
+        }
+
+        // a normalized color component above the threshold (false for black, whose normalized color is NaN)
+        const float fColorLength = sqrtf( ( Color[0]*Color[0] + Color[1]*Color[1] ) + Color[2]*Color[2] );
+        bColorRejected = !( Color[0] / fColorLength > P.fColorThreshold || Color[1] / fColorLength > P.fColorThreshold || Color[2] / fColorLength > P.fColorThreshold );
+        if( bColorRejected )
+        {
+            return false;
+        }
+
+        for( int i = 0; i < 3; i++ )
+        {
+            Color[i] = ( Color[i]*P.LightColor[i] )*P.fStrength;
+        }
+
+        const float fColorStrength = sqrtf( ( Color[0]*Color[0] + Color[1]*Color[1] ) + Color[2]*Color[2] );
+        if( !( fColorStrength > P.fBrightnessThreshold ) )
+        {
+            return false;
+        }
+
+        const float PointSourceDir[3] = { -SourceLightDir[0] / fLightDistance, -SourceLightDir[1] / fLightDistance, -SourceLightDir[2] / fLightDistance };
+        WriteVPL( P, Position, Normal, Color, P.bSpot ? P.SpotSourceDir : PointSourceDir, PositionAndRadius, Data );
+        return true;
+    }
+
+    static unsigned GenerateRSMScalar( const CPURSMParams& P, CPUFloat4* pPositions, CPUVPLData* pData, unsigned& uNumColorRejected )
+    {
+        unsigned uNumVPLs = 0;
+
+        for( unsigned uRow = 0; uRow < CPU_RSM_SAMPLES_PER_ROW; uRow++ )
+        {
+            const size_t uRowOffset = (size_t)uRow*CPU_RSM_SAMPLE_WIDTH*P.uPitch;
+            for( unsigned uSample = 0; uSample < CPU_RSM_SAMPLES_PER_ROW; uSample++ )
+            {
+                bool bColorRejected;
+                if( GenerateTexelVPL( P, P.SampleX[uSample], P.SampleY[uRow], uRowOffset + uSample*CPU_RSM_SAMPLE_WIDTH, pPositions[uNumVPLs], pData[uNumVPLs], bColorRejected ) )
+                {
+                    uNumVPLs++;
+                }
+                uNumColorRejected += bColorRejected ? 1 : 0;
+            }
+        }
+
+        return uNumVPLs;
+    }
+
+    bool CPUGenerateTexelVPL( const CPURSMParams& Params, unsigned uX, unsigned uY, CPUFloat4& PositionAndRadius, CPUVPLData& Data )
+    {
+        assert( uX < CPU_RSM_RESOLUTION && uY < CPU_RSM_RESOLUTION );
+
+        bool bColorRejected;
+        return GenerateTexelVPL( Params, GetTexelX( uX ), GetTexelY( uY ), (size_t)uY*Params.uPitch + uX, PositionAndRadius, Data, bColorRejected );
+    }
+
+    // The attributes of a batch of samples, stored from the SIMD registers
+    struct SampleLanes
+    {
+        float   Position[3][8];
+        float   Normal[3][8];
+        float   Color[3][8];
+        float   SourceDir[3][8];
+    };
+
+    static unsigned WriteVPLLanes( const CPURSMParams& P, const SampleLanes& Lanes, unsigned uMask, CPUFloat4* pPositions, CPUVPLData* pData )
+    {
+        unsigned uNumVPLs = 0;
+        for( ; uMask != 0; uMask &= uMask - 1 )
+        {
+            const unsigned uLane = CountTrailingZeros( uMask );
+            const float Position[3] = { Lanes.Position[0][uLane], Lanes.Position[1][uLane], Lanes.Position[2][uLane] };
+            const float Normal[3] = { Lanes.Normal[0][uLane], Lanes.Normal[1][uLane], Lanes.Normal[2][uLane] };
+            const float Color[3] = { Lanes.Color[0][uLane], Lanes.Color[1][uLane], Lanes.Color[2][uLane] };
+            const float PointSourceDir[3] = { Lanes.SourceDir[0][uLane], Lanes.SourceDir[1][uLane], Lanes.SourceDir[2][uLane] };
+            WriteVPL( P, Position, Normal, Color, P.bSpot ? P.SpotSourceDir : PointSourceDir, pPositions[uNumVPLs], pData[uNumVPLs] );
+            uNumVPLs++;
+        }
+        return uNumVPLs;
+    }
+
+#if CPU_SIMD_X86
+    //--------------------------------------------------------------------------------------
+    // SSE path, four samples of a row at a time
+    //--------------------------------------------------------------------------------------
+    static inline __m128 NegateSSE( __m128 v )
+    {
+        return _mm_xor_ps( v, _mm_set1_ps( -0.0f ) );
+    }
+
+    static inline __m128 Dot3SSE( const __m128 a[3], const __m128 b[3] )
+    {
+        return _mm_add_ps( _mm_add_ps( _mm_mul_ps( a[0], b[0] ), _mm_mul_ps( a[1], b[1] ) ), _mm_mul_ps( a[2], b[2] ) );
+    }
+
+    // texels 0, 2, 4 and 6 of p
+    static inline __m128i LoadSampleTexelsSSE( const unsigned* p )
+    {
+        const __m128 a = _mm_castsi128_ps( _mm_loadu_si128( (const __m128i*)p ) );
+        const __m128 b = _mm_castsi128_ps( _mm_loadu_si128( (const __m128i*)( p + 4 ) ) );
+        return _mm_castps_si128( _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+    }
+
+    static inline __m128 LoadSampleDepthsSSE( const unsigned short* p )
+    {
+        const __m128i Depth = _mm_and_si128( _mm_loadu_si128( (const __m128i*)p ), _mm_set1_epi32( 0xFFFF ) );
+        return _mm_div_ps( _mm_cvtepi32_ps( Depth ), _mm_set1_ps( 65535.0f ) );
+    }
+
+    // see DecodeSmallFloat
+    static inline __m128 DecodeSmallFloatSSE( __m128i Bits )
+    {
+        const __m128i ExponentMask = _mm_set1_epi32( (int)SMALL_FLOAT_EXPONENT_MASK );
+        const __m128 InfOrNaN = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( Bits, ExponentMask ), ExponentMask ) );
+        const __m128 Finite = _mm_mul_ps( _mm_castsi128_ps( Bits ), _mm_set1_ps( SMALL_FLOAT_SCALE ) );
+        const __m128 Special = _mm_castsi128_ps( _mm_or_si128( Bits, _mm_set1_epi32( 0x7F800000 ) ) );
+        return _mm_or_ps( _mm_and_ps( InfOrNaN, Special ), _mm_andnot_ps( InfOrNaN, Finite ) );
+    }
+
+    static inline void DecodeR11G11B10SSE( __m128i Packed, __m128 RGB[3] )
+    {
+        const __m128i Mask11 = _mm_set1_epi32( 0x7FF );
+        RGB[0] = DecodeSmallFloatSSE( _mm_slli_epi32( _mm_and_si128( Packed, Mask11 ), 17 ) );
+        RGB[1] = DecodeSmallFloatSSE( _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( Packed, 11 ), Mask11 ), 17 ) );
+        RGB[2] = DecodeSmallFloatSSE( _mm_slli_epi32( _mm_srli_epi32( Packed, 22 ), 18 ) );
+    }
+
+    static unsigned GenerateRSMSSE( const CPURSMParams& P, CPUFloat4* pPositions, CPUVPLData* pData, unsigned& uNumColorRejected )
+    {
+        const __m128 One = _mm_set1_ps( 1.0f );
+        const __m128 Two = _mm_set1_ps( 2.0f );
+        const __m128 LightRadius = _mm_set1_ps( P.fLightRadius );
+        const __m128 Strength = _mm_set1_ps( P.fStrength );
+        const __m128 ColorThreshold = _mm_set1_ps( P.fColorThreshold );
+        const __m128 BrightnessThreshold = _mm_set1_ps( P.fBrightnessThreshold );
+
+        __m128 LightPos[3], LightColor[3];
+        for( int i = 0; i < 3; i++ )
+        {
+            LightPos[i] = _mm_set1_ps( P.LightPos[i] );
+            LightColor[i] = _mm_set1_ps( P.LightColor[i] );
+        }
+
+        SampleLanes Lanes;
+        unsigned uNumVPLs = 0;
+
+        for( unsigned uRow = 0; uRow < CPU_RSM_SAMPLES_PER_ROW; uRow++ )
+        {
+            const size_t uRowOffset = (size_t)uRow*CPU_RSM_SAMPLE_WIDTH*P.uPitch;
+            const __m128 y = _mm_set1_ps( P.SampleY[uRow] );
+
+            // the row's part of the unprojection
+            __m128 RowTerm[4], DepthScale[4];
+            for( int i = 0; i < 4; i++ )
+            {
+                RowTerm[i] = _mm_mul_ps( y, _mm_set1_ps( P.Inv[i][1] ) );
+                DepthScale[i] = _mm_set1_ps( P.Inv[i][2] );
+            }
+
+            for( unsigned uSample = 0; uSample < CPU_RSM_SAMPLES_PER_ROW; uSample += 4 )
+            {
+                const size_t uTexel = uRowOffset + uSample*CPU_RSM_SAMPLE_WIDTH;
+                const __m128 x = _mm_loadu_ps( &P.SampleX[uSample] );
+                const __m128 Depth = LoadSampleDepthsSSE( P.pDepth + uTexel );
+
+                __m128 Normal[3], Color[3];
+                DecodeR11G11B10SSE( LoadSampleTexelsSSE( P.pNormal + uTexel ), Normal );
+                DecodeR11G11B10SSE( LoadSampleTexelsSSE( P.pDiffuse + uTexel ), Color );
+                for( int i = 0; i < 3; i++ )
+                {
+                    Normal[i] = _mm_sub_ps( _mm_mul_ps( Two, Normal[i] ), One );
+                }
+
+                __m128 Position[4];
+                for( int i = 0; i < 4; i++ )
+                {
+                    Position[i] = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( P.Inv[i][0] ) ), RowTerm[i] ), _mm_mul_ps( Depth, DepthScale[i] ) ),
+                        _mm_set1_ps( P.Inv[i][3] ) );
+                }
+                for( int i = 0; i < 3; i++ )
+                {
+                    Position[i] = _mm_div_ps( Position[i], Position[3] );
+                }
+
+                const __m128 SourceLightDir[3] = { _mm_sub_ps( Position[0], LightPos[0] ), _mm_sub_ps( Position[1], LightPos[1] ), _mm_sub_ps( Position[2], LightPos[2] ) };
+                const __m128 LightDistance = _mm_sqrt_ps( Dot3SSE( SourceLightDir, SourceLightDir ) );
+                const __m128 Falloff = _mm_sub_ps( One, _mm_div_ps( LightDistance, LightRadius ) );
+                for( int i = 0; i < 3; i++ )
+                {
+                    Color[i] = _mm_mul_ps( Color[i], Falloff );
+                }
+
+                const __m128 ColorLength = _mm_sqrt_ps( Dot3SSE( Color, Color ) );
+                const __m128 Interesting = _mm_or_ps( _mm_or_ps(
+                    _mm_cmpgt_ps( _mm_div_ps( Color[0], ColorLength ), ColorThreshold ),
+                    _mm_cmpgt_ps( _mm_div_ps( Color[1], ColorLength ), ColorThreshold ) ),
+                    _mm_cmpgt_ps( _mm_div_ps( Color[2], ColorLength ), ColorThreshold ) );
+                const unsigned uInterestingMask = (unsigned)_mm_movemask_ps( Interesting );
+                uNumColorRejected += 4 - CountBits( uInterestingMask );
+                if( uInterestingMask == 0 )
+                {
+                    continue;
+                }
+
+                for( int i = 0; i < 3; i++ )
+                {
+                    Color[i] = _mm_mul_ps( _mm_mul_ps( Color[i], LightColor[i] ), Strength );
+                }
+
+                const __m128 ColorStrength = _mm_sqrt_ps( Dot3SSE( Color, Color ) );
+                const unsigned uMask = (unsigned)_mm_movemask_ps( _mm_and_ps( Interesting, _mm_cmpgt_ps( ColorStrength, BrightnessThreshold ) ) );
+                if( uMask == 0 )
+                {
+                    continue;
+                }
+
+                for( int i = 0; i < 3; i++ )
+                {
+                    _mm_storeu_ps( Lanes.Position[i], Position[i] );
+                    _mm_storeu_ps( Lanes.Normal[i], Normal[i] );
+                    _mm_storeu_ps( Lanes.Color[i], Color[i] );
+                    _mm_storeu_ps( Lanes.SourceDir[i], _mm_div_ps( NegateSSE( SourceLightDir[i] ), LightDistance ) );
+                }
+                uNumVPLs += WriteVPLLanes( P, Lanes, uMask, pPositions + uNumVPLs, pData + uNumVPLs );
+            }
+        }
+
+        return uNumVPLs;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // AVX2 path, eight samples of a row at a time
+    //--------------------------------------------------------------------------------------
+    CPU_SIMD_TARGET_AVX2 static inline __m256 NegateAVX2( __m256 v )
+    {
+        return _mm256_xor_ps( v, _mm256_set1_ps( -0.0f ) );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static inline __m256 Dot3AVX2( const __m256 a[3], const __m256 b[3] )
+    {
+        return _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( a[0], b[0] ), _mm256_mul_ps( a[1], b[1] ) ), _mm256_mul_ps( a[2], b[2] ) );
+    }
+
+    // texels 0, 2, ... 14 of p
+    CPU_SIMD_TARGET_AVX2 static inline __m256i LoadSampleTexelsAVX2( const unsigned* p )
+    {
+        const __m256 a = _mm256_castsi256_ps( _mm256_loadu_si256( (const __m256i*)p ) );
+        const __m256 b = _mm256_castsi256_ps( _mm256_loadu_si256( (const __m256i*)( p + 8 ) ) );
+
+        // (texels 0, 2, 8, 10 in the low half and 4, 6, 12, 14 in the high half, put back in order)
+        const __m256 Even = _mm256_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+        return _mm256_castpd_si256( _mm256_permute4x64_pd( _mm256_castps_pd( Even ), _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static inline __m256 LoadSampleDepthsAVX2( const unsigned short* p )
+    {
+        const __m256i Depth = _mm256_and_si256( _mm256_loadu_si256( (const __m256i*)p ), _mm256_set1_epi32( 0xFFFF ) );
+        return _mm256_div_ps( _mm256_cvtepi32_ps( Depth ), _mm256_set1_ps( 65535.0f ) );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static inline __m256 DecodeSmallFloatAVX2( __m256i Bits )
+    {
+        const __m256i ExponentMask = _mm256_set1_epi32( (int)SMALL_FLOAT_EXPONENT_MASK );
+        const __m256 InfOrNaN = _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256( Bits, ExponentMask ), ExponentMask ) );
+        const __m256 Finite = _mm256_mul_ps( _mm256_castsi256_ps( Bits ), _mm256_set1_ps( SMALL_FLOAT_SCALE ) );
+        const __m256 Special = _mm256_castsi256_ps( _mm256_or_si256( Bits, _mm256_set1_epi32( 0x7F800000 ) ) );
+        return _mm256_blendv_ps( Finite, Special, InfOrNaN );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static inline void DecodeR11G11B10AVX2( __m256i Packed, __m256 RGB[3] )
+    {
+        const __m256i Mask11 = _mm256_set1_epi32( 0x7FF );
+        RGB[0] = DecodeSmallFloatAVX2( _mm256_slli_epi32( _mm256_and_si256( Packed, Mask11 ), 17 ) );
+        RGB[1] = DecodeSmallFloatAVX2( _mm256_slli_epi32( _mm256_and_si256( _mm256_srli_epi32( Packed, 11 ), Mask11 ), 17 ) );
+        RGB[2] = DecodeSmallFloatAVX2( _mm256_slli_epi32( _mm256_srli_epi32( Packed, 22 ), 18 ) );
+    }
+
+    CPU_SIMD_TARGET_AVX2 static unsigned GenerateRSMAVX2( const CPURSMParams& P, CPUFloat4* pPositions, CPUVPLData* pData, unsigned& uNumColorRejected )
+    {
+        const __m256 One = _mm256_set1_ps( 1.0f );
+        const __m256 Two = _mm256_set1_ps( 2.0f );
+        const __m256 LightRadius = _mm256_set1_ps( P.fLightRadius );
+        const __m256 Strength = _mm256_set1_ps( P.fStrength );
+        const __m256 ColorThreshold = _mm256_set1_ps( P.fColorThreshold );
+        const __m256 BrightnessThreshold = _mm256_set1_ps( P.fBrightnessThreshold );
+
+        __m256 LightPos[3], LightColor[3];
+        for( int i = 0; i < 3; i++ )
+        {
+            LightPos[i] = _mm256_set1_ps( P.LightPos[i] );
+            LightColor[i] = _mm256_set1_ps( P.LightColor[i] );
+        }
+
+        SampleLanes Lanes;
+        unsigned uNumVPLs = 0;
+
+        for( unsigned uRow = 0; uRow < CPU_RSM_SAMPLES_PER_ROW; uRow++ )
+        {
+            const size_t uRowOffset = (size_t)uRow*CPU_RSM_SAMPLE_WIDTH*P.uPitch;
+            const __m256 y = _mm256_set1_ps( P.SampleY[uRow] );
+
+            // the row's part of the unprojection
+            __m256 RowTerm[4], DepthScale[4];
+            for( int i = 0; i < 4; i++ )
+            {
+                RowTerm[i] = _mm256_mul_ps( y, _mm256_set1_ps( P.Inv[i][1] ) );
+                DepthScale[i] = _mm256_set1_ps( P.Inv[i][2] );
+            }
+
+            for( unsigned uSample = 0; uSample < CPU_RSM_SAMPLES_PER_ROW; uSample += 8 )
+            {
+                const size_t uTexel = uRowOffset + uSample*CPU_RSM_SAMPLE_WIDTH;
+                const __m256 x = _mm256_loadu_ps( &P.SampleX[uSample] );
+                const __m256 Depth = LoadSampleDepthsAVX2( P.pDepth + uTexel );
+
+                __m256 Normal[3], Color[3];
+                DecodeR11G11B10AVX2( LoadSampleTexelsAVX2( P.pNormal + uTexel ), Normal );
+                DecodeR11G11B10AVX2( LoadSampleTexelsAVX2( P.pDiffuse + uTexel ), Color );
+                for( int i = 0; i < 3; i++ )
+                {
+                    Normal[i] = _mm256_sub_ps( _mm256_mul_ps( Two, Normal[i] ), One );
+                }
+
+                __m256 Position[4];
+                for( int i = 0; i < 4; i++ )
+                {
+                    Position[i] = _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( x, _mm256_set1_ps( P.Inv[i][0] ) ), RowTerm[i] ), _mm256_mul_ps( Depth, DepthScale[i] ) ),
+                        _mm256_set1_ps( P.Inv[i][3] ) );
+                }
+                for( int i = 0; i < 3; i++ )
+                {
+                    Position[i] = _mm256_div_ps( Position[i], Position[3] );
+                }
+
+                const __m256 SourceLightDir[3] = { _mm256_sub_ps( Position[0], LightPos[0] ), _mm256_sub_ps( Position[1], LightPos[1] ), _mm256_sub_ps( Position[2], LightPos[2] ) };
+                const __m256 LightDistance = _mm256_sqrt_ps( Dot3AVX2( SourceLightDir, SourceLightDir ) );
+                const __m256 Falloff = _mm256_sub_ps( One, _mm256_div_ps( LightDistance, LightRadius ) );
+                for( int i = 0; i < 3; i++ )
+                {
+                    Color[i] = _mm256_mul_ps( Color[i], Falloff );
+                }
+
+                const __m256 ColorLength = _mm256_sqrt_ps( Dot3AVX2( Color, Color ) );
+                const __m256 Interesting = _mm256_or_ps( _mm256_or_ps(
+                    _mm256_cmp_ps( _mm256_div_ps( Color[0], ColorLength ), ColorThreshold, _CMP_GT_OQ ),
+                    _mm256_cmp_ps( _mm256_div_ps( Color[1], ColorLength ), ColorThreshold, _CMP_GT_OQ ) ),
+                    _mm256_cmp_ps( _mm256_div_ps( Color[2], ColorLength ), ColorThreshold, _CMP_GT_OQ ) );
+                const unsigned uInterestingMask = (unsigned)_mm256_movemask_ps( Interesting );
+                uNumColorRejected += 8 - CountBits( uInterestingMask );
+                if( uInterestingMask == 0 )
+                {
+                    continue;
+                }
+
+                for( int i = 0; i < 3; i++ )
+                {
+                    Color[i] = _mm256_mul_ps( _mm256_mul_ps( Color[i], LightColor[i] ), Strength );
+                }
+
+                const __m256 ColorStrength = _mm256_sqrt_ps( Dot3AVX2( Color, Color ) );
+                const unsigned uMask = (unsigned)_mm256_movemask_ps( _mm256_and_ps( Interesting, _mm256_cmp_ps( ColorStrength, BrightnessThreshold, _CMP_GT_OQ ) ) );
+                if( uMask == 0 )
+                {
+                    continue;
+                }
+
+                for( int i = 0; i < 3; i++ )
+                {
+                    _mm256_storeu_ps( Lanes.Position[i], Position[i] );
+                    _mm256_storeu_ps( Lanes.Normal[i], Normal[i] );
+                    _mm256_storeu_ps( Lanes.Color[i], Color[i] );
+                    _mm256_storeu_ps( Lanes.SourceDir[i], _mm256_div_ps( NegateAVX2( SourceLightDir[i] ), LightDistance ) );
+                }
+                uNumVPLs += WriteVPLLanes( P, Lanes, uMask, pPositions + uNumVPLs, pData + uNumVPLs );
+            }
+        }
+
+        return uNumVPLs;
+    }
+#endif // CPU_SIMD_X86
+
+    //--------------------------------------------------------------------------------------
+    // R11G11B10_FLOAT
+    //--------------------------------------------------------------------------------------
+    void CPUDecodeR11G11B10( unsigned uPacked, float RGB[3] )
+    {
+        RGB[0] = DecodeSmallFloat( ( uPacked & 0x7FF ) << 17 );
+        RGB[1] = DecodeSmallFloat( ( ( uPacked >> 11 ) & 0x7FF ) << 17 );
+        RGB[2] = DecodeSmallFloat( ( uPacked >> 22 ) << 18 );
+    }
+
+    unsigned CPUEncodeR11G11B10( const float RGB[3] )
+    {
+        return EncodeSmallFloat( RGB[0], 6 ) | ( EncodeSmallFloat( RGB[1], 6 ) << 11 ) | ( EncodeSmallFloat( RGB[2], 5 ) << 22 );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Input
+    //--------------------------------------------------------------------------------------
+    CPUVPLGenerationInput::CPUVPLGenerationInput()
+        :pSpotViewProjInv(NULL)
+        ,pPointViewProjInv(NULL)
+        ,pSpotLightCenterAndRadius(NULL)
+        ,pSpotLightColor(NULL)
+        ,pSpotParams(NULL)
+        ,uNumSpotLights(0)
+        ,pPointLightCenterAndRadius(NULL)
+        ,pPointLightColor(NULL)
+        ,uNumPointLights(0)
+        ,fSpotStrength(0.0f)
+        ,fSpotRadius(0.0f)
+        ,fPointStrength(0.0f)
+        ,fPointRadius(0.0f)
+        ,fColorThreshold(0.0f)
+        ,fBrightnessThreshold(0.0f)
+    {
+        memset( &SpotAtlas, 0, sizeof(SpotAtlas) );
+        memset( &PointAtlas, 0, sizeof(PointAtlas) );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUVPLGenerator::CPUVPLGenerator()
+        :m_SIMDLevel(CPU_SIMD_AUTO)
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUVPLGenerator::~CPUVPLGenerator()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Every RSM into its own range of the output, then the ranges packed together
+    //--------------------------------------------------------------------------------------
+    void CPUVPLGenerator::GenerateVPLs( const CPUVPLGenerationInput& Input, CPUVPLGenerationOutput& Output, CPUTaskScheduler* pScheduler )
+    {
+        assert( Input.uNumSpotLights == 0 || ( Input.SpotAtlas.uWidth >= Input.uNumSpotLights*CPU_RSM_RESOLUTION && Input.SpotAtlas.uHeight >= CPU_RSM_RESOLUTION ) );
+        assert( Input.uNumPointLights == 0 || ( Input.PointAtlas.uWidth >= 6*CPU_RSM_RESOLUTION && Input.PointAtlas.uHeight >= Input.uNumPointLights*CPU_RSM_RESOLUTION ) );
+        static_assert( CPU_RSM_SAMPLES_PER_ROW % 8 == 0, "the SIMD paths process whole rows" );
+
+        const unsigned uNumRSMs = Input.uNumSpotLights + 6*Input.uNumPointLights;
+        const size_t uCapacity = (size_t)uNumRSMs*CPU_RSM_SAMPLES_PER_RSM;
+        if( Output.PositionAndRadius.size() < uCapacity )
+        {
+            Output.PositionAndRadius.resize( uCapacity );
+            Output.Data.resize( uCapacity );
+        }
+
+        m_RSMCounts.resize( uNumRSMs );
+        const CPUSIMDLevel Level = ResolveCPUSIMDLevel( m_SIMDLevel );
+
+        CPUTaskScheduler::RangeFunction GenerateRSMs = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned uRSM = uBegin; uRSM < uEnd; uRSM++ )
+            {
+                CPURSMParams Params;
+                CPUGetRSMParams( Input, uRSM, Params );
+
+                CPUFloat4* pPositions = &Output.PositionAndRadius[(size_t)uRSM*CPU_RSM_SAMPLES_PER_RSM];
+                CPUVPLData* pData = &Output.Data[(size_t)uRSM*CPU_RSM_SAMPLES_PER_RSM];
+                RSMCounts& Counts = m_RSMCounts[uRSM];
+                Counts.uNumColorRejected = 0;
+
+                switch( Level )
+                {
+#if CPU_SIMD_X86
+                case CPU_SIMD_AVX2:
+                    Counts.uNumVPLs = GenerateRSMAVX2( Params, pPositions, pData, Counts.uNumColorRejected );
+                    break;
+                case CPU_SIMD_SSE:
+                    Counts.uNumVPLs = GenerateRSMSSE( Params, pPositions, pData, Counts.uNumColorRejected );
+                    break;
+#endif
+                default:
+                    Counts.uNumVPLs = GenerateRSMScalar( Params, pPositions, pData, Counts.uNumColorRejected );
+                    break;
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumRSMs, RSM_GRAIN_SIZE, GenerateRSMs );
+        }
+        else
+        {
+            GenerateRSMs( 0, uNumRSMs, 0 );
+        }
+
+        // pack the ranges down, in RSM order (each range starts at or after where it goes)
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        Output.RSMOffsets.resize( uNumRSMs + 1 );
+
+        unsigned uNumVPLs = 0;
+        for( unsigned uRSM = 0; uRSM < uNumRSMs; uRSM++ )
+        {
+            const RSMCounts& Counts = m_RSMCounts[uRSM];
+            const size_t uSource = (size_t)uRSM*CPU_RSM_SAMPLES_PER_RSM;
+
+            Output.RSMOffsets[uRSM] = uNumVPLs;
+            if( uSource != uNumVPLs && Counts.uNumVPLs > 0 )
+            {
+                memmove( &Output.PositionAndRadius[uNumVPLs], &Output.PositionAndRadius[uSource], Counts.uNumVPLs*sizeof(CPUFloat4) );
+                memmove( &Output.Data[uNumVPLs], &Output.Data[uSource], Counts.uNumVPLs*sizeof(CPUVPLData) );
+            }
+            uNumVPLs += Counts.uNumVPLs;
+            m_Stats.uNumColorRejected += Counts.uNumColorRejected;
+        }
+        Output.RSMOffsets[uNumRSMs] = uNumVPLs;
+        Output.uNumVPLs = uNumVPLs;
+
+        m_Stats.uNumRSMs = uNumRSMs;
+        m_Stats.uNumSamples = uNumRSMs*CPU_RSM_SAMPLES_PER_RSM;
+        m_Stats.uNumVPLs = uNumVPLs;
+        m_Stats.uNumBrightnessRejected = m_Stats.uNumSamples - m_Stats.uNumColorRejected - uNumVPLs;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
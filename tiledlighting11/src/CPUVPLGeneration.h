@@ -0,0 +1,217 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUVPLGeneration.h
+//
+// CPU implementation of GenerateVPLsCS in Shaders/GenerateVPLs.hlsl: one sample per
+// 2x2 texel block of every reflective shadow map (RSM), unprojected through the
+// shadow camera's inverse, attenuated by the source light's falloff and kept if it
+// passes the color and brightness thresholds. It reads the RSM atlases in the formats
+// RSMRenderer renders them to, so GPU readbacks can be fed to it directly. The samples
+// of an RSM row are processed four (SSE) or eight (AVX2) at a time, and the RSMs are
+// spread across the task scheduler. Every SIMD level and thread count gives the same
+// bits. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+#include "CPUSIMD.h"
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+
+    // RSM size and sample spacing, see gRSMSpotResolution and gRSMPointResolution in
+    // RSMRenderer.cpp and RSM_SIZE and SAMPLE_WIDTH in GenerateVPLs.hlsl
+    static const unsigned CPU_RSM_RESOLUTION = 32;
+    static const unsigned CPU_RSM_SAMPLE_WIDTH = 2;
+    static const unsigned CPU_RSM_SAMPLES_PER_ROW = CPU_RSM_RESOLUTION / CPU_RSM_SAMPLE_WIDTH;
+    static const unsigned CPU_RSM_SAMPLES_PER_RSM = CPU_RSM_SAMPLES_PER_ROW*CPU_RSM_SAMPLES_PER_ROW;
+
+    // Same layout as struct VPLData in CommonHeader.h
+    struct CPUVPLData
+    {
+        CPUFloat4   Direction;
+        CPUFloat4   Color;
+        CPUFloat4   SourceLightDirection;
+    };
+
+    // An RSM atlas as RSMRenderer lays it out: the spot atlas has the lights' RSMs side by
+    // side in one row, the point atlas a row of the six faces' RSMs per light. Row-major,
+    // uWidth texels per row, in the formats of the atlas textures: R16_UNORM depth, and
+    // R11G11B10_FLOAT normals (packed as 0.5*n + 0.5) and diffuse colors.
+    struct CPURSMAtlas
+    {
+        unsigned                uWidth;
+        unsigned                uHeight;
+        const unsigned short*   pDepth;
+        const unsigned*         pNormal;
+        const unsigned*         pDiffuse;
+    };
+
+    // Everything GenerateVPLsCS reads from its constant buffers and SRVs
+    struct CPUVPLGenerationInput
+    {
+        CPUVPLGenerationInput();
+
+        CPURSMAtlas             SpotAtlas;
+        CPURSMAtlas             PointAtlas;
+
+        // g_invViewProjMatrices: the transposed inverse shadow matrices, as CalcCPUSpotLightShadowMatrices
+        // and CalcCPUPointLightShadowMatrices write them (one per spot light, six per point light)
+        const CPUMatrix*        pSpotViewProjInv;
+        const CPUMatrix*        pPointViewProjInv;
+
+        // the shadow-casting light buffers (the colors are R8G8B8A8_UNORM)
+        const CPUFloat4*        pSpotLightCenterAndRadius;
+        const unsigned*         pSpotLightColor;
+        const CPUSpotParams*    pSpotParams;
+        unsigned                uNumSpotLights;
+        const CPUFloat4*        pPointLightCenterAndRadius;
+        const unsigned*         pPointLightColor;
+        unsigned                uNumPointLights;
+
+        // g_fVPLSpotStrength, g_fVPLSpotRadius, g_fVPLPointStrength, g_fVPLPointRadius,
+        // g_fVPLColorThreshold and g_fVPLBrightnessThreshold
+        float                   fSpotStrength;
+        float                   fSpotRadius;
+        float                   fPointStrength;
+        float                   fPointRadius;
+        float                   fColorThreshold;
+        float                   fBrightnessThreshold;
+    };
+
+    // The VPL buffers, spot lights first and then the point lights' faces, each RSM's VPLs
+    // in row-major sample order. The GPU appends in the order its threads finish, so sort
+    // both sides (by position, say) before comparing to a readback.
+    struct CPUVPLGenerationOutput
+    {
+        CPUVPLGenerationOutput() : uNumVPLs(0) {}
+
+        // g_VPLPositionBuffer and g_VPLDataBuffer; may be larger than uNumVPLs
+        std::vector<CPUFloat4>  PositionAndRadius;
+        std::vector<CPUVPLData> Data;
+        unsigned                uNumVPLs;
+
+        // the VPLs of RSM i are [RSMOffsets[i], RSMOffsets[i + 1]), with the spot lights'
+        // RSMs first and then six per point light
+        std::vector<unsigned>   RSMOffsets;
+    };
+
+    struct CPUVPLGenerationStats
+    {
+        unsigned            uNumRSMs;
+        unsigned            uNumSamples;
+
+        // samples whose normalized color has no component above the color threshold (this
+        // includes the empty texels), and samples that pass it but are too dim
+        unsigned            uNumColorRejected;
+        unsigned            uNumBrightnessRejected;
+
+        unsigned            uNumVPLs;
+    };
+
+    // R11G11B10_FLOAT texels: red in the low 11 bits, then green, then blue in the high 10.
+    // Encoding rounds to nearest, flushes negative values and NaNs to 0 and clamps to the
+    // largest finite value.
+    void CPUDecodeR11G11B10( unsigned uPacked, float RGB[3] );
+    unsigned CPUEncodeR11G11B10( const float RGB[3] );
+
+    // Everything about one RSM that is the same for all of its texels, see CPUGetRSMParams
+    struct CPURSMParams
+    {
+        // the top-left texel of the RSM, and the atlas row pitch in texels
+        const unsigned short*   pDepth;
+        const unsigned*         pNormal;
+        const unsigned*         pDiffuse;
+        unsigned                uPitch;
+
+        // the transposed inverse shadow matrix, so each row is dotted with the sample position
+        float                   Inv[4][4];
+
+        float                   LightPos[3];
+        float                   fLightRadius;
+        float                   LightColor[3];
+        float                   fStrength;
+
+        // spot lights have one source direction, point lights one per VPL
+        bool                    bSpot;
+        float                   SpotSourceDir[3];
+
+        float                   fVPLRadius;
+        float                   fColorThreshold;
+        float                   fBrightnessThreshold;
+
+        // post-projection x of each sample column and y of each sample row, at the texel centers
+        float                   SampleX[CPU_RSM_SAMPLES_PER_ROW];
+        float                   SampleY[CPU_RSM_SAMPLES_PER_ROW];
+    };
+
+    // uRSM counts as in CPUVPLGenerationOutput::RSMOffsets
+    void CPUGetRSMParams( const CPUVPLGenerationInput& Input, unsigned uRSM, CPURSMParams& Params );
+
+    // GenerateVPLsCS at any texel of an RSM, not just the top-left texel of each 2x2 block,
+    // for samplers of their own (see CPUVPLSampling.h). Returns false if the texel fails the
+    // color or brightness test; (2i, 2j) gives the same bits as the generator's sample (i, j).
+    bool CPUGenerateTexelVPL( const CPURSMParams& Params, unsigned uX, unsigned uY, CPUFloat4& PositionAndRadius, CPUVPLData& Data );
+
+    class CPUVPLGenerator
+    {
+    public:
+        // Constructor / destructor
+        CPUVPLGenerator();
+        ~CPUVPLGenerator();
+
+        void SetSIMDLevel( CPUSIMDLevel Level ) { m_SIMDLevel = Level; }
+        CPUSIMDLevel GetSIMDLevel() const { return ResolveCPUSIMDLevel( m_SIMDLevel ); }
+
+        // Generate the VPLs of every RSM, spreading the RSMs across pScheduler (NULL runs on the calling thread)
+        void GenerateVPLs( const CPUVPLGenerationInput& Input, CPUVPLGenerationOutput& Output, CPUTaskScheduler* pScheduler );
+
+        const CPUVPLGenerationStats& GetStats() const { return m_Stats; }
+
+    private:
+        // not copyable
+        CPUVPLGenerator( const CPUVPLGenerator& );
+        CPUVPLGenerator& operator=( const CPUVPLGenerator& );
+
+        // per RSM counts, filled in by the threads and summed afterwards
+        struct RSMCounts
+        {
+            unsigned    uNumVPLs;
+            unsigned    uNumColorRejected;
+        };
+
+        CPUSIMDLevel                m_SIMDLevel;
+        CPUVPLGenerationStats       m_Stats;
+        std::vector<RSMCounts>      m_RSMCounts;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,306 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUVPLSampling.cpp
+//
+// Importance-driven VPL sampling on the CPU.
+//
+// The texel weights are computed per RSM in parallel, then summed row by row, in RSM and
+// row order on the calling thread, into one marginal distribution over all the RSMs'
+// rows. Sample i takes its row from the first Hammersley coordinate, (i + 0.5)/N, and its
+// texel within the row from the second, the base 2 radical inverse of i. The drawn texels
+// are sorted, and each distinct one makes a VPL, generated per RSM in parallel. Nothing
+// depends on the thread count.
+//--------------------------------------------------------------------------------------
+
+#include "CPUVPLSampling.h"
+#include "CPULightGeneration.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // RSMs per task, and samples per task
+    static const unsigned RSM_GRAIN_SIZE = 4;
+    static const unsigned SAMPLE_GRAIN_SIZE = 1024;
+
+    static const unsigned TEXELS_PER_RSM = CPU_RSM_RESOLUTION*CPU_RSM_RESOLUTION;
+
+    // the grid's VPLs each stand for a 2x2 block of texels
+    static const double TEXELS_PER_GRID_VPL = (double)( CPU_RSM_SAMPLE_WIDTH*CPU_RSM_SAMPLE_WIDTH );
+
+    // the Philox key for the rotation, after the seed
+    static const unsigned ROTATION_KEY = 0x56504C53;
+
+    // the base 2 radical inverse (van der Corput sequence) of i, in [0,1)
+    static double RadicalInverse2( unsigned i )
+    {
+        i = ( i << 16 ) | ( i >> 16 );
+        i = ( ( i & 0x00FF00FFu ) << 8 ) | ( ( i & 0xFF00FF00u ) >> 8 );
+        i = ( ( i & 0x0F0F0F0Fu ) << 4 ) | ( ( i & 0xF0F0F0F0u ) >> 4 );
+        i = ( ( i & 0x33333333u ) << 2 ) | ( ( i & 0xCCCCCCCCu ) >> 2 );
+        i = ( ( i & 0x55555555u ) << 1 ) | ( ( i & 0xAAAAAAAAu ) >> 1 );
+        return i*( 1.0 / 4294967296.0 );
+    }
+
+    static double Wrap( double u )
+    {
+        return ( u >= 1.0 ) ? u - 1.0 : u;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUVPLSampler::CPUVPLSampler()
+    {
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUVPLSampler::~CPUVPLSampler()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Weigh every texel, draw the samples, then make a VPL of each texel drawn
+    //--------------------------------------------------------------------------------------
+    void CPUVPLSampler::SampleVPLs( const CPUVPLSamplingDesc& Desc, const CPUVPLGenerationInput& Input, CPUVPLGenerationOutput& Output, CPUTaskScheduler* pScheduler )
+    {
+        const unsigned uNumRSMs = Input.uNumSpotLights + 6*Input.uNumPointLights;
+        const unsigned uNumRows = uNumRSMs*CPU_RSM_RESOLUTION;
+
+        memset( &m_Stats, 0, sizeof(m_Stats) );
+        m_Stats.uNumRSMs = uNumRSMs;
+        m_Stats.uNumTexels = uNumRSMs*TEXELS_PER_RSM;
+        m_Stats.uNumSamples = Desc.uNumSamples;
+
+        m_TexelWeights.resize( (size_t)uNumRSMs*TEXELS_PER_RSM );
+        CPUTaskScheduler::RangeFunction WeighTexels = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned uRSM = uBegin; uRSM < uEnd; uRSM++ )
+            {
+                CPURSMParams Params;
+                CPUGetRSMParams( Input, uRSM, Params );
+
+                float* pWeights = &m_TexelWeights[(size_t)uRSM*TEXELS_PER_RSM];
+                for( unsigned uY = 0; uY < CPU_RSM_RESOLUTION; uY++ )
+                {
+                    for( unsigned uX = 0; uX < CPU_RSM_RESOLUTION; uX++ )
+                    {
+                        CPUFloat4 PositionAndRadius;
+                        CPUVPLData Data;
+                        const bool bVPL = CPUGenerateTexelVPL( Params, uX, uY, PositionAndRadius, Data );
+                        pWeights[uY*CPU_RSM_RESOLUTION + uX] = bVPL ? std::max( GetTexelWeight( Data ), 0.0f ) : 0.0f;
+                    }
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumRSMs, RSM_GRAIN_SIZE, WeighTexels );
+        }
+        else
+        {
+            WeighTexels( 0, uNumRSMs, 0 );
+        }
+
+        // the marginal over the rows, and the per-RSM summary
+        m_RowCDF.resize( uNumRows );
+        m_RSMWeights.assign( uNumRSMs, 0.0 );
+        double fTotalWeight = 0.0;
+        for( unsigned uRow = 0; uRow < uNumRows; uRow++ )
+        {
+            const float* pWeights = &m_TexelWeights[(size_t)uRow*CPU_RSM_RESOLUTION];
+            double fRowWeight = 0.0;
+            for( unsigned uX = 0; uX < CPU_RSM_RESOLUTION; uX++ )
+            {
+                fRowWeight += pWeights[uX];
+                m_Stats.uNumCandidates += ( pWeights[uX] > 0.0f ) ? 1 : 0;
+            }
+
+            fTotalWeight += fRowWeight;
+            m_RowCDF[uRow] = fTotalWeight;
+            m_RSMWeights[uRow / CPU_RSM_RESOLUTION] += fRowWeight;
+        }
+        for( unsigned uRSM = 0; uRSM < uNumRSMs; uRSM++ )
+        {
+            m_Stats.uNumEmptyRSMs += ( m_RSMWeights[uRSM] > 0.0 ) ? 0 : 1;
+        }
+        m_Stats.fTotalWeight = fTotalWeight;
+
+        Output.RSMOffsets.assign( uNumRSMs + 1, 0 );
+        Output.uNumVPLs = 0;
+        if( !( fTotalWeight > 0.0 ) || Desc.uNumSamples == 0 )
+        {
+            return;
+        }
+
+        double Rotation[2] = { 0.0, 0.0 };
+        if( Desc.uSeed != 0 )
+        {
+            const unsigned Counter[4] = { 0, 0, 0, 0 };
+            const unsigned Key[2] = { Desc.uSeed, ROTATION_KEY };
+            unsigned Random[4];
+            CPUPhilox4x32( Counter, Key, Random );
+            Rotation[0] = Random[0]*( 1.0 / 4294967296.0 );
+            Rotation[1] = Random[1]*( 1.0 / 4294967296.0 );
+        }
+
+        const unsigned uNumSamples = Desc.uNumSamples;
+        m_Samples.resize( uNumSamples );
+        CPUTaskScheduler::RangeFunction DrawSamples = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned i = uBegin; i < uEnd; i++ )
+            {
+                // the first row whose running sum passes the sample, which has some weight
+                // (unless rounding took the sample to the very end, then the last such row)
+                const double fRowTarget = Wrap( ( i + 0.5 ) / uNumSamples + Rotation[0] )*fTotalWeight;
+                unsigned uRow = (unsigned)( std::upper_bound( m_RowCDF.begin(), m_RowCDF.end(), fRowTarget ) - m_RowCDF.begin() );
+                if( uRow == uNumRows )
+                {
+                    do
+                    {
+                        uRow--;
+                    }
+                    while( m_RowCDF[uRow] == ( uRow > 0 ? m_RowCDF[uRow - 1] : 0.0 ) );
+                }
+
+                // then the texel within the row, the same way
+                const float* pWeights = &m_TexelWeights[(size_t)uRow*CPU_RSM_RESOLUTION];
+                double fRowWeight = 0.0;
+                unsigned uLastTexel = 0;
+                for( unsigned uX = 0; uX < CPU_RSM_RESOLUTION; uX++ )
+                {
+                    fRowWeight += pWeights[uX];
+                    uLastTexel = ( pWeights[uX] > 0.0f ) ? uX : uLastTexel;
+                }
+
+                const double fTexelTarget = Wrap( RadicalInverse2( i ) + Rotation[1] )*fRowWeight;
+                double fSum = 0.0;
+                unsigned uTexel = uLastTexel;
+                for( unsigned uX = 0; uX < uLastTexel; uX++ )
+                {
+                    fSum += pWeights[uX];
+                    if( fSum > fTexelTarget )
+                    {
+                        uTexel = uX;
+                        break;
+                    }
+                }
+
+                m_Samples[i] = uRow*CPU_RSM_RESOLUTION + uTexel;
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumSamples, SAMPLE_GRAIN_SIZE, DrawSamples );
+        }
+        else
+        {
+            DrawSamples( 0, uNumSamples, 0 );
+        }
+
+        // the distinct texels, in RSM order
+        std::sort( m_Samples.begin(), m_Samples.end() );
+        m_Texels.clear();
+        m_TexelCounts.clear();
+        for( unsigned i = 0; i < uNumSamples; )
+        {
+            unsigned uEnd = i + 1;
+            while( uEnd < uNumSamples && m_Samples[uEnd] == m_Samples[i] )
+            {
+                uEnd++;
+            }
+
+            m_Texels.push_back( m_Samples[i] );
+            m_TexelCounts.push_back( uEnd - i );
+            m_Stats.uMaxSamplesPerTexel = std::max( m_Stats.uMaxSamplesPerTexel, uEnd - i );
+            Output.RSMOffsets[m_Samples[i] / TEXELS_PER_RSM + 1]++;
+            i = uEnd;
+        }
+        for( unsigned uRSM = 0; uRSM < uNumRSMs; uRSM++ )
+        {
+            Output.RSMOffsets[uRSM + 1] += Output.RSMOffsets[uRSM];
+        }
+
+        const unsigned uNumVPLs = (unsigned)m_Texels.size();
+        if( Output.PositionAndRadius.size() < uNumVPLs )
+        {
+            Output.PositionAndRadius.resize( uNumVPLs );
+            Output.Data.resize( uNumVPLs );
+        }
+        Output.uNumVPLs = uNumVPLs;
+        m_Stats.uNumVPLs = uNumVPLs;
+
+        // each VPL's color over its probability, per sample, at the grid's strength
+        const double fColorScale = fTotalWeight / ( TEXELS_PER_GRID_VPL*uNumSamples );
+        CPUTaskScheduler::RangeFunction GenerateVPLs = [&]( unsigned uBegin, unsigned uEnd, unsigned )
+        {
+            for( unsigned uRSM = uBegin; uRSM < uEnd; uRSM++ )
+            {
+                if( Output.RSMOffsets[uRSM] == Output.RSMOffsets[uRSM + 1] )
+                {
+                    continue;
+                }
+
+                CPURSMParams Params;
+                CPUGetRSMParams( Input, uRSM, Params );
+                for( unsigned i = Output.RSMOffsets[uRSM]; i < Output.RSMOffsets[uRSM + 1]; i++ )
+                {
+                    const unsigned uTexel = m_Texels[i] % TEXELS_PER_RSM;
+                    CPUVPLData& Data = Output.Data[i];
+                    const bool bVPL = CPUGenerateTexelVPL( Params, uTexel % CPU_RSM_RESOLUTION, uTexel / CPU_RSM_RESOLUTION, Output.PositionAndRadius[i], Data );
+                    assert( bVPL );
+                    (void)bVPL;
+
+                    const float fScale = (float)( m_TexelCounts[i]*fColorScale / m_TexelWeights[m_Texels[i]] );
+                    Data.Color.x *= fScale;
+                    Data.Color.y *= fScale;
+                    Data.Color.z *= fScale;
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumRSMs, RSM_GRAIN_SIZE, GenerateVPLs );
+        }
+        else
+        {
+            GenerateVPLs( 0, uNumRSMs, 0 );
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,119 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUVPLSampling.h
+//
+// Importance-driven VPL sampling, instead of GenerateVPLsCS's one VPL per 2x2 texel block.
+// Every texel of every RSM is weighted by the luminance of the VPL GenerateVPLsCS would
+// make there (0 where it would make none), and a global budget of VPLs is drawn across
+// all the lights and texels in proportion to that weight, with a 2D Hammersley point set
+// through the rows' marginal and each row's conditional distribution. Each VPL's color is
+// scaled by the inverse of its probability, so the VPLs estimate the light of every
+// texel having one, at the strength of the 2x2 grid's VPLs. Lights that see empty space
+// get no VPLs, and colorful walls get more. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPUVPLGeneration.h"
+
+namespace TiledLighting11
+{
+    class CPUTaskScheduler;
+
+    struct CPUVPLSamplingDesc
+    {
+        CPUVPLSamplingDesc() : uNumSamples(4096), uSeed(0) {}
+
+        // the global budget; texels drawn more than once make one VPL, so there may be fewer VPLs
+        unsigned            uNumSamples;
+
+        // 0 uses the Hammersley points as they are, anything else shifts them by a random
+        // offset (a Cranley-Patterson rotation), e.g. to vary the VPLs from frame to frame
+        unsigned            uSeed;
+    };
+
+    struct CPUVPLSamplingStats
+    {
+        unsigned            uNumRSMs;
+        unsigned            uNumTexels;
+
+        // texels with a VPL, and RSMs with none (their lights don't light anything)
+        unsigned            uNumCandidates;
+        unsigned            uNumEmptyRSMs;
+
+        unsigned            uNumSamples;
+        unsigned            uNumVPLs;
+        unsigned            uMaxSamplesPerTexel;
+
+        // the sum of the texel weights
+        double              fTotalWeight;
+    };
+
+    class CPUVPLSampler
+    {
+    public:
+        // Constructor / destructor
+        CPUVPLSampler();
+        ~CPUVPLSampler();
+
+        // Sample the VPLs of every RSM, spreading the RSMs and the samples across pScheduler
+        // (NULL runs on the calling thread). The output is in the generator's layout, with
+        // each RSM's VPLs in texel order.
+        void SampleVPLs( const CPUVPLSamplingDesc& Desc, const CPUVPLGenerationInput& Input, CPUVPLGenerationOutput& Output, CPUTaskScheduler* pScheduler );
+
+        const CPUVPLSamplingStats& GetStats() const { return m_Stats; }
+
+        // The per-light summary of the last call: each RSM's total weight, in RSM order
+        const std::vector<double>& GetRSMWeights() const { return m_RSMWeights; }
+
+        // What a texel's VPL is weighted by
+        static float GetTexelWeight( const CPUVPLData& Data ) { return 0.2126f*Data.Color.x + 0.7152f*Data.Color.y + 0.0722f*Data.Color.z; }
+
+    private:
+        // not copyable
+        CPUVPLSampler( const CPUVPLSampler& );
+        CPUVPLSampler& operator=( const CPUVPLSampler& );
+
+        CPUVPLSamplingStats     m_Stats;
+
+        // every texel's weight, RSM after RSM, each row-major
+        std::vector<float>      m_TexelWeights;
+
+        // the running sum of the row weights over all the RSMs' rows, and each RSM's total
+        std::vector<double>     m_RowCDF;
+        std::vector<double>     m_RSMWeights;
+
+        // the texel each sample drew, then the distinct ones and how many times each was drawn
+        std::vector<unsigned>   m_Samples;
+        std::vector<unsigned>   m_Texels;
+        std::vector<unsigned>   m_TexelCounts;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,252 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUZBinnedCulling.cpp
+//
+// Z-binned light culling on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "CPUZBinnedCulling.h"
+#include "CPUTaskScheduler.h"
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+namespace TiledLighting11
+{
+    // an empty bin: lowest sorted position 0xFFFF, highest 0
+    static const unsigned EMPTY_BIN = 0x0000FFFF;
+
+    // float to uint with the same ordering, for sorting by depth
+    static unsigned GetOrderedBits( float f )
+    {
+        unsigned u;
+        memcpy( &u, &f, sizeof(u) );
+        return ( u & 0x80000000u ) ? ~u : ( u | 0x80000000u );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Bin of a view-space depth
+    //--------------------------------------------------------------------------------------
+    unsigned CPUZBinning::GetBin( float fViewZ ) const
+    {
+        const float fBin = fViewZ*GetBinScale();
+        return std::min( (unsigned)std::max( fBin, 0.0f ), uNumBins - 1 );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CPUZBinnedLightCuller::CPUZBinnedLightCuller()
+        :m_SIMDLevel(CPU_SIMD_AUTO)
+    {
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CPUZBinnedLightCuller::~CPUZBinnedLightCuller()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Sort the lights by the depth of their centers, and record for each bin the lowest
+    // and highest sorted position of the lights whose depth range overlaps it
+    //--------------------------------------------------------------------------------------
+    void CPUZBinnedLightCuller::SortAndBinLights( const CPUViewSpaceLights& Lights, const CPUZBinning& Binning, CPUViewSpaceLights& SortedLights, CPUZBinnedLights& Output )
+    {
+        const unsigned uNumLights = Lights.uCount;
+        assert( uNumLights <= 0x10000 );
+
+        m_SortKeys.resize( uNumLights );
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            m_SortKeys[i] = ( (unsigned long long)GetOrderedBits( Lights.Z[i] ) << 32 ) | i;
+        }
+        std::sort( m_SortKeys.begin(), m_SortKeys.end() );
+
+        const unsigned uPaddedCount = ( uNumLights + 7 ) & ~7u;
+        SortedLights.X.assign( uPaddedCount, 0.0f );
+        SortedLights.Y.assign( uPaddedCount, 0.0f );
+        SortedLights.Z.assign( uPaddedCount, 0.0f );
+        SortedLights.Radius.assign( uPaddedCount, 0.0f );
+        SortedLights.uCount = uNumLights;
+        Output.SortedIndices.resize( uNumLights );
+        Output.Bins.assign( Binning.uNumBins, EMPTY_BIN );
+
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            const unsigned uIndex = (unsigned)( m_SortKeys[i] & 0xFFFFFFFFu );
+            const float z = Lights.Z[uIndex];
+            const float r = Lights.Radius[uIndex];
+
+            SortedLights.X[i] = Lights.X[uIndex];
+            SortedLights.Y[i] = Lights.Y[uIndex];
+            SortedLights.Z[i] = z;
+            SortedLights.Radius[i] = r;
+            Output.SortedIndices[i] = (unsigned short)uIndex;
+
+            // entirely behind the camera
+            if( z + r < 0.0f )
+            {
+                continue;
+            }
+
+            const unsigned uFirstBin = Binning.GetBin( z - r );
+            const unsigned uLastBin = Binning.GetBin( z + r );
+            for( unsigned uBin = uFirstBin; uBin <= uLastBin; uBin++ )
+            {
+                const unsigned uLow = std::min( Output.Bins[uBin] & 0xFFFF, i );
+                const unsigned uHigh = std::max( Output.Bins[uBin] >> 16, i );
+                Output.Bins[uBin] = uLow | ( uHigh << 16 );
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // One bit per sorted light per tile, set if the light touches the tile's depth range
+    //--------------------------------------------------------------------------------------
+    void CPUZBinnedLightCuller::BuildTileMasks( const CPULightCullingInput& Input, const CPUViewSpaceLights& SortedLights, CPUZBinnedLights& Output, CPUTaskScheduler* pScheduler )
+    {
+        const unsigned uNumTilesX = CPULightCuller::GetNumTiles( Input.uWidth, Input.uTileRes );
+        const unsigned uNumTiles = uNumTilesX*CPULightCuller::GetNumTiles( Input.uHeight, Input.uTileRes );
+        const unsigned uNumWords = ( SortedLights.uCount + 31 ) / 32;
+
+        Output.uNumMaskWords = uNumWords;
+        Output.TileMasks.assign( (size_t)uNumTiles*uNumWords, 0 );
+
+        const unsigned uNumThreads = pScheduler ? pScheduler->GetNumThreads() : 1;
+        std::vector< std::vector<unsigned> > ThreadIndices( uNumThreads );
+        const CPUSIMDLevel Level = ResolveCPUSIMDLevel( m_SIMDLevel );
+
+        CPUTaskScheduler::RangeFunction CullTiles = [&]( unsigned uBegin, unsigned uEnd, unsigned uThreadIndex )
+        {
+            std::vector<unsigned>& Indices = ThreadIndices[uThreadIndex];
+
+            for( unsigned uTile = uBegin; uTile < uEnd; uTile++ )
+            {
+                // the real screen size, so that every pixel of the tile is inside its frustum
+                CPUTileFrustum Frustum;
+                CPULightCuller::BuildTileFrustum( Input, uTile % uNumTilesX, uTile / uNumTilesX, Frustum, false );
+                CPULightCuller::CalculateTileDepthBounds( Input, uTile % uNumTilesX, uTile / uNumTilesX, Frustum );
+
+                Indices.clear();
+                CPULightCuller::CullLightsAgainstFrustum( SortedLights, Frustum, Level, Indices );
+
+                unsigned* pMask = uNumWords ? &Output.TileMasks[(size_t)uTile*uNumWords] : NULL;
+                for( size_t i = 0; i < Indices.size(); i++ )
+                {
+                    pMask[Indices[i] / 32] |= 1u << ( Indices[i] % 32 );
+                }
+            }
+        };
+
+        if( pScheduler )
+        {
+            pScheduler->ParallelFor( uNumTiles, 8, CullTiles );
+        }
+        else
+        {
+            CullTiles( 0, uNumTiles, 0 );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Sort, bin and cull every light type
+    //--------------------------------------------------------------------------------------
+    void CPUZBinnedLightCuller::CullLights( const CPULightCullingInput& Input, const CPUZBinning& Binning, CPUZBinnedCullingOutput& Output, CPUTaskScheduler* pScheduler )
+    {
+        assert( Input.pDepth != NULL );
+        assert( Binning.uNumBins > 0 );
+
+        const bool bVPLsEnabled = ( Input.pVPLCenterAndRadius != NULL );
+
+        Output.uTileRes = Input.uTileRes;
+        Output.uNumTilesX = CPULightCuller::GetNumTiles( Input.uWidth, Input.uTileRes );
+        Output.uNumTilesY = CPULightCuller::GetNumTiles( Input.uHeight, Input.uTileRes );
+        Output.Binning = Binning;
+
+        CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pPointLightCenterAndRadius, Input.uNumPointLights, m_PointLights );
+        CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pSpotLightCenterAndRadius, Input.uNumSpotLights, m_SpotLights );
+        CPULightCuller::TransformLightsToViewSpace( Input.mView, Input.pVPLCenterAndRadius, bVPLsEnabled ? Input.uNumVPLs : 0, m_VPLs );
+
+        SortAndBinLights( m_PointLights, Binning, m_SortedLights, Output.PointLights );
+        BuildTileMasks( Input, m_SortedLights, Output.PointLights, pScheduler );
+
+        SortAndBinLights( m_SpotLights, Binning, m_SortedLights, Output.SpotLights );
+        BuildTileMasks( Input, m_SortedLights, Output.SpotLights, pScheduler );
+
+        if( bVPLsEnabled )
+        {
+            SortAndBinLights( m_VPLs, Binning, m_SortedLights, Output.VPLs );
+            BuildTileMasks( Input, m_SortedLights, Output.VPLs, pScheduler );
+        }
+        else
+        {
+            Output.VPLs = CPUZBinnedLights();
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Walk the mask words of a pixel's tile inside its bin's range
+    //--------------------------------------------------------------------------------------
+    void CPUZBinnedLightCuller::GetZBinnedLights( const CPUZBinnedCullingOutput& Output, const CPUZBinnedLights& Lights, unsigned uX, unsigned uY, float fViewZ, std::vector<unsigned>& Indices )
+    {
+        if( Lights.Bins.empty() )
+        {
+            return;
+        }
+
+        const unsigned uBin = Lights.Bins[Output.Binning.GetBin( fViewZ )];
+        const unsigned uLow = uBin & 0xFFFF;
+        const unsigned uHigh = uBin >> 16;
+        if( uLow > uHigh )
+        {
+            return;
+        }
+
+        const unsigned uTileIndex = ( uX / Output.uTileRes ) + ( uY / Output.uTileRes )*Output.uNumTilesX;
+        const unsigned* pMask = &Lights.TileMasks[(size_t)uTileIndex*Lights.uNumMaskWords];
+
+        for( unsigned uWord = uLow / 32; uWord <= uHigh / 32; uWord++ )
+        {
+            // clip the word to [uLow,uHigh]
+            unsigned uMask = pMask[uWord];
+            if( uWord == uLow / 32 ) uMask &= ~0u << ( uLow % 32 );
+            if( uWord == uHigh / 32 ) uMask &= ~0u >> ( 31 - uHigh % 32 );
+
+            while( uMask != 0 )
+            {
+                Indices.push_back( Lights.SortedIndices[uWord*32 + CountTrailingZeros( uMask )] );
+                uMask &= uMask - 1;
+            }
+        }
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
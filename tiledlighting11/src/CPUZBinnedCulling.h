@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: CPUZBinnedCulling.h
+//
+// Z-binned light culling on the CPU. Lights are sorted by view-space depth every frame,
+// a 1D array of depth bins stores the range of sorted lights that reach each bin, and
+// every 16x16 tile stores a bitmask of the sorted lights that touch it. A pixel's lights
+// are the bits of its tile's mask inside its bin's range. Memory is O(tiles x lights/32)
+// bits, with no per-tile light limit. The result is decoded by GetZBinLightRange and
+// GetZBinLightMaskWord in Shaders/CommonHeader.h. This file has no D3D or DXUT dependencies.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "CPULightCulling.h"
+
+namespace TiledLighting11
+{
+    static const unsigned CPU_ZBIN_DEFAULT_NUM_BINS = 256;
+
+    // Linear depth bins over [0,fFarZ], the last bin also runs to infinity
+    struct CPUZBinning
+    {
+        CPUZBinning() : uNumBins(CPU_ZBIN_DEFAULT_NUM_BINS), fFarZ(1000.0f) {}
+
+        unsigned            uNumBins;
+        float               fFarZ;
+
+        // bin = floor( viewZ*fScale ), the form the shader lookup uses
+        float GetBinScale() const { return uNumBins / fFarZ; }
+        unsigned GetBin( float fViewZ ) const;
+    };
+
+    // Z-binned layout, per light type:
+    // SortedIndices maps a sorted position back to the index in the light array (R16_UINT).
+    // Bins holds one uint per bin: | Lowest Sorted Position (low 16 bits) | Highest Sorted Position (high 16 bits) |,
+    // with low > high for a bin that no light reaches.
+    // TileMasks holds uNumMaskWords uints per tile, bit i of word w set if sorted light 32*w+i touches the tile.
+    struct CPUZBinnedLights
+    {
+        CPUZBinnedLights() : uNumMaskWords(0) {}
+
+        std::vector<unsigned short> SortedIndices;
+        std::vector<unsigned>       Bins;
+        std::vector<unsigned>       TileMasks;
+        unsigned                    uNumMaskWords;
+
+        size_t GetMemorySize() const { return SortedIndices.size()*sizeof(unsigned short) + ( Bins.size() + TileMasks.size() )*sizeof(unsigned); }
+    };
+
+    struct CPUZBinnedCullingOutput
+    {
+        CPUZBinnedCullingOutput() : uTileRes(CPU_CULLING_TILE_RES), uNumTilesX(0), uNumTilesY(0) {}
+
+        unsigned            uTileRes;
+        unsigned            uNumTilesX;
+        unsigned            uNumTilesY;
+        CPUZBinning         Binning;
+
+        CPUZBinnedLights    PointLights;
+        CPUZBinnedLights    SpotLights;
+        CPUZBinnedLights    VPLs;
+    };
+
+    class CPUZBinnedLightCuller
+    {
+    public:
+        // Constructor / destructor
+        CPUZBinnedLightCuller();
+        ~CPUZBinnedLightCuller();
+
+        void SetSIMDLevel( CPUSIMDLevel Level ) { m_SIMDLevel = Level; }
+
+        // Sort, bin and cull. uMaxNumLightsPerTile and uMaxNumVPLsPerTile in Input are ignored.
+        // Each light array is limited to 65536 lights by the 16-bit bin ranges.
+        void CullLights( const CPULightCullingInput& Input, const CPUZBinning& Binning, CPUZBinnedCullingOutput& Output, CPUTaskScheduler* pScheduler );
+
+        // Same lookup as GetZBinLightRange and GetZBinLightMaskWord in CommonHeader.h, for a pixel
+        // at (uX,uY) with view-space depth fViewZ. Appends the light array indices to Indices.
+        static void GetZBinnedLights( const CPUZBinnedCullingOutput& Output, const CPUZBinnedLights& Lights, unsigned uX, unsigned uY, float fViewZ, std::vector<unsigned>& Indices );
+
+    private:
+        void SortAndBinLights( const CPUViewSpaceLights& Lights, const CPUZBinning& Binning, CPUViewSpaceLights& SortedLights, CPUZBinnedLights& Output );
+        void BuildTileMasks( const CPULightCullingInput& Input, const CPUViewSpaceLights& SortedLights, CPUZBinnedLights& Output, CPUTaskScheduler* pScheduler );
+
+        CPUSIMDLevel                    m_SIMDLevel;
+
+        // per-frame view-space copies of the light arrays, and the same lights sorted by depth
+        CPUViewSpaceLights              m_PointLights;
+        CPUViewSpaceLights              m_SpotLights;
+        CPUViewSpaceLights              m_VPLs;
+        CPUViewSpaceLights              m_SortedLights;
+
+        // depth in the high 32 bits (as an ordered uint), light index in the low 32 bits
+        std::vector<unsigned long long> m_SortKeys;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
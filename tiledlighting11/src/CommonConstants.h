@@ -23,12 +23,13 @@
 //--------------------------------------------------------------------------------------
 // File: CommonConstants.h
 //
-// Common constants for the TiledLighting11 sample.
+// Common constants for the TiledLighting11 sample. This file has no D3D or DXUT
+// dependencies, so the CPU code and its benchmark share it with the sample.
 //--------------------------------------------------------------------------------------
 
 #pragma once
 
-#include "..\\..\\DXUT\\Core\\DXUT.h"
+#include <assert.h>
 
 namespace TiledLighting11
 {
@@ -49,6 +50,72 @@ namespace TiledLighting11
     };
     static const int g_nMSAASampleCount[NUM_MSAA_SETTINGS] = {1,2,4};
 
+    // light culling tile sizes, 8x8, 16x16, and 32x32 pixels
+    // (the tiled culling compute shaders are compiled once per setting)
+    enum TileResSetting
+    {
+        TILE_RES_SETTING_8 = 0,
+        TILE_RES_SETTING_16,
+        TILE_RES_SETTING_32,
+        NUM_TILE_RES_SETTINGS
+    };
+    static const int g_nTileRes[NUM_TILE_RES_SETTINGS] = {8,16,32};
+
+    // returns the TileResSetting for a tile size in g_nTileRes
+    inline int GetTileResSetting( unsigned uTileRes )
+    {
+        switch( uTileRes )
+        {
+        case 8:  return TILE_RES_SETTING_8;
+        case 16: return TILE_RES_SETTING_16;
+        case 32: return TILE_RES_SETTING_32;
+        default: assert(false); break;
+        }
+
+        return TILE_RES_SETTING_16;
+    }
+
+    // Light culling constants.
+    // These must match their counterparts in CommonHeader.h
+    static const unsigned MAX_NUM_LIGHTS_PER_TILE = 272;
+    static const unsigned MAX_NUM_VPLS_PER_TILE = 1024;
+
+    //--------------------------------------------------------------------------------------
+    // Adjust max number of lights per tile based on screen height.
+    // This assumes that the demo has a constant vertical field of view (fovy).
+    //
+    // Note that the light culling tile size stays fixed as screen size changes.
+    // With a constant fovy, reducing the screen height shrinks the projected 
+    // view of the scene, and so more lights can fall into our fixed tile size.
+    //
+    // This function reduces the max lights per tile as screen height increases, 
+    // to save memory. It was tuned for this particular demo and is not intended 
+    // as a general solution for all scenes. It was also tuned for 16x16 tiles:
+    // the limit does not grow with the tile size, so 32x32 tiles overflow sooner.
+    //--------------------------------------------------------------------------------------
+    inline unsigned GetMaxNumLightsPerTile( unsigned uHeight )
+    {
+        const unsigned kAdjustmentMultipier = 16;
+
+        // I haven't tested at greater than 1080p, so cap it
+        uHeight = (uHeight > 1080) ? 1080 : uHeight;
+
+        // adjust max lights per tile down as height increases
+        return ( MAX_NUM_LIGHTS_PER_TILE - ( kAdjustmentMultipier * ( uHeight / 120 ) ) );
+    }
+
+    // The same for the VPL lists, see GetMaxNumLightsPerTile
+    inline unsigned GetMaxNumVPLsPerTile( unsigned uHeight )
+    {
+        const unsigned kAdjustmentMultipier = 8;
+
+        // I haven't tested at greater than 1080p, so cap it
+        uHeight = (uHeight > 1080) ? 1080 : uHeight;
+
+        // adjust max lights per tile down as height increases
+        return ( MAX_NUM_VPLS_PER_TILE - ( kAdjustmentMultipier * ( uHeight / 120 ) ) );
+    }
+
 } // namespace TiledLighting11
 
 //--------------------------------------------------------------------------------------
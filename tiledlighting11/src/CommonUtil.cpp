@@ -33,6 +33,8 @@
 #include "..\\..\\AMD_SDK\\inc\\AMD_SDK.h"
 
 #include "CommonUtil.h"
+#include "CPULightListTelemetry.h"
+#include "DefaultScene.h"
 
 using namespace DirectX;
 
@@ -148,22 +150,19 @@ static void UpdateBlendedObjectData(const XMVECTOR vEyePt)
 template <size_t nNumGridVertices, size_t nNumGridIndices>
 static void InitGridObjectData(int nNumGridCells1D, CommonUtilGridVertex GridVertexData[TiledLighting11::MAX_NUM_GRID_OBJECTS][nNumGridVertices], unsigned short GridIndexData[nNumGridIndices])
 {
-    const float fGridSizeWorldSpace = 100.0f;
+    const float fGridSizeWorldSpace = TiledLighting11::GRID_OBJECT_SIZE;
     const float fGridSizeWorldSpaceHalf = 0.5f * fGridSizeWorldSpace;
 
     const float fPosStep = fGridSizeWorldSpace / (float)(nNumGridCells1D);
     const float fTexStep = 1.0f / (float)(nNumGridCells1D);
 
-    const float fPosX = 725.0f;
-    const float fPosYStart = 1000.0f;
-    const float fStepY = 1.05f * fGridSizeWorldSpace;
-    const float fPosZStart = 1467.0f;
-    const float fStepZ = 1.05f * fGridSizeWorldSpace;
-
     for( int nGrid = 0; nGrid < TiledLighting11::MAX_NUM_GRID_OBJECTS; nGrid++ )
     {
-        const float fCurrentPosYOffset = fPosYStart - (float)((nGrid/28)%10)*fStepY;
-        const float fCurrentPosZOffset = fPosZStart - (float)(nGrid%28)*fStepZ;
+        float Center[3];
+        TiledLighting11::GetGridObjectCenter( nGrid, Center );
+        const float fPosX = Center[0];
+        const float fCurrentPosYOffset = Center[1];
+        const float fCurrentPosZOffset = Center[2];
 
         // front side verts
         for( int i = 0; i < nNumGridCells1D+1; i++ )
@@ -244,6 +243,7 @@ namespace TiledLighting11
     CommonUtil::CommonUtil()
         :m_uWidth(0)
         ,m_uHeight(0)
+        ,m_uTileRes(16)
         ,m_pLightIndexBuffer(NULL)
         ,m_pLightIndexBufferSRV(NULL)
         ,m_pLightIndexBufferUAV(NULL)
@@ -283,6 +283,7 @@ namespace TiledLighting11
         ,m_pDebugDrawLegendForNumLightsPerTileGrayscalePS(NULL)
         ,m_pDebugDrawLegendForNumLightsLayout11(NULL)
         ,m_pFullScreenVS(NULL)
+        ,m_pFullScreenDepthBlitPS(NULL)
     {
         assert( CommonUtilObjectCounter == 0 );
         CommonUtilObjectCounter++;
@@ -391,6 +392,7 @@ namespace TiledLighting11
         {
             SAFE_RELEASE(m_pFullScreenPS[i]);
         }
+        SAFE_RELEASE(m_pFullScreenDepthBlitPS);
 
         for( int i = 0; i < DEPTH_STENCIL_STATE_NUM_TYPES; i++ )
         {
@@ -532,6 +534,10 @@ namespace TiledLighting11
         DepthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS; 
         V_RETURN( pd3dDevice->CreateDepthStencilState( &DepthStencilDesc, &m_pDepthStencilState[DEPTH_STENCIL_STATE_DEPTH_LESS] ) );
 
+        // Comparison always, for clearing and restoring shadow map tiles
+        DepthStencilDesc.DepthFunc = D3D11_COMPARISON_ALWAYS; 
+        V_RETURN( pd3dDevice->CreateDepthStencilState( &DepthStencilDesc, &m_pDepthStencilState[DEPTH_STENCIL_STATE_DEPTH_ALWAYS] ) );
+
         // Disable culling
         D3D11_RASTERIZER_DESC RasterizerDesc;
         RasterizerDesc.FillMode = D3D11_FILL_SOLID;
@@ -633,6 +639,7 @@ namespace TiledLighting11
         {
             SAFE_RELEASE(m_pFullScreenPS[i]);
         }
+        SAFE_RELEASE(m_pFullScreenDepthBlitPS);
 
         for( int i = 0; i < DEPTH_STENCIL_STATE_NUM_TYPES; i++ )
         {
@@ -663,6 +670,60 @@ namespace TiledLighting11
 
         // depends on m_uWidth and m_uHeight, so don't do this 
         // until you have updated them (see above)
+        V_RETURN( CreateLightIndexBuffers( pd3dDevice ) );
+
+        // initialize the vertex buffer data for a quad (for drawing the lights-per-tile legend)
+        const float kTextureHeight = (float)g_nLegendNumLines * (float)nLineHeight;
+        const float kTextureWidth = (float)g_nLegendTextureWidth;
+        const float kPaddingLeft = (float)g_nLegendPaddingLeft;
+        const float kPaddingBottom = (float)g_nLegendPaddingBottom;
+        float fLeft = kPaddingLeft;
+        float fRight = kPaddingLeft + kTextureWidth;
+        float fTop = (float)m_uHeight - kPaddingBottom - kTextureHeight;
+        float fBottom =(float)m_uHeight - kPaddingBottom;
+        g_QuadForLegendVertexData[0].v3Pos = XMFLOAT3( fLeft,  fBottom, 0.0f );
+        g_QuadForLegendVertexData[0].v2TexCoord = XMFLOAT2( 0.0f, 0.0f );
+        g_QuadForLegendVertexData[1].v3Pos = XMFLOAT3( fLeft,  fTop, 0.0f );
+        g_QuadForLegendVertexData[1].v2TexCoord = XMFLOAT2( 0.0f, 1.0f );
+        g_QuadForLegendVertexData[2].v3Pos = XMFLOAT3( fRight, fBottom, 0.0f );
+        g_QuadForLegendVertexData[2].v2TexCoord = XMFLOAT2( 1.0f, 0.0f );
+        g_QuadForLegendVertexData[3].v3Pos = XMFLOAT3( fLeft,  fTop, 0.0f );
+        g_QuadForLegendVertexData[3].v2TexCoord = XMFLOAT2( 0.0f, 1.0f );
+        g_QuadForLegendVertexData[4].v3Pos = XMFLOAT3( fRight,  fTop, 0.0f );
+        g_QuadForLegendVertexData[4].v2TexCoord = XMFLOAT2( 1.0f, 1.0f );
+        g_QuadForLegendVertexData[5].v3Pos = XMFLOAT3( fRight, fBottom, 0.0f );
+        g_QuadForLegendVertexData[5].v2TexCoord = XMFLOAT2( 1.0f, 0.0f );
+
+        // Create the vertex buffer for the sprite (a single quad)
+        D3D11_SUBRESOURCE_DATA InitData;
+        D3D11_BUFFER_DESC VBDesc;
+        ZeroMemory( &VBDesc, sizeof(VBDesc) );
+        VBDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        VBDesc.ByteWidth = sizeof( g_QuadForLegendVertexData );
+        VBDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        InitData.pSysMem = g_QuadForLegendVertexData;
+        V_RETURN( pd3dDevice->CreateBuffer( &VBDesc, &InitData, &m_pQuadForLegendVB ) );
+        DXUT_SetDebugName( m_pQuadForLegendVB, "QuadForLegendVB" );
+
+        return S_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Releasing swap chain hook function
+    //--------------------------------------------------------------------------------------
+    void CommonUtil::OnReleasingSwapChain()
+    {
+        ReleaseLightIndexBuffers();
+        SAFE_RELEASE(m_pQuadForLegendVB);
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Create the per-tile light index buffers, sized for the current screen size and tile size
+    //--------------------------------------------------------------------------------------
+    HRESULT CommonUtil::CreateLightIndexBuffers( ID3D11Device* pd3dDevice )
+    {
+        HRESULT hr;
+
         unsigned uNumTiles = GetNumTilesX()*GetNumTilesY();
         unsigned uMaxNumElementsPerTile = GetMaxNumElementsPerTile();
         unsigned uMaxNumVPLElementsPerTile = GetMaxNumVPLElementsPerTile();
@@ -718,46 +779,13 @@ namespace TiledLighting11
         UAVDesc.Buffer.NumElements = uMaxNumVPLElementsPerTile * uNumTiles;
         V_RETURN( pd3dDevice->CreateUnorderedAccessView( m_pVPLIndexBuffer, &UAVDesc, &m_pVPLIndexBufferUAV ) );
 
-        // initialize the vertex buffer data for a quad (for drawing the lights-per-tile legend)
-        const float kTextureHeight = (float)g_nLegendNumLines * (float)nLineHeight;
-        const float kTextureWidth = (float)g_nLegendTextureWidth;
-        const float kPaddingLeft = (float)g_nLegendPaddingLeft;
-        const float kPaddingBottom = (float)g_nLegendPaddingBottom;
-        float fLeft = kPaddingLeft;
-        float fRight = kPaddingLeft + kTextureWidth;
-        float fTop = (float)m_uHeight - kPaddingBottom - kTextureHeight;
-        float fBottom =(float)m_uHeight - kPaddingBottom;
-        g_QuadForLegendVertexData[0].v3Pos = XMFLOAT3( fLeft,  fBottom, 0.0f );
-        g_QuadForLegendVertexData[0].v2TexCoord = XMFLOAT2( 0.0f, 0.0f );
-        g_QuadForLegendVertexData[1].v3Pos = XMFLOAT3( fLeft,  fTop, 0.0f );
-        g_QuadForLegendVertexData[1].v2TexCoord = XMFLOAT2( 0.0f, 1.0f );
-        g_QuadForLegendVertexData[2].v3Pos = XMFLOAT3( fRight, fBottom, 0.0f );
-        g_QuadForLegendVertexData[2].v2TexCoord = XMFLOAT2( 1.0f, 0.0f );
-        g_QuadForLegendVertexData[3].v3Pos = XMFLOAT3( fLeft,  fTop, 0.0f );
-        g_QuadForLegendVertexData[3].v2TexCoord = XMFLOAT2( 0.0f, 1.0f );
-        g_QuadForLegendVertexData[4].v3Pos = XMFLOAT3( fRight,  fTop, 0.0f );
-        g_QuadForLegendVertexData[4].v2TexCoord = XMFLOAT2( 1.0f, 1.0f );
-        g_QuadForLegendVertexData[5].v3Pos = XMFLOAT3( fRight, fBottom, 0.0f );
-        g_QuadForLegendVertexData[5].v2TexCoord = XMFLOAT2( 1.0f, 0.0f );
-
-        // Create the vertex buffer for the sprite (a single quad)
-        D3D11_SUBRESOURCE_DATA InitData;
-        D3D11_BUFFER_DESC VBDesc;
-        ZeroMemory( &VBDesc, sizeof(VBDesc) );
-        VBDesc.Usage = D3D11_USAGE_IMMUTABLE;
-        VBDesc.ByteWidth = sizeof( g_QuadForLegendVertexData );
-        VBDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        InitData.pSysMem = g_QuadForLegendVertexData;
-        V_RETURN( pd3dDevice->CreateBuffer( &VBDesc, &InitData, &m_pQuadForLegendVB ) );
-        DXUT_SetDebugName( m_pQuadForLegendVB, "QuadForLegendVB" );
-
         return S_OK;
     }
 
     //--------------------------------------------------------------------------------------
-    // Releasing swap chain hook function
+    // Release the per-tile light index buffers
     //--------------------------------------------------------------------------------------
-    void CommonUtil::OnReleasingSwapChain()
+    void CommonUtil::ReleaseLightIndexBuffers()
     {
         SAFE_RELEASE(m_pLightIndexBuffer);
         SAFE_RELEASE(m_pLightIndexBufferSRV);
@@ -774,7 +802,116 @@ namespace TiledLighting11
         SAFE_RELEASE(m_pVPLIndexBuffer);
         SAFE_RELEASE(m_pVPLIndexBufferSRV);
         SAFE_RELEASE(m_pVPLIndexBufferUAV);
-        SAFE_RELEASE(m_pQuadForLegendVB);
+        m_LightListReadback.Release();
+        m_LightListQueue.Reset();
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Read back the per-tile index buffers and gather their occupancy. Only the Forward+
+    // path writes them (Tiled Deferred culls and shades in one pass), so they hold the
+    // lists of the last Forward+ frame. The three buffers are copied into one readback
+    // slot per frame, and the index buffers are recreated (and the readback with them)
+    // whenever the tiles change, so a slot's lists always match the current tiles.
+    //--------------------------------------------------------------------------------------
+    HRESULT CommonUtil::GatherLightListTelemetry( ID3D11Device* pd3dDevice, unsigned uFrame, bool bVPLsEnabled, CPULightListTelemetry& Telemetry )
+    {
+        HRESULT hr;
+
+        if( m_pLightIndexBuffer == NULL )
+        {
+            return E_FAIL;
+        }
+
+        if( !m_LightListReadback.IsCreated() )
+        {
+            D3D11_BUFFER_DESC PointDesc, SpotDesc, VPLDesc;
+            m_pLightIndexBuffer->GetDesc( &PointDesc );
+            m_pSpotIndexBuffer->GetDesc( &SpotDesc );
+            m_pVPLIndexBuffer->GetDesc( &VPLDesc );
+
+            const unsigned ByteWidths[3] = { PointDesc.ByteWidth, SpotDesc.ByteWidth, VPLDesc.ByteWidth };
+            V_RETURN( m_LightListReadback.Create( pd3dDevice, CPU_READBACK_DEFAULT_NUM_SLOTS, 3, ByteWidths, "LightListReadback" ) );
+            m_LightListQueue.Init( &m_LightListReadback, CPU_READBACK_DEFAULT_NUM_SLOTS, m_LightListReadback.GetDataSize() );
+        }
+
+        m_LightListReadback.SetSource( 0, m_pLightIndexBuffer );
+        m_LightListReadback.SetSource( 1, m_pSpotIndexBuffer );
+        m_LightListReadback.SetSource( 2, m_pVPLIndexBuffer );
+        m_LightListQueue.Request( uFrame, bVPLsEnabled ? 1 : 0 );
+
+        if( !m_LightListQueue.Update( uFrame ) )
+        {
+            return S_FALSE;
+        }
+
+        Telemetry.uFrame = m_LightListQueue.GetResultFrame();
+        Telemetry.uWidth = m_uWidth;
+        Telemetry.uHeight = m_uHeight;
+        Telemetry.uTileRes = m_uTileRes;
+        Telemetry.uNumTilesX = GetNumTilesX();
+        Telemetry.uNumTilesY = GetNumTilesY();
+
+        const unsigned uNumTiles = GetNumTilesX()*GetNumTilesY();
+        const unsigned short* pPointLists = (const unsigned short*)m_LightListQueue.GetResult();
+        const unsigned short* pSpotLists = pPointLists + uNumTiles*GetMaxNumElementsPerTile();
+        const unsigned short* pVPLLists = pSpotLists + uNumTiles*GetMaxNumElementsPerTile();
+        GatherLightListOccupancy( pPointLists, uNumTiles, GetMaxNumLightsPerTile(), Telemetry.Point );
+        GatherLightListOccupancy( pSpotLists, uNumTiles, GetMaxNumLightsPerTile(), Telemetry.Spot );
+
+        Telemetry.bHasVPLs = ( m_LightListQueue.GetResultTag() != 0 );
+        if( Telemetry.bHasVPLs )
+        {
+            GatherLightListOccupancy( pVPLLists, uNumTiles, GetMaxNumVPLsPerTile(), Telemetry.VPL );
+        }
+        else
+        {
+            Telemetry.VPL = CPULightListOccupancy();
+        }
+
+        return S_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Change the light culling tile size. The index buffers hold one list per tile, so they
+    // are recreated if the swap chain already exists (OnResizedSwapChain sizes them otherwise).
+    //--------------------------------------------------------------------------------------
+    HRESULT CommonUtil::SetTileRes( ID3D11Device* pd3dDevice, unsigned uTileRes )
+    {
+        HRESULT hr;
+
+        bool bValid = false;
+        for( int i = 0; i < NUM_TILE_RES_SETTINGS; i++ )
+        {
+            bValid = bValid || ( g_nTileRes[i] == (int)uTileRes );
+        }
+        if( !bValid )
+        {
+            return E_INVALIDARG;
+        }
+
+        if( uTileRes == m_uTileRes )
+        {
+            return S_OK;
+        }
+
+        const unsigned uPreviousTileRes = m_uTileRes;
+        m_uTileRes = uTileRes;
+
+        if( m_pLightIndexBuffer != NULL )
+        {
+            ReleaseLightIndexBuffers();
+            hr = CreateLightIndexBuffers( pd3dDevice );
+            if( FAILED( hr ) )
+            {
+                // go back to the previous tile size and its buffers
+                ReleaseLightIndexBuffers();
+                m_uTileRes = uPreviousTileRes;
+                CreateLightIndexBuffers( pd3dDevice );
+                return hr;
+            }
+        }
+
+        return S_OK;
     }
 
     void CommonUtil::InitStaticData()
@@ -810,6 +947,23 @@ namespace TiledLighting11
 
     }
 
+    //--------------------------------------------------------------------------------------
+    // Calculate AABB around a grid object (the same at every triangle density)
+    //--------------------------------------------------------------------------------------
+    void CommonUtil::CalculateGridObjectMinMax( int nGridNumber, XMVECTOR *pBBoxMinOut, XMVECTOR *pBBoxMaxOut )
+    {
+        *pBBoxMinOut = XMLoadFloat3( &g_GridVertexDataLow[nGridNumber][0].v3Pos );
+        *pBBoxMaxOut = *pBBoxMinOut;
+
+        for( int i = 1; i < g_nNumGridVerticesLow; i++ )
+        {
+            XMVECTOR vPos = XMLoadFloat3( &g_GridVertexDataLow[nGridNumber][i].v3Pos );
+
+            *pBBoxMaxOut = XMVectorMax(*pBBoxMaxOut, vPos);
+            *pBBoxMinOut = XMVectorMin(*pBBoxMinOut, vPos);
+        }
+    }
+
     //--------------------------------------------------------------------------------------
     // Add shaders to the shader cache
     //--------------------------------------------------------------------------------------
@@ -845,6 +999,7 @@ namespace TiledLighting11
         {
             SAFE_RELEASE(m_pFullScreenPS[i]);
         }
+        SAFE_RELEASE(m_pFullScreenDepthBlitPS);
 
         AMD::ShaderCache::Macro ShaderMacroFullScreenPS;
         wcscpy_s( ShaderMacroFullScreenPS.m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"NUM_MSAA_SAMPLES" );
@@ -935,22 +1090,33 @@ namespace TiledLighting11
                 L"Common.hlsl", 1, &ShaderMacroFullScreenPS, NULL, NULL, 0 );
         }
 
-        AMD::ShaderCache::Macro ShaderMacroLightCullCS[2];
+        ShaderMacroFullScreenPS.m_iValue = 1;
+        pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pFullScreenDepthBlitPS, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"FullScreenDepthBlitPS",
+            L"Common.hlsl", 1, &ShaderMacroFullScreenPS, NULL, NULL, 0 );
+
+        AMD::ShaderCache::Macro ShaderMacroLightCullCS[3];
         wcscpy_s( ShaderMacroLightCullCS[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILED_CULLING_COMPUTE_SHADER_MODE" );
         wcscpy_s( ShaderMacroLightCullCS[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"NUM_MSAA_SAMPLES" );
+        wcscpy_s( ShaderMacroLightCullCS[2].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
 
         // Set TILED_CULLING_COMPUTE_SHADER_MODE to 4 (blended geometry mode)
         ShaderMacroLightCullCS[0].m_iValue = 4;
 
         // sanity check
-        assert(NUM_LIGHT_CULLING_COMPUTE_SHADERS_FOR_BLENDED_OBJECTS == NUM_MSAA_SETTINGS);
+        assert(NUM_LIGHT_CULLING_COMPUTE_SHADERS_FOR_BLENDED_OBJECTS == NUM_MSAA_SETTINGS*NUM_TILE_RES_SETTINGS);
 
         for( int i = 0; i < NUM_MSAA_SETTINGS; i++ )
         {
             // set NUM_MSAA_SAMPLES
             ShaderMacroLightCullCS[1].m_iValue = g_nMSAASampleCount[i];
-            pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pLightCullCSForBlendedObjects[i], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
-                L"TilingForward.hlsl", 2, ShaderMacroLightCullCS, NULL, NULL, 0 );
+
+            for( int j = 0; j < NUM_TILE_RES_SETTINGS; j++ )
+            {
+                // set TILE_RES
+                ShaderMacroLightCullCS[2].m_iValue = g_nTileRes[j];
+                pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pLightCullCSForBlendedObjects[NUM_TILE_RES_SETTINGS*i + j], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+                    L"TilingForward.hlsl", 3, ShaderMacroLightCullCS, NULL, NULL, 0 );
+            }
         }
     }
 
@@ -1157,7 +1323,7 @@ namespace TiledLighting11
     //--------------------------------------------------------------------------------------
     unsigned CommonUtil::GetNumTilesX() const
     {
-        return (unsigned)( ( m_uWidth + TILE_RES - 1 ) / (float)TILE_RES );
+        return (unsigned)( ( m_uWidth + m_uTileRes - 1 ) / (float)m_uTileRes );
     }
 
     //--------------------------------------------------------------------------------------
@@ -1165,30 +1331,15 @@ namespace TiledLighting11
     //--------------------------------------------------------------------------------------
     unsigned CommonUtil::GetNumTilesY() const
     {
-        return (unsigned)( ( m_uHeight + TILE_RES - 1 ) / (float)TILE_RES );
+        return (unsigned)( ( m_uHeight + m_uTileRes - 1 ) / (float)m_uTileRes );
     }
 
     //--------------------------------------------------------------------------------------
-    // Adjust max number of lights per tile based on screen height.
-    // This assumes that the demo has a constant vertical field of view (fovy).
-    //
-    // Note that the light culling tile size stays fixed as screen size changes.
-    // With a constant fovy, reducing the screen height shrinks the projected 
-    // view of the scene, and so more lights can fall into our fixed tile size.
-    //
-    // This function reduces the max lights per tile as screen height increases, 
-    // to save memory. It was tuned for this particular demo and is not intended 
-    // as a general solution for all scenes.
+    // Adjust max number of lights per tile based on screen height, see CommonConstants.h
     //--------------------------------------------------------------------------------------
     unsigned CommonUtil::GetMaxNumLightsPerTile() const
     {
-        const unsigned kAdjustmentMultipier = 16;
-
-        // I haven't tested at greater than 1080p, so cap it
-        unsigned uHeight = (m_uHeight > 1080) ? 1080 : m_uHeight;
-
-        // adjust max lights per tile down as height increases
-        return ( MAX_NUM_LIGHTS_PER_TILE - ( kAdjustmentMultipier * ( uHeight / 120 ) ) );
+        return TiledLighting11::GetMaxNumLightsPerTile( m_uHeight );
     }
 
     unsigned CommonUtil::GetMaxNumElementsPerTile() const
@@ -1200,26 +1351,11 @@ namespace TiledLighting11
     }
 
     //--------------------------------------------------------------------------------------
-    // Adjust max number of lights per tile based on screen height.
-    // This assumes that the demo has a constant vertical field of view (fovy).
-    //
-    // Note that the light culling tile size stays fixed as screen size changes.
-    // With a constant fovy, reducing the screen height shrinks the projected 
-    // view of the scene, and so more lights can fall into our fixed tile size.
-    //
-    // This function reduces the max lights per tile as screen height increases, 
-    // to save memory. It was tuned for this particular demo and is not intended 
-    // as a general solution for all scenes.
+    // Adjust max number of VPLs per tile based on screen height, see CommonConstants.h
     //--------------------------------------------------------------------------------------
     unsigned CommonUtil::GetMaxNumVPLsPerTile() const
     {
-        const unsigned kAdjustmentMultipier = 8;
-
-        // I haven't tested at greater than 1080p, so cap it
-        unsigned uHeight = (m_uHeight > 1080) ? 1080 : m_uHeight;
-
-        // adjust max lights per tile down as height increases
-        return ( MAX_NUM_VPLS_PER_TILE - ( kAdjustmentMultipier * ( uHeight / 120 ) ) );
+        return TiledLighting11::GetMaxNumVPLsPerTile( m_uHeight );
     }
 
     unsigned CommonUtil::GetMaxNumVPLElementsPerTile() const
@@ -1324,18 +1460,20 @@ namespace TiledLighting11
     }
 
     //--------------------------------------------------------------------------------------
-    // Return one of the light culling compute shaders, based on MSAA settings
+    // Return one of the light culling compute shaders, based on MSAA settings and tile size
     //--------------------------------------------------------------------------------------
-    ID3D11ComputeShader * CommonUtil::GetLightCullCSForBlendedObjects( unsigned uMSAASampleCount ) const
+    ID3D11ComputeShader * CommonUtil::GetLightCullCSForBlendedObjects( unsigned uMSAASampleCount, unsigned uTileRes ) const
     {
         // sanity check
-        assert(NUM_LIGHT_CULLING_COMPUTE_SHADERS_FOR_BLENDED_OBJECTS == NUM_MSAA_SETTINGS);
+        assert(NUM_LIGHT_CULLING_COMPUTE_SHADERS_FOR_BLENDED_OBJECTS == NUM_MSAA_SETTINGS*NUM_TILE_RES_SETTINGS);
+
+        const int nTileResSetting = GetTileResSetting( uTileRes );
 
         switch( uMSAASampleCount )
         {
-        case 1: return m_pLightCullCSForBlendedObjects[MSAA_SETTING_NO_MSAA]; break;
-        case 2: return m_pLightCullCSForBlendedObjects[MSAA_SETTING_2X_MSAA]; break;
-        case 4: return m_pLightCullCSForBlendedObjects[MSAA_SETTING_4X_MSAA]; break;
+        case 1: return m_pLightCullCSForBlendedObjects[NUM_TILE_RES_SETTINGS*MSAA_SETTING_NO_MSAA + nTileResSetting]; break;
+        case 2: return m_pLightCullCSForBlendedObjects[NUM_TILE_RES_SETTINGS*MSAA_SETTING_2X_MSAA + nTileResSetting]; break;
+        case 4: return m_pLightCullCSForBlendedObjects[NUM_TILE_RES_SETTINGS*MSAA_SETTING_4X_MSAA + nTileResSetting]; break;
         default: assert(false); break;
         }
 
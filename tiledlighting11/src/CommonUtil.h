@@ -30,6 +30,7 @@
 
 #include "..\\..\\DXUT\\Core\\DXUT.h"
 #include "CommonConstants.h"
+#include "ReadbackUtil.h"
 
 // Forward declarations
 namespace AMD
@@ -42,6 +43,9 @@ class CFirstPersonCamera;
 
 namespace TiledLighting11
 {
+    struct CPULightListOccupancy;
+    struct CPULightListTelemetry;
+
     enum DebugDrawType
     {
         DEBUG_DRAW_NONE,
@@ -65,6 +69,7 @@ namespace TiledLighting11
         DEPTH_STENCIL_STATE_DEPTH_GREATER_AND_DISABLE_DEPTH_WRITE,
         DEPTH_STENCIL_STATE_DEPTH_EQUAL_AND_DISABLE_DEPTH_WRITE,
         DEPTH_STENCIL_STATE_DEPTH_LESS,
+        DEPTH_STENCIL_STATE_DEPTH_ALWAYS,
         DEPTH_STENCIL_STATE_NUM_TYPES
     };
 
@@ -124,6 +129,7 @@ namespace TiledLighting11
 
         static void InitStaticData();
 		static void CalculateSceneMinMax( CDXUTSDKMesh &Mesh, DirectX::XMVECTOR *pBBoxMinOut, DirectX::XMVECTOR *pBBoxMaxOut );
+        static void CalculateGridObjectMinMax( int nGridNumber, DirectX::XMVECTOR *pBBoxMinOut, DirectX::XMVECTOR *pBBoxMaxOut );
 
         void AddShadersToCache( AMD::ShaderCache *pShaderCache );
 
@@ -138,6 +144,12 @@ namespace TiledLighting11
         HRESULT OnResizedSwapChain( ID3D11Device* pd3dDevice, const DXGI_SURFACE_DESC* pBackBufferSurfaceDesc, int nLineHeight );
         void OnReleasingSwapChain();
 
+        // Light culling tile size in pixels, one of g_nTileRes (16 by default).
+        // Changing it recreates the per-tile index buffers. SetTileRes returns E_INVALIDARG
+        // for any other size, and keeps the previous size if the buffers can't be created.
+        unsigned GetTileRes() const { return m_uTileRes; }
+        HRESULT SetTileRes( ID3D11Device* pd3dDevice, unsigned uTileRes );
+
         unsigned GetNumTilesX() const;
         unsigned GetNumTilesY() const;
         unsigned GetMaxNumLightsPerTile() const;
@@ -145,6 +157,15 @@ namespace TiledLighting11
         unsigned GetMaxNumVPLsPerTile() const;
         unsigned GetMaxNumVPLElementsPerTile() const;
 
+        // Starts reading the point, spot and (if bVPLsEnabled) VPL index buffers of frame uFrame
+        // back, and gathers the occupancy of the newest frame whose readback has arrived, with
+        // its frame number in Telemetry.uFrame. It does not wait for the GPU, so the telemetry
+        // is a few frames behind; S_FALSE means no new frame has arrived yet.
+        HRESULT GatherLightListTelemetry( ID3D11Device* pd3dDevice, unsigned uFrame, bool bVPLsEnabled, CPULightListTelemetry& Telemetry );
+
+        // Forget the frames in flight, e.g. when the frame numbers start over
+        void ResetLightListTelemetry() { m_LightListQueue.Reset(); }
+
         ID3D11ShaderResourceView * const * GetLightIndexBufferSRVParam() const { return &m_pLightIndexBufferSRV; }
         ID3D11UnorderedAccessView * const * GetLightIndexBufferUAVParam() const { return &m_pLightIndexBufferUAV; }
 
@@ -166,8 +187,9 @@ namespace TiledLighting11
 
         ID3D11VertexShader * GetFullScreenVS() const { return m_pFullScreenVS; }
         ID3D11PixelShader * GetFullScreenPS( unsigned uMSAASampleCount ) const;
+        ID3D11PixelShader * GetFullScreenDepthBlitPS() const { return m_pFullScreenDepthBlitPS; }
 
-        ID3D11ComputeShader * GetLightCullCSForBlendedObjects( unsigned uMSAASampleCount ) const;
+        ID3D11ComputeShader * GetLightCullCSForBlendedObjects( unsigned uMSAASampleCount, unsigned uTileRes ) const;
 
         ID3D11DepthStencilState * GetDepthStencilState( int nDepthStencilStateType ) const { return m_pDepthStencilState[nDepthStencilStateType]; }
         ID3D11RasterizerState * GetRasterizerState( int nRasterizerStateType ) const { return m_pRasterizerState[nRasterizerStateType]; }
@@ -176,16 +198,16 @@ namespace TiledLighting11
 
     private:
 
-        // Light culling constants.
-        // These must match their counterparts in CommonHeader.h
-        static const unsigned TILE_RES = 16;
-        static const unsigned MAX_NUM_LIGHTS_PER_TILE = 272;
-        static const unsigned MAX_NUM_VPLS_PER_TILE = 1024;
+        HRESULT CreateLightIndexBuffers( ID3D11Device* pd3dDevice );
+        void ReleaseLightIndexBuffers();
 
         // forward rendering render target width and height
         unsigned                    m_uWidth;
         unsigned                    m_uHeight;
 
+        // light culling tile width and height in pixels
+        unsigned                    m_uTileRes;
+
         // buffers for light culling
         ID3D11Buffer*               m_pLightIndexBuffer;
         ID3D11ShaderResourceView*   m_pLightIndexBufferSRV;
@@ -211,6 +233,10 @@ namespace TiledLighting11
         ID3D11ShaderResourceView*   m_pVPLIndexBufferSRV;
         ID3D11UnorderedAccessView*  m_pVPLIndexBufferUAV;
 
+        // the telemetry readback of the point, spot and VPL index buffers, created on first use
+        StagingReadback             m_LightListReadback;
+        CPUReadbackQueue            m_LightListQueue;
+
         // cube VB and IB (for blended objects)
         ID3D11Buffer*               m_pBlendedVB;
         ID3D11Buffer*               m_pBlendedIB;
@@ -241,7 +267,7 @@ namespace TiledLighting11
         ID3D11InputLayout*          m_pSceneBlendedDepthLayout;
 
         // compute shaders for tiled culling
-        static const int NUM_LIGHT_CULLING_COMPUTE_SHADERS_FOR_BLENDED_OBJECTS = NUM_MSAA_SETTINGS;  // one for each MSAA setting
+        static const int NUM_LIGHT_CULLING_COMPUTE_SHADERS_FOR_BLENDED_OBJECTS = NUM_MSAA_SETTINGS*NUM_TILE_RES_SETTINGS;  // one for each MSAA setting and tile size
         ID3D11ComputeShader*        m_pLightCullCSForBlendedObjects[NUM_LIGHT_CULLING_COMPUTE_SHADERS_FOR_BLENDED_OBJECTS];
 
         // debug draw shaders for the lights-per-tile visualization modes
@@ -262,6 +288,7 @@ namespace TiledLighting11
         static const int NUM_FULL_SCREEN_PIXEL_SHADERS = NUM_MSAA_SETTINGS;  // one for each MSAA setting
         ID3D11VertexShader*         m_pFullScreenVS;
         ID3D11PixelShader*          m_pFullScreenPS[NUM_FULL_SCREEN_PIXEL_SHADERS];
+        ID3D11PixelShader*          m_pFullScreenDepthBlitPS;
 
         // state
         ID3D11DepthStencilState*    m_pDepthStencilState[DEPTH_STENCIL_STATE_NUM_TYPES];
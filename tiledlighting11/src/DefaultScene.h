@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: DefaultScene.h
+//
+// The sample's default scene layout: the shadow-casting lights LightUtil::InitLights adds,
+// and the grid objects CommonUtil builds. This file has no D3D or DXUT dependencies, so
+// the CPU benchmark checks the same scene the sample renders.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CommonConstants.h"
+
+namespace TiledLighting11
+{
+    struct DefaultShadowCastingPointLight
+    {
+        float           CenterAndRadius[4];
+        unsigned char   Color[3];
+    };
+
+    struct DefaultShadowCastingSpotLight
+    {
+        float           PositionAndRadius[4];
+        float           LookAt[3];
+        unsigned char   Color[3];
+    };
+
+    static const DefaultShadowCastingPointLight g_DefaultShadowCastingPointLights[MAX_NUM_SHADOWCASTING_POINTS] =
+    {
+        // Hanging lamps
+        { { -620.0f, 136.0f, 218.0f, 450.0f }, { 200, 100, 0 } },
+        { { -620.0f, 136.0f, -140.0f, 450.0f }, { 200, 100, 0 } },
+        { {  490.0f, 136.0f, 218.0f, 450.0f }, { 200, 100, 0 } },
+        { {  490.0f, 136.0f, -140.0f, 450.0f }, { 200, 100, 0 } },
+
+        // Corner lights
+        { { -1280.0f, 120.0f, -300.0f, 500.0f }, { 120, 60, 60 } },
+        { { -1280.0f, 200.0f,  430.0f, 600.0f }, { 50, 50, 128 } },
+        { { 1030.0f, 200.0f, 545.0f, 500.0f }, { 255, 128, 0 } },
+        { { 1180.0f, 220.0f, -390.0f, 500.0f }, { 100, 100, 255 } },
+
+        // Midpoint lights
+        { { -65.0f, 100.0f, 220.0f, 500.0f }, { 200, 200, 200 } },
+        { { -65.0f, 100.0f,-140.0f, 500.0f }, { 200, 200, 200 } },
+
+        // High gallery lights
+        { { 600.0f, 660.0f, -30.0f, 800.0f }, { 100, 100, 100 } },
+        { { -700.0f, 660.0f, 80.0f, 800.0f }, { 100, 100, 100 } },
+    };
+
+    static const DefaultShadowCastingSpotLight g_DefaultShadowCastingSpotLights[MAX_NUM_SHADOWCASTING_SPOTS] =
+    {
+        // Curtain spot
+        { {  -772.0f, 254.0f, -503.0f, 800.0f }, { -814.0f, 180.0f, -250.0f }, { 255, 255, 255 } },
+
+        // Lion spots
+        { {  1130.0f, 378.0f, 40.0f, 500.0f }, { 1150.0f, 290.0f, 40.0f }, { 200, 200, 100 } },
+        { { -1260.0f, 378.0f, 40.0f, 500.0f }, { -1280.0f, 290.0f, 40.0f }, { 200, 200, 100 } },
+
+        // Gallery spots
+        { { -115.0f, 660.0f, -100.0f, 800.0f }, { -115.0f, 630.0f, 0.0f }, { 200, 200, 200 } },
+        { { -115.0f, 660.0f,  100.0f, 800.0f }, { -115.0f, 630.0f, -100.0f }, { 200, 200, 200 } },
+
+        { { -770.0f, 660.0f, -100.0f, 800.0f }, { -770.0f, 630.0f, 0.0f }, { 200, 200, 200 } },
+        { { -770.0f, 660.0f,  100.0f, 800.0f }, { -770.0f, 630.0f, -100.0f }, { 200, 200, 200 } },
+
+        { { 500.0f, 660.0f, -100.0f, 800.0f }, { 500.0f, 630.0f, 0.0f }, { 200, 200, 200 } },
+        { { 500.0f, 660.0f,  100.0f, 800.0f }, { 500.0f, 630.0f, -100.0f }, { 200, 200, 200 } },
+
+        // Red corner spots
+        { { -1240.0f, 90.0f, -70.0f, 700.0f }, { -1240.0f, 140.0f, -405.0f }, { 200, 0, 0 } },
+        { { -1000.0f, 90.0f, -260.0f, 700.0f }, { -1240.0f, 140.0f, -405.0f }, { 200, 0, 0 } },
+
+        // Green corner spot
+        { { -900.0f, 60.0f, 340.0f, 700.0f }, { -1360.0f, 255.0f, 555.0f }, { 100, 200, 100 } },
+    };
+
+    // The grid objects are two-sided squares in the x = GRID_OBJECT_POS_X plane, laid out
+    // GRID_OBJECTS_PER_ROW to a row from the top-left one, with a 5% gap between them
+    static const float GRID_OBJECT_SIZE = 100.0f;
+    static const float GRID_OBJECT_STEP = 1.05f * GRID_OBJECT_SIZE;
+    static const float GRID_OBJECT_POS_X = 725.0f;
+    static const float GRID_OBJECT_POS_Y_START = 1000.0f;
+    static const float GRID_OBJECT_POS_Z_START = 1467.0f;
+    static const int GRID_OBJECTS_PER_ROW = 28;
+    static const int NUM_GRID_OBJECT_ROWS = 10;
+
+    static_assert( MAX_NUM_GRID_OBJECTS == GRID_OBJECTS_PER_ROW*NUM_GRID_OBJECT_ROWS, "grid object layout" );
+
+    // the center of grid object nGrid; it extends GRID_OBJECT_SIZE/2 from it in y and z
+    inline void GetGridObjectCenter( int nGrid, float Center[3] )
+    {
+        Center[0] = GRID_OBJECT_POS_X;
+        Center[1] = GRID_OBJECT_POS_Y_START - (float)((nGrid/GRID_OBJECTS_PER_ROW)%NUM_GRID_OBJECT_ROWS)*GRID_OBJECT_STEP;
+        Center[2] = GRID_OBJECT_POS_Z_START - (float)(nGrid%GRID_OBJECTS_PER_ROW)*GRID_OBJECT_STEP;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
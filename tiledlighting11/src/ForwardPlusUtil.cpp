@@ -37,11 +37,125 @@
 #include "LightUtil.h"
 #include "ShadowRenderer.h"
 #include "RSMRenderer.h"
+#include "CPULightCulling.h"
 
 #pragma warning( disable : 4100 ) // disable unreference formal parameter warnings for /W4 builds
 
+using namespace DirectX;
+
 namespace TiledLighting11
 {
+    static_assert( sizeof(CPUFloat4) == sizeof(XMFLOAT4), "shadow caster bounds layout" );
+
+    //--------------------------------------------------------------------------------------
+    // Add a bounding box as its center and half extents
+    //--------------------------------------------------------------------------------------
+    static void AddShadowCasterBounds( FXMVECTOR vMin, FXMVECTOR vMax, std::vector<CPUFloat4>& Centers, std::vector<CPUFloat4>& Extents )
+    {
+        CPUFloat4 Center, Extent;
+        XMStoreFloat4( (XMFLOAT4*)&Center, XMVectorSetW( 0.5f*( vMin + vMax ), 1.0f ) );
+        XMStoreFloat4( (XMFLOAT4*)&Extent, XMVectorSetW( 0.5f*( vMax - vMin ), 0.0f ) );
+        Centers.push_back( Center );
+        Extents.push_back( Extent );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Add the bounding box of every subset of every mesh, over the vertices its indices
+    // reach (the position is the first element of the first vertex stream)
+    //--------------------------------------------------------------------------------------
+    static void AddSubsetBounds( const CDXUTSDKMesh& Mesh, std::vector<CPUFloat4>& Centers, std::vector<CPUFloat4>& Extents )
+    {
+        for( UINT iMesh = 0; iMesh < Mesh.GetNumMeshes(); iMesh++ )
+        {
+            const SDKMESH_MESH* pMesh = Mesh.GetMesh( iMesh );
+            const BYTE* pVertices = Mesh.GetRawVerticesAt( pMesh->VertexBuffers[0] );
+            const BYTE* pIndices = Mesh.GetRawIndicesAt( pMesh->IndexBuffer );
+            const UINT uStride = Mesh.GetVertexStride( iMesh, 0 );
+            const bool b32BitIndices = ( Mesh.GetIndexType( iMesh ) == IT_32BIT );
+
+            for( UINT iSubset = 0; iSubset < pMesh->NumSubsets; iSubset++ )
+            {
+                const SDKMESH_SUBSET* pSubset = Mesh.GetSubset( iMesh, iSubset );
+
+                XMVECTOR vMin = XMVectorZero();
+                XMVECTOR vMax = XMVectorZero();
+                for( UINT64 i = 0; i < pSubset->IndexCount; i++ )
+                {
+                    const UINT64 uIndex = pSubset->IndexStart + i;
+                    const UINT64 uVertex = pSubset->VertexStart + ( b32BitIndices ? ((const UINT*)pIndices)[uIndex] : ((const USHORT*)pIndices)[uIndex] );
+                    const XMVECTOR vPos = XMLoadFloat3( (const XMFLOAT3*)( pVertices + uVertex*uStride ) );
+
+                    vMin = ( i == 0 ) ? vPos : XMVectorMin( vMin, vPos );
+                    vMax = ( i == 0 ) ? vPos : XMVectorMax( vMax, vPos );
+                }
+
+                AddShadowCasterBounds( vMin, vMax, Centers, Extents );
+            }
+        }
+    }
+
+    static unsigned GetNumMeshSubsets( const CDXUTSDKMesh& Mesh )
+    {
+        unsigned uNumSubsets = 0;
+        for( UINT iMesh = 0; iMesh < Mesh.GetNumMeshes(); iMesh++ )
+        {
+            uNumSubsets += Mesh.GetNumSubsets( iMesh );
+        }
+        return uNumSubsets;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Draw the subsets of a mesh that are in the caster list, the mesh's subsets being
+    // casters uFirstCaster onwards, and move pCaster past them. Like CDXUTSDKMesh::Render,
+    // but a draw per listed subset.
+    //--------------------------------------------------------------------------------------
+    static void RenderSubsets( ID3D11DeviceContext* pd3dImmediateContext, const CDXUTSDKMesh& Mesh, UINT iDiffuseSlot, unsigned uFirstCaster, const unsigned*& pCaster, const unsigned* pCasterEnd )
+    {
+        unsigned uMeshFirstCaster = uFirstCaster;
+        for( UINT iMesh = 0; iMesh < Mesh.GetNumMeshes() && pCaster != pCasterEnd; iMesh++ )
+        {
+            const SDKMESH_MESH* pMesh = Mesh.GetMesh( iMesh );
+            const unsigned uMeshEndCaster = uMeshFirstCaster + pMesh->NumSubsets;
+
+            if( *pCaster < uMeshEndCaster && pMesh->NumVertexBuffers <= MAX_D3D11_VERTEX_STREAMS )
+            {
+                ID3D11Buffer* pVB[MAX_D3D11_VERTEX_STREAMS];
+                UINT Strides[MAX_D3D11_VERTEX_STREAMS];
+                UINT Offsets[MAX_D3D11_VERTEX_STREAMS];
+                for( UINT i = 0; i < pMesh->NumVertexBuffers; i++ )
+                {
+                    pVB[i] = Mesh.GetVB11( iMesh, i );
+                    Strides[i] = Mesh.GetVertexStride( iMesh, i );
+                    Offsets[i] = 0;
+                }
+
+                pd3dImmediateContext->IASetVertexBuffers( 0, pMesh->NumVertexBuffers, pVB, Strides, Offsets );
+                pd3dImmediateContext->IASetIndexBuffer( Mesh.GetIB11( iMesh ), Mesh.GetIBFormat11( iMesh ), 0 );
+
+                for( ; pCaster != pCasterEnd && *pCaster < uMeshEndCaster; pCaster++ )
+                {
+                    const SDKMESH_SUBSET* pSubset = Mesh.GetSubset( iMesh, *pCaster - uMeshFirstCaster );
+                    pd3dImmediateContext->IASetPrimitiveTopology( CDXUTSDKMesh::GetPrimitiveType11( ( SDKMESH_PRIMITIVE_TYPE )pSubset->PrimitiveType ) );
+
+                    SDKMESH_MATERIAL* pMat = Mesh.GetMaterial( pSubset->MaterialID );
+                    if( iDiffuseSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pDiffuseRV11 ) )
+                    {
+                        pd3dImmediateContext->PSSetShaderResources( iDiffuseSlot, 1, &pMat->pDiffuseRV11 );
+                    }
+
+                    pd3dImmediateContext->DrawIndexed( ( UINT )pSubset->IndexCount, ( UINT )pSubset->IndexStart, ( INT )pSubset->VertexStart );
+                }
+            }
+
+            // skip whatever is left of this mesh (only if its vertex streams did not fit)
+            while( pCaster != pCasterEnd && *pCaster < uMeshEndCaster )
+            {
+                pCaster++;
+            }
+
+            uMeshFirstCaster = uMeshEndCaster;
+        }
+    }
 
     //--------------------------------------------------------------------------------------
     // Constructor
@@ -220,11 +334,11 @@ namespace TiledLighting11
         }
 
         // Light culling compute shader
-        ID3D11ComputeShader* pLightCullCS = GetLightCullCS(CurrentGuiState.m_uMSAASampleCount, bVPLsEnabled);
+        ID3D11ComputeShader* pLightCullCS = GetLightCullCS(CurrentGuiState.m_uMSAASampleCount, bVPLsEnabled, CommonUtil.GetTileRes());
         ID3D11ShaderResourceView* pDepthSRV = DepthStencilBufferForOpaque.m_pDepthStencilSRV;
 
         // Light culling compute shader for transparent objects
-        ID3D11ComputeShader* pLightCullCSForTransparency = CommonUtil.GetLightCullCSForBlendedObjects(CurrentGuiState.m_uMSAASampleCount);
+        ID3D11ComputeShader* pLightCullCSForTransparency = CommonUtil.GetLightCullCSForBlendedObjects(CurrentGuiState.m_uMSAASampleCount, CommonUtil.GetTileRes());
         ID3D11ShaderResourceView* pDepthSRVForTransparency = DepthStencilBufferForTransparency.m_pDepthStencilSRV;
 
         // Switch off alpha blending
@@ -502,12 +616,13 @@ namespace TiledLighting11
             }
         }
 
-        AMD::ShaderCache::Macro ShaderMacroLightCullCS[2];
+        AMD::ShaderCache::Macro ShaderMacroLightCullCS[3];
         wcscpy_s( ShaderMacroLightCullCS[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILED_CULLING_COMPUTE_SHADER_MODE" );
         wcscpy_s( ShaderMacroLightCullCS[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"NUM_MSAA_SAMPLES" );
+        wcscpy_s( ShaderMacroLightCullCS[2].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
 
         // sanity check
-        assert(NUM_LIGHT_CULLING_COMPUTE_SHADERS == 2*NUM_MSAA_SETTINGS);
+        assert(NUM_LIGHT_CULLING_COMPUTE_SHADERS == 2*NUM_MSAA_SETTINGS*NUM_TILE_RES_SETTINGS);
 
         for( int i = 0; i < 2; i++ )
         {
@@ -519,16 +634,50 @@ namespace TiledLighting11
             {
                 // set NUM_MSAA_SAMPLES
                 ShaderMacroLightCullCS[1].m_iValue = g_nMSAASampleCount[j];
-                pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pLightCullCS[NUM_MSAA_SETTINGS*i + j], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
-                    L"TilingForward.hlsl", 2, ShaderMacroLightCullCS, NULL, NULL, 0 );
+
+                for( int k = 0; k < NUM_TILE_RES_SETTINGS; k++ )
+                {
+                    // set TILE_RES
+                    ShaderMacroLightCullCS[2].m_iValue = g_nTileRes[k];
+                    pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pLightCullCS[NUM_TILE_RES_SETTINGS*(NUM_MSAA_SETTINGS*i + j) + k], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+                        L"TilingForward.hlsl", 3, ShaderMacroLightCullCS, NULL, NULL, 0 );
+                }
             }
         }
     }
 
+    //--------------------------------------------------------------------------------------
+    // Bounding boxes of the shadow casters
+    //--------------------------------------------------------------------------------------
+    void ForwardPlusUtil::CalculateShadowCasterBounds( const Scene& Scene, std::vector<CPUFloat4>& Centers, std::vector<CPUFloat4>& Extents )
+    {
+        Centers.clear();
+        Extents.clear();
+
+        AddSubsetBounds( *Scene.m_pSceneMesh, Centers, Extents );
+
+        for( int i = 0; i < MAX_NUM_GRID_OBJECTS; i++ )
+        {
+            XMVECTOR vMin, vMax;
+            CommonUtil::CalculateGridObjectMinMax( i, &vMin, &vMax );
+            AddShadowCasterBounds( vMin, vMax, Centers, Extents );
+        }
+
+        AddSubsetBounds( *Scene.m_pAlphaMesh, Centers, Extents );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The grid objects come after the scene mesh subsets
+    //--------------------------------------------------------------------------------------
+    unsigned ForwardPlusUtil::GetGridObjectShadowCaster( const Scene& Scene, int nGridNumber )
+    {
+        return GetNumMeshSubsets( *Scene.m_pSceneMesh ) + (unsigned)nGridNumber;
+    }
+
     //--------------------------------------------------------------------------------------
     // Depth-only rendering for shadow maps
     //--------------------------------------------------------------------------------------
-    void ForwardPlusUtil::RenderSceneForShadowMaps( const GuiState& CurrentGuiState, const Scene& Scene, const CommonUtil& CommonUtil )
+    void ForwardPlusUtil::RenderSceneForShadowMaps( const GuiState& CurrentGuiState, const Scene& Scene, const CommonUtil& CommonUtil, const unsigned* pCasters, unsigned uNumCasters )
     {
         ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
 
@@ -543,13 +692,40 @@ namespace TiledLighting11
         pd3dImmediateContext->PSSetShaderResources( 1, 1, &pNULLSRV );
         pd3dImmediateContext->PSSetSamplers( 0, 1, &pNULLSampler );
 
+        // the caster numbers of the first grid object and of the first alpha mesh subset
+        const unsigned uFirstGridCaster = pCasters ? GetNumMeshSubsets( *Scene.m_pSceneMesh ) : 0;
+        const unsigned uFirstAlphaCaster = uFirstGridCaster + MAX_NUM_GRID_OBJECTS;
+        const unsigned* pCaster = pCasters;
+        const unsigned* pCasterEnd = pCasters + uNumCasters;
+
         // Draw the main scene
-        Scene.m_pSceneMesh->Render( pd3dImmediateContext );
+        if( pCasters )
+        {
+            RenderSubsets( pd3dImmediateContext, *Scene.m_pSceneMesh, INVALID_SAMPLER_SLOT, 0, pCaster, pCasterEnd );
+        }
+        else
+        {
+            Scene.m_pSceneMesh->Render( pd3dImmediateContext );
+        }
 
         // Draw the grid objects (i.e. the "lots of triangles" system)
-        for( int i = 0; i < CurrentGuiState.m_nNumGridObjects; i++ )
+        if( pCasters )
         {
-            CommonUtil.DrawGrid(i, CurrentGuiState.m_nGridObjectTriangleDensity, false);
+            for( ; pCaster != pCasterEnd && *pCaster < uFirstAlphaCaster; pCaster++ )
+            {
+                const int nGrid = (int)( *pCaster - uFirstGridCaster );
+                if( nGrid < CurrentGuiState.m_nNumGridObjects )
+                {
+                    CommonUtil.DrawGrid(nGrid, CurrentGuiState.m_nGridObjectTriangleDensity, false);
+                }
+            }
+        }
+        else
+        {
+            for( int i = 0; i < CurrentGuiState.m_nNumGridObjects; i++ )
+            {
+                CommonUtil.DrawGrid(i, CurrentGuiState.m_nGridObjectTriangleDensity, false);
+            }
         }
 
         // Draw the alpha-test geometry
@@ -558,7 +734,14 @@ namespace TiledLighting11
         pd3dImmediateContext->VSSetShader( m_pScenePositionAndTexVS, NULL, 0 );
         pd3dImmediateContext->PSSetShader( m_pSceneAlphaTestOnlyPS, NULL, 0 );
         pd3dImmediateContext->PSSetSamplers( 0, 1, CommonUtil.GetSamplerStateParam(SAMPLER_STATE_ANISO) );
-        Scene.m_pAlphaMesh->Render( pd3dImmediateContext, 0 );
+        if( pCasters )
+        {
+            RenderSubsets( pd3dImmediateContext, *Scene.m_pAlphaMesh, 0, uFirstAlphaCaster, pCaster, pCasterEnd );
+        }
+        else
+        {
+            Scene.m_pAlphaMesh->Render( pd3dImmediateContext, 0 );
+        }
         pd3dImmediateContext->RSSetState( NULL );
     }
 
@@ -575,20 +758,21 @@ namespace TiledLighting11
     }
 
     //--------------------------------------------------------------------------------------
-    // Return one of the light culling compute shaders, based on MSAA settings
+    // Return one of the light culling compute shaders, based on MSAA settings and tile size
     //--------------------------------------------------------------------------------------
-    ID3D11ComputeShader * ForwardPlusUtil::GetLightCullCS( unsigned uMSAASampleCount, bool bVPLsEnabled ) const
+    ID3D11ComputeShader * ForwardPlusUtil::GetLightCullCS( unsigned uMSAASampleCount, bool bVPLsEnabled, unsigned uTileRes ) const
     {
         // sanity check
-        assert(NUM_LIGHT_CULLING_COMPUTE_SHADERS == 2*NUM_MSAA_SETTINGS);
+        assert(NUM_LIGHT_CULLING_COMPUTE_SHADERS == 2*NUM_MSAA_SETTINGS*NUM_TILE_RES_SETTINGS);
 
         const int nIndexMultiplier = bVPLsEnabled ? 1 : 0;
+        const int nTileResSetting = GetTileResSetting( uTileRes );
 
         switch( uMSAASampleCount )
         {
-        case 1: return m_pLightCullCS[NUM_MSAA_SETTINGS*nIndexMultiplier + MSAA_SETTING_NO_MSAA]; break;
-        case 2: return m_pLightCullCS[NUM_MSAA_SETTINGS*nIndexMultiplier + MSAA_SETTING_2X_MSAA]; break;
-        case 4: return m_pLightCullCS[NUM_MSAA_SETTINGS*nIndexMultiplier + MSAA_SETTING_4X_MSAA]; break;
+        case 1: return m_pLightCullCS[NUM_TILE_RES_SETTINGS*(NUM_MSAA_SETTINGS*nIndexMultiplier + MSAA_SETTING_NO_MSAA) + nTileResSetting]; break;
+        case 2: return m_pLightCullCS[NUM_TILE_RES_SETTINGS*(NUM_MSAA_SETTINGS*nIndexMultiplier + MSAA_SETTING_2X_MSAA) + nTileResSetting]; break;
+        case 4: return m_pLightCullCS[NUM_TILE_RES_SETTINGS*(NUM_MSAA_SETTINGS*nIndexMultiplier + MSAA_SETTING_4X_MSAA) + nTileResSetting]; break;
         default: assert(false); break;
         }
 
@@ -28,6 +28,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "..\\..\\DXUT\\Core\\DXUT.h"
 #include "CommonConstants.h"
 
@@ -41,6 +43,7 @@ namespace TiledLighting11
     struct GuiState;
     struct DepthStencilBuffer;
     struct Scene;
+    struct CPUFloat4;
     class CommonUtil;
     class LightUtil;
     class ShadowRenderer;
@@ -57,7 +60,17 @@ namespace TiledLighting11
         ~ForwardPlusUtil();
 
         void AddShadersToCache( AMD::ShaderCache *pShaderCache );
-        void RenderSceneForShadowMaps( const GuiState& CurrentGuiState, const Scene& Scene, const CommonUtil& CommonUtil );
+
+        // Bounding boxes (centers and half extents) of the shadow casters, in the order
+        // RenderSceneForShadowMaps numbers them: the scene mesh subsets, the grid objects,
+        // then the alpha mesh subsets
+        static void CalculateShadowCasterBounds( const Scene& Scene, std::vector<CPUFloat4>& Centers, std::vector<CPUFloat4>& Extents );
+
+        // The shadow caster number of a grid object
+        static unsigned GetGridObjectShadowCaster( const Scene& Scene, int nGridNumber );
+
+        // Depth-only rendering of the casters in pCasters (in ascending order), or of the whole scene if pCasters is NULL
+        void RenderSceneForShadowMaps( const GuiState& CurrentGuiState, const Scene& Scene, const CommonUtil& CommonUtil, const unsigned* pCasters = NULL, unsigned uNumCasters = 0 );
 
         // Various hook functions
         HRESULT OnCreateDevice( ID3D11Device* pd3dDevice );
@@ -68,7 +81,7 @@ namespace TiledLighting11
 
     private:
         ID3D11PixelShader * GetScenePS( bool bAlphaTestEnabled, bool bShadowsEnabled, bool bVPLsEnabled ) const;
-        ID3D11ComputeShader * GetLightCullCS( unsigned uMSAASampleCount, bool bVPLsEnabled ) const;
+        ID3D11ComputeShader * GetLightCullCS( unsigned uMSAASampleCount, bool bVPLsEnabled, unsigned uTileRes ) const;
 
     private:
         // shaders for Forward+
@@ -84,8 +97,8 @@ namespace TiledLighting11
         ID3D11PixelShader*          m_pSceneForwardPS[NUM_FORWARD_PIXEL_SHADERS];
 
         // compute shaders for tiled culling
-        static const int NUM_LIGHT_CULLING_COMPUTE_SHADERS = 2*NUM_MSAA_SETTINGS;  // one for each MSAA setting,
-                                                                                   // times two for VPLs enabled/disabled
+        static const int NUM_LIGHT_CULLING_COMPUTE_SHADERS = 2*NUM_MSAA_SETTINGS*NUM_TILE_RES_SETTINGS;  // one for each MSAA setting and tile size,
+                                                                                                         // times two for VPLs enabled/disabled
         ID3D11ComputeShader*        m_pLightCullCS[NUM_LIGHT_CULLING_COMPUTE_SHADERS];
 
         // state for Forward+
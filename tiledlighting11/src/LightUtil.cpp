@@ -33,6 +33,10 @@
 
 #include "LightUtil.h"
 #include "CommonUtil.h"
+#include "CPULightGeneration.h"
+#include "CPUShadowMatrices.h"
+#include "CPUSpotLightCulling.h"
+#include "DefaultScene.h"
 
 #pragma warning( disable : 4100 ) // disable unreference formal parameter warnings for /W4 builds
 
@@ -101,67 +105,51 @@ static XMMATRIX             g_ShadowCastingSpotLightDataArraySpotMatrices[TiledL
 static XMMATRIX             g_ShadowCastingSpotLightViewProjTransposed[TiledLighting11::MAX_NUM_SHADOWCASTING_SPOTS];
 static XMMATRIX             g_ShadowCastingSpotLightViewProjInvTransposed[TiledLighting11::MAX_NUM_SHADOWCASTING_SPOTS];
 
-// miscellaneous constants
-static const float TWO_PI = 6.28318530718f;
-
-// there should only be one LightUtil object
-static int LightUtilObjectCounter = 0;
+// the shadow cameras of the shadow-casting spot lights: the light's position and radius, and where it looks
+static XMFLOAT4             g_ShadowCastingSpotLightDataArrayPositionAndRadius[TiledLighting11::MAX_NUM_SHADOWCASTING_SPOTS];
+static XMFLOAT4             g_ShadowCastingSpotLightDataArrayLookAt[TiledLighting11::MAX_NUM_SHADOWCASTING_SPOTS];
 
-static float GetRandFloat( float fRangeMin, float fRangeMax )
+// attributes of the light pools, one per light buffer
+enum LightUtilPointLightAttribute
 {
-    // Generate random numbers in the half-closed interval
-    // [rangeMin, rangeMax). In other words,
-    // rangeMin <= random number < rangeMax
-    return  (float)rand() / (RAND_MAX + 1) * (fRangeMax - fRangeMin) + fRangeMin;
-}
+    POINT_LIGHT_CENTER_AND_RADIUS = 0,
+    POINT_LIGHT_COLOR,
+    NUM_POINT_LIGHT_ATTRIBUTES
+};
 
-static DWORD GetRandColor()
+enum LightUtilSpotLightAttribute
 {
-    static unsigned uCounter = 0;
-    uCounter++;
-
-    XMFLOAT4 Color;
-    if( uCounter%2 == 0 )
-    {
-        // since green contributes the most to perceived brightness, 
-        // cap it's min value to avoid overly dim lights
-        Color = XMFLOAT4(GetRandFloat(0.0f,1.0f),GetRandFloat(0.27f,1.0f),GetRandFloat(0.0f,1.0f),1.0f);
-    }
-    else
-    {
-        // else ensure the red component has a large value, again 
-        // to avoid overly dim lights
-        Color = XMFLOAT4(GetRandFloat(0.9f,1.0f),GetRandFloat(0.0f,1.0f),GetRandFloat(0.0f,1.0f),1.0f);
-    }
-
-    DWORD dwR = (DWORD)(Color.x * 255.0f + 0.5f);
-    DWORD dwG = (DWORD)(Color.y * 255.0f + 0.5f);
-    DWORD dwB = (DWORD)(Color.z * 255.0f + 0.5f);
+    SPOT_LIGHT_CENTER_AND_RADIUS = 0,
+    SPOT_LIGHT_COLOR,
+    SPOT_LIGHT_SPOT_PARAMS,
+    SPOT_LIGHT_SPOT_MATRIX,
+    NUM_SPOT_LIGHT_ATTRIBUTES
+};
 
-    return COLOR(dwR, dwG, dwB);
-}
+// dirty lights closer than this are uploaded with one UpdateSubresource call
+static const unsigned LIGHT_POOL_MAX_UPLOAD_GAP = 16;
 
-static XMFLOAT3 GetRandLightDirection()
-{
-    static unsigned uCounter = 0;
-    uCounter++;
+// scratch for the dirty ranges of one light buffer
+static std::vector<TiledLighting11::CPULightPoolRange> g_LightPoolRanges;
 
-    XMFLOAT3 vLightDir;
-    vLightDir.x = GetRandFloat(-1.0f,1.0f);
-    vLightDir.y = GetRandFloat( 0.1f,1.0f);
-    vLightDir.z = GetRandFloat(-1.0f,1.0f);
+// the random lights: the arrays above, or the sections of a light set file (kept mapped while in use)
+static TiledLighting11::CPULightSetDesc     g_RandomLights;
+static TiledLighting11::CPULightSetFile     g_RandomLightSetFile;
 
-    if( uCounter%2 == 0 )
-    {
-        vLightDir.y = -vLightDir.y;
-    }
+// motion of the random lights, and the animated light data, in the layout of the light buffers
+static TiledLighting11::CPULightAnimator    g_PointLightAnimator;
+static TiledLighting11::CPULightAnimator    g_SpotLightAnimator;
+static TiledLighting11::CPUFloat4           g_AnimatedLightDataArrayCenterAndRadius[TiledLighting11::MAX_NUM_LIGHTS];
+static DWORD                                g_AnimatedLightDataArrayColor[TiledLighting11::MAX_NUM_LIGHTS];
+static TiledLighting11::CPUSpotParams       g_AnimatedLightDataArraySpotParams[TiledLighting11::MAX_NUM_LIGHTS];
+static TiledLighting11::CPUMatrix           g_AnimatedLightDataArraySpotMatrices[TiledLighting11::MAX_NUM_LIGHTS];
+static float                                g_fLightAnimationRadius = 0.0f;
 
-    XMFLOAT3 vResult;
-    XMVECTOR NormalizedLightDir = XMVector3Normalize( XMLoadFloat3( &vLightDir) );
-    XMStoreFloat3( &vResult, NormalizedLightDir );
+// miscellaneous constants
+static const float TWO_PI = 6.28318530718f;
 
-    return vResult;
-}
+// there should only be one LightUtil object
+static int LightUtilObjectCounter = 0;
 
 static LightUtilSpotParams PackSpotParams(const XMFLOAT3& vLightDir, float fCosineOfConeAngle, float fFalloffRadius)
 {
@@ -188,54 +176,6 @@ static LightUtilSpotParams PackSpotParams(const XMFLOAT3& vLightDir, float fCosi
     return PackedParams;
 }
 
-static void CalcPointLightView( const XMFLOAT4& PositionAndRadius, int nFace, XMMATRIX& View )
-{
-    const XMVECTOR dir[ 6 ] = 
-    {
-        XMVectorSet(  1.0f,  0.0f,  0.0f, 0.0f ),
-        XMVectorSet( -1.0f,  0.0f,  0.0f, 0.0f ),
-        XMVectorSet(  0.0f,  1.0f,  0.0f, 0.0f ),
-        XMVectorSet(  0.0f, -1.0f,  0.0f, 0.0f ),
-        XMVectorSet(  0.0f,  0.0f, -1.0f, 0.0f ),
-        XMVectorSet(  0.0f,  0.0f,  1.0f, 0.0f ),
-    };
-
-    const XMVECTOR up[ 6 ] = 
-    {
-        XMVectorSet( 0.0f, 1.0f,  0.0f, 0.0f ),
-        XMVectorSet( 0.0f, 1.0f,  0.0f, 0.0f ),
-        XMVectorSet( 0.0f, 0.0f,  1.0f, 0.0f ),
-        XMVectorSet( 0.0f, 0.0f, -1.0f, 0.0f ),
-        XMVectorSet( 0.0f, 1.0f,  0.0f, 0.0f ),
-        XMVectorSet( 0.0f, 1.0f,  0.0f, 0.0f ),
-    };
-
-    XMVECTOR eye = XMVectorSet( PositionAndRadius.x, PositionAndRadius.y, PositionAndRadius.z, 0.0f );
-
-    XMVECTOR at = eye + dir[ nFace ];
-    View = XMMatrixLookAtLH( eye, at, up[ nFace ] );
-}
-
-static void CalcPointLightProj( const XMFLOAT4& PositionAndRadius, XMMATRIX& Proj )
-{
-    Proj = XMMatrixPerspectiveFovLH( XMConvertToRadians( 90.0f ), 1.0f, 2.0f, PositionAndRadius.w );
-}
-
-static void CalcPointLightViewProj( const XMFLOAT4& positionAndRadius, XMMATRIX* viewProjTransposed, XMMATRIX* viewProjInvTransposed )
-{
-    XMMATRIX proj;
-    XMMATRIX view;
-    CalcPointLightProj( positionAndRadius, proj );
-    for ( int i = 0; i < 6; i++ )
-    {
-        CalcPointLightView( positionAndRadius, i, view );
-        XMMATRIX viewProj = view * proj;
-        viewProjTransposed[i] = XMMatrixTranspose( viewProj );
-        XMMATRIX viewProjInv = XMMatrixInverse( NULL, viewProj );
-        viewProjInvTransposed[i] = XMMatrixTranspose( viewProjInv );
-    }
-}
-
 static void AddShadowCastingPointLight( const XMFLOAT4& positionAndRadius, DWORD color )
 {
     static unsigned uShadowCastingPointLightCounter = 0;
@@ -245,40 +185,100 @@ static void AddShadowCastingPointLight( const XMFLOAT4& positionAndRadius, DWORD
     g_ShadowCastingPointLightDataArrayCenterAndRadius[ uShadowCastingPointLightCounter ] = positionAndRadius;
     g_ShadowCastingPointLightDataArrayColor[ uShadowCastingPointLightCounter ] = color;
 
-    CalcPointLightViewProj( positionAndRadius, g_ShadowCastingPointLightViewProjTransposed[uShadowCastingPointLightCounter], g_ShadowCastingPointLightViewProjInvTransposed[uShadowCastingPointLightCounter] );
-
     uShadowCastingPointLightCounter++;
 }
 
-static void CalcSpotLightView( const XMFLOAT3& Eye, const XMFLOAT3& LookAt, XMMATRIX& View )
+// build a "rotate from one vector to another" matrix, to point the spot light 
+// cone along its light direction (transposed, for the debug drawing shader)
+static XMMATRIX CalcSpotLightRotation( FXMVECTOR LightDir )
 {
-    XMFLOAT3 Up( 0.0f, 1.0f, 0.0f );
-    View = XMMatrixLookAtLH( XMLoadFloat3(&Eye), XMLoadFloat3(&LookAt), XMLoadFloat3(&Up) );
+    XMVECTOR s = XMVectorSet(0.0f,-1.0f,0.0f,0.0f);
+    XMVECTOR t = LightDir;
+    XMFLOAT3 v;
+    XMStoreFloat3( &v, XMVector3Cross(s,t) );
+    float e = XMVectorGetX(XMVector3Dot(s,t));
+    float h = 1.0f / (1.0f + e);
+
+    XMFLOAT4X4 f4x4Rotation;
+    XMStoreFloat4x4( &f4x4Rotation, XMMatrixIdentity() );
+    f4x4Rotation._11 = e + h*v.x*v.x;
+    f4x4Rotation._12 = h*v.x*v.y - v.z;
+    f4x4Rotation._13 = h*v.x*v.z + v.y;
+    f4x4Rotation._21 = h*v.x*v.y + v.z;
+    f4x4Rotation._22 = e + h*v.y*v.y;
+    f4x4Rotation._23 = h*v.y*v.z - v.x;
+    f4x4Rotation._31 = h*v.x*v.z - v.y;
+    f4x4Rotation._32 = h*v.y*v.z + v.x;
+    f4x4Rotation._33 = e + h*v.z*v.z;
+    XMMATRIX mRotation = XMLoadFloat4x4( &f4x4Rotation );
+
+    return XMMatrixTranspose(mRotation);
 }
 
-static void CalcSpotLightProj( float radius, XMMATRIX& Proj )
+// orbit around the light's position, cycling between its color and a dimmer one
+static void InitLightAnimationDesc( const TiledLighting11::CPUFloat4& CenterAndRadius, unsigned dwColor, TiledLighting11::CPULightAnimationDesc& Desc )
 {
-    Proj = XMMatrixPerspectiveFovLH( XMConvertToRadians( 70.52877936f ), 1.0f, 2.0f, radius );
+    Desc.Pivot[0] = CenterAndRadius.x;
+    Desc.Pivot[1] = CenterAndRadius.y;
+    Desc.Pivot[2] = CenterAndRadius.z;
+    Desc.fRadius = CenterAndRadius.w;
+
+    for( int i = 0; i < 3; i++ )
+    {
+        Desc.ColorA[i] = ( ( dwColor >> ( 8*i ) ) & 0xFF ) / 255.0f;
+        Desc.ColorB[i] = 0.5f*Desc.ColorA[i];
+    }
 }
 
-static void CalcSpotLightViewProj( const XMFLOAT4& positionAndRadius, const XMFLOAT3& lookAt, XMMATRIX* viewProjTransposed, XMMATRIX* viewProjInvTransposed )
+// random motion around the random lights, starting from their colors and spot light directions
+static void InitLightAnimation()
 {
-    XMMATRIX proj;
-    XMMATRIX view;
-    CalcSpotLightProj( positionAndRadius.w, proj );
-    CalcSpotLightView( *(const XMFLOAT3 *)(&positionAndRadius), lookAt, view );
-    XMMATRIX viewProj = view * proj;
-    *viewProjTransposed = XMMatrixTranspose( viewProj );
-    XMMATRIX viewProjInv = XMMatrixInverse( NULL, viewProj );
-    *viewProjInvTransposed = XMMatrixTranspose( viewProjInv );
+    using namespace TiledLighting11;
+
+    // the pivots are the lights' positions
+    const float BBox[3] = { 0.0f, 0.0f, 0.0f };
+    std::vector<CPULightAnimationDesc> PointLightDescs, SpotLightDescs;
+    CPULightAnimator::CreateRandomLights( 1, BBox, BBox, g_fLightAnimationRadius, g_RandomLights.uNumPointLights, PointLightDescs );
+    CPULightAnimator::CreateRandomLights( 2, BBox, BBox, g_fLightAnimationRadius, g_RandomLights.uNumSpotLights, SpotLightDescs );
+
+    for( unsigned i = 0; i < g_RandomLights.uNumPointLights; i++ )
+    {
+        InitLightAnimationDesc( g_RandomLights.pPointLightCenterAndRadius[i], g_RandomLights.pPointLightColor[i], PointLightDescs[i] );
+    }
+
+    for( unsigned i = 0; i < g_RandomLights.uNumSpotLights; i++ )
+    {
+        InitLightAnimationDesc( g_RandomLights.pSpotLightCenterAndRadius[i], g_RandomLights.pSpotLightColor[i], SpotLightDescs[i] );
+        SpotLightDescs[i].fDirY = CPUConvertF16ToF32( g_RandomLights.pSpotParams[i].fLightDirY );
+    }
+
+    g_PointLightAnimator.SetLights( PointLightDescs.empty() ? NULL : &PointLightDescs[0], g_RandomLights.uNumPointLights );
+    g_SpotLightAnimator.SetLights( SpotLightDescs.empty() ? NULL : &SpotLightDescs[0], g_RandomLights.uNumSpotLights );
 }
 
-static void AddShadowCastingSpotLight( const XMFLOAT4& positionAndRadius, const XMFLOAT3& lookAt, DWORD color )
+// upload the dirty ranges of one light pool attribute into its buffer
+static void UpdateLightBuffer( ID3D11DeviceContext* pd3dImmediateContext, const TiledLighting11::CPULightPool& Pool, unsigned uAttribute, ID3D11Buffer* pBuffer )
 {
-    static unsigned uShadowCastingSpotLightCounter = 0;
+    Pool.GetDirtyRanges( uAttribute, LIGHT_POOL_MAX_UPLOAD_GAP, g_LightPoolRanges );
 
-    assert( uShadowCastingSpotLightCounter < TiledLighting11::MAX_NUM_SHADOWCASTING_SPOTS );
+    const unsigned uSize = Pool.GetAttributeSize( uAttribute );
+    const unsigned char* pData = (const unsigned char*)Pool.GetData( uAttribute );
+    for( size_t i = 0; i < g_LightPoolRanges.size(); i++ )
+    {
+        D3D11_BOX Box;
+        Box.left = g_LightPoolRanges[i].uFirst * uSize;
+        Box.right = ( g_LightPoolRanges[i].uFirst + g_LightPoolRanges[i].uCount ) * uSize;
+        Box.top = 0;
+        Box.bottom = 1;
+        Box.front = 0;
+        Box.back = 1;
+        pd3dImmediateContext->UpdateSubresource( pBuffer, 0, &Box, pData + Box.left, 0, 0 );
+    }
+}
 
+// the bounding sphere, spot parameters, debug drawing matrix and shadow camera of a shadow-casting spot light
+static void SetShadowCastingSpotLightData( unsigned uIndex, const XMFLOAT4& positionAndRadius, const XMFLOAT3& lookAt )
+{
     XMVECTOR eye = XMLoadFloat3( (XMFLOAT3*)(&positionAndRadius) );
     XMVECTOR dir = XMLoadFloat3(&lookAt) - eye;
     dir = XMVector3Normalize( dir );
@@ -287,41 +287,43 @@ static void AddShadowCastingSpotLight( const XMFLOAT4& positionAndRadius, const
 
     XMVECTOR boundingSpherePos = eye + (dir * positionAndRadius.w);
 
-    g_ShadowCastingSpotLightDataArrayCenterAndRadius[ uShadowCastingSpotLightCounter ] = XMFLOAT4( XMVectorGetX(boundingSpherePos), XMVectorGetY(boundingSpherePos), XMVectorGetZ(boundingSpherePos), positionAndRadius.w );
-    g_ShadowCastingSpotLightDataArrayColor[ uShadowCastingSpotLightCounter ] = color;
+    g_ShadowCastingSpotLightDataArrayCenterAndRadius[ uIndex ] = XMFLOAT4( XMVectorGetX(boundingSpherePos), XMVectorGetY(boundingSpherePos), XMVectorGetZ(boundingSpherePos), positionAndRadius.w );
 
     // cosine of cone angle is cosine(35.26438968 degrees) = 0.816496580927726
-    g_ShadowCastingSpotLightDataArraySpotParams[ uShadowCastingSpotLightCounter ] = PackSpotParams( f3Dir, 0.816496580927726f, positionAndRadius.w * 1.33333333f );
+    g_ShadowCastingSpotLightDataArraySpotParams[ uIndex ] = PackSpotParams( f3Dir, 0.816496580927726f, positionAndRadius.w * 1.33333333f );
 
-    CalcSpotLightViewProj( positionAndRadius, lookAt, &g_ShadowCastingSpotLightViewProjTransposed[uShadowCastingSpotLightCounter], &g_ShadowCastingSpotLightViewProjInvTransposed[uShadowCastingSpotLightCounter] );
+    g_ShadowCastingSpotLightDataArraySpotMatrices[ uIndex ] = CalcSpotLightRotation( dir );
 
-    // build a "rotate from one vector to another" matrix, to point the spot light 
-    // cone along its light direction
-    XMVECTOR s = XMVectorSet(0.0f,-1.0f,0.0f,0.0f);
-    XMVECTOR t = dir;
-    XMFLOAT3 v;
-    XMStoreFloat3( &v, XMVector3Cross(s,t) );
-    float e = XMVectorGetX(XMVector3Dot(s,t));
-    float h = 1.0f / (1.0f + e);
+    g_ShadowCastingSpotLightDataArrayPositionAndRadius[ uIndex ] = positionAndRadius;
+    g_ShadowCastingSpotLightDataArrayLookAt[ uIndex ] = XMFLOAT4( lookAt.x, lookAt.y, lookAt.z, 1.0f );
+}
 
-    XMFLOAT4X4 f4x4Rotation;
-    XMStoreFloat4x4( &f4x4Rotation, XMMatrixIdentity() );
-    f4x4Rotation._11 = e + h*v.x*v.x;
-    f4x4Rotation._12 = h*v.x*v.y - v.z;
-    f4x4Rotation._13 = h*v.x*v.z + v.y;
-    f4x4Rotation._21 = h*v.x*v.y + v.z;
-    f4x4Rotation._22 = e + h*v.y*v.y;
-    f4x4Rotation._23 = h*v.y*v.z - v.x;
-    f4x4Rotation._31 = h*v.x*v.z - v.y;
-    f4x4Rotation._32 = h*v.y*v.z + v.x;
-    f4x4Rotation._33 = e + h*v.z*v.z;
-    XMMATRIX mRotation = XMLoadFloat4x4( &f4x4Rotation );
+static void AddShadowCastingSpotLight( const XMFLOAT4& positionAndRadius, const XMFLOAT3& lookAt, DWORD color )
+{
+    static unsigned uShadowCastingSpotLightCounter = 0;
 
-    g_ShadowCastingSpotLightDataArraySpotMatrices[ uShadowCastingSpotLightCounter ] = XMMatrixTranspose(mRotation);
+    assert( uShadowCastingSpotLightCounter < TiledLighting11::MAX_NUM_SHADOWCASTING_SPOTS );
+
+    g_ShadowCastingSpotLightDataArrayColor[ uShadowCastingSpotLightCounter ] = color;
+    SetShadowCastingSpotLightData( uShadowCastingSpotLightCounter, positionAndRadius, lookAt );
 
     uShadowCastingSpotLightCounter++;
 }
 
+// the shadow map view-projection matrices and their inverses, for every shadow-casting light in one batch
+static void CalcShadowCastingLightMatrices()
+{
+    using namespace TiledLighting11;
+
+    static_assert( sizeof(CPUFloat4) == sizeof(XMFLOAT4), "light position layout" );
+    static_assert( sizeof(CPUMatrix) == sizeof(XMMATRIX), "shadow matrix layout" );
+
+    CalcCPUPointLightShadowMatrices( (const CPUFloat4*)g_ShadowCastingPointLightDataArrayCenterAndRadius, MAX_NUM_SHADOWCASTING_POINTS,
+        (CPUMatrix*)g_ShadowCastingPointLightViewProjTransposed, (CPUMatrix*)g_ShadowCastingPointLightViewProjInvTransposed, CPU_SIMD_AUTO, NULL );
+    CalcCPUSpotLightShadowMatrices( (const CPUFloat4*)g_ShadowCastingSpotLightDataArrayPositionAndRadius, (const CPUFloat4*)g_ShadowCastingSpotLightDataArrayLookAt, MAX_NUM_SHADOWCASTING_SPOTS,
+        (CPUMatrix*)g_ShadowCastingSpotLightViewProjTransposed, (CPUMatrix*)g_ShadowCastingSpotLightViewProjInvTransposed, CPU_SIMD_AUTO, NULL );
+}
+
 namespace TiledLighting11
 {
 
@@ -363,6 +365,7 @@ namespace TiledLighting11
         ,m_pDebugDrawSpotLightsPS(NULL)
         ,m_pDebugDrawSpotLightsLayout11(NULL)
         ,m_pBlendStateAdditive(NULL)
+        ,m_bShadowCastingLightsChanged(false)
     {
         assert( LightUtilObjectCounter == 0 );
         LightUtilObjectCounter++;
@@ -422,13 +425,40 @@ namespace TiledLighting11
 
         D3D11_SUBRESOURCE_DATA InitData;
 
-        // Create the point light buffer (center and radius)
+        // Fill the light pools with the random lights (from InitLights or LoadLightSet) the first time through. They
+        // outlive the device, so handles stay valid when the device is recreated.
+        if( m_PointLightPool.GetCapacity() == 0 )
+        {
+            const unsigned uPointLightAttributeSizes[NUM_POINT_LIGHT_ATTRIBUTES] = { sizeof(XMFLOAT4), sizeof(DWORD) };
+            m_PointLightPool.Reset( MAX_NUM_LIGHTS, uPointLightAttributeSizes, NUM_POINT_LIGHT_ATTRIBUTES );
+
+            const unsigned uSpotLightAttributeSizes[NUM_SPOT_LIGHT_ATTRIBUTES] = { sizeof(XMFLOAT4), sizeof(DWORD), sizeof(LightUtilSpotParams), sizeof(XMMATRIX) };
+            m_SpotLightPool.Reset( MAX_NUM_LIGHTS, uSpotLightAttributeSizes, NUM_SPOT_LIGHT_ATTRIBUTES );
+
+            for( unsigned i = 0; i < g_RandomLights.uNumPointLights; i++ )
+            {
+                CPULightHandle Handle = m_PointLightPool.Add();
+                m_PointLightPool.Set( Handle, POINT_LIGHT_CENTER_AND_RADIUS, &g_RandomLights.pPointLightCenterAndRadius[i] );
+                m_PointLightPool.Set( Handle, POINT_LIGHT_COLOR, &g_RandomLights.pPointLightColor[i] );
+            }
+
+            for( unsigned i = 0; i < g_RandomLights.uNumSpotLights; i++ )
+            {
+                CPULightHandle Handle = m_SpotLightPool.Add();
+                m_SpotLightPool.Set( Handle, SPOT_LIGHT_CENTER_AND_RADIUS, &g_RandomLights.pSpotLightCenterAndRadius[i] );
+                m_SpotLightPool.Set( Handle, SPOT_LIGHT_COLOR, &g_RandomLights.pSpotLightColor[i] );
+                m_SpotLightPool.Set( Handle, SPOT_LIGHT_SPOT_PARAMS, &g_RandomLights.pSpotParams[i] );
+                m_SpotLightPool.Set( Handle, SPOT_LIGHT_SPOT_MATRIX, &g_RandomLights.pSpotMatrices[i] );
+            }
+        }
+
+        // Create the point light buffer (center and radius), updated from the pool with UpdateSubresource
         D3D11_BUFFER_DESC LightBufferDesc;
         ZeroMemory( &LightBufferDesc, sizeof(LightBufferDesc) );
-        LightBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        LightBufferDesc.Usage = D3D11_USAGE_DEFAULT;
         LightBufferDesc.ByteWidth = sizeof( g_PointLightDataArrayCenterAndRadius );
         LightBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        InitData.pSysMem = g_PointLightDataArrayCenterAndRadius;
+        InitData.pSysMem = m_PointLightPool.GetData( POINT_LIGHT_CENTER_AND_RADIUS );
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pPointLightBufferCenterAndRadius ) );
         DXUT_SetDebugName( m_pPointLightBufferCenterAndRadius, "PointLightBufferCenterAndRadius" );
 
@@ -442,14 +472,14 @@ namespace TiledLighting11
 
         // Create the point light buffer (color)
         LightBufferDesc.ByteWidth = sizeof( g_PointLightDataArrayColor );
-        InitData.pSysMem = g_PointLightDataArrayColor;
+        InitData.pSysMem = m_PointLightPool.GetData( POINT_LIGHT_COLOR );
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pPointLightBufferColor ) );
         DXUT_SetDebugName( m_pPointLightBufferColor, "PointLightBufferColor" );
 
         SRVDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
         V_RETURN( pd3dDevice->CreateShaderResourceView( m_pPointLightBufferColor, &SRVDesc, &m_pPointLightBufferColorSRV ) );
 
-        // Create the shadow-casting point light buffer (center and radius)
+        // Create the shadow-casting point light buffer (center and radius), updated in UpdateShadowCastingLights
         LightBufferDesc.ByteWidth = sizeof( g_ShadowCastingPointLightDataArrayCenterAndRadius );
         InitData.pSysMem = g_ShadowCastingPointLightDataArrayCenterAndRadius;
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pShadowCastingPointLightBufferCenterAndRadius ) );
@@ -468,12 +498,12 @@ namespace TiledLighting11
         SRVDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
         V_RETURN( pd3dDevice->CreateShaderResourceView( m_pShadowCastingPointLightBufferColor, &SRVDesc, &m_pShadowCastingPointLightBufferColorSRV ) );
 
-        // Create the spot light buffer (center and radius)
+        // Create the spot light buffer (center and radius), updated from the pool with UpdateSubresource
         ZeroMemory( &LightBufferDesc, sizeof(LightBufferDesc) );
-        LightBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        LightBufferDesc.Usage = D3D11_USAGE_DEFAULT;
         LightBufferDesc.ByteWidth = sizeof( g_SpotLightDataArrayCenterAndRadius );
         LightBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        InitData.pSysMem = g_SpotLightDataArrayCenterAndRadius;
+        InitData.pSysMem = m_SpotLightPool.GetData( SPOT_LIGHT_CENTER_AND_RADIUS );
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pSpotLightBufferCenterAndRadius ) );
         DXUT_SetDebugName( m_pSpotLightBufferCenterAndRadius, "SpotLightBufferCenterAndRadius" );
 
@@ -486,7 +516,7 @@ namespace TiledLighting11
 
         // Create the spot light buffer (color)
         LightBufferDesc.ByteWidth = sizeof( g_SpotLightDataArrayColor );
-        InitData.pSysMem = g_SpotLightDataArrayColor;
+        InitData.pSysMem = m_SpotLightPool.GetData( SPOT_LIGHT_COLOR );
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pSpotLightBufferColor ) );
         DXUT_SetDebugName( m_pSpotLightBufferColor, "SpotLightBufferColor" );
 
@@ -495,7 +525,7 @@ namespace TiledLighting11
 
         // Create the spot light buffer (spot light parameters)
         LightBufferDesc.ByteWidth = sizeof( g_SpotLightDataArraySpotParams );
-        InitData.pSysMem = g_SpotLightDataArraySpotParams;
+        InitData.pSysMem = m_SpotLightPool.GetData( SPOT_LIGHT_SPOT_PARAMS );
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pSpotLightBufferSpotParams ) );
         DXUT_SetDebugName( m_pSpotLightBufferSpotParams, "SpotLightBufferSpotParams" );
 
@@ -504,7 +534,7 @@ namespace TiledLighting11
 
         // Create the light buffer (spot light matrices, only used for debug drawing the spot lights)
         LightBufferDesc.ByteWidth = sizeof( g_SpotLightDataArraySpotMatrices );
-        InitData.pSysMem = g_SpotLightDataArraySpotMatrices;
+        InitData.pSysMem = m_SpotLightPool.GetData( SPOT_LIGHT_SPOT_MATRIX );
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pSpotLightBufferSpotMatrices ) );
         DXUT_SetDebugName( m_pSpotLightBufferSpotMatrices, "SpotLightBufferSpotMatrices" );
 
@@ -512,7 +542,7 @@ namespace TiledLighting11
         SRVDesc.Buffer.ElementWidth = 4*MAX_NUM_LIGHTS;
         V_RETURN( pd3dDevice->CreateShaderResourceView( m_pSpotLightBufferSpotMatrices, &SRVDesc, &m_pSpotLightBufferSpotMatricesSRV ) );
 
-        // Create the shadow-casting spot light buffer (center and radius)
+        // Create the shadow-casting spot light buffer (center and radius), updated in UpdateShadowCastingLights
         LightBufferDesc.ByteWidth = sizeof( g_ShadowCastingSpotLightDataArrayCenterAndRadius );
         InitData.pSysMem = g_ShadowCastingSpotLightDataArrayCenterAndRadius;
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pShadowCastingSpotLightBufferCenterAndRadius ) );
@@ -550,6 +580,11 @@ namespace TiledLighting11
         SRVDesc.Buffer.ElementWidth = 4*MAX_NUM_SHADOWCASTING_SPOTS;
         V_RETURN( pd3dDevice->CreateShaderResourceView( m_pShadowCastingSpotLightBufferSpotMatrices, &SRVDesc, &m_pShadowCastingSpotLightBufferSpotMatricesSRV ) );
 
+        // the new buffers hold everything in the pools, and the shadow-casting lights as they are now
+        m_PointLightPool.ClearDirtyRanges();
+        m_SpotLightPool.ClearDirtyRanges();
+        m_bShadowCastingLightsChanged = false;
+
         // Create the vertex buffer for the sprites (a single quad)
         D3D11_BUFFER_DESC VBDesc;
         ZeroMemory( &VBDesc, sizeof(VBDesc) );
@@ -769,132 +804,320 @@ namespace TiledLighting11
     }
 
     //--------------------------------------------------------------------------------------
-    // Fill in the data for the lights (center, radius, and color).
-    // Also fill in the vertex data for the sprite quad.
+    // Add a point light to the pool
     //--------------------------------------------------------------------------------------
-    void LightUtil::InitLights( const XMVECTOR &BBoxMin, const XMVECTOR &BBoxMax )
+    CPULightHandle LightUtil::AddPointLight( const XMFLOAT4& CenterAndRadius, DWORD dwColor )
     {
-        // init the random seed to 1, so that results are deterministic 
-        // across different runs of the sample
-        srand(1);
-
-        // scale the size of the lights based on the size of the scene
-        XMVECTOR BBoxExtents = 0.5f * (BBoxMax - BBoxMin);
-        float fRadius = 0.075f * XMVectorGetX(XMVector3Length(BBoxExtents));
-
-        // For point lights, the radius of the bounding sphere for the light (used for culling) 
-        // and the falloff distance of the light (used for lighting) are the same. Not so for 
-        // spot lights. A spot light is a right circular cone. The height of the cone is the 
-        // falloff distance. We want to fit the cone of the spot light inside the bounding sphere. 
-        // From calculus, we know the cone with maximum volume that can fit inside a sphere has height:
-        // h_cone = (4/3)*r_sphere
-        float fSpotLightFalloffRadius = 1.333333333333f * fRadius;
+        CPULightHandle Handle = m_PointLightPool.Add();
+        if( Handle != CPU_INVALID_LIGHT_HANDLE )
+        {
+            m_PointLightPool.Set( Handle, POINT_LIGHT_CENTER_AND_RADIUS, &CenterAndRadius );
+            m_PointLightPool.Set( Handle, POINT_LIGHT_COLOR, &dwColor );
+        }
+        return Handle;
+    }
 
-        XMFLOAT3 vBBoxMin, vBBoxMax;
-        XMStoreFloat3( &vBBoxMin, BBoxMin );
-        XMStoreFloat3( &vBBoxMax, BBoxMax );
+    //--------------------------------------------------------------------------------------
+    // Move or resize a point light
+    //--------------------------------------------------------------------------------------
+    void LightUtil::SetPointLight( CPULightHandle Handle, const XMFLOAT4& CenterAndRadius )
+    {
+        m_PointLightPool.Set( Handle, POINT_LIGHT_CENTER_AND_RADIUS, &CenterAndRadius );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Remove a point light from the pool
+    //--------------------------------------------------------------------------------------
+    bool LightUtil::RemovePointLight( CPULightHandle Handle )
+    {
+        return m_PointLightPool.Remove( Handle );
+    }
 
-        // initialize the point light data
-        for (int i = 0; i < MAX_NUM_LIGHTS; i++)
+    //--------------------------------------------------------------------------------------
+    // Add a spot light to the pool, with the cone and falloff of the lights from InitLights
+    //--------------------------------------------------------------------------------------
+    CPULightHandle LightUtil::AddSpotLight( const XMFLOAT4& CenterAndRadius, DWORD dwColor, const XMFLOAT3& vLightDir )
+    {
+        CPULightHandle Handle = m_SpotLightPool.Add();
+        if( Handle != CPU_INVALID_LIGHT_HANDLE )
         {
-            g_PointLightDataArrayCenterAndRadius[i] = XMFLOAT4(GetRandFloat(vBBoxMin.x,vBBoxMax.x), GetRandFloat(vBBoxMin.y,vBBoxMax.y), GetRandFloat(vBBoxMin.z,vBBoxMax.z), fRadius);
-            g_PointLightDataArrayColor[i] = GetRandColor();
+            m_SpotLightPool.Set( Handle, SPOT_LIGHT_COLOR, &dwColor );
+            SetSpotLight( Handle, CenterAndRadius, vLightDir );
         }
+        return Handle;
+    }
 
-        // initialize the spot light data
-        for (int i = 0; i < MAX_NUM_LIGHTS; i++)
+    //--------------------------------------------------------------------------------------
+    // Move, resize or turn a spot light
+    //--------------------------------------------------------------------------------------
+    void LightUtil::SetSpotLight( CPULightHandle Handle, const XMFLOAT4& CenterAndRadius, const XMFLOAT3& vLightDir )
+    {
+        // see InitLights for the cone angle and the falloff radius
+        LightUtilSpotParams SpotParams = PackSpotParams( vLightDir, 0.816496580927726f, 1.333333333333f * CenterAndRadius.w );
+        XMMATRIX mRotation = CalcSpotLightRotation( XMLoadFloat3( &vLightDir ) );
+
+        m_SpotLightPool.Set( Handle, SPOT_LIGHT_CENTER_AND_RADIUS, &CenterAndRadius );
+        m_SpotLightPool.Set( Handle, SPOT_LIGHT_SPOT_PARAMS, &SpotParams );
+        m_SpotLightPool.Set( Handle, SPOT_LIGHT_SPOT_MATRIX, &mRotation );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Remove a spot light from the pool
+    //--------------------------------------------------------------------------------------
+    bool LightUtil::RemoveSpotLight( CPULightHandle Handle )
+    {
+        return m_SpotLightPool.Remove( Handle );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Move or resize a shadow-casting point light
+    //--------------------------------------------------------------------------------------
+    void LightUtil::SetShadowCastingPointLight( unsigned uIndex, const XMFLOAT4& PositionAndRadius )
+    {
+        assert( uIndex < MAX_NUM_SHADOWCASTING_POINTS );
+
+        g_ShadowCastingPointLightDataArrayCenterAndRadius[uIndex] = PositionAndRadius;
+        m_bShadowCastingLightsChanged = true;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Move, resize or turn a shadow-casting spot light
+    //--------------------------------------------------------------------------------------
+    void LightUtil::SetShadowCastingSpotLight( unsigned uIndex, const XMFLOAT4& PositionAndRadius, const XMFLOAT3& LookAt )
+    {
+        assert( uIndex < MAX_NUM_SHADOWCASTING_SPOTS );
+
+        SetShadowCastingSpotLightData( uIndex, PositionAndRadius, LookAt );
+        m_bShadowCastingLightsChanged = true;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Recompute the shadow matrices of every shadow-casting light if any of them changed,
+    // and upload the shadow-casting light buffers (a few hundred bytes each)
+    //--------------------------------------------------------------------------------------
+    bool LightUtil::UpdateShadowCastingLights( ID3D11DeviceContext* pd3dImmediateContext )
+    {
+        if( !m_bShadowCastingLightsChanged || m_pShadowCastingPointLightBufferCenterAndRadius == NULL )
         {
-            g_SpotLightDataArrayCenterAndRadius[i] = XMFLOAT4(GetRandFloat(vBBoxMin.x,vBBoxMax.x), GetRandFloat(vBBoxMin.y,vBBoxMax.y), GetRandFloat(vBBoxMin.z,vBBoxMax.z), fRadius);
-            g_SpotLightDataArrayColor[i] = GetRandColor();
+            return false;
+        }
 
-            XMFLOAT3 vLightDir = GetRandLightDirection();
+        CalcShadowCastingLightMatrices();
 
-            // Okay, so we fit a max-volume cone inside our bounding sphere for the spot light. We need to find 
-            // the cone angle for that cone. Google on "cone inside sphere" (without the quotes) to find info 
-            // on how to derive these formulas for the height and radius of the max-volume cone inside a sphere.
-            // h_cone = (4/3)*r_sphere
-            // r_cone = sqrt(8/9)*r_sphere
-            // tan(theta) = r_cone/h_cone = sqrt(2)/2 = 0.7071067811865475244
-            // theta = 35.26438968 degrees
-            // store the cosine of this angle: cosine(35.26438968 degrees) = 0.816496580927726
-
-            // random direction, cosine of cone angle, falloff radius calcuated above
-            g_SpotLightDataArraySpotParams[i] = PackSpotParams(vLightDir, 0.816496580927726f, fSpotLightFalloffRadius);
-
-            // build a "rotate from one vector to another" matrix, to point the spot light 
-            // cone along its light direction
-            XMVECTOR s = XMVectorSet(0.0f,-1.0f,0.0f,0.0f);
-            XMVECTOR t = XMLoadFloat3( &vLightDir );
-            XMFLOAT3 v;
-            XMStoreFloat3( &v, XMVector3Cross(s,t) );
-            float e = XMVectorGetX(XMVector3Dot(s,t));
-            float h = 1.0f / (1.0f + e);
-
-            XMFLOAT4X4 f4x4Rotation;
-            XMStoreFloat4x4( &f4x4Rotation, XMMatrixIdentity() );
-            f4x4Rotation._11 = e + h*v.x*v.x;
-            f4x4Rotation._12 = h*v.x*v.y - v.z;
-            f4x4Rotation._13 = h*v.x*v.z + v.y;
-            f4x4Rotation._21 = h*v.x*v.y + v.z;
-            f4x4Rotation._22 = e + h*v.y*v.y;
-            f4x4Rotation._23 = h*v.y*v.z - v.x;
-            f4x4Rotation._31 = h*v.x*v.z - v.y;
-            f4x4Rotation._32 = h*v.y*v.z + v.x;
-            f4x4Rotation._33 = e + h*v.z*v.z;
-            XMMATRIX mRotation = XMLoadFloat4x4( &f4x4Rotation );
-
-            g_SpotLightDataArraySpotMatrices[i] = XMMatrixTranspose(mRotation);
+        pd3dImmediateContext->UpdateSubresource( m_pShadowCastingPointLightBufferCenterAndRadius, 0, NULL, g_ShadowCastingPointLightDataArrayCenterAndRadius, 0, 0 );
+        pd3dImmediateContext->UpdateSubresource( m_pShadowCastingSpotLightBufferCenterAndRadius, 0, NULL, g_ShadowCastingSpotLightDataArrayCenterAndRadius, 0, 0 );
+        pd3dImmediateContext->UpdateSubresource( m_pShadowCastingSpotLightBufferSpotParams, 0, NULL, g_ShadowCastingSpotLightDataArraySpotParams, 0, 0 );
+        pd3dImmediateContext->UpdateSubresource( m_pShadowCastingSpotLightBufferSpotMatrices, 0, NULL, g_ShadowCastingSpotLightDataArraySpotMatrices, 0, 0 );
+
+        m_bShadowCastingLightsChanged = false;
+        return true;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Upload the dirty ranges of every light pool attribute
+    //--------------------------------------------------------------------------------------
+    void LightUtil::UpdateLightBuffers( ID3D11DeviceContext* pd3dImmediateContext )
+    {
+        if( m_pPointLightBufferCenterAndRadius == NULL )
+        {
+            return;
+        }
+
+        UpdateLightBuffer( pd3dImmediateContext, m_PointLightPool, POINT_LIGHT_CENTER_AND_RADIUS, m_pPointLightBufferCenterAndRadius );
+        UpdateLightBuffer( pd3dImmediateContext, m_PointLightPool, POINT_LIGHT_COLOR, m_pPointLightBufferColor );
+        m_PointLightPool.ClearDirtyRanges();
+
+        UpdateLightBuffer( pd3dImmediateContext, m_SpotLightPool, SPOT_LIGHT_CENTER_AND_RADIUS, m_pSpotLightBufferCenterAndRadius );
+        UpdateLightBuffer( pd3dImmediateContext, m_SpotLightPool, SPOT_LIGHT_COLOR, m_pSpotLightBufferColor );
+        UpdateLightBuffer( pd3dImmediateContext, m_SpotLightPool, SPOT_LIGHT_SPOT_PARAMS, m_pSpotLightBufferSpotParams );
+        UpdateLightBuffer( pd3dImmediateContext, m_SpotLightPool, SPOT_LIGHT_SPOT_MATRIX, m_pSpotLightBufferSpotMatrices );
+        m_SpotLightPool.ClearDirtyRanges();
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Move the lights from InitLights that are still in the pools. Point and spot lights
+    // are evaluated in one SIMD pass each, straight into the layout of the light buffers.
+    //--------------------------------------------------------------------------------------
+    void LightUtil::AnimateLights( float fTime, CPUTaskScheduler* pScheduler )
+    {
+        static_assert( sizeof(CPUSpotParams) == sizeof(LightUtilSpotParams), "spot params layout" );
+        static_assert( sizeof(CPUMatrix) == sizeof(XMMATRIX), "spot matrix layout" );
+
+        g_PointLightAnimator.Animate( fTime, g_AnimatedLightDataArrayCenterAndRadius, (unsigned*)g_AnimatedLightDataArrayColor, NULL, NULL, pScheduler );
+
+        // their handles are 0 to MAX_NUM_LIGHTS-1, see OnCreateDevice
+        for( unsigned i = 0; i < g_PointLightAnimator.GetNumLights(); i++ )
+        {
+            if( m_PointLightPool.IsValid( i ) )
+            {
+                m_PointLightPool.Set( i, POINT_LIGHT_CENTER_AND_RADIUS, &g_AnimatedLightDataArrayCenterAndRadius[i] );
+                m_PointLightPool.Set( i, POINT_LIGHT_COLOR, &g_AnimatedLightDataArrayColor[i] );
+            }
         }
 
-        // initialize the shadow-casting point light data
+        g_SpotLightAnimator.Animate( fTime, g_AnimatedLightDataArrayCenterAndRadius, (unsigned*)g_AnimatedLightDataArrayColor,
+            g_AnimatedLightDataArraySpotParams, g_AnimatedLightDataArraySpotMatrices, pScheduler );
+
+        for( unsigned i = 0; i < g_SpotLightAnimator.GetNumLights(); i++ )
         {
-            // Hanging lamps
-            AddShadowCastingPointLight( XMFLOAT4( -620.0f, 136.0f, 218.0f, 450.0f ), COLOR( 200, 100, 0 ) );
-            AddShadowCastingPointLight( XMFLOAT4( -620.0f, 136.0f, -140.0f, 450.0f ), COLOR( 200, 100, 0 ) );
-            AddShadowCastingPointLight( XMFLOAT4(  490.0f, 136.0f, 218.0f, 450.0f ), COLOR( 200, 100, 0 ) );
-            AddShadowCastingPointLight( XMFLOAT4(  490.0f, 136.0f, -140.0f, 450.0f ), COLOR( 200, 100, 0 ) );
-
-            // Corner lights
-            AddShadowCastingPointLight( XMFLOAT4( -1280.0f, 120.0f, -300.0f, 500.0f ), COLOR( 120, 60, 60 ) );
-            AddShadowCastingPointLight( XMFLOAT4( -1280.0f, 200.0f,  430.0f, 600.0f ), COLOR( 50, 50, 128 ) );
-            AddShadowCastingPointLight( XMFLOAT4( 1030.0f, 200.0f, 545.0f, 500.0f ), COLOR( 255, 128, 0 ) );
-            AddShadowCastingPointLight( XMFLOAT4( 1180.0f, 220.0f, -390.0f, 500.0f ), COLOR( 100, 100, 255 ) );
-
-            // Midpoint lights
-            AddShadowCastingPointLight( XMFLOAT4( -65.0f, 100.0f, 220.0f, 500.0f ), COLOR( 200, 200, 200 ) );
-            AddShadowCastingPointLight( XMFLOAT4( -65.0f, 100.0f,-140.0f, 500.0f ), COLOR( 200, 200, 200 ) );
-
-            // High gallery lights
-            AddShadowCastingPointLight( XMFLOAT4( 600.0f, 660.0f, -30.0f, 800.0f ), COLOR( 100, 100, 100 ) );
-            AddShadowCastingPointLight( XMFLOAT4( -700.0f, 660.0f, 80.0f, 800.0f ), COLOR( 100, 100, 100 ) );
+            if( m_SpotLightPool.IsValid( i ) )
+            {
+                m_SpotLightPool.Set( i, SPOT_LIGHT_CENTER_AND_RADIUS, &g_AnimatedLightDataArrayCenterAndRadius[i] );
+                m_SpotLightPool.Set( i, SPOT_LIGHT_COLOR, &g_AnimatedLightDataArrayColor[i] );
+                m_SpotLightPool.Set( i, SPOT_LIGHT_SPOT_PARAMS, &g_AnimatedLightDataArraySpotParams[i] );
+                m_SpotLightPool.Set( i, SPOT_LIGHT_SPOT_MATRIX, &g_AnimatedLightDataArraySpotMatrices[i] );
+            }
         }
+    }
 
+    //--------------------------------------------------------------------------------------
+    // Write the random lights, and the shadow-casting lights with their shadow matrices
+    //--------------------------------------------------------------------------------------
+    CPULightSetResult LightUtil::ExportLightSets( const char* pRandomLightsPath, const char* pShadowCastingLightsPath )
+    {
+        CPULightSetResult Result = WriteCPULightSet( pRandomLightsPath, g_RandomLights );
+        if( Result != CPU_LIGHT_SET_OK )
         {
-            // Curtain spot
-            AddShadowCastingSpotLight( XMFLOAT4(  -772.0f, 254.0f, -503.0f, 800.0f ), XMFLOAT3( -814.0f, 180.0f, -250.0f ), COLOR( 255, 255, 255 ) );
+            return Result;
+        }
 
-            // Lion spots
-            AddShadowCastingSpotLight( XMFLOAT4(  1130.0f, 378.0f, 40.0f, 500.0f ), XMFLOAT3( 1150.0f, 290.0f, 40.0f ), COLOR( 200, 200, 100 ) );
-            AddShadowCastingSpotLight( XMFLOAT4( -1260.0f, 378.0f, 40.0f, 500.0f ), XMFLOAT3( -1280.0f, 290.0f, 40.0f ), COLOR( 200, 200, 100 ) );
+        CPULightSetDesc Desc;
+        ClearCPULightSetDesc( Desc );
+        Desc.uNumPointLights = MAX_NUM_SHADOWCASTING_POINTS;
+        Desc.pPointLightCenterAndRadius = (const CPUFloat4*)g_ShadowCastingPointLightDataArrayCenterAndRadius;
+        Desc.pPointLightColor = (const unsigned*)g_ShadowCastingPointLightDataArrayColor;
+        Desc.pPointLightShadowViewProj = (const CPUMatrix*)g_ShadowCastingPointLightViewProjTransposed;
+        Desc.pPointLightShadowViewProjInv = (const CPUMatrix*)g_ShadowCastingPointLightViewProjInvTransposed;
+        Desc.uNumSpotLights = MAX_NUM_SHADOWCASTING_SPOTS;
+        Desc.pSpotLightCenterAndRadius = (const CPUFloat4*)g_ShadowCastingSpotLightDataArrayCenterAndRadius;
+        Desc.pSpotLightColor = (const unsigned*)g_ShadowCastingSpotLightDataArrayColor;
+        Desc.pSpotParams = (const CPUSpotParams*)g_ShadowCastingSpotLightDataArraySpotParams;
+        Desc.pSpotMatrices = (const CPUMatrix*)g_ShadowCastingSpotLightDataArraySpotMatrices;
+        Desc.pSpotLightShadowViewProj = (const CPUMatrix*)g_ShadowCastingSpotLightViewProjTransposed;
+        Desc.pSpotLightShadowViewProjInv = (const CPUMatrix*)g_ShadowCastingSpotLightViewProjInvTransposed;
+        return WriteCPULightSet( pShadowCastingLightsPath, Desc );
+    }
 
-            // Gallery spots
-            AddShadowCastingSpotLight( XMFLOAT4( -115.0f, 660.0f, -100.0f, 800.0f ), XMFLOAT3( -115.0f, 630.0f, 0.0f ), COLOR( 200, 200, 200 ) );
-            AddShadowCastingSpotLight( XMFLOAT4( -115.0f, 660.0f,  100.0f, 800.0f ), XMFLOAT3( -115.0f, 630.0f, -100.0f ), COLOR( 200, 200, 200 ) );
+    //--------------------------------------------------------------------------------------
+    // Replace the random lights, or the shadow-casting lights, with those of a light set file.
+    // The random lights are read straight from the mapped file when the pools are filled;
+    // the few shadow-casting lights are copied into the arrays the renderers read.
+    //--------------------------------------------------------------------------------------
+    CPULightSetResult LightUtil::LoadLightSet( const char* pPath, bool bShadowCasting )
+    {
+        if( !bShadowCasting )
+        {
+            CPULightSetResult Result = g_RandomLightSetFile.Open( pPath, true );
+            if( Result != CPU_LIGHT_SET_OK )
+            {
+                return Result;
+            }
 
-            AddShadowCastingSpotLight( XMFLOAT4( -770.0f, 660.0f, -100.0f, 800.0f ), XMFLOAT3( -770.0f, 630.0f, 0.0f ), COLOR( 200, 200, 200 ) );
-            AddShadowCastingSpotLight( XMFLOAT4( -770.0f, 660.0f,  100.0f, 800.0f ), XMFLOAT3( -770.0f, 630.0f, -100.0f ), COLOR( 200, 200, 200 ) );
+            // the light buffers and the GUI are sized for MAX_NUM_LIGHTS
+            g_RandomLights = g_RandomLightSetFile.GetDesc();
+            g_RandomLights.uNumPointLights = std::min( g_RandomLights.uNumPointLights, (unsigned)MAX_NUM_LIGHTS );
+            g_RandomLights.uNumSpotLights = std::min( g_RandomLights.uNumSpotLights, (unsigned)MAX_NUM_LIGHTS );
+            InitLightAnimation();
+            return CPU_LIGHT_SET_OK;
+        }
 
-            AddShadowCastingSpotLight( XMFLOAT4( 500.0f, 660.0f, -100.0f, 800.0f ), XMFLOAT3( 500.0f, 630.0f, 0.0f ), COLOR( 200, 200, 200 ) );
-            AddShadowCastingSpotLight( XMFLOAT4( 500.0f, 660.0f,  100.0f, 800.0f ), XMFLOAT3( 500.0f, 630.0f, -100.0f ), COLOR( 200, 200, 200 ) );
+        // the shadow maps have a slot for every shadow-casting light, so the counts must match
+        CPULightSetFile File;
+        CPULightSetResult Result = File.Open( pPath, true );
+        if( Result != CPU_LIGHT_SET_OK )
+        {
+            return Result;
+        }
 
-            // Red corner spots
-            AddShadowCastingSpotLight( XMFLOAT4( -1240.0f, 90.0f, -70.0f, 700.0f ), XMFLOAT3( -1240.0f, 140.0f, -405.0f ), COLOR( 200, 0, 0 ) );
-            AddShadowCastingSpotLight( XMFLOAT4( -1000.0f, 90.0f, -260.0f, 700.0f ), XMFLOAT3( -1240.0f, 140.0f, -405.0f ), COLOR( 200, 0, 0 ) );
+        const CPULightSetDesc& Desc = File.GetDesc();
+        if( Desc.uNumPointLights != MAX_NUM_SHADOWCASTING_POINTS || Desc.uNumSpotLights != MAX_NUM_SHADOWCASTING_SPOTS || Desc.pPointLightShadowViewProj == NULL )
+        {
+            return CPU_LIGHT_SET_BAD_HEADER;
+        }
 
-            // Green corner spot
-            AddShadowCastingSpotLight( XMFLOAT4( -900.0f, 60.0f, 340.0f, 700.0f ), XMFLOAT3( -1360.0f, 255.0f, 555.0f ), COLOR( 100, 200, 100 ) );
+        memcpy( g_ShadowCastingPointLightDataArrayCenterAndRadius, Desc.pPointLightCenterAndRadius, sizeof(g_ShadowCastingPointLightDataArrayCenterAndRadius) );
+        memcpy( g_ShadowCastingPointLightDataArrayColor, Desc.pPointLightColor, sizeof(g_ShadowCastingPointLightDataArrayColor) );
+        memcpy( g_ShadowCastingPointLightViewProjTransposed, Desc.pPointLightShadowViewProj, sizeof(g_ShadowCastingPointLightViewProjTransposed) );
+        memcpy( g_ShadowCastingPointLightViewProjInvTransposed, Desc.pPointLightShadowViewProjInv, sizeof(g_ShadowCastingPointLightViewProjInvTransposed) );
+        memcpy( g_ShadowCastingSpotLightDataArrayCenterAndRadius, Desc.pSpotLightCenterAndRadius, sizeof(g_ShadowCastingSpotLightDataArrayCenterAndRadius) );
+        memcpy( g_ShadowCastingSpotLightDataArrayColor, Desc.pSpotLightColor, sizeof(g_ShadowCastingSpotLightDataArrayColor) );
+        memcpy( g_ShadowCastingSpotLightDataArraySpotParams, Desc.pSpotParams, sizeof(g_ShadowCastingSpotLightDataArraySpotParams) );
+        memcpy( g_ShadowCastingSpotLightDataArraySpotMatrices, Desc.pSpotMatrices, sizeof(g_ShadowCastingSpotLightDataArraySpotMatrices) );
+        memcpy( g_ShadowCastingSpotLightViewProjTransposed, Desc.pSpotLightShadowViewProj, sizeof(g_ShadowCastingSpotLightViewProjTransposed) );
+        memcpy( g_ShadowCastingSpotLightViewProjInvTransposed, Desc.pSpotLightShadowViewProjInv, sizeof(g_ShadowCastingSpotLightViewProjInvTransposed) );
+
+        // The spot lights' positions and look directions, for when they are moved, from the
+        // inverse matrices (see CPUShadowMatrices.cpp): the third column is -k*(eye,1), and
+        // the fourth is (dir + eye/near, 1/near). The far plane is the radius.
+        for( unsigned i = 0; i < MAX_NUM_SHADOWCASTING_SPOTS; i++ )
+        {
+            XMFLOAT4X4 f4x4Inv;
+            XMStoreFloat4x4( &f4x4Inv, g_ShadowCastingSpotLightViewProjInvTransposed[i] );
+            const XMFLOAT3 Eye( f4x4Inv._13 / f4x4Inv._43, f4x4Inv._23 / f4x4Inv._43, f4x4Inv._33 / f4x4Inv._43 );
+            g_ShadowCastingSpotLightDataArrayPositionAndRadius[i] = XMFLOAT4( Eye.x, Eye.y, Eye.z, g_ShadowCastingSpotLightDataArrayCenterAndRadius[i].w );
+            g_ShadowCastingSpotLightDataArrayLookAt[i] = XMFLOAT4(
+                Eye.x + f4x4Inv._14 - Eye.x*f4x4Inv._44,
+                Eye.y + f4x4Inv._24 - Eye.y*f4x4Inv._44,
+                Eye.z + f4x4Inv._34 - Eye.z*f4x4Inv._44, 1.0f );
+        }
+        return CPU_LIGHT_SET_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Fill in the data for the lights (center, radius, and color).
+    // Also fill in the vertex data for the sprite quad.
+    //--------------------------------------------------------------------------------------
+    void LightUtil::InitLights( const XMVECTOR &BBoxMin, const XMVECTOR &BBoxMax )
+    {
+        XMFLOAT3 vBBoxMin, vBBoxMax;
+        XMStoreFloat3( &vBBoxMin, BBoxMin );
+        XMStoreFloat3( &vBBoxMax, BBoxMax );
+
+        // Every light is a function of the seed and its index alone (see CPULightGeneration.h),
+        // seeded with 1, so that results are deterministic across different runs of the sample.
+        // The radius of the lights is scaled to the size of the scene. For point lights, the
+        // radius of the bounding sphere for the light (used for culling) and the falloff distance
+        // of the light (used for lighting) are the same. Not so for spot lights: a spot light is
+        // the cone with maximum volume that fits inside the bounding sphere, with height
+        // h_cone = (4/3)*r_sphere as its falloff distance.
+        CPULightGenerationDesc GenerationDesc;
+        InitCPULightGenerationDesc( 1, &vBBoxMin.x, &vBBoxMax.x, GenerationDesc );
+        const float fRadius = GenerationDesc.fRadius;
+
+        GenerateCPUPointLights( GenerationDesc, MAX_NUM_LIGHTS, (CPUFloat4*)g_PointLightDataArrayCenterAndRadius, (unsigned*)g_PointLightDataArrayColor, NULL );
+        GenerateCPUSpotLights( GenerationDesc, MAX_NUM_LIGHTS, (CPUFloat4*)g_SpotLightDataArrayCenterAndRadius, (unsigned*)g_SpotLightDataArrayColor,
+            (CPUSpotParams*)g_SpotLightDataArraySpotParams, (CPUMatrix*)g_SpotLightDataArraySpotMatrices, NULL );
+
+        // the random lights are the arrays above until a light set file replaces them
+        ClearCPULightSetDesc( g_RandomLights );
+        g_RandomLights.uNumPointLights = MAX_NUM_LIGHTS;
+        g_RandomLights.pPointLightCenterAndRadius = (const CPUFloat4*)g_PointLightDataArrayCenterAndRadius;
+        g_RandomLights.pPointLightColor = (const unsigned*)g_PointLightDataArrayColor;
+        g_RandomLights.uNumSpotLights = MAX_NUM_LIGHTS;
+        g_RandomLights.pSpotLightCenterAndRadius = (const CPUFloat4*)g_SpotLightDataArrayCenterAndRadius;
+        g_RandomLights.pSpotLightColor = (const unsigned*)g_SpotLightDataArrayColor;
+        g_RandomLights.pSpotParams = (const CPUSpotParams*)g_SpotLightDataArraySpotParams;
+        g_RandomLights.pSpotMatrices = (const CPUMatrix*)g_SpotLightDataArraySpotMatrices;
+        g_RandomLightSetFile.Close();
+
+        g_fLightAnimationRadius = fRadius;
+        InitLightAnimation();
+
+        // initialize the shadow-casting light data
+        for( int i = 0; i < MAX_NUM_SHADOWCASTING_POINTS; i++ )
+        {
+            const DefaultShadowCastingPointLight& Light = g_DefaultShadowCastingPointLights[i];
+            AddShadowCastingPointLight( XMFLOAT4( Light.CenterAndRadius ), COLOR( Light.Color[0], Light.Color[1], Light.Color[2] ) );
         }
 
+        for( int i = 0; i < MAX_NUM_SHADOWCASTING_SPOTS; i++ )
+        {
+            const DefaultShadowCastingSpotLight& Light = g_DefaultShadowCastingSpotLights[i];
+            AddShadowCastingSpotLight( XMFLOAT4( Light.PositionAndRadius ), XMFLOAT3( Light.LookAt ), COLOR( Light.Color[0], Light.Color[1], Light.Color[2] ) );
+        }
+
+        CalcShadowCastingLightMatrices();
+
         // initialize the vertex buffer data for a quad (for drawing the lights)
         float fQuadHalfSize = 0.083f * fRadius;
         g_QuadForLightsVertexData[0].v3Pos = XMFLOAT3(-fQuadHalfSize, -fQuadHalfSize, 0.0f );
@@ -998,6 +1221,22 @@ namespace TiledLighting11
         return g_ShadowCastingSpotLightViewProjInvTransposed;
     }
 
+    //--------------------------------------------------------------------------------------
+    // Return a pointer to the bounding spheres of the shadow-casting point lights
+    //--------------------------------------------------------------------------------------
+    const XMFLOAT4* LightUtil::GetShadowCastingPointLightCenterAndRadiusArray()
+    {
+        return g_ShadowCastingPointLightDataArrayCenterAndRadius;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Return a pointer to the bounding spheres of the shadow-casting spot light cones
+    //--------------------------------------------------------------------------------------
+    const XMFLOAT4* LightUtil::GetShadowCastingSpotLightCenterAndRadiusArray()
+    {
+        return g_ShadowCastingSpotLightDataArrayCenterAndRadius;
+    }
+
     //--------------------------------------------------------------------------------------
     // Add shaders to the shader cache
     //--------------------------------------------------------------------------------------
@@ -30,6 +30,9 @@
 
 #include "..\\..\\DXUT\\Core\\DXUT.h"
 #include "CommonConstants.h"
+#include "CPULightAnimation.h"
+#include "CPULightPool.h"
+#include "CPULightSet.h"
 
 // Forward declarations
 namespace AMD
@@ -59,6 +62,12 @@ namespace TiledLighting11
 
         static void InitLights( const DirectX::XMVECTOR &BBoxMin, const DirectX::XMVECTOR &BBoxMax );
 
+        // Light set files (see CPULightSet.h). Load after InitLights and before the device is
+        // created. A shadow-casting set must have shadow matrices and exactly MAX_NUM_SHADOWCASTING_POINTS
+        // and MAX_NUM_SHADOWCASTING_SPOTS lights; a random set is cut to MAX_NUM_LIGHTS of each.
+        static CPULightSetResult ExportLightSets( const char* pRandomLightsPath, const char* pShadowCastingLightsPath );
+        static CPULightSetResult LoadLightSet( const char* pPath, bool bShadowCasting );
+
         // returning a 2D array as XMMATRIX*[6], please forgive this ugly syntax
         static const DirectX::XMMATRIX (*GetShadowCastingPointLightViewProjTransposedArray())[6];
         static const DirectX::XMMATRIX (*GetShadowCastingPointLightViewProjInvTransposedArray())[6];
@@ -66,10 +75,48 @@ namespace TiledLighting11
         static const DirectX::XMMATRIX* GetShadowCastingSpotLightViewProjTransposedArray();
         static const DirectX::XMMATRIX* GetShadowCastingSpotLightViewProjInvTransposedArray();
 
+        // bounding spheres, for the spot lights those of their cones
+        static const DirectX::XMFLOAT4* GetShadowCastingPointLightCenterAndRadiusArray();
+        static const DirectX::XMFLOAT4* GetShadowCastingSpotLightCenterAndRadiusArray();
+
         void AddShadersToCache( AMD::ShaderCache *pShaderCache );
 
         void RenderLights( float fElapsedTime, unsigned uNumPointLights, unsigned uNumSpotLights, int nLightingMode, const CommonUtil& CommonUtil ) const;
 
+        // The point and spot lights of LIGHTING_RANDOM live in light pools, filled with the lights
+        // from InitLights when the device is first created (handles 0 to MAX_NUM_LIGHTS-1).
+        // Removing a light moves the last light of its pool into its place.
+        CPULightHandle AddPointLight( const DirectX::XMFLOAT4& CenterAndRadius, DWORD dwColor );
+        void SetPointLight( CPULightHandle Handle, const DirectX::XMFLOAT4& CenterAndRadius );
+        bool RemovePointLight( CPULightHandle Handle );
+
+        // CenterAndRadius is the bounding sphere of the cone, vLightDir must be normalized
+        CPULightHandle AddSpotLight( const DirectX::XMFLOAT4& CenterAndRadius, DWORD dwColor, const DirectX::XMFLOAT3& vLightDir );
+        void SetSpotLight( CPULightHandle Handle, const DirectX::XMFLOAT4& CenterAndRadius, const DirectX::XMFLOAT3& vLightDir );
+        bool RemoveSpotLight( CPULightHandle Handle );
+
+        unsigned GetNumPointLights() const { return m_PointLightPool.GetCount(); }
+        unsigned GetNumSpotLights() const { return m_SpotLightPool.GetCount(); }
+        const CPULightPool& GetPointLightPool() const { return m_PointLightPool; }
+        const CPULightPool& GetSpotLightPool() const { return m_SpotLightPool; }
+
+        // Move the lights that InitLights made (those still in the pools) to where they are at
+        // fTime seconds. Lights added later are left alone. Call before UpdateLightBuffers.
+        void AnimateLights( float fTime, CPUTaskScheduler* pScheduler );
+
+        // Upload what changed in the light pools since the last call, call once per frame before rendering
+        void UpdateLightBuffers( ID3D11DeviceContext* pd3dImmediateContext );
+
+        // The shadow-casting lights of LIGHTING_SHADOWS (uIndex is below MAX_NUM_SHADOWCASTING_POINTS
+        // or MAX_NUM_SHADOWCASTING_SPOTS). PositionAndRadius is the light's position, for spot lights too.
+        void SetShadowCastingPointLight( unsigned uIndex, const DirectX::XMFLOAT4& PositionAndRadius );
+        void SetShadowCastingSpotLight( unsigned uIndex, const DirectX::XMFLOAT4& PositionAndRadius, const DirectX::XMFLOAT3& LookAt );
+
+        // If a shadow-casting light was set since the last call, recompute all the shadow matrices
+        // and upload the shadow-casting light buffers, then return true: the shadow maps and RSMs
+        // have to be rendered again. Call once per frame before rendering.
+        bool UpdateShadowCastingLights( ID3D11DeviceContext* pd3dImmediateContext );
+
         // Various hook functions
         HRESULT OnCreateDevice( ID3D11Device* pd3dDevice );
         void OnDestroyDevice();
@@ -141,6 +188,13 @@ namespace TiledLighting11
 
         // state
         ID3D11BlendState*           m_pBlendStateAdditive;
+
+        // the point and spot light data, in the layout of the buffers above
+        CPULightPool                m_PointLightPool;
+        CPULightPool                m_SpotLightPool;
+
+        // a shadow-casting light was set since the last UpdateShadowCastingLights
+        bool                        m_bShadowCastingLightsChanged;
     };
 
 } // namespace TiledLighting11
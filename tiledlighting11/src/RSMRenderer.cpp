@@ -59,7 +59,10 @@ namespace TiledLighting11
         m_pPointInvViewProjBuffer( 0 ),
         m_pPointInvViewProjBufferSRV( 0 ),
         m_pNumVPLsConstantBuffer( 0 ),
-        m_pCPUReadbackConstantBuffer( 0 ),
+        m_uNumVPLFrames( 0 ),
+        m_bVPLsDirty( true ),
+        m_nVPLSpotLights( 0 ),
+        m_nVPLPointLights( 0 ),
         m_pRSMVS( 0 ),
         m_pRSMPS( 0 ),
         m_pRSMLayout( 0 ),
@@ -162,11 +165,12 @@ namespace TiledLighting11
         V( pd3dDevice->CreateBuffer( &desc, 0, &m_pNumVPLsConstantBuffer ) );
         DXUT_SetDebugName( m_pNumVPLsConstantBuffer, "NumVPLsConstantBuffer" );
 
-        desc.BindFlags = 0;
-        desc.Usage = D3D11_USAGE_STAGING;
-        desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-        V( pd3dDevice->CreateBuffer( &desc, 0, &m_pCPUReadbackConstantBuffer ) );
-        DXUT_SetDebugName( m_pCPUReadbackConstantBuffer, "CPUReadbackConstantBuffer" );
+        const unsigned uNumVPLsSize = sizeof( int );
+        V( m_NumVPLsReadback.Create( pd3dDevice, CPU_READBACK_DEFAULT_NUM_SLOTS, 1, &uNumVPLsSize, "NumVPLsReadback" ) );
+        m_NumVPLsReadback.SetSource( 0, m_pVPLBufferCenterAndRadiusUAV );
+        m_NumVPLsQueue.Init( &m_NumVPLsReadback, CPU_READBACK_DEFAULT_NUM_SLOTS, uNumVPLsSize );
+        m_uNumVPLFrames = 0;
+        m_bVPLsDirty = true;
     }
 
 
@@ -179,7 +183,8 @@ namespace TiledLighting11
         SAFE_RELEASE( m_pRSMPS );
         SAFE_RELEASE( m_pRSMVS );
 
-        SAFE_RELEASE( m_pCPUReadbackConstantBuffer );
+        m_NumVPLsReadback.Release();
+        m_NumVPLsQueue.Reset();
         SAFE_RELEASE( m_pNumVPLsConstantBuffer );
 
         SAFE_RELEASE( m_pPointInvViewProjBufferSRV );
@@ -214,6 +219,8 @@ namespace TiledLighting11
     {
         AMDProfileEvent( AMD_PROFILE_RED, L"SpotRSM" ); 
 
+        m_bVPLsDirty = true;
+
         ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
 
         D3D11_VIEWPORT oldVp[ 8 ];
@@ -275,6 +282,8 @@ namespace TiledLighting11
     {
         AMDProfileEvent( AMD_PROFILE_RED, L"PointRSM" ); 
 
+        m_bVPLsDirty = true;
+
         ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
 
         D3D11_VIEWPORT oldVp[ 8 ];
@@ -345,91 +354,97 @@ namespace TiledLighting11
     {
         ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
 
-        ID3D11UnorderedAccessView* pUAVs[] = { m_pVPLBufferCenterAndRadiusUAV, m_pVPLBufferDataUAV };
+        // The VPL buffers and their count keep what the last dispatch made, which is still up to
+        // date if neither the RSMs nor the light counts nor the VPL constants changed since
+        if ( m_bVPLsDirty || NumSpotLights != m_nVPLSpotLights || NumPointLights != m_nVPLPointLights )
+        {
+            ID3D11UnorderedAccessView* pUAVs[] = { m_pVPLBufferCenterAndRadiusUAV, m_pVPLBufferDataUAV };
 
-        // Clear the VPL counter
-        UINT InitialCounts[ 2 ] = { 0, 0 };
-        pd3dImmediateContext->CSSetUnorderedAccessViews( 0, ARRAYSIZE( pUAVs ), pUAVs, InitialCounts );
+            // Clear the VPL counter
+            UINT InitialCounts[ 2 ] = { 0, 0 };
+            pd3dImmediateContext->CSSetUnorderedAccessViews( 0, ARRAYSIZE( pUAVs ), pUAVs, InitialCounts );
 
-        const int numThreadsX = 16;
-        const int numThreadsY = 16;
+            const int numThreadsX = 16;
+            const int numThreadsY = 16;
 
-        const int sampleKernel = 2;
+            const int sampleKernel = 2;
 
-        if ( NumSpotLights > 0 )
-        {
-            ID3D11ShaderResourceView* pSRVs[] = 
-			{ 
-				m_SpotAtlas.m_pDepthSRV, 
-				m_SpotAtlas.m_pNormalSRV, 
-				m_SpotAtlas.m_pDiffuseSRV, 
-				m_pSpotInvViewProjBufferSRV, 
-				*LightUtil.GetSpotLightBufferCenterAndRadiusSRVParam(LIGHTING_SHADOWS),  
-				*LightUtil.GetSpotLightBufferColorSRVParam(LIGHTING_SHADOWS),
-				*LightUtil.GetSpotLightBufferSpotParamsSRVParam(LIGHTING_SHADOWS)
-			};
-            pd3dImmediateContext->CSSetShaderResources( 0, ARRAYSIZE( pSRVs ), pSRVs );
-            pd3dImmediateContext->CSSetShader( m_pGenerateSpotVPLsCS, 0, 0 );
-
-            int dispatchCountX = (NumSpotLights * gRSMSpotResolution/sampleKernel) / numThreadsX;
-            int dispatchCountY = (gRSMSpotResolution/sampleKernel) / numThreadsY;
-
-            pd3dImmediateContext->Dispatch( dispatchCountX, dispatchCountY, 1 );
-
-            ZeroMemory( pSRVs, sizeof( pSRVs ) );
-            pd3dImmediateContext->CSSetShaderResources( 0, ARRAYSIZE( pSRVs ), pSRVs );
-        }
+            if ( NumSpotLights > 0 )
+            {
+                ID3D11ShaderResourceView* pSRVs[] = 
+				{ 
+					m_SpotAtlas.m_pDepthSRV, 
+					m_SpotAtlas.m_pNormalSRV, 
+					m_SpotAtlas.m_pDiffuseSRV, 
+					m_pSpotInvViewProjBufferSRV, 
+					*LightUtil.GetSpotLightBufferCenterAndRadiusSRVParam(LIGHTING_SHADOWS),  
+					*LightUtil.GetSpotLightBufferColorSRVParam(LIGHTING_SHADOWS),
+					*LightUtil.GetSpotLightBufferSpotParamsSRVParam(LIGHTING_SHADOWS)
+				};
+                pd3dImmediateContext->CSSetShaderResources( 0, ARRAYSIZE( pSRVs ), pSRVs );
+                pd3dImmediateContext->CSSetShader( m_pGenerateSpotVPLsCS, 0, 0 );
+
+                int dispatchCountX = (NumSpotLights * gRSMSpotResolution/sampleKernel) / numThreadsX;
+                int dispatchCountY = (gRSMSpotResolution/sampleKernel) / numThreadsY;
+
+                pd3dImmediateContext->Dispatch( dispatchCountX, dispatchCountY, 1 );
+
+                ZeroMemory( pSRVs, sizeof( pSRVs ) );
+                pd3dImmediateContext->CSSetShaderResources( 0, ARRAYSIZE( pSRVs ), pSRVs );
+            }
 
-        if ( NumPointLights > 0  )
-        {
-            ID3D11ShaderResourceView* pSRVs[] = 
-			{ 
-				m_PointAtlas.m_pDepthSRV, 
-				m_PointAtlas.m_pNormalSRV, 
-				m_PointAtlas.m_pDiffuseSRV, 
-				m_pPointInvViewProjBufferSRV, 
-				*LightUtil.GetPointLightBufferCenterAndRadiusSRVParam(LIGHTING_SHADOWS),
-				*LightUtil.GetPointLightBufferColorSRVParam(LIGHTING_SHADOWS)
-			};
-            pd3dImmediateContext->CSSetShaderResources( 0, ARRAYSIZE( pSRVs ), pSRVs );
-            pd3dImmediateContext->CSSetShader( m_pGeneratePointVPLsCS, 0, 0 );
-
-            int dispatchCountX = (6 * gRSMPointResolution/sampleKernel) / numThreadsX;
-            int dispatchCountY = (NumPointLights * gRSMPointResolution/sampleKernel) / numThreadsY;
-
-            pd3dImmediateContext->Dispatch( dispatchCountX, dispatchCountY, 1 );
-
-			ZeroMemory( pSRVs, sizeof( pSRVs ) );
-            pd3dImmediateContext->CSSetShaderResources( 0, ARRAYSIZE( pSRVs ), pSRVs );
-        }
+            if ( NumPointLights > 0  )
+            {
+                ID3D11ShaderResourceView* pSRVs[] = 
+				{ 
+					m_PointAtlas.m_pDepthSRV, 
+					m_PointAtlas.m_pNormalSRV, 
+					m_PointAtlas.m_pDiffuseSRV, 
+					m_pPointInvViewProjBufferSRV, 
+					*LightUtil.GetPointLightBufferCenterAndRadiusSRVParam(LIGHTING_SHADOWS),
+					*LightUtil.GetPointLightBufferColorSRVParam(LIGHTING_SHADOWS)
+				};
+                pd3dImmediateContext->CSSetShaderResources( 0, ARRAYSIZE( pSRVs ), pSRVs );
+                pd3dImmediateContext->CSSetShader( m_pGeneratePointVPLsCS, 0, 0 );
+
+                int dispatchCountX = (6 * gRSMPointResolution/sampleKernel) / numThreadsX;
+                int dispatchCountY = (NumPointLights * gRSMPointResolution/sampleKernel) / numThreadsY;
+
+                pd3dImmediateContext->Dispatch( dispatchCountX, dispatchCountY, 1 );
+
+				ZeroMemory( pSRVs, sizeof( pSRVs ) );
+                pd3dImmediateContext->CSSetShaderResources( 0, ARRAYSIZE( pSRVs ), pSRVs );
+            }
 
-        ID3D11UnorderedAccessView* pNullUAVs[] = { NULL, NULL };
-        pd3dImmediateContext->CSSetUnorderedAccessViews( 0, ARRAYSIZE( pNullUAVs ), pNullUAVs, NULL );
+            ID3D11UnorderedAccessView* pNullUAVs[] = { NULL, NULL };
+            pd3dImmediateContext->CSSetUnorderedAccessViews( 0, ARRAYSIZE( pNullUAVs ), pNullUAVs, NULL );
 
-        // Copy the number of items counter from the UAV into a constant buffer for reading in the forward pass
-        pd3dImmediateContext->CopyStructureCount( m_pNumVPLsConstantBuffer, 0, m_pVPLBufferCenterAndRadiusUAV );
+            // Copy the number of items counter from the UAV into a constant buffer for reading in the forward pass
+            pd3dImmediateContext->CopyStructureCount( m_pNumVPLsConstantBuffer, 0, m_pVPLBufferCenterAndRadiusUAV );
+
+            m_bVPLsDirty = false;
+            m_nVPLSpotLights = NumSpotLights;
+            m_nVPLPointLights = NumPointLights;
+        }
 
         pd3dImmediateContext->CSSetConstantBuffers( 4, 1, &m_pNumVPLsConstantBuffer );
         pd3dImmediateContext->PSSetConstantBuffers( 4, 1, &m_pNumVPLsConstantBuffer );
+
+        // and into the next readback slot, for ReadbackNumVPLs to pick up a few frames later
+        m_NumVPLsQueue.Request( ++m_uNumVPLFrames );
     }
 
 
-    int RSMRenderer::ReadbackNumVPLs()
+    int RSMRenderer::ReadbackNumVPLs( unsigned* puAge )
     {
-        ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
-        int NumVPLs = 0;
+        m_NumVPLsQueue.Update( m_uNumVPLFrames );
 
-        pd3dImmediateContext->CopyStructureCount( m_pCPUReadbackConstantBuffer, 0, m_pVPLBufferCenterAndRadiusUAV );
-
-        D3D11_MAPPED_SUBRESOURCE resource;
-        if ( pd3dImmediateContext->Map( m_pCPUReadbackConstantBuffer, 0, D3D11_MAP_READ, 0, &resource ) == S_OK )
+        if( puAge != NULL )
         {
-            NumVPLs = *( (int*)resource.pData );
-
-            pd3dImmediateContext->Unmap( m_pCPUReadbackConstantBuffer, 0 );
+            *puAge = m_NumVPLsQueue.HasResult() ? m_uNumVPLFrames - m_NumVPLsQueue.GetResultFrame() : 0;
         }
 
-        return NumVPLs;
+        return m_NumVPLsQueue.HasResult() ? *(const int*)m_NumVPLsQueue.GetResult() : 0;
     }
 
     void RSMRenderer::RenderRSMScene( const GuiState& CurrentGuiState, const Scene& Scene, const CommonUtil& CommonUtil )
@@ -30,6 +30,7 @@
 
 #include "..\\..\\DXUT\\Core\\DXUT.h"
 #include "CommonConstants.h"
+#include "ReadbackUtil.h"
 
 // Forward declarations
 namespace AMD
@@ -80,7 +81,15 @@ namespace TiledLighting11
         ID3D11ShaderResourceView * const * GetVPLBufferCenterAndRadiusSRVParam() const { return &m_pVPLBufferCenterAndRadiusSRV; }
         ID3D11ShaderResourceView * const * GetVPLBufferDataSRVParam() const { return &m_pVPLBufferDataSRV; }
 
-        int ReadbackNumVPLs();
+        // The number of VPLs a recent GenerateVPLs made, read back without waiting for the GPU
+        // (0 until the first readback arrives). puAge, if not NULL, gets how many GenerateVPLs
+        // calls ago that was.
+        int ReadbackNumVPLs( unsigned* puAge = NULL );
+
+        // GenerateVPLs keeps the last frame's VPLs until the RSMs are rendered again or the
+        // light counts change; call this when anything else it reads changes (the VPL
+        // thresholds, say)
+        void InvalidateVPLs() { m_bVPLsDirty = true; }
 
     private:
         void RenderRSMScene( const GuiState& CurrentGuiState, const Scene& Scene, const CommonUtil& CommonUtil );
@@ -137,7 +146,16 @@ namespace TiledLighting11
         ID3D11ShaderResourceView*   m_pPointInvViewProjBufferSRV;
 
         ID3D11Buffer*               m_pNumVPLsConstantBuffer;
-        ID3D11Buffer*               m_pCPUReadbackConstantBuffer;
+
+        // the VPL counter, read back a few frames late
+        StagingReadback             m_NumVPLsReadback;
+        CPUReadbackQueue            m_NumVPLsQueue;
+        unsigned                    m_uNumVPLFrames;
+
+        // whether the VPL buffers are out of date, and the light counts they were generated for
+        bool                        m_bVPLsDirty;
+        int                         m_nVPLSpotLights;
+        int                         m_nVPLPointLights;
 
         ID3D11VertexShader*         m_pRSMVS;
         ID3D11PixelShader*          m_pRSMPS;
@@ -0,0 +1,206 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ReadbackUtil.cpp
+//
+// The D3D11 backend of CPUReadbackQueue.
+//--------------------------------------------------------------------------------------
+
+#include "..\\..\\DXUT\\Core\\DXUT.h"
+
+#include "ReadbackUtil.h"
+
+#include <string.h>
+
+namespace TiledLighting11
+{
+
+    StagingReadback::StagingReadback()
+    {
+    }
+
+
+    StagingReadback::~StagingReadback()
+    {
+        Release();
+    }
+
+
+    HRESULT StagingReadback::Create( ID3D11Device* pd3dDevice, unsigned uNumSlots, unsigned uNumSources, const unsigned* pByteWidths, const char* pName )
+    {
+        HRESULT hr;
+
+        Release();
+
+        m_Sources.resize( uNumSources );
+        for( unsigned i = 0; i < uNumSources; i++ )
+        {
+            m_Sources[i].pBuffer = NULL;
+            m_Sources[i].pCounterUAV = NULL;
+            m_Sources[i].uByteWidth = pByteWidths[i];
+        }
+
+        m_StagingBuffers.assign( uNumSlots*uNumSources, NULL );
+        m_Queries.assign( uNumSlots, NULL );
+
+        for( unsigned uSlot = 0; uSlot < uNumSlots; uSlot++ )
+        {
+            for( unsigned i = 0; i < uNumSources; i++ )
+            {
+                // CopyStructureCount writes 4 bytes, but buffers are at least 16
+                D3D11_BUFFER_DESC desc;
+                ZeroMemory( &desc, sizeof( desc ) );
+                desc.Usage = D3D11_USAGE_STAGING;
+                desc.ByteWidth = pByteWidths[i] < 16 ? 16 : pByteWidths[i];
+                desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+                V_RETURN( pd3dDevice->CreateBuffer( &desc, NULL, &m_StagingBuffers[uSlot*uNumSources + i] ) );
+                DXUT_SetDebugName( m_StagingBuffers[uSlot*uNumSources + i], pName );
+            }
+
+            D3D11_QUERY_DESC QueryDesc;
+            QueryDesc.Query = D3D11_QUERY_EVENT;
+            QueryDesc.MiscFlags = 0;
+            V_RETURN( pd3dDevice->CreateQuery( &QueryDesc, &m_Queries[uSlot] ) );
+            DXUT_SetDebugName( m_Queries[uSlot], pName );
+        }
+
+        return S_OK;
+    }
+
+
+    void StagingReadback::Release()
+    {
+        for( unsigned i = 0; i < m_StagingBuffers.size(); i++ )
+        {
+            SAFE_RELEASE( m_StagingBuffers[i] );
+        }
+        for( unsigned i = 0; i < m_Queries.size(); i++ )
+        {
+            SAFE_RELEASE( m_Queries[i] );
+        }
+
+        m_StagingBuffers.clear();
+        m_Queries.clear();
+        m_Sources.clear();
+    }
+
+
+    unsigned StagingReadback::GetDataSize() const
+    {
+        unsigned uDataSize = 0;
+        for( unsigned i = 0; i < m_Sources.size(); i++ )
+        {
+            uDataSize += m_Sources[i].uByteWidth;
+        }
+
+        return uDataSize;
+    }
+
+
+    void StagingReadback::SetSource( unsigned uSource, ID3D11Buffer* pBuffer )
+    {
+        m_Sources[uSource].pBuffer = pBuffer;
+        m_Sources[uSource].pCounterUAV = NULL;
+    }
+
+
+    void StagingReadback::SetSource( unsigned uSource, ID3D11UnorderedAccessView* pCounterUAV )
+    {
+        m_Sources[uSource].pBuffer = NULL;
+        m_Sources[uSource].pCounterUAV = pCounterUAV;
+    }
+
+
+    void StagingReadback::CopyToSlot( unsigned uSlot )
+    {
+        if( uSlot >= m_Queries.size() )
+        {
+            return;
+        }
+
+        ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
+
+        const unsigned uNumSources = (unsigned)m_Sources.size();
+        for( unsigned i = 0; i < uNumSources; i++ )
+        {
+            ID3D11Buffer* pStagingBuffer = m_StagingBuffers[uSlot*uNumSources + i];
+            if( m_Sources[i].pCounterUAV != NULL )
+            {
+                pd3dImmediateContext->CopyStructureCount( pStagingBuffer, 0, m_Sources[i].pCounterUAV );
+            }
+            else if( m_Sources[i].pBuffer != NULL )
+            {
+                pd3dImmediateContext->CopyResource( pStagingBuffer, m_Sources[i].pBuffer );
+            }
+        }
+
+        pd3dImmediateContext->End( m_Queries[uSlot] );
+    }
+
+
+    bool StagingReadback::IsSlotReady( unsigned uSlot )
+    {
+        // nothing completes once released, so a queue can be updated before it is set up again
+        if( uSlot >= m_Queries.size() )
+        {
+            return false;
+        }
+
+        // S_FALSE until the GPU gets past the copies; don't flush, Present will
+        ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
+        return pd3dImmediateContext->GetData( m_Queries[uSlot], NULL, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH ) == S_OK;
+    }
+
+
+    bool StagingReadback::ReadSlot( unsigned uSlot, void* pData, unsigned uDataSize )
+    {
+        ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
+
+        const unsigned uNumSources = (unsigned)m_Sources.size();
+        unsigned char* pDst = (unsigned char*)pData;
+        for( unsigned i = 0; i < uNumSources && uDataSize > 0; i++ )
+        {
+            const unsigned uSize = m_Sources[i].uByteWidth < uDataSize ? m_Sources[i].uByteWidth : uDataSize;
+
+            // the fence has passed, so this does not wait
+            D3D11_MAPPED_SUBRESOURCE MappedResource;
+            if( pd3dImmediateContext->Map( m_StagingBuffers[uSlot*uNumSources + i], 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &MappedResource ) != S_OK )
+            {
+                return false;
+            }
+            memcpy( pDst, MappedResource.pData, uSize );
+            pd3dImmediateContext->Unmap( m_StagingBuffers[uSlot*uNumSources + i], 0 );
+
+            pDst += uSize;
+            uDataSize -= uSize;
+        }
+
+        return true;
+    }
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
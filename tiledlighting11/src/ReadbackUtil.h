@@ -0,0 +1,90 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ReadbackUtil.h
+//
+// The D3D11 backend of CPUReadbackQueue: a staging buffer per slot and source, and an
+// event query per slot as the fence.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "..\\..\\DXUT\\Core\\DXUT.h"
+#include "CPUReadbackQueue.h"
+
+#include <vector>
+
+namespace TiledLighting11
+{
+    class StagingReadback : public CPUReadbackBackend
+    {
+    public:
+
+        StagingReadback();
+        ~StagingReadback();
+
+        // uNumSlots slots, each with a staging buffer for every source, of pByteWidths[i]
+        // bytes for source i. A slot's data is its sources' data one after the other.
+        HRESULT Create( ID3D11Device* pd3dDevice, unsigned uNumSlots, unsigned uNumSources, const unsigned* pByteWidths, const char* pName );
+        void Release();
+
+        bool IsCreated() const { return !m_Queries.empty(); }
+        unsigned GetNumSlots() const { return (unsigned)m_Queries.size(); }
+        unsigned GetDataSize() const;
+
+        // What the next copies read: a buffer of the source's size (CopyResource), or the
+        // hidden counter of an append or counter UAV (CopyStructureCount, 4 bytes). The
+        // views are not AddRef'd, so set them again if they are recreated.
+        void SetSource( unsigned uSource, ID3D11Buffer* pBuffer );
+        void SetSource( unsigned uSource, ID3D11UnorderedAccessView* pCounterUAV );
+
+        // CPUReadbackBackend
+        virtual void CopyToSlot( unsigned uSlot );
+        virtual bool IsSlotReady( unsigned uSlot );
+        virtual bool ReadSlot( unsigned uSlot, void* pData, unsigned uDataSize );
+
+    private:
+        // not copyable
+        StagingReadback( const StagingReadback& );
+        StagingReadback& operator=( const StagingReadback& );
+
+        struct Source
+        {
+            ID3D11Buffer*               pBuffer;
+            ID3D11UnorderedAccessView*  pCounterUAV;
+            unsigned                    uByteWidth;
+        };
+
+        std::vector<Source>         m_Sources;
+
+        // m_StagingBuffers[uSlot*m_Sources.size() + uSource]
+        std::vector<ID3D11Buffer*>  m_StagingBuffers;
+        std::vector<ID3D11Query*>   m_Queries;
+    };
+
+} // namespace TiledLighting11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
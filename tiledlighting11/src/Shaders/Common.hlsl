@@ -91,3 +91,17 @@ float4 FullScreenBlitPS( VS_QUAD_OUTPUT i ) : SV_TARGET
 #endif
 }
 
+#if ( NUM_MSAA_SAMPLES <= 1 )   // non-MSAA
+//--------------------------------------------------------------------------------------
+// Function:    FullScreenDepthBlitPS
+//
+// Description: Copy the input's first channel to the depth buffer, texel for texel.
+//              Used with the viewport set to a shadow map tile, to restore the tile 
+//              from a cached copy of the same size.
+//--------------------------------------------------------------------------------------
+float FullScreenDepthBlitPS( VS_QUAD_OUTPUT i ) : SV_DEPTH
+{
+    return g_OffScreenBuffer.Load( int3( i.Position.xy, 0 ) ).x;
+}
+#endif
+
@@ -50,9 +50,15 @@ static const float4 kRadarColors[14] =
 
 //--------------------------------------------------------------------------------------
 // Light culling constants.
-// These must match their counterparts in CommonUtil.h
+// These must match their counterparts in CommonConstants.h
+//
+// The tiled culling compute shaders are compiled once per tile size in g_nTileRes
+// (see CommonConstants.h), which sets TILE_RES. Other shaders read the tile size
+// from g_uTileRes instead, so that they don't need a permutation per tile size.
 //--------------------------------------------------------------------------------------
+#ifndef TILE_RES
 #define TILE_RES 16
+#endif
 #define MAX_NUM_LIGHTS_PER_TILE 272
 #define MAX_NUM_VPLS_PER_TILE 1024
 
@@ -104,7 +110,7 @@ cbuffer cbPerFrame : register( b2 )
     float               g_fVPLRemoveBackFaceContrib  : packoffset( c22.w );
     float               g_fVPLColorThreshold         : packoffset( c23 );
     float               g_fVPLBrightnessThreshold    : packoffset( c23.y );
-    float               g_fPerFramePad1              : packoffset( c23.z );
+    uint                g_uTileRes                   : packoffset( c23.z );
     float               g_fPerFramePad2              : packoffset( c23.w );
 };
 
@@ -112,7 +118,9 @@ cbuffer cbShadowConstants : register( b3 )
 {
     matrix              g_mPointShadowViewProj[ MAX_NUM_SHADOWCASTING_POINTS ][ 6 ];
     matrix              g_mSpotShadowViewProj[ MAX_NUM_SHADOWCASTING_SPOTS ];
-    float4              g_ShadowBias;  // X: Texel offset from edge, Y: Underscan scale, Z: Z bias for points, W: Z bias for spots
+    float4              g_ShadowBias;  // X, Y: unused, Z: Z bias for points, W: Z bias for spots
+    float4              g_PointShadowScaleOffset[ MAX_NUM_SHADOWCASTING_POINTS ][ 6 ];  // XY: scale, ZW: offset, to each face's tile in the atlas
+    float4              g_SpotShadowScaleOffset[ MAX_NUM_SHADOWCASTING_SPOTS ];
 };
 
 cbuffer cbVPLConstants : register( b4 )
@@ -156,7 +164,7 @@ float ConvertProjDepthToView( float z )
 
 uint GetTileIndex(float2 ScreenPos)
 {
-    float fTileRes = (float)TILE_RES;
+    float fTileRes = (float)g_uTileRes;
     uint nTileIdx = floor(ScreenPos.x/fTileRes)+floor(ScreenPos.y/fTileRes)*g_uNumTilesX;
     return nTileIdx;
 }
@@ -180,6 +188,67 @@ void GetLightListInfo(in Buffer<uint> PerTileLightIndexBuffer, in uint uMaxNumLi
     uNumLights = (fViewPosZ < fHalfZ) ? PerTileLightIndexBuffer[nStartIndex+2] : PerTileLightIndexBuffer[nStartIndex+3];
 }
 
+// Clustered alternative to GetLightListInfo (see CPUClusteredCulling.h).
+// Each tile is cut into uNumSlices exponential depth slices, slice = floor(log2(viewZ)*scale + bias).
+// ClusterOffsetAndCountBuffer layout, per cluster (tileIndex*uNumSlices + slice):
+// | Offset Into Light Index Pool | Light Count |
+// The returned range indexes the shared light index pool, not ClusterOffsetAndCountBuffer.
+void GetClusterLightListInfo(in Buffer<uint2> ClusterOffsetAndCountBuffer, in uint uNumSlices, in float2 SliceScaleAndBias, in float4 SVPosition, out uint uFirstLightIndex, out uint uNumLights)
+{
+    uint nTileIndex = GetTileIndex(SVPosition.xy);
+
+    float fViewPosZ = ConvertProjDepthToView( SVPosition.z );
+    float fSlice = log2( fViewPosZ )*SliceScaleAndBias.x + SliceScaleAndBias.y;
+    uint nSlice = min( (uint)max( fSlice, 0.0f ), uNumSlices - 1 );
+
+    uint2 OffsetAndCount = ClusterOffsetAndCountBuffer[nTileIndex*uNumSlices + nSlice];
+    uFirstLightIndex = OffsetAndCount.x;
+    uNumLights = OffsetAndCount.y;
+}
+
+// Compacted alternative to GetLightListInfo (see CPUCompactLightCulling.h).
+// The per-tile lists are packed back to back in one light index pool instead of
+// reserving uMaxNumLightsPerTile entries for each list of each tile.
+// PerTileLightListInfoBuffer layout, per tile:
+// | First Index (List A, List B follows it) | Light Count List A | Light Count List B | HalfZ Bits |
+// The returned range indexes the light index pool, not PerTileLightListInfoBuffer.
+void GetCompactLightListInfo(in Buffer<uint4> PerTileLightListInfoBuffer, in float4 SVPosition, out uint uFirstLightIndex, out uint uNumLights)
+{
+    uint4 TileInfo = PerTileLightListInfoBuffer[GetTileIndex(SVPosition.xy)];
+    float fHalfZ = asfloat(TileInfo.w);
+
+    float fViewPosZ = ConvertProjDepthToView( SVPosition.z );
+
+    uFirstLightIndex = (fViewPosZ < fHalfZ) ? TileInfo.x : (TileInfo.x + TileInfo.y);
+    uNumLights = (fViewPosZ < fHalfZ) ? TileInfo.y : TileInfo.z;
+}
+
+// Z-binned alternative to GetLightListInfo (see CPUZBinnedCulling.h).
+// Lights are sorted by view-space depth. ZBinBuffer holds one uint per linear depth bin, bin = floor(viewZ*fBinScale):
+// | Lowest Sorted Light (low 16 bits) | Highest Sorted Light (high 16 bits) |, with lowest > highest for an empty bin.
+// TileLightMaskBuffer holds uNumMaskWords uints per tile, one bit per sorted light that touches the tile.
+// A pixel's lights are the set bits of the words from uMinLightIndex/32 to uMaxLightIndex/32,
+// as returned by GetZBinLightMaskWord, mapped back through the sorted light index buffer.
+void GetZBinLightRange(in Buffer<uint> ZBinBuffer, in uint uNumBins, in float fBinScale, in float4 SVPosition, out uint uMinLightIndex, out uint uMaxLightIndex)
+{
+    float fViewPosZ = ConvertProjDepthToView( SVPosition.z );
+    uint nBin = min( (uint)max( fViewPosZ*fBinScale, 0.0f ), uNumBins - 1 );
+
+    uint uBin = ZBinBuffer[nBin];
+    uMinLightIndex = uBin & 0xFFFF;
+    uMaxLightIndex = uBin >> 16;
+}
+
+uint GetZBinLightMaskWord(in Buffer<uint> TileLightMaskBuffer, in uint uNumMaskWords, in float4 SVPosition, in uint uWord, in uint uMinLightIndex, in uint uMaxLightIndex)
+{
+    uint uMask = TileLightMaskBuffer[GetTileIndex(SVPosition.xy)*uNumMaskWords + uWord];
+
+    // clip the word to [uMinLightIndex,uMaxLightIndex]
+    if( uWord == uMinLightIndex/32 ) uMask &= 0xFFFFFFFF << (uMinLightIndex % 32);
+    if( uWord == uMaxLightIndex/32 ) uMask &= 0xFFFFFFFF >> (31 - (uMaxLightIndex % 32));
+    return uMask;
+}
+
 float4 ConvertNumberOfLightsToGrayscale(uint nNumLightsInThisTile, uint uMaxNumLightsPerTile)
 {
     float fPercentOfMax = (float)nNumLightsInThisTile / (float)uMaxNumLightsPerTile;
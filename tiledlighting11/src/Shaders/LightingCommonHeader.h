@@ -112,14 +112,9 @@ float DoShadow( uint nShadowIndex, in float3 vPosition, float3 vLightDir, float
     shadowTexCoord.x = shadowTexCoord.x/2 + 0.5;
     shadowTexCoord.y = shadowTexCoord.y/-2 + 0.5;
 
-    shadowTexCoord.xy *= g_ShadowBias.xx;
-    shadowTexCoord.xy += g_ShadowBias.yy;
-
-    shadowTexCoord.x += face;
-    shadowTexCoord.x *= rcp( 6 );
-
-    shadowTexCoord.y += nShadowIndex;
-    shadowTexCoord.y *= rcp( MAX_NUM_SHADOWCASTING_POINTS );
+    // into the face's tile, which keeps a border for the filter
+    float4 vScaleOffset = g_PointShadowScaleOffset[ nShadowIndex ][ face ];
+    shadowTexCoord.xy = shadowTexCoord.xy*vScaleOffset.xy + vScaleOffset.zw;
 
     // the lerp below is to increase the shadow bias when the light is close to the
     // surface pixel being shaded
@@ -136,14 +131,59 @@ float DoSpotShadow( uint nShadowIndex, in float3 vPosition )
     shadowTexCoord.x = shadowTexCoord.x/2 + 0.5;
     shadowTexCoord.y = shadowTexCoord.y/-2 + 0.5;
 
-    shadowTexCoord.x += nShadowIndex;
-    shadowTexCoord.x *= rcp( MAX_NUM_SHADOWCASTING_SPOTS );
+    float4 vScaleOffset = g_SpotShadowScaleOffset[ nShadowIndex ];
+    shadowTexCoord.xy = shadowTexCoord.xy*vScaleOffset.xy + vScaleOffset.zw;
 
     shadowTexCoord.z -= g_ShadowBias.w;
 
     return FilterShadow( g_SpotShadowAtlas, shadowTexCoord.xyz );
 }
 
+//-----------------------------------------------------------------------------------------
+// Quantized lights (see CPUQuantizedLights.h). The decoders return what the float light
+// buffers hold, so the results can go straight into the lighting functions below.
+//-----------------------------------------------------------------------------------------
+struct QuantizedSpotLight
+{
+    uint2 CenterAndRadius;
+    uint  Color;
+    uint  Direction;
+    uint  ConeAndFalloff;
+};
+
+float4 DecodeQuantizedCenterAndRadius( uint2 Packed, float3 BoundsMin, float3 BoundsScale )
+{
+    float3 vQuantized = float3( Packed.x & 0xFFFF, Packed.x >> 16, Packed.y & 0xFFFF );
+    return float4( BoundsMin + vQuantized*BoundsScale, f16tof32( Packed.y >> 16 ) );
+}
+
+float4 DecodeRGB9E5( uint uPacked )
+{
+    float fScale = exp2( (float)( uPacked >> 27 ) - 24.0 );
+    return float4( float3( uPacked & 0x1FF, ( uPacked >> 9 ) & 0x1FF, ( uPacked >> 18 ) & 0x1FF )*fScale, 0 );
+}
+
+float3 DecodeOctahedral( uint uPacked )
+{
+    // two snorms
+    float2 vEncoded = max( float2( (int)( uPacked << 16 ) >> 16, (int)uPacked >> 16 ) / 32767.0, -1.0 );
+    float3 vDir = float3( vEncoded, 1 - abs( vEncoded.x ) - abs( vEncoded.y ) );
+
+    // unfold the lower half
+    float t = saturate( -vDir.z );
+    vDir.xy += ( vDir.xy >= 0 ) ? -t : t;
+    return normalize( vDir );
+}
+
+// The float4 of the spot params buffer: the light dir's x and y, the cone angle cosine
+// with the sign of the light dir's z, and the falloff radius
+float4 DecodeQuantizedSpotParams( uint uDirection, uint uConeAndFalloff )
+{
+    float3 vDir = DecodeOctahedral( uDirection );
+    float fCosineOfConeAngle = f16tof32( uConeAndFalloff & 0xFFFF );
+    return float4( vDir.xy, ( vDir.z < 0 ) ? -fCosineOfConeAngle : fCosineOfConeAngle, f16tof32( uConeAndFalloff >> 16 ) );
+}
+
 void DoLighting(uniform bool bDoShadow, in Buffer<float4> PointLightBufferCenterAndRadius, in Buffer<float4> PointLightBufferColor, in uint nLightIndex, in float3 vPosition, in float3 vNorm, in float3 vViewDir, out float3 LightColorDiffuseResult, out float3 LightColorSpecularResult)
 {
     float4 CenterAndRadius = PointLightBufferCenterAndRadius[nLightIndex];
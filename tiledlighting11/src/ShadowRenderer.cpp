@@ -32,14 +32,25 @@
 
 #include "ShadowRenderer.h"
 #include "LightUtil.h"
+#include "CommonUtil.h"
+#include "CPUShadowScheduler.h"
 
 
 #pragma warning( disable : 4100 ) // disable unreference formal parameter warnings for /W4 builds
 
 using namespace DirectX;
 
-static const int gPointShadowResolution = 256;
-static const int gSpotShadowResolution = 256;
+// point light faces go in a 4096x2048 atlas and spot lights in a 2048x1024 one, in tiles
+// from 64 to 512 (points) or 1024 (spots) texels, all 256 until the camera is known
+static const unsigned gPointShadowAtlasRootSize = 2048;
+static const unsigned gSpotShadowAtlasRootSize = 1024;
+static const unsigned gMinShadowTileSize = 64;
+static const unsigned gMaxPointShadowTileSize = 512;
+static const unsigned gMaxSpotShadowTileSize = 1024;
+static const unsigned gInitialShadowTileSize = 256;
+
+// the point light shadow filter's footprint, in texels, kept inside each face's tile
+static const float gPointShadowBorder = 2.5f;
 
 
 namespace TiledLighting11
@@ -53,8 +64,40 @@ namespace TiledLighting11
         m_pPointAtlasSRV( 0 ),
         m_pSpotAtlasTexture( 0 ),
         m_pSpotAtlasView( 0 ),
-        m_pSpotAtlasSRV( 0 )
+        m_pSpotAtlasSRV( 0 ),
+        m_pPointStaticTexture( 0 ),
+        m_pPointStaticView( 0 ),
+        m_pPointStaticSRV( 0 ),
+        m_pSpotStaticTexture( 0 ),
+        m_pSpotStaticView( 0 ),
+        m_pSpotStaticSRV( 0 )
     {
+        CPUShadowAtlasDesc PointAtlasDesc;
+        PointAtlasDesc.uRootSize = gPointShadowAtlasRootSize;
+        PointAtlasDesc.uNumRootsX = 2;
+        PointAtlasDesc.uMinTileSize = gMinShadowTileSize;
+        m_PointAtlas.Reset( PointAtlasDesc );
+
+        CPUShadowAtlasDesc SpotAtlasDesc;
+        SpotAtlasDesc.uRootSize = gSpotShadowAtlasRootSize;
+        SpotAtlasDesc.uNumRootsX = 2;
+        SpotAtlasDesc.uMinTileSize = gMinShadowTileSize;
+        m_SpotAtlas.Reset( SpotAtlasDesc );
+
+        for ( int p = 0; p < MAX_NUM_SHADOWCASTING_POINTS; p++ )
+        {
+            for ( int i = 0; i < 6; i++ )
+            {
+                m_PointTiles[p][i] = m_PointAtlas.Allocate( gInitialShadowTileSize, false );
+            }
+        }
+
+        for ( int i = 0; i < MAX_NUM_SHADOWCASTING_SPOTS; i++ )
+        {
+            m_SpotTiles[i] = m_SpotAtlas.Allocate( gInitialShadowTileSize, false );
+        }
+
+        UpdateScaleOffsets();
     }
 
 
@@ -70,17 +113,54 @@ namespace TiledLighting11
     }
 
 
+    void ShadowRenderer::SetShadowCasters( const CPUFloat4* pCenters, const CPUFloat4* pExtents, unsigned uNumCasters )
+    {
+        m_PointCasterCuller.SetCasters( pCenters, pExtents, uNumCasters );
+        m_SpotCasterCuller.SetCasters( pCenters, pExtents, uNumCasters );
+        m_PointCache.Reset( uNumCasters );
+        m_SpotCache.Reset( uNumCasters );
+    }
+
+
+    void ShadowRenderer::SetShadowCasterDynamic( unsigned uCaster, bool bDynamic )
+    {
+        m_PointCache.SetCasterDynamic( uCaster, bDynamic );
+        m_SpotCache.SetCasterDynamic( uCaster, bDynamic );
+    }
+
+
+    void ShadowRenderer::InvalidateShadowCaster( unsigned uCaster )
+    {
+        m_PointCache.InvalidateCaster( uCaster );
+        m_SpotCache.InvalidateCaster( uCaster );
+    }
+
+
     HRESULT ShadowRenderer::OnCreateDevice( ID3D11Device* pd3dDevice )
     {
         HRESULT hr;
-        V_RETURN( AMD::CreateDepthStencilSurface( &m_pPointAtlasTexture, &m_pPointAtlasSRV, &m_pPointAtlasView, DXGI_FORMAT_D16_UNORM, DXGI_FORMAT_R16_UNORM, 6 * gPointShadowResolution, MAX_NUM_SHADOWCASTING_POINTS * gPointShadowResolution, 1 ) );
-        V_RETURN( AMD::CreateDepthStencilSurface( &m_pSpotAtlasTexture, &m_pSpotAtlasSRV, &m_pSpotAtlasView, DXGI_FORMAT_D16_UNORM, DXGI_FORMAT_R16_UNORM, MAX_NUM_SHADOWCASTING_SPOTS * gSpotShadowResolution, gSpotShadowResolution, 1 ) );
+        V_RETURN( AMD::CreateDepthStencilSurface( &m_pPointAtlasTexture, &m_pPointAtlasSRV, &m_pPointAtlasView, DXGI_FORMAT_D16_UNORM, DXGI_FORMAT_R16_UNORM, m_PointAtlas.GetWidth(), m_PointAtlas.GetHeight(), 1 ) );
+        V_RETURN( AMD::CreateDepthStencilSurface( &m_pSpotAtlasTexture, &m_pSpotAtlasSRV, &m_pSpotAtlasView, DXGI_FORMAT_D16_UNORM, DXGI_FORMAT_R16_UNORM, m_SpotAtlas.GetWidth(), m_SpotAtlas.GetHeight(), 1 ) );
+        V_RETURN( AMD::CreateDepthStencilSurface( &m_pPointStaticTexture, &m_pPointStaticSRV, &m_pPointStaticView, DXGI_FORMAT_D16_UNORM, DXGI_FORMAT_R16_UNORM, m_PointAtlas.GetWidth(), m_PointAtlas.GetHeight(), 1 ) );
+        V_RETURN( AMD::CreateDepthStencilSurface( &m_pSpotStaticTexture, &m_pSpotStaticSRV, &m_pSpotStaticView, DXGI_FORMAT_D16_UNORM, DXGI_FORMAT_R16_UNORM, m_SpotAtlas.GetWidth(), m_SpotAtlas.GetHeight(), 1 ) );
+
+        // new textures, so nothing is cached yet
+        m_PointCache.InvalidateAll();
+        m_SpotCache.InvalidateAll();
         return S_OK;
     }
 
 
     void ShadowRenderer::OnDestroyDevice()
     {
+        SAFE_RELEASE( m_pSpotStaticSRV );
+        SAFE_RELEASE( m_pSpotStaticView );
+        SAFE_RELEASE( m_pSpotStaticTexture );
+
+        SAFE_RELEASE( m_pPointStaticSRV );
+        SAFE_RELEASE( m_pPointStaticView );
+        SAFE_RELEASE( m_pPointStaticTexture );
+
         SAFE_RELEASE( m_pSpotAtlasSRV );
         SAFE_RELEASE( m_pSpotAtlasView );
         SAFE_RELEASE( m_pSpotAtlasTexture );
@@ -99,41 +179,261 @@ namespace TiledLighting11
     {
     }
 
-    void ShadowRenderer::RenderPointMap( int numShadowCastingPointLights )
+    void ShadowRenderer::UpdateScaleOffsets()
     {
-        AMDProfileEvent( AMD_PROFILE_RED, L"PointShadows" ); 
+        for ( int p = 0; p < MAX_NUM_SHADOWCASTING_POINTS; p++ )
+        {
+            for ( int i = 0; i < 6; i++ )
+            {
+                const CPUFloat4 ScaleOffset = m_PointAtlas.GetScaleOffset( m_PointTiles[p][i], gPointShadowBorder );
+                m_PointShadowScaleOffset[p][i] = XMFLOAT4( ScaleOffset.x, ScaleOffset.y, ScaleOffset.z, ScaleOffset.w );
+            }
+        }
+
+        for ( int i = 0; i < MAX_NUM_SHADOWCASTING_SPOTS; i++ )
+        {
+            const CPUFloat4 ScaleOffset = m_SpotAtlas.GetScaleOffset( m_SpotTiles[i], 0.0f );
+            m_SpotShadowScaleOffset[i] = XMFLOAT4( ScaleOffset.x, ScaleOffset.y, ScaleOffset.z, ScaleOffset.w );
+        }
+    }
+
 
+    bool ShadowRenderer::UpdateAtlasTiles( const XMMATRIX& mView, const XMMATRIX& mProj, unsigned uScreenHeight )
+    {
+        static_assert( sizeof(CPUMatrix) == sizeof(XMFLOAT4X4), "camera matrix layout" );
+        static_assert( sizeof(CPUFloat4) == sizeof(XMFLOAT4), "light position layout" );
+
+        CPUMatrix View, Proj;
+        XMStoreFloat4x4( (XMFLOAT4X4*)&View, mView );
+        XMStoreFloat4x4( (XMFLOAT4X4*)&Proj, mProj );
+
+        const CPUFloat4* pPointLights = (const CPUFloat4*)LightUtil::GetShadowCastingPointLightCenterAndRadiusArray();
+        const CPUFloat4* pSpotLights = (const CPUFloat4*)LightUtil::GetShadowCastingSpotLightCenterAndRadiusArray();
+
+        unsigned PointSizes[MAX_NUM_SHADOWCASTING_POINTS];
+        unsigned SpotSizes[MAX_NUM_SHADOWCASTING_SPOTS];
+        for ( int p = 0; p < MAX_NUM_SHADOWCASTING_POINTS; p++ )
+        {
+            float fDistance;
+            const float fCoverage = CPUShadowScheduler::GetScreenCoverage( View, Proj, pPointLights[p], fDistance );
+            const unsigned uCurrentSize = m_PointAtlas.GetTile( m_PointTiles[p][0] ).uSize;
+            PointSizes[p] = CPUShadowAtlas::GetTileSizeForCoverage( fCoverage, uScreenHeight, uCurrentSize, gMinShadowTileSize, gMaxPointShadowTileSize );
+        }
+        for ( int i = 0; i < MAX_NUM_SHADOWCASTING_SPOTS; i++ )
+        {
+            float fDistance;
+            const float fCoverage = CPUShadowScheduler::GetScreenCoverage( View, Proj, pSpotLights[i], fDistance );
+            const unsigned uCurrentSize = m_SpotAtlas.GetTile( m_SpotTiles[i] ).uSize;
+            SpotSizes[i] = CPUShadowAtlas::GetTileSizeForCoverage( fCoverage, uScreenHeight, uCurrentSize, gMinShadowTileSize, gMaxSpotShadowTileSize );
+        }
+
+        // shrink first, to make room for the tiles that grow; a tile that cannot grow
+        // as far as it wants grows as far as it can, and nothing else in the atlas moves
+        bool bChanged = false;
+        for ( int nPass = 0; nPass < 2; nPass++ )
+        {
+            const bool bGrow = ( nPass == 1 );
+
+            for ( int p = 0; p < MAX_NUM_SHADOWCASTING_POINTS; p++ )
+            {
+                for ( int i = 0; i < 6; i++ )
+                {
+                    const unsigned uCurrentSize = m_PointAtlas.GetTile( m_PointTiles[p][i] ).uSize;
+                    if ( PointSizes[p] != uCurrentSize && ( PointSizes[p] > uCurrentSize ) == bGrow )
+                    {
+                        const unsigned uTile = m_PointAtlas.Reallocate( m_PointTiles[p][i], PointSizes[p], true );
+                        bChanged = bChanged || ( uTile != m_PointTiles[p][i] );
+                        m_PointTiles[p][i] = uTile;
+                    }
+                }
+            }
+
+            for ( int i = 0; i < MAX_NUM_SHADOWCASTING_SPOTS; i++ )
+            {
+                const unsigned uCurrentSize = m_SpotAtlas.GetTile( m_SpotTiles[i] ).uSize;
+                if ( SpotSizes[i] != uCurrentSize && ( SpotSizes[i] > uCurrentSize ) == bGrow )
+                {
+                    const unsigned uTile = m_SpotAtlas.Reallocate( m_SpotTiles[i], SpotSizes[i], true );
+                    bChanged = bChanged || ( uTile != m_SpotTiles[i] );
+                    m_SpotTiles[i] = uTile;
+                }
+            }
+        }
+
+        if ( bChanged )
+        {
+            UpdateScaleOffsets();
+        }
+
+        return bChanged;
+    }
+
+
+    void ShadowRenderer::DrawTileQuad( const CommonUtil& CommonUtil, ID3D11ShaderResourceView* pStaticSRV )
+    {
         ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
 
-        D3D11_VIEWPORT oldVp[ 8 ];
-        UINT numVPs = 1;
-        pd3dImmediateContext->RSGetViewports( &numVPs, oldVp );
+        // the full-screen quad is at far depth, so without a copy to restore this clears the tile
+        UINT stride = 0;
+        UINT offset = 0;
+        ID3D11Buffer* pBuffer[1] = { NULL };
+        pd3dImmediateContext->IASetInputLayout( NULL );
+        pd3dImmediateContext->IASetVertexBuffers( 0, 1, pBuffer, &stride, &offset );
+        pd3dImmediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP );
+
+        pd3dImmediateContext->OMSetDepthStencilState( CommonUtil.GetDepthStencilState(DEPTH_STENCIL_STATE_DEPTH_ALWAYS), 0x00 );
+        pd3dImmediateContext->VSSetShader( CommonUtil.GetFullScreenVS(), NULL, 0 );
+        pd3dImmediateContext->PSSetShader( pStaticSRV ? CommonUtil.GetFullScreenDepthBlitPS() : NULL, NULL, 0 );
+        pd3dImmediateContext->PSSetShaderResources( 2, 1, &pStaticSRV );
+
+        pd3dImmediateContext->Draw( 3, 0 );
+    }
+
+
+    void ShadowRenderer::RenderCachedFaces( const CommonUtil& CommonUtil, CPUShadowCache& Cache, const CPUShadowCasterCuller& Culler, const CPUShadowAtlas& Atlas,
+        const unsigned* pTiles, const XMMATRIX* pViewProj, unsigned uNumLights, unsigned uNumFacesPerLight,
+        ID3D11DepthStencilView* pStaticView, ID3D11ShaderResourceView* pStaticSRV, ID3D11DepthStencilView* pAtlasView )
+    {
+        ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
+
+        const unsigned uNumFaces = uNumLights*uNumFacesPerLight;
+        CPUMatrix ViewProj[6*MAX_NUM_SHADOWCASTING_POINTS];
+        CPUShadowAtlasTile Tiles[6*MAX_NUM_SHADOWCASTING_POINTS];
+        assert( uNumFaces <= 6*MAX_NUM_SHADOWCASTING_POINTS );
+        for ( unsigned i = 0; i < uNumFaces; i++ )
+        {
+            XMStoreFloat4x4( (XMFLOAT4X4*)&ViewProj[i], pViewProj[i] );
+            Tiles[i] = Atlas.GetTile( pTiles[i] );
+        }
+
+        Cache.Update( Culler, ViewProj, Tiles, uNumLights, uNumFacesPerLight );
 
         D3D11_VIEWPORT vp;
-        vp.Width = gPointShadowResolution;
-        vp.Height = gPointShadowResolution;
         vp.MinDepth = 0.0f;
         vp.MaxDepth = 1.0f;
 
-        pd3dImmediateContext->ClearDepthStencilView( m_pPointAtlasView, D3D11_CLEAR_DEPTH, 1.0f, 0 );
-
         ID3D11RenderTargetView* pNULLRTV = NULL;
-        pd3dImmediateContext->OMSetRenderTargets( 1, &pNULLRTV, m_pPointAtlasView );
+        ID3D11ShaderResourceView* pNULLSRV = NULL;
 
-        const XMMATRIX (*PointLightViewProjArray)[6] = LightUtil::GetShadowCastingPointLightViewProjTransposedArray();
+        // the static copies that are out of date: clear the tile, then draw the static casters
+        pd3dImmediateContext->OMSetRenderTargets( 1, &pNULLRTV, pStaticView );
+        for ( unsigned i = 0; i < uNumFaces; i++ )
+        {
+            const unsigned uLight = i / uNumFacesPerLight;
+            const unsigned uFace = i % uNumFacesPerLight;
+            if ( !Cache.NeedsStaticRender( uLight, uFace ) )
+            {
+                continue;
+            }
+
+            vp.TopLeftX = (float)Tiles[i].uX;
+            vp.TopLeftY = (float)Tiles[i].uY;
+            vp.Width = (float)Tiles[i].uSize;
+            vp.Height = (float)Tiles[i].uSize;
+            pd3dImmediateContext->RSSetViewports( 1, &vp );
+
+            DrawTileQuad( CommonUtil, NULL );
+
+            unsigned uNumCasters = 0;
+            const unsigned* pCasters = Cache.GetStaticDrawList( uLight, uFace, uNumCasters );
+            if ( uNumCasters > 0 )
+            {
+                m_CameraCallback( pViewProj[i] );
+                m_RenderCallback( pCasters, uNumCasters );
+            }
+        }
 
-        for ( int p = 0; p < numShadowCastingPointLights; p++ )
+        // the shadow maps that are out of date: restore the static copy, then draw the dynamic casters
+        pd3dImmediateContext->OMSetRenderTargets( 1, &pNULLRTV, pAtlasView );
+        for ( unsigned i = 0; i < uNumFaces; i++ )
         {
-            vp.TopLeftY = (float)p * gPointShadowResolution;
+            const unsigned uLight = i / uNumFacesPerLight;
+            const unsigned uFace = i % uNumFacesPerLight;
+            if ( !Cache.NeedsComposite( uLight, uFace ) )
+            {
+                continue;
+            }
 
-            for ( int i = 0; i < 6; i++ )
+            vp.TopLeftX = (float)Tiles[i].uX;
+            vp.TopLeftY = (float)Tiles[i].uY;
+            vp.Width = (float)Tiles[i].uSize;
+            vp.Height = (float)Tiles[i].uSize;
+            pd3dImmediateContext->RSSetViewports( 1, &vp );
+
+            DrawTileQuad( CommonUtil, pStaticSRV );
+
+            unsigned uNumCasters = 0;
+            const unsigned* pCasters = Cache.GetDynamicDrawList( uLight, uFace, uNumCasters );
+            if ( uNumCasters > 0 )
             {
-                m_CameraCallback( PointLightViewProjArray[p][i] );
+                pd3dImmediateContext->PSSetShaderResources( 2, 1, &pNULLSRV );
+                m_CameraCallback( pViewProj[i] );
+                m_RenderCallback( pCasters, uNumCasters );
+            }
+        }
 
-                vp.TopLeftX = (float)i * gPointShadowResolution;
-                pd3dImmediateContext->RSSetViewports( 1, &vp );
+        pd3dImmediateContext->PSSetShaderResources( 2, 1, &pNULLSRV );
+    }
+
+
+    void ShadowRenderer::RenderPointMap( int numShadowCastingPointLights, const CommonUtil& CommonUtil )
+    {
+        AMDProfileEvent( AMD_PROFILE_RED, L"PointShadows" ); 
+
+        ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
+
+        D3D11_VIEWPORT oldVp[ 8 ];
+        UINT numVPs = 1;
+        pd3dImmediateContext->RSGetViewports( &numVPs, oldVp );
+
+        const XMMATRIX (*PointLightViewProjArray)[6] = LightUtil::GetShadowCastingPointLightViewProjTransposedArray();
 
-                m_RenderCallback();
+        if ( m_PointCasterCuller.GetNumCasters() > 0 )
+        {
+            // the casters inside each face's frustum, then the faces whose copies are out of date
+            XMFLOAT4 Planes[MAX_NUM_SHADOWCASTING_POINTS][6][6];
+            for ( int p = 0; p < numShadowCastingPointLights; p++ )
+            {
+                for ( int i = 0; i < 6; i++ )
+                {
+                    const XMMATRIX mViewProj = XMMatrixTranspose( PointLightViewProjArray[p][i] );
+                    AMD::ExtractPlanesFromFrustum( Planes[p][i], &mViewProj, false );
+                }
+            }
+
+            m_PointCasterCuller.CullCasters( (const CPUFloat4*)LightUtil::GetShadowCastingPointLightCenterAndRadiusArray(), (const CPUFloat4*)Planes,
+                (unsigned)numShadowCastingPointLights, 6, NULL );
+
+            RenderCachedFaces( CommonUtil, m_PointCache, m_PointCasterCuller, m_PointAtlas, &m_PointTiles[0][0], &PointLightViewProjArray[0][0],
+                (unsigned)numShadowCastingPointLights, 6, m_pPointStaticView, m_pPointStaticSRV, m_pPointAtlasView );
+        }
+        else
+        {
+            // without the casters' bounds, every face renders the whole scene
+            D3D11_VIEWPORT vp;
+            vp.MinDepth = 0.0f;
+            vp.MaxDepth = 1.0f;
+
+            pd3dImmediateContext->ClearDepthStencilView( m_pPointAtlasView, D3D11_CLEAR_DEPTH, 1.0f, 0 );
+
+            ID3D11RenderTargetView* pNULLRTV = NULL;
+            pd3dImmediateContext->OMSetRenderTargets( 1, &pNULLRTV, m_pPointAtlasView );
+
+            for ( int p = 0; p < numShadowCastingPointLights; p++ )
+            {
+                for ( int i = 0; i < 6; i++ )
+                {
+                    m_CameraCallback( PointLightViewProjArray[p][i] );
+
+                    const CPUShadowAtlasTile Tile = m_PointAtlas.GetTile( m_PointTiles[p][i] );
+                    vp.TopLeftX = (float)Tile.uX;
+                    vp.TopLeftY = (float)Tile.uY;
+                    vp.Width = (float)Tile.uSize;
+                    vp.Height = (float)Tile.uSize;
+                    pd3dImmediateContext->RSSetViewports( 1, &vp );
+
+                    m_RenderCallback( NULL, 0 );
+                }
             }
         }
 
@@ -141,7 +441,7 @@ namespace TiledLighting11
     }
 
 
-    void ShadowRenderer::RenderSpotMap( int numShadowCastingSpotLights )
+    void ShadowRenderer::RenderSpotMap( int numShadowCastingSpotLights, const CommonUtil& CommonUtil )
     {
         AMDProfileEvent( AMD_PROFILE_RED, L"SpotShadows" ); 
 
@@ -151,29 +451,50 @@ namespace TiledLighting11
         UINT numVPs = 1;
         pd3dImmediateContext->RSGetViewports( &numVPs, oldVp );
 
-        D3D11_VIEWPORT vp;
-        vp.Width = gSpotShadowResolution;
-        vp.Height = gSpotShadowResolution;
-        vp.MinDepth = 0.0f;
-        vp.MaxDepth = 1.0f;
-        vp.TopLeftY = 0.0f;
-
-        pd3dImmediateContext->ClearDepthStencilView( m_pSpotAtlasView, D3D11_CLEAR_DEPTH, 1.0f, 0 );
+        const XMMATRIX* SpotLightViewProjArray = LightUtil::GetShadowCastingSpotLightViewProjTransposedArray();
 
-        ID3D11RenderTargetView* pNULLRTV = NULL;
-        pd3dImmediateContext->OMSetRenderTargets( 1, &pNULLRTV, m_pSpotAtlasView );
+        if ( m_SpotCasterCuller.GetNumCasters() > 0 )
+        {
+            // the casters inside each spot light's frustum, then the lights whose copies are out of date
+            XMFLOAT4 Planes[MAX_NUM_SHADOWCASTING_SPOTS][6];
+            for ( int i = 0; i < numShadowCastingSpotLights; i++ )
+            {
+                const XMMATRIX mViewProj = XMMatrixTranspose( SpotLightViewProjArray[i] );
+                AMD::ExtractPlanesFromFrustum( Planes[i], &mViewProj, false );
+            }
 
-        const XMMATRIX* SpotLightViewProjArray = LightUtil::GetShadowCastingSpotLightViewProjTransposedArray();
+            m_SpotCasterCuller.CullCasters( (const CPUFloat4*)LightUtil::GetShadowCastingSpotLightCenterAndRadiusArray(), (const CPUFloat4*)Planes,
+                (unsigned)numShadowCastingSpotLights, 1, NULL );
 
-        for ( int i = 0; i < numShadowCastingSpotLights; i++ )
+            RenderCachedFaces( CommonUtil, m_SpotCache, m_SpotCasterCuller, m_SpotAtlas, m_SpotTiles, SpotLightViewProjArray,
+                (unsigned)numShadowCastingSpotLights, 1, m_pSpotStaticView, m_pSpotStaticSRV, m_pSpotAtlasView );
+        }
+        else
         {
-            vp.TopLeftX = (float)i * gSpotShadowResolution;
+            // without the casters' bounds, every spot light renders the whole scene
+            D3D11_VIEWPORT vp;
+            vp.MinDepth = 0.0f;
+            vp.MaxDepth = 1.0f;
 
-            m_CameraCallback( SpotLightViewProjArray[i] );
+            pd3dImmediateContext->ClearDepthStencilView( m_pSpotAtlasView, D3D11_CLEAR_DEPTH, 1.0f, 0 );
 
-            pd3dImmediateContext->RSSetViewports( 1, &vp );
+            ID3D11RenderTargetView* pNULLRTV = NULL;
+            pd3dImmediateContext->OMSetRenderTargets( 1, &pNULLRTV, m_pSpotAtlasView );
+
+            for ( int i = 0; i < numShadowCastingSpotLights; i++ )
+            {
+                const CPUShadowAtlasTile Tile = m_SpotAtlas.GetTile( m_SpotTiles[i] );
+                vp.TopLeftX = (float)Tile.uX;
+                vp.TopLeftY = (float)Tile.uY;
+                vp.Width = (float)Tile.uSize;
+                vp.Height = (float)Tile.uSize;
 
-            m_RenderCallback();
+                m_CameraCallback( SpotLightViewProjArray[i] );
+
+                pd3dImmediateContext->RSSetViewports( 1, &vp );
+
+                m_RenderCallback( NULL, 0 );
+            }
         }
 
         pd3dImmediateContext->RSSetViewports( 1, oldVp );
@@ -30,12 +30,18 @@
 
 #include "..\\..\\DXUT\\Core\\DXUT.h"
 #include "CommonConstants.h"
+#include "CPUShadowAtlas.h"
+#include "CPUShadowCache.h"
+#include "CPUShadowCasterCulling.h"
 
 
 namespace TiledLighting11
 {
+    class CommonUtil;
+
     typedef void (*UpdateCameraCallback)( const DirectX::XMMATRIX& mViewProj );
-    typedef void (*RenderSceneCallback)();
+    // Draws the casters in pCasters (numbered as in SetShadowCasters), or everything if pCasters is NULL
+    typedef void (*RenderSceneCallback)( const unsigned* pCasters, unsigned uNumCasters );
 
     class ShadowRenderer
     {
@@ -46,20 +52,53 @@ namespace TiledLighting11
 
         void SetCallbacks( UpdateCameraCallback cameraCallback, RenderSceneCallback renderCallback );
 
+        // Bounding boxes (centers and half extents) of the shadow casters. Each point light face
+        // and spot light then renders only the casters that can reach its shadow map; without
+        // them every pass renders the whole scene.
+        void SetShadowCasters( const CPUFloat4* pCenters, const CPUFloat4* pExtents, unsigned uNumCasters );
+
+        // With the casters known, each face keeps a copy of its static casters' depth, which is
+        // rendered again only when the light moves, the face's atlas tile changes, or a static
+        // caster in the face's frustum changes. Dynamic casters are drawn over the copy each time.
+        void SetShadowCasterDynamic( unsigned uCaster, bool bDynamic );
+        bool HasDynamicShadowCasters() const { return m_PointCache.GetNumDynamicCasters() > 0; }
+
+        // A static caster changed shape, moved, or was shown or hidden
+        void InvalidateShadowCaster( unsigned uCaster );
+
         // Various hook functions
         HRESULT OnCreateDevice( ID3D11Device* pd3dDevice );
         void OnDestroyDevice();
         HRESULT OnResizedSwapChain( ID3D11Device* pd3dDevice, const DXGI_SURFACE_DESC* pBackBufferSurfaceDesc );
         void OnReleasingSwapChain();
 
-        void RenderPointMap( int numShadowCastingPointLights );
-        void RenderSpotMap( int numShadowCastingSpotLights );
+        // Sizes the atlas tiles of the shadow-casting lights by their screen coverage.
+        // Returns true if any tile changed, after which the shadow maps must be rendered again.
+        bool UpdateAtlasTiles( const DirectX::XMMATRIX& mView, const DirectX::XMMATRIX& mProj, unsigned uScreenHeight );
+
+        void RenderPointMap( int numShadowCastingPointLights, const CommonUtil& CommonUtil );
+        void RenderSpotMap( int numShadowCastingSpotLights, const CommonUtil& CommonUtil );
+
+        // How the faces in the last RenderPointMap and RenderSpotMap used their static copies
+        const CPUShadowCacheStats& GetPointCacheStats() const { return m_PointCache.GetStats(); }
+        const CPUShadowCacheStats& GetSpotCacheStats() const { return m_SpotCache.GetStats(); }
+
+        // Texture coordinate scale (xy) and offset (zw) from a point light face or a spot light to its atlas tile
+        const DirectX::XMFLOAT4 (*GetPointShadowScaleOffsetArray() const)[6] { return m_PointShadowScaleOffset; }
+        const DirectX::XMFLOAT4* GetSpotShadowScaleOffsetArray() const { return m_SpotShadowScaleOffset; }
 
         ID3D11ShaderResourceView * const * GetPointAtlasSRVParam() const { return &m_pPointAtlasSRV; }
         ID3D11ShaderResourceView * const * GetSpotAtlasSRVParam() const { return &m_pSpotAtlasSRV; }
 
     private:
 
+        void UpdateScaleOffsets();
+
+        void RenderCachedFaces( const CommonUtil& CommonUtil, CPUShadowCache& Cache, const CPUShadowCasterCuller& Culler, const CPUShadowAtlas& Atlas,
+            const unsigned* pTiles, const DirectX::XMMATRIX* pViewProj, unsigned uNumLights, unsigned uNumFacesPerLight,
+            ID3D11DepthStencilView* pStaticView, ID3D11ShaderResourceView* pStaticSRV, ID3D11DepthStencilView* pAtlasView );
+        void DrawTileQuad( const CommonUtil& CommonUtil, ID3D11ShaderResourceView* pStaticSRV );
+
         UpdateCameraCallback        m_CameraCallback;
         RenderSceneCallback         m_RenderCallback;
 
@@ -70,6 +109,27 @@ namespace TiledLighting11
         ID3D11Texture2D*            m_pSpotAtlasTexture;
         ID3D11DepthStencilView*     m_pSpotAtlasView;
         ID3D11ShaderResourceView*   m_pSpotAtlasSRV;
+
+        // the static casters' copies, laid out the same as the atlases
+        ID3D11Texture2D*            m_pPointStaticTexture;
+        ID3D11DepthStencilView*     m_pPointStaticView;
+        ID3D11ShaderResourceView*   m_pPointStaticSRV;
+
+        ID3D11Texture2D*            m_pSpotStaticTexture;
+        ID3D11DepthStencilView*     m_pSpotStaticView;
+        ID3D11ShaderResourceView*   m_pSpotStaticSRV;
+
+        CPUShadowAtlas              m_PointAtlas;
+        CPUShadowAtlas              m_SpotAtlas;
+        unsigned                    m_PointTiles[MAX_NUM_SHADOWCASTING_POINTS][6];
+        unsigned                    m_SpotTiles[MAX_NUM_SHADOWCASTING_SPOTS];
+        DirectX::XMFLOAT4           m_PointShadowScaleOffset[MAX_NUM_SHADOWCASTING_POINTS][6];
+        DirectX::XMFLOAT4           m_SpotShadowScaleOffset[MAX_NUM_SHADOWCASTING_SPOTS];
+
+        CPUShadowCasterCuller       m_PointCasterCuller;
+        CPUShadowCasterCuller       m_SpotCasterCuller;
+        CPUShadowCache              m_PointCache;
+        CPUShadowCache              m_SpotCache;
     };
 
 } // namespace TiledLighting11
@@ -278,11 +278,11 @@ namespace TiledLighting11
         bool bDebugDrawingEnabled = ( CurrentGuiState.m_nDebugDrawType == DEBUG_DRAW_RADAR_COLORS ) || ( CurrentGuiState.m_nDebugDrawType == DEBUG_DRAW_GRAYSCALE );
 
         // Light culling compute shader
-        ID3D11ComputeShader* pLightCullCS = bDebugDrawingEnabled ? GetDebugDrawNumLightsPerTileCS( CurrentGuiState.m_uMSAASampleCount, CurrentGuiState.m_nDebugDrawType, bVPLsEnabled ) : GetLightCullAndShadeCS( CurrentGuiState.m_uMSAASampleCount, CurrentGuiState.m_nNumGBufferRenderTargets, bShadowsEnabled, bVPLsEnabled );
+        ID3D11ComputeShader* pLightCullCS = bDebugDrawingEnabled ? GetDebugDrawNumLightsPerTileCS( CurrentGuiState.m_uMSAASampleCount, CurrentGuiState.m_nDebugDrawType, bVPLsEnabled, CommonUtil.GetTileRes() ) : GetLightCullAndShadeCS( CurrentGuiState.m_uMSAASampleCount, CurrentGuiState.m_nNumGBufferRenderTargets, bShadowsEnabled, bVPLsEnabled, CommonUtil.GetTileRes() );
         ID3D11ShaderResourceView* pDepthSRV = DepthStencilBufferForOpaque.m_pDepthStencilSRV;
 
         // Light culling compute shader for transparent objects
-        ID3D11ComputeShader* pLightCullCSForTransparency = CommonUtil.GetLightCullCSForBlendedObjects(CurrentGuiState.m_uMSAASampleCount);
+        ID3D11ComputeShader* pLightCullCSForTransparency = CommonUtil.GetLightCullCSForBlendedObjects(CurrentGuiState.m_uMSAASampleCount, CommonUtil.GetTileRes());
         ID3D11ShaderResourceView* pDepthSRVForTransparency = DepthStencilBufferForTransparency.m_pDepthStencilSRV;
 
         // Switch off alpha blending
@@ -571,12 +571,13 @@ namespace TiledLighting11
             }
         }
 
-        AMD::ShaderCache::Macro ShaderMacroLightCullCS[5];
+        AMD::ShaderCache::Macro ShaderMacroLightCullCS[6];
         wcscpy_s( ShaderMacroLightCullCS[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILED_CULLING_COMPUTE_SHADER_MODE" );
         wcscpy_s( ShaderMacroLightCullCS[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"SHADOWS_ENABLED" );
         wcscpy_s( ShaderMacroLightCullCS[2].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"NUM_MSAA_SAMPLES" );
         wcscpy_s( ShaderMacroLightCullCS[3].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"NUM_GBUFFER_RTS" );
         wcscpy_s( ShaderMacroLightCullCS[4].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"LIGHTS_PER_TILE_MODE" );
+        wcscpy_s( ShaderMacroLightCullCS[5].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
 
         // Set LIGHTS_PER_TILE_MODE to 0 (lights per tile visualization disabled)
         ShaderMacroLightCullCS[4].m_iValue = 0;
@@ -602,8 +603,14 @@ namespace TiledLighting11
                         // set NUM_GBUFFER_RTS
                         ShaderMacroLightCullCS[3].m_iValue = m;
 
-                        pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pLightCullAndShadeCS[2*NUM_MSAA_SETTINGS*(MAX_NUM_GBUFFER_RENDER_TARGETS-1)*i + NUM_MSAA_SETTINGS*(MAX_NUM_GBUFFER_RENDER_TARGETS-1)*j + (MAX_NUM_GBUFFER_RENDER_TARGETS-1)*k + m-2], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsAndDoLightingCS",
-                            L"TilingDeferred.hlsl", 5, ShaderMacroLightCullCS, NULL, NULL, 0 );
+                        for( int n = 0; n < NUM_TILE_RES_SETTINGS; n++ )
+                        {
+                            // set TILE_RES
+                            ShaderMacroLightCullCS[5].m_iValue = g_nTileRes[n];
+
+                            pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pLightCullAndShadeCS[NUM_TILE_RES_SETTINGS*(2*NUM_MSAA_SETTINGS*(MAX_NUM_GBUFFER_RENDER_TARGETS-1)*i + NUM_MSAA_SETTINGS*(MAX_NUM_GBUFFER_RENDER_TARGETS-1)*j + (MAX_NUM_GBUFFER_RENDER_TARGETS-1)*k + m-2) + n], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsAndDoLightingCS",
+                                L"TilingDeferred.hlsl", 6, ShaderMacroLightCullCS, NULL, NULL, 0 );
+                        }
                     }
                 }
             }
@@ -631,17 +638,23 @@ namespace TiledLighting11
                     // set NUM_MSAA_SAMPLES
                     ShaderMacroLightCullCS[2].m_iValue = g_nMSAASampleCount[k];
 
-                    pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pDebugDrawNumLightsPerTileCS[2*NUM_MSAA_SETTINGS*i + NUM_MSAA_SETTINGS*j + k], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsAndDoLightingCS",
-                        L"TilingDeferred.hlsl", 5, ShaderMacroLightCullCS, NULL, NULL, 0 );
+                    for( int n = 0; n < NUM_TILE_RES_SETTINGS; n++ )
+                    {
+                        // set TILE_RES
+                        ShaderMacroLightCullCS[5].m_iValue = g_nTileRes[n];
+
+                        pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pDebugDrawNumLightsPerTileCS[NUM_TILE_RES_SETTINGS*(2*NUM_MSAA_SETTINGS*i + NUM_MSAA_SETTINGS*j + k) + n], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsAndDoLightingCS",
+                            L"TilingDeferred.hlsl", 6, ShaderMacroLightCullCS, NULL, NULL, 0 );
+                    }
                 }
             }
         }
     }
 
     //--------------------------------------------------------------------------------------
-    // Return one of the light culling and shading compute shaders, based on MSAA settings
+    // Return one of the light culling and shading compute shaders, based on MSAA settings and tile size
     //--------------------------------------------------------------------------------------
-    ID3D11ComputeShader * TiledDeferredUtil::GetLightCullAndShadeCS( unsigned uMSAASampleCount, int nNumGBufferRenderTargets, bool bShadowsEnabled, bool bVPLsEnabled ) const
+    ID3D11ComputeShader * TiledDeferredUtil::GetLightCullAndShadeCS( unsigned uMSAASampleCount, int nNumGBufferRenderTargets, bool bShadowsEnabled, bool bVPLsEnabled, unsigned uTileRes ) const
     {
         const int nIndexMultiplierShadows = bShadowsEnabled ? 1 : 0;
         const int nIndexMultiplierVPLs = bVPLsEnabled ? 1 : 0;
@@ -655,13 +668,13 @@ namespace TiledLighting11
         default: assert(false); break;
         }
 
-        return m_pLightCullAndShadeCS[(2*NUM_MSAA_SETTINGS*(MAX_NUM_GBUFFER_RENDER_TARGETS-1)*nIndexMultiplierVPLs) + (NUM_MSAA_SETTINGS*(MAX_NUM_GBUFFER_RENDER_TARGETS-1)*nIndexMultiplierShadows) + ((MAX_NUM_GBUFFER_RENDER_TARGETS-1)*nMSAAMode) + (nNumGBufferRenderTargets-2)];
+        return m_pLightCullAndShadeCS[NUM_TILE_RES_SETTINGS*((2*NUM_MSAA_SETTINGS*(MAX_NUM_GBUFFER_RENDER_TARGETS-1)*nIndexMultiplierVPLs) + (NUM_MSAA_SETTINGS*(MAX_NUM_GBUFFER_RENDER_TARGETS-1)*nIndexMultiplierShadows) + ((MAX_NUM_GBUFFER_RENDER_TARGETS-1)*nMSAAMode) + (nNumGBufferRenderTargets-2)) + GetTileResSetting( uTileRes )];
     }
 
     //--------------------------------------------------------------------------------------
-    // Return one of the lights-per-tile visualization compute shaders, based on MSAA settings
+    // Return one of the lights-per-tile visualization compute shaders, based on MSAA settings and tile size
     //--------------------------------------------------------------------------------------
-    ID3D11ComputeShader * TiledDeferredUtil::GetDebugDrawNumLightsPerTileCS( unsigned uMSAASampleCount, int nDebugDrawType, bool bVPLsEnabled ) const
+    ID3D11ComputeShader * TiledDeferredUtil::GetDebugDrawNumLightsPerTileCS( unsigned uMSAASampleCount, int nDebugDrawType, bool bVPLsEnabled, unsigned uTileRes ) const
     {
         if ( ( nDebugDrawType != DEBUG_DRAW_RADAR_COLORS ) && ( nDebugDrawType != DEBUG_DRAW_GRAYSCALE ) )
         {
@@ -680,7 +693,7 @@ namespace TiledLighting11
         default: assert(false); break;
         }
 
-        return m_pDebugDrawNumLightsPerTileCS[(2*NUM_MSAA_SETTINGS*nIndexMultiplierVPLs) + (NUM_MSAA_SETTINGS*nIndexMultiplierDebugDrawType) + nMSAAMode];
+        return m_pDebugDrawNumLightsPerTileCS[NUM_TILE_RES_SETTINGS*((2*NUM_MSAA_SETTINGS*nIndexMultiplierVPLs) + (NUM_MSAA_SETTINGS*nIndexMultiplierDebugDrawType) + nMSAAMode) + GetTileResSetting( uTileRes )];
     }
 
 } // namespace TiledLighting11
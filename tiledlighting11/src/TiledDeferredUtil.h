@@ -68,8 +68,8 @@ namespace TiledLighting11
         void OnRender( float fElapsedTime, const GuiState& CurrentGuiState, const DepthStencilBuffer& DepthStencilBufferForOpaque, const DepthStencilBuffer& DepthStencilBufferForTransparency, const Scene& Scene, const CommonUtil& CommonUtil, const LightUtil& LightUtil, const ShadowRenderer& ShadowRenderer, const RSMRenderer& RSMRenderer );
 
     private:
-        ID3D11ComputeShader * GetLightCullAndShadeCS( unsigned uMSAASampleCount, int nNumGBufferRenderTargets, bool bShadowsEnabled, bool bVPLsEnabled ) const;
-        ID3D11ComputeShader * GetDebugDrawNumLightsPerTileCS( unsigned uMSAASampleCount, int nDebugDrawType, bool bVPLsEnabled ) const;
+        ID3D11ComputeShader * GetLightCullAndShadeCS( unsigned uMSAASampleCount, int nNumGBufferRenderTargets, bool bShadowsEnabled, bool bVPLsEnabled, unsigned uTileRes ) const;
+        ID3D11ComputeShader * GetDebugDrawNumLightsPerTileCS( unsigned uMSAASampleCount, int nDebugDrawType, bool bVPLsEnabled, unsigned uTileRes ) const;
 
     private:
         // G-Buffer
@@ -90,13 +90,13 @@ namespace TiledLighting11
         ID3D11InputLayout*          m_pLayoutDeferredBuildGBuffer11;
 
         // compute shaders for tiled culling and shading
-        static const int NUM_DEFERRED_LIGHTING_COMPUTE_SHADERS = 2*2*NUM_MSAA_SETTINGS*(MAX_NUM_GBUFFER_RENDER_TARGETS-1);
+        static const int NUM_DEFERRED_LIGHTING_COMPUTE_SHADERS = 2*2*NUM_MSAA_SETTINGS*(MAX_NUM_GBUFFER_RENDER_TARGETS-1)*NUM_TILE_RES_SETTINGS;
         ID3D11ComputeShader*        m_pLightCullAndShadeCS[NUM_DEFERRED_LIGHTING_COMPUTE_SHADERS];
 
         // debug draw shaders for the lights-per-tile visualization modes
-        static const int NUM_DEBUG_DRAW_COMPUTE_SHADERS = 2*2*NUM_MSAA_SETTINGS;  // one for each MSAA setting,
-                                                                                  // times 2 for VPL on/off,
-                                                                                  // times 2 for radar vs. grayscale
+        static const int NUM_DEBUG_DRAW_COMPUTE_SHADERS = 2*2*NUM_MSAA_SETTINGS*NUM_TILE_RES_SETTINGS;  // one for each MSAA setting and tile size,
+                                                                                                        // times 2 for VPL on/off,
+                                                                                                        // times 2 for radar vs. grayscale
         ID3D11ComputeShader*        m_pDebugDrawNumLightsPerTileCS[NUM_DEBUG_DRAW_COMPUTE_SHADERS];
 
         // state for Tiled Deferred
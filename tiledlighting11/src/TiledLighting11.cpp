@@ -48,6 +48,10 @@
 #include "TiledDeferredUtil.h"
 #include "ShadowRenderer.h"
 #include "RSMRenderer.h"
+#include "CPUBenchmark.h"
+#include "CPULightListTelemetry.h"
+
+#include <algorithm>
 
 #pragma warning( disable : 4100 ) // disable unreference formal parameter warnings for /W4 builds
 
@@ -117,9 +121,20 @@ static AMD::Slider*         g_VPLBrightnessCutOffSlider = 0;
 
 // Current lighting mode
 static LightingMode         g_LightingMode = LIGHTING_SHADOWS;
+static int                  g_TileResSetting = TILE_RES_SETTING_16;
+
+// Per-frame light list telemetry, appended to these files while recording
+static FILE*                g_pLightListCSV = NULL;
+static FILE*                g_pLightListJSON = NULL;
+static unsigned             g_uLightListFrame = 0;
 static int					g_UpdateShadowMap = 4;
 static int					g_UpdateRSMs = 4;
 
+// Light set files from the command line (-lightset:, -shadowlightset: and -exportlightsets:)
+static std::string          g_LightSetPath;
+static std::string          g_ShadowLightSetPath;
+static std::string          g_ExportLightSetsPath;
+
 // The max distance the camera can travel
 static float                g_fMaxDistance = 500.0f;
 
@@ -164,7 +179,7 @@ struct CB_PER_FRAME
     float    m_fVPLRemoveBackFaceContrib;
     float    m_fVPLColorThreshold;
     float    m_fVPLBrightnessThreshold;
-    float    m_fPerFramePad1;
+    unsigned m_uTileRes;
     float    m_fPerFramePad2;
 };
 
@@ -173,6 +188,8 @@ struct CB_SHADOW_CONSTANTS
     XMMATRIX m_mPointShadowViewProj[ MAX_NUM_SHADOWCASTING_POINTS ][ 6 ];
     XMMATRIX m_mSpotShadowViewProj[ MAX_NUM_SHADOWCASTING_SPOTS ];
     XMVECTOR m_ShadowBias;
+    XMFLOAT4 m_PointShadowScaleOffset[ MAX_NUM_SHADOWCASTING_POINTS ][ 6 ];
+    XMFLOAT4 m_SpotShadowScaleOffset[ MAX_NUM_SHADOWCASTING_SPOTS ];
 };
 #pragma pack(pop)
 
@@ -212,6 +229,7 @@ enum
     IDC_RADIOBUTTON_FORWARD_PLUS,
     IDC_RADIOBUTTON_TILED_DEFERRED,
     IDC_CHECKBOX_ENABLE_LIGHT_DRAWING,
+    IDC_CHECKBOX_ANIMATE_LIGHTS,
     IDC_SLIDER_NUM_POINT_LIGHTS,
     IDC_SLIDER_NUM_SPOT_LIGHTS,
     IDC_CHECKBOX_ENABLE_TRANSPARENT_OBJECTS,
@@ -222,6 +240,8 @@ enum
     IDC_CHECKBOX_ENABLE_DEBUG_DRAWING,
     IDC_RADIOBUTTON_DEBUG_DRAWING_ONE,
     IDC_RADIOBUTTON_DEBUG_DRAWING_TWO,
+    IDC_COMBO_TILE_RES,
+    IDC_CHECKBOX_RECORD_LIGHT_LIST_STATS,
     IDC_STATIC_TRIANGLE_DENSITY,
     IDC_SLIDER_TRIANGLE_DENSITY,
     IDC_SLIDER_NUM_GRID_OBJECTS,
@@ -262,8 +282,11 @@ void ClearD3D11DeviceContext();
 void UpdateShadowConstants();
 void UpdateCameraConstantBuffer( const XMMATRIX& mViewProjAlreadyTransposed );
 void UpdateCameraConstantBufferWithTranspose( const XMMATRIX& mViewProj );
-void RenderDepthOnlyScene();
+void RenderDepthOnlyScene( const unsigned* pCasters, unsigned uNumCasters );
+void InvalidateGridObjectShadows( int nFirst, int nEnd );
 void UpdateUI();
+void StartLightListRecording();
+void StopLightListRecording();
 
 //--------------------------------------------------------------------------------------
 // Entry point to the program. Initializes everything and goes into a message processing 
@@ -276,6 +299,17 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
     _CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+    // Headless CPU benchmark, no window or device
+    CPUBenchmarkConfig BenchmarkConfig;
+    if( ParseCPUBenchmarkCommandLine( lpCmdLine, BenchmarkConfig ) )
+    {
+        return RunCPUBenchmark( BenchmarkConfig );
+    }
+
+    GetCommandLineOption( lpCmdLine, L"lightset", g_LightSetPath );
+    GetCommandLineOption( lpCmdLine, L"shadowlightset", g_ShadowLightSetPath );
+    GetCommandLineOption( lpCmdLine, L"exportlightsets", g_ExportLightSetsPath );
+
     // Set DXUT callbacks
     DXUTSetCallbackMsgProc( MsgProc );
     DXUTSetCallbackKeyboard( OnKeyboard );
@@ -302,6 +336,8 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
     // Ensure the ShaderCache aborts if in a lengthy generation process
     g_ShaderCache.Abort();
 
+    StopLightListRecording();
+
     return DXUTGetExitCode();
 }
 
@@ -347,6 +383,7 @@ void InitApp()
     iY += AMD::HUD::iGroupDelta;
 
     g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_DRAWING, L"Show Lights", AMD::HUD::iElementOffset, iY, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, true );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ANIMATE_LIGHTS, L"Animate Lights", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
 
     // CDXUTDialog g_HUD.m_GUI will clean up these allocations in the CDXUTDialog destructor (see CDXUTDialog::RemoveAllControls)
     g_NumPointLightsSlider = new AMD::Slider( g_HUD.m_GUI, IDC_SLIDER_NUM_POINT_LIGHTS, iY, L"Active Point Lights", 0, MAX_NUM_LIGHTS, g_iNumActivePointLights );
@@ -374,6 +411,23 @@ void InitApp()
 
     iY += AMD::HUD::iGroupDelta;
 
+    g_HUD.m_GUI.AddComboBox( IDC_COMBO_TILE_RES, AMD::HUD::iElementOffset, iY, AMD::HUD::iElementWidth + 20, AMD::HUD::iElementHeight );
+    pComboBox = g_HUD.m_GUI.GetComboBox( IDC_COMBO_TILE_RES );
+    if( pComboBox )
+    {
+        pComboBox->SetDropHeight( 40 );
+        pComboBox->AddItem( L"8x8 Tiles", NULL );
+        pComboBox->AddItem( L"16x16 Tiles", NULL );
+        pComboBox->AddItem( L"32x32 Tiles", NULL );
+        pComboBox->SetSelectedByIndex( g_TileResSetting );
+    }
+
+    // reads the index buffers back (Forward+ only) through a ring of staging copies that is
+    // never waited on, so the stats are a few frames late and skip frames when the ring is full
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_RECORD_LIGHT_LIST_STATS, L"Record Light List Stats", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
+
+    iY += AMD::HUD::iGroupDelta;
+
     // Use a standard DXUT slider here (not AMD::Slider), since we display a word for the slider value ("Low", "Med", "High") instead of a number
     wcscpy_s( szTemp, 256, L"Triangle Density: " );
     wcscat_s( szTemp, 256, g_szTriangleDensityLabel[g_iTriangleDensity] );
@@ -486,6 +540,32 @@ void RenderText()
         fGpuPerfStat2 = fGpuTimeForwardTransparency;
     }
 
+    if( g_CurrentGuiState.m_nLightingMode == LIGHTING_SHADOWS )
+    {
+        // the shadow maps are not part of the total, and only render when something changed
+        const float fGpuTimeShadowMaps = (float)TIMER_GetTime( Gpu, L"Shadow maps" ) * 1000.0f;
+        swprintf_s( szFormat, 256, L"Shadow maps:     %s", szPrecision );
+        swprintf_s( szBuf, 256, szFormat, fGpuTimeShadowMaps );
+        g_pTxtHelper->DrawTextLine( szBuf );
+
+        const CPUShadowCacheStats& PointCacheStats = g_ShadowRenderer.GetPointCacheStats();
+        const CPUShadowCacheStats& SpotCacheStats = g_ShadowRenderer.GetSpotCacheStats();
+        const unsigned long long uLookups = PointCacheStats.uTotalLookups + SpotCacheStats.uTotalLookups;
+        const unsigned long long uHits = PointCacheStats.uTotalHits + SpotCacheStats.uTotalHits;
+        swprintf_s( szBuf, 256, L"Shadow cache: %u of %u faces reused, %.1f%% overall", PointCacheStats.uNumHits + SpotCacheStats.uNumHits,
+            PointCacheStats.uNumFaces + SpotCacheStats.uNumFaces, uLookups ? 100.0*uHits / uLookups : 0.0 );
+        g_pTxtHelper->DrawTextLine( szBuf );
+
+        if( g_CurrentGuiState.m_bVPLsEnabled )
+        {
+            // read back without waiting, so it is a few frames old
+            unsigned uAge;
+            const int nNumVPLs = g_RSMRenderer.ReadbackNumVPLs( &uAge );
+            swprintf_s( szBuf, 256, L"VPLs: %d (%u frames ago)", nNumVPLs, uAge );
+            g_pTxtHelper->DrawTextLine( szBuf );
+        }
+    }
+
     g_pTxtHelper->SetInsertionPos( 5, DXUTGetDXGIBackBufferSurfaceDesc()->Height - AMD::HUD::iElementDelta );
     g_pTxtHelper->DrawTextLine( L"Toggle GUI    : F1" );
 
@@ -544,6 +624,13 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
     // And the camera
     g_Scene.m_pCamera = &g_Camera;
 
+    // The shadow casters' bounds, so that each shadow map pass only draws what it can see
+    {
+        std::vector<CPUFloat4> CasterCenters, CasterExtents;
+        ForwardPlusUtil::CalculateShadowCasterBounds( g_Scene, CasterCenters, CasterExtents );
+        g_ShadowRenderer.SetShadowCasters( CasterCenters.empty() ? NULL : &CasterCenters[0], CasterCenters.empty() ? NULL : &CasterExtents[0], (unsigned)CasterCenters.size() );
+    }
+
     // Create constant buffers
     D3D11_BUFFER_DESC CBDesc;
     ZeroMemory( &CBDesc, sizeof(CBDesc) );
@@ -597,6 +684,35 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
 
         // Init light buffer data
         LightUtil::InitLights( SceneMin, SceneMax );
+
+        // Write the generated lights before any are replaced, then load the light set files
+        if( !g_ExportLightSetsPath.empty() )
+        {
+            const std::string RandomPath = g_ExportLightSetsPath + "_random.lightset";
+            const std::string ShadowPath = g_ExportLightSetsPath + "_shadow.lightset";
+            if( LightUtil::ExportLightSets( RandomPath.c_str(), ShadowPath.c_str() ) != CPU_LIGHT_SET_OK )
+            {
+                DXUTOutputDebugString( L"Failed to export the light sets\n" );
+            }
+        }
+
+        if( !g_LightSetPath.empty() )
+        {
+            const CPULightSetResult Result = LightUtil::LoadLightSet( g_LightSetPath.c_str(), false );
+            if( Result != CPU_LIGHT_SET_OK )
+            {
+                DXUTOutputDebugString( L"Failed to load the light set: %S\n", GetCPULightSetResultName( Result ) );
+            }
+        }
+
+        if( !g_ShadowLightSetPath.empty() )
+        {
+            const CPULightSetResult Result = LightUtil::LoadLightSet( g_ShadowLightSetPath.c_str(), true );
+            if( Result != CPU_LIGHT_SET_OK )
+            {
+                DXUTOutputDebugString( L"Failed to load the shadow-casting light set: %S\n", GetCPULightSetResultName( Result ) );
+            }
+        }
     }
 
     // Create helper resources here
@@ -692,6 +808,28 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
     // Check GUI state for lighting mode
     g_CurrentGuiState.m_nLightingMode = g_HUD.m_GUI.GetComboBox( IDC_COMBO_LIGHTING_MODE )->GetSelectedIndex();
 
+    // Animate the random lights (on this thread, as 2*MAX_NUM_LIGHTS lights only take tens of microseconds)
+    if( g_CurrentGuiState.m_nLightingMode == LIGHTING_RANDOM && g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ANIMATE_LIGHTS )->GetChecked() )
+    {
+        g_LightUtil.AnimateLights( (float)fTime, NULL );
+    }
+
+    // Upload the lights that were added, removed or changed since the last frame. Lights can
+    // have been removed from the pools, so there may be fewer than the sliders ask for.
+    g_LightUtil.UpdateLightBuffers( pd3dImmediateContext );
+
+    // Shadow-casting lights that moved need their shadow maps and RSMs rendered again
+    if( g_LightUtil.UpdateShadowCastingLights( pd3dImmediateContext ) )
+    {
+        g_UpdateShadowMap = std::max( g_UpdateShadowMap, 1 );
+        g_UpdateRSMs = std::max( g_UpdateRSMs, 1 );
+    }
+    if( g_CurrentGuiState.m_nLightingMode == LIGHTING_RANDOM )
+    {
+        g_CurrentGuiState.m_uNumPointLights = std::min( g_CurrentGuiState.m_uNumPointLights, g_LightUtil.GetNumPointLights() );
+        g_CurrentGuiState.m_uNumSpotLights = std::min( g_CurrentGuiState.m_uNumSpotLights, g_LightUtil.GetNumSpotLights() );
+    }
+
     // Check GUI state for debug drawing
     bool bDebugDrawingEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEBUG_DRAWING )->GetEnabled() &&
             g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEBUG_DRAWING )->GetChecked();
@@ -781,8 +919,8 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
     pPerFrame->m_AmbientColorUp = XMVectorSet( 0.013f, 0.015f, 0.050f, 1.0f );
     pPerFrame->m_AmbientColorDown = XMVectorSet( 0.0013f, 0.0015f, 0.0050f, 1.0f );
     pPerFrame->m_vCameraPosAndAlphaTest = XMLoadFloat4( &CameraPosAndAlphaTest );
-    pPerFrame->m_uNumLights = (unsigned)g_iNumActivePointLights;
-    pPerFrame->m_uNumSpotLights = (unsigned)g_iNumActiveSpotLights;
+    pPerFrame->m_uNumLights = g_CurrentGuiState.m_uNumPointLights;
+    pPerFrame->m_uNumSpotLights = g_CurrentGuiState.m_uNumSpotLights;
     pPerFrame->m_uWindowWidth = BackBufferDesc->Width;
     pPerFrame->m_uWindowHeight = BackBufferDesc->Height;
     pPerFrame->m_uMaxNumLightsPerTile = g_CommonUtil.GetMaxNumLightsPerTile();
@@ -799,7 +937,7 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
     pPerFrame->m_fVPLRemoveBackFaceContrib = 1.0f * ( (float)g_VPLBackFace / 100.0f );
     pPerFrame->m_fVPLColorThreshold = 1.0f * ( (float)g_VPLThreshold / 100.0f );
     pPerFrame->m_fVPLBrightnessThreshold = 0.01f * ( (float)g_VPLBrightnessCutOff / 100.0f );
-    pPerFrame->m_fPerFramePad1 = 0.0f;
+    pPerFrame->m_uTileRes = g_CommonUtil.GetTileRes();
     pPerFrame->m_fPerFramePad2 = 0.0f;
     pd3dImmediateContext->Unmap( g_pcbPerFrame11, 0 );
     pd3dImmediateContext->VSSetConstantBuffers( 2, 1, &g_pcbPerFrame11 );
@@ -815,7 +953,11 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
     pd3dImmediateContext->PSSetConstantBuffers( 0, 1, &g_pcbPerObject11 );
     pd3dImmediateContext->CSSetConstantBuffers( 0, 1, &g_pcbPerObject11 );
 
-    // shadow constants
+    // shadow constants, after moving the shadow-casting lights' atlas tiles to the tiers their screen sizes ask for
+    if( g_ShadowRenderer.UpdateAtlasTiles( mView, mProj, BackBufferDesc->Height ) )
+    {
+        g_UpdateShadowMap = std::max( g_UpdateShadowMap, 1 );
+    }
     UpdateShadowConstants();
 
     bool bForwardPlus = g_HUD.m_GUI.GetRadioButton( IDC_RADIOBUTTON_FORWARD_PLUS )->GetEnabled() &&
@@ -824,15 +966,19 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
     // Render objects here...
     if( g_ShaderCache.ShadersReady() )
     {
-        if ( g_CurrentGuiState.m_nLightingMode == LIGHTING_SHADOWS && g_UpdateShadowMap > 0 )
+        // only the faces whose static casters' copies are out of date render them again,
+        // but dynamic casters are drawn over the copies every frame
+        if ( g_CurrentGuiState.m_nLightingMode == LIGHTING_SHADOWS && ( g_UpdateShadowMap > 0 || g_ShadowRenderer.HasDynamicShadowCasters() ) )
         {
-            g_ShadowRenderer.RenderPointMap( MAX_NUM_SHADOWCASTING_POINTS );
-            g_ShadowRenderer.RenderSpotMap( MAX_NUM_SHADOWCASTING_SPOTS );
+            TIMER_Begin( 0, L"Shadow maps" );
+            g_ShadowRenderer.RenderPointMap( MAX_NUM_SHADOWCASTING_POINTS, g_CommonUtil );
+            g_ShadowRenderer.RenderSpotMap( MAX_NUM_SHADOWCASTING_SPOTS, g_CommonUtil );
+            TIMER_End(); // Shadow maps
 
             // restore main camera viewProj
             UpdateCameraConstantBufferWithTranspose( mViewProjection );
 
-            g_UpdateShadowMap--;
+            g_UpdateShadowMap = std::max( g_UpdateShadowMap - 1, 0 );
         }
 
         if ( g_CurrentGuiState.m_nLightingMode == LIGHTING_SHADOWS && g_CurrentGuiState.m_bVPLsEnabled )
@@ -862,6 +1008,19 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
             g_TiledDeferredUtil.OnRender( fElapsedTime, g_CurrentGuiState, g_DepthStencilBuffer, g_DepthStencilBufferForTransparency, g_Scene, g_CommonUtil, g_LightUtil, g_ShadowRenderer, g_RSMRenderer );
         }
 
+        // the Forward+ light culling leaves its lists in the index buffers
+        if( bForwardPlus && g_pLightListCSV != NULL )
+        {
+            // the readback arrives a few frames later, numbered by the frame it was started in
+            CPULightListTelemetry Telemetry;
+            bool bVPLsEnabled = ( g_CurrentGuiState.m_nLightingMode == LIGHTING_SHADOWS && g_CurrentGuiState.m_bVPLsEnabled );
+            if( g_CommonUtil.GatherLightListTelemetry( pd3dDevice, g_uLightListFrame++, bVPLsEnabled, Telemetry ) == S_OK )
+            {
+                WriteLightListTelemetryCSV( g_pLightListCSV, Telemetry );
+                WriteLightListTelemetryJSON( g_pLightListJSON, Telemetry );
+            }
+        }
+
         TIMER_End(); // Render
 	}
 
@@ -1130,6 +1289,32 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
                 }
             }
             break;
+        case IDC_COMBO_TILE_RES:
+            {
+                const int nPreviousTileResSetting = g_TileResSetting;
+                g_TileResSetting = ((CDXUTComboBox*)pControl)->GetSelectedIndex();
+
+                // recreates the per-tile index buffers if the tile size actually changed,
+                // and keeps the previous tile size if that fails
+                if( FAILED( g_CommonUtil.SetTileRes( DXUTGetD3D11Device(), g_nTileRes[g_TileResSetting] ) ) )
+                {
+                    g_TileResSetting = nPreviousTileResSetting;
+                    ((CDXUTComboBox*)pControl)->SetSelectedByIndex( g_TileResSetting );
+                }
+            }
+            break;
+        case IDC_CHECKBOX_RECORD_LIGHT_LIST_STATS:
+            {
+                if( ((CDXUTCheckBox*)pControl)->GetChecked() )
+                {
+                    StartLightListRecording();
+                }
+                else
+                {
+                    StopLightListRecording();
+                }
+            }
+            break;
         case IDC_RADIOBUTTON_FORWARD_PLUS:
         case IDC_RADIOBUTTON_TILED_DEFERRED:
             {
@@ -1165,10 +1350,12 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
             break;
         case IDC_SLIDER_VPL_THRESHOLD_COLOR:
             g_VPLThresholdSlider->OnGuiEvent();
+            g_RSMRenderer.InvalidateVPLs();
             break;
 
         case IDC_SLIDER_VPL_THRESHOLD_BRIGHTNESS:
             g_VPLBrightnessCutOffSlider->OnGuiEvent();
+            g_RSMRenderer.InvalidateVPLs();
             break;
         case IDC_CHECKBOX_ENABLE_DEBUG_DRAWING:
             {
@@ -1181,7 +1368,14 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
         case IDC_SLIDER_TRIANGLE_DENSITY:
             {
                 // update
+                const int nPreviousTriangleDensity = g_iTriangleDensity;
                 g_iTriangleDensity = ((CDXUTSlider*)pControl)->GetValue();
+                if ( g_iTriangleDensity != nPreviousTriangleDensity )
+                {
+                    // every grid object casts a different shadow
+                    InvalidateGridObjectShadows( 0, MAX_NUM_GRID_OBJECTS );
+                    g_UpdateShadowMap = std::max( g_UpdateShadowMap, 1 );
+                }
                 wcscpy_s( szTemp, 256, L"Triangle Density: " );
                 wcscat_s( szTemp, 256, g_szTriangleDensityLabel[g_iTriangleDensity] );
                 g_HUD.m_GUI.GetStatic( IDC_STATIC_TRIANGLE_DENSITY )->SetText( szTemp );
@@ -1190,8 +1384,12 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
         case IDC_SLIDER_NUM_GRID_OBJECTS:
             {
                 // update slider
+                const int nPreviousNumGridObjects = g_iNumActiveGridObjects;
                 g_NumGridObjectsSlider->OnGuiEvent();
 
+                // the grid objects that were shown or hidden
+                InvalidateGridObjectShadows( std::min( g_iNumActiveGridObjects, nPreviousNumGridObjects ), std::max( g_iNumActiveGridObjects, nPreviousNumGridObjects ) );
+
                 if ( g_LightingMode == LIGHTING_SHADOWS )
                 {
                     // need to update the shadow maps when grid object count changes
@@ -1270,8 +1468,6 @@ void ClearD3D11DeviceContext()
 
 void UpdateShadowConstants()
 {
-    static const int POINT_SHADOW_SIZE = 256;
-
     HRESULT hr;
     D3D11_MAPPED_SUBRESOURCE MappedResource;
 
@@ -1284,11 +1480,13 @@ void UpdateShadowConstants()
     memcpy(pShadowConstants->m_mPointShadowViewProj, LightUtil::GetShadowCastingPointLightViewProjTransposedArray(), sizeof(pShadowConstants->m_mPointShadowViewProj));
     memcpy(pShadowConstants->m_mSpotShadowViewProj, LightUtil::GetShadowCastingSpotLightViewProjTransposedArray(), sizeof(pShadowConstants->m_mSpotShadowViewProj));
 
-    float pointShadowMapSize = (float)POINT_SHADOW_SIZE;
-    float pointBlurSize = 2.5f;
+    // the atlas tiles, with the point light filter's border, are in the scale and offset
+    memcpy(pShadowConstants->m_PointShadowScaleOffset, g_ShadowRenderer.GetPointShadowScaleOffsetArray(), sizeof(pShadowConstants->m_PointShadowScaleOffset));
+    memcpy(pShadowConstants->m_SpotShadowScaleOffset, g_ShadowRenderer.GetSpotShadowScaleOffsetArray(), sizeof(pShadowConstants->m_SpotShadowScaleOffset));
+
     XMFLOAT4 ShadowBias;
-    ShadowBias.x = (pointShadowMapSize - 2.0f * pointBlurSize) / pointShadowMapSize;
-    ShadowBias.y = pointBlurSize / pointShadowMapSize;
+    ShadowBias.x = 0.0f;
+    ShadowBias.y = 0.0f;
     ShadowBias.z = (float)g_PointShadowBias * 0.00001f;
     ShadowBias.w = (float)g_SpotShadowBias * 0.00001f;
     pShadowConstants->m_ShadowBias = XMLoadFloat4(&ShadowBias);
@@ -1320,9 +1518,22 @@ void UpdateCameraConstantBufferWithTranspose( const XMMATRIX& mViewProj )
 }
 
 
-void RenderDepthOnlyScene()
+void RenderDepthOnlyScene( const unsigned* pCasters, unsigned uNumCasters )
 {
-    g_ForwardPlusUtil.RenderSceneForShadowMaps( g_CurrentGuiState, g_Scene, g_CommonUtil );
+    g_ForwardPlusUtil.RenderSceneForShadowMaps( g_CurrentGuiState, g_Scene, g_CommonUtil, pCasters, uNumCasters );
+}
+
+
+//--------------------------------------------------------------------------------------
+// The grid objects in [nFirst,nEnd) were shown, hidden or changed, so the cached shadow 
+// maps that hold or see them must be rendered again
+//--------------------------------------------------------------------------------------
+void InvalidateGridObjectShadows( int nFirst, int nEnd )
+{
+    for( int i = nFirst; i < nEnd; i++ )
+    {
+        g_ShadowRenderer.InvalidateShadowCaster( ForwardPlusUtil::GetGridObjectShadowCaster( g_Scene, i ) );
+    }
 }
 
 
@@ -1344,6 +1555,48 @@ void UpdateUI()
     g_NumSpotLightsSlider->OnGuiEvent();
 }
 
+//--------------------------------------------------------------------------------------
+// Start or stop appending the light list telemetry to LightListTelemetry.csv and
+// LightListTelemetry.json (one JSON object per line) in the working directory
+//--------------------------------------------------------------------------------------
+void StartLightListRecording()
+{
+    StopLightListRecording();
+
+    if( fopen_s( &g_pLightListCSV, "LightListTelemetry.csv", "w" ) != 0 )
+    {
+        g_pLightListCSV = NULL;
+        return;
+    }
+
+    if( fopen_s( &g_pLightListJSON, "LightListTelemetry.json", "w" ) != 0 )
+    {
+        fclose( g_pLightListCSV );
+        g_pLightListCSV = NULL;
+        g_pLightListJSON = NULL;
+        return;
+    }
+
+    WriteLightListTelemetryCSVHeader( g_pLightListCSV );
+    g_uLightListFrame = 0;
+    g_CommonUtil.ResetLightListTelemetry();
+}
+
+void StopLightListRecording()
+{
+    if( g_pLightListCSV != NULL )
+    {
+        fclose( g_pLightListCSV );
+        g_pLightListCSV = NULL;
+    }
+
+    if( g_pLightListJSON != NULL )
+    {
+        fclose( g_pLightListJSON );
+        g_pLightListJSON = NULL;
+    }
+}
+
 //--------------------------------------------------------------------------------------
 // EOF.
 //--------------------------------------------------------------------------------------